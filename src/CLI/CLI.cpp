@@ -6,35 +6,85 @@
 #include "Libraries/Paths/Paths.hpp"
 
 #include <fstream>
+#include <thread>
 
 // ==== Main functions ====
 
-void build(const std::string& nlpFile) {
+static std::vector<std::filesystem::path> collectFiles(const std::filesystem::path& sourceFolder) {
+    std::vector<std::filesystem::path> files;
+    for (const auto& file : std::filesystem::recursive_directory_iterator(sourceFolder, std::filesystem::directory_options::skip_permission_denied)) {
+        if (file.is_regular_file() && file.path().extension() == ".nm") files.push_back(file.path());
+    }
+    return files;
+}
+
+static CompilationInput compilationInput(const ProjectConfig& config) {
+    CompilationInput input;
+    input.name = config.name;
+    input.targetOutput = config.output;
+    input.settings = parseCompilerSettings(config.compilerSettings);
+    input.sourceFolder = std::filesystem::path(config.sourcePath) / config.sourceFolder;
+    input.files = collectFiles(input.sourceFolder);
+    input.buildFolder = std::filesystem::path(config.sourcePath) / config.buildFolder;
+    input.dependencies = {{"std", std::filesystem::path(Paths::dataDir() + "/modules/std")}}; // todo: doesn't support external for now
+    return input;
+}
+
+std::filesystem::path build(const std::string& nlpFile, const std::string& lto) {
     ProjectConfig config = parseProjectFile(nlpFile);
     std::println("{} {}", Localization::translate("CLI.build.initialization"), config.name);
-    // todo: compiler call, executable generation
-}
 
-void run(const std::string& nlpFile) {
-    build(nlpFile);
-    std::println("{}\n", Localization::translate("CLI.run.initialization"));
-    // todo: launch the file using std::system or CreateProcess
+    CompilationInput input = compilationInput(config);
+    if (!lto.empty()) input.settings.lto = parseLTO(lto);
+    Compiler compiler = Compiler(input);
+    if (!compiler.compile()) return {};
+
+    std::println("{}{}{}", Color::TextHex("#75ff87"), formatStr(Localization::translate("CLI.build.complete"), compiler.program.output.string()), Color::Reset);
+    return compiler.program.output;
 }
 
-void check(const std::string& nlpFile, bool jsonOutput) {
+int run(const std::string& nlpFile) {
     ProjectConfig config = parseProjectFile(nlpFile);
-    CompilationInput input;
+    std::println("{} {}\n", Localization::translate("CLI.run.initialization"), config.name);
 
-    input.targetOutput = config.output;
-    input.settings = parseCompilerSettings(config.compilerSettings);
-    for (const auto& file : std:: filesystem::recursive_directory_iterator(std::filesystem::path(config.sourcePath) / config.sourceFolder, std::filesystem::directory_options::skip_permission_denied)) {
-        if (file.is_regular_file() && file.path().extension() == ".nm") input.files.push_back(file.path());
-    }
-    input.dependencies = {{"std", std::filesystem::path(Paths::dataDir() + "modules/std")}}; // todo: doesn't support external for now
+    // nothing is written: the program is compiled in memory and runs inside this process
+    Compiler compiler = Compiler(compilationInput(config));
+    return compiler.run();
+}
+
+void check(const std::string& nlpFile, bool jsonOutput, bool watch) {
+    ProjectConfig config = parseProjectFile(nlpFile);
+    CompilationInput input = compilationInput(config);
+    std::filesystem::path sourceFolder = input.sourceFolder;
 
     Compiler compiler = Compiler(input);
     if (!jsonOutput) std::println("{}{}{}", Color::TextHex("#75ff87"), formatStr(Localization::translate("CLI.check.initialization"), config.name), Color::Reset);
     compiler.check(jsonOutput);
+    if (!watch) return;
+
+    // The compiler stays alive, so every check after the first one only re-runs what the edit affected
+    auto snapshot = [&sourceFolder] {
+        std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>> stamps;
+        for (const auto& file : collectFiles(sourceFolder)) {
+            std::error_code error;
+            stamps.emplace_back(file, std::filesystem::last_write_time(file, error));
+        }
+        return stamps;
+    };
+    auto stamps = snapshot();
+    while (true) {
+        if (!jsonOutput) std::println("{}", Localization::translate("CLI.check.watching"));
+        std::fflush(stdout); // the output may be piped into an editor that waits for it
+        for (auto current = snapshot(); current == stamps; current = snapshot())
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        stamps = snapshot();
+
+        auto before = compiler.queries.statistics();
+        compiler.program.input.files = collectFiles(sourceFolder);
+        compiler.check(jsonOutput);
+        auto after = compiler.queries.statistics();
+        if (!jsonOutput) std::println("{}", formatStr(Localization::translate("CLI.check.rechecked"), after.executed - before.executed, after.reused - before.reused));
+    }
 }
 
 void createProject() {
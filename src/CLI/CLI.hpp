@@ -20,9 +20,9 @@ CLIArgs parseArgs(int argc, char** argv);
 
 // ==== Main functions ====
 
-void build(const std::string& nlpFile); // Compiles Neoluma program into a binary executable
-void run(const std::string& nlpFile); // Runs the code interpreted way. Useful for testing.
-void check(const std::string& nlpFile, bool jsonOutput = false); // Checks code on errors. Doesn't generate any binaries
+std::filesystem::path build(const std::string& nlpFile, const std::string& lto = ""); // Compiles Neoluma program into the output of the project file. Returns its path, empty if it failed. `lto` overrides [compiler] lto
+int run(const std::string& nlpFile); // Runs the program with the JIT, whatever its output type is. Returns its exit code
+void check(const std::string& nlpFile, bool jsonOutput = false, bool watch = false); // Checks code on errors. Doesn't generate any binaries. With `watch` checks again on every change
 void createProject(ProjectConfig config); // Creates a project
 void createProject(); // Creates a project (Without ProjectConfig)
 
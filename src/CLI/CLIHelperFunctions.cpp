@@ -1,5 +1,7 @@
 #include "CLIHelperFunctions.hpp"
 
+#include <algorithm>
+
 #include "CLI.hpp"
 #include "Libraries/Asker/Asker.hpp"
 #include "Libraries/Color/Color.hpp"
@@ -85,6 +87,24 @@ std::map<std::string, std::string> extractMap(const Toml::TomlTable& root, const
 
     return result;
 }
+
+std::map<std::string, ProjectSettingValue> extractSettings(const Toml::TomlTable& root, const std::string& key) {
+    std::map<std::string, ProjectSettingValue> result;
+
+    for (const auto& [k, v] : root) {
+        if (k == key && v.type == Toml::TomlType::Table) {
+            const auto& tbl = std::get<Toml::TomlTable>(v.value);
+            for (const auto& [tk, tv] : tbl) {
+                if (tv.type == Toml::TomlType::Boolean) result[tk] = std::get<bool>(tv.value);
+                else if (tv.type == Toml::TomlType::Integer) result[tk] = std::get<int64_t>(tv.value);
+                else if (tv.type == Toml::TomlType::Float) result[tk] = std::get<double>(tv.value);
+                else if (tv.type == Toml::TomlType::String) result[tk] = std::get<std::string>(tv.value);
+            }
+        }
+    }
+
+    return result;
+}
 // --------
 
 // Argument parsing
@@ -98,6 +118,12 @@ CLIArgs parseArgs(int argc, char** argv) {
             std::string key = token.substr(2);
             std::string value;
 
+            // --key=value
+            if (size_t equals = key.find('='); equals != std::string::npos) {
+                args.options[key.substr(0, equals)] = key.substr(equals + 1);
+                continue;
+            }
+
             while (i + 1 < argc && argv[i + 1][0] != '-') {
                 if (!value.empty()) value += " ";
                 value += argv[++i];
@@ -133,6 +159,7 @@ ProjectConfig parseProjectFile(const std::string& file) {
     config.dependencies = extractMap(root, "dependencies");
     config.tests = extractMap(root, "tests");
     config.languagePacks = extractMap(root, "languagePacks");
+    config.compilerSettings = extractSettings(root, "compiler");
 
     // configure source path
     config.sourcePath = std::filesystem::path(file).parent_path().string();
@@ -145,6 +172,13 @@ CompilerSettings parseCompilerSettings(const std::map<std::string, ProjectSettin
 
     config.verbose = map.contains("verbose") ? std::get<bool>(map.at("verbose")) : config.verbose;
     config.baremetal = map.contains("baremetal") ? std::get<bool>(map.at("baremetal")) : config.baremetal;
+    config.lto = map.contains("lto") && std::holds_alternative<std::string>(map.at("lto")) ? parseLTO(std::get<std::string>(map.at("lto"))) : config.lto;
+    config.target = map.contains("target") && std::holds_alternative<std::string>(map.at("target")) ? std::get<std::string>(map.at("target")) : config.target;
+    config.memory.level = map.contains("memory") && std::holds_alternative<std::string>(map.at("memory")) ? parseMemory(std::get<std::string>(map.at("memory"))) : config.memory.level;
+    config.memory.heapSize = map.contains("heapSize") && std::holds_alternative<int64_t>(map.at("heapSize")) ? std::max<int64_t>(std::get<int64_t>(map.at("heapSize")), 0) : config.memory.heapSize;
+    config.memory.pauseTarget = map.contains("gcPause") ? parsePauseTarget(map.at("gcPause")) : config.memory.pauseTarget;
+    config.memory.gcStats = map.contains("gcStats") && std::holds_alternative<bool>(map.at("gcStats")) ? std::get<bool>(map.at("gcStats")) : config.memory.gcStats;
+    config.memory.arcStats = map.contains("arcStats") && std::holds_alternative<bool>(map.at("arcStats")) ? std::get<bool>(map.at("arcStats")) : config.memory.arcStats;
 
     return config;
 }
@@ -197,6 +231,27 @@ License parseLicense(std::string license) {
     return License::Custom;
 }
 
+CompilerSettings::LTO parseLTO(const std::string& lto) {
+    if (lto == "thin") return CompilerSettings::LTO::Thin;
+    if (lto != "none") std::println(std::cerr, "{}[NeolumaCLI/parseLTO] {}{}", Color::TextHex("#ff5050"), Localization::translate("CLI.parseProjectFile.parseLTOError"), Color::Reset);
+    return CompilerSettings::LTO::None;
+}
+
+CompilerSettings::Memory::MemoryOptions parseMemory(const std::string& memory) {
+    if (memory == "arc") return CompilerSettings::Memory::MemoryOptions::ARC;
+    if (memory == "rusty") return CompilerSettings::Memory::MemoryOptions::Rusty;
+    if (memory == "none") return CompilerSettings::Memory::MemoryOptions::None;
+    if (memory != "default") std::println(std::cerr, "{}[NeolumaCLI/parseMemory] {}{}", Color::TextHex("#ff5050"), Localization::translate("CLI.parseProjectFile.parseMemoryError"), Color::Reset);
+    return CompilerSettings::Memory::MemoryOptions::Default;
+}
+
+double parsePauseTarget(const ProjectSettingValue& pause) {
+    if (std::holds_alternative<double>(pause) && std::get<double>(pause) > 0) return std::get<double>(pause);
+    if (std::holds_alternative<int64_t>(pause) && std::get<int64_t>(pause) > 0) return static_cast<double>(std::get<int64_t>(pause));
+    std::println(std::cerr, "{}[NeolumaCLI/parsePauseTarget] {}{}", Color::TextHex("#ff5050"), Localization::translate("CLI.parseProjectFile.parsePauseTargetError"), Color::Reset);
+    return CompilerSettings::Memory{}.pauseTarget;
+}
+
 OutputType parseOutput(std::string outputType) {
     if (outputType == "exe") return OutputType::Executable;
     if (outputType == "ir") return OutputType::IR;
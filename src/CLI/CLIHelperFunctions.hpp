@@ -24,6 +24,7 @@ void clearScreen();
 std::string getString(const Toml::TomlTable& table, const std::string& key, const std::string& def);
 std::vector<std::string> getStringArray(const Toml::TomlTable& table, const std::string& key);
 std::map<std::string, std::string> extractMap(const Toml::TomlTable& root, const std::string& key);
+std::map<std::string, ProjectSettingValue> extractSettings(const Toml::TomlTable& root, const std::string& key);
 
 ProjectConfig parseProjectFile(const std::string& file);
 CompilerSettings parseCompilerSettings(const std::map<std::string, ProjectSettingValue>& map);
@@ -31,4 +32,7 @@ CompilerSettings parseCompilerSettings(const std::map<std::string, ProjectSettin
 std::string licenseID(License license);
 std::string outputID(OutputType type);
 License parseLicense(std::string license);
-OutputType parseOutput(std::string outputType);
\ No newline at end of file
+OutputType parseOutput(std::string outputType);
+CompilerSettings::LTO parseLTO(const std::string& lto);
+CompilerSettings::Memory::MemoryOptions parseMemory(const std::string& memory);
+double parsePauseTarget(const ProjectSettingValue& pause);
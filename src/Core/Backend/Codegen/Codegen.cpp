@@ -0,0 +1,340 @@
+#include "Codegen.hpp"
+
+#include <cstdlib>
+#include <format>
+#include <mutex>
+#include <unordered_set>
+
+// LLVM Primitives
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/LTO/Config.h"
+#include "llvm/LTO/LTO.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Caching.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/IPO/ThinLTOBitcodeWriter.h"
+#if LLVM_VERSION_MAJOR >= 17
+#include "llvm/TargetParser/Host.h"
+#include "llvm/TargetParser/Triple.h"
+#else
+#include "llvm/ADT/Triple.h"
+#include "llvm/Support/Host.h"
+#endif
+
+#include "Core/Compiler.hpp"
+
+static std::string quote(const std::filesystem::path& path) { return std::format("\"{}\"", path.string()); }
+
+// ==== Target ====
+
+Codegen::Codegen() = default;
+Codegen::~Codegen() = default;
+
+bool Codegen::initialize(const std::string& triple) {
+    // target registration isn't thread-safe, and every thread of parallel codegen sets up its own Codegen
+    static std::once_flag targets;
+    std::call_once(targets, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+
+    targetTriple = triple.empty() ? llvm::sys::getDefaultTargetTriple() : triple;
+    std::string error;
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+    if (!target) {
+        errorManager->addError(ErrorType::Codegen, CodegenErrors::TargetNotSupported,
+            ErrorSpan{"", targetTriple, 0, 0},
+            "ErrorManager.Codegen.TargetNotSupported.message", {targetTriple},
+            "ErrorManager.Codegen.TargetNotSupported.hint", {error});
+        return false;
+    }
+
+    // a generic CPU keeps binaries runnable on every machine of the target, PIC lets the same objects go into shared libraries
+#if LLVM_VERSION_MAJOR >= 21
+    targetMachine.reset(target->createTargetMachine(llvm::Triple(targetTriple), "generic", "", llvm::TargetOptions(), llvm::Reloc::PIC_));
+#else
+    targetMachine.reset(target->createTargetMachine(targetTriple, "generic", "", llvm::TargetOptions(), llvm::Reloc::PIC_));
+#endif
+    return true;
+}
+
+std::string Codegen::dataLayout() const {
+    return targetMachine ? targetMachine->createDataLayout().getStringRepresentation() : "";
+}
+
+// ==== Modules ====
+
+bool Codegen::verify(llvm::Module& module) {
+    std::string message;
+    llvm::raw_string_ostream stream(message);
+    if (!llvm::verifyModule(module, &stream)) return true;
+
+    stream.flush();
+    errorManager->addError(ErrorType::Codegen, CodegenErrors::LLVMGenerationError,
+        ErrorSpan{"", module.getName().str(), 0, 0},
+        "ErrorManager.Codegen.LLVMGenerationError.message", {module.getName().str()},
+        "ErrorManager.Codegen.LLVMGenerationError.hint", {message.substr(0, message.find('\n'))});
+    return false;
+}
+
+void Codegen::optimize(llvm::Module& module) { runPipeline(module, nullptr); }
+
+bool Codegen::emitObject(llvm::Module& module, const std::filesystem::path& path) {
+    if (!prepareFile(path)) return false;
+
+    std::error_code error;
+    llvm::raw_fd_ostream out(path.string(), error, llvm::sys::fs::OF_None);
+    if (error) {
+        reportWrite(path, error.message());
+        return false;
+    }
+
+#if LLVM_VERSION_MAJOR >= 18
+    auto fileType = llvm::CodeGenFileType::ObjectFile;
+#else
+    auto fileType = llvm::CGFT_ObjectFile;
+#endif
+    // machine code generation still runs on the legacy PassManager
+    llvm::legacy::PassManager passes;
+    if (targetMachine->addPassesToEmitFile(passes, out, nullptr, fileType)) {
+        errorManager->addError(ErrorType::Codegen, CodegenErrors::TargetNotSupported,
+            ErrorSpan{"", targetTriple, 0, 0},
+            "ErrorManager.Codegen.TargetNotSupported.message", {targetTriple},
+            "ErrorManager.Codegen.TargetNotSupported.objectFiles.hint");
+        return false;
+    }
+    passes.run(module);
+    out.flush();
+    return true;
+}
+
+bool Codegen::emitIR(llvm::Module& module, const std::filesystem::path& path) {
+    if (!prepareFile(path)) return false;
+
+    std::error_code error;
+    llvm::raw_fd_ostream out(path.string(), error, llvm::sys::fs::OF_Text);
+    if (error) {
+        reportWrite(path, error.message());
+        return false;
+    }
+    module.print(out, nullptr);
+    return true;
+}
+
+bool Codegen::emitText(const std::string& text, const std::filesystem::path& path) {
+    if (!prepareFile(path)) return false;
+
+    std::error_code error;
+    llvm::raw_fd_ostream out(path.string(), error, llvm::sys::fs::OF_Text);
+    if (error) {
+        reportWrite(path, error.message());
+        return false;
+    }
+    out << text;
+    return true;
+}
+
+// ==== Linking ====
+
+bool Codegen::link(const std::vector<std::filesystem::path>& objects, const std::filesystem::path& output, OutputType type) {
+    if (!prepareFile(output)) return false;
+
+    llvm::Triple triple(targetTriple);
+    std::string command;
+    if (type == OutputType::StaticLibrary) {
+        const char* archiver = std::getenv("AR");
+        command = std::format("{} rcs {}", archiver ? archiver : triple.isOSWindows() ? "llvm-ar" : "ar", quote(output));
+        for (const auto& object : objects) command += " " + quote(object);
+    } else {
+        const char* driver = std::getenv("CC");
+        command = driver ? driver : triple.isOSWindows() ? "clang" : "cc";
+        if (type == OutputType::SharedLibrary) command += " -shared";
+        for (const auto& object : objects) command += " " + quote(object);
+        command += " -o " + quote(output);
+        if (!triple.isOSWindows()) command += " -lm -pthread"; // sqrt, pow and friends that LLVM doesn't inline, and the async workers
+    }
+
+    // an archive is added to, so an old one would keep objects that no longer exist
+    std::error_code error;
+    if (type == OutputType::StaticLibrary) std::filesystem::remove(output, error);
+
+    if (std::system(command.c_str()) != 0) {
+        errorManager->addError(ErrorType::Codegen, CodegenErrors::LinkageError,
+            ErrorSpan{"", output.string(), 0, 0},
+            "ErrorManager.Codegen.LinkageError.message", {output.filename().string()},
+            "ErrorManager.Codegen.LinkageError.hint", {command});
+        return false;
+    }
+    return true;
+}
+
+std::filesystem::path Codegen::outputPath(const std::filesystem::path& folder, const std::string& name, OutputType type) const {
+    llvm::Triple triple(targetTriple);
+    switch (type) {
+        case OutputType::Executable: return folder / (triple.isOSWindows() ? name + ".exe" : name);
+        case OutputType::Object: return folder / (name + objectExtension());
+        case OutputType::StaticLibrary: return folder / (triple.isOSWindows() ? name + ".lib" : "lib" + name + ".a");
+        case OutputType::SharedLibrary:
+            if (triple.isOSWindows()) return folder / (name + ".dll");
+            return folder / ("lib" + name + (triple.isOSDarwin() ? ".dylib" : ".so"));
+        case OutputType::IR: return folder / (name + ".nir");
+        default: return folder / (name + ".ll");
+    }
+}
+
+std::string Codegen::objectExtension() const { return llvm::Triple(targetTriple).isOSWindows() ? ".obj" : ".o"; }
+
+// ==== ThinLTO ====
+
+bool Codegen::emitBitcode(llvm::Module& module, const std::filesystem::path& path) {
+    if (!prepareFile(path)) return false;
+
+    std::error_code error;
+    llvm::raw_fd_ostream out(path.string(), error, llvm::sys::fs::OF_None);
+    if (error) {
+        reportWrite(path, error.message());
+        return false;
+    }
+    runPipeline(module, &out);
+    return true;
+}
+
+bool Codegen::linkThin(const std::vector<std::filesystem::path>& bitcode, const std::filesystem::path& output, OutputType type, const std::filesystem::path& buildFolder) {
+    auto fail = [&](const std::string& reason) {
+        errorManager->addError(ErrorType::Codegen, CodegenErrors::OptimizationFailure,
+            ErrorSpan{"", output.string(), 0, 0},
+            "ErrorManager.Codegen.OptimizationFailure.message", {output.filename().string()},
+            "ErrorManager.Codegen.OptimizationFailure.hint", {reason});
+        return false;
+    };
+
+    llvm::lto::Config config;
+    config.CPU = "generic";
+    config.RelocModel = llvm::Reloc::PIC_;
+    config.OptLevel = 2;
+    config.DefaultTriple = targetTriple;
+    llvm::lto::LTO lto(std::move(config), llvm::lto::createInProcessThinBackend(llvm::heavyweight_hardware_concurrency()));
+
+    // inputs point into their buffers, which have to outlive the link
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> buffers;
+    std::unordered_set<std::string> defined; // the runtime pieces are linkonce_odr in every module using them
+    for (const auto& path : bitcode) {
+        auto buffer = llvm::MemoryBuffer::getFile(path.string());
+        if (!buffer) return fail(std::format("{}: {}", path.string(), buffer.getError().message()));
+        auto input = llvm::lto::InputFile::create((*buffer)->getMemBufferRef());
+        if (!input) return fail(llvm::toString(input.takeError()));
+
+        // There's no other object in the link: the first definition of a symbol prevails, the copies after it are
+        // dropped. An executable only has to keep `main`.
+        std::vector<llvm::lto::SymbolResolution> resolutions;
+        for (const auto& symbol : (*input)->symbols()) {
+            bool prevailing = !symbol.isUndefined() && defined.insert(std::string(symbol.getName())).second;
+            llvm::lto::SymbolResolution resolution;
+            resolution.Prevailing = prevailing;
+            resolution.FinalDefinitionInLinkageUnit = prevailing;
+            resolution.VisibleToRegularObj = prevailing && (type != OutputType::Executable || symbol.getIRName() == "main");
+            resolutions.push_back(resolution);
+        }
+        if (llvm::Error error = lto.add(std::move(*input), resolutions)) return fail(llvm::toString(std::move(error)));
+        buffers.push_back(std::move(*buffer));
+    }
+
+    // Every task of the link is one native object. Backend threads write them, each to its own slot.
+    std::filesystem::path objectFolder = buildFolder / "obj" / "thinlto";
+    auto objectPath = [&](unsigned task) { return objectFolder / std::format("{}{}", task, objectExtension()); };
+    if (!prepareFile(objectPath(0))) return false;
+    std::vector<std::filesystem::path> objects(lto.getMaxTasks());
+    std::mutex failures;
+    std::string failure;
+    auto writeObject = [&](unsigned task, const llvm::MemoryBuffer& buffer) {
+        std::error_code error;
+        llvm::raw_fd_ostream out(objectPath(task).string(), error, llvm::sys::fs::OF_None);
+        if (error) {
+            std::scoped_lock lock(failures);
+            failure = std::format("{}: {}", objectPath(task).string(), error.message());
+            return;
+        }
+        out << buffer.getBuffer();
+        objects[task] = objectPath(task);
+    };
+    auto addStream = [&](unsigned task, const auto&...) -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>> {
+        std::error_code error;
+        auto out = std::make_unique<llvm::raw_fd_ostream>(objectPath(task).string(), error, llvm::sys::fs::OF_None);
+        if (error) return llvm::errorCodeToError(error);
+        objects[task] = objectPath(task);
+        return std::make_unique<llvm::CachedFileStream>(std::move(out), objectPath(task).string());
+    };
+#if LLVM_VERSION_MAJOR >= 16
+    auto addBuffer = [&](unsigned task, const llvm::Twine&, std::unique_ptr<llvm::MemoryBuffer> buffer) { writeObject(task, *buffer); };
+#else
+    auto addBuffer = [&](unsigned task, std::unique_ptr<llvm::MemoryBuffer> buffer) { writeObject(task, *buffer); };
+#endif
+
+    // the key of a cached object covers the summaries of its module and of everything imported into it
+    std::filesystem::path cacheFolder = buildFolder / "cache" / "thinlto";
+    auto cache = llvm::localCache("ThinLTO", "thinlto", cacheFolder.string(), addBuffer);
+    if (!cache) return fail(llvm::toString(cache.takeError()));
+    if (llvm::Error error = lto.run(addStream, *cache)) return fail(llvm::toString(std::move(error)));
+    if (!failure.empty()) return fail(failure);
+
+    // the default policy drops entries that weren't used for a week
+    llvm::pruneCache(cacheFolder.string(), llvm::CachePruningPolicy());
+
+    std::erase_if(objects, [](const std::filesystem::path& object) { return object.empty(); });
+    return link(objects, output, type);
+}
+
+// ==== Helpers ====
+
+void Codegen::runPipeline(llvm::Module& module, llvm::raw_ostream* bitcode) {
+    // the analysis managers have to outlive each other in this order
+    llvm::LoopAnalysisManager loops;
+    llvm::FunctionAnalysisManager functions;
+    llvm::CGSCCAnalysisManager cgscc;
+    llvm::ModuleAnalysisManager modules;
+
+    llvm::PassBuilder passes(targetMachine.get());
+    passes.registerModuleAnalyses(modules);
+    passes.registerCGSCCAnalyses(cgscc);
+    passes.registerFunctionAnalyses(functions);
+    passes.registerLoopAnalyses(loops);
+    passes.crossRegisterProxies(loops, functions, cgscc, modules);
+
+    // before a ThinLTO link only the cheap half runs: inlining across modules and what it enables come at the link
+    llvm::ModulePassManager pipeline;
+    if (bitcode) {
+        pipeline = passes.buildThinLTOPreLinkDefaultPipeline(llvm::OptimizationLevel::O2);
+        pipeline.addPass(llvm::ThinLTOBitcodeWriterPass(*bitcode, nullptr));
+    }
+    else pipeline = passes.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2);
+    pipeline.run(module, modules);
+}
+
+
+bool Codegen::prepareFile(const std::filesystem::path& path) {
+    std::error_code error;
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), error);
+    if (error) {
+        reportWrite(path, error.message());
+        return false;
+    }
+    return true;
+}
+
+void Codegen::reportWrite(const std::filesystem::path& path, const std::string& reason) {
+    errorManager->addError(ErrorType::Codegen, CodegenErrors::LLVMGenerationError,
+        ErrorSpan{"", path.string(), 0, 0},
+        "ErrorManager.Codegen.LLVMGenerationError.write.message", {path.string()},
+        "ErrorManager.Codegen.LLVMGenerationError.write.hint", {reason});
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Core/Extras/ErrorManager/ErrorManager.hpp"
+#include "HelperFunctions.hpp"
+
+// Compiler.hpp includes this header, LLVM stays out of it
+namespace llvm {
+    class Module;
+    class TargetMachine;
+    class raw_ostream;
+}
+enum class OutputType;
+
+/* Codegen is the Backend: it turns LLVM modules from the IR Generator into files for the target machine.
+ * - optimize() runs the standard per-module pipeline of the new PassManager, the one `clang -O2` runs
+ * - emitObject()/emitIR() write a module as a native object file or as textual LLVM IR, emitText() writes what
+ *   earlier stages print (NIR)
+ * - link() puts object files together with the system toolchain: the C compiler driver links executables and
+ *   shared libraries against the C library, `ar` packs static libraries. Both can be replaced with $CC and $AR.
+ * - emitBitcode()/linkThin() are the two halves of ThinLTO: modules are written as bitcode with a summary of what they
+ *   define and call, the link imports functions across modules by those summaries and optimizes every module again
+ *   in parallel. Native objects of the link are cached in the build folder by a key computed from the summaries.
+ * A Codegen is used by one thread at a time, parallel codegen creates one per thread.
+ */
+struct Codegen {
+    // ErrorManager is used to report errors
+    ErrorManager* errorManager = nullptr;
+
+    Codegen();
+    ~Codegen();
+
+    // Sets up the target, an empty triple is the host. False (with an error) if LLVM can't generate code for it.
+    bool initialize(const std::string& triple = "");
+    const std::string& triple() const { return targetTriple; }
+    std::string dataLayout() const;
+
+    bool verify(llvm::Module& module); // false means the IR Generator produced broken IR, which is a compiler bug
+    void optimize(llvm::Module& module); // -O2
+    bool emitObject(llvm::Module& module, const std::filesystem::path& path);
+    bool emitIR(llvm::Module& module, const std::filesystem::path& path);
+    bool emitText(const std::string& text, const std::filesystem::path& path);
+    bool link(const std::vector<std::filesystem::path>& objects, const std::filesystem::path& output, OutputType type);
+
+    bool emitBitcode(llvm::Module& module, const std::filesystem::path& path); // ThinLTO pre-link pipeline, then bitcode with a summary
+    // Runs ThinLTO over bitcode from emitBitcode() and links the result. Objects and the cache go under `buildFolder`.
+    bool linkThin(const std::vector<std::filesystem::path>& bitcode, const std::filesystem::path& output, OutputType type, const std::filesystem::path& buildFolder);
+
+    // Where an output named `name` goes in `folder`, with the file name conventions of the target (`app.exe`, `libapp.so`)
+    std::filesystem::path outputPath(const std::filesystem::path& folder, const std::string& name, OutputType type) const;
+    std::string objectExtension() const;
+
+private:
+    std::string targetTriple;
+    MemoryPtr<llvm::TargetMachine> targetMachine;
+
+    void runPipeline(llvm::Module& module, llvm::raw_ostream* bitcode); // -O2, or the ThinLTO pre-link half of it if `bitcode` is set
+    bool prepareFile(const std::filesystem::path& path);
+    void reportWrite(const std::filesystem::path& path, const std::string& reason);
+};
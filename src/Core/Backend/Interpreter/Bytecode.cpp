@@ -0,0 +1,621 @@
+#include "Bytecode.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+
+#include "Core/Frontend/SemanticAnalysis/Types.hpp"
+
+static constexpr uint32_t notGlobal = UINT32_MAX;
+
+static bool isComparison(const std::string& op) { return op == "==" || op == "!=" || op == "<" || op == ">" || op == "<=" || op == ">="; }
+
+static bool isLogical(const std::string& op) { return op == "&&" || op == "||" || op == "and" || op == "or"; }
+
+static bool isInterpolation(const ASTNode* node) {
+    return node->type == ASTNodeType::Literal && static_cast<const LiteralNode*>(node)->isInterpolation();
+}
+
+// Whether the code of an expression writes its target with the last instruction only. Short-circuits and interpolations
+// use the target on the way, so it can't be a variable the expression still reads.
+static bool writesTargetLast(const ASTNode* node) {
+    if (node->type == ASTNodeType::BinaryOperation && isLogical(node->value)) return false;
+    return !isInterpolation(node);
+}
+
+// ==== Program ====
+
+Scalar BytecodeCompiler::scalarOf(const Type* type) {
+    if (!type || type->kind != Type::Kind::Primitive) return Scalar::None;
+    switch (type->primitive) {
+        case ResolvedType::Int8: return Scalar::Int8;
+        case ResolvedType::Int16: return Scalar::Int16;
+        case ResolvedType::Int: return Scalar::Int32;
+        case ResolvedType::Int64: return Scalar::Int64;
+        case ResolvedType::UInt8: return Scalar::UInt8;
+        case ResolvedType::UInt16: return Scalar::UInt16;
+        case ResolvedType::UInt: return Scalar::UInt32;
+        case ResolvedType::UInt64: return Scalar::UInt64;
+        case ResolvedType::Float: return Scalar::Float;
+        case ResolvedType::Float64: return Scalar::Double;
+        case ResolvedType::Bool: return Scalar::Bool;
+        case ResolvedType::Str: return Scalar::Str;
+        // 128-bit integers and numbers don't fit a register, the ones with numbers run natively. Void isn't a value.
+        default: return Scalar::None;
+    }
+}
+
+bool BytecodeCompiler::compile(const std::vector<ModuleNode*>& modules, FunctionNode* entry, BytecodeProgram& output) {
+    program = &output;
+    failed = false;
+    globalDeclarations.clear();
+    globalIndexes.clear();
+    functionIndexes.clear();
+
+    // the entry is called with no arguments, like the C `main` of native code calls it
+    if (!entry || !entry->parameters.empty()) return false;
+
+    program->functions.emplace_back(); // global initializers
+    for (ModuleNode* node : modules)
+        if (node) declareTopLevel(node->body);
+    for (ModuleNode* node : modules)
+        if (node && !compileTopLevel(node->body)) return false;
+
+    current = 0;
+    emit(Opcode::ReturnVoid, Scalar::None, 0, 0, 0, nullptr);
+
+    program->entry = functionIndex(entry);
+    const Type* type = entry->inferredType;
+    if (type && type->kind == Type::Kind::Function && returnsValue(entry->body.get())) program->entryResult = scalarOf(type->returnType());
+
+    // every function that's called needs its code here, the interpreter has nowhere else to look
+    for (size_t i = 1; i < program->functions.size(); i++)
+        if (program->functions[i].code.empty()) return false;
+    return !failed;
+}
+
+void BytecodeCompiler::declareTopLevel(std::vector<MemoryPtr<ASTNode>>& body) {
+    for (auto& statement : body) {
+        if (statement->type == ASTNodeType::Namespace) declareTopLevel(static_cast<NamespaceNode*>(statement.get())->body);
+        if (statement->type != ASTNodeType::Declaration) continue;
+
+        // every global gets its index up front, functions may use the ones declared after them
+        auto* declaration = static_cast<DeclarationNode*>(statement.get());
+        Scalar scalar = scalarOf(declaration->inferredType);
+        if (scalar == Scalar::None) failed = true;
+        globalDeclarations[declaration->variable->varName].push_back(declaration);
+        globalIndexes[declaration] = static_cast<uint32_t>(program->globals.size());
+        program->globals.push_back(BytecodeGlobal{declaration, scalar});
+    }
+}
+
+bool BytecodeCompiler::compileTopLevel(std::vector<MemoryPtr<ASTNode>>& body) {
+    for (auto& statement : body) {
+        switch (statement->type) {
+            case ASTNodeType::Function: if (!compileFunction(static_cast<FunctionNode*>(statement.get()))) return false; break;
+            case ASTNodeType::Declaration: if (!compileGlobal(static_cast<DeclarationNode*>(statement.get()))) return false; break;
+            case ASTNodeType::Namespace: if (!compileTopLevel(static_cast<NamespaceNode*>(statement.get())->body)) return false; break;
+            case ASTNodeType::Import: case ASTNodeType::Preprocessor: case ASTNodeType::Interface: case ASTNodeType::Decorator: break;
+            default: return giveUp();
+        }
+    }
+    return !failed;
+}
+
+bool BytecodeCompiler::compileFunction(FunctionNode* node) {
+    if (node->isIntrinsic || !node->body) return true;
+    for (const auto& decorator : node->decorators) {
+        auto* callee = decorator->callee.get();
+        std::string name = callee->type == ASTNodeType::Variable ? static_cast<VariableNode*>(callee)->varName : "";
+        if (name != "entry" && name != "comptime" && name != "unsafe") return giveUp();
+    }
+
+    const Type* type = node->inferredType;
+    if (!type || type->kind != Type::Kind::Function || type->paramCount() != node->parameters.size()) return giveUp();
+
+    current = functionIndex(node);
+    returnType = type->returnType()->isDynamic() && !returnsValue(node->body.get()) ? nullptr : type->returnType();
+    if (returnType && returnType->isVoid()) returnType = nullptr;
+    if (returnType && scalarOf(returnType) == Scalar::None) return giveUp();
+
+    scopes.assign(1, {});
+    loops.clear();
+    nextRegister = 0;
+    function().parameters = static_cast<uint16_t>(node->parameters.size());
+    for (size_t i = 0; i < node->parameters.size(); i++) {
+        if (scalarOf(type->param(i)) == Scalar::None) return giveUp();
+        scopes.back()[node->parameters[i]->parameterName] = Local{allocate(), type->param(i)};
+    }
+
+    for (auto& statement : node->body->statements)
+        if (!compileStatement(statement.get())) return false;
+
+    // Flow Analysis made sure a function returning a value can't get here
+    emit(Opcode::ReturnVoid, Scalar::None, 0, 0, 0, node);
+    scopes.clear();
+    return true;
+}
+
+bool BytecodeCompiler::compileGlobal(DeclarationNode* node) {
+    if (!node->value) return true;
+
+    // initializers run one after another in function 0, none of them has locals
+    current = 0;
+    returnType = nullptr;
+    scopes.assign(1, {});
+    loops.clear();
+    nextRegister = 0;
+
+    uint16_t value = allocate();
+    if (!compileExpression(node->value.get(), value) || !convert(value, node->value->inferredType, node->inferredType, node)) return false;
+    const BytecodeGlobal& global = program->globals[globalIndexes.at(node)];
+    emit(Opcode::StoreGlobal, global.scalar, value, globalIndexes.at(node), 0, node);
+    scopes.clear();
+    return true;
+}
+
+// ==== Helpers ====
+
+size_t BytecodeCompiler::emit(Opcode op, Scalar scalar, uint16_t a, uint32_t b, uint16_t c, ASTNode* site, uint16_t count) {
+    function().code.push_back(Instruction{op, scalar, a, b, c, count});
+    function().sites.push_back(site);
+    return function().code.size() - 1;
+}
+
+uint16_t BytecodeCompiler::allocate() {
+    if (nextRegister == UINT16_MAX) {
+        failed = true;
+        return 0;
+    }
+    uint16_t reg = nextRegister++;
+    function().registers = std::max(function().registers, nextRegister);
+    return reg;
+}
+
+uint32_t BytecodeCompiler::constant(Register value) {
+    program->constants.push_back(value);
+    return static_cast<uint32_t>(program->constants.size() - 1);
+}
+
+uint32_t BytecodeCompiler::functionIndex(FunctionNode* node) {
+    auto [it, inserted] = functionIndexes.try_emplace(node, static_cast<uint32_t>(program->functions.size()));
+    if (inserted) program->functions.emplace_back().source = node;
+    return it->second;
+}
+
+DeclarationNode* BytecodeCompiler::findGlobal(const std::string& name, const std::string& filePath) {
+    auto it = globalDeclarations.find(name);
+    if (it == globalDeclarations.end()) return nullptr;
+    for (DeclarationNode* declaration : it->second)
+        if (declaration->filePath == filePath) return declaration;
+    return it->second.front();
+}
+
+bool BytecodeCompiler::variable(const std::string& name, const std::string& filePath, Local& local, uint32_t& global) {
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+        auto it = scope->find(name);
+        if (it == scope->end()) continue;
+        local = it->second;
+        global = notGlobal;
+        return true;
+    }
+
+    DeclarationNode* declaration = findGlobal(name, filePath);
+    if (!declaration) return false;
+    local = Local{0, declaration->inferredType};
+    global = globalIndexes.at(declaration);
+    return true;
+}
+
+bool BytecodeCompiler::convert(uint16_t reg, const Type* from, const Type* to, ASTNode* site) {
+    if (!from || !to || from == to) return true;
+
+    // `number` takes every numeric type, the others are never converted implicitly. Numbers aren't interpreted.
+    if (to->isPrimitive(ResolvedType::Number)) return giveUp();
+    return true;
+}
+
+// ==== Statements ====
+
+bool BytecodeCompiler::compileStatement(ASTNode* node) {
+    if (node->type == ASTNodeType::Declaration) return compileDeclaration(static_cast<DeclarationNode*>(node));
+
+    // temporaries of a statement are free once it's done
+    uint16_t mark = nextRegister;
+    bool compiled = true;
+    switch (node->type) {
+        case ASTNodeType::Assignment: compiled = compileAssignment(static_cast<AssignmentNode*>(node)); break;
+        case ASTNodeType::Block: compiled = compileBlock(node); break;
+        case ASTNodeType::IfStatement: compiled = compileIf(static_cast<IfNode*>(node)); break;
+        case ASTNodeType::WhileLoop: compiled = compileWhile(static_cast<WhileLoopNode*>(node)); break;
+        case ASTNodeType::Switch: compiled = compileSwitch(static_cast<SwitchNode*>(node)); break;
+        case ASTNodeType::ReturnStatement: compiled = compileReturn(static_cast<ReturnStatementNode*>(node)); break;
+        case ASTNodeType::BreakStatement:
+            if (!loops.empty()) loops.back().breaks.push_back(emit(Opcode::Jump, Scalar::None, 0, 0, 0, node));
+            break;
+        case ASTNodeType::ContinueStatement:
+            if (!loops.empty()) emit(Opcode::Loop, Scalar::None, 0, loops.back().start, 0, node);
+            break;
+        case ASTNodeType::Import: break;
+        case ASTNodeType::ForLoop: case ASTNodeType::TryCatch: case ASTNodeType::ThrowStatement:
+        case ASTNodeType::Function: case ASTNodeType::Class:
+            return giveUp();
+        default: compiled = compileExpression(node, allocate()); break;
+    }
+    nextRegister = mark;
+    return compiled && !failed;
+}
+
+bool BytecodeCompiler::compileBlock(ASTNode* node) {
+    if (!node) return true;
+    if (node->type != ASTNodeType::Block) return compileStatement(node);
+
+    uint16_t mark = nextRegister;
+    scopes.emplace_back();
+    for (auto& statement : static_cast<BlockNode*>(node)->statements)
+        if (!compileStatement(statement.get())) return false;
+    scopes.pop_back();
+    nextRegister = mark;
+    return true;
+}
+
+bool BytecodeCompiler::compileDeclaration(DeclarationNode* node) {
+    const Type* type = node->inferredType;
+    if (scalarOf(type) == Scalar::None) return giveUp();
+
+    // the value comes first: in `x := x + 1` the right `x` is still the outer one
+    uint16_t reg = allocate();
+    if (node->value && (!compileExpression(node->value.get(), reg) || !convert(reg, node->value->inferredType, type, node))) return false;
+    nextRegister = reg + 1;
+    scopes.back()[node->variable->varName] = Local{reg, type};
+    return !failed;
+}
+
+bool BytecodeCompiler::compileAssignment(AssignmentNode* node) {
+    if (node->variable->type != ASTNodeType::Variable) return giveUp();
+
+    auto* variableNode = static_cast<VariableNode*>(node->variable.get());
+    Local local;
+    uint32_t global;
+    if (!variable(variableNode->varName, variableNode->filePath, local, global)) return giveUp();
+    Scalar scalar = scalarOf(local.type);
+    if (scalar == Scalar::None) return giveUp();
+
+    ASTNode* valueNode = node->value.get();
+    if (node->op == "=" && global == notGlobal && writesTargetLast(valueNode))
+        return compileExpression(valueNode, local.reg) && convert(local.reg, valueNode->inferredType, local.type, node);
+
+    uint16_t value = allocate();
+    if (!compileExpression(valueNode, value) || !convert(value, valueNode->inferredType, local.type, node)) return false;
+
+    // x += y is x = x + y
+    std::string op = node->op.substr(0, node->op.size() - 1);
+    if (global == notGlobal) {
+        if (node->op == "=") emit(Opcode::Move, scalar, local.reg, value, 0, node);
+        else if (!compileOperation(op, local.reg, local.reg, value, local.type, node)) return false;
+        return true;
+    }
+    if (node->op != "=") {
+        uint16_t currentValue = allocate();
+        emit(Opcode::LoadGlobal, scalar, currentValue, global, 0, node);
+        if (!compileOperation(op, value, currentValue, value, local.type, node)) return false;
+    }
+    emit(Opcode::StoreGlobal, scalar, value, global, 0, node);
+    return true;
+}
+
+bool BytecodeCompiler::compileIf(IfNode* node) {
+    uint16_t condition;
+    if (!operand(node->condition.get(), condition)) return false;
+    size_t toElse = emit(Opcode::JumpUnless, Scalar::Bool, condition, 0, 0, node);
+    if (!compileBlock(node->thenBlock.get())) return false;
+
+    // `else if` is an IfNode in place of the else block
+    if (!node->elseBlock) {
+        patch(toElse);
+        return true;
+    }
+    size_t toEnd = emit(Opcode::Jump, Scalar::None, 0, 0, 0, node);
+    patch(toElse);
+    if (!compileBlock(node->elseBlock.get())) return false;
+    patch(toEnd);
+    return true;
+}
+
+bool BytecodeCompiler::compileWhile(WhileLoopNode* node) {
+    uint32_t start = static_cast<uint32_t>(function().code.size());
+    uint16_t mark = nextRegister;
+    uint16_t condition;
+    if (!operand(node->condition.get(), condition)) return false;
+    size_t exit = emit(Opcode::JumpUnless, Scalar::Bool, condition, 0, 0, node);
+    nextRegister = mark;
+
+    loops.push_back(Loop{start, {}});
+    if (!compileBlock(node->body.get())) return false;
+    emit(Opcode::Loop, Scalar::None, 0, start, 0, node);
+
+    patch(exit);
+    for (size_t jump : loops.back().breaks) patch(jump);
+    loops.pop_back();
+    return true;
+}
+
+bool BytecodeCompiler::compileSwitch(SwitchNode* node) {
+    // the value gets its own register, a case body may change the variable it came from
+    const Type* type = node->expression->inferredType;
+    uint16_t value = allocate();
+    if (!compileExpression(node->expression.get(), value)) return false;
+
+    // a chain of comparisons, cases don't fall through
+    std::vector<size_t> ends;
+    for (const auto& caseNode : node->cases) {
+        uint16_t mark = nextRegister;
+        uint16_t candidate = allocate(), matches = allocate();
+        if (!compileExpression(caseNode->condition.get(), candidate) || !convert(candidate, caseNode->condition->inferredType, type, caseNode.get())) return false;
+        if (!compileOperation("==", matches, value, candidate, type, caseNode.get())) return false;
+        size_t next = emit(Opcode::JumpUnless, Scalar::Bool, matches, 0, 0, caseNode.get());
+        nextRegister = mark;
+
+        if (!compileBlock(caseNode->body.get())) return false;
+        ends.push_back(emit(Opcode::Jump, Scalar::None, 0, 0, 0, caseNode.get()));
+        patch(next);
+    }
+
+    if (node->defaultCase && !compileBlock(node->defaultCase->body.get())) return false;
+    for (size_t jump : ends) patch(jump);
+    return true;
+}
+
+bool BytecodeCompiler::compileReturn(ReturnStatementNode* node) {
+    ASTNode* expression = node->expression.get();
+    if (!expression || !returnType) {
+        if (expression && !compileExpression(expression, allocate())) return false;
+        emit(Opcode::ReturnVoid, Scalar::None, 0, 0, 0, node);
+        return true;
+    }
+
+    uint16_t value;
+    if (expression->inferredType == returnType) {
+        if (!operand(expression, value)) return false;
+    } else {
+        value = allocate();
+        if (!compileExpression(expression, value) || !convert(value, expression->inferredType, returnType, node)) return false;
+    }
+    emit(Opcode::Return, scalarOf(returnType), value, 0, 0, node);
+    return true;
+}
+
+// ==== Expressions ====
+
+bool BytecodeCompiler::compileExpression(ASTNode* node, uint16_t target) {
+    if (!node) return giveUp();
+
+    switch (node->type) {
+        case ASTNodeType::Literal: return compileLiteral(static_cast<LiteralNode*>(node), target);
+        case ASTNodeType::Variable: {
+            auto* variableNode = static_cast<VariableNode*>(node);
+            Local local;
+            uint32_t global;
+            if (!variable(variableNode->varName, variableNode->filePath, local, global)) return giveUp(); // a function as a value
+            Scalar scalar = scalarOf(local.type);
+            if (scalar == Scalar::None) return giveUp();
+
+            if (global != notGlobal) emit(Opcode::LoadGlobal, scalar, target, global, 0, node);
+            else if (local.reg != target) emit(Opcode::Move, scalar, target, local.reg, 0, node);
+            return true;
+        }
+        case ASTNodeType::BinaryOperation: return compileBinary(static_cast<BinaryOperationNode*>(node), target);
+        case ASTNodeType::UnaryOperation: {
+            auto* unary = static_cast<UnaryOperationNode*>(node);
+            Scalar scalar = scalarOf(unary->operand->inferredType);
+            uint16_t value;
+            if (!operand(unary->operand.get(), value)) return false;
+
+            const std::string& op = unary->value;
+            if (op == "-" && scalar != Scalar::None && scalar != Scalar::Bool && scalar != Scalar::Str)
+                emit(Opcode::Negate, scalar, target, value, 0, node);
+            else if ((op == "~" || op == "!" || op == "not") && scalar != Scalar::None && scalar != Scalar::Str && scalar != Scalar::Float && scalar != Scalar::Double)
+                emit(Opcode::Not, scalar, target, value, 0, node);
+            else return giveUp();
+            return true;
+        }
+        case ASTNodeType::CallExpression: return compileCall(static_cast<CallExpressionNode*>(node), target);
+        case ASTNodeType::MemberAccess: {
+            // only namespace calls, like the IR Generator
+            ASTNode* last = node;
+            while (last && last->type == ASTNodeType::MemberAccess) last = static_cast<MemberAccessNode*>(last)->val.get();
+            if (last && last->type == ASTNodeType::CallExpression && static_cast<CallExpressionNode*>(last)->resolvedFunction)
+                return compileCall(static_cast<CallExpressionNode*>(last), target);
+            return giveUp();
+        }
+        default: return giveUp();
+    }
+}
+
+bool BytecodeCompiler::operand(ASTNode* node, uint16_t& reg) {
+    if (node && node->type == ASTNodeType::Variable) {
+        auto* variableNode = static_cast<VariableNode*>(node);
+        Local local;
+        uint32_t global;
+        if (variable(variableNode->varName, variableNode->filePath, local, global) && global == notGlobal) {
+            reg = local.reg;
+            return scalarOf(local.type) != Scalar::None || giveUp();
+        }
+    }
+    reg = allocate();
+    return compileExpression(node, reg);
+}
+
+bool BytecodeCompiler::compileLiteral(LiteralNode* node, uint16_t target) {
+    Scalar scalar = scalarOf(node->inferredType);
+    Register value{};
+
+    switch (node->literalType) {
+        case ASTLiteralType::Integer:
+        case ASTLiteralType::Float: {
+            // a literal takes the type it's used as, `x: float = 5` included
+            const std::string& text = node->value;
+            if (scalar == Scalar::Float) value.f = std::strtof(text.c_str(), nullptr);
+            else if (scalar == Scalar::Double) value.f = std::strtod(text.c_str(), nullptr);
+            else if (scalar == Scalar::Bool || scalar == Scalar::Str || scalar == Scalar::None) return giveUp();
+            else {
+                bool isSigned = scalar == Scalar::Int8 || scalar == Scalar::Int16 || scalar == Scalar::Int32 || scalar == Scalar::Int64;
+                auto parsed = isSigned ? std::from_chars(text.data(), text.data() + text.size(), value.i) : std::from_chars(text.data(), text.data() + text.size(), value.u);
+                if (parsed.ec != std::errc() || parsed.ptr != text.data() + text.size()) return giveUp();
+            }
+            break;
+        }
+        case ASTLiteralType::Bool:
+            scalar = Scalar::Bool;
+            value.u = node->value == "true";
+            break;
+        case ASTLiteralType::String:
+            if (isInterpolation(node)) return compileInterpolation(node, target);
+            scalar = Scalar::Str;
+            value.s = program->strings.emplace_back(node->value).c_str();
+            break;
+        case ASTLiteralType::Null: return giveUp();
+    }
+    emit(Opcode::Constant, scalar, target, constant(value), 0, node);
+    return true;
+}
+
+bool BytecodeCompiler::compileInterpolation(LiteralNode* node, uint16_t target) {
+    // "a ${b} c" is put together piece by piece, every value formatted like snprintf does it in native code
+    bool empty = true;
+    auto append = [&](uint16_t piece) {
+        if (empty) emit(Opcode::Move, Scalar::Str, target, piece, 0, node);
+        else emit(Opcode::Concat, Scalar::Str, target, target, piece, node);
+        empty = false;
+    };
+    auto literal = [&](const std::string& text) {
+        Register value{};
+        value.s = program->strings.emplace_back(text).c_str();
+        uint16_t piece = allocate();
+        emit(Opcode::Constant, Scalar::Str, piece, constant(value), 0, node);
+        return piece;
+    };
+
+    for (size_t i = 0; i < node->interpolations.size(); i++) {
+        if (!node->pieces[i].empty()) append(literal(node->pieces[i]));
+
+        ASTNode* interpolation = node->interpolations[i].get();
+        Scalar scalar = scalarOf(interpolation->inferredType);
+        uint16_t value;
+        if (scalar == Scalar::None || !operand(interpolation, value)) return giveUp();
+        uint16_t formatted = allocate();
+        emit(Opcode::ToText, scalar, formatted, value, 0, interpolation);
+        append(formatted);
+    }
+    if (!node->pieces.back().empty()) append(literal(node->pieces.back()));
+    if (empty) append(literal(""));
+    return true;
+}
+
+bool BytecodeCompiler::compileBinary(BinaryOperationNode* node, uint16_t target) {
+    // the right operand only runs when the left one doesn't decide
+    if (isLogical(node->value)) {
+        bool isAnd = node->value == "&&" || node->value == "and";
+        if (!compileExpression(node->leftOperand.get(), target)) return false;
+        size_t skip = emit(isAnd ? Opcode::JumpUnless : Opcode::JumpIf, Scalar::Bool, target, 0, 0, node);
+        if (!compileExpression(node->rightOperand.get(), target)) return false;
+        patch(skip);
+        return true;
+    }
+
+    uint16_t left, right;
+    if (!operand(node->leftOperand.get(), left) || !operand(node->rightOperand.get(), right)) return false;
+
+    // operands are of one type, comparisons only differ in their result
+    const Type* type = node->leftOperand->inferredType;
+    if (!type || type->isDynamic() || scalarOf(type) != scalarOf(node->rightOperand->inferredType)) return giveUp();
+    return compileOperation(node->value, target, left, right, type, node);
+}
+
+bool BytecodeCompiler::compileOperation(const std::string& op, uint16_t target, uint16_t left, uint16_t right, const Type* type, ASTNode* site) {
+    static const std::unordered_map<std::string, Opcode> comparisons = {
+        {"==", Opcode::Equal}, {"!=", Opcode::NotEqual}, {"<", Opcode::Less}, {"<=", Opcode::LessEqual}, {">", Opcode::Greater}, {">=", Opcode::GreaterEqual},
+    };
+    static const std::unordered_map<std::string, Opcode> arithmetic = {
+        {"+", Opcode::Add}, {"-", Opcode::Subtract}, {"*", Opcode::Multiply}, {"/", Opcode::Divide}, {"%", Opcode::Remainder}, {"^", Opcode::Power},
+        {"&", Opcode::BitAnd}, {"|", Opcode::BitOr}, {"^^", Opcode::BitXor}, {"<<", Opcode::ShiftLeft}, {">>", Opcode::ShiftRight},
+    };
+
+    Scalar scalar = scalarOf(type);
+    if (scalar == Scalar::None) return giveUp();
+    if (isComparison(op)) {
+        emit(comparisons.at(op), scalar, target, left, right, site);
+        return true;
+    }
+    if (scalar == Scalar::Str && op == "+") {
+        emit(Opcode::Concat, scalar, target, left, right, site);
+        return true;
+    }
+
+    auto it = arithmetic.find(op);
+    if (it == arithmetic.end() || scalar == Scalar::Str || scalar == Scalar::Bool) return giveUp();
+    bool real = scalar == Scalar::Float || scalar == Scalar::Double;
+    if (real && it->second >= Opcode::BitAnd && it->second <= Opcode::ShiftRight) return giveUp();
+    emit(it->second, scalar, target, left, right, site);
+    return true;
+}
+
+bool BytecodeCompiler::compileCall(CallExpressionNode* node, uint16_t target) {
+    FunctionNode* callee = node->resolvedFunction;
+    if (!callee) return giveUp(); // calls of values and constructors
+
+    // arguments go to consecutive registers, missing ones are the defaults of the parameters
+    size_t count = std::max(node->arguments.size(), callee->parameters.size());
+    if (count >= UINT16_MAX) return giveUp();
+    uint16_t arguments = nextRegister;
+    for (size_t i = 0; i < count; i++) allocate();
+
+    for (size_t i = 0; i < count; i++) {
+        ASTNode* argument = i < node->arguments.size() ? node->arguments[i].get() : callee->parameters[i]->defaultValue.get();
+        if (!argument || !compileExpression(argument, static_cast<uint16_t>(arguments + i))) return giveUp();
+        if (!callee->isIntrinsic && callee->inferredType && i < callee->inferredType->paramCount()
+            && !convert(static_cast<uint16_t>(arguments + i), argument->inferredType, callee->inferredType->param(i), argument)) return false;
+    }
+
+    if (callee->isIntrinsic) return compileIntrinsicCall(node, callee, target, arguments, static_cast<uint16_t>(count));
+    emit(Opcode::Call, Scalar::None, target, functionIndex(callee), arguments, node, static_cast<uint16_t>(count));
+    return true;
+}
+
+bool BytecodeCompiler::compileIntrinsicCall(CallExpressionNode* node, FunctionNode* callee, uint16_t target, uint16_t arguments, uint16_t count) {
+    // intrinsics are told apart by the std namespace they're declared in, not by the file that happens to hold it
+    const std::string& library = callee->namespaceName;
+    const std::string& name = callee->name;
+    Scalar scalar = node->arguments.empty() ? Scalar::None : scalarOf(node->arguments[0]->inferredType);
+    auto call = [&](Intrinsic intrinsic) {
+        emit(Opcode::Intrinsic, scalar, target, static_cast<uint32_t>(intrinsic), arguments, node, count);
+        return true;
+    };
+
+    if (library == "std.io") {
+        if (count > 0 && scalar == Scalar::None) return giveUp();
+        if (name == "print") return call(Intrinsic::Print);
+        if (name == "println") return call(Intrinsic::Println);
+        if (name == "eprint") return call(Intrinsic::EPrint);
+        if (name == "eprintln") return call(Intrinsic::EPrintln);
+        if (name == "input" || name == "readLine") return call(Intrinsic::Input);
+    }
+
+    if (library == "std.math" && count > 0 && scalar != Scalar::None && scalar != Scalar::Bool && scalar != Scalar::Str) {
+        if (name == "abs") return call(Intrinsic::Abs);
+        if (name == "min" && count == 2) return call(Intrinsic::Min);
+        if (name == "max" && count == 2) return call(Intrinsic::Max);
+        if (name == "clamp" && count == 3) return call(Intrinsic::Clamp);
+        if (scalar == Scalar::Float || scalar == Scalar::Double) {
+            if (name == "sqrt") return call(Intrinsic::Sqrt);
+            if (name == "floor") return call(Intrinsic::Floor);
+            if (name == "ceil") return call(Intrinsic::Ceil);
+            if (name == "round") return call(Intrinsic::Round);
+            if (name == "sin") return call(Intrinsic::Sin);
+            if (name == "cos") return call(Intrinsic::Cos);
+            if (name == "tan") return call(Intrinsic::Tan);
+            if (name == "pow" && count == 2) return call(Intrinsic::Pow);
+        }
+    }
+    return giveUp();
+}
@@ -0,0 +1,175 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Core/Frontend/Nodes.hpp"
+
+struct Type;
+
+/* Bytecode is the first tier of `neoluma run`: a register-based form of the analyzed AST that the Interpreter runs
+ * without generating any machine code, so a script starts as soon as the Frontend is done with it.
+ *
+ * A function is a flat array of fixed-size instructions over a frame of registers. Parameters take the first
+ * registers, locals get one each for as long as their scope lives, and temporaries are reused after every statement.
+ * Jumps go to instruction indexes, `Loop` is a jump backwards that counts towards promotion to the JIT.
+ */
+
+// Machine type of a register, typed instructions say which one they work on
+enum class Scalar : uint8_t { None, Int8, Int16, Int32, Int64, UInt8, UInt16, UInt32, UInt64, Float, Double, Bool, Str };
+
+// Every value takes one register. Integers are kept extended from their width (signed ones with their sign),
+// `float` is a double rounded to float, `str` points to a null-terminated string like in native code.
+union Register {
+    int64_t i;
+    uint64_t u;
+    double f;
+    const char* s;
+};
+static_assert(sizeof(Register) == 8, "bridges to native code read registers as 8-byte slots");
+
+enum class Opcode : uint8_t {
+    Constant,       // A = constants[B]
+    Move,           // A = B
+    LoadGlobal,     // A = globals[B]
+    StoreGlobal,    // globals[B] = A
+
+    // A = B op C, operands of `scalar`
+    Add, Subtract, Multiply, Divide, Remainder, Power,
+    BitAnd, BitOr, BitXor, ShiftLeft, ShiftRight,
+    Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual,
+    Concat,         // strings
+
+    // A = op B
+    Negate, Not,
+    ToText,         // B of `scalar` formatted like print() does
+
+    Jump,           // goto B
+    JumpIf,         // if A: goto B
+    JumpUnless,     // if not A: goto B
+    Loop,           // goto B, backwards
+
+    Call,           // A = functions[B](C .. C+count-1)
+    Intrinsic,      // A = Intrinsic(B)(C .. C+count-1), arguments of `scalar`
+    Return,         // returns A
+    ReturnVoid,
+};
+
+// Parts of std that are built into the interpreter, the same ones the IR Generator lowers
+enum class Intrinsic : uint8_t {
+    Print, Println, EPrint, EPrintln, Input,
+    Abs, Min, Max, Clamp, Sqrt, Pow, Floor, Ceil, Round, Sin, Cos, Tan,
+};
+
+struct Instruction {
+    Opcode op;
+    Scalar scalar = Scalar::None;
+    uint16_t a = 0; // destination, or the register that is tested, stored or returned
+    uint32_t b = 0; // a register, constant, global, function, intrinsic or jump target
+    uint16_t c = 0; // second operand, or the first argument of a call
+    uint16_t count = 0; // arguments of a call
+};
+
+// Native entry of a promoted function: arguments and result are registers, see IRGenerator::generateBridge()
+using NativeBridge = void (*)(Register* arguments, Register* result);
+
+struct BytecodeFunction {
+    FunctionNode* source = nullptr; // nullptr for the global initializers
+    uint16_t parameters = 0;
+    uint16_t registers = 0; // size of a frame
+    std::vector<Instruction> code;
+    std::vector<ASTNode*> sites; // node of every instruction, runtime errors point at it
+
+    // Tiering: calls and loop iterations so far, and where calls go once the function is promoted
+    uint64_t calls = 0, backedges = 0;
+    NativeBridge native = nullptr;
+    bool promotable = true; // false once the JIT was asked, whatever it answered
+};
+
+struct BytecodeGlobal {
+    DeclarationNode* declaration;
+    Scalar scalar;
+};
+
+struct BytecodeProgram {
+    std::vector<BytecodeFunction> functions; // [0] runs the global initializers, in module order
+    std::vector<BytecodeGlobal> globals;
+    std::vector<Register> constants;
+    std::deque<std::string> strings; // text of string constants, their registers point in here
+    uint32_t entry = 0;
+    Scalar entryResult = Scalar::None; // an integer result is the exit code
+};
+
+/* BytecodeCompiler lowers modules that went through the whole Frontend into Bytecode. It takes the same subset of the
+ * language the IR Generator does, with the same conversions, so both tiers compute the same thing.
+ * It gives up on anything else, and on values that don't fit a register (128-bit integers). Nothing is reported then:
+ * the program runs on the JIT alone, which reports what it can't compile either.
+ */
+struct BytecodeCompiler {
+    // False if the program can't be interpreted
+    bool compile(const std::vector<ModuleNode*>& modules, FunctionNode* entry, BytecodeProgram& program);
+
+    static Scalar scalarOf(const Type* type); // Scalar::None if registers can't hold it
+
+private:
+    struct Local {
+        uint16_t reg;
+        const Type* type;
+    };
+    struct Loop {
+        uint32_t start; // `continue` goes here
+        std::vector<size_t> breaks; // jumps to patch with the end
+    };
+
+    BytecodeProgram* program = nullptr;
+    bool failed = false;
+
+    std::unordered_map<std::string, std::vector<DeclarationNode*>> globalDeclarations; // by name, like IRGenerator::globals
+    std::unordered_map<const DeclarationNode*, uint32_t> globalIndexes;
+    std::unordered_map<const FunctionNode*, uint32_t> functionIndexes;
+
+    // Function being compiled
+    uint32_t current = 0;
+    const Type* returnType = nullptr; // nullptr for void
+    std::vector<std::unordered_map<std::string, Local>> scopes;
+    std::vector<Loop> loops;
+    uint16_t nextRegister = 0;
+
+    // Helper functions
+    bool giveUp() { failed = true; return false; }
+    BytecodeFunction& function() { return program->functions[current]; }
+    size_t emit(Opcode op, Scalar scalar, uint16_t a, uint32_t b, uint16_t c, ASTNode* site, uint16_t count = 0);
+    void patch(size_t jump) { function().code[jump].b = static_cast<uint32_t>(function().code.size()); }
+    uint16_t allocate();
+    uint32_t constant(Register value);
+    uint32_t functionIndex(FunctionNode* function);
+    DeclarationNode* findGlobal(const std::string& name, const std::string& filePath);
+    bool variable(const std::string& name, const std::string& filePath, Local& local, uint32_t& global); // false if it's neither
+    bool convert(uint16_t reg, const Type* from, const Type* to, ASTNode* site); // implicit conversions the Frontend allows
+
+    // Compilers
+    void declareTopLevel(std::vector<MemoryPtr<ASTNode>>& body);
+    bool compileTopLevel(std::vector<MemoryPtr<ASTNode>>& body);
+    bool compileFunction(FunctionNode* node);
+    bool compileGlobal(DeclarationNode* node);
+
+    bool compileStatement(ASTNode* node);
+    bool compileBlock(ASTNode* node);
+    bool compileDeclaration(DeclarationNode* node);
+    bool compileAssignment(AssignmentNode* node);
+    bool compileIf(IfNode* node);
+    bool compileWhile(WhileLoopNode* node);
+    bool compileSwitch(SwitchNode* node);
+    bool compileReturn(ReturnStatementNode* node);
+
+    bool compileExpression(ASTNode* node, uint16_t target);
+    bool operand(ASTNode* node, uint16_t& reg); // a local's own register, or a temporary holding the value
+    bool compileLiteral(LiteralNode* node, uint16_t target);
+    bool compileInterpolation(LiteralNode* node, uint16_t target);
+    bool compileBinary(BinaryOperationNode* node, uint16_t target);
+    bool compileOperation(const std::string& op, uint16_t target, uint16_t left, uint16_t right, const Type* type, ASTNode* site);
+    bool compileCall(CallExpressionNode* node, uint16_t target);
+    bool compileIntrinsicCall(CallExpressionNode* node, FunctionNode* callee, uint16_t target, uint16_t arguments, uint16_t count);
+};
@@ -0,0 +1,451 @@
+#include "Interpreter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+
+// ==== Values ====
+
+static bool isSigned(Scalar scalar) { return scalar == Scalar::Int8 || scalar == Scalar::Int16 || scalar == Scalar::Int32 || scalar == Scalar::Int64; }
+
+static bool isReal(Scalar scalar) { return scalar == Scalar::Float || scalar == Scalar::Double; }
+
+static unsigned widthOf(Scalar scalar) {
+    switch (scalar) {
+        case Scalar::Int8: case Scalar::UInt8: case Scalar::Bool: return 8;
+        case Scalar::Int16: case Scalar::UInt16: return 16;
+        case Scalar::Int32: case Scalar::UInt32: case Scalar::Float: return 32;
+        default: return 64;
+    }
+}
+
+// Brings a result back to its type, the way the machine would have wrapped or rounded it
+static Register normalize(Register value, Scalar scalar) {
+    switch (scalar) {
+        case Scalar::Int8: value.i = static_cast<int8_t>(value.u); break;
+        case Scalar::Int16: value.i = static_cast<int16_t>(value.u); break;
+        case Scalar::Int32: value.i = static_cast<int32_t>(value.u); break;
+        case Scalar::UInt8: value.u = static_cast<uint8_t>(value.u); break;
+        case Scalar::UInt16: value.u = static_cast<uint16_t>(value.u); break;
+        case Scalar::UInt32: value.u = static_cast<uint32_t>(value.u); break;
+        case Scalar::Float: value.f = static_cast<float>(value.f); break;
+        case Scalar::Bool: value.u &= 1; break;
+        default: break;
+    }
+    return value;
+}
+
+// The bits of an integer read as signed, std.math works on them like that in native code
+static int64_t signedValue(Register value, Scalar scalar) {
+    switch (scalar) {
+        case Scalar::UInt8: return static_cast<int8_t>(value.u);
+        case Scalar::UInt16: return static_cast<int16_t>(value.u);
+        case Scalar::UInt32: return static_cast<int32_t>(value.u);
+        default: return value.i;
+    }
+}
+
+// snprintf of a value with the conversion native code formats it with
+static int formatValue(char* buffer, size_t size, Register value, Scalar scalar) {
+    switch (scalar) {
+        case Scalar::Str: return std::snprintf(buffer, size, "%s", value.s);
+        case Scalar::Bool: return std::snprintf(buffer, size, "%s", value.u ? "true" : "false");
+        case Scalar::Int8: case Scalar::Int16: case Scalar::Int32: return std::snprintf(buffer, size, "%d", static_cast<int>(value.i));
+        case Scalar::UInt8: case Scalar::UInt16: case Scalar::UInt32: return std::snprintf(buffer, size, "%u", static_cast<unsigned>(value.u));
+        case Scalar::Int64: return std::snprintf(buffer, size, "%lld", static_cast<long long>(value.i));
+        case Scalar::UInt64: return std::snprintf(buffer, size, "%llu", static_cast<unsigned long long>(value.u));
+        case Scalar::Float: return std::snprintf(buffer, size, "%g", value.f);
+        case Scalar::Double: return std::snprintf(buffer, size, "%.15g", value.f);
+        default: return std::snprintf(buffer, size, "%s", "");
+    }
+}
+
+// A fresh buffer, like the strings native code builds. Nothing frees them yet.
+static char* toText(Register value, Scalar scalar) {
+    int length = formatValue(nullptr, 0, value, scalar);
+    char* buffer = static_cast<char*>(std::malloc(length + 1));
+    formatValue(buffer, length + 1, value, scalar);
+    return buffer;
+}
+
+static char* concat(const char* left, const char* right) {
+    size_t leftLength = std::strlen(left), rightSize = std::strlen(right) + 1;
+    char* buffer = static_cast<char*>(std::malloc(leftLength + rightSize));
+    std::memcpy(buffer, left, leftLength);
+    std::memcpy(buffer + leftLength, right, rightSize);
+    return buffer;
+}
+
+// stdin up to a newline, into a buffer that doubles when it's full
+static char* readLine() {
+    size_t capacity = 64, length = 0;
+    char* buffer = static_cast<char*>(std::malloc(capacity));
+    for (int character = std::fgetc(stdin); character != EOF && character != '\n'; character = std::fgetc(stdin)) {
+        if (length + 1 == capacity) buffer = static_cast<char*>(std::realloc(buffer, capacity *= 2));
+        buffer[length++] = static_cast<char>(character);
+    }
+    buffer[length] = '\0';
+    return buffer;
+}
+
+// ==== Operations ====
+
+// False for a division by zero
+static bool integerOperation(Opcode op, Scalar scalar, Register left, Register right, Register& result) {
+    bool sign = isSigned(scalar);
+    switch (op) {
+        case Opcode::Add: result.u = left.u + right.u; break;
+        case Opcode::Subtract: result.u = left.u - right.u; break;
+        case Opcode::Multiply: result.u = left.u * right.u; break;
+        case Opcode::Divide:
+            if (right.u == 0) return false;
+            if (!sign) result.u = left.u / right.u;
+            else result.i = right.i == -1 ? static_cast<int64_t>(0 - left.u) : left.i / right.i;
+            break;
+        case Opcode::Remainder:
+            if (right.u == 0) return false;
+            if (!sign) result.u = left.u % right.u;
+            else result.i = right.i == -1 ? 0 : left.i % right.i;
+            break;
+        case Opcode::Power: {
+            // exponentiation by squaring; a negative exponent gives 1, like an empty product
+            Register base = left, exponent = right;
+            result.u = 1;
+            while (sign ? exponent.i > 0 : exponent.u != 0) {
+                if (exponent.u & 1) result.u *= base.u;
+                base.u *= base.u;
+                exponent.u >>= 1;
+            }
+            break;
+        }
+        case Opcode::BitAnd: result.u = left.u & right.u; break;
+        case Opcode::BitOr: result.u = left.u | right.u; break;
+        case Opcode::BitXor: result.u = left.u ^ right.u; break;
+
+        // native code leaves shifts past the width undefined, here they wrap around it
+        case Opcode::ShiftLeft: result.u = left.u << (right.u & (widthOf(scalar) - 1)); break;
+        case Opcode::ShiftRight:
+            if (sign) result.i = left.i >> (right.u & (widthOf(scalar) - 1));
+            else result.u = left.u >> (right.u & (widthOf(scalar) - 1));
+            break;
+        default: break;
+    }
+    result = normalize(result, scalar);
+    return true;
+}
+
+// Float is computed in double and rounded back, which gives the same result for everything IEEE rounds exactly
+static Register realOperation(Opcode op, Scalar scalar, Register left, Register right) {
+    Register result{};
+    switch (op) {
+        case Opcode::Add: result.f = left.f + right.f; break;
+        case Opcode::Subtract: result.f = left.f - right.f; break;
+        case Opcode::Multiply: result.f = left.f * right.f; break;
+        case Opcode::Divide: result.f = left.f / right.f; break;
+        case Opcode::Remainder: result.f = std::fmod(left.f, right.f); break;
+        case Opcode::Power:
+            result.f = scalar == Scalar::Float ? std::pow(static_cast<float>(left.f), static_cast<float>(right.f)) : std::pow(left.f, right.f);
+            break;
+        default: break;
+    }
+    return normalize(result, scalar);
+}
+
+static bool compare(Opcode op, Scalar scalar, Register left, Register right) {
+    // NaN is unordered: only != holds for it
+    if (isReal(scalar)) {
+        switch (op) {
+            case Opcode::Equal: return left.f == right.f;
+            case Opcode::NotEqual: return left.f != right.f;
+            case Opcode::Less: return left.f < right.f;
+            case Opcode::LessEqual: return left.f <= right.f;
+            case Opcode::Greater: return left.f > right.f;
+            default: return left.f >= right.f;
+        }
+    }
+
+    int order;
+    if (scalar == Scalar::Str) order = std::strcmp(left.s, right.s);
+    else if (isSigned(scalar)) order = (left.i > right.i) - (left.i < right.i);
+    else order = (left.u > right.u) - (left.u < right.u);
+    switch (op) {
+        case Opcode::Equal: return order == 0;
+        case Opcode::NotEqual: return order != 0;
+        case Opcode::Less: return order < 0;
+        case Opcode::LessEqual: return order <= 0;
+        case Opcode::Greater: return order > 0;
+        default: return order >= 0;
+    }
+}
+
+static Register intrinsic(Intrinsic which, Scalar scalar, const Register* arguments, uint16_t count) {
+    Register result{};
+    bool real = isReal(scalar);
+    auto minimum = [&](Register left, Register right) {
+        if (real) return Register{.f = std::fmin(left.f, right.f)};
+        return signedValue(left, scalar) <= signedValue(right, scalar) ? left : right;
+    };
+    auto maximum = [&](Register left, Register right) {
+        if (real) return Register{.f = std::fmax(left.f, right.f)};
+        return signedValue(left, scalar) >= signedValue(right, scalar) ? left : right;
+    };
+    // float functions for float, like the LLVM intrinsics native code calls
+    auto math = [&](auto operation) {
+        result.f = scalar == Scalar::Float ? static_cast<double>(operation(static_cast<float>(arguments[0].f))) : operation(arguments[0].f);
+        return result;
+    };
+
+    switch (which) {
+        case Intrinsic::Print: case Intrinsic::Println: case Intrinsic::EPrint: case Intrinsic::EPrintln: {
+            FILE* stream = which == Intrinsic::EPrint || which == Intrinsic::EPrintln ? stderr : stdout;
+            if (count > 0) {
+                char* text = toText(arguments[0], scalar);
+                std::fputs(text, stream);
+                std::free(text);
+            }
+            if (which == Intrinsic::Println || which == Intrinsic::EPrintln) std::fputc('\n', stream);
+            return result;
+        }
+        case Intrinsic::Input:
+            if (count > 0) {
+                std::printf("%s", arguments[0].s);
+                std::fflush(nullptr);
+            }
+            result.s = readLine();
+            return result;
+
+        case Intrinsic::Abs: {
+            if (real) return Register{.f = std::fabs(arguments[0].f)};
+            int64_t value = signedValue(arguments[0], scalar);
+            result.u = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+            return normalize(result, scalar);
+        }
+        case Intrinsic::Min: return minimum(arguments[0], arguments[1]);
+        case Intrinsic::Max: return maximum(arguments[0], arguments[1]);
+        case Intrinsic::Clamp: return minimum(maximum(arguments[0], arguments[1]), maximum(arguments[1], arguments[2]));
+
+        case Intrinsic::Sqrt: return math([](auto x) { return std::sqrt(x); });
+        case Intrinsic::Floor: return math([](auto x) { return std::floor(x); });
+        case Intrinsic::Ceil: return math([](auto x) { return std::ceil(x); });
+        case Intrinsic::Round: return math([](auto x) { return std::round(x); });
+        case Intrinsic::Sin: return math([](auto x) { return std::sin(x); });
+        case Intrinsic::Cos: return math([](auto x) { return std::cos(x); });
+        case Intrinsic::Tan: return math([](auto x) { return std::tan(x); });
+        case Intrinsic::Pow: return realOperation(Opcode::Power, scalar, arguments[0], arguments[1]);
+    }
+    return result;
+}
+
+// ==== Globals ====
+
+template <typename T> static T read(const void* address) {
+    T value;
+    std::memcpy(&value, address, sizeof(T));
+    return value;
+}
+
+template <typename T> static void write(void* address, T value) { std::memcpy(address, &value, sizeof(T)); }
+
+static Register readValue(const void* address, Scalar scalar) {
+    Register value{};
+    switch (scalar) {
+        case Scalar::Int8: value.i = read<int8_t>(address); break;
+        case Scalar::Int16: value.i = read<int16_t>(address); break;
+        case Scalar::Int32: value.i = read<int32_t>(address); break;
+        case Scalar::Int64: value.i = read<int64_t>(address); break;
+        case Scalar::UInt8: case Scalar::Bool: value.u = read<uint8_t>(address); break;
+        case Scalar::UInt16: value.u = read<uint16_t>(address); break;
+        case Scalar::UInt32: value.u = read<uint32_t>(address); break;
+        case Scalar::UInt64: value.u = read<uint64_t>(address); break;
+        case Scalar::Float: value.f = read<float>(address); break;
+        case Scalar::Double: value.f = read<double>(address); break;
+        case Scalar::Str: value.s = read<const char*>(address); break;
+        case Scalar::None: break;
+    }
+    return value;
+}
+
+static void writeValue(void* address, Scalar scalar, Register value) {
+    switch (scalar) {
+        case Scalar::Int8: case Scalar::UInt8: case Scalar::Bool: write(address, static_cast<uint8_t>(value.u)); break;
+        case Scalar::Int16: case Scalar::UInt16: write(address, static_cast<uint16_t>(value.u)); break;
+        case Scalar::Int32: case Scalar::UInt32: write(address, static_cast<uint32_t>(value.u)); break;
+        case Scalar::Int64: case Scalar::UInt64: write(address, value.u); break;
+        case Scalar::Float: write(address, static_cast<float>(value.f)); break;
+        case Scalar::Double: write(address, value.f); break;
+        case Scalar::Str: write(address, value.s); break;
+        case Scalar::None: break;
+    }
+}
+
+Register Interpreter::load(uint32_t global) const { return readValue(globalAddresses[global], program->globals[global].scalar); }
+
+void Interpreter::store(uint32_t global, Register value) { writeValue(globalAddresses[global], program->globals[global].scalar, value); }
+
+bool Interpreter::relocateGlobals() {
+    if (!locateNative) return false;
+
+    std::vector<void*> addresses(program->globals.size());
+    for (size_t i = 0; i < addresses.size(); i++)
+        if (!(addresses[i] = locateNative(program->globals[i].declaration))) return false;
+
+    // constants folded into read-only memory already hold the same value, only the others are written
+    for (size_t i = 0; i < addresses.size(); i++) {
+        Scalar scalar = program->globals[i].scalar;
+        Register value = readValue(globalAddresses[i], scalar), native = readValue(addresses[i], scalar);
+        bool same = scalar == Scalar::Str
+            ? value.s == native.s || (value.s && native.s && std::strcmp(value.s, native.s) == 0)
+            : value.u == native.u;
+        if (!same) writeValue(addresses[i], scalar, value);
+    }
+    globalAddresses = std::move(addresses);
+    return true;
+}
+
+// ==== Running ====
+
+std::optional<int> Interpreter::run(BytecodeProgram& bytecode) {
+    program = &bytecode;
+    globalStorage.assign(program->globals.size(), 0);
+    globalAddresses.resize(program->globals.size());
+    for (size_t i = 0; i < globalStorage.size(); i++) globalAddresses[i] = &globalStorage[i];
+    program->functions[0].promotable = false;
+    nativeTier = true;
+    relocated = false;
+
+    // the program shares stdout with the compiler, whatever the compiler printed goes first
+    std::fflush(nullptr);
+    Register result{};
+    bool finished = execute(0, result) && execute(program->entry, result);
+    std::fflush(nullptr);
+    if (!finished) return std::nullopt;
+
+    // an integer result is the exit code
+    Scalar scalar = program->entryResult;
+    if (isSigned(scalar)) return static_cast<int32_t>(result.i);
+    if (scalar == Scalar::UInt8 || scalar == Scalar::UInt16 || scalar == Scalar::UInt32 || scalar == Scalar::UInt64) return static_cast<int32_t>(static_cast<uint32_t>(result.u));
+    return 0;
+}
+
+bool Interpreter::execute(uint32_t entry, Register& result) {
+    BytecodeFunction* function = &program->functions[entry];
+    registers.assign(function->registers, Register{});
+    frames.assign(1, Frame{entry, 0, 0, 0});
+
+    const Instruction* code = function->code.data();
+    Register* r = registers.data();
+    uint32_t pc = 0;
+
+    while (true) {
+        const Instruction& in = code[pc++];
+        switch (in.op) {
+            case Opcode::Constant: r[in.a] = program->constants[in.b]; break;
+            case Opcode::Move: r[in.a] = r[in.b]; break;
+            case Opcode::LoadGlobal: r[in.a] = load(in.b); break;
+            case Opcode::StoreGlobal: store(in.b, r[in.a]); break;
+
+            case Opcode::Add: case Opcode::Subtract: case Opcode::Multiply: case Opcode::Divide: case Opcode::Remainder:
+            case Opcode::Power: case Opcode::BitAnd: case Opcode::BitOr: case Opcode::BitXor: case Opcode::ShiftLeft: case Opcode::ShiftRight:
+                if (isReal(in.scalar)) r[in.a] = realOperation(in.op, in.scalar, r[in.b], r[in.c]);
+                else if (!integerOperation(in.op, in.scalar, r[in.b], r[in.c], r[in.a])) {
+                    report(RuntimeErrors::DivisionByZero, "DivisionByZero", function->sites[pc - 1]);
+                    return false;
+                }
+                break;
+            case Opcode::Equal: case Opcode::NotEqual: case Opcode::Less: case Opcode::LessEqual: case Opcode::Greater: case Opcode::GreaterEqual:
+                r[in.a].u = compare(in.op, in.scalar, r[in.b], r[in.c]);
+                break;
+            case Opcode::Concat: r[in.a].s = concat(r[in.b].s, r[in.c].s); break;
+
+            case Opcode::Negate:
+                if (isReal(in.scalar)) r[in.a].f = -r[in.b].f;
+                else r[in.a] = normalize(Register{.u = 0 - r[in.b].u}, in.scalar);
+                break;
+            case Opcode::Not: r[in.a] = normalize(Register{.u = ~r[in.b].u}, in.scalar); break;
+            case Opcode::ToText: r[in.a].s = in.scalar == Scalar::Str ? r[in.b].s : toText(r[in.b], in.scalar); break;
+
+            case Opcode::Jump: pc = in.b; break;
+            case Opcode::JumpIf: if (r[in.a].u) pc = in.b; break;
+            case Opcode::JumpUnless: if (!r[in.a].u) pc = in.b; break;
+            case Opcode::Loop:
+                if (function->promotable && ++function->backedges + function->calls >= promotionThreshold) promote(*function);
+                pc = in.b;
+                break;
+
+            case Opcode::Intrinsic: r[in.a] = intrinsic(static_cast<Intrinsic>(in.b), in.scalar, r + in.c, in.count); break;
+            case Opcode::Call: {
+                BytecodeFunction& callee = program->functions[in.b];
+                if (callee.promotable && ++callee.calls + callee.backedges >= promotionThreshold) promote(callee);
+                if (callee.native) {
+                    callee.native(r + in.c, r + in.a);
+                    break;
+                }
+
+                if (frames.size() >= callDepthLimit) {
+                    report(RuntimeErrors::StackOverflow, "StackOverflow", function->sites[pc - 1], {std::to_string(callDepthLimit)});
+                    return false;
+                }
+
+                // the callee's frame starts right after the caller's, arguments become its first registers
+                frames.back().pc = pc;
+                size_t base = frames.back().base + function->registers;
+                if (registers.size() < base + callee.registers) registers.resize(std::max(base + callee.registers, registers.size() * 2));
+                r = registers.data() + frames.back().base;
+                std::copy(r + in.c, r + in.c + in.count, registers.data() + base);
+                frames.push_back(Frame{in.b, 0, base, in.a});
+
+                function = &callee;
+                code = function->code.data();
+                r = registers.data() + base;
+                pc = 0;
+                break;
+            }
+            case Opcode::Return: case Opcode::ReturnVoid: {
+                Register value = in.op == Opcode::Return ? r[in.a] : Register{};
+                uint16_t target = frames.back().result;
+                frames.pop_back();
+                if (frames.empty()) {
+                    result = value;
+                    return true;
+                }
+
+                const Frame& caller = frames.back();
+                function = &program->functions[caller.function];
+                code = function->code.data();
+                r = registers.data() + caller.base;
+                pc = caller.pc;
+                r[target] = value;
+                break;
+            }
+        }
+    }
+}
+
+// ==== Tiering ====
+
+void Interpreter::promote(BytecodeFunction& function) {
+    function.promotable = false;
+    if (!nativeTier || !compileNative || !function.source) return;
+
+    NativeBridge bridge = compileNative(function.source);
+    if (!bridge) return;
+
+    // native code reads globals from its own storage, so that's where they live from now on
+    if (!relocated && !(relocated = relocateGlobals())) {
+        nativeTier = false;
+        return;
+    }
+    function.native = bridge;
+}
+
+// ==== Helpers ====
+
+void Interpreter::report(RuntimeErrors error, const std::string& name, const ASTNode* site, std::vector<std::string> args) {
+    errorManager->addError(ErrorType::Runtime, error,
+        ErrorSpan{site ? site->filePath : "", site ? site->value : "", site ? site->line : 0, site ? site->column : 0},
+        std::format("ErrorManager.Runtime.{}.message", name), args,
+        std::format("ErrorManager.Runtime.{}.hint", name), args);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "Bytecode.hpp"
+#include "Core/Extras/ErrorManager/ErrorManager.hpp"
+
+/* Interpreter runs Bytecode, it's what `neoluma run` starts a program with.
+ * Every function counts its calls and loop iterations. Once that reaches promotionThreshold, the function is handed to
+ * compileNative, and calls after that go to the native code it returns. A call that is already running stays
+ * interpreted till it returns, there's no on-stack replacement.
+ * Globals live where native code would keep them: in the interpreter's own storage till the first promotion, then in
+ * the JIT's, so both tiers always see the same values.
+ */
+struct Interpreter {
+    // ErrorManager is used to report errors
+    ErrorManager* errorManager = nullptr;
+
+    uint64_t promotionThreshold = 1000; // calls + loop iterations of a function
+    size_t callDepthLimit = 100'000;
+
+    // Native version of a function, nullptr if it has none. Without it everything is interpreted.
+    std::function<NativeBridge(FunctionNode*)> compileNative;
+    // Address of a global in native code, nullptr if it has none
+    std::function<void*(DeclarationNode*)> locateNative;
+
+    // Runs the global initializers, then the entry. Returns its exit code, nullopt (with an error) if the program failed.
+    std::optional<int> run(BytecodeProgram& program);
+
+private:
+    struct Frame {
+        uint32_t function;
+        uint32_t pc; // where the frame goes on once its callee returns
+        size_t base; // first register
+        uint16_t result; // register of the caller that gets the result
+    };
+
+    BytecodeProgram* program = nullptr;
+    std::vector<Register> registers;
+    std::vector<Frame> frames;
+    std::vector<uint64_t> globalStorage;
+    std::vector<void*> globalAddresses;
+    bool nativeTier = true; // false once the JIT failed to take the globals
+    bool relocated = false;
+
+    bool execute(uint32_t function, Register& result);
+    void promote(BytecodeFunction& function);
+    bool relocateGlobals();
+    Register load(uint32_t global) const;
+    void store(uint32_t global, Register value);
+    void report(RuntimeErrors error, const std::string& name, const ASTNode* site, std::vector<std::string> args = {});
+};
@@ -0,0 +1,107 @@
+#include "JIT.hpp"
+
+#include <cstdio>
+
+// LLVM Primitives
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+JIT::JIT() = default;
+JIT::~JIT() = default;
+
+// ==== Setup ====
+
+bool JIT::initialize() {
+    optimizer.errorManager = errorManager;
+    if (!optimizer.initialize()) return false;
+
+    auto created = llvm::orc::LLLazyJITBuilder().create();
+    if (!created) {
+        std::string reason = llvm::toString(created.takeError());
+        errorManager->addError(ErrorType::Codegen, CodegenErrors::TargetNotSupported,
+            ErrorSpan{"", optimizer.triple(), 0, 0},
+            "ErrorManager.Codegen.TargetNotSupported.message", {optimizer.triple()},
+            "ErrorManager.Codegen.TargetNotSupported.jit.hint", {reason});
+        return false;
+    }
+    jit = std::move(*created);
+
+    // printf, malloc and the rest of the C library come from the compiler process
+    auto process = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(jit->getDataLayout().getGlobalPrefix());
+    if (!process) {
+        report("libc", llvm::toString(process.takeError()));
+        return false;
+    }
+    jit->getMainJITDylib().addGenerator(std::move(*process));
+
+    // runs once per lazily compiled piece, so only functions that are actually called get optimized
+    jit->getIRTransformLayer().setTransform([this](llvm::orc::ThreadSafeModule module, llvm::orc::MaterializationResponsibility&) {
+        module.withModuleDo([this](llvm::Module& piece) {
+            // the runtime is linkonce_odr, a piece nothing in it calls would lose the definitions it has to provide
+            for (llvm::GlobalValue& value : piece.global_values())
+                if (!value.isDeclaration() && value.hasLinkOnceLinkage()) value.setLinkage(llvm::GlobalValue::WeakODRLinkage);
+            optimizer.optimize(piece);
+        });
+        return llvm::Expected<llvm::orc::ThreadSafeModule>(std::move(module));
+    });
+    return true;
+}
+
+std::string JIT::triple() const { return jit ? jit->getTargetTriple().str() : ""; }
+
+std::string JIT::dataLayout() const { return jit ? jit->getDataLayout().getStringRepresentation() : ""; }
+
+// ==== Running ====
+
+bool JIT::addModule(MemoryPtr<llvm::Module> module, MemoryPtr<llvm::LLVMContext> context) {
+    std::string name = module->getName().str();
+    if (llvm::Error error = jit->addLazyIRModule(llvm::orc::ThreadSafeModule(std::move(module), llvm::orc::ThreadSafeContext(std::move(context))))) {
+        report(name, llvm::toString(std::move(error)));
+        return false;
+    }
+    return true;
+}
+
+void* JIT::lookup(const std::string& symbol) {
+    auto found = jit->lookup(symbol);
+    if (!found) {
+        report(symbol, llvm::toString(found.takeError()));
+        return nullptr;
+    }
+#if LLVM_VERSION_MAJOR >= 15
+    return found->toPtr<void*>();
+#else
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(found->getAddress()));
+#endif
+}
+
+std::optional<int> JIT::run(const std::string& entry) {
+    if (llvm::Error error = jit->initialize(jit->getMainJITDylib())) {
+        report(entry, llvm::toString(std::move(error)));
+        return std::nullopt;
+    }
+
+    auto* function = reinterpret_cast<int (*)()>(lookup(entry));
+    if (!function) return std::nullopt;
+
+    // the program shares stdout with the compiler, whatever the compiler printed goes first
+    std::fflush(nullptr);
+    int result = function();
+    std::fflush(nullptr);
+
+    if (llvm::Error error = jit->deinitialize(jit->getMainJITDylib())) report(entry, llvm::toString(std::move(error)));
+    return result;
+}
+
+// ==== Helpers ====
+
+void JIT::report(const std::string& symbol, const std::string& reason) {
+    errorManager->addError(ErrorType::Codegen, CodegenErrors::LinkageError,
+        ErrorSpan{"", symbol, 0, 0},
+        "ErrorManager.Codegen.LinkageError.jit.message", {symbol},
+        "ErrorManager.Codegen.LinkageError.jit.hint", {reason});
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <optional>
+#include <string>
+
+#include "Core/Backend/Codegen/Codegen.hpp"
+#include "Core/Extras/ErrorManager/ErrorManager.hpp"
+#include "HelperFunctions.hpp"
+
+namespace llvm {
+    class LLVMContext;
+    class Module;
+    namespace orc { class LLLazyJIT; }
+}
+
+/* JIT runs a program inside the compiler process with LLVM's ORC LLLazyJIT, there's no object file and no link step.
+ * Modules are added as they come out of the IR Generator, but nothing is compiled then: every function starts as a stub
+ * that compiles it on its first call. Functions a run never reaches are never compiled.
+ * A function is optimized (-O2) right before it's compiled. Everything not defined by the program, the C library
+ * included, is looked up in the compiler process itself.
+ */
+struct JIT {
+    // ErrorManager is used to report errors
+    ErrorManager* errorManager = nullptr;
+
+    JIT();
+    ~JIT();
+
+    bool initialize(); // for the host, false (with an error) if LLVM can't run code on it
+    std::string triple() const;
+    std::string dataLayout() const;
+
+    // The module is compiled lazily, a function at a time. Its context goes with it.
+    bool addModule(MemoryPtr<llvm::Module> module, MemoryPtr<llvm::LLVMContext> context);
+    // Address of a symbol of the program, compiling it first if it wasn't yet. nullptr (with an error) if there's none.
+    void* lookup(const std::string& symbol);
+    // Runs global initializers, then `int entry()`. Returns its result, nullopt if the program couldn't start.
+    std::optional<int> run(const std::string& entry = "main");
+
+private:
+    MemoryPtr<llvm::orc::LLLazyJIT> jit;
+    Codegen optimizer; // for the target machine the optimization pipeline is tuned to
+
+    void report(const std::string& symbol, const std::string& reason);
+};
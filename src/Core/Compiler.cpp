@@ -1,10 +1,69 @@
 #include "Compiler.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+
+#include "Backend/Interpreter/Interpreter.hpp"
+#include "Backend/JIT/JIT.hpp"
+#include "Middleend/IRGenerator/IRGenerator.hpp"
+#include "Middleend/Optimizer/NIR/NIRBuilder.hpp"
+#include "Middleend/Optimizer/NIR/PassManager.hpp"
 #include "Libraries/Asker/Asker.hpp"
 #include "Libraries/Color/Color.hpp"
 #include "Libraries/Json/Json.hpp"
 #include "Libraries/Localization/Localization.hpp"
 
+// Everything another module sees of a top-level statement. Function bodies are left out on purpose: editing one
+// doesn't change what other modules can declare or call, so their analysis stays green.
+static void fingerprintExport(uint64_t& seed, ASTNode* statement) {
+    switch (statement->type) {
+        case ASTNodeType::Function: {
+            auto* function = static_cast<FunctionNode*>(statement);
+            QueryEngine::mix(seed, std::format("fn {} {}:{} {}", function->name, function->line, function->column, function->isIntrinsic));
+            for (const auto& decorator : function->decorators) QueryEngine::mix(seed, decorator->toString(0));
+            for (const auto& modifier : function->modifiers) QueryEngine::mix(seed, modifier->toString(0));
+            for (const auto& parameter : function->parameters) QueryEngine::mix(seed, parameter->toString(0));
+            if (function->returnType) QueryEngine::mix(seed, function->returnType->toString(0));
+            break;
+        }
+        case ASTNodeType::Namespace: {
+            auto* node = static_cast<NamespaceNode*>(statement);
+            QueryEngine::mix(seed, node->name->toString(0));
+            for (const auto& member : node->body) fingerprintExport(seed, member.get());
+            break;
+        }
+        // initializers decide the types of top-level variables, classes are taken whole for now
+        case ASTNodeType::Declaration:
+        case ASTNodeType::Class:
+        case ASTNodeType::Enum:
+        case ASTNodeType::Interface:
+        case ASTNodeType::Decorator:
+        case ASTNodeType::Import:
+            QueryEngine::mix(seed, statement->toString(0));
+            break;
+        default: break; // other top-level statements declare nothing
+    }
+}
+
+static void fingerprintNamespace(uint64_t& seed, const NamespaceInfo& level) {
+    QueryEngine::mix(seed, level.name);
+    std::map<std::string_view, size_t> members;
+    for (const auto& [name, declarations] : level.members) members[name] = declarations.size();
+    for (const auto& [name, count] : members) { QueryEngine::mix(seed, name); QueryEngine::mix(seed, static_cast<uint64_t>(count)); }
+
+    std::map<std::string_view, const NamespaceInfo*> children;
+    for (const auto& [name, child] : level.children) children[name] = child.get();
+    for (const auto& [_, child] : children) fingerprintNamespace(seed, *child);
+}
+
+static uint64_t fingerprintSource(std::string_view source) {
+    uint64_t fingerprint = QueryEngine::fingerprintSeed;
+    QueryEngine::mix(fingerprint, source);
+    return fingerprint;
+}
+
 Compiler::Compiler(const CompilationInput& input) {
     program.input = input;
 
@@ -12,57 +71,550 @@ Compiler::Compiler(const CompilationInput& input) {
     parser.errorManager = &errorManager;
     orchestrator.setCompiler(this); // it requires for internal project checks
     semanticAnalysis.errorManager = &errorManager;
+    constantFolder.errorManager = &errorManager;
+    flowAnalysis.errorManager = &errorManager;
+    flowAnalysis.borrowChecker.errorManager = &errorManager;
+    flowAnalysis.checkOwnership = input.settings.memory.level == CompilerSettings::Memory::MemoryOptions::Rusty;
+    codegen.errorManager = &errorManager;
+    queries.errorManager = &errorManager;
+
+    defineQueries();
 }
 
-void Compiler::check(bool jsonOutput) {
+// Strings are collected in the default memory mode only
+static std::optional<GarbageCollector::Settings> collectorSettings(const CompilerSettings& settings) {
+    if (settings.memory.level != CompilerSettings::Memory::MemoryOptions::Default) return std::nullopt;
+    return GarbageCollector::Settings{settings.memory.heapSize << 20, static_cast<uint64_t>(settings.memory.pauseTarget * 1e6), settings.memory.gcStats};
+}
+
+// and counted in ARC, with collections
+static std::optional<ReferenceCounter::Settings> referenceCountingSettings(const CompilerSettings& settings) {
+    if (settings.memory.level != CompilerSettings::Memory::MemoryOptions::ARC) return std::nullopt;
+    return ReferenceCounter::Settings{settings.memory.arcStats};
+}
+
+// ==== Queries ====
+
+void Compiler::defineQueries() {
+    // Lexer: breaks code down into tokens.
+    queries.define("tokens", [this](const std::string& file) {
+        std::vector<Token> tokens = lexer.tokenizeSource(queries.get<std::string>("source", file), file);
+
+        uint64_t fingerprint = QueryEngine::fingerprintSeed;
+        for (const auto& token : tokens) {
+            QueryEngine::mix(fingerprint, static_cast<uint64_t>(token.type));
+            QueryEngine::mix(fingerprint, token.value);
+            QueryEngine::mix(fingerprint, (static_cast<uint64_t>(token.line) << 32) | static_cast<uint32_t>(token.column));
+        }
+        return QueryEngine::Result{std::move(tokens), fingerprint};
+    });
+
+    // Parser: builds a module tree out of tokens
+    queries.define("ast", [this](const std::string& file) {
+        parser.parseModule(queries.get<std::vector<Token>>("tokens", file), file);
+        ModuleNode* tree = parser.moduleSource.get();
+        if (!tree) std::println(std::cerr, "NULL TREE: {}", file);
+        program.modules[moduleIds.at(file)] = std::move(parser.moduleSource);
+
+        // Every parse is a new tree, so everything that keeps pointers into the old one has to run again
+        return QueryEngine::Result{tree, ++parses};
+    });
+
+    queries.define("exports", [this](const std::string& file) {
+        uint64_t fingerprint = QueryEngine::fingerprintSeed;
+        if (ModuleNode* tree = queries.get<ModuleNode*>("ast", file))
+            for (const auto& statement : tree->body) fingerprintExport(fingerprint, statement.get());
+        return QueryEngine::Result{{}, fingerprint};
+    });
+
+    // Orchestrator: stitches files together into a full program, used for Semantic Analysis and more.
+    queries.define("program", [this](const std::string&) {
+        for (const auto& file : queries.get<std::vector<std::string>>("files")) queries.get("ast", file);
+
+        program.order.clear();
+        program.namespaces = orchestrator.collectNamespaces(program.modules);
+        for (const auto& index : program.symbolIndexes) Orchestrator::mergeIndex(*program.namespaces, index);
+        program.entryPoint = orchestrator.findEntryPoint(program.modules);
+        program.moduleInfos = orchestrator.resolveImports(program);
+        orchestrator.stitchProgram(program);
+        return QueryEngine::Result{{}, programFingerprint()};
+    });
+
+    // Semantic Analysis: Make sure the program runs logically correct, before turned into a machine code
+    queries.define("analysis", [this](const std::string& file) {
+        queries.get("ast", file);
+        for (const auto& other : queries.get<std::vector<std::string>>("files"))
+            if (other != file) queries.get("exports", other);
+        queries.get("program");
+
+        // calls into other modules point into their trees, so those trees become dependencies too
+        semanticAnalysis.onResolvedCall = [this, &file](FunctionNode* function) {
+            if (function->filePath != file && moduleIds.contains(function->filePath)) queries.get("ast", function->filePath);
+        };
+        semanticAnalysis.analyzeModuleOf(program, moduleIds.at(file));
+        semanticAnalysis.onResolvedCall = nullptr;
+
+        // the tree is annotated in place, so every run counts as a new result
+        return QueryEngine::Result{{}, ++rewrites};
+    });
+
+    // Constant Folder: evaluates everything known at compile time, only on a program that type-checked
+    queries.define("fold", [this](const std::string& file) {
+        queries.get("analysis", file);
+        ModuleNode* tree = queries.get<ModuleNode*>("ast", file);
+
+        constantFolder.onComptimeCall = [this, &file](FunctionNode* function) {
+            if (function->filePath != file && moduleIds.contains(function->filePath)) queries.get("ast", function->filePath);
+        };
+        if (tree) constantFolder.foldModule(tree);
+        constantFolder.onComptimeCall = nullptr;
+        return QueryEngine::Result{{}, ++rewrites};
+    });
+
+    // Flow Analysis: checks every function body along its control flow and drops the code no path reaches
+    queries.define("flow", [this](const std::string& file) {
+        queries.get("fold", file);
+        flowAnalysis.analyzeModule(queries.get<ModuleNode*>("ast", file));
+        indexQueue.push_back(file);
+        return QueryEngine::Result{{}, ++rewrites};
+    });
+}
+
+std::vector<std::string> Compiler::collectSources() {
     // TODO: Tolerate sourceFolder choice
-    // Parsing dependencies before getting started
-    std::vector<std::filesystem::path> files = program.input.files;
+    std::vector<std::string> files;
+    for (const auto& file : program.input.files) files.push_back(file.string());
+
+    loadDependencies();
+    files.insert(files.end(), dependencySources.begin(), dependencySources.end());
+    return files;
+}
+
+void Compiler::loadDependencies() {
+    if (dependenciesLoaded) return;
+    dependenciesLoaded = true;
 
     for (const auto& [name, path] : program.input.dependencies) {
         std::filesystem::path sourcePath = path / "src";
-        for (const auto& file : std::filesystem::recursive_directory_iterator( sourcePath, std::filesystem::directory_options::skip_permission_denied)) {
-            if (file.is_regular_file() && file.path().extension() == ".nm") files.push_back(file.path());
+        for (const auto& entry : std::filesystem::recursive_directory_iterator( sourcePath, std::filesystem::directory_options::skip_permission_denied)) {
+            if (!entry.is_regular_file() || entry.path().extension() != ".nm") continue;
+            std::string file = entry.path().string();
+
+            // An index written from the same text replaces the module. Names outside of namespaces are only reachable through its tree though.
+            SymbolIndex index;
+            std::filesystem::path indexFile = indexPath(file);
+            if (!indexFile.empty() && index.open(indexFile) && !index.hasGlobals() && index.sourceFingerprint() == fingerprintSource(readFile(file)))
+                program.symbolIndexes.push_back(std::move(index));
+            else dependencySources.push_back(file);
         }
     }
+}
+
+std::filesystem::path Compiler::indexPath(const std::string& file) const {
+    if (program.input.buildFolder.empty()) return {};
+
+    std::filesystem::path path(file);
+    std::filesystem::path relative;
+    for (const auto& [name, root] : program.input.dependencies) {
+        std::filesystem::path inside = path.lexically_relative(root / "src");
+        if (!inside.empty() && *inside.begin() != "..") { relative = std::filesystem::path("dependencies") / name / inside; break; }
+    }
+    if (relative.empty() && !program.input.sourceFolder.empty()) relative = path.lexically_relative(program.input.sourceFolder);
+    if (relative.empty() || *relative.begin() == "..") relative = path.filename();
+
+    return program.input.buildFolder / "index" / relative.replace_extension(".nsi");
+}
 
-    // Parsing the project itself
-    for (const auto& file : program.input.files){
-        // Lexer: breaks code down into tokens.
-        std::string source = readFile(file.string());
-        std::vector<Token> tokens = lexer.tokenize(file.string());
-        //lexer.printTokens();
+void Compiler::writeIndexes(const std::vector<std::string>& analyzed) {
+    auto write = [this](const std::string& file) {
+        auto id = moduleIds.find(file);
+        std::filesystem::path path = indexPath(file);
+        if (id == moduleIds.end() || path.empty() || !program.modules[id->second]) return;
+        SymbolIndex::write(path, program.modules[id->second].get(), sourceFingerprints[file]);
+    };
 
-        // Parser: builds a module tree out of tokens
-        parser.parseModule(tokens, file.string());
-        //parser.printModule();
-        MemoryPtr<ModuleNode> tree = std::move(parser.moduleSource);
+    for (const auto& file : indexQueue) write(file);
+    indexQueue.clear();
 
-        // Adding modules to program's tree
-        if (!tree) std::println(std::cerr, "NULL TREE: {}", file.string());
-        if (tree) program.modules.push_back(std::move(tree));
+    // Modules only reached through namespaces (most of std) are never analyzed, their signatures are resolved just for the index
+    std::unordered_set<std::string> inOrder(analyzed.begin(), analyzed.end());
+    for (const auto& file : sourceFiles) {
+        if (inOrder.contains(file) || indexedSources[file] == sourceFingerprints[file] || !moduleIds.contains(file)) continue;
+        if (ModuleNode* module = program.modules[moduleIds.at(file)].get()) semanticAnalysis.resolveSignatures(program, module);
+        write(file);
+        indexedSources[file] = sourceFingerprints[file];
     }
+}
 
-    // Orchestrator: stitches files together into a full program, used for Semantic Analysis and more.
-    program.namespaces = orchestrator.collectNamespaces(program.modules);
-    program.entryPoint = orchestrator.findEntryPoint(program.modules);
-    program.moduleInfos = orchestrator.resolveImports(program);
-    // /*std::println(std::cout, "=== ModuleId map ===");
-    // for (const auto& info : infos){
-    //     std::println(std::cout, "[{}] file={}", info.id, info.module ? info.module->filePath : "<null>");
-    //     std::println(std::cout, "     deps={}", info.dependencies.size());
-    //     for (auto d : info.dependencies) std::println(std::cout, "        -> {}", d.moduleId);
-    // }*/
-    orchestrator.stitchProgram(program);
-    /*std::println(std::cout, "Entry module id: {}", program.entryModule);
-    std::println(std::cout, "Order:");
-    for (auto id : program.order) {
-        std::println(std::cout, "    {}", id);
-    }*/
+uint64_t Compiler::programFingerprint() const {
+    uint64_t seed = QueryEngine::fingerprintSeed;
+    if (program.entryPoint.function)
+        QueryEngine::mix(seed, std::format("{}:{}", program.entryPoint.module->filePath, program.entryPoint.function->name));
+    for (ModuleId id : program.order) QueryEngine::mix(seed, static_cast<uint64_t>(id));
 
-    // Semantic Analysis: Make sure the program runs logically correct, before turned into a machine code
-    semanticAnalysis.analyzeProgram(program);
+    for (const auto& info : program.moduleInfos) {
+        QueryEngine::mix(seed, static_cast<uint64_t>(info.id));
+        for (const auto& dependency : info.dependencies) QueryEngine::mix(seed, static_cast<uint64_t>(dependency.moduleId));
+        for (const auto& [alias, id] : std::map<std::string, ModuleId>(info.aliasMap.begin(), info.aliasMap.end())) {
+            QueryEngine::mix(seed, alias);
+            QueryEngine::mix(seed, static_cast<uint64_t>(id));
+        }
+        for (const auto& native : info.nativeImports) QueryEngine::mix(seed, native);
+        for (const auto* level : info.namespaceImports) QueryEngine::mix(seed, level->fullName());
+        for (const auto& [alias, level] : std::map<std::string, NamespaceInfo*>(info.namespaceAliasMap.begin(), info.namespaceAliasMap.end())) {
+            QueryEngine::mix(seed, alias);
+            QueryEngine::mix(seed, level->fullName());
+        }
+    }
+
+    if (program.namespaces) fingerprintNamespace(seed, *program.namespaces);
+    return seed;
+}
+
+// ==== Main functions ====
+
+void Compiler::analyze() {
+    // Inputs: the list of files and the text of every file. Queries computed from unchanged text stay as they are.
+    std::vector<std::string> files = collectSources();
+    if (files != sourceFiles) {
+        // ModuleIds shift with the list, so every tree is rebuilt
+        sourceFiles = files;
+        moduleIds.clear();
+        for (size_t i = 0; i < files.size(); i++) moduleIds[files[i]] = static_cast<ModuleId>(i);
+        program.modules.clear();
+        program.modules.resize(files.size());
+        for (const auto& file : files) queries.invalidate("ast", file);
+
+        uint64_t fingerprint = QueryEngine::fingerprintSeed;
+        for (const auto& file : files) QueryEngine::mix(fingerprint, file);
+        queries.setInput("files", "", files, fingerprint);
+    }
+    for (const auto& file : files) {
+        std::string source = readFile(file);
+        uint64_t fingerprint = fingerprintSource(source);
+        sourceFingerprints[file] = fingerprint;
+        queries.setInput("source", file, std::move(source), fingerprint);
+    }
+
+    /* Analysis and folding work on the trees in place, so a module that has to be analyzed again needs a fresh tree.
+     * A fresh tree in turn turns red every module that resolved calls into the old one, so this repeats until nothing
+     * else changes. Modules that were never analyzed still have untouched trees.
+     */
+    std::unordered_set<std::string> refreshed;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const auto& file : files) {
+            if (refreshed.contains(file) || !queries.contains("analysis", file) || queries.isGreen("analysis", file)) continue;
+            queries.invalidate("ast", file);
+            refreshed.insert(file);
+            changed = true;
+        }
+    }
+
+    // Exports are read off trees nothing has annotated yet
+    for (const auto& file : files) queries.get("exports", file);
+    queries.get("program");
+
+    std::vector<std::string> analyzed;
+    for (ModuleId id : moduleOrder())
+        if (id < static_cast<ModuleId>(files.size())) analyzed.push_back(files[id]);
+    for (const auto& file : analyzed) queries.get("analysis", file);
+
+    // Errors are collected in the order the stages would report them in one go
+    errorManager.errors.clear();
+    auto collect = [this](const std::string& kind, const std::string& argument) {
+        const auto& diagnostics = queries.diagnostics(kind, argument);
+        errorManager.errors.insert(errorManager.errors.end(), diagnostics.begin(), diagnostics.end());
+    };
+    for (const auto& file : files) { collect("tokens", file); collect("ast", file); }
+    collect("program", "");
+    for (const auto& file : analyzed) collect("analysis", file);
+
+    if (errorManager.hasErrors()) return;
+    for (const auto& file : analyzed) {
+        queries.get("fold", file);
+        collect("fold", file);
+    }
+
+    // flow errors only make sense on folded trees, `if (false)` has to be a literal by then
+    if (errorManager.hasErrors()) return;
+    for (const auto& file : analyzed) {
+        queries.get("flow", file);
+        collect("flow", file);
+    }
+
+    // modules that went through a clean program are safe to stand in for their source next time
+    if (!errorManager.hasErrors()) writeIndexes(analyzed);
+}
+
+std::vector<ModuleId> Compiler::moduleOrder() const {
+    std::vector<ModuleId> order;
+    std::unordered_set<ModuleId> seen;
+    auto add = [&](ModuleId id) {
+        if (id >= 0 && id < static_cast<ModuleId>(program.modules.size()) && program.modules[id] && seen.insert(id).second) order.push_back(id);
+    };
+    for (ModuleId id : program.order) add(id);
+    // imports of namespaces aren't edges of the order, the modules only they reach come after it
+    for (ModuleId id = 0; id < static_cast<ModuleId>(program.modules.size()); id++) add(id);
+    return order;
+}
+
+bool Compiler::compile() {
+    analyze();
+    if (!errorManager.hasErrors()) generate();
+
+    if (errorManager.hasErrors()) {
+        errorManager.printErrors();
+        std::println(std::cout, "{}{}{}", Color::TextHex("#ff5050"), Localization::translate("CLI.build.failed"), Color::Reset);
+        return false;
+    }
+    return true;
+}
+
+void Compiler::generate() {
+    if (!codegen.initialize(program.input.settings.target)) return;
+
+    std::vector<ModuleNode*> modules;
+    for (ModuleId id : moduleOrder()) modules.push_back(program.modules[id].get());
+
+    OutputType type = program.input.targetOutput;
+    std::string name = program.input.name.empty() ? "main" : program.input.name;
+    program.output = codegen.outputPath(program.input.buildFolder, name, type);
+
+    if (type == OutputType::Executable || type == OutputType::StaticLibrary || type == OutputType::SharedLibrary) {
+        bool thin = program.input.settings.lto == CompilerSettings::LTO::Thin;
+        std::vector<std::filesystem::path> objects = generateObjects(modules, thin);
+        if (errorManager.hasErrors()) return;
+        if (thin) codegen.linkThin(objects, program.output, type, program.input.buildFolder);
+        else codegen.link(objects, program.output, type);
+        return;
+    }
+    if (type == OutputType::None) return;
+
+    // `ir` is NIR after the Neoluma passes, with what each of them took
+    if (type == OutputType::IR) {
+        NIRBuilder builder;
+        builder.types = program.types.get();
+        builder.sourceFolder = program.input.sourceFolder;
+        NIRModule module = builder.build(name, modules);
+        PassManager passes = PassManager::defaultPipeline(program.input.settings.memory.level == CompilerSettings::Memory::MemoryOptions::ARC);
+        passes.run(module);
+        codegen.emitText(printNIR(module) + "\n" + passes.report(), program.output);
+        return;
+    }
+
+    // a single file out of the whole program: everything goes into one module
+    llvm::LLVMContext context;
+    IRGenerator generator(context);
+    generator.errorManager = &errorManager;
+    generator.sourceFolder = program.input.sourceFolder;
+    generator.targetTriple = codegen.triple();
+    generator.dataLayout = codegen.dataLayout();
+    generator.garbageCollector = collectorSettings(program.input.settings);
+    generator.referenceCounting = referenceCountingSettings(program.input.settings);
+    generator.declareProgram(modules);
+
+    MemoryPtr<llvm::Module> module = generator.generate(name, modules, program.entryPoint.function);
+    if (errorManager.hasErrors() || !codegen.verify(*module)) return;
+    codegen.optimize(*module);
+
+    if (type == OutputType::Object) codegen.emitObject(*module, program.output);
+    else codegen.emitIR(*module, program.output);
+}
+
+std::vector<std::filesystem::path> Compiler::generateObjects(const std::vector<ModuleNode*>& modules, bool bitcode) {
+    struct Job {
+        ModuleNode* module = nullptr;
+        std::string name;
+        std::filesystem::path object;
+        ErrorManager errors; // merged in module order once every thread is done
+        bool written = false;
+    };
+
+    if (modules.empty()) return {};
+
+    // files outside the source folder go by their name, so two of them can share a module path
+    std::vector<Job> jobs(modules.size());
+    std::unordered_set<std::string> names;
+    for (size_t i = 0; i < modules.size(); i++) {
+        jobs[i].module = modules[i];
+        jobs[i].name = IRGenerator::modulePath(modules[i]->filePath, program.input.sourceFolder);
+        std::string file = jobs[i].name;
+        for (int suffix = 1; !names.insert(file).second; suffix++) file = std::format("{}-{}", jobs[i].name, suffix);
+        jobs[i].object = program.input.buildFolder / "obj" / (file + (bitcode ? ".bc" : codegen.objectExtension()));
+    }
+
+    // Every thread has its own Codegen: a TargetMachine can't be shared between them. Every module gets its own LLVMContext,
+    // other modules are only seen through declarations of their symbols.
+    std::atomic<size_t> next = 0;
+    auto work = [&] {
+        ErrorManager setup; // the same triple was already set up once, this can't fail
+        Codegen backend;
+        backend.errorManager = &setup;
+        if (!backend.initialize(codegen.triple())) return;
+
+        for (size_t i; (i = next++) < jobs.size();) {
+            Job& job = jobs[i];
+            backend.errorManager = &job.errors;
+
+            llvm::LLVMContext context;
+            IRGenerator generator(context);
+            generator.errorManager = &job.errors;
+            generator.sourceFolder = program.input.sourceFolder;
+            generator.targetTriple = backend.triple();
+            generator.dataLayout = backend.dataLayout();
+            generator.garbageCollector = collectorSettings(program.input.settings);
+            generator.referenceCounting = referenceCountingSettings(program.input.settings);
+            generator.declareProgram(modules);
+
+            MemoryPtr<llvm::Module> module = generator.generate(job.name, {job.module}, program.entryPoint.function);
+            if (job.errors.hasErrors() || !backend.verify(*module)) continue;
+
+            // modules of intrinsics have nothing to put in an object
+            bool empty = std::ranges::all_of(module->functions(), [](const llvm::Function& function) { return function.isDeclaration(); })
+                && std::ranges::all_of(module->globals(), [](const llvm::GlobalVariable& global) { return global.isDeclaration(); });
+            if (empty) continue;
+
+            if (bitcode) job.written = backend.emitBitcode(*module, job.object);
+            else {
+                backend.optimize(*module);
+                job.written = backend.emitObject(*module, job.object);
+            }
+        }
+    };
+
+    {
+        size_t threads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, jobs.size());
+        std::vector<std::jthread> workers;
+        for (size_t i = 1; i < threads; i++) workers.emplace_back(work);
+        work();
+    }
+
+    // a function of one module that can't be compiled is reported by every module calling it
+    std::vector<std::filesystem::path> objects;
+    std::unordered_set<std::string> reported;
+    for (Job& job : jobs) {
+        for (Error& error : job.errors.errors)
+            if (reported.insert(std::format("{}:{}:{}:{}", error.span.filePath, error.span.line, error.span.column, error.messageKey)).second)
+                errorManager.errors.push_back(std::move(error));
+        if (job.written) objects.push_back(job.object);
+    }
+    return objects;
+}
+
+int Compiler::run() {
+    analyze();
+    std::optional<int> result;
+    if (!errorManager.hasErrors()) result = execute();
+
+    if (errorManager.hasErrors() || !result) {
+        errorManager.printErrors();
+        std::println(std::cout, "{}{}{}", Color::TextHex("#ff5050"), Localization::translate("CLI.run.failed"), Color::Reset);
+        return 1;
+    }
+    return *result;
+}
+
+std::optional<int> Compiler::execute() {
+    std::vector<ModuleNode*> modules;
+    for (ModuleId id : moduleOrder()) modules.push_back(program.modules[id].get());
+
+    // the interpreter starts right away; a program using what it doesn't have runs on the JIT as a whole. So does one
+    // counting references: the Interpreter's strings have no counts promoted code could keep. And one setting up its
+    // collector, neither tier collects strings: the Interpreter's registers are no roots the collector could scan.
+    const CompilerSettings::Memory& memory = program.input.settings.memory;
+    bool collectorSet = memory.level == CompilerSettings::Memory::MemoryOptions::Default && (memory.heapSize || memory.gcStats);
+    if (memory.level == CompilerSettings::Memory::MemoryOptions::ARC || collectorSet) return executeNative(modules);
+    BytecodeProgram bytecode;
+    BytecodeCompiler bytecodeCompiler;
+    if (!bytecodeCompiler.compile(modules, program.entryPoint.function, bytecode)) return executeNative(modules);
+
+    // The JIT is only started for the first hot function. Its errors aren't the program's: a function it can't take stays interpreted.
+    // Promoted code doesn't collect strings, the ones in the Interpreter's registers aren't roots it could see; like
+    // the Interpreter's own they live till the program ends.
+    ErrorManager nativeErrors;
+    MemoryPtr<JIT> jit;
+    bool jitFailed = false;
+    auto startNative = [&]() -> JIT* {
+        if (jit || jitFailed) return jit.get();
+        jit = makeMemoryPtr<JIT>();
+        jit->errorManager = &nativeErrors;
+        if (!jit->initialize() || !loadNative(*jit, modules, false)) {
+            jit.reset();
+            jitFailed = true;
+        }
+        return jit.get();
+    };
+
+    // symbol names of globals are the same in every LLVM module, this generator never generates one
+    llvm::LLVMContext namingContext;
+    IRGenerator naming(namingContext);
+    naming.sourceFolder = program.input.sourceFolder;
+    naming.declareProgram(modules);
+
+    Interpreter interpreter;
+    interpreter.errorManager = &errorManager;
+    interpreter.compileNative = [&](FunctionNode* function) -> NativeBridge {
+        JIT* native = startNative();
+        if (!native) return nullptr;
+
+        auto context = makeMemoryPtr<llvm::LLVMContext>();
+        IRGenerator generator(*context);
+        generator.errorManager = &nativeErrors;
+        generator.sourceFolder = program.input.sourceFolder;
+        generator.targetTriple = native->triple();
+        generator.dataLayout = native->dataLayout();
+        generator.declareProgram(modules);
+
+        MemoryPtr<llvm::Module> module = generator.generateBridge(function);
+        if (!module || !native->addModule(std::move(module), std::move(context))) return nullptr;
+        return reinterpret_cast<NativeBridge>(native->lookup(generator.bridgeName(function)));
+    };
+    interpreter.locateNative = [&](DeclarationNode* declaration) -> void* {
+        JIT* native = startNative();
+        return native ? native->lookup(naming.globalName(declaration)) : nullptr;
+    };
+    return interpreter.run(bytecode);
+}
+
+std::optional<int> Compiler::executeNative(const std::vector<ModuleNode*>& modules) {
+    JIT jit;
+    jit.errorManager = &errorManager;
+    if (!jit.initialize() || !loadNative(jit, modules, true)) return std::nullopt;
+    return jit.run();
+}
+
+bool Compiler::loadNative(JIT& jit, const std::vector<ModuleNode*>& modules, bool collected) {
+    Codegen verifier;
+    verifier.errorManager = jit.errorManager;
+
+    // every module keeps its own context, as if it went to its own object file
+    for (ModuleNode* node : modules) {
+        auto context = makeMemoryPtr<llvm::LLVMContext>();
+        IRGenerator generator(*context);
+        generator.errorManager = jit.errorManager;
+        generator.sourceFolder = program.input.sourceFolder;
+        generator.targetTriple = jit.triple();
+        generator.dataLayout = jit.dataLayout();
+        if (collected) {
+            generator.garbageCollector = collectorSettings(program.input.settings);
+            generator.referenceCounting = referenceCountingSettings(program.input.settings);
+        }
+        generator.declareProgram(modules);
+
+        MemoryPtr<llvm::Module> module = generator.generate(IRGenerator::modulePath(node->filePath, program.input.sourceFolder), {node}, program.entryPoint.function);
+        if (jit.errorManager->hasErrors() || !verifier.verify(*module)) return false;
+        if (!jit.addModule(std::move(module), std::move(context))) return false;
+    }
+    return true;
+}
+
+void Compiler::check(bool jsonOutput) {
+    analyze();
+    report(jsonOutput);
+}
 
+void Compiler::report(bool jsonOutput) {
     if (errorManager.hasErrors()) {
         if (jsonOutput) {
             std::println(std::cout, "{}", json::stringify(errorManager.toJson(), {.pretty = true, .emit_comments = false}));
@@ -1,11 +1,19 @@
 #pragma once
 #include <map>
+#include <unordered_map>
 
 #include "Frontend/Lexer/Lexer.hpp"
 #include "Frontend/Parser/Parser.hpp"
 #include "Extras/ErrorManager/ErrorManager.hpp"
+#include "Extras/QueryEngine/QueryEngine.hpp"
+#include "Extras/SymbolIndex/SymbolIndex.hpp"
 #include "Frontend/SemanticAnalysis/SemanticAnalysis.hpp"
 #include "Frontend/Orchestrator/Orchestrator.hpp"
+#include "Frontend/FlowAnalysis/FlowAnalysis.hpp"
+#include "Middleend/Optimizer/ConstantFolder.hpp"
+#include "Backend/Codegen/Codegen.hpp"
+
+struct JIT;
 
 enum class OutputType { Executable, StaticLibrary, SharedLibrary, Object, IR, LLVM_IR, None };
 
@@ -31,18 +39,42 @@ struct CompilerSettings {
          * @brief `level` is an option of `Memory` struct that goes through types of Memory options and, depending on chosen option, will manage the memory in the application the preferred way.
          * @param Default - enables default Garbage Collector (Java, C#, others)
          * @param ARC - enables Automatic Reference Counter (Python, JS, others)
-         * @param Rusty - enables Borrow Checker (Rust)
+         * @param Rusty - enables Borrow Checker (Rust): one owner for every value, checked at compile time, no GC or reference counts at runtime
          * @param None - No memory management tools (C, C++, maybe others)
          */
         MemoryOptions level = MemoryOptions::Default;
+
+        // The garbage collector of `Default`, set with `heapSize`, `gcPause` and `gcStats` in `[compiler]`
+        uint64_t heapSize = 0; // MiB the heap may grow to, 0 for no limit
+        double pauseTarget = 1.0; // milliseconds a minor collection should stay under
+        bool gcStats = false; // the program prints its collections and their pauses to stderr when it ends
+        // ARC prints its objects and counts to stderr when the program ends with `arcStats`
+        bool arcStats = false;
     };
+    // Set with `memory = "default" | "arc" | "rusty" | "none"` in `[compiler]`
+    Memory memory;
+
+    enum class LTO { None, Thin };
+    /**
+     * @brief `lto` is an option that picks link-time optimization for executables and libraries. Set with `lto = "thin"` in `[compiler]` or `--lto=thin`.
+     * @param None - every module is optimized on its own, calls between modules are never inlined
+     * @param Thin - ThinLTO: modules are summarized, and functions are imported and inlined across them at link time. Its results are cached in the build folder.
+     */
+    LTO lto = LTO::None;
+
+    // The LLVM target triple the project is built for, set with `target = "..."` in `[compiler]`. Empty is the host,
+    // and `neoluma run` always runs on the host.
+    std::string target;
 };
 
 struct CompilationInput {
+    std::string name; // of the project, outputs are named after it
     OutputType targetOutput;
     std::vector<std::filesystem::path> files;
     std::map<std::string, std::filesystem::path> dependencies;
     CompilerSettings settings;
+    std::filesystem::path sourceFolder; // project files are relative to it
+    std::filesystem::path buildFolder; // symbol indexes are written under `index/`, nothing is written if it's empty. Outputs go here too.
 };
 
 // Program is a class that stores results of compilation here for easy access to all information
@@ -50,19 +82,56 @@ struct Program {
     CompilationInput input; // Compilation data for the compiler
 
     // Parser result
-    std::vector<MemoryPtr<ModuleNode>> modules; // all files of the project
+    std::vector<MemoryPtr<ModuleNode>> modules; // all files of the project, in the order of Compiler's source list (index = ModuleId)
 
     // Orchestrator result
     std::vector<ModuleInfo> moduleInfos;
     EntryPoint entryPoint;
     std::vector<ModuleId> order;
 
-    // global namespaces for the entire program
-    std::unordered_map<std::string, NamespaceInfo> namespaces;
+    // global namespace tree for the entire program (root level has no name)
+    MemoryPtr<NamespaceInfo> namespaces;
+
+    // Semantic Analysis result: every expression node points to one of these types
+    MemoryPtr<TypeContext> types;
+
+    // Dependency modules whose symbol index is up to date. They aren't parsed at all, their namespaces are backed by these.
+    std::vector<SymbolIndex> symbolIndexes;
+
+    // Backend result: the file compile() wrote, of the requested OutputType
+    std::filesystem::path output;
 };
 
 /**
  * @brief Compiler is a general class that allows Neoluma compiler to turn source code into machine code.
+ *
+ * Every stage runs as a query of the QueryEngine, so a Compiler kept alive between checks only redoes
+ * the work an edit invalidates:
+ * - `source:F` - text of file F (input)
+ * - `tokens:F` - Lexer output for F
+ * - `ast:F` - Parser output for F, stored in `program.modules`
+ * - `exports:F` - fingerprint of everything F declares for other modules (signatures, constants, @comptime bodies)
+ * - `program` - Orchestrator output: imports, namespaces, entry point and module order
+ * - `analysis:F` - Semantic Analysis of F; depends on the exports of other modules and on the trees it resolved calls into
+ * - `fold:F` - Constant Folder over F, only run when the whole program is free of errors
+ * - `flow:F` - Flow Analysis over the folded F: control flow graphs, flow errors and dead code removal
+ *
+ * A module that passed every stage gets its SymbolIndex written to the build folder. Dependencies with an up-to-date
+ * index are not compiled again at all: the index stands in for their source.
+ *
+ * compile() goes on past the queries. For executables and libraries every module is lowered by the IR Generator into
+ * its own LLVM module and object file, in parallel, and the objects are linked at the end. Outputs that are a single
+ * file (`obj`, `llvm_ir`) get the whole program in one LLVM module. With ThinLTO the modules are written as bitcode
+ * and optimized across each other at link time. In the default memory mode strings are garbage collected, the
+ * collector's runtime is generated into the modules along with them. `ir` is the program in NIR, the Neoluma IR,
+ * after the passes that know the language ran over it. In ARC memory mode that includes reference counting, with what
+ * can be elided gone. It's the only output of that mode so far: the IR Generator doesn't count references, so
+ * executables, libraries and run() reject it.
+ *
+ * run() doesn't write anything. The program starts in the Interpreter as Bytecode, and a function that gets hot is
+ * promoted to the JIT, which compiles it and every function it calls on their first call. A program using something
+ * the Interpreter doesn't have goes to the JIT as a whole. Only a program that runs on the JIT as a whole has its
+ * strings collected: the Interpreter's registers aren't roots the collector could see.
  */
 class Compiler {
 public:
@@ -70,18 +139,48 @@ public:
     Compiler(const CompilationInput& input);
 
     // Functions
-    void compile(); // compiled way
-    void check(bool jsonOutput = false);
-    void run(); // interpreted way
+    bool compile(); // compiled way, false if there were errors (they are printed)
+    void check(bool jsonOutput = false); // can be called again after the sources changed, only affected queries re-run
+    int run(); // JIT way: the program runs inside the compiler, its result is returned (1 if there were errors, they are printed)
 
     ErrorManager errorManager;
 
     // Data
     Program program;
+    QueryEngine queries;
 private:
     // All parts of compiler
     Lexer lexer;
     Parser parser;
     Orchestrator orchestrator;
     SemanticAnalysis semanticAnalysis;
+    ConstantFolder constantFolder;
+    FlowAnalysis flowAnalysis;
+    Codegen codegen;
+
+    std::vector<std::string> sourceFiles; // project files and dependencies, in ModuleId order
+    std::unordered_map<std::string, ModuleId> moduleIds;
+    uint64_t parses = 0, rewrites = 0; // fingerprints of queries whose results are new on every run
+
+    // Dependencies are looked at once per Compiler: the ones with a fresh index go to `program.symbolIndexes`, the rest are compiled
+    bool dependenciesLoaded = false;
+    std::vector<std::string> dependencySources;
+    std::unordered_map<std::string, uint64_t> sourceFingerprints;
+    std::vector<std::string> indexQueue; // modules whose flow ran in this check, their index is written once the program is clean
+    std::unordered_map<std::string, uint64_t> indexedSources; // modules outside the program order, by the source their index was written from
+
+    void defineQueries();
+    void analyze(); // brings every query up to date and leaves their errors in the ErrorManager
+    void generate(); // IR Generator and Backend over a program that passed analysis
+    std::vector<std::filesystem::path> generateObjects(const std::vector<ModuleNode*>& modules, bool bitcode); // an object (or ThinLTO bitcode) file per module, on all cores
+    std::optional<int> execute(); // Interpreter with JIT promotion over a program that passed analysis
+    std::optional<int> executeNative(const std::vector<ModuleNode*>& modules); // JIT alone
+    bool loadNative(JIT& jit, const std::vector<ModuleNode*>& modules, bool collected); // IR Generator over every module into the JIT, errors go where the JIT's do
+    std::vector<ModuleId> moduleOrder() const; // parsed modules, in `program.order` first
+    void report(bool jsonOutput);
+    std::vector<std::string> collectSources();
+    void loadDependencies();
+    std::filesystem::path indexPath(const std::string& file) const; // empty if indexes aren't written
+    void writeIndexes(const std::vector<std::string>& analyzed);
+    uint64_t programFingerprint() const;
 };
\ No newline at end of file
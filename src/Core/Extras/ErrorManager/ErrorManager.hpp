@@ -125,6 +125,16 @@ enum struct AnalysisErrors {
     // Inference
     TypeInferenceFailed,
     AmbiguousType,
+
+    // Compile-time evaluation
+    ComptimeEvaluationFailed,
+
+    // Ownership (Rusty memory mode)
+    UseAfterMove,
+    BorrowConflict,
+
+    // Tasks
+    DiscardedTask,
 };
 
 // NPrE{x}
@@ -149,7 +159,11 @@ enum struct PreprocessorErrors {
     DirectiveInWrongContext,
 
     // ???
-    InvalidConsoleArgument
+    InvalidConsoleArgument,
+
+    // Queries
+    QueryCycle,
+    QueryWithoutProvider,
 };
 
 //NCoE{x}
@@ -0,0 +1,162 @@
+#include "QueryEngine.hpp"
+
+#include <algorithm>
+
+// ==== Registration and inputs ====
+
+void QueryEngine::define(const std::string& kind, Provider provider) {
+    providers[kind] = std::move(provider);
+}
+
+bool QueryEngine::setInput(const std::string& kind, const std::string& argument, std::any value, uint64_t fingerprint) {
+    Memo& memo = memos[intern(kind, argument)];
+    memo.isInput = true;
+    if (memo.hasValue && memo.fingerprint == fingerprint) return false;
+
+    currentRevision++;
+    memo.value = std::move(value);
+    memo.fingerprint = fingerprint;
+    memo.hasValue = true;
+    memo.changedAt = memo.verifiedAt = currentRevision;
+    return true;
+}
+
+void QueryEngine::invalidate(const std::string& kind, const std::string& argument) {
+    memos[intern(kind, argument)].forced = true;
+    currentRevision++; // everything verified so far has to be verified again
+}
+
+// ==== Queries ====
+
+const std::any& QueryEngine::get(const std::string& kind, const std::string& argument) {
+    QueryId id = intern(kind, argument);
+    ensureFresh(id);
+    record(id);
+    return memos[id].value;
+}
+
+bool QueryEngine::contains(const std::string& kind, const std::string& argument) const {
+    auto it = ids.find(kind + ":" + argument);
+    return it != ids.end() && memos[it->second].hasValue;
+}
+
+bool QueryEngine::isGreen(const std::string& kind, const std::string& argument) {
+    QueryId id = intern(kind, argument);
+    Memo& memo = memos[id];
+    if (!memo.hasValue || memo.forced) return false;
+    if (memo.isInput || memo.verifiedAt == currentRevision) return true;
+
+    if (!dependenciesUnchanged(id)) return false;
+    memo.verifiedAt = currentRevision;
+    stats.reused++;
+    return true;
+}
+
+const std::vector<Error>& QueryEngine::diagnostics(const std::string& kind, const std::string& argument) {
+    return memos[intern(kind, argument)].diagnostics;
+}
+
+// ==== Fingerprints ====
+
+void QueryEngine::mix(uint64_t& seed, std::string_view value) {
+    for (unsigned char c : value) {
+        seed ^= c;
+        seed *= 1099511628211ull;
+    }
+    mix(seed, static_cast<uint64_t>(value.size())); // so ("ab", "c") and ("a", "bc") differ
+}
+
+void QueryEngine::mix(uint64_t& seed, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        seed ^= (value >> (i * 8)) & 0xff;
+        seed *= 1099511628211ull;
+    }
+}
+
+// ==== Red/green validation ====
+
+QueryEngine::QueryId QueryEngine::intern(const std::string& kind, const std::string& argument) {
+    auto [it, inserted] = ids.try_emplace(kind + ":" + argument, static_cast<QueryId>(memos.size()));
+    if (inserted) {
+        memos.emplace_back();
+        memos.back().kind = kind;
+        memos.back().argument = argument;
+    }
+    return it->second;
+}
+
+void QueryEngine::record(QueryId id) {
+    if (active.empty()) return;
+    auto& dependencies = memos[active.back()].dependencies;
+    if (std::find(dependencies.begin(), dependencies.end(), id) == dependencies.end()) dependencies.push_back(id);
+}
+
+void QueryEngine::ensureFresh(QueryId id) {
+    Memo& memo = memos[id];
+    if (memo.running) {
+        // providers never ask for themselves, a cycle is a bug in the Compiler and the old value is the best we have
+        reportBug(PreprocessorErrors::QueryCycle, memo, memo.kind + ":" + memo.argument);
+        return;
+    }
+    if (memo.isInput) return;
+
+    if (memo.hasValue && !memo.forced) {
+        if (memo.verifiedAt == currentRevision) return;
+        if (dependenciesUnchanged(id)) {
+            memo.verifiedAt = currentRevision;
+            stats.reused++;
+            return;
+        }
+    }
+    execute(id);
+}
+
+bool QueryEngine::dependenciesUnchanged(QueryId id) {
+    // dependencies are checked in the order they were asked for: a later one may only exist because of an earlier one's value
+    for (QueryId dependency : memos[id].dependencies) {
+        ensureFresh(dependency);
+        if (memos[dependency].changedAt > memos[id].verifiedAt) return false;
+    }
+    return true;
+}
+
+void QueryEngine::execute(QueryId id) {
+    Memo& memo = memos[id];
+    auto provider = providers.find(memo.kind);
+    if (provider == providers.end()) {
+        reportBug(PreprocessorErrors::QueryWithoutProvider, memo, memo.kind);
+        return;
+    }
+
+    memo.running = true;
+    memo.dependencies.clear();
+    active.push_back(id);
+
+    // errors of this query are collected separately, nested queries do the same for theirs
+    std::vector<Error> outer;
+    if (errorManager) { outer = std::move(errorManager->errors); errorManager->errors.clear(); }
+
+    Result result = provider->second(memo.argument);
+
+    if (errorManager) { memo.diagnostics = std::move(errorManager->errors); errorManager->errors = std::move(outer); }
+    active.pop_back();
+    memo.running = false;
+    stats.executed++;
+
+    // early cutoff: a re-run that produced the same result doesn't count as a change
+    if (!memo.hasValue || memo.fingerprint != result.fingerprint) memo.changedAt = currentRevision;
+    memo.value = std::move(result.value);
+    memo.fingerprint = result.fingerprint;
+    memo.hasValue = true;
+    memo.forced = false;
+    memo.verifiedAt = currentRevision;
+}
+
+void QueryEngine::reportBug(PreprocessorErrors type, const Memo& memo, const std::string& subject) {
+    // lands in the diagnostics of the query that asked, so it's shown with the rest of its errors
+    if (!errorManager) return;
+    std::string key = type == PreprocessorErrors::QueryCycle ? "QueryCycle" : "QueryWithoutProvider";
+    errorManager->addError(ErrorType::Preprocessor, type, ErrorSpan{"", memo.argument, 0, 0},
+        "ErrorManager.Preprocessor." + key + ".message", {subject},
+        "ErrorManager.Preprocessor." + key + ".hint");
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <any>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Core/Extras/ErrorManager/ErrorManager.hpp"
+
+/* Query Engine is the memoized core of the Compiler. Every stage is a query named `kind:argument`
+ * ("tokens:src/main.nm", "exports:src/math.nm"), computed by the provider registered for its kind.
+ * While a provider runs, every query it asks for is recorded as its dependency.
+ *
+ * Results are validated red/green: after an input changes, a query is green (reused) if none of its dependencies
+ * changed since it was last verified, and red (re-run) otherwise. If a re-run produces the same fingerprint as before,
+ * the query counts as unchanged, so its dependents stay green (early cutoff): editing a function body re-parses the file,
+ * but the exports of the module stay the same and nothing that only sees its declarations runs again.
+ *
+ * Errors reported while a provider runs are stored with its result, so a reused query still shows them.
+ */
+struct QueryEngine {
+    using Revision = uint64_t;
+    using QueryId = uint32_t;
+
+    struct Result {
+        std::any value;
+        uint64_t fingerprint = 0; // equal fingerprints mean equal results, this is what early cutoff compares
+    };
+    using Provider = std::function<Result(const std::string& argument)>;
+
+    // ErrorManager is used to capture errors of every query
+    ErrorManager* errorManager = nullptr;
+
+    void define(const std::string& kind, Provider provider);
+
+    // Inputs are set from the outside. Returns true (and starts a new revision) only if the fingerprint changed.
+    bool setInput(const std::string& kind, const std::string& argument, std::any value, uint64_t fingerprint);
+    // Forces a derived query to run again the next time it's asked for, even if its dependencies are green.
+    void invalidate(const std::string& kind, const std::string& argument);
+
+    // Returns the up-to-date value, running the provider only if needed. Inside a provider it also records the dependency.
+    const std::any& get(const std::string& kind, const std::string& argument = "");
+    template<typename T>
+    const T& get(const std::string& kind, const std::string& argument = "") { return std::any_cast<const T&>(get(kind, argument)); }
+
+    // Has the query ever produced a result?
+    bool contains(const std::string& kind, const std::string& argument = "") const;
+    // Checks whether the last result can be reused without running the query itself. Dependencies may run to find out.
+    bool isGreen(const std::string& kind, const std::string& argument = "");
+
+    // Errors reported by the query itself, not by the queries it asked for
+    const std::vector<Error>& diagnostics(const std::string& kind, const std::string& argument = "");
+
+    Revision revision() const { return currentRevision; }
+
+    // How many providers ran and how many results were reused since the engine was created
+    struct Statistics { size_t executed = 0; size_t reused = 0; };
+    const Statistics& statistics() const { return stats; }
+
+    // Small helpers to build fingerprints: start from `fingerprintSeed` and mix every part in (FNV-1a)
+    static constexpr uint64_t fingerprintSeed = 14695981039346656037ull;
+    static void mix(uint64_t& seed, std::string_view value);
+    static void mix(uint64_t& seed, uint64_t value);
+
+private:
+    struct Memo {
+        std::string kind;
+        std::string argument;
+        bool isInput = false;
+        bool hasValue = false;
+        bool forced = false; // invalidated, must run again
+        bool running = false; // on the stack right now, used to catch cycles
+
+        std::any value;
+        uint64_t fingerprint = 0;
+        Revision changedAt = 0; // last revision where the value actually changed
+        Revision verifiedAt = 0; // last revision where the value was known to be up to date
+
+        std::vector<QueryId> dependencies; // in the order they were asked for
+        std::vector<Error> diagnostics;
+    };
+
+    std::unordered_map<std::string, Provider> providers;
+    std::unordered_map<std::string, QueryId> ids; // "kind:argument" -> id
+    std::deque<Memo> memos; // deque keeps references stable while nested queries are interned
+    std::vector<QueryId> active; // queries being computed, innermost last
+
+    Revision currentRevision = 1;
+    Statistics stats;
+
+    QueryId intern(const std::string& kind, const std::string& argument);
+    void record(QueryId id); // adds a dependency to the innermost active query
+    void ensureFresh(QueryId id);
+    bool dependenciesUnchanged(QueryId id); // deep check, brings every dependency up to date first
+    void execute(QueryId id);
+    // Cycles and missing providers are bugs in the Compiler, they are still reported instead of crashing later
+    void reportBug(PreprocessorErrors type, const Memo& memo, const std::string& subject);
+};
@@ -0,0 +1,291 @@
+#include "SymbolIndex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#include "Core/Frontend/SemanticAnalysis/Types.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ==== Writing ====
+
+std::string namespacePath(const ASTNode* name) {
+    if (!name) return "";
+    if (name->type == ASTNodeType::MemberAccess) {
+        auto* access = static_cast<const MemberAccessNode*>(name);
+        return namespacePath(access->parent.get()) + "." + namespacePath(access->val.get());
+    }
+    if (name->type == ASTNodeType::Variable) return static_cast<const VariableNode*>(name)->varName;
+    return "";
+}
+
+namespace {
+
+struct PendingEntry {
+    std::string name;
+    std::string signature;
+    SymbolIndex::Kind kind;
+    uint8_t flags = 0;
+    int line = 0, column = 0;
+};
+
+bool hasModifier(const std::vector<MemoryPtr<ModifierNode>>& modifiers, ASTModifierType type) {
+    return std::any_of(modifiers.begin(), modifiers.end(), [type](const auto& modifier) { return modifier->modifier == type; });
+}
+
+std::string encodeType(const Type* type) {
+    std::string out;
+    if (type) type->encode(out);
+    else out += static_cast<char>(Type::Kind::Dynamic); // never analyzed, nothing is known about it
+    return out;
+}
+
+void collect(const std::vector<MemoryPtr<ASTNode>>& body, const std::string& prefix, std::vector<PendingEntry>& entries) {
+    auto add = [&](const std::string& name, SymbolIndex::Kind kind, const ASTNode* node, std::string signature = "", uint8_t flags = 0) {
+        entries.push_back(PendingEntry{prefix.empty() ? name : prefix + "." + name, std::move(signature), kind, flags, node->line, node->column});
+    };
+
+    for (const auto& statement : body) {
+        switch (statement->type) {
+            case ASTNodeType::Namespace: {
+                auto* node = static_cast<NamespaceNode*>(statement.get());
+                std::string path = namespacePath(node->name.get());
+                std::string full = prefix.empty() ? path : prefix + "." + path;
+
+                // every level gets an entry, so a reader can open `std` and `std.math` without looking at the members
+                size_t dot = prefix.size();
+                while ((dot = full.find('.', dot + 1)) != std::string::npos)
+                    entries.push_back(PendingEntry{full.substr(0, dot), "", SymbolIndex::Kind::Namespace, 0, node->line, node->column});
+                entries.push_back(PendingEntry{full, "", SymbolIndex::Kind::Namespace, 0, node->line, node->column});
+
+                collect(node->body, full, entries);
+                break;
+            }
+            case ASTNodeType::Function: {
+                auto* node = static_cast<FunctionNode*>(statement.get());
+                std::string signature = encodeType(node->inferredType);
+                auto count = static_cast<uint32_t>(node->parameters.size());
+                signature.append(reinterpret_cast<const char*>(&count), sizeof(count));
+                for (const auto& parameter : node->parameters) {
+                    signature += static_cast<char>(parameter->defaultValue != nullptr);
+                    auto length = static_cast<uint32_t>(parameter->parameterName.size());
+                    signature.append(reinterpret_cast<const char*>(&length), sizeof(length));
+                    signature += parameter->parameterName;
+                }
+                add(node->name, SymbolIndex::Kind::Function, node, std::move(signature),
+                    (node->isIntrinsic ? SymbolIndex::Intrinsic : 0) | (node->isAsync ? SymbolIndex::Async : 0));
+                break;
+            }
+            case ASTNodeType::Class: {
+                auto* node = static_cast<ClassNode*>(statement.get());
+                add(node->name, SymbolIndex::Kind::Class, node, "", hasModifier(node->modifiers, ASTModifierType::Const) ? SymbolIndex::Constant : 0);
+                break;
+            }
+            case ASTNodeType::Enum: add(static_cast<EnumNode*>(statement.get())->name, SymbolIndex::Kind::Enum, statement.get()); break;
+            case ASTNodeType::Interface: add(static_cast<InterfaceNode*>(statement.get())->name, SymbolIndex::Kind::Interface, statement.get()); break;
+            case ASTNodeType::Decorator: add(static_cast<DecoratorNode*>(statement.get())->name, SymbolIndex::Kind::Decorator, statement.get()); break;
+            case ASTNodeType::Declaration: {
+                auto* node = static_cast<DeclarationNode*>(statement.get());
+                add(node->variable->varName, SymbolIndex::Kind::Variable, node, encodeType(node->inferredType),
+                    hasModifier(node->modifiers, ASTModifierType::Const) ? SymbolIndex::Constant : 0);
+                break;
+            }
+            default: break; // imports and statements declare nothing
+        }
+    }
+}
+
+} // namespace
+
+bool SymbolIndex::write(const std::filesystem::path& path, const ModuleNode* module, uint64_t sourceFingerprint) {
+    if (!module) return false;
+
+    std::vector<PendingEntry> pending;
+    collect(module->body, "", pending);
+
+    // namespaces opened by several declarations of the module are written once
+    std::stable_sort(pending.begin(), pending.end(), [](const PendingEntry& a, const PendingEntry& b) { return a.name < b.name; });
+    pending.erase(std::unique(pending.begin(), pending.end(), [](const PendingEntry& a, const PendingEntry& b) {
+        return a.kind == Kind::Namespace && b.kind == Kind::Namespace && a.name == b.name;
+    }), pending.end());
+
+    std::string strings;
+    auto intern = [&strings](std::string_view value) {
+        auto offset = static_cast<uint32_t>(strings.size());
+        strings += value;
+        return offset;
+    };
+
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.sourceFingerprint = sourceFingerprint;
+    header.entryCount = static_cast<uint32_t>(pending.size());
+    header.fileLength = static_cast<uint32_t>(module->filePath.size());
+    header.file = intern(module->filePath);
+
+    std::vector<Entry> table;
+    table.reserve(pending.size());
+    for (const auto& entry : pending) {
+        if (entry.name.find('.') == std::string::npos && entry.kind != Kind::Namespace) header.globals++;
+
+        Entry written{};
+        written.nameLength = static_cast<uint32_t>(entry.name.size());
+        written.name = intern(entry.name);
+        written.signatureLength = static_cast<uint32_t>(entry.signature.size());
+        written.signature = intern(entry.signature);
+        written.line = entry.line;
+        written.column = entry.column;
+        written.kind = entry.kind;
+        written.flags = entry.flags;
+        table.push_back(written);
+    }
+    header.stringsSize = static_cast<uint32_t>(strings.size());
+
+    // written next to the final file and renamed over it, so a reader never maps half of an index
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(Entry)));
+        out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+        if (!out) return false;
+    }
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
+
+// ==== Reading ====
+
+SymbolIndex::SymbolIndex(SymbolIndex&& other) noexcept { *this = std::move(other); }
+
+SymbolIndex& SymbolIndex::operator=(SymbolIndex&& other) noexcept {
+    if (this == &other) return *this;
+    close();
+    header = std::exchange(other.header, nullptr);
+    table = std::exchange(other.table, nullptr);
+    strings = std::exchange(other.strings, nullptr);
+    mapping = std::exchange(other.mapping, nullptr);
+    mappingSize = std::exchange(other.mappingSize, 0);
+#ifdef _WIN32
+    fileHandle = std::exchange(other.fileHandle, nullptr);
+    mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+    return *this;
+}
+
+SymbolIndex::~SymbolIndex() { close(); }
+
+void SymbolIndex::close() {
+    if (mapping) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        fileHandle = mappingHandle = nullptr;
+#else
+        munmap(mapping, mappingSize);
+#endif
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    table = nullptr;
+    strings = nullptr;
+}
+
+bool SymbolIndex::open(const std::filesystem::path& path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(Header))) { CloseHandle(file); return false; }
+    HANDLE view = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!view) { CloseHandle(file); return false; }
+    mapping = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+    if (!mapping) { CloseHandle(view); CloseHandle(file); return false; }
+    fileHandle = file;
+    mappingHandle = view;
+    mappingSize = static_cast<size_t>(size.QuadPart);
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+    struct stat status{};
+    if (fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(Header))) { ::close(file); return false; }
+    void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file); // the mapping keeps the file alive
+    if (view == MAP_FAILED) return false;
+    mapping = view;
+    mappingSize = static_cast<size_t>(status.st_size);
+#endif
+
+    // everything is bounds-checked once here, lookups trust the offsets after that
+    auto* candidate = static_cast<const Header*>(mapping);
+    size_t tableSize = static_cast<size_t>(candidate->entryCount) * sizeof(Entry);
+    bool valid = std::memcmp(candidate->magic, magic, sizeof(magic)) == 0 && candidate->version == version
+        && sizeof(Header) + tableSize + candidate->stringsSize == mappingSize
+        && static_cast<uint64_t>(candidate->file) + candidate->fileLength <= candidate->stringsSize;
+
+    auto* entries = reinterpret_cast<const Entry*>(static_cast<const char*>(mapping) + sizeof(Header));
+    for (uint32_t i = 0; valid && i < candidate->entryCount; i++) {
+        const Entry& entry = entries[i];
+        valid = static_cast<uint64_t>(entry.name) + entry.nameLength <= candidate->stringsSize
+            && static_cast<uint64_t>(entry.signature) + entry.signatureLength <= candidate->stringsSize
+            && entry.kind <= Kind::Variable;
+    }
+    if (!valid) { close(); return false; }
+
+    header = candidate;
+    table = entries;
+    strings = static_cast<const char*>(mapping) + sizeof(Header) + tableSize;
+    return true;
+}
+
+std::span<const SymbolIndex::Entry> SymbolIndex::entries() const {
+    if (!header) return {};
+    return std::span<const Entry>(table, header->entryCount);
+}
+
+std::span<const SymbolIndex::Entry> SymbolIndex::find(std::string_view name) const {
+    auto all = entries();
+    auto [first, last] = std::equal_range(all.begin(), all.end(), name, [this](const auto& a, const auto& b) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(a)>, Entry>) return this->name(a) < b;
+        else return a < this->name(b);
+    });
+    return std::span<const Entry>(first, last);
+}
+
+std::vector<SymbolIndex::Parameter> SymbolIndex::parameters(std::string_view bytes) {
+    std::vector<Parameter> result;
+    if (bytes.empty()) return result;
+    uint32_t count = 0;
+    if (bytes.size() < sizeof(count)) return result;
+    std::memcpy(&count, bytes.data(), sizeof(count));
+    bytes.remove_prefix(sizeof(count));
+
+    for (uint32_t i = 0; i < count && bytes.size() >= 1 + sizeof(uint32_t); i++) {
+        bool hasDefault = bytes[0] != 0;
+        uint32_t length = 0;
+        std::memcpy(&length, bytes.data() + 1, sizeof(length));
+        bytes.remove_prefix(1 + sizeof(length));
+        if (bytes.size() < length) break;
+        result.push_back(Parameter{bytes.substr(0, length), hasDefault});
+        bytes.remove_prefix(length);
+    }
+    return result;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Core/Frontend/Nodes.hpp"
+
+/* Symbol Index is the compiled interface of one module: every name it exports, with its kind, signature and position,
+ * in a flat binary file that is mapped into memory as is and binary-searched, never parsed.
+ * The Compiler writes one for every module it analyzed, and loads dependency modules from them instead of their source,
+ * so importing a large package costs a lookup per name actually used instead of parsing and analyzing the whole package.
+ *
+ * Layout (native endianness, the magic tells a foreign one apart):
+ *   Header | Entry[entryCount], sorted by name | string table
+ * Names are full paths ("std.math.abs"). Overloads are adjacent entries with the same name, in declaration order.
+ */
+struct SymbolIndex {
+    enum class Kind : uint8_t { Namespace, Function, Class, Enum, Interface, Decorator, Variable };
+
+    enum Flags : uint8_t {
+        Intrinsic = 1 << 0, // function without a body, provided by the compiler
+        Constant = 1 << 1,
+        Async = 1 << 2, // function whose calls give a task<T>
+    };
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceFingerprint; // of the text the index was written from, a mismatch means it's stale
+        uint32_t entryCount;
+        uint32_t stringsSize;
+        uint32_t file, fileLength; // source path, in the string table
+        uint32_t globals; // entries outside any namespace; such a module can't be replaced by its index
+        uint32_t reserved;
+    };
+
+    struct Entry {
+        uint32_t name, nameLength;
+        uint32_t signature, signatureLength; // encoded type and parameters, see below
+        int32_t line, column;
+        Kind kind;
+        uint8_t flags;
+        uint16_t reserved;
+        uint32_t padding;
+    };
+
+    /* Signature blob of an entry: the encoded Type (Type::encode) followed, for functions, by
+     * a u32 parameter count and every parameter as [has default byte][u32 name length][name].
+     */
+    struct Parameter {
+        std::string_view name;
+        bool hasDefault;
+    };
+
+    static constexpr char magic[4] = {'N', 'L', 'S', 'I'};
+    static constexpr uint32_t version = 6;
+
+    SymbolIndex() = default;
+    SymbolIndex(SymbolIndex&& other) noexcept;
+    SymbolIndex& operator=(SymbolIndex&& other) noexcept;
+    SymbolIndex(const SymbolIndex&) = delete;
+    SymbolIndex& operator=(const SymbolIndex&) = delete;
+    ~SymbolIndex();
+
+    // Writes the index of an analyzed module. Types are taken from `inferredType`, so it must run after Semantic Analysis.
+    static bool write(const std::filesystem::path& path, const ModuleNode* module, uint64_t sourceFingerprint);
+    // Maps an index into memory. Returns false (and stays empty) if the file is missing, malformed or from another version.
+    bool open(const std::filesystem::path& path);
+    bool isOpen() const { return header != nullptr; }
+
+    // Every entry named `name`, overloads included. Empty if there's none.
+    std::span<const Entry> find(std::string_view name) const;
+    std::span<const Entry> entries() const;
+
+    std::string_view name(const Entry& entry) const { return string(entry.name, entry.nameLength); }
+    std::string_view signature(const Entry& entry) const { return string(entry.signature, entry.signatureLength); }
+    std::string_view file() const { return header ? string(header->file, header->fileLength) : std::string_view(); }
+    uint64_t sourceFingerprint() const { return header ? header->sourceFingerprint : 0; }
+    bool hasGlobals() const { return header && header->globals; }
+
+    // Reads the parameters that follow the type of a function signature, once TypeContext::decode() consumed the type
+    static std::vector<Parameter> parameters(std::string_view bytes);
+
+private:
+    const Header* header = nullptr;
+    const Entry* table = nullptr;
+    const char* strings = nullptr;
+
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+
+    std::string_view string(uint32_t offset, uint32_t length) const { return std::string_view(strings + offset, length); }
+    void close();
+};
+
+// `std.math` for the name of a namespace declaration, which is written as a chain of member accesses
+std::string namespacePath(const ASTNode* name);
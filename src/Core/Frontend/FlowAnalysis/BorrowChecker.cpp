@@ -0,0 +1,258 @@
+#include "BorrowChecker.hpp"
+
+#include <unordered_map>
+
+#include "Core/Frontend/SemanticAnalysis/Types.hpp"
+
+using BlockId = ControlFlowGraph::BlockId;
+using VariableId = ControlFlowGraph::VariableId;
+using Element = ControlFlowGraph::Element;
+
+void BorrowChecker::check(ControlFlowGraph& graph) {
+    reported.clear();
+    BitSet owned = ownedVariables(graph);
+    checkMoves(graph, owned);
+    checkBorrows(graph, owned);
+}
+
+// ==== Ownership ====
+
+// Values that own memory: giving them away gives that memory away. The rest is copied.
+static bool isOwned(const Type* type) {
+    if (!type) return false; // didn't type-check, reported already
+    switch (type->kind) {
+        case Type::Kind::Primitive: return type->isPrimitive(ResolvedType::Str);
+        case Type::Kind::Nullable: return isOwned(type->element());
+        case Type::Kind::Null: return false;
+        default: return true;
+    }
+}
+
+BitSet BorrowChecker::ownedVariables(const ControlFlowGraph& graph) const {
+    BitSet owned(graph.variables.size());
+    for (size_t id = 0; id < graph.variables.size(); id++) {
+        const auto& variable = graph.variables[id];
+        ASTNode* declaration = variable.declaration;
+        bool result = false;
+        if (variable.isIterator) result = false; // never given away, only borrows
+        else if (declaration->type == ASTNodeType::ForLoop) result = isOwned(static_cast<ForLoopNode*>(declaration)->variable->inferredType);
+        else if (declaration->type == ASTNodeType::TryCatch) result = true;
+        else if (declaration->type == ASTNodeType::Function) result = false; // a named function, nothing to own
+        else result = isOwned(declaration->inferredType);
+        if (result) owned.set(id);
+    }
+    return owned;
+}
+
+void BorrowChecker::report(AnalysisErrors error, ASTNode* node, const std::string& key, const std::vector<std::string>& messageArguments, const std::vector<std::string>& hintArguments) {
+    errorManager->addError(ErrorType::Analysis, error,
+        ErrorSpan{node->filePath, messageArguments.front(), node->line, node->column},
+        "ErrorManager.Analysis." + key + ".message", messageArguments,
+        "ErrorManager.Analysis." + key + ".hint", hintArguments);
+}
+
+// ==== Moves ====
+
+/* Forward, may: a local is moved at the start of a block if its value was given away on some path to it,
+ * and nothing assigned it since. Reading it there is a use after move.
+ */
+void BorrowChecker::checkMoves(ControlFlowGraph& graph, const BitSet& owned) {
+    size_t count = graph.variables.size();
+    auto transfer = [&owned](const Element& element, BitSet& state) {
+        for (const auto& [id, _] : element.moves) if (owned.test(id)) state.set(id);
+        for (VariableId id : element.kills) state.reset(id);
+        for (VariableId id : element.defs) state.reset(id);
+    };
+
+    std::vector<BlockId> order = graph.reversePostOrder();
+    std::vector<BitSet> in(graph.blocks.size(), BitSet(count));
+    std::vector<BitSet> out(graph.blocks.size(), BitSet(count));
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (BlockId block : order) {
+            BitSet state(count);
+            for (BlockId predecessor : graph.blocks[block].predecessors) state.uniteWith(out[predecessor]);
+            in[block] = state;
+            for (const auto& element : graph.blocks[block].elements) transfer(element, state);
+            if (state != out[block]) { out[block] = std::move(state); changed = true; }
+        }
+    }
+
+    for (BlockId block : order) {
+        BitSet state = in[block];
+        for (const auto& element : graph.blocks[block].elements) {
+            for (const auto& [id, node] : element.uses) {
+                if (!state.test(id) || reported.contains(id)) continue;
+                reported.insert(id);
+                const std::string& name = graph.variables[id].name;
+                report(AnalysisErrors::UseAfterMove, node, "UseAfterMove", {name}, {name});
+            }
+            // `[a, a]` gives the same value away twice
+            for (size_t i = 0; i < element.moves.size(); i++) {
+                auto [id, node] = element.moves[i];
+                if (!owned.test(id) || reported.contains(id)) continue;
+                for (size_t j = 0; j < i; j++) {
+                    if (element.moves[j].first != id) continue;
+                    reported.insert(id);
+                    const std::string& name = graph.variables[id].name;
+                    report(AnalysisErrors::UseAfterMove, node, "UseAfterMove", {name}, {name});
+                    break;
+                }
+            }
+            transfer(element, state);
+        }
+    }
+}
+
+// ==== Borrows ====
+
+// `g := f` hands the lambda in `f` over to `g`, along with what it borrows
+static std::optional<std::pair<VariableId, VariableId>> handover(const Element& element) {
+    if (element.moves.size() != 1 || element.defs.size() != 1) return std::nullopt;
+    ASTNode* value = nullptr;
+    if (element.node->type == ASTNodeType::Declaration) value = static_cast<DeclarationNode*>(element.node)->value.get();
+    else if (element.node->type == ASTNodeType::Assignment) value = static_cast<AssignmentNode*>(element.node)->value.get();
+    if (!value || value != element.moves[0].second) return std::nullopt;
+    return std::make_pair(element.moves[0].first, element.defs[0]);
+}
+
+/* Forward, may: which loans are in force at the start of a block. A loan is taken by the element that creates the
+ * borrower, ends when the borrower is assigned again, and matters only while the borrower is live: after its last use
+ * the borrowed local is free again, wherever its scope ends.
+ */
+void BorrowChecker::checkBorrows(ControlFlowGraph& graph, const BitSet& owned) {
+    // every loan of the function, the same borrower of the same local is the same loan
+    std::vector<ControlFlowGraph::Loan> loans;
+    std::unordered_map<uint64_t, size_t> loanIndex;
+    auto intern = [&](VariableId borrowed, VariableId holder, ASTNode* node) {
+        auto [it, added] = loanIndex.try_emplace(uint64_t(borrowed) << 32 | holder, loans.size());
+        if (added) loans.push_back(ControlFlowGraph::Loan{borrowed, holder, node});
+        return it->second;
+    };
+    auto find = [&](VariableId borrowed, VariableId holder) { return loanIndex.at(uint64_t(borrowed) << 32 | holder); };
+
+    std::vector<BlockId> order = graph.reversePostOrder();
+    for (BlockId block : order)
+        for (const auto& element : graph.blocks[block].elements)
+            for (const auto& loan : element.loans) intern(loan.borrowed, loan.holder, loan.node);
+    if (loans.empty()) return;
+
+    // loans handed over to another local, until no new ones turn up
+    std::unordered_map<VariableId, std::vector<size_t>> heldBy;
+    for (bool grew = true; grew;) {
+        grew = false;
+        heldBy.clear();
+        for (size_t i = 0; i < loans.size(); i++) heldBy[loans[i].holder].push_back(i);
+        for (BlockId block : order) {
+            for (const auto& element : graph.blocks[block].elements) {
+                auto pair = handover(element);
+                if (!pair || !heldBy.contains(pair->first)) continue;
+                for (size_t i : heldBy[pair->first]) {
+                    size_t before = loans.size();
+                    intern(loans[i].borrowed, pair->second, loans[i].node);
+                    grew |= loans.size() != before;
+                }
+            }
+        }
+    }
+
+    std::unordered_map<VariableId, std::vector<size_t>> borrowedFrom;
+    std::unordered_map<VariableId, BitSet> heldSets;
+    for (size_t i = 0; i < loans.size(); i++) {
+        borrowedFrom[loans[i].borrowed].push_back(i);
+        heldSets.try_emplace(loans[i].holder, loans.size()).first->second.set(i);
+    }
+
+    auto transfer = [&](const Element& element, BitSet& state) {
+        BitSet taken(loans.size());
+        if (auto pair = handover(element); pair && heldBy.contains(pair->first))
+            for (size_t i : heldBy[pair->first]) if (state.test(i)) taken.set(find(loans[i].borrowed, pair->second));
+        for (const auto& loan : element.loans) taken.set(find(loan.borrowed, loan.holder));
+
+        for (VariableId id : element.defs) if (auto it = heldSets.find(id); it != heldSets.end()) state.subtract(it->second);
+        for (VariableId id : element.kills) if (auto it = heldSets.find(id); it != heldSets.end()) state.subtract(it->second);
+        state.uniteWith(taken);
+    };
+
+    std::vector<BitSet> in(graph.blocks.size(), BitSet(loans.size()));
+    std::vector<BitSet> out(graph.blocks.size(), BitSet(loans.size()));
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (BlockId block : order) {
+            BitSet state(loans.size());
+            for (BlockId predecessor : graph.blocks[block].predecessors) state.uniteWith(out[predecessor]);
+            in[block] = state;
+            for (const auto& element : graph.blocks[block].elements) transfer(element, state);
+            if (state != out[block]) { out[block] = std::move(state); changed = true; }
+        }
+    }
+
+    const std::vector<BitSet>& liveOut = graph.liveOut();
+    for (BlockId block : order) {
+        const auto& elements = graph.blocks[block].elements;
+
+        // what's live right after every element, walking back from the end of the block
+        std::vector<BitSet> liveAfter(elements.size());
+        BitSet live = liveOut[block];
+        for (size_t i = elements.size(); i-- > 0;) {
+            liveAfter[i] = live;
+            for (VariableId id : elements[i].defs) live.reset(id);
+            for (VariableId id : elements[i].kills) live.reset(id);
+            for (const auto& [id, _] : elements[i].uses) live.set(id);
+        }
+
+        BitSet state = in[block];
+        for (size_t i = 0; i < elements.size(); i++) {
+            const Element& element = elements[i];
+            BitSet used(graph.variables.size());
+            for (const auto& [id, _] : element.uses) used.set(id);
+
+            // a loan on `id` whose borrower is still needed here or later
+            auto conflict = [&](VariableId id, ASTNode* node) {
+                if (reported.contains(id) || !borrowedFrom.contains(id)) return;
+                for (size_t loan : borrowedFrom[id]) {
+                    VariableId holder = loans[loan].holder;
+                    if (!state.test(loan) || !(liveAfter[i].test(holder) || used.test(holder))) continue;
+                    reported.insert(id);
+                    const std::string& name = graph.variables[id].name;
+                    if (graph.variables[holder].isIterator) report(AnalysisErrors::BorrowConflict, node, "BorrowConflict.loop", {name}, {name});
+                    else {
+                        const std::string& holderName = graph.variables[holder].name;
+                        report(AnalysisErrors::BorrowConflict, node, "BorrowConflict", {name, holderName}, {holderName, name});
+                    }
+                    return;
+                }
+            };
+            for (const auto& [id, node] : element.moves) if (owned.test(id)) conflict(id, node);
+            for (const auto& [id, node] : element.changes) conflict(id, node);
+            ASTNode* target = element.node->type == ASTNodeType::Assignment ? static_cast<AssignmentNode*>(element.node)->variable.get() : element.node;
+            for (VariableId id : element.defs) conflict(id, target);
+
+            // changing a collection borrows it exclusively, nothing else may take it in the meantime
+            for (const auto& [id, node] : element.changes) {
+                if (!owned.test(id) || reported.contains(id)) continue;
+                for (const auto& [moved, _] : element.moves) {
+                    if (moved != id) continue;
+                    reported.insert(id);
+                    const std::string& name = graph.variables[id].name;
+                    report(AnalysisErrors::BorrowConflict, node, "BorrowConflict.exclusive", {name}, {name});
+                    break;
+                }
+            }
+
+            // a borrower given away anywhere but another local would outlive what it borrows
+            auto pair = handover(element);
+            for (const auto& [id, node] : element.moves) {
+                if ((pair && pair->first == id) || reported.contains(id) || !heldBy.contains(id)) continue;
+                for (size_t loan : heldBy[id]) {
+                    if (!state.test(loan)) continue;
+                    reported.insert(id);
+                    const std::string& borrowed = graph.variables[loans[loan].borrowed].name;
+                    report(AnalysisErrors::BorrowConflict, node, "BorrowConflict.escape", {graph.variables[id].name, borrowed}, {borrowed});
+                    break;
+                }
+            }
+            transfer(element, state);
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <unordered_set>
+
+#include "Core/Extras/ErrorManager/ErrorManager.hpp"
+#include "ControlFlowGraph.hpp"
+
+/* Borrow Checker backs the Rusty memory mode, where every value has exactly one owner and nothing counts or traces
+ * references at runtime. It runs in Flow Analysis over the same Control Flow Graph, one function at a time:
+ * - UseAfterMove: a local read on a path where its value was already given away (stored, returned, thrown, captured)
+ * - BorrowConflict: a local moved, changed or assigned while something that borrows it is still live, or a borrower
+ *   given away while it holds a borrow
+ *
+ * Strings, collections, results, lambdas and objects are owned. Numbers and bools are copied, so they never move.
+ * Calls only borrow their arguments. A lambda kept in a local borrows what it captures for as long as that local is
+ * live (not to the end of its scope), a lambda stored anywhere else takes its captures. A for loop borrows what it
+ * goes over until its last iteration, and changing a collection in place borrows it exclusively for that expression.
+ *
+ * Both checks are gen/kill dataflow over bit sets (moved locals, loans in force), so they stay linear in the size of
+ * the function for every practical nesting of loops.
+ */
+struct BorrowChecker {
+    // ErrorManager is used to report errors
+    ErrorManager* errorManager = nullptr;
+
+    void check(ControlFlowGraph& graph);
+
+private:
+    BitSet ownedVariables(const ControlFlowGraph& graph) const;
+
+    void checkMoves(ControlFlowGraph& graph, const BitSet& owned);
+    void checkBorrows(ControlFlowGraph& graph, const BitSet& owned);
+
+    void report(AnalysisErrors error, ASTNode* node, const std::string& key, const std::vector<std::string>& messageArguments, const std::vector<std::string>& hintArguments);
+
+    std::unordered_set<ControlFlowGraph::VariableId> reported; // per function, one error for every variable is enough
+};
@@ -0,0 +1,642 @@
+#include "ControlFlowGraph.hpp"
+
+#include <algorithm>
+#include <format>
+#include <functional>
+#include <unordered_set>
+
+// ==== BitSet ====
+
+BitSet::BitSet(size_t size, bool filled) : words((size + 63) / 64, filled ? ~uint64_t(0) : 0), bits(size) {
+    if (filled && size % 64) words.back() = (uint64_t(1) << (size % 64)) - 1; // keep the tail clean, so equality works
+}
+
+bool BitSet::intersectWith(const BitSet& other) {
+    bool changed = false;
+    for (size_t i = 0; i < words.size(); i++) {
+        uint64_t next = words[i] & other.words[i];
+        changed |= next != words[i];
+        words[i] = next;
+    }
+    return changed;
+}
+
+bool BitSet::uniteWith(const BitSet& other) {
+    bool changed = false;
+    for (size_t i = 0; i < words.size(); i++) {
+        uint64_t next = words[i] | other.words[i];
+        changed |= next != words[i];
+        words[i] = next;
+    }
+    return changed;
+}
+
+bool BitSet::subtract(const BitSet& other) {
+    bool changed = false;
+    for (size_t i = 0; i < words.size(); i++) {
+        uint64_t next = words[i] & ~other.words[i];
+        changed |= next != words[i];
+        words[i] = next;
+    }
+    return changed;
+}
+
+// ==== Construction ====
+
+namespace {
+
+// Lowers a function body into blocks. Scopes map names to variables while walking, so shadowing is resolved once here.
+struct Builder {
+    using BlockId = ControlFlowGraph::BlockId;
+    using VariableId = ControlFlowGraph::VariableId;
+
+    ControlFlowGraph& graph;
+    BlockId current = 0;
+
+    std::vector<std::unordered_map<std::string, VariableId>> scopes;
+    struct Loop { BlockId continueTarget; BlockId breakTarget; };
+    std::vector<Loop> loops;
+    std::vector<BlockId> handlers; // catch blocks of the enclosing try statements, innermost last
+
+    BlockId newBlock() {
+        graph.blocks.emplace_back();
+        return static_cast<BlockId>(graph.blocks.size() - 1);
+    }
+
+    void edge(BlockId from, BlockId to) {
+        auto& successors = graph.blocks[from].successors;
+        if (std::find(successors.begin(), successors.end(), to) != successors.end()) return;
+        successors.push_back(to);
+        graph.blocks[to].predecessors.push_back(from);
+    }
+
+    // After return, break and friends the code that follows starts in a block nothing leads to
+    void leave(BlockId target) {
+        edge(current, target);
+        current = newBlock();
+    }
+
+    VariableId declare(const std::string& name, ASTNode* declaration, bool isParameter = false) {
+        graph.variables.push_back(ControlFlowGraph::Variable{name, declaration, isParameter});
+        auto id = static_cast<VariableId>(graph.variables.size() - 1);
+        scopes.back()[name] = id;
+        return id;
+    }
+
+    // A variable no name leads to, like the iterator of a for loop
+    VariableId hidden(const std::string& name, ASTNode* declaration) {
+        graph.variables.push_back(ControlFlowGraph::Variable{name, declaration, false, true});
+        return static_cast<VariableId>(graph.variables.size() - 1);
+    }
+
+    std::optional<VariableId> lookup(const std::string& name) const {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto it = scope->find(name);
+            if (it != scope->end()) return it->second;
+        }
+        return std::nullopt; // not a local: globals, functions, namespaces...
+    }
+
+    ControlFlowGraph::Element& element(ASTNode* node) {
+        graph.blocks[current].elements.push_back(ControlFlowGraph::Element{node, {}, {}, {}});
+        return graph.blocks[current].elements.back();
+    }
+
+    static std::optional<bool> constantCondition(ASTNode* condition) {
+        if (!condition || condition->type != ASTNodeType::Literal) return std::nullopt;
+        auto* literal = static_cast<LiteralNode*>(condition);
+        if (literal->literalType != ASTLiteralType::Bool) return std::nullopt;
+        return literal->value == "true";
+    }
+
+    // ==== Uses ====
+
+    void use(ControlFlowGraph::Element& into, const std::string& name, ASTNode* node) {
+        if (auto id = lookup(name)) into.uses.emplace_back(*id, node);
+    }
+
+    void uses(ControlFlowGraph::Element& into, ASTNode* node) {
+        if (!node) return;
+        switch (node->type) {
+            case ASTNodeType::Variable: use(into, static_cast<VariableNode*>(node)->varName, node); break;
+            case ASTNodeType::Literal: for (const auto& interpolation : static_cast<LiteralNode*>(node)->interpolations) uses(into, interpolation.get()); break;
+            case ASTNodeType::MemberAccess: {
+                auto* access = static_cast<MemberAccessNode*>(node);
+                uses(into, access->parent.get());
+                // the member itself is a name, only the arguments of a method call are expressions
+                if (access->val && access->val->type == ASTNodeType::CallExpression) {
+                    auto* call = static_cast<CallExpressionNode*>(access->val.get());
+                    for (const auto& argument : call->arguments) uses(into, argument.get());
+                    collectionMethod(into, access->parent.get(), call);
+                }
+                break;
+            }
+            case ASTNodeType::CallExpression: {
+                auto* call = static_cast<CallExpressionNode*>(node);
+                uses(into, call->callee.get());
+                for (const auto& argument : call->arguments) uses(into, argument.get());
+                break;
+            }
+            case ASTNodeType::BinaryOperation: {
+                auto* binary = static_cast<BinaryOperationNode*>(node);
+                uses(into, binary->leftOperand.get());
+                uses(into, binary->rightOperand.get());
+                break;
+            }
+            case ASTNodeType::UnaryOperation: uses(into, static_cast<UnaryOperationNode*>(node)->operand.get()); break;
+            case ASTNodeType::Array: for (const auto& element : static_cast<ArrayNode*>(node)->elements) uses(into, element.get()); break;
+            case ASTNodeType::Set: for (const auto& element : static_cast<SetNode*>(node)->elements) uses(into, element.get()); break;
+            case ASTNodeType::Tuple: for (const auto& element : static_cast<TupleNode*>(node)->elements) uses(into, element.get()); break;
+            case ASTNodeType::Dict:
+                for (const auto& [key, value] : static_cast<DictNode*>(node)->elements) { uses(into, key.get()); uses(into, value.get()); }
+                break;
+            case ASTNodeType::Lambda: captures(into, static_cast<LambdaNode*>(node)); break;
+            default: break;
+        }
+    }
+
+    // Methods that change a collection in place, the ones that put something in keep their arguments
+    void collectionMethod(ControlFlowGraph::Element& into, ASTNode* receiver, CallExpressionNode* call) {
+        if (!call->callee || call->callee->type != ASTNodeType::Variable) return;
+        const std::string& name = static_cast<VariableNode*>(call->callee.get())->varName;
+        bool inserts = name == "push" || name == "append" || name == "add" || name == "insert" || name == "set";
+        if (!inserts && name != "remove") return;
+        if (auto id = root(receiver)) into.changes.emplace_back(*id, receiver);
+        if (inserts) for (const auto& argument : call->arguments) stored(into, argument.get());
+    }
+
+    // The local an access path starts from: `a` of `a.b.c`
+    std::optional<VariableId> root(ASTNode* node) const {
+        while (node && node->type == ASTNodeType::MemberAccess) node = static_cast<MemberAccessNode*>(node)->parent.get();
+        if (!node || node->type != ASTNodeType::Variable) return std::nullopt;
+        return lookup(static_cast<VariableNode*>(node)->varName);
+    }
+
+    /* `value` ends up kept somewhere: in a variable, a collection, the caller. A local read as a whole moves there,
+     * and so do the locals a lambda captures, unless the lambda goes into the local `holder`, which then borrows them
+     * for as long as it's live. Calls and operators make new values, their operands are only borrowed.
+     */
+    void stored(ControlFlowGraph::Element& into, ASTNode* value, std::optional<VariableId> holder = std::nullopt) {
+        if (!value) return;
+        switch (value->type) {
+            case ASTNodeType::Variable:
+                if (auto id = lookup(static_cast<VariableNode*>(value)->varName)) into.moves.emplace_back(*id, value);
+                break;
+            case ASTNodeType::Lambda: {
+                ControlFlowGraph::Element scratch{value, {}, {}, {}};
+                captures(scratch, static_cast<LambdaNode*>(value));
+                std::unordered_set<VariableId> seen;
+                for (const auto& [id, at] : scratch.uses) {
+                    if (!seen.insert(id).second || id == holder) continue;
+                    if (holder) into.loans.push_back(ControlFlowGraph::Loan{id, *holder, value});
+                    else into.moves.emplace_back(id, at);
+                }
+                break;
+            }
+            case ASTNodeType::Array: for (const auto& element : static_cast<ArrayNode*>(value)->elements) stored(into, element.get()); break;
+            case ASTNodeType::Set: for (const auto& element : static_cast<SetNode*>(value)->elements) stored(into, element.get()); break;
+            case ASTNodeType::Tuple: for (const auto& element : static_cast<TupleNode*>(value)->elements) stored(into, element.get()); break;
+            case ASTNodeType::Dict:
+                for (const auto& [key, element] : static_cast<DictNode*>(value)->elements) { stored(into, key.get()); stored(into, element.get()); }
+                break;
+            default: break;
+        }
+    }
+
+    // A lambda reads the locals it captures when it's created. Its own parameters and locals hide outer names.
+    void captures(ControlFlowGraph::Element& into, LambdaNode* lambda) {
+        std::unordered_set<std::string> hidden;
+        for (const auto& parameter : lambda->params) {
+            if (parameter->type == ASTNodeType::Variable) hidden.insert(static_cast<VariableNode*>(parameter.get())->varName);
+            else if (parameter->type == ASTNodeType::Parameter) hidden.insert(static_cast<ParameterNode*>(parameter.get())->parameterName);
+        }
+
+        std::function<void(ASTNode*)> walk = [&](ASTNode* node) {
+            if (!node) return;
+            switch (node->type) {
+                case ASTNodeType::Variable: {
+                    const std::string& name = static_cast<VariableNode*>(node)->varName;
+                    if (!hidden.contains(name)) use(into, name, node);
+                    break;
+                }
+                case ASTNodeType::Block: for (const auto& statement : static_cast<BlockNode*>(node)->statements) walk(statement.get()); break;
+                case ASTNodeType::Declaration: {
+                    auto* declaration = static_cast<DeclarationNode*>(node);
+                    walk(declaration->value.get());
+                    hidden.insert(declaration->variable->varName);
+                    break;
+                }
+                case ASTNodeType::Assignment: {
+                    auto* assignment = static_cast<AssignmentNode*>(node);
+                    walk(assignment->variable.get());
+                    walk(assignment->value.get());
+                    break;
+                }
+                case ASTNodeType::ReturnStatement: walk(static_cast<ReturnStatementNode*>(node)->expression.get()); break;
+                case ASTNodeType::ThrowStatement: walk(static_cast<ThrowStatementNode*>(node)->expression.get()); break;
+                case ASTNodeType::IfStatement: {
+                    auto* branch = static_cast<IfNode*>(node);
+                    walk(branch->condition.get()); walk(branch->thenBlock.get()); walk(branch->elseBlock.get());
+                    break;
+                }
+                case ASTNodeType::WhileLoop: {
+                    auto* loop = static_cast<WhileLoopNode*>(node);
+                    walk(loop->condition.get()); walk(loop->body.get());
+                    break;
+                }
+                case ASTNodeType::ForLoop: {
+                    auto* loop = static_cast<ForLoopNode*>(node);
+                    walk(loop->iterable.get());
+                    hidden.insert(loop->variable->varName);
+                    for (auto& variable : loop->unpacked) hidden.insert(variable->varName);
+                    walk(loop->body.get());
+                    break;
+                }
+                default: {
+                    // expressions: reuse the regular walk, but through a scratch element so hidden names can be filtered
+                    ControlFlowGraph::Element scratch{node, {}, {}, {}};
+                    uses(scratch, node);
+                    for (const auto& [id, at] : scratch.uses)
+                        if (!hidden.contains(graph.variables[id].name)) into.uses.emplace_back(id, at);
+                    break;
+                }
+            }
+        };
+        walk(lambda->body.get());
+    }
+
+    // ==== Statements ====
+
+    void statements(const std::vector<MemoryPtr<ASTNode>>& list) {
+        for (const auto& statement : list) this->statement(statement.get());
+    }
+
+    void block(ASTNode* node) {
+        if (!node) return;
+        scopes.emplace_back();
+        if (node->type == ASTNodeType::Block) statements(static_cast<BlockNode*>(node)->statements);
+        else statement(node);
+        scopes.pop_back();
+    }
+
+    void statement(ASTNode* node) {
+        if (!node) return;
+        graph.statementBlocks[node] = current;
+
+        switch (node->type) {
+            case ASTNodeType::Block: block(node); break;
+            case ASTNodeType::Declaration: {
+                auto* declaration = static_cast<DeclarationNode*>(node);
+                auto& step = element(node);
+                uses(step, declaration->value.get()); // `x := x` reads the outer x
+                VariableId id = declare(declaration->variable->varName, node);
+                stored(step, declaration->value.get(), id);
+                // a nullable without a value starts as null
+                if (declaration->value || declaration->isNullable) step.defs.push_back(id);
+                else step.kills.push_back(id);
+                break;
+            }
+            case ASTNodeType::Assignment: {
+                auto* assignment = static_cast<AssignmentNode*>(node);
+                auto& step = element(node);
+                uses(step, assignment->value.get());
+                if (assignment->variable->type == ASTNodeType::Variable) {
+                    const std::string& name = static_cast<VariableNode*>(assignment->variable.get())->varName;
+                    if (assignment->op != "=") use(step, name, assignment->variable.get()); // `x += 1` reads x first
+                    auto id = lookup(name);
+                    if (id) step.defs.push_back(*id);
+                    if (assignment->op == "=") stored(step, assignment->value.get(), id);
+                }
+                else {
+                    uses(step, assignment->variable.get()); // writing a member reads the object, and changes it
+                    if (auto id = root(assignment->variable.get())) step.changes.emplace_back(*id, assignment->variable.get());
+                    if (assignment->op == "=") stored(step, assignment->value.get());
+                }
+                break;
+            }
+            case ASTNodeType::IfStatement: {
+                auto* branch = static_cast<IfNode*>(node);
+                uses(element(node), branch->condition.get());
+                auto constant = constantCondition(branch->condition.get());
+                BlockId condition = current;
+                BlockId join = newBlock();
+
+                BlockId thenBlock = newBlock();
+                if (constant != false) edge(condition, thenBlock);
+                current = thenBlock;
+                block(branch->thenBlock.get());
+                edge(current, join);
+
+                if (branch->elseBlock) {
+                    BlockId elseBlock = newBlock();
+                    if (constant != true) edge(condition, elseBlock);
+                    current = elseBlock;
+                    block(branch->elseBlock.get());
+                    edge(current, join);
+                }
+                else if (constant != true) edge(condition, join);
+                current = join;
+                break;
+            }
+            case ASTNodeType::WhileLoop: {
+                auto* loop = static_cast<WhileLoopNode*>(node);
+                BlockId header = newBlock();
+                edge(current, header);
+                current = header;
+                uses(element(node), loop->condition.get());
+
+                auto constant = constantCondition(loop->condition.get());
+                BlockId body = newBlock();
+                BlockId after = newBlock();
+                if (constant != false) edge(header, body);
+                if (constant != true) edge(header, after);
+
+                loops.push_back(Loop{header, after});
+                current = body;
+                block(loop->body.get());
+                edge(current, header);
+                loops.pop_back();
+                current = after;
+                break;
+            }
+            case ASTNodeType::ForLoop: {
+                auto* loop = static_cast<ForLoopNode*>(node);
+                auto& start = element(node);
+                uses(start, loop->iterable.get());
+                // the iterator is made here and borrows the collection until the loop is done with it
+                VariableId iterator = hidden("for " + loop->variable->varName, node);
+                start.defs.push_back(iterator);
+                if (loop->iterable && loop->iterable->type == ASTNodeType::Variable)
+                    if (auto id = lookup(static_cast<VariableNode*>(loop->iterable.get())->varName))
+                        start.loans.push_back(ControlFlowGraph::Loan{*id, iterator, node});
+
+                // the header takes the next item (or leaves), the loop variable is assigned there on every iteration
+                BlockId header = newBlock();
+                BlockId body = newBlock();
+                BlockId after = newBlock();
+                edge(current, header);
+                edge(header, body);
+                edge(header, after);
+
+                scopes.emplace_back();
+                current = header;
+                VariableId variable = declare(loop->variable->varName, node);
+                auto& next = element(node);
+                next.uses.emplace_back(iterator, node);
+                next.defs.push_back(variable);
+                for (auto& unpacked : loop->unpacked) next.defs.push_back(declare(unpacked->varName, unpacked.get()));
+
+                loops.push_back(Loop{header, after});
+                current = body;
+                block(loop->body.get());
+                edge(current, header);
+                loops.pop_back();
+                scopes.pop_back();
+                current = after;
+                break;
+            }
+            case ASTNodeType::Switch: {
+                auto* switchNode = static_cast<SwitchNode*>(node);
+                auto& dispatch = element(node);
+                uses(dispatch, switchNode->expression.get());
+                for (const auto& caseNode : switchNode->cases) uses(dispatch, caseNode->condition.get());
+
+                // cases don't fall through into each other
+                BlockId from = current;
+                BlockId after = newBlock();
+                for (const auto& caseNode : switchNode->cases) {
+                    BlockId body = newBlock();
+                    edge(from, body);
+                    current = body;
+                    graph.statementBlocks[caseNode.get()] = body;
+                    block(caseNode->body.get());
+                    edge(current, after);
+                }
+                if (switchNode->defaultCase) {
+                    BlockId body = newBlock();
+                    edge(from, body);
+                    current = body;
+                    graph.statementBlocks[switchNode->defaultCase.get()] = body;
+                    block(switchNode->defaultCase->body.get());
+                    edge(current, after);
+                }
+                else edge(from, after);
+                current = after;
+                break;
+            }
+            case ASTNodeType::TryCatch: {
+                auto* tryCatch = static_cast<TryCatchNode*>(node);
+                BlockId handler = newBlock();
+                BlockId after = newBlock();
+
+                // anything inside the try may throw, so every block of it leads to the catch, and so does its start
+                BlockId tryStart = newBlock();
+                edge(current, tryStart);
+                edge(tryStart, handler);
+                auto firstTryBlock = static_cast<BlockId>(graph.blocks.size());
+                current = tryStart;
+                handlers.push_back(handler);
+                block(tryCatch->tryBlock.get());
+                handlers.pop_back();
+                edge(current, after);
+                for (auto id = firstTryBlock; id < graph.blocks.size(); id++) edge(id, handler);
+
+                current = handler;
+                scopes.emplace_back();
+                if (tryCatch->exception) element(node).defs.push_back(declare(tryCatch->exception->varName, node));
+                block(tryCatch->catchBlock.get());
+                scopes.pop_back();
+                edge(current, after);
+                current = after;
+                break;
+            }
+            case ASTNodeType::ReturnStatement: {
+                auto& step = element(node);
+                uses(step, static_cast<ReturnStatementNode*>(node)->expression.get());
+                stored(step, static_cast<ReturnStatementNode*>(node)->expression.get());
+                leave(graph.exit);
+                break;
+            }
+            case ASTNodeType::ThrowStatement: {
+                auto& step = element(node);
+                uses(step, static_cast<ThrowStatementNode*>(node)->expression.get());
+                stored(step, static_cast<ThrowStatementNode*>(node)->expression.get());
+                leave(handlers.empty() ? graph.exit : handlers.back());
+                break;
+            }
+            case ASTNodeType::BreakStatement:
+                element(node);
+                if (loops.empty()) current = newBlock(); // already reported by Semantic Analysis
+                else leave(loops.back().breakTarget);
+                break;
+            case ASTNodeType::ContinueStatement:
+                element(node);
+                if (loops.empty()) current = newBlock();
+                else leave(loops.back().continueTarget);
+                break;
+            case ASTNodeType::Function: {
+                // a nested function is a value from here on, its body gets a graph of its own
+                element(node).defs.push_back(declare(static_cast<FunctionNode*>(node)->name, node));
+                break;
+            }
+            case ASTNodeType::Class: case ASTNodeType::Enum: case ASTNodeType::Interface:
+            case ASTNodeType::Decorator: case ASTNodeType::Import: case ASTNodeType::Namespace:
+                break;
+            default: uses(element(node), node); break; // expression statement
+        }
+    }
+};
+
+} // namespace
+
+ControlFlowGraph ControlFlowGraph::build(FunctionNode* function) {
+    ControlFlowGraph graph;
+    graph.function = function;
+    graph.blocks.resize(2); // entry and exit
+
+    Builder builder{graph};
+    builder.scopes.emplace_back();
+    for (const auto& parameter : function->parameters) builder.declare(parameter->parameterName, parameter.get(), true);
+
+    builder.current = graph.entry;
+    if (function->body) builder.block(function->body.get());
+    graph.fallthrough = builder.current;
+    builder.edge(builder.current, graph.exit);
+    return graph;
+}
+
+ControlFlowGraph& ControlFlowGraph::of(FunctionNode* function) {
+    if (!function->controlFlow) function->controlFlow = makeMemoryPtr<ControlFlowGraph>(build(function));
+    return *function->controlFlow;
+}
+
+// ==== Dataflow ====
+
+std::vector<ControlFlowGraph::BlockId> ControlFlowGraph::reversePostOrder() const {
+    std::vector<BlockId> order;
+    std::vector<uint8_t> visited(blocks.size(), 0);
+    // iterative DFS, bodies can nest deep enough to make recursion a risk
+    std::vector<std::pair<BlockId, size_t>> stack{{entry, 0}};
+    visited[entry] = 1;
+    while (!stack.empty()) {
+        auto& [block, next] = stack.back();
+        if (next < blocks[block].successors.size()) {
+            BlockId successor = blocks[block].successors[next++];
+            if (!visited[successor]) { visited[successor] = 1; stack.emplace_back(successor, 0); }
+            continue;
+        }
+        order.push_back(block);
+        stack.pop_back();
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+const BitSet& ControlFlowGraph::reachable() {
+    if (reachableBlocks) return *reachableBlocks;
+    BitSet result(blocks.size());
+    for (BlockId block : reversePostOrder()) result.set(block);
+    return *(reachableBlocks = std::move(result));
+}
+
+/* Forward, must: a variable is assigned on entry to a block if it's assigned at the end of every predecessor.
+ * Everything starts full (the top of the lattice) except the entry, where only parameters are assigned,
+ * and the blocks converge down in reverse post order.
+ */
+const std::vector<BitSet>& ControlFlowGraph::definitelyAssigned() {
+    if (assignedIn) return *assignedIn;
+
+    std::vector<BitSet> in(blocks.size(), BitSet(variables.size(), true));
+    std::vector<BitSet> out(blocks.size(), BitSet(variables.size(), true));
+    BitSet parameters(variables.size());
+    for (size_t i = 0; i < variables.size(); i++) if (variables[i].isParameter) parameters.set(i);
+
+    auto transfer = [this](BlockId block, BitSet state) {
+        for (const auto& element : blocks[block].elements) {
+            for (VariableId id : element.kills) state.reset(id);
+            for (VariableId id : element.defs) state.set(id);
+        }
+        return state;
+    };
+
+    std::vector<BlockId> order = reversePostOrder();
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (BlockId block : order) {
+            BitSet state = block == entry ? parameters : BitSet(variables.size(), true);
+            if (block != entry) for (BlockId predecessor : blocks[block].predecessors) state.intersectWith(out[predecessor]);
+
+            in[block] = state;
+            BitSet next = transfer(block, std::move(state));
+            if (next != out[block]) { out[block] = std::move(next); changed = true; }
+        }
+    }
+    return *(assignedIn = std::move(in));
+}
+
+/* Backward, may: a variable is live at the end of a block if some successor reads it before writing it.
+ * Computed for every block, so unreachable ones simply stay empty.
+ */
+const std::vector<BitSet>& ControlFlowGraph::liveOut() {
+    if (liveOutSets) return *liveOutSets;
+
+    std::vector<BitSet> used(blocks.size(), BitSet(variables.size()));
+    std::vector<BitSet> defined(blocks.size(), BitSet(variables.size()));
+    for (size_t block = 0; block < blocks.size(); block++) {
+        for (const auto& element : blocks[block].elements) {
+            for (const auto& [id, _] : element.uses) if (!defined[block].test(id)) used[block].set(id);
+            for (VariableId id : element.defs) defined[block].set(id);
+            for (VariableId id : element.kills) defined[block].set(id);
+        }
+    }
+
+    std::vector<BitSet> in(blocks.size(), BitSet(variables.size()));
+    std::vector<BitSet> out(blocks.size(), BitSet(variables.size()));
+    std::vector<BlockId> order = reversePostOrder();
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            BlockId block = *it;
+            for (BlockId successor : blocks[block].successors) out[block].uniteWith(in[successor]);
+
+            BitSet next = out[block];
+            next.subtract(defined[block]);
+            next.uniteWith(used[block]);
+            if (next != in[block]) { in[block] = std::move(next); changed = true; }
+        }
+    }
+    return *(liveOutSets = std::move(out));
+}
+
+void ControlFlowGraph::removeUnreachable() {
+    const BitSet& live = reachable();
+    for (BlockId block = 0; block < blocks.size(); block++) {
+        if (live.test(block) || block == exit) continue;
+        for (BlockId successor : blocks[block].successors) std::erase(blocks[successor].predecessors, block);
+        blocks[block] = Block{};
+    }
+    std::erase_if(statementBlocks, [&live](const auto& entry) { return !live.test(entry.second); });
+    if (fallthrough != noBlock && !live.test(fallthrough)) fallthrough = noBlock;
+
+    // dataflow results are per block, the empty blocks don't change them
+}
+
+std::string ControlFlowGraph::toString() const {
+    std::string out = std::format("ControlFlowGraph {} ({} blocks, {} variables)\n", function ? function->name : "", blocks.size(), variables.size());
+    for (size_t block = 0; block < blocks.size(); block++) {
+        out += std::format("  b{}{}:", block, block == entry ? " (entry)" : block == exit ? " (exit)" : "");
+        for (BlockId successor : blocks[block].successors) out += std::format(" -> b{}", successor);
+        out += "\n";
+        for (const auto& element : blocks[block].elements) {
+            out += std::format("    {}:{}", element.node->line, element.node->column);
+            for (const auto& [id, _] : element.uses) out += std::format(" use {}", variables[id].name);
+            for (VariableId id : element.defs) out += std::format(" def {}", variables[id].name);
+            for (VariableId id : element.kills) out += std::format(" kill {}", variables[id].name);
+            for (const auto& [id, _] : element.moves) out += std::format(" move {}", variables[id].name);
+            for (const auto& [id, _] : element.changes) out += std::format(" change {}", variables[id].name);
+            for (const auto& loan : element.loans) out += std::format(" loan {} to {}", variables[loan.borrowed].name, variables[loan.holder].name);
+            out += "\n";
+        }
+    }
+    return out;
+}
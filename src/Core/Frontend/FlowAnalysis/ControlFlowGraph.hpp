@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Core/Frontend/Nodes.hpp"
+
+// Dense set of small indices (variables or blocks): the lattice element of every dataflow analysis over the graph.
+struct BitSet {
+    BitSet() = default;
+    explicit BitSet(size_t size, bool filled = false);
+
+    void set(size_t i) { words[i / 64] |= uint64_t(1) << (i % 64); }
+    void reset(size_t i) { words[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+    bool test(size_t i) const { return words[i / 64] >> (i % 64) & 1; }
+    size_t size() const { return bits; }
+
+    // All of them return true if the set changed
+    bool intersectWith(const BitSet& other);
+    bool uniteWith(const BitSet& other);
+    bool subtract(const BitSet& other);
+
+    bool operator==(const BitSet& other) const = default;
+
+private:
+    std::vector<uint64_t> words;
+    size_t bits = 0;
+};
+
+/* Control Flow Graph of one function body. It's built from the typed AST once the Constant Folder is done with it,
+ * so constant conditions (`if (false)`, `while (true)`) already have only the edges that can be taken.
+ * The graph is cached on the FunctionNode and shared by every pass after that: Flow Analysis, the Optimizer
+ * and the borrow checker all get the same instance through ControlFlowGraph::of().
+ *
+ * Blocks hold elements: simple statements, and the conditions/subjects of control statements. Every element records
+ * which local variables it reads and writes, which is all the dataflow analyses below need. For the borrow checker it
+ * also records what happens to the values: which reads give a value away, what's changed in place and what's borrowed
+ * past the element.
+ */
+struct ControlFlowGraph {
+    using BlockId = uint32_t;
+    using VariableId = uint32_t;
+    static constexpr BlockId noBlock = UINT32_MAX;
+
+    // `borrowed` can't change while `holder` is live: a lambda kept in a local borrows what it captures, a loop its iterable
+    struct Loan {
+        VariableId borrowed;
+        VariableId holder;
+        ASTNode* node; // what borrows: the lambda or the loop
+    };
+
+    struct Element {
+        ASTNode* node; // the statement (or loop/switch/if owning the condition), never a bare sub-expression
+        std::vector<std::pair<VariableId, ASTNode*>> uses; // in evaluation order, with the node that reads
+        std::vector<VariableId> defs;
+        std::vector<VariableId> kills; // declarations without a value: the variable starts over unassigned
+
+        std::vector<std::pair<VariableId, ASTNode*>> moves; // uses that give the value away: stored, returned or thrown
+        std::vector<std::pair<VariableId, ASTNode*>> changes; // variables changed in place: a member set, a collection method
+        std::vector<Loan> loans; // taken once the element is done
+    };
+
+    struct Block {
+        std::vector<Element> elements;
+        std::vector<BlockId> successors;
+        std::vector<BlockId> predecessors;
+    };
+
+    // A local of the function. Same-named locals in different scopes are different variables.
+    struct Variable {
+        std::string name;
+        ASTNode* declaration; // ParameterNode, DeclarationNode, ForLoopNode, TryCatchNode or FunctionNode
+        bool isParameter = false;
+        bool isIterator = false; // the hidden iterator of a for loop: assigned before it, read by every iteration
+    };
+
+    FunctionNode* function = nullptr;
+    std::vector<Block> blocks;
+    std::vector<Variable> variables;
+    BlockId entry = 0;
+    BlockId exit = 1; // returns, throws out of the function and the end of the body lead here
+    BlockId fallthrough = noBlock; // block that runs off the end of the body without `return`
+
+    // Block every statement of the body starts in; nested statement lists are included
+    std::unordered_map<ASTNode*, BlockId> statementBlocks;
+
+    // Builds the graph of `function` on first use and caches it on the node
+    static ControlFlowGraph& of(FunctionNode* function);
+    static ControlFlowGraph build(FunctionNode* function);
+
+    // ==== Dataflow, computed on first use ====
+    const BitSet& reachable(); // over blocks
+    const std::vector<BitSet>& definitelyAssigned(); // per block: variables assigned on every path into it
+    const std::vector<BitSet>& liveOut(); // per block: variables read later on some path out of it
+
+    // Empties unreachable blocks and drops their edges, after their statements were removed from the AST
+    void removeUnreachable();
+
+    std::vector<BlockId> reversePostOrder() const; // reachable blocks only
+    std::string toString() const; // debug dump
+
+private:
+    std::optional<BitSet> reachableBlocks;
+    std::optional<std::vector<BitSet>> assignedIn;
+    std::optional<std::vector<BitSet>> liveOutSets;
+};
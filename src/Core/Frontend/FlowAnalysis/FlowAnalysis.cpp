@@ -0,0 +1,154 @@
+#include "FlowAnalysis.hpp"
+
+#include "Core/Frontend/SemanticAnalysis/Types.hpp"
+
+// ==== Walking the module ====
+
+void FlowAnalysis::analyzeModule(ModuleNode* module) {
+    if (module) analyzeTopLevel(module->body);
+}
+
+void FlowAnalysis::analyzeTopLevel(std::vector<MemoryPtr<ASTNode>>& body) {
+    for (auto& statement : body) {
+        switch (statement->type) {
+            case ASTNodeType::Function: analyzeFunction(static_cast<FunctionNode*>(statement.get())); break;
+            case ASTNodeType::Namespace: analyzeTopLevel(static_cast<NamespaceNode*>(statement.get())->body); break;
+            case ASTNodeType::Class: {
+                auto* node = static_cast<ClassNode*>(statement.get());
+                if (node->constructor) analyzeFunction(node->constructor.get());
+                for (auto& method : node->methods) analyzeFunction(method.get());
+                break;
+            }
+            default: break;
+        }
+    }
+}
+
+void FlowAnalysis::analyzeFunction(FunctionNode* function) {
+    if (!function->body || function->isIntrinsic) return;
+
+    // the tree may have been rewritten since a graph was cached on it, the checks always work on a fresh one
+    function->controlFlow.reset();
+    ControlFlowGraph& graph = ControlFlowGraph::of(function);
+
+    reported.clear();
+    checkAssignments(graph);
+    checkReturn(graph);
+
+    prune(graph, function->body->statements, true);
+    graph.removeUnreachable();
+    if (checkOwnership) borrowChecker.check(graph);
+}
+
+// ==== Checks ====
+
+void FlowAnalysis::checkAssignments(ControlFlowGraph& graph) {
+    const BitSet& reachable = graph.reachable();
+    const std::vector<BitSet>& assigned = graph.definitelyAssigned();
+
+    for (size_t block = 0; block < graph.blocks.size(); block++) {
+        if (!reachable.test(block)) continue; // reported as unreachable instead
+
+        BitSet state = assigned[block];
+        for (const auto& element : graph.blocks[block].elements) {
+            for (const auto& [id, node] : element.uses) {
+                if (state.test(id) || reported.contains(id)) continue;
+                reported.insert(id);
+
+                const std::string& name = graph.variables[id].name;
+                errorManager->addError(ErrorType::Analysis, AnalysisErrors::UninitializedVariable,
+                    ErrorSpan{node->filePath, name, node->line, node->column},
+                    "ErrorManager.Analysis.UninitializedVariable.message", {name},
+                    "ErrorManager.Analysis.UninitializedVariable.hint", {name});
+            }
+            for (auto id : element.kills) state.reset(id);
+            for (auto id : element.defs) state.set(id);
+        }
+    }
+}
+
+void FlowAnalysis::checkReturn(ControlFlowGraph& graph) {
+    FunctionNode* function = graph.function;
+    const Type* type = function->inferredType;
+    if (!type || type->kind != Type::Kind::Function) return;
+
+    const Type* returnType = type->returnType();
+    if (!returnType || returnType->isVoid() || returnType->isDynamic()) return;
+    if (graph.fallthrough == ControlFlowGraph::noBlock || !graph.reachable().test(graph.fallthrough)) return;
+
+    std::string typeName = returnType->toString();
+    errorManager->addError(ErrorType::Analysis, AnalysisErrors::MissingReturnStatement,
+        ErrorSpan{function->filePath, function->name, function->line, function->column},
+        "ErrorManager.Analysis.MissingReturnStatement.message", {function->name, typeName},
+        "ErrorManager.Analysis.MissingReturnStatement.hint", {typeName});
+}
+
+// ==== Removing dead code ====
+
+void FlowAnalysis::prune(ControlFlowGraph& graph, std::vector<MemoryPtr<ASTNode>>& statements, bool reportFirst) {
+    const BitSet& reachable = graph.reachable();
+    auto isReachable = [&](ASTNode* statement) {
+        auto it = graph.statementBlocks.find(statement);
+        return it != graph.statementBlocks.end() && reachable.test(it->second);
+    };
+
+    /* Only a statement right after reachable code is reported: that's where the flow ends (`return`, `break`, an endless loop).
+     * Everything after it is the same mistake, and the body of `if (false)` is dead on purpose.
+     */
+    bool previousReachable = false;
+    std::erase_if(statements, [&](MemoryPtr<ASTNode>& statement) {
+        if (isReachable(statement.get())) {
+            previousReachable = true;
+            pruneNested(graph, statement.get());
+            return false;
+        }
+        if (reportFirst && previousReachable) {
+            errorManager->addError(ErrorType::Analysis, AnalysisErrors::UnreachableCode,
+                ErrorSpan{statement->filePath, statement->value, statement->line, statement->column},
+                "ErrorManager.Analysis.UnreachableCode.message", {},
+                "ErrorManager.Analysis.UnreachableCode.hint", {});
+        }
+        previousReachable = false;
+        return true;
+    });
+}
+
+void FlowAnalysis::pruneNested(ControlFlowGraph& graph, ASTNode* statement) {
+    auto body = [&](ASTNode* node) {
+        if (!node) return;
+        if (node->type == ASTNodeType::Block) prune(graph, static_cast<BlockNode*>(node)->statements, true);
+        else pruneNested(graph, node);
+    };
+
+    switch (statement->type) {
+        case ASTNodeType::Block: body(statement); break;
+        case ASTNodeType::IfStatement: {
+            auto* node = static_cast<IfNode*>(statement);
+            body(node->thenBlock.get());
+            body(node->elseBlock.get());
+            break;
+        }
+        case ASTNodeType::WhileLoop: body(static_cast<WhileLoopNode*>(statement)->body.get()); break;
+        case ASTNodeType::ForLoop: body(static_cast<ForLoopNode*>(statement)->body.get()); break;
+        case ASTNodeType::Switch: {
+            auto* node = static_cast<SwitchNode*>(statement);
+            for (auto& caseNode : node->cases) body(caseNode->body.get());
+            if (node->defaultCase) body(node->defaultCase->body.get());
+            break;
+        }
+        case ASTNodeType::TryCatch: {
+            auto* node = static_cast<TryCatchNode*>(statement);
+            body(node->tryBlock.get());
+            body(node->catchBlock.get());
+            break;
+        }
+        case ASTNodeType::Function: {
+            // a nested function has a graph of its own, the outer one stays cached on the outer function
+            auto saved = std::move(reported);
+            analyzeFunction(static_cast<FunctionNode*>(statement));
+            reported = std::move(saved);
+            break;
+        }
+        default: break;
+    }
+}
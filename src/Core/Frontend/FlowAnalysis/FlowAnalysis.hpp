@@ -0,0 +1,42 @@
+#pragma once
+#include <unordered_set>
+#include <vector>
+
+#include "Core/Extras/ErrorManager/ErrorManager.hpp"
+#include "Core/Frontend/Nodes.hpp"
+#include "ControlFlowGraph.hpp"
+#include "BorrowChecker.hpp"
+
+/* Flow Analysis is the last check of Frontend. It runs over a module once the whole program type-checked and folded,
+ * builds the Control Flow Graph of every function body and checks what only the flow of a function can tell:
+ * - UninitializedVariable: a local read on a path where it was never assigned
+ * - UnreachableCode: statements no path gets to (after return/break/throw, inside `if (false)`)
+ * - MissingReturnStatement: a function returning a value that can run off the end of its body
+ * - in the Rusty memory mode, moves and borrows through Borrow Checker
+ *
+ * Unreachable statements are then removed from the tree, so nothing after Frontend generates code for them.
+ */
+struct FlowAnalysis {
+    // ErrorManager is used to report errors
+    ErrorManager* errorManager = nullptr;
+
+    // Rusty memory mode: values have one owner, checked by borrowChecker
+    bool checkOwnership = false;
+    BorrowChecker borrowChecker;
+
+    // Main entry
+    void analyzeModule(ModuleNode* module);
+
+private:
+    void analyzeTopLevel(std::vector<MemoryPtr<ASTNode>>& body); // module and namespace bodies
+    void analyzeFunction(FunctionNode* function);
+
+    void checkAssignments(ControlFlowGraph& graph);
+    void checkReturn(ControlFlowGraph& graph);
+
+    // Reports the first unreachable statement of every list and removes all of them. Nested functions are analyzed on the way.
+    void prune(ControlFlowGraph& graph, std::vector<MemoryPtr<ASTNode>>& statements, bool reportFirst);
+    void pruneNested(ControlFlowGraph& graph, ASTNode* statement);
+
+    std::unordered_set<ControlFlowGraph::VariableId> reported; // per function, one error for every variable is enough
+};
@@ -10,8 +10,12 @@
 
 // ==== Main ====
 std::vector<Token> Lexer::tokenize(const std::string& filePath) {
+    return tokenizeSource(readFile(filePath), filePath);
+}
+
+std::vector<Token> Lexer::tokenizeSource(std::string source, const std::string& filePath) {
     tokens.clear();
-    this->source = readFile(filePath);
+    this->source = std::move(source);
     this->filePath = filePath;
     pos = 0; line = 1; column = 1;
 
@@ -9,6 +9,7 @@
 class Lexer {
 public:
     std::vector<Token> tokenize(const std::string& filePath);
+    std::vector<Token> tokenizeSource(std::string source, const std::string& filePath); // same, for a file that's already read
     void printTokens() const; // Debug command to check tokens correctness
 
     // ErrorManager is used to report errors
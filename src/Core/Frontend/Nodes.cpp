@@ -8,6 +8,7 @@
  * nice debug output tree. Nobody's gonna use this anyway unless for dev purposes like me, who cares?!
 */
 #include "Nodes.hpp"
+#include "Core/Frontend/FlowAnalysis/ControlFlowGraph.hpp"
 
 #include <format>
 #include <string>
@@ -16,6 +17,12 @@
 
 ASTNode::~ASTNode() = default;
 
+FunctionNode::FunctionNode(const std::string& name, std::vector<MemoryPtr<ParameterNode>> parameters, MemoryPtr<RawTypeNode> returnType, MemoryPtr<BlockNode> body, std::vector<MemoryPtr<CallExpressionNode>> decorators, std::vector<MemoryPtr<ModifierNode>> modifiers)
+    : name(name), parameters(std::move(parameters)), body(std::move(body)), decorators(std::move(decorators)), modifiers(std::move(modifiers)), returnType(std::move(returnType)) {
+    this->type = ASTNodeType::Function;
+}
+FunctionNode::~FunctionNode() = default;
+
 // Pure-virtual can still have a body.
 // If you get this output it means you screwed up -tsuki
 std::string ASTNode::toString(int indent) const { return std::string(indent, ' ') + "<ASTNode>"; }
@@ -124,7 +131,12 @@ static void appendPtrVec(std::string& out, const char* name, const TPtrVec& vec,
 std::string LiteralNode::toString(int indent) const {
     std::vector<std::pair<std::string, std::string>> hdr;
     appendBaseHeaderFields(hdr, *this); // includes value if not empty
-    return std::format("{}{}", ind(indent), makeHeader("Literal", hdr));
+    if (interpolations.empty()) return std::format("{}{}", ind(indent), makeHeader("Literal", hdr));
+
+    std::string out = std::format("{}{} {{\n", ind(indent), makeHeader("Literal", hdr));
+    appendPtrVec(out, "interpolations", interpolations, indent + 2);
+    out += std::format("{}}}", ind(indent));
+    return out;
 }
 
 std::string VariableNode::toString(int indent) const {
@@ -178,6 +190,7 @@ std::string RawTypeNode::toString(int indent) const {
     std::string out = std::format("{}{} {{\n", ind(indent), makeHeader("RawType", hdr));
     appendPtrField(out, "varType", varType, indent + 2);
     appendPtrField(out, "varSize", varSize, indent + 2);
+    appendPtrVec(out, "arguments", arguments, indent + 2);
     out += std::format("{}}}", ind(indent));
     return out;
 }
@@ -295,6 +308,7 @@ std::string ForLoopNode::toString(int indent) const {
 
     std::string out = std::format("{}{} {{\n", ind(indent), makeHeader("ForLoop", hdr));
     appendPtrField(out, "variable", variable, indent + 2);
+    appendPtrVec(out, "unpacked", unpacked, indent + 2);
     appendPtrField(out, "iterable", iterable, indent + 2);
     appendPtrField(out, "body", body, indent + 2);
     out += std::format("{}}}", ind(indent));
@@ -610,3 +624,33 @@ std::string ModuleNode::toString(int indent) const {
     out += std::format("{}}}", ind(indent));
     return out;
 }
+
+// ==== Queries ====
+
+bool returnsValue(const ASTNode* node) {
+    if (!node) return false;
+    switch (node->type) {
+        case ASTNodeType::ReturnStatement: return static_cast<const ReturnStatementNode*>(node)->expression != nullptr;
+        case ASTNodeType::Block:
+            for (const auto& statement : static_cast<const BlockNode*>(node)->statements)
+                if (returnsValue(statement.get())) return true;
+            return false;
+        case ASTNodeType::IfStatement: {
+            auto* ifNode = static_cast<const IfNode*>(node);
+            return returnsValue(ifNode->thenBlock.get()) || returnsValue(ifNode->elseBlock.get());
+        }
+        case ASTNodeType::WhileLoop: return returnsValue(static_cast<const WhileLoopNode*>(node)->body.get());
+        case ASTNodeType::ForLoop: return returnsValue(static_cast<const ForLoopNode*>(node)->body.get());
+        case ASTNodeType::TryCatch: {
+            auto* tryNode = static_cast<const TryCatchNode*>(node);
+            return returnsValue(tryNode->tryBlock.get()) || returnsValue(tryNode->catchBlock.get());
+        }
+        case ASTNodeType::Switch: {
+            auto* switchNode = static_cast<const SwitchNode*>(node);
+            for (const auto& branch : switchNode->cases)
+                if (returnsValue(branch->body.get())) return true;
+            return switchNode->defaultCase && returnsValue(switchNode->defaultCase->body.get());
+        }
+        default: return false;
+    }
+}
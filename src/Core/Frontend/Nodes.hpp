@@ -2,6 +2,7 @@
 #include <vector>
 #include <string>
 #include <variant>
+#include <memory>
 
 #include "../../HelperFunctions.hpp"
 
@@ -28,6 +29,10 @@ enum struct ASTPreprocessorDirectiveType {
     Import, Unsafe, Macro, None
 };
 
+enum struct ASTLiteralType {
+    Integer, Float, String, Bool, Null,
+};
+
 enum struct ASTImportType {
     /*
     Native - from dependencies
@@ -38,10 +43,16 @@ enum struct ASTImportType {
     Native, Relative, Foreign, ForeignRelative,
 };
 
+struct Type;
+struct ControlFlowGraph;
+
 struct ASTNode {
     ASTNodeType type;
     std::string value; // for basic values like literals, etc.
 
+    // Semantic type of an expression, set by SemanticAnalysis. Points into Program::types, so compare by address.
+    const Type* inferredType = nullptr;
+
     // Tracking the node for the ErrorManager purposes
     int line = 0;
     int column = 0;
@@ -65,13 +76,19 @@ struct VariableNode : ASTNode {
 };
 
 struct LiteralNode : ASTNode {
-    LiteralNode(const std::string& val = "") {
+    ASTLiteralType literalType;
+
+    LiteralNode(const std::string& val = "", ASTLiteralType literalType = ASTLiteralType::Integer) : literalType(literalType) {
         this->type = ASTNodeType::Literal;
         value = val;
     }
 
-    // TODO: add string statements to support inline data in strings
-    //std::optional<std::vector<MemoryPtr<VariableNode>>> stringStatements = std::nullopt;
+    // "a ${b + 1} c" is parsed once by the Parser: `pieces` are the texts around the `${}` ("a ", " c"), always one more
+    // than the `interpolations` inside them. Both are empty for any other literal, `value` keeps the whole text.
+    std::vector<std::string> pieces;
+    std::vector<MemoryPtr<ASTNode>> interpolations;
+
+    bool isInterpolation() const { return !interpolations.empty(); }
     std::string toString(int indent) const override;
 };
 
@@ -118,6 +135,8 @@ struct RawTypeNode : ASTNode {
     MemoryPtr<VariableNode> varType;
     // ASTNode is used only for nullptr. Be aware!
     MemoryPtr<ASTNode> varSize;
+    bool isArray = false; // written with brackets: int[] or int[4]
+    std::vector<MemoryPtr<RawTypeNode>> arguments; // written in angle brackets: dict<str, int>
 
     RawTypeNode(MemoryPtr<VariableNode> varType, MemoryPtr<ASTNode> varSize = nullptr)
     : varType(std::move(varType)), varSize(std::move(varSize)) {
@@ -198,6 +217,7 @@ struct SwitchNode : ASTNode {
 
 struct ForLoopNode : ASTNode {
     MemoryPtr<VariableNode> variable;
+    std::vector<MemoryPtr<VariableNode>> unpacked; // the ones after `variable` in `for (i, x: pairs)`, elements are unpacked into all of them
     MemoryPtr<ASTNode> iterable;
     MemoryPtr<BlockNode> body;
 
@@ -365,10 +385,13 @@ struct ModifierNode : ASTNode {
     std::string toString(int indent = 0) const override;
 };
 
+struct FunctionNode;
+
 struct CallExpressionNode : ASTNode {
     MemoryPtr<ASTNode> callee;
     std::vector<MemoryPtr<ASTNode>> arguments;
     bool isDecoratorCall = false;
+    FunctionNode* resolvedFunction = nullptr; // overload chosen by SemanticAnalysis, nullptr for dynamic calls
 
     CallExpressionNode(MemoryPtr<ASTNode> callee, std::vector<MemoryPtr<ASTNode>> arguments, bool isDecoratorCall = false)
         : callee(std::move(callee)), arguments(std::move(arguments)), isDecoratorCall(isDecoratorCall) {
@@ -465,11 +488,13 @@ struct FunctionNode : ASTNode {
     MemoryPtr<RawTypeNode> returnType = nullptr;
     MemoryPtr<BlockNode> body;
     bool isIntrinsic = false; // Is this a function that passes through an LLVM call?
+    bool isAsync = false; // A call starts it and gives a task<T> of its result, `await` inside it waits without blocking
+    std::string namespaceName; // "std.math" for a function declared in `namespace std.math`, set by the Orchestrator
+    MemoryPtr<ControlFlowGraph> controlFlow; // built by Flow Analysis on first use, see ControlFlowGraph::of()
 
-    FunctionNode(const std::string& name, std::vector<MemoryPtr<ParameterNode>> parameters, MemoryPtr<RawTypeNode> returnType, MemoryPtr<BlockNode> body,std::vector<MemoryPtr<CallExpressionNode>> decorators = {}, std::vector<MemoryPtr<ModifierNode>> modifiers = {})
-        : name(name), parameters(std::move(parameters)), body(std::move(body)), decorators(std::move(decorators)), modifiers(std::move(modifiers)), returnType(std::move(returnType)) {
-        this->type = ASTNodeType::Function;
-    }
+    // both in Nodes.cpp, where ControlFlowGraph is complete
+    FunctionNode(const std::string& name, std::vector<MemoryPtr<ParameterNode>> parameters, MemoryPtr<RawTypeNode> returnType, MemoryPtr<BlockNode> body,std::vector<MemoryPtr<CallExpressionNode>> decorators = {}, std::vector<MemoryPtr<ModifierNode>> modifiers = {});
+    ~FunctionNode() override;
 
     // Suggested by AI. If it fails, it's his fault
     std::string toString(int indent = 0) const override;
@@ -578,4 +603,8 @@ struct ModuleNode : ASTNode {
 
     // Suggested by AI. If it fails, it's his fault
     std::string toString(int indent = 0) const override;
-};
\ No newline at end of file
+};
+
+// Whether a `return` with a value is somewhere in the statement. Functions without a declared result are `dynamic`
+// for the Frontend, the backends treat the ones that never return a value as void.
+bool returnsValue(const ASTNode* node);
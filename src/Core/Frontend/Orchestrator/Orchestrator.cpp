@@ -1,6 +1,8 @@
 #include "Orchestrator.hpp"
 #include "Core/Compiler.hpp"
 
+#include <algorithm>
+
 // Helper Functions
 
 bool Orchestrator::hasEntryDecorator(const FunctionNode* function){
@@ -216,9 +218,9 @@ std::vector<ModuleInfo> Orchestrator::resolveImports(Program& program){
             auto* imp = static_cast<ImportNode*>(st.get());
             const std::string& name = imp->moduleName;
 
-            if (program.namespaces.contains(name)) {
-                mi.namespaceImports.push_back(name);
-                if (!imp->alias.empty()) mi.namespaceAliasMap.emplace(imp->alias, name);
+            if (auto* ns = program.namespaces ? program.namespaces->resolve(std::string_view(name)) : nullptr) {
+                mi.namespaceImports.push_back(ns);
+                if (!imp->alias.empty()) mi.namespaceAliasMap.emplace(imp->alias, ns);
                 continue;
             }
 
@@ -272,8 +274,8 @@ std::vector<ModuleInfo> Orchestrator::resolveImports(Program& program){
     return infos;
 }
 
-std::unordered_map<std::string, NamespaceInfo> Orchestrator::collectNamespaces(const std::vector<MemoryPtr<ModuleNode>>& modules) {
-    std::unordered_map<std::string, NamespaceInfo> namespaces;
+MemoryPtr<NamespaceInfo> Orchestrator::collectNamespaces(const std::vector<MemoryPtr<ModuleNode>>& modules) {
+    auto root = makeMemoryPtr<NamespaceInfo>();
 
     for (const auto& module : modules) {
         if (!module) continue;
@@ -282,13 +284,124 @@ std::unordered_map<std::string, NamespaceInfo> Orchestrator::collectNamespaces(c
             if (!statement || statement->type != ASTNodeType::Namespace) continue;
 
             auto* node = static_cast<NamespaceNode*>(statement.get());
-            const std::string& name = node->value;
+            mergeNamespace(*root, node);
+        }
+    }
+
+    return root;
+}
 
-            if (!namespaces.contains(name)) namespaces.emplace(name, NamespaceInfo{name, {}});
+// Opens (or creates) every level of `name` under `level` and returns the deepest one.
+NamespaceInfo* Orchestrator::openNamespace(NamespaceInfo& level, ASTNode* name) {
+    if (!name) return nullptr;
+
+    if (name->type == ASTNodeType::MemberAccess) {
+        auto* ma = static_cast<MemberAccessNode*>(name);
+        auto* parent = openNamespace(level, ma->parent.get());
+        return parent ? openNamespace(*parent, ma->val.get()) : nullptr;
+    }
+    if (name->type != ASTNodeType::Variable) return nullptr;
+
+    const std::string& component = static_cast<VariableNode*>(name)->varName;
+    auto [it, inserted] = level.children.try_emplace(component);
+    auto& slot = it->second;
+    if (inserted) {
+        slot = makeMemoryPtr<NamespaceInfo>();
+        slot->name = component;
+        slot->parent = &level;
+    }
+    return slot.get();
+}
+
+// Merges one `namespace` declaration into the tree. Symbols of every declaration end up in the same table,
+// so `namespace std.io` split over several files is still a single level.
+void Orchestrator::mergeNamespace(NamespaceInfo& level, NamespaceNode* node) {
+    NamespaceInfo* info = openNamespace(level, node->name.get());
+    if (!info) return;
+
+    info->declarations.push_back(node);
+
+    for (const auto& statement : node->body) {
+        if (!statement) continue;
+
+        switch (statement->type) {
+            case ASTNodeType::Function: {
+                auto* function = static_cast<FunctionNode*>(statement.get());
+                function->namespaceName = info->fullName();
+                info->members[function->name].push_back(function);
+                break;
+            }
+            case ASTNodeType::Class: info->members[static_cast<ClassNode*>(statement.get())->name].push_back(statement.get()); break;
+            case ASTNodeType::Enum: info->members[static_cast<EnumNode*>(statement.get())->name].push_back(statement.get()); break;
+            case ASTNodeType::Interface: info->members[static_cast<InterfaceNode*>(statement.get())->name].push_back(statement.get()); break;
+            case ASTNodeType::Decorator: info->members[static_cast<DecoratorNode*>(statement.get())->name].push_back(statement.get()); break;
+            case ASTNodeType::Declaration: info->members[static_cast<DeclarationNode*>(statement.get())->variable->varName].push_back(statement.get()); break;
+            case ASTNodeType::Namespace: mergeNamespace(*info, static_cast<NamespaceNode*>(statement.get())); break;
+            default: break;
+        }
+    }
+}
 
-            namespaces[name].declarations.push_back(node);
+// Opens the namespaces of a module known only by its symbol index. Members stay in the index until they're looked up.
+void Orchestrator::mergeIndex(NamespaceInfo& root, const SymbolIndex& index) {
+    for (const auto& entry : index.entries()) {
+        if (entry.kind != SymbolIndex::Kind::Namespace) continue;
+
+        NamespaceInfo* level = &root;
+        std::string_view path = index.name(entry);
+        while (level && !path.empty()) {
+            size_t dot = path.find('.');
+            std::string component(path.substr(0, dot));
+            auto [it, inserted] = level->children.try_emplace(component);
+            if (inserted) {
+                it->second = makeMemoryPtr<NamespaceInfo>();
+                it->second->name = component;
+                it->second->parent = level;
+            }
+            level = it->second.get();
+            path = dot == std::string_view::npos ? std::string_view{} : path.substr(dot + 1);
         }
+        if (std::find(level->indexes.begin(), level->indexes.end(), &index) == level->indexes.end()) level->indexes.push_back(&index);
     }
+}
+
+// ==== NamespaceInfo ====
+
+NamespaceInfo* NamespaceInfo::child(std::string_view component) const {
+    auto it = children.find(component);
+    return it == children.end() ? nullptr : it->second.get();
+}
 
-    return namespaces;
-}
\ No newline at end of file
+const std::vector<ASTNode*>* NamespaceInfo::member(std::string_view symbol) const {
+    auto it = members.find(symbol);
+    return it == members.end() ? nullptr : &it->second;
+}
+
+NamespaceInfo* NamespaceInfo::resolve(std::string_view path) {
+    NamespaceInfo* level = this;
+
+    while (level && !path.empty()) {
+        size_t dot = path.find('.');
+        level = level->child(path.substr(0, dot));
+        path = dot == std::string_view::npos ? std::string_view{} : path.substr(dot + 1);
+    }
+    return level;
+}
+
+NamespaceInfo* NamespaceInfo::resolve(ASTNode* path) {
+    if (!path) return nullptr;
+
+    if (path->type == ASTNodeType::MemberAccess) {
+        auto* ma = static_cast<MemberAccessNode*>(path);
+        auto* parentLevel = resolve(ma->parent.get());
+        return parentLevel ? parentLevel->resolve(ma->val.get()) : nullptr;
+    }
+    if (path->type == ASTNodeType::Variable) return child(static_cast<VariableNode*>(path)->varName);
+
+    return nullptr;
+}
+
+std::string NamespaceInfo::fullName() const {
+    if (!parent || parent->isRoot()) return name;
+    return parent->fullName() + "." + name;
+}
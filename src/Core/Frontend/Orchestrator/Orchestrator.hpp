@@ -1,12 +1,14 @@
 #pragma once
 #include "../Nodes.hpp"
 #include "Core/Extras/ErrorManager/ErrorManager.hpp"
+#include <string_view>
 #include <unordered_map>
 
 // helper declarations
 using ModuleId = int;
 struct Compiler;
 struct Program;
+struct SymbolIndex;
 
 struct EntryPoint {
     ModuleNode* module = nullptr;
@@ -20,6 +22,39 @@ struct DependencyEdge {
 
 // main data declarations
 
+// Transparent hash so namespace levels can be probed with a std::string_view component without copying it.
+struct NamespaceKeyHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+};
+
+// NamespaceInfo is one level of the namespace tree. `std.math` lives at root -> "std" -> "math", and every level keeps
+// a symbol table merged from all `namespace` declarations that open it, no matter which file they're in.
+struct NamespaceInfo {
+    std::string name; // only the last component, e.g. "math"
+    NamespaceInfo* parent = nullptr;
+    std::vector<NamespaceNode*> declarations;
+
+    std::unordered_map<std::string, MemoryPtr<NamespaceInfo>, NamespaceKeyHash, std::equal_to<>> children;
+    std::unordered_map<std::string, std::vector<ASTNode*>, NamespaceKeyHash, std::equal_to<>> members; // functions can be overloaded, so every name keeps all of its declarations
+
+    // Dependency modules loaded from their symbol index declare members here without a tree.
+    // Their declarations are only created when a name is first looked up, see SemanticAnalysis::namespaceMember().
+    std::vector<const SymbolIndex*> indexes;
+    std::vector<MemoryPtr<ASTNode>> imported; // declarations created from `indexes`, owned by the level
+
+    NamespaceInfo* child(std::string_view component) const;
+    const std::vector<ASTNode*>* member(std::string_view symbol) const;
+
+    // Walks a dotted path ("std.math") component by component. Returns nullptr if any level is missing.
+    NamespaceInfo* resolve(std::string_view path);
+    // Same, but for a name written in code (VariableNode or a chain of MemberAccessNode).
+    NamespaceInfo* resolve(ASTNode* path);
+
+    std::string fullName() const; // only used for diagnostics
+    bool isRoot() const { return parent == nullptr; }
+};
+
 struct ModuleInfo {
     ModuleId id;
     ModuleNode* module;
@@ -27,13 +62,8 @@ struct ModuleInfo {
     std::unordered_map<std::string, ModuleId> aliasMap;
     std::vector<std::string> nativeImports; // for packages that import from dependencies or std, like "math", "std", "tazer"
 
-    std::vector<std::string> namespaceImports;
-    std::unordered_map<std::string, std::string> namespaceAliasMap;
-};
-
-struct NamespaceInfo {
-    std::string name;
-    std::vector<NamespaceNode*> declarations;
+    std::vector<NamespaceInfo*> namespaceImports;
+    std::unordered_map<std::string, NamespaceInfo*> namespaceAliasMap;
 };
 
 // Orchestrator is a struct that allows us to stitch the project together into a working program, that can be fed to the Semantic Analysis and lower parts of the Compiler.
@@ -45,10 +75,13 @@ struct Orchestrator {
     void stitchProgram(Program& program);
     EntryPoint findEntryPoint(const std::vector<MemoryPtr<ModuleNode>>& modules);
     std::vector<ModuleInfo> resolveImports(Program& program);
-    std::unordered_map<std::string, NamespaceInfo> collectNamespaces(const std::vector<MemoryPtr<ModuleNode>>& modules);
+    MemoryPtr<NamespaceInfo> collectNamespaces(const std::vector<MemoryPtr<ModuleNode>>& modules);
 
     // helper functions
     static bool hasEntryDecorator(const FunctionNode* function);
+    static void mergeNamespace(NamespaceInfo& level, NamespaceNode* node);
+    static void mergeIndex(NamespaceInfo& root, const SymbolIndex& index); // opens every namespace the index declares
+    static NamespaceInfo* openNamespace(NamespaceInfo& level, ASTNode* name);
     void dfsVisit(ModuleId id, const std::vector<ModuleInfo>& infos, std::vector<uint8_t>& state, std::vector<ModuleId>& order, const ErrorSpan* fromSpan);
 
     static std::vector<std::string> splitPath(const std::string& path);
@@ -4,8 +4,8 @@
 
 struct ASTBuilder {
     // Creates a LiteralNode
-    static MemoryPtr<LiteralNode> createLiteral(const std::string& val = "") {
-        return makeMemoryPtr<LiteralNode>(val);
+    static MemoryPtr<LiteralNode> createLiteral(const std::string& val = "", ASTLiteralType literalType = ASTLiteralType::Integer) {
+        return makeMemoryPtr<LiteralNode>(val, literalType);
     }
 
     // Creates a VariableNode
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <print>
 #include <algorithm>
+#include <utility>
 
 #include "Core/Compiler.hpp"
 #include "Libraries/Color/Color.hpp"
@@ -192,7 +193,9 @@ MemoryPtr<ASTNode> Parser::parseExpression() {
     if (om.find(token.value) != om.end()) {
         if (match(token, Operators::LogicalNot) || match(token, Operators::Subtract)) {
             next();
-            return parseUnary(token.value);
+            auto node = parseUnary(token.value);
+            if (node) { node->line = token.line; node->column = token.column; node->filePath = token.filePath; }
+            return node;
         }
     }
 
@@ -201,8 +204,8 @@ MemoryPtr<ASTNode> Parser::parseExpression() {
         return parseAssignment();
     }
 
-    // Fallback to binary
-    return parseBinary(0);
+    // Fallback to binary, starting from the loosest operator (||)
+    return parseBinary(getOperatorPrecedence("||"));
 }
 
 MemoryPtr<ASTNode> Parser::parseBinary(int prevPredecence) {
@@ -227,6 +230,64 @@ MemoryPtr<ASTNode> Parser::parseBinary(int prevPredecence) {
     return left;
 }
 
+bool Parser::parseInterpolations(LiteralNode* node, const Token& token) {
+    // "a ${b + 1} c": every `${...}` is lexed and parsed on its own, positions are shifted to where it is in the file
+    const std::string& text = token.value;
+    size_t i = 0;
+    for (size_t start = text.find("${"); start != std::string::npos; start = text.find("${", i)) {
+        size_t end = start + 2;
+        for (int depth = 1; end < text.size(); end++) {
+            if (text[end] == '{') depth++;
+            else if (text[end] == '}' && --depth == 0) break;
+        }
+        if (end >= text.size()) break; // never closed, the rest is text
+
+        Lexer lexer;
+        lexer.errorManager = errorManager;
+        std::vector<Token> inner = lexer.tokenizeSource(text.substr(start + 2, end - start - 2), token.filePath);
+        // offsets are counted in the unescaped text, so they're exact unless an escape comes before the `${`
+        size_t lineStart = text.rfind('\n', start);
+        int line = token.line + static_cast<int>(std::count(text.begin(), text.begin() + start, '\n'));
+        int column = lineStart == std::string::npos ? token.column + 1 + static_cast<int>(start) + 2 : static_cast<int>(start - lineStart) + 2;
+        for (Token& t : inner) {
+            if (t.line == 1) t.column += column - 1;
+            t.line += line - 1;
+        }
+        inner.erase(std::remove_if(inner.begin(), inner.end(), [](const Token& t) { return t.type == TokenType::Delimeter && t.value == "\\n"; }), inner.end());
+
+        // the expression is parsed from its own tokens, then the Parser goes back to the file
+        std::vector<Token> outer = std::exchange(tokens, std::move(inner));
+        size_t outerPos = std::exchange(pos, 0);
+        bool empty = isAtEnd();
+        MemoryPtr<ASTNode> expression = empty ? nullptr : parseExpression();
+        Token rest = curToken();
+        bool complete = isAtEnd();
+        tokens = std::move(outer);
+        pos = outerPos;
+
+        if (empty) {
+            errorManager->addError(ErrorType::Syntax, SyntaxErrors::MissingToken,
+                ErrorSpan{token.filePath, "${}", line, column - 2},
+                "ErrorManager.Syntax.MissingToken.interpolation.message", {},
+                "ErrorManager.Syntax.MissingToken.interpolation.hint");
+            return false;
+        }
+        if (!expression) return false; // already reported
+        if (!complete) {
+            errorManager->addError(ErrorType::Syntax, SyntaxErrors::UnexpectedToken,
+                ErrorSpan{rest.filePath, rest.value, rest.line, rest.column},
+                "ErrorManager.Syntax.UnexpectedToken.message", {rest.value},
+                "ErrorManager.Syntax.UnexpectedToken.hint");
+            return false;
+        }
+        node->pieces.push_back(text.substr(i, start - i));
+        node->interpolations.push_back(std::move(expression));
+        i = end + 1;
+    }
+    if (!node->interpolations.empty()) node->pieces.push_back(text.substr(i));
+    return true;
+}
+
 MemoryPtr<UnaryOperationNode> Parser::parseUnary(const std::string& op) {
     MemoryPtr<ASTNode> operand = parsePrimary();
     if (!operand) {
@@ -407,12 +468,30 @@ MemoryPtr<ASTNode> Parser::parsePrimary() {
     else if ((match(TokenType::Number) || match(TokenType::String))
     || (match(TokenType::Identifier) && (token.value == "true" || token.value == "false"))) {
         next();
-        return ASTBuilder::createLiteral(token.value);
+        ASTLiteralType literalType = ASTLiteralType::Bool;
+        if (match(token, TokenType::String)) literalType = ASTLiteralType::String;
+        else if (match(token, TokenType::Number))
+            literalType = token.value.find_first_of(".eE") != std::string::npos ? ASTLiteralType::Float : ASTLiteralType::Integer;
+
+        auto node = ASTBuilder::createLiteral(token.value, literalType);
+        node->line = token.line; node->column = token.column; node->filePath = token.filePath;
+        if (literalType == ASTLiteralType::String && !parseInterpolations(node.get(), token)) return nullptr;
+        return node;
     }
     // Null
     else if (match(TokenType::Null)) {
         next();
-        return ASTBuilder::createLiteral("null");
+        auto node = ASTBuilder::createLiteral("null", ASTLiteralType::Null);
+        node->line = token.line; node->column = token.column; node->filePath = token.filePath;
+        return node;
+    }
+
+    // `await task`, wherever an operand can be
+    else if (match(Keywords::Await)) {
+        next();
+        auto node = parseUnary(token.value);
+        if (node) { node->line = token.line; node->column = token.column; node->filePath = token.filePath; }
+        return node;
     }
 
     // Identifier/variable or function call
@@ -448,6 +527,7 @@ MemoryPtr<ASTNode> Parser::parsePrimary() {
             // else identifier/variable
             node = ASTBuilder::createVariable(id.value);
         }
+        node->line = id.line; node->column = id.column; node->filePath = id.filePath;
 
         while (match(Delimeters::Dot)) {
             next();
@@ -461,17 +541,39 @@ MemoryPtr<ASTNode> Parser::parsePrimary() {
                     "ErrorManager.Syntax.UnexpectedToken.hint");
                 return nullptr;
             }
-            MemoryPtr<ASTNode> member = parsePrimary();
-            if (!member) return nullptr;
-            if (member->type != ASTNodeType::Variable && member->type != ASTNodeType::CallExpression) {
-                errorManager->addError(
-                    ErrorType::Syntax, SyntaxErrors::InvalidStatement,
-                    ErrorSpan{member->filePath, member->value, member->line, member->column},
-                    "ErrorManager.Syntax.InvalidStatement.message", {},
-                    "ErrorManager.Syntax.InvalidStatement.hint");
-                return nullptr;
-            }
+            // Only one component is taken per iteration, so `a.b.c` is built left to right:
+            // MemberAccess(MemberAccess(a, b), c). Namespace lookups rely on that shape.
+            Token memberToken = next();
+            MemoryPtr<ASTNode> member;
+            if (match(Delimeters::LeftParen)) {
+                next();
+                std::vector<MemoryPtr<ASTNode>> args;
+
+                while (!match(Delimeters::RightParen)) {
+                    auto arg = parseExpression();
+                    if (arg) args.push_back(std::move(arg));
+
+                    if (match(Delimeters::Comma)) next();
+                    else break;
+                }
+                if (!match(Delimeters::RightParen)) {
+                    errorManager->addError(
+                        ErrorType::Syntax, SyntaxErrors::MissingToken,
+                        ErrorSpan{memberToken.filePath, memberToken.value, memberToken.line, memberToken.column},
+                        "ErrorManager.Syntax.MissingToken.closingParen.message", {memberToken.value},
+                        "ErrorManager.Syntax.MissingToken.closingParen.hint", {memberToken.value});
+                    return nullptr;
+                }
+                next();
+
+                auto callee = ASTBuilder::createVariable(memberToken.value);
+                callee->line = memberToken.line; callee->column = memberToken.column; callee->filePath = memberToken.filePath;
+                member = ASTBuilder::createCallExpression(std::move(callee), std::move(args));
+            } else member = ASTBuilder::createVariable(memberToken.value);
+            member->line = memberToken.line; member->column = memberToken.column; member->filePath = memberToken.filePath;
+
             node = ASTBuilder::createMemberAccess(std::move(parent), std::move(member));
+            node->line = id.line; node->column = id.column; node->filePath = id.filePath;
         }
         node->line = id.line; node->column = id.column; node->filePath = id.filePath;
         return node;
@@ -494,11 +596,41 @@ MemoryPtr<RawTypeNode> Parser::parseType() {
             "ErrorManager.Syntax.InvalidStatement.noType.hint");
         return nullptr;
     }
-    MemoryPtr<VariableNode> varType = ASTBuilder::createVariable(curToken().value);
+    Token typeToken = curToken();
+    MemoryPtr<VariableNode> varType = ASTBuilder::createVariable(typeToken.value);
     next();
 
+    // type arguments: set<int>, dict<str, int>, iter<int>
+    std::vector<MemoryPtr<RawTypeNode>> arguments;
+    if (match(Operators::LessThan)) {
+        next();
+        while (true) {
+            MemoryPtr<RawTypeNode> argument = parseType();
+            if (!argument) return nullptr;
+            arguments.push_back(std::move(argument));
+            if (!match(Delimeters::Comma)) break;
+            next();
+        }
+        // `>>` closes two lists at once, this one takes its first half
+        if (match(Operators::BitwiseRightShift)) {
+            tokens[pos].value = ">";
+            tokens[pos].column++;
+        }
+        else if (match(Operators::GreaterThan)) next();
+        else {
+            errorManager->addError(
+                ErrorType::Syntax, SyntaxErrors::MissingToken,
+                ErrorSpan{curToken().filePath, curToken().value, curToken().line, curToken().column},
+                "ErrorManager.Syntax.MissingToken.closingAngle.message", {typeToken.value},
+                "ErrorManager.Syntax.MissingToken.closingAngle.hint");
+            return nullptr;
+        }
+    }
+
     MemoryPtr<ASTNode> varSize = nullptr;
+    bool isArray = false;
     if (match(Delimeters::LeftBracket)){
+        isArray = true;
         next();
         if (match(TokenType::Identifier) || match(TokenType::Number)) varSize = parseExpression();
         if (!match(Delimeters::RightBracket))
@@ -513,7 +645,11 @@ MemoryPtr<RawTypeNode> Parser::parseType() {
         next();
     }
 
-    return ASTBuilder::createRawType(std::move(varType), std::move(varSize));
+    auto node = ASTBuilder::createRawType(std::move(varType), std::move(varSize));
+    node->isArray = isArray;
+    node->arguments = std::move(arguments);
+    node->line = typeToken.line; node->column = typeToken.column; node->filePath = typeToken.filePath;
+    return node;
 }
 
 MemoryPtr<DeclarationNode> Parser::parseDeclaration(std::vector<MemoryPtr<CallExpressionNode>> decorators, std::vector<MemoryPtr<ModifierNode>> modifiers)
@@ -881,6 +1017,24 @@ MemoryPtr<ForLoopNode> Parser::parseFor() {
     auto varNode = ASTBuilder::createVariable(varName);
     next();
 
+    // for (i, x: pairs)
+    std::vector<MemoryPtr<VariableNode>> unpacked;
+    while (match(Delimeters::Comma)) {
+        next();
+        if (curToken().type != TokenType::Identifier) {
+            errorManager->addError(
+                ErrorType::Syntax, SyntaxErrors::MissingToken,
+                ErrorSpan{curToken().filePath, curToken().value, curToken().line, curToken().column},
+                "ErrorManager.Syntax.MissingToken.noVariableAfter.message", {varName + ","},
+                "ErrorManager.Syntax.MissingToken.noVariableAfter.hint", {varName + ","});
+            return nullptr;
+        }
+        auto variable = ASTBuilder::createVariable(curToken().value);
+        variable->line = curToken().line; variable->column = curToken().column; variable->filePath = curToken().filePath;
+        unpacked.push_back(std::move(variable));
+        next();
+    }
+
     if (!match(Delimeters::Colon)) {
         errorManager->addError(
             ErrorType::Syntax, SyntaxErrors::MissingToken,
@@ -922,6 +1076,7 @@ MemoryPtr<ForLoopNode> Parser::parseFor() {
     }
 
     auto node = ASTBuilder::createForLoop(std::move(varNode), std::move(iterable), std::move(body));
+    node->unpacked = std::move(unpacked);
     node->line = token.line; node->column = token.column; node->filePath = token.filePath;
     return node;
 }
@@ -1054,23 +1209,34 @@ MemoryPtr<FunctionNode> Parser::parseFunction(std::vector<MemoryPtr<CallExpressi
         returnType = parseType();
     }
 
-    MemoryPtr<BlockNode> body = parseBlock();
-    if (!body) {
-        errorManager->addError(
-            ErrorType::Syntax, SyntaxErrors::InvalidStatement,
-            ErrorSpan{nameToken.filePath, nameToken.value, nameToken.line, nameToken.column},
-            "ErrorManager.Syntax.MissingToken.functionBody.message", {funcName},
-            "ErrorManager.Syntax.MissingToken.functionBody.hint", {funcName});
-        return nullptr;
+    bool isIntrinsic = false, isAsync = false;
+    for (const auto& modifier : modifiers) {
+        if (modifier->modifier == ASTModifierType::Intrinsic) isIntrinsic = true;
+        if (modifier->modifier == ASTModifierType::Async) isAsync = true;
     }
 
-    auto node = ASTBuilder::createFunction(funcName, std::move(params), std::move(returnType), std::move(body), std::move(decorators), std::move(modifiers));
-    for (const auto& modifier : modifiers) {
-        if (modifier->modifier == ASTModifierType::Intrinsic) {
-            node->isIntrinsic = true;
-            node->body = nullptr;
+    // intrinsic functions are only declarations, LLVM provides the body: `intrinsic fn sqrt(value: float) -> float;`
+    MemoryPtr<BlockNode> body = nullptr;
+    if (isIntrinsic && !match(Delimeters::LeftBraces)) {
+        if (isNextLine()) next();
+    } else {
+        body = parseBlock();
+        if (!body) {
+            errorManager->addError(
+                ErrorType::Syntax, SyntaxErrors::InvalidStatement,
+                ErrorSpan{nameToken.filePath, nameToken.value, nameToken.line, nameToken.column},
+                "ErrorManager.Syntax.MissingToken.functionBody.message", {funcName},
+                "ErrorManager.Syntax.MissingToken.functionBody.hint", {funcName});
+            return nullptr;
         }
     }
+
+    auto node = ASTBuilder::createFunction(funcName, std::move(params), std::move(returnType), std::move(body), std::move(decorators), std::move(modifiers));
+    if (isIntrinsic) {
+        node->isIntrinsic = true;
+        node->body = nullptr;
+    }
+    node->isAsync = isAsync;
     node->line = nameToken.line; node->column = nameToken.column; node->filePath = nameToken.filePath;
     return node;
 }
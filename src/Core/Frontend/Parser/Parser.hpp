@@ -106,6 +106,7 @@ struct Parser {
     MemoryPtr<ASTNode> parseBinary(int prevPrecedence = 0);
     MemoryPtr<UnaryOperationNode> parseUnary(const std::string& op);
     MemoryPtr<RawTypeNode> parseType();
+    bool parseInterpolations(LiteralNode* node, const Token& token); // splits "a ${b} c" into pieces and expressions
 
     // Statement parsing
     MemoryPtr<ASTNode> parseStatement();
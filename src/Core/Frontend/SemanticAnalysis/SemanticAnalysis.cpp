@@ -1,18 +1,14 @@
 #include "SemanticAnalysis.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <utility>
 
 #include "Core/Compiler.hpp"
 
 // ==== Main function ====
 void SemanticAnalysis::analyzeProgram(Program& program){
-    pushScope();
-
-    // Defines all built-in decorators.
-    auto& dm = getDecoratorMap();
-    for (const auto& [name, _] : dm) {
-        declareName(name, Symbol{Symbol::Kind::Decorator, false, "", 0, 0}, nullptr);
-    }
+    beginProgram(program);
 
     for (ModuleId id : program.order) {
         if (id < 0 || id >= static_cast<ModuleId>(program.moduleInfos.size()))
@@ -22,27 +18,86 @@ void SemanticAnalysis::analyzeProgram(Program& program){
         if (!module)
             continue;
 
-        if (!program.moduleInfos[id].module)
-            std::println(std::cerr, "NULL MODULE INFO: {}", id);
+        currentModule = &program.moduleInfos[id];
         analyzeModule(module);
     }
+    currentModule = nullptr;
+
+    popScope();
+}
+
+void SemanticAnalysis::analyzeModuleOf(Program& program, ModuleId id) {
+    if (id < 0 || id >= static_cast<ModuleId>(program.moduleInfos.size()) || !program.moduleInfos[id].module) return;
+    beginProgram(program);
+
+    // Modules before this one leak their top-level names into it, the same way they do in analyzeProgram().
+    // Their errors were already reported by their own analysis, so whatever comes up here is dropped.
+    size_t errorMark = errorManager->errors.size();
+    for (ModuleId previous : program.order) {
+        if (previous == id) break;
+        if (previous < 0 || previous >= static_cast<ModuleId>(program.moduleInfos.size()) || !program.moduleInfos[previous].module) continue;
+
+        currentModule = &program.moduleInfos[previous];
+        redeclareModule(program.moduleInfos[previous].module);
+    }
+    errorManager->errors.erase(errorManager->errors.begin() + errorMark, errorManager->errors.end());
+
+    currentModule = &program.moduleInfos[id];
+    analyzeModule(program.moduleInfos[id].module);
+    currentModule = nullptr;
+
+    popScope();
+}
+
+void SemanticAnalysis::resolveSignatures(Program& program, ModuleNode* module) {
+    beginProgram(program);
+
+    // only built-in types and global names are visible here, the same as when a namespace member is typed on access
+    std::function<void(const std::vector<MemoryPtr<ASTNode>>&)> walk = [&](const std::vector<MemoryPtr<ASTNode>>& body) {
+        for (const auto& statement : body) {
+            if (match(statement.get(), ASTNodeType::Function)) functionType(static_cast<FunctionNode*>(statement.get()));
+            else if (match(statement.get(), ASTNodeType::Namespace)) walk(static_cast<NamespaceNode*>(statement.get())->body);
+        }
+    };
+    walk(module->body);
 
     popScope();
 }
 
+void SemanticAnalysis::beginProgram(Program& program) {
+    nameIds.clear(); innermost.clear(); symbols.clear(); scopeMarks.clear();
+    overloadSets.clear(); signatureIndex.clear(); arityIndex.clear(); namespaceOverloads.clear();
+    loopDepth = 0; functionDepth = 0;
+    currentReturnType = nullptr; currentNamespace = nullptr; currentModule = nullptr;
+
+    namespaces = program.namespaces.get();
+    if (!program.types) program.types = makeMemoryPtr<TypeContext>();
+    types = program.types.get();
+    pushScope();
+
+    // Defines all built-in decorators.
+    auto& dm = getDecoratorMap();
+    for (const auto& [name, _] : dm) {
+        declareName(name, Symbol{Symbol::Kind::Decorator, false, "", 0, 0}, nullptr);
+    }
+}
+
 /* Module analysis usually breaks down into two passes
  * 1. Declaration - we get all the symbols used in code, before checking their work logic
  * 2. Analysis - we pass through the whole module body, calling each analyze* for each part
  */
 void SemanticAnalysis::analyzeModule(ModuleNode* module) {
+    declareModule(module);
+
+    // Analysis pass
+    for (const auto& statement : module->body)
+        analyzeStatement(statement.get());
+}
+
+void SemanticAnalysis::declareModule(ModuleNode* module) {
     // Declaration pass
     for (const auto& statement : module->body){
-        if (match(statement.get(), ASTNodeType::Function)) {
-            auto* node = static_cast<FunctionNode*>(statement.get());
-            bool isConst = false;
-            for (auto& modifier : node->modifiers) if (modifier.get()->modifier == ASTModifierType::Const) isConst = true;
-            declareName(node->name, Symbol{Symbol::Kind::Function, isConst, node->filePath, node->line, node->column}, node);
-        }
+        if (match(statement.get(), ASTNodeType::Function)) declareFunction(static_cast<FunctionNode*>(statement.get()));
         else if (match(statement.get(), ASTNodeType::Class)) {
             auto* node = static_cast<ClassNode*>(statement.get());
             bool isConst = false;
@@ -65,83 +120,133 @@ void SemanticAnalysis::analyzeModule(ModuleNode* module) {
         }
     }
 
-    // Analysis pass
-    for (const auto& statement : module->body)
-        analyzeStatement(statement.get());
+    // Signatures are resolved once every type of the module is declared
+    for (const auto& statement : module->body) {
+        if (!match(statement.get(), ASTNodeType::Function)) continue;
+        auto* node = static_cast<FunctionNode*>(statement.get());
+        auto* symbol = findName(node->name);
+        if (!symbol || !symbol->overloads) continue;
+        addOverload(symbol->overloads, node);
+        symbol->type = overloadSetType(symbol->overloads);
+    }
+    for (const auto& statement : module->body) {
+        if (!match(statement.get(), ASTNodeType::Class) && !match(statement.get(), ASTNodeType::Enum) && !match(statement.get(), ASTNodeType::Interface)) continue;
+        const std::string& name = match(statement.get(), ASTNodeType::Class) ? static_cast<ClassNode*>(statement.get())->name
+            : match(statement.get(), ASTNodeType::Enum) ? static_cast<EnumNode*>(statement.get())->name : static_cast<InterfaceNode*>(statement.get())->name;
+        if (auto* symbol = findName(name)) symbol->type = types->userDefined(name);
+    }
+}
+
+// Replays what the module declared at the top level, taking the types its own analysis already inferred.
+void SemanticAnalysis::redeclareModule(ModuleNode* module) {
+    declareModule(module);
+
+    for (const auto& statement : module->body) {
+        if (!match(statement.get(), ASTNodeType::Declaration)) continue;
+        auto* node = static_cast<DeclarationNode*>(statement.get());
+        bool isConst = false;
+        for (auto& modifier : node->modifiers) if (modifier.get()->modifier == ASTModifierType::Const) isConst = true;
+        declareName(node->variable->varName, Symbol{Symbol::Kind::Variable, isConst, node->filePath, node->line, node->column, node->inferredType}, node);
+    }
 }
 
-void SemanticAnalysis::analyzeExpression(ASTNode* node) {
-    if (!node) return;
+const Type* SemanticAnalysis::analyzeExpression(ASTNode* node, const Type* expected) {
+    if (!node) return types->dynamic();
+
+    const Type* type = inferExpression(node, expected);
+    node->inferredType = type;
+    return type;
+}
 
+const Type* SemanticAnalysis::inferExpression(ASTNode* node, const Type* expected) {
     switch (node->type) {
+        case ASTNodeType::Literal: return analyzeLiteral(static_cast<LiteralNode*>(node), expected);
         case ASTNodeType::Variable: {
             auto* var = static_cast<VariableNode*>(node);
-            if (!findName(var->varName))
+            auto* symbol = findName(var->varName);
+            if (!symbol) {
                 errorManager->addError(ErrorType::Analysis, AnalysisErrors::UndefinedVariable,
                     ErrorSpan{node->filePath, var->varName, node->line, node->column},
                     "ErrorManager.Analysis.UndefinedVariable.message", {var->varName},
                     "ErrorManager.Analysis.UndefinedVariable.hint");
-            break;
-        }
-        case ASTNodeType::CallExpression:
-            analyzeCallExpression(static_cast<CallExpressionNode*>(node)); break;
-        case ASTNodeType::BinaryOperation: {
-            auto* bin = static_cast<BinaryOperationNode*>(node);
-            analyzeExpression(bin->leftOperand.get());
-            analyzeExpression(bin->rightOperand.get());
-            break;
-        }
-        case ASTNodeType::UnaryOperation:
-            analyzeExpression(static_cast<UnaryOperationNode*>(node)->operand.get()); break;
-        case ASTNodeType::MemberAccess: {
-            auto* ma = static_cast<MemberAccessNode*>(node);
-            analyzeExpression(ma->parent.get());
-            break;
+                return types->dynamic();
+            }
+            // a function passed as a value, `xs.iter().map(square)`, has its type if it isn't overloaded
+            if (symbol->kind == Symbol::Kind::Function && symbol->overloads && symbol->overloads->functions.size() == 1)
+                return functionType(symbol->overloads->functions.front());
+            return symbolType(symbol);
         }
+        case ASTNodeType::CallExpression: return analyzeCallExpression(static_cast<CallExpressionNode*>(node));
+        case ASTNodeType::BinaryOperation: return analyzeBinary(static_cast<BinaryOperationNode*>(node), expected);
+        case ASTNodeType::UnaryOperation: return analyzeUnary(static_cast<UnaryOperationNode*>(node), expected);
+        case ASTNodeType::MemberAccess: return analyzeMemberAccess(static_cast<MemberAccessNode*>(node));
         case ASTNodeType::Array:
-            for (const auto& el : static_cast<ArrayNode*>(node)->elements) analyzeExpression(el.get());
-            break;
         case ASTNodeType::Set:
-            for (const auto& el : static_cast<SetNode*>(node)->elements) analyzeExpression(el.get());
-            break;
         case ASTNodeType::Dict:
-            for (const auto& [k, v] : static_cast<DictNode*>(node)->elements) {
-                analyzeExpression(k.get());
-                analyzeExpression(v.get());
-            }
-            break;
-        case ASTNodeType::Lambda: {
-            analyzeLambda(static_cast<LambdaNode*>(node)); break;
-        }
+            return analyzeCollection(node, expected);
+        case ASTNodeType::Tuple:
+            for (const auto& el : static_cast<TupleNode*>(node)->elements) analyzeExpression(el.get());
+            return types->dynamic();
+        case ASTNodeType::Lambda: return analyzeLambda(static_cast<LambdaNode*>(node), expected);
         default:
-            break;
+            return types->dynamic();
     }
 }
 
 void SemanticAnalysis::analyzeFunction(FunctionNode* node) {
+    const Type* signature = functionType(node);
+    const Type* previousReturnType = currentReturnType;
+    bool wasAsync = isAsync;
+    // the body of an async function returns what its task gives
+    currentReturnType = node->isAsync ? signature->returnType()->element() : signature->returnType();
+    isAsync = node->isAsync;
+
+    if (node->returnType && !resolveType(node->returnType.get()))
+        errorManager->addError(ErrorType::Analysis, AnalysisErrors::UnknownType,
+            ErrorSpan{node->returnType->filePath, node->returnType->varType->varName, node->returnType->line, node->returnType->column},
+            "ErrorManager.Analysis.UnknownType.message", {node->returnType->varType->varName, node->name},
+            "ErrorManager.Analysis.UnknownType.hint");
+
     pushScope();
     functionDepth++;
 
     for (const auto& parameter : node->parameters) {
-        if (scopes.back().contains((parameter->parameterName))) {
+        if (isDeclaredInCurrentScope(parameter->parameterName)) {
             errorManager->addError(ErrorType::Analysis, AnalysisErrors::DuplicateParameterName,
                 ErrorSpan{parameter->filePath, parameter->parameterName, parameter->line, parameter->column},
                 "ErrorManager.Analysis.DuplicateParameterName.message", {parameter->parameterName, node->name},
                 "ErrorManager.Analysis.DuplicateParameterName.hint");
             popScope();
             functionDepth--;
+            currentReturnType = previousReturnType;
+            isAsync = wasAsync;
             return;
         }
 
+        const Type* parameterType = types->dynamic();
+        if (parameter->parameterRawType) {
+            if (const Type* resolved = resolveType(parameter->parameterRawType.get())) parameterType = resolved;
+            else errorManager->addError(ErrorType::Analysis, AnalysisErrors::UnknownType,
+                ErrorSpan{parameter->parameterRawType->filePath, parameter->parameterRawType->varType->varName, parameter->line, parameter->column},
+                "ErrorManager.Analysis.UnknownType.message", {parameter->parameterRawType->varType->varName, parameter->parameterName},
+                "ErrorManager.Analysis.UnknownType.hint");
+        }
+
         //FIXME: Right now parameters do not support const. this must be addressed.
-        declareName(parameter->parameterName, Symbol{Symbol::Kind::Parameter, false, node->filePath, node->line, node->column}, parameter.get());
+        declareName(parameter->parameterName, Symbol{Symbol::Kind::Parameter, false, node->filePath, node->line, node->column, parameterType}, parameter.get());
+        parameter->inferredType = parameterType;
 
-        if (parameter->defaultValue) analyzeExpression(parameter->defaultValue.get());
+        if (parameter->defaultValue) {
+            const Type* valueType = analyzeExpression(parameter->defaultValue.get(), parameterType);
+            expectType(parameter->defaultValue.get(), valueType, parameterType, AnalysisErrors::ArgumentTypeMismatch, parameter->parameterName);
+        }
     }
 
-    analyzeBlock(node->body.get());
+    if (node->body) analyzeBlock(node->body.get()); // intrinsic functions have no body
     functionDepth--;
     popScope();
+    currentReturnType = previousReturnType;
+    isAsync = wasAsync;
 }
 
 void SemanticAnalysis::analyzeBlock(BlockNode* node) {
@@ -162,7 +267,6 @@ void SemanticAnalysis::analyzeStatement(ASTNode* statement) {
         case ASTNodeType::Class: analyzeClass(static_cast<ClassNode*>(statement)); break;
         case ASTNodeType::Enum: analyzeEnum(static_cast<EnumNode*>(statement)); break;
         case ASTNodeType::Interface: analyzeInterface(static_cast<InterfaceNode*>(statement)); break;
-        case ASTNodeType::CallExpression: analyzeCallExpression(static_cast<CallExpressionNode*>(statement)); break;
         case ASTNodeType::Decorator: analyzeDecorator(static_cast<DecoratorNode*>(statement)); break;
         case ASTNodeType::IfStatement: analyzeIf(static_cast<IfNode*>(statement)); break;
         case ASTNodeType::Switch: analyzeSwitch(static_cast<SwitchNode*>(statement)); break;
@@ -173,37 +277,91 @@ void SemanticAnalysis::analyzeStatement(ASTNode* statement) {
         case ASTNodeType::ThrowStatement: analyzeThrow(static_cast<ThrowStatementNode*>(statement)); break;
         case ASTNodeType::BreakStatement: analyzeBreak(static_cast<BreakStatementNode*>(statement)); break;
         case ASTNodeType::ContinueStatement: analyzeContinue(static_cast<ContinueStatementNode*>(statement)); break;
-        case ASTNodeType::Lambda: analyzeLambda(static_cast<LambdaNode*>(statement)); break;
+        case ASTNodeType::Namespace: analyzeNamespace(static_cast<NamespaceNode*>(statement)); break;
         case ASTNodeType::Import: break; // Imports are already resolved by the Orchestrator
-        default: analyzeExpression(statement); break;
+        default: analyzeExpressionStatement(statement); break;
     }
 }
 
+void SemanticAnalysis::analyzeExpressionStatement(ASTNode* node) {
+    const Type* type = analyzeExpression(node);
+
+    // a task nobody awaits is never freed, and nothing waits for it to finish
+    if (type && type->kind == Type::Kind::Task)
+        errorManager->addError(ErrorType::Analysis, AnalysisErrors::DiscardedTask,
+            ErrorSpan{node->filePath, node->value, node->line, node->column},
+            "ErrorManager.Analysis.DiscardedTask.message", {type->toString()},
+            "ErrorManager.Analysis.DiscardedTask.hint");
+}
+
 void SemanticAnalysis::analyzeDeclaration(DeclarationNode* node) {
-    // at first you make sure what the value is to not screw up with x := x being undefined
-    if (node->value) analyzeExpression(node->value.get());
+    const std::string& name = node->variable->varName;
+    const Type* declaredType = nullptr;
 
     if (!node->isTypeInference && node->rawType) {
-        auto type = resolveType(node->rawType.get());
-        if (type == ResolvedType::Unknown)
+        declaredType = resolveType(node->rawType.get());
+        if (!declaredType)
             errorManager->addError(ErrorType::Analysis, AnalysisErrors::UnknownType,
         ErrorSpan{node->rawType->filePath, node->rawType->varType->varName, node->rawType->line, node->rawType->column},
-        "ErrorManager.Analysis.UnknownType.message", {node->rawType->varType->varName, node->variable->varName},
+        "ErrorManager.Analysis.UnknownType.message", {node->rawType->varType->varName, name},
         "ErrorManager.Analysis.UnknownType.hint");
+        else if (node->isNullable) declaredType = types->nullable(declaredType);
+    }
+
+    // at first you make sure what the value is to not screw up with x := x being undefined
+    const Type* valueType = nullptr;
+    if (node->value) valueType = analyzeExpression(node->value.get(), declaredType);
+
+    if (node->isTypeInference) {
+        // x := value takes the type of the value, so the value must have one
+        if (!valueType || valueType->isVoid())
+            errorManager->addError(ErrorType::Analysis, AnalysisErrors::TypeInferenceFailed,
+                ErrorSpan{node->filePath, name, node->line, node->column},
+                "ErrorManager.Analysis.TypeInferenceFailed.message", {name},
+                "ErrorManager.Analysis.TypeInferenceFailed.hint");
+        else if (valueType == types->null())
+            errorManager->addError(ErrorType::Analysis, AnalysisErrors::AmbiguousType,
+                ErrorSpan{node->filePath, name, node->line, node->column},
+                "ErrorManager.Analysis.AmbiguousType.message", {name},
+                "ErrorManager.Analysis.AmbiguousType.hint");
+        else declaredType = node->isNullable ? types->nullable(valueType) : valueType;
     }
+    else if (declaredType && valueType) expectType(node->value.get(), valueType, declaredType, AnalysisErrors::AssignmentTypeMismatch, name);
+
+    if (!declaredType) declaredType = types->dynamic();
+    node->inferredType = declaredType;
 
     bool isConst = false;
     for (auto& modifier : node->modifiers) if (modifier.get()->modifier == ASTModifierType::Const) isConst = true;
-    declareName(node->variable->varName, Symbol{Symbol::Kind::Variable, isConst, node->filePath, node->line, node->column}, node);
+    declareName(name, Symbol{Symbol::Kind::Variable, isConst, node->filePath, node->line, node->column, declaredType}, node);
 }
 
 void SemanticAnalysis::analyzeAssignment(AssignmentNode* node) {
-    analyzeExpression(node->value.get());
-
     auto* variable = getRootVariable(node->variable.get());
+    Symbol* symbol = nullptr;
+    if (variable && match(variable, ASTNodeType::Variable)) symbol = findName(static_cast<VariableNode*>(variable)->varName);
+
+    // only plain variables have a known type for now, members of objects are dynamic
+    const Type* targetType = symbol && variable == node->variable.get() ? symbolType(symbol) : types->dynamic();
+    const std::string targetName = symbol ? static_cast<VariableNode*>(variable)->varName : "";
+    node->variable->inferredType = targetType;
+
+    const Type* valueType = analyzeExpression(node->value.get(), targetType);
+    if (node->op == "=") expectType(node->value.get(), valueType, targetType, AnalysisErrors::AssignmentTypeMismatch, targetName);
+    else {
+        // x += y is x = x + y, so the operator has to apply and give back the type of x
+        const Type* resultType = binaryResultType(node->op.substr(0, node->op.size() - 1), targetType, valueType);
+        if (!resultType)
+            errorManager->addError(ErrorType::Analysis, AnalysisErrors::BinaryOperationTypeMismatch,
+                ErrorSpan{node->filePath, node->op, node->line, node->column},
+                "ErrorManager.Analysis.BinaryOperationTypeMismatch.message", {node->op, targetType->toString(), valueType->toString()},
+                "ErrorManager.Analysis.BinaryOperationTypeMismatch.hint");
+        else expectType(node->value.get(), resultType, targetType, AnalysisErrors::AssignmentTypeMismatch, targetName);
+    }
+
     if (variable && match(variable, ASTNodeType::Variable)) {
         auto* var = static_cast<VariableNode*>(variable);
-        auto* symbol = findName(var->varName);
+        symbol = findName(var->varName); // the value could have declared something (lambdas), so look it up again
         if (!symbol) errorManager->addError(ErrorType::Analysis, AnalysisErrors::UndefinedVariable,
             ErrorSpan{var->filePath, var->varName, var->line, var->column},
             "ErrorManager.Analysis.UndefinedVariable.message", {var->varName},
@@ -217,12 +375,16 @@ void SemanticAnalysis::analyzeAssignment(AssignmentNode* node) {
     }
 }
 
-void SemanticAnalysis::analyzeCallExpression(CallExpressionNode* node) {
-    for (const auto& arg : node->arguments) analyzeExpression(arg.get());
-
+const Type* SemanticAnalysis::analyzeCallExpression(CallExpressionNode* node) {
     if (match(node->callee.get(), ASTNodeType::Variable)) {
         auto varName = static_cast<VariableNode*>(node->callee.get())->varName;
         auto* sym = findName(varName);
+        const Type* calleeType = symbolType(sym);
+        node->callee->inferredType = calleeType;
+
+        const Type* result = nullptr;
+        if (sym && sym->overloads && !node->isDecoratorCall) result = resolveCall(node, sym->overloads);
+        else checkArguments(node, calleeType);
 
         if (!sym && node->isDecoratorCall)
             errorManager->addError(ErrorType::Analysis, AnalysisErrors::UndefinedDecorator,
@@ -244,8 +406,17 @@ void SemanticAnalysis::analyzeCallExpression(CallExpressionNode* node) {
                 ErrorSpan{node->filePath, varName, node->line, node->column},
                 "ErrorManager.Analysis.FunctionMismatch.message", {varName},
                 "ErrorManager.Analysis.FunctionMismatch.hint");
+
+        if (result) return result;
+        if (sym && sym->kind == Symbol::Kind::Class) return types->userDefined(varName); // constructor call
+        return calleeType->kind == Type::Kind::Function ? calleeType->returnType() : types->dynamic();
     }
-    else if (match(node->callee.get(), ASTNodeType::MemberAccess)) {
+
+    if (match(node->callee.get(), ASTNodeType::MemberAccess)) {
+        if (const Type* type = analyzeNamespaceAccess(static_cast<MemberAccessNode*>(node->callee.get()))) {
+            checkArguments(node, type);
+            return type->kind == Type::Kind::Function ? type->returnType() : types->dynamic();
+        }
         auto* root = getRootVariable(node->callee.get());
         if (root && match(root, ASTNodeType::Variable)) {
             auto varName = static_cast<VariableNode*>(root)->varName;
@@ -257,29 +428,65 @@ void SemanticAnalysis::analyzeCallExpression(CallExpressionNode* node) {
                     "ErrorManager.Analysis.UndefinedVariable.hint");
         }
     }
+
+    checkArguments(node, types->dynamic());
+    return types->dynamic();
 }
 
 void SemanticAnalysis::analyzeIf(IfNode* node) {
-    analyzeExpression(node->condition.get());
+    const Type* condition = analyzeExpression(node->condition.get(), types->primitive(ResolvedType::Bool));
+    expectType(node->condition.get(), condition, types->primitive(ResolvedType::Bool), AnalysisErrors::TypeMismatch, "if");
     if (node->thenBlock) analyzeStatement(node->thenBlock.get());
     if (node->elseBlock) analyzeStatement(node->elseBlock.get());
 }
 
 void SemanticAnalysis::analyzeWhile(WhileLoopNode* node) {
-    analyzeExpression(node->condition.get());
+    const Type* condition = analyzeExpression(node->condition.get(), types->primitive(ResolvedType::Bool));
+    expectType(node->condition.get(), condition, types->primitive(ResolvedType::Bool), AnalysisErrors::TypeMismatch, "while");
     loopDepth++;
     analyzeBlock(node->body.get());
     loopDepth--;
 }
 
 void SemanticAnalysis::analyzeFor(ForLoopNode* node) {
-    analyzeExpression(node->iterable.get());
+    const Type* iterable = analyzeExpression(node->iterable.get());
+
+    // arrays, sets and iterators give their elements, dicts give their keys and strings give characters
+    const Type* elementType = types->dynamic();
+    switch (iterable->kind) {
+        case Type::Kind::Array: case Type::Kind::Set: case Type::Kind::Dict: case Type::Kind::Iterator: elementType = iterable->components.front(); break;
+        case Type::Kind::Dynamic: break;
+        default:
+            if (iterable->isPrimitive(ResolvedType::Str)) elementType = iterable;
+            else errorManager->addError(ErrorType::Analysis, AnalysisErrors::TypeMismatch,
+                ErrorSpan{node->iterable->filePath, iterable->toString(), node->iterable->line, node->iterable->column},
+                "ErrorManager.Analysis.TypeMismatch.notIterable.message", {iterable->toString()},
+                "ErrorManager.Analysis.TypeMismatch.notIterable.hint");
+            break;
+    }
+
+    // `for (i, x: pairs)` unpacks tuples, one variable for every element of them
+    std::vector<VariableNode*> variables{node->variable.get()};
+    for (auto& variable : node->unpacked) variables.push_back(variable.get());
+    std::vector<const Type*> variableTypes{elementType};
+    if (variables.size() > 1) {
+        variableTypes.assign(variables.size(), types->dynamic());
+        if (elementType->kind == Type::Kind::Tuple && elementType->components.size() == variables.size()) variableTypes = elementType->components;
+        else if (!elementType->isDynamic())
+            errorManager->addError(ErrorType::Analysis, AnalysisErrors::TypeMismatch,
+                ErrorSpan{node->iterable->filePath, elementType->toString(), node->iterable->line, node->iterable->column},
+                "ErrorManager.Analysis.TypeMismatch.notUnpackable.message", {elementType->toString(), std::to_string(variables.size())},
+                "ErrorManager.Analysis.TypeMismatch.notUnpackable.hint");
+    }
 
     loopDepth++;
     pushScope();
 
     // FIXME: Find out how to get if it's the constant.
-    declareName(node->variable.get()->varName, Symbol{Symbol::Kind::Variable, false, node->variable->filePath, node->variable->line, node->variable->column}, node->variable.get());
+    for (size_t i = 0; i < variables.size(); i++) {
+        declareName(variables[i]->varName, Symbol{Symbol::Kind::Variable, false, variables[i]->filePath, variables[i]->line, variables[i]->column, variableTypes[i]}, variables[i]);
+        variables[i]->inferredType = variableTypes[i];
+    }
     for (const auto& stmt : node->body->statements)
         analyzeStatement(stmt.get());
 
@@ -295,7 +502,10 @@ void SemanticAnalysis::analyzeReturn(ReturnStatementNode* node) {
             "ErrorManager.Analysis.ReturnOutsideFunction.hint");
     }
 
-    if (node->expression) analyzeExpression(node->expression.get());
+    const Type* expected = currentReturnType ? currentReturnType : types->dynamic();
+    const Type* returned = node->expression ? analyzeExpression(node->expression.get(), expected) : types->primitive(ResolvedType::Void);
+    if (lambdaReturns && lambdaReturns->depth == functionDepth) lambdaReturns->types.push_back(returned);
+    if (functionDepth > 0) expectType(node->expression ? node->expression.get() : node, returned, expected, AnalysisErrors::ReturnTypeMismatch);
 }
 
 void SemanticAnalysis::analyzeBreak(BreakStatementNode* node) {
@@ -323,15 +533,17 @@ void SemanticAnalysis::analyzeClass(ClassNode* node) {
     pushScope();
 
     // self и super are available inside the whole class
-    declareName("self", Symbol{Symbol::Kind::Variable, false, node->filePath, node->line, node->column}, node);
+    declareName("self", Symbol{Symbol::Kind::Variable, false, node->filePath, node->line, node->column, types->userDefined(node->name)}, node);
     if (node->super) declareName("super", Symbol{Symbol::Kind::Function, false, node->filePath, node->line, node->column}, node);
 
 
     // declaration of methods
+    for (const auto& method : node->methods) declareFunction(method.get());
     for (const auto& method : node->methods) {
-        bool isConst = false;
-        for (auto& modifier : method->modifiers) if (modifier.get()->modifier == ASTModifierType::Const) isConst = true;
-        declareName(method->name, Symbol{Symbol::Kind::Function, isConst, node->filePath, node->line, node->column}, node);
+        auto* symbol = findName(method->name);
+        if (!symbol || !symbol->overloads) continue;
+        addOverload(symbol->overloads, method.get());
+        symbol->type = overloadSetType(symbol->overloads);
     }
 
     for (const auto& field : node->fields) analyzeDeclaration(field.get());
@@ -346,16 +558,17 @@ void SemanticAnalysis::analyzeTryCatch(TryCatchNode* node) {
     analyzeBlock(node->tryBlock.get());
 
     pushScope(); // catch has it's own scope
-    declareName(node->exception->varName, Symbol{Symbol::Kind::Variable, false, node->exception->filePath, node->exception->line, node->exception->column}, node);
+    declareName(node->exception->varName, Symbol{Symbol::Kind::Variable, false, node->exception->filePath, node->exception->line, node->exception->column, types->dynamic()}, node);
     analyzeBlock(node->catchBlock.get());
     popScope();
 }
 
 void SemanticAnalysis::analyzeSwitch(SwitchNode* node) {
-    analyzeExpression(node->expression.get());
+    const Type* subject = analyzeExpression(node->expression.get());
 
     for (const auto& sCase : node->cases) {
-        analyzeExpression(sCase->condition.get());
+        const Type* caseType = analyzeExpression(sCase->condition.get(), subject);
+        expectType(sCase->condition.get(), caseType, subject, AnalysisErrors::CaseTypeMismatch);
         analyzeStatement(sCase->body.get());
     }
 
@@ -366,7 +579,7 @@ void SemanticAnalysis::analyzeEnum(EnumNode* node) {
     pushScope();
 
     for (const auto& element : node->elements) {
-        if (scopes.back().contains(element->name)) errorManager->addError(ErrorType::Analysis, AnalysisErrors::DuplicateEnumMember,
+        if (isDeclaredInCurrentScope(element->name)) errorManager->addError(ErrorType::Analysis, AnalysisErrors::DuplicateEnumMember,
             ErrorSpan{node->filePath, element->name, node->line, node->column},
             "ErrorManager.Analysis.DuplicateEnumMember.message", {element->name, node->name},
             "ErrorManager.Analysis.DuplicateEnumMember.hint"
@@ -384,64 +597,799 @@ void SemanticAnalysis::analyzeInterface(InterfaceNode* node) {
 }
 
 void SemanticAnalysis::analyzeDecorator(DecoratorNode* node) {
+    const Type* previousReturnType = currentReturnType;
+    currentReturnType = types->dynamic();
     pushScope();
     functionDepth++;
 
     for (const auto& parameter : node->parameters) {
         if (!parameter) continue;
-        declareName(parameter->parameterName, Symbol{Symbol::Kind::Parameter, false, node->filePath, node->line, node->column}, node);
+        declareName(parameter->parameterName, Symbol{Symbol::Kind::Parameter, false, node->filePath, node->line, node->column, types->dynamic()}, node);
         if (parameter->defaultValue) analyzeExpression(parameter->defaultValue.get());
     }
     analyzeBlock(node->body.get());
 
     functionDepth--;
     popScope();
+    currentReturnType = previousReturnType;
 }
 
-void SemanticAnalysis::analyzeLambda(LambdaNode* node) {
+const Type* SemanticAnalysis::analyzeLambda(LambdaNode* node, const Type* expected) {
+    // Lambdas don't declare types. Passed where a function type is expected (a callback of an iterator), parameters
+    // take the types of it and returns are checked against its result, or give the result if that's dynamic.
+    // Anywhere else neither parameters nor results are checked.
+    bool isTyped = expected && expected->kind == Type::Kind::Function && expected->paramCount() == node->params.size();
+    const Type* previousReturnType = currentReturnType;
+    LambdaReturns* previousReturns = lambdaReturns;
+    currentReturnType = isTyped ? expected->returnType() : types->dynamic();
+    bool wasAsync = std::exchange(isAsync, false); // a lambda is called back synchronously, it can't suspend its caller
     pushScope();
     functionDepth++;
-
-    for (const auto& param : node->params) {
-        if (match(param.get(), ASTNodeType::Variable)) {
-            auto* v = static_cast<VariableNode*>(param.get());
-            declareName(v->varName, Symbol{Symbol::Kind::Parameter, false, v->filePath, v->line, v->column}, param.get());
+    LambdaReturns returns{functionDepth, {}};
+    lambdaReturns = &returns;
+
+    std::vector<const Type*> params;
+    for (size_t i = 0; i < node->params.size(); i++) {
+        if (match(node->params[i].get(), ASTNodeType::Variable)) {
+            auto* v = static_cast<VariableNode*>(node->params[i].get());
+            const Type* type = isTyped ? expected->param(i) : types->dynamic();
+            declareName(v->varName, Symbol{Symbol::Kind::Parameter, false, v->filePath, v->line, v->column, type}, v);
+            v->inferredType = type;
+            params.push_back(type);
         }
     }
 
     analyzeStatement(node->body.get());
 
+    const Type* result = currentReturnType;
+    if (result->isDynamic() && !returns.types.empty() &&
+        std::all_of(returns.types.begin(), returns.types.end(), [&](const Type* type) { return type == returns.types.front(); }))
+        result = returns.types.front();
+
+    lambdaReturns = previousReturns;
     functionDepth--;
     popScope();
+    currentReturnType = previousReturnType;
+    isAsync = wasAsync;
+    return types->function(result, params);
+}
+
+void SemanticAnalysis::analyzeNamespace(NamespaceNode* node) {
+    NamespaceInfo* parentLevel = currentNamespace ? currentNamespace : namespaces;
+    NamespaceInfo* level = parentLevel ? parentLevel->resolve(node->name.get()) : nullptr;
+    if (!level) return; // the Orchestrator couldn't open it, nothing to check against
+
+    NamespaceInfo* previous = currentNamespace;
+    currentNamespace = level;
+    pushScope();
+
+    // Every declaration of this namespace shares one symbol table, so siblings from other files are visible too.
+    // Variables are left out, they're declared in order by analyzeDeclaration().
+    for (const auto& [name, declarations] : level->members) {
+        ASTNode* first = declarations.front();
+        switch (first->type) {
+            case ASTNodeType::Function: declareName(name, Symbol{Symbol::Kind::Function, false, first->filePath, first->line, first->column}, first); break;
+            case ASTNodeType::Class: declareName(name, Symbol{Symbol::Kind::Class, false, first->filePath, first->line, first->column, types->userDefined(name)}, first); break;
+            case ASTNodeType::Enum: declareName(name, Symbol{Symbol::Kind::Enum, true, first->filePath, first->line, first->column, types->userDefined(name)}, first); break;
+            case ASTNodeType::Interface: declareName(name, Symbol{Symbol::Kind::Interface, true, first->filePath, first->line, first->column, types->userDefined(name)}, first); break;
+            case ASTNodeType::Decorator: declareName(name, Symbol{Symbol::Kind::Decorator, false, first->filePath, first->line, first->column}, first); break;
+            default: break;
+        }
+    }
+    for (const auto& [name, declarations] : level->members) {
+        if (!match(declarations.front(), ASTNodeType::Function)) continue;
+        if (auto* symbol = findName(name); symbol && symbol->kind == Symbol::Kind::Function) {
+            symbol->overloads = namespaceOverloadSet(declarations);
+            symbol->type = overloadSetType(symbol->overloads);
+        }
+    }
+
+    for (const auto& statement : node->body)
+        if (statement) analyzeStatement(statement.get());
+
+    popScope();
+    currentNamespace = previous;
+}
+
+const Type* SemanticAnalysis::analyzeNamespaceAccess(MemberAccessNode* node) {
+    if (!namespaces) return nullptr;
+
+    // flatten a.b.c into [a, b, c]; the parser builds member chains left to right
+    std::vector<ASTNode*> chain;
+    ASTNode* current = node;
+    while (match(current, ASTNodeType::MemberAccess)) {
+        auto* ma = static_cast<MemberAccessNode*>(current);
+        chain.push_back(ma->val.get());
+        current = ma->parent.get();
+    }
+    if (!match(current, ASTNodeType::Variable)) return nullptr;
+    chain.push_back(current);
+    std::reverse(chain.begin(), chain.end());
+
+    // locals always shadow namespaces
+    const std::string& rootName = static_cast<VariableNode*>(chain.front())->varName;
+    if (findName(rootName)) return nullptr;
+
+    NamespaceInfo* level = nullptr;
+    if (currentModule) {
+        auto alias = currentModule->namespaceAliasMap.find(rootName);
+        if (alias != currentModule->namespaceAliasMap.end()) level = alias->second;
+    }
+    if (!level && currentNamespace) level = currentNamespace->child(rootName);
+    if (!level) level = namespaces->child(rootName);
+    if (!level) return nullptr;
+
+    for (size_t i = 1; i < chain.size(); i++) {
+        ASTNode* component = chain[i];
+        bool isCall = match(component, ASTNodeType::CallExpression);
+        auto* nameNode = isCall ? static_cast<CallExpressionNode*>(component)->callee.get() : component;
+        const std::string& name = static_cast<VariableNode*>(nameNode)->varName;
+
+        if (!isCall) {
+            if (auto* next = level->child(name)) { level = next; continue; }
+        }
+
+        auto* declarations = namespaceMember(level, name);
+        if (!declarations) {
+            errorManager->addError(ErrorType::Analysis, AnalysisErrors::UndefinedMember,
+                ErrorSpan{component->filePath, name, component->line, component->column},
+                "ErrorManager.Analysis.UndefinedMember.message", {name, level->fullName()},
+                "ErrorManager.Analysis.UndefinedMember.hint");
+            return types->dynamic();
+        }
+        // `iter.range(10).sum()`: members of the value are a regular member access, its parent is this one
+        if (i + 1 < chain.size()) return nullptr;
+
+        // found the symbol, take its type from the declaration
+        ASTNode* declaration = declarations->front();
+        OverloadSet* overloads = match(declaration, ASTNodeType::Function) ? namespaceOverloadSet(*declarations) : nullptr;
+        const Type* type = types->dynamic();
+        switch (declaration->type) {
+            case ASTNodeType::Function: type = overloadSetType(overloads); break;
+            case ASTNodeType::Class: case ASTNodeType::Enum: case ASTNodeType::Interface: type = types->userDefined(name); break;
+            case ASTNodeType::Declaration: if (declaration->inferredType) type = declaration->inferredType; break;
+            default: break;
+        }
+        nameNode->inferredType = type;
+
+        if (isCall) {
+            auto* call = static_cast<CallExpressionNode*>(component);
+            if (overloads) type = resolveCall(call, overloads);
+            else {
+                checkArguments(call, type);
+                type = match(declaration, ASTNodeType::Class) ? types->userDefined(name) : types->dynamic();
+            }
+            call->inferredType = type;
+        }
+        return type;
+    }
+
+    return types->dynamic(); // the chain names a namespace itself
 }
 
-ResolvedType SemanticAnalysis::resolveType(RawTypeNode* type) {
+const std::vector<ASTNode*>* SemanticAnalysis::namespaceMember(NamespaceInfo* level, const std::string& name) {
+    if (auto* declarations = level->member(name)) return declarations;
+    if (level->indexes.empty()) return nullptr;
+
+    // binary search in the index, then a declaration without a body that carries the signature in `inferredType`
+    std::string path = level->fullName() + "." + name;
+    for (const SymbolIndex* index : level->indexes) {
+        for (const auto& entry : index->find(path)) {
+            if (entry.kind == SymbolIndex::Kind::Namespace) continue;
+            MemoryPtr<ASTNode> declaration = importDeclaration(*index, entry, name);
+            if (declaration->type == ASTNodeType::Function) static_cast<FunctionNode*>(declaration.get())->namespaceName = level->fullName();
+            level->members[name].push_back(declaration.get());
+            level->imported.push_back(std::move(declaration));
+        }
+    }
+    return level->member(name);
+}
+
+MemoryPtr<ASTNode> SemanticAnalysis::importDeclaration(const SymbolIndex& index, const SymbolIndex::Entry& entry, const std::string& name) {
+    std::string_view signature = index.signature(entry);
+    MemoryPtr<ASTNode> declaration;
+
+    switch (entry.kind) {
+        case SymbolIndex::Kind::Function: {
+            const Type* type = types->decode(signature);
+            std::vector<MemoryPtr<ParameterNode>> parameters;
+            for (const auto& parameter : SymbolIndex::parameters(signature)) {
+                // only the presence of a default matters to overload resolution, the value itself stays in the dependency
+                auto defaultValue = parameter.hasDefault ? makeMemoryPtr<LiteralNode>("null", ASTLiteralType::Null) : nullptr;
+                parameters.push_back(makeMemoryPtr<ParameterNode>(std::string(parameter.name), nullptr, std::move(defaultValue)));
+            }
+            auto function = makeMemoryPtr<FunctionNode>(name, std::move(parameters), nullptr, nullptr);
+            function->isIntrinsic = entry.flags & SymbolIndex::Intrinsic;
+            function->isAsync = entry.flags & SymbolIndex::Async;
+            if (!type || type->kind != Type::Kind::Function) {
+                std::vector<const Type*> dynamics(function->parameters.size(), types->dynamic());
+                type = types->function(types->dynamic(), dynamics);
+            }
+            function->inferredType = type;
+            declaration = std::move(function);
+            break;
+        }
+        case SymbolIndex::Kind::Class: declaration = makeMemoryPtr<ClassNode>(name, nullptr, nullptr, std::vector<MemoryPtr<DeclarationNode>>{}, std::vector<MemoryPtr<FunctionNode>>{}); break;
+        case SymbolIndex::Kind::Enum: declaration = makeMemoryPtr<EnumNode>(name, std::vector<MemoryPtr<EnumMemberNode>>{}); break;
+        case SymbolIndex::Kind::Interface: declaration = makeMemoryPtr<InterfaceNode>(name, std::vector<MemoryPtr<InterfaceFieldNode>>{}); break;
+        case SymbolIndex::Kind::Decorator: declaration = makeMemoryPtr<DecoratorNode>(name, std::vector<MemoryPtr<ParameterNode>>{}, nullptr); break;
+        default: {
+            auto variable = makeMemoryPtr<DeclarationNode>(makeMemoryPtr<VariableNode>(name));
+            if (entry.flags & SymbolIndex::Constant) {
+                ASTModifierType modifier = ASTModifierType::Const;
+                variable->modifiers.push_back(makeMemoryPtr<ModifierNode>(modifier));
+            }
+            variable->inferredType = types->decode(signature);
+            declaration = std::move(variable);
+            break;
+        }
+    }
+
+    declaration->filePath = std::string(index.file());
+    declaration->line = entry.line;
+    declaration->column = entry.column;
+    return declaration;
+}
+
+const Type* SemanticAnalysis::resolveType(RawTypeNode* type) {
     auto varType = type->varType.get()->varName;
-    auto tm = getTypeMap();
+    auto& tm = getTypeMap();
 
-    // first check built-ins
-    if (tm.contains(varType)) return tm.find(varType)->second;
+    const Type* resolved = nullptr;
+
+    // type arguments say what a container holds, a bare one holds anything
+    std::vector<const Type*> arguments;
+    for (auto& argument : type->arguments) {
+        const Type* resolvedArgument = resolveType(argument.get());
+        if (!resolvedArgument) return nullptr;
+        arguments.push_back(resolvedArgument);
+    }
+    auto component = [&](size_t i) { return arguments.empty() ? types->dynamic() : arguments[i]; };
 
+    // first check built-ins
+    if (auto it = tm.find(varType); it != tm.end()) {
+        size_t expected = 0;
+        switch (it->second) {
+            case ResolvedType::Array: case ResolvedType::Set: case ResolvedType::Iterator: case ResolvedType::Task: expected = 1; break;
+            case ResolvedType::Dict: case ResolvedType::Result: expected = 2; break;
+            default: break;
+        }
+        if (!arguments.empty() && arguments.size() != expected) return nullptr;
+
+        switch (it->second) {
+            case ResolvedType::Array: resolved = types->array(component(0)); break;
+            case ResolvedType::Set: resolved = types->set(component(0)); break;
+            case ResolvedType::Iterator: resolved = types->iterator(component(0)); break;
+            case ResolvedType::Task: resolved = types->task(component(0)); break;
+            case ResolvedType::Dict: resolved = types->dict(component(0), component(1)); break;
+            case ResolvedType::Result: resolved = types->result(component(0), component(1)); break;
+            default: resolved = types->primitive(it->second); break;
+        }
+    }
     // well, perhaps it's user-defined?
-    auto* userDefined = findName(varType);
-    if (userDefined && (userDefined->kind == Symbol::Kind::Class || userDefined->kind == Symbol::Kind::Enum || userDefined->kind == Symbol::Kind::Interface)) return ResolvedType::UserDefined;
+    else if (auto* userDefined = findName(varType); arguments.empty() && userDefined && (userDefined->kind == Symbol::Kind::Class || userDefined->kind == Symbol::Kind::Enum || userDefined->kind == Symbol::Kind::Interface))
+        resolved = types->userDefined(varType);
 
     // The type is unknown. Error message context is added at parent call.
-    return ResolvedType::Unknown;
+    if (!resolved) return nullptr;
+
+    // int[] and int[4] are arrays of int
+    if (type->isArray) resolved = types->array(resolved);
+    return resolved;
+}
+
+const Type* SemanticAnalysis::functionType(FunctionNode* node) {
+    if (node->inferredType) return node->inferredType;
+
+    // untyped parameters and results are dynamic
+    std::vector<const Type*> params;
+    for (const auto& parameter : node->parameters) {
+        const Type* type = parameter->parameterRawType ? resolveType(parameter->parameterRawType.get()) : nullptr;
+        params.push_back(type ? type : types->dynamic());
+    }
+
+    const Type* returnType = types->dynamic();
+    if (node->returnType) {
+        if (const Type* type = resolveType(node->returnType.get())) returnType = type;
+    }
+    // calling an async function starts it, what the caller gets is the task
+    if (node->isAsync) returnType = types->task(returnType);
+
+    node->inferredType = types->function(returnType, params);
+    return node->inferredType;
+}
+
+// ==== Type checking ====
+
+const Type* SemanticAnalysis::analyzeLiteral(LiteralNode* node, const Type* expected) {
+    // literals take the numeric type they're checked against, so `x: int8 = 5` and `y: float64 = 0.5` work without casts
+    if (expected && expected->kind == Type::Kind::Nullable) expected = expected->element();
+
+    switch (node->literalType) {
+        case ASTLiteralType::Integer:
+            if (expected && expected->isNumeric()) return expected;
+            return types->primitive(ResolvedType::Int);
+        case ASTLiteralType::Float:
+            if (expected && (expected->isFloat() || expected->isPrimitive(ResolvedType::Number))) return expected;
+            return types->primitive(ResolvedType::Float);
+        case ASTLiteralType::String:
+            // every `${}` is a value of its own, turned into text where the string is built
+            for (const auto& interpolation : node->interpolations) {
+                const Type* type = analyzeExpression(interpolation.get());
+                if (!type->isVoid() && type->kind != Type::Kind::Task) continue;
+                errorManager->addError(ErrorType::Analysis, AnalysisErrors::TypeMismatch,
+                    ErrorSpan{interpolation->filePath, type->toString(), interpolation->line, interpolation->column},
+                    "ErrorManager.Analysis.TypeMismatch.notFormattable.message", {type->toString()},
+                    "ErrorManager.Analysis.TypeMismatch.notFormattable.hint");
+            }
+            return types->primitive(ResolvedType::Str);
+        case ASTLiteralType::Bool: return types->primitive(ResolvedType::Bool);
+        case ASTLiteralType::Null: return types->null();
+    }
+    return types->dynamic();
+}
+
+// Is the node a literal whose type adapts to the context? (-1 is a unary operation on a literal)
+static bool isFlexibleLiteral(ASTNode* node) {
+    if (node->type == ASTNodeType::UnaryOperation) return isFlexibleLiteral(static_cast<UnaryOperationNode*>(node)->operand.get());
+    if (node->type != ASTNodeType::Literal) return false;
+    auto kind = static_cast<LiteralNode*>(node)->literalType;
+    return kind == ASTLiteralType::Integer || kind == ASTLiteralType::Float;
+}
+
+// Would the flexible literal take the given type, the way analyzeLiteral() adapts it?
+static bool literalFits(ASTNode* node, const Type* type) {
+    if (!isFlexibleLiteral(node)) return false;
+    while (node->type == ASTNodeType::UnaryOperation) node = static_cast<UnaryOperationNode*>(node)->operand.get();
+    if (static_cast<LiteralNode*>(node)->literalType == ASTLiteralType::Integer) return type->isNumeric();
+    return type->isFloat() || type->isPrimitive(ResolvedType::Number);
+}
+
+const Type* SemanticAnalysis::analyzeBinary(BinaryOperationNode* node, const Type* expected) {
+    const std::string& op = node->value;
+    bool isArithmetic = op == "+" || op == "-" || op == "*" || op == "/" || op == "%" || op == "^" ||
+        op == "&" || op == "|" || op == "^^" || op == "<<" || op == ">>";
+
+    // the side that isn't a bare literal decides the type, the literal is checked against it
+    const Type* hint = isArithmetic ? expected : nullptr;
+    const Type* left;
+    const Type* right;
+    if (isFlexibleLiteral(node->leftOperand.get()) && !isFlexibleLiteral(node->rightOperand.get())) {
+        right = analyzeExpression(node->rightOperand.get(), hint);
+        left = analyzeExpression(node->leftOperand.get(), right);
+    } else {
+        left = analyzeExpression(node->leftOperand.get(), hint);
+        right = analyzeExpression(node->rightOperand.get(), left);
+    }
+
+    const Type* result = binaryResultType(op, left, right);
+    if (!result) {
+        errorManager->addError(ErrorType::Analysis, AnalysisErrors::BinaryOperationTypeMismatch,
+            ErrorSpan{node->filePath, op, node->line, node->column},
+            "ErrorManager.Analysis.BinaryOperationTypeMismatch.message", {op, left->toString(), right->toString()},
+            "ErrorManager.Analysis.BinaryOperationTypeMismatch.hint");
+        return types->dynamic();
+    }
+    return result;
+}
+
+const Type* SemanticAnalysis::binaryResultType(const std::string& op, const Type* left, const Type* right) {
+    const Type* boolean = types->primitive(ResolvedType::Bool);
+
+    if (op == "==" || op == "!=")
+        return types->isAssignable(left, right) || types->isAssignable(right, left) ? boolean : nullptr;
+
+    if (op == "&&" || op == "||" || op == "and" || op == "or")
+        return types->isAssignable(left, boolean) && types->isAssignable(right, boolean) ? boolean : nullptr;
+
+    bool isComparison = op == "<" || op == ">" || op == "<=" || op == ">=";
+    bool isBitwise = op == "&" || op == "|" || op == "^^" || op == "<<" || op == ">>";
+    bool isArithmetic = op == "+" || op == "-" || op == "*" || op == "/" || op == "%" || op == "^";
+    if (!isComparison && !isBitwise && !isArithmetic) return types->dynamic(); // not an operator on values
+
+    // nothing is known about dynamic operands until runtime
+    if (left->isDynamic() || right->isDynamic()) return isComparison ? boolean : types->dynamic();
+
+    // no implicit conversions between numeric types: codegen emits the operation for exactly one machine type
+    if (isComparison) return left == right && (left->isNumeric() || left->isPrimitive(ResolvedType::Str)) ? boolean : nullptr;
+    if (isBitwise) return left == right && left->isInteger() ? left : nullptr;
+    if (op == "+" && left == right && left->isPrimitive(ResolvedType::Str)) return left;
+    return left == right && left->isNumeric() ? left : nullptr;
+}
+
+const Type* SemanticAnalysis::analyzeUnary(UnaryOperationNode* node, const Type* expected) {
+    const std::string& op = node->value;
+    if (op == "await") return analyzeAwait(node);
+    // `x: int8 = -5` types the literal as int8, just like `x: int8 = 5`
+    const Type* operand = analyzeExpression(node->operand.get(), op == "-" || op == "~" ? expected : nullptr);
+    if (operand->isDynamic()) return op == "!" || op == "not" ? types->primitive(ResolvedType::Bool) : operand;
+
+    bool fits = op == "-" ? operand->isNumeric() && !operand->isPrimitive(ResolvedType::UInt8) && !operand->isPrimitive(ResolvedType::UInt16) &&
+                            !operand->isPrimitive(ResolvedType::UInt) && !operand->isPrimitive(ResolvedType::UInt64) && !operand->isPrimitive(ResolvedType::UInt128)
+              : op == "~" ? operand->isInteger()
+              : operand->isPrimitive(ResolvedType::Bool);
+
+    if (!fits) {
+        errorManager->addError(ErrorType::Analysis, AnalysisErrors::UnaryOperationTypeMismatch,
+            ErrorSpan{node->filePath, op, node->line, node->column},
+            "ErrorManager.Analysis.UnaryOperationTypeMismatch.message", {op, operand->toString()},
+            "ErrorManager.Analysis.UnaryOperationTypeMismatch.hint");
+        return types->dynamic();
+    }
+    return operand;
+}
+
+const Type* SemanticAnalysis::analyzeAwait(UnaryOperationNode* node) {
+    const Type* operand = analyzeExpression(node->operand.get());
+    if (!isAsync)
+        errorManager->addError(ErrorType::Analysis, AnalysisErrors::AwaitOutsideAsync,
+            ErrorSpan{node->filePath, node->value, node->line, node->column},
+            "ErrorManager.Analysis.AwaitOutsideAsync.message", {},
+            "ErrorManager.Analysis.AwaitOutsideAsync.hint");
+    if (operand->isDynamic()) return operand;
+
+    if (operand->kind != Type::Kind::Task) {
+        errorManager->addError(ErrorType::Analysis, AnalysisErrors::UnaryOperationTypeMismatch,
+            ErrorSpan{node->filePath, node->value, node->line, node->column},
+            "ErrorManager.Analysis.UnaryOperationTypeMismatch.message", {node->value, operand->toString()},
+            "ErrorManager.Analysis.UnaryOperationTypeMismatch.hint");
+        return types->dynamic();
+    }
+    return operand->element();
+}
+
+const Type* SemanticAnalysis::analyzeMemberAccess(MemberAccessNode* node) {
+    if (const Type* type = analyzeNamespaceAccess(node)) return type;
+
+    const Type* parent = analyzeExpression(node->parent.get());
+    if (parent->isNumeric() || parent->isPrimitive(ResolvedType::Bool)) {
+        errorManager->addError(ErrorType::Analysis, AnalysisErrors::MemberAccessOnNonObject,
+            ErrorSpan{node->val->filePath, parent->toString(), node->val->line, node->val->column},
+            "ErrorManager.Analysis.MemberAccessOnNonObject.message", {parent->toString()},
+            "ErrorManager.Analysis.MemberAccessOnNonObject.hint");
+    }
+
+    // methods of collections are, the other members aren't typed yet
+    if (match(node->val.get(), ASTNodeType::CallExpression)) {
+        auto* call = static_cast<CallExpressionNode*>(node->val.get());
+        std::string name = match(call->callee.get(), ASTNodeType::Variable) ? static_cast<VariableNode*>(call->callee.get())->varName : "";
+        if (const Type* signature = collectionMethod(parent, name, call->arguments.size())) {
+            checkArguments(call, signature);
+            const Type* result = signature->returnType();
+            const Type* argument = call->arguments.empty() ? nullptr : call->arguments[0]->inferredType;
+            if (parent->kind == Type::Kind::Iterator && name == "map" && argument && argument->kind == Type::Kind::Function)
+                result = types->iterator(argument->returnType());
+            else if (parent->kind == Type::Kind::Iterator && name == "zip" && argument && argument->kind == Type::Kind::Iterator)
+                result = types->iterator(types->tuple({parent->element(), argument->element()}));
+            node->val->inferredType = result;
+            return result;
+        }
+        checkArguments(call, types->dynamic());
+    }
+    else if (match(node->val.get(), ASTNodeType::Variable)) {
+        const std::string& name = static_cast<VariableNode*>(node->val.get())->varName;
+        if (name == "length" || name == "size") {
+            if (const Type* signature = collectionMethod(parent, name, 0)) {
+                node->val->inferredType = signature->returnType();
+                return signature->returnType();
+            }
+        }
+    }
+    node->val->inferredType = types->dynamic();
+    return types->dynamic();
+}
+
+const Type* SemanticAnalysis::collectionMethod(const Type* collection, const std::string& name, size_t argumentCount) {
+    Type::Kind kind = collection->kind;
+    const Type* none = types->primitive(ResolvedType::Void);
+    const Type* boolean = types->primitive(ResolvedType::Bool);
+    const Type* index = types->primitive(ResolvedType::Int);
+    auto signature = [&](const Type* result, std::vector<const Type*> params) { return params.size() == argumentCount ? types->function(result, params) : nullptr; };
+
+    // Adapters give iterators again, sum and collect run one to its end. What map and zip give depends on their
+    // argument, analyzeMemberAccess() fills that in.
+    if (kind == Type::Kind::Iterator) {
+        const Type* element = collection->element();
+        const Type* any = types->dynamic();
+        if (name == "map") return signature(types->iterator(any), {types->function(any, {element})});
+        if (name == "filter") return signature(collection, {types->function(boolean, {element})});
+        if (name == "take") return signature(collection, {index});
+        if (name == "enumerate") return signature(types->iterator(types->tuple({index, element})), {});
+        if (name == "zip") return signature(types->iterator(types->tuple({element, any})), {types->iterator(any)});
+        if (name == "sum" && (element->isNumeric() || element->isDynamic())) return signature(element, {});
+        if (name == "collect") return signature(types->array(element), {});
+        return nullptr;
+    }
+    if (kind != Type::Kind::Array && kind != Type::Kind::Set && kind != Type::Kind::Dict) return nullptr;
+
+    if (name == "length" || name == "size") return signature(index, {});
+    if (name == "iter") return signature(types->iterator(collection->element()), {}); // a dict's keys
+    if (kind == Type::Kind::Array) {
+        const Type* element = collection->element();
+        if (name == "push" || name == "append") return signature(none, {element});
+        if (name == "get") return signature(element, {index});
+        if (name == "set") return signature(none, {index, element});
+    }
+    else if (kind == Type::Kind::Set) {
+        const Type* element = collection->element();
+        if (name == "contains" || name == "has") return signature(boolean, {element});
+        if (name == "add" || name == "insert" || name == "remove") return signature(none, {element});
+    }
+    else {
+        const Type* key = collection->components[0];
+        const Type* value = collection->components[1];
+        if (name == "contains" || name == "has") return signature(boolean, {key});
+        // `V?` to NIR, but nothing unwraps a nullable yet, so it's left to the place it goes to
+        if (name == "get") return signature(types->dynamic(), {key});
+        if (name == "set") return signature(none, {key, value});
+        if (name == "remove") return signature(none, {key});
+    }
+    return nullptr;
+}
+
+const Type* SemanticAnalysis::analyzeCollection(ASTNode* node, const Type* expected) {
+    if (expected && expected->kind == Type::Kind::Nullable) expected = expected->element();
+
+    // Dicts check keys and values separately
+    if (match(node, ASTNodeType::Dict)) {
+        auto* dict = static_cast<DictNode*>(node);
+        const Type* keyType = expected && expected->kind == Type::Kind::Dict ? expected->components[0] : nullptr;
+        const Type* valueType = expected && expected->kind == Type::Kind::Dict ? expected->components[1] : nullptr;
+
+        for (const auto& [k, v] : dict->elements) {
+            const Type* key = analyzeExpression(k.get(), keyType);
+            const Type* value = analyzeExpression(v.get(), valueType);
+            if (!keyType) keyType = key; // the first element decides
+            else expectType(k.get(), key, keyType, AnalysisErrors::DictKeyTypeMismatch, "dict");
+            if (!valueType) valueType = value;
+            else expectType(v.get(), value, valueType, AnalysisErrors::DictValueTypeMismatch, "dict");
+        }
+        return types->dict(keyType ? keyType : types->dynamic(), valueType ? valueType : types->dynamic());
+    }
+
+    bool isSet = match(node, ASTNodeType::Set);
+    auto& elements = isSet ? static_cast<SetNode*>(node)->elements : static_cast<ArrayNode*>(node)->elements;
+    Type::Kind kind = isSet ? Type::Kind::Set : Type::Kind::Array;
+    const Type* elementType = expected && expected->kind == kind ? expected->element() : nullptr;
+
+    for (const auto& element : elements) {
+        const Type* type = analyzeExpression(element.get(), elementType);
+        if (!elementType) elementType = type;
+        else expectType(element.get(), type, elementType, AnalysisErrors::ArrayElementTypeMismatch, isSet ? "set" : "array");
+    }
+
+    if (!elementType) elementType = types->dynamic(); // [] fits into any array
+    return isSet ? types->set(elementType) : types->array(elementType);
+}
+
+void SemanticAnalysis::checkArguments(CallExpressionNode* node, const Type* signature) {
+    bool isTyped = signature->kind == Type::Kind::Function;
+
+    for (size_t i = 0; i < node->arguments.size(); i++) {
+        ASTNode* argument = node->arguments[i].get();
+        const Type* expected = isTyped && i < signature->paramCount() ? signature->param(i) : nullptr;
+        const Type* actual = analyzeExpression(argument, expected);
+        if (expected) expectType(argument, actual, expected, AnalysisErrors::ArgumentTypeMismatch, std::to_string(i + 1));
+    }
+}
+
+bool SemanticAnalysis::expectType(ASTNode* node, const Type* actual, const Type* expected, AnalysisErrors error, const std::string& what) {
+    if (types->isAssignable(actual, expected)) return true;
+
+    // null has its own error, it's the most common way to end up here
+    if (actual == types->null() && error == AnalysisErrors::AssignmentTypeMismatch) error = AnalysisErrors::NullAssignmentToNonNullable;
+
+    static const std::unordered_map<AnalysisErrors, std::string> keys = {
+        {AnalysisErrors::TypeMismatch, "TypeMismatch"}, {AnalysisErrors::AssignmentTypeMismatch, "AssignmentTypeMismatch"},
+        {AnalysisErrors::ReturnTypeMismatch, "ReturnTypeMismatch"}, {AnalysisErrors::ArgumentTypeMismatch, "ArgumentTypeMismatch"},
+        {AnalysisErrors::NullAssignmentToNonNullable, "NullAssignmentToNonNullable"}, {AnalysisErrors::ArrayElementTypeMismatch, "ArrayElementTypeMismatch"},
+        {AnalysisErrors::DictKeyTypeMismatch, "DictKeyTypeMismatch"}, {AnalysisErrors::DictValueTypeMismatch, "DictValueTypeMismatch"},
+        {AnalysisErrors::CaseTypeMismatch, "CaseTypeMismatch"},
+    };
+    const std::string& key = keys.at(error);
+
+    // every message takes (what, expected, actual) and picks what it needs
+    errorManager->addError(ErrorType::Analysis, error,
+        ErrorSpan{node->filePath, actual->toString(), node->line, node->column},
+        "ErrorManager.Analysis." + key + ".message", {what, expected->toString(), actual->toString()},
+        "ErrorManager.Analysis." + key + ".hint", {what, expected->toString(), actual->toString()});
+    return false;
+}
+
+// ==== Overloads ====
+
+size_t SemanticAnalysis::SignatureKeyHash::operator()(const SignatureKey& key) const {
+    size_t hash = std::hash<const OverloadSet*>{}(key.set) * 31 + key.arity;
+    for (uint32_t id : key.params) hash = hash * 31 + id;
+    return hash;
+}
+
+void SemanticAnalysis::declareFunction(FunctionNode* node) {
+    // another function of the same scope: it's an overload, the signature index decides if it's a redefinition
+    if (isDeclaredInCurrentScope(node->name)) {
+        auto* existing = findName(node->name);
+        if (existing->overloads) return;
+    }
+
+    bool isConst = false;
+    for (auto& modifier : node->modifiers) if (modifier.get()->modifier == ASTModifierType::Const) isConst = true;
+    if (!declareName(node->name, Symbol{Symbol::Kind::Function, isConst, node->filePath, node->line, node->column}, node)) return;
+
+    overloadSets.push_back(makeMemoryPtr<OverloadSet>(OverloadSet{node->name, {}}));
+    findName(node->name)->overloads = overloadSets.back().get();
+}
+
+void SemanticAnalysis::addOverload(OverloadSet* set, FunctionNode* function) {
+    const Type* signature = functionType(function);
+
+    // parameters with defaults can be left out, so the function answers to several arities
+    size_t required = function->parameters.size();
+    while (required > 0 && function->parameters[required - 1]->defaultValue) required--;
+
+    std::vector<uint32_t> params;
+    for (size_t i = 0; i < signature->paramCount(); i++) params.push_back(signature->param(i)->id);
+
+    for (size_t arity = required; arity <= params.size(); arity++) {
+        SignatureKey key{set, (uint32_t)arity, std::vector<uint32_t>(params.begin(), params.begin() + arity)};
+        if (!signatureIndex.try_emplace(key, function).second) {
+            errorManager->addError(ErrorType::Analysis, AnalysisErrors::RedefinedVariable,
+                ErrorSpan{function->filePath, function->name, function->line, function->column},
+                "ErrorManager.Analysis.RedefinedVariable.overload.message", {function->name},
+                "ErrorManager.Analysis.RedefinedVariable.overload.hint");
+            return;
+        }
+        arityIndex[SignatureKey{set, (uint32_t)arity, {}}].push_back(function);
+    }
+    set->functions.push_back(function);
+}
+
+SemanticAnalysis::OverloadSet* SemanticAnalysis::namespaceOverloadSet(const std::vector<ASTNode*>& declarations) {
+    if (auto it = namespaceOverloads.find(&declarations); it != namespaceOverloads.end()) return it->second;
+
+    auto* first = static_cast<FunctionNode*>(declarations.front());
+    overloadSets.push_back(makeMemoryPtr<OverloadSet>(OverloadSet{first->name, {}}));
+    OverloadSet* set = overloadSets.back().get();
+    namespaceOverloads.emplace(&declarations, set);
+
+    for (ASTNode* declaration : declarations)
+        if (match(declaration, ASTNodeType::Function)) addOverload(set, static_cast<FunctionNode*>(declaration));
+    return set;
+}
+
+const Type* SemanticAnalysis::overloadSetType(OverloadSet* set) {
+    // an overloaded name used as a value doesn't say which function it means
+    if (!set || set->functions.size() != 1) return types->dynamic();
+    return functionType(set->functions.front());
+}
+
+// Lists the signatures of an overload set for error hints.
+static std::string describeOverloads(const std::vector<FunctionNode*>& functions) {
+    std::string result;
+    for (FunctionNode* function : functions) {
+        if (!result.empty()) result += ", ";
+        result += function->inferredType ? function->inferredType->toString() : function->name;
+    }
+    return result;
+}
+
+const Type* SemanticAnalysis::resolveCall(CallExpressionNode* node, OverloadSet* set) {
+    const size_t arity = node->arguments.size();
+
+    // a single function keeps check mode: its parameter types flow straight into the arguments
+    if (set->functions.size() == 1) {
+        FunctionNode* function = set->functions.front();
+        const Type* signature = functionType(function);
+        checkArguments(node, signature);
+
+        if (!arityIndex.contains(SignatureKey{set, (uint32_t)arity, {}})) {
+            size_t required = function->parameters.size();
+            while (required > 0 && function->parameters[required - 1]->defaultValue) required--;
+            std::string expected = required == function->parameters.size() ? std::to_string(required) : std::format("{}-{}", required, function->parameters.size());
+            errorManager->addError(ErrorType::Analysis, AnalysisErrors::WrongArgumentCount,
+                ErrorSpan{node->filePath, set->name, node->line, node->column},
+                "ErrorManager.Analysis.WrongArgumentCount.message", {set->name, expected, std::to_string(arity)},
+                "ErrorManager.Analysis.WrongArgumentCount.hint");
+            return signature->returnType();
+        }
+
+        node->resolvedFunction = function;
+        if (onResolvedCall) onResolvedCall(function);
+        return signature->returnType();
+    }
+
+    // overloaded: the arguments decide, so they're inferred on their own first
+    std::vector<const Type*> argumentTypes;
+    std::vector<uint32_t> ids;
+    for (const auto& argument : node->arguments) {
+        argumentTypes.push_back(analyzeExpression(argument.get()));
+        ids.push_back(argumentTypes.back()->id);
+    }
+
+    FunctionNode* chosen = nullptr;
+    if (auto exact = signatureIndex.find(SignatureKey{set, (uint32_t)arity, ids}); exact != signatureIndex.end()) chosen = exact->second;
+    else {
+        auto candidates = arityIndex.find(SignatureKey{set, (uint32_t)arity, {}});
+        if (candidates == arityIndex.end()) {
+            errorManager->addError(ErrorType::Analysis, AnalysisErrors::WrongArgumentCount,
+                ErrorSpan{node->filePath, set->name, node->line, node->column},
+                "ErrorManager.Analysis.WrongArgumentCount.noOverload.message", {set->name, std::to_string(arity)},
+                "ErrorManager.Analysis.WrongArgumentCount.noOverload.hint", {describeOverloads(set->functions)});
+            return types->dynamic();
+        }
+
+        // no exact match: rank the candidates of this arity, exact parameters beat conversions
+        int bestScore = -1;
+        bool ambiguous = false;
+        for (FunctionNode* candidate : candidates->second) {
+            const Type* signature = functionType(candidate);
+            int score = 0;
+            for (size_t i = 0; i < arity && score >= 0; i++) {
+                const Type* parameter = signature->param(i);
+                if (argumentTypes[i] == parameter) score += 2;
+                else if (literalFits(node->arguments[i].get(), parameter)) score += 1;
+                else if (types->isAssignable(argumentTypes[i], parameter)) score += 1;
+                else score = -1;
+            }
+            if (score < 0 || score < bestScore) continue;
+            ambiguous = score == bestScore;
+            bestScore = score;
+            chosen = candidate;
+        }
+
+        std::string argumentList;
+        for (const Type* type : argumentTypes) argumentList += (argumentList.empty() ? "" : ", ") + type->toString();
+
+        if (!chosen || ambiguous) {
+            errorManager->addError(ErrorType::Analysis, AnalysisErrors::FunctionMismatch,
+                ErrorSpan{node->filePath, set->name, node->line, node->column},
+                chosen ? "ErrorManager.Analysis.FunctionMismatch.ambiguous.message" : "ErrorManager.Analysis.FunctionMismatch.noOverload.message", {set->name, argumentList},
+                "ErrorManager.Analysis.FunctionMismatch.noOverload.hint", {describeOverloads(set->functions)});
+            return types->dynamic();
+        }
+    }
+
+    // literals take the exact parameter type now that it's known
+    const Type* signature = functionType(chosen);
+    for (size_t i = 0; i < arity; i++)
+        if (isFlexibleLiteral(node->arguments[i].get())) analyzeExpression(node->arguments[i].get(), signature->param(i));
+
+    node->resolvedFunction = chosen;
+    if (onResolvedCall) onResolvedCall(chosen);
+    return signature->returnType();
 }
 
 // ==== Helpers ====
 
-void SemanticAnalysis::pushScope() { scopes.emplace_back(); }
+void SemanticAnalysis::pushScope() { scopeMarks.push_back(symbols.size()); }
+
+void SemanticAnalysis::popScope() {
+    if (scopeMarks.empty()) return;
+
+    size_t mark = scopeMarks.back();
+    scopeMarks.pop_back();
 
-void SemanticAnalysis::popScope() { if (!scopes.empty()) scopes.pop_back(); }
+    // unwind the scope, uncovering whatever its declarations shadowed
+    while (symbols.size() > mark) {
+        const auto& entry = symbols.back();
+        innermost[entry.name] = entry.shadowed;
+        symbols.pop_back();
+    }
+}
+
+SemanticAnalysis::NameId SemanticAnalysis::intern(const std::string& name) {
+    auto [it, inserted] = nameIds.try_emplace(name, (NameId)innermost.size());
+    if (inserted) innermost.push_back(noEntry);
+    return it->second;
+}
 
 bool SemanticAnalysis::declareName(const std::string& name, Symbol symbol, ASTNode* node)
 {
-    if (scopes.empty()) pushScope();
-    auto& parent = scopes.back();
+    if (scopeMarks.empty()) pushScope();
 
-    if (parent.contains(name)) {
+    NameId id = intern(name);
+    int32_t visible = innermost[id];
+
+    if (visible != noEntry && (size_t)visible >= scopeMarks.back()) {
         errorManager->addError(ErrorType::Analysis, AnalysisErrors::RedefinedVariable,
             ErrorSpan{node ? node->filePath : "", name, node ? node->line : 0, node ? node->column : 0},
             "ErrorManager.Analysis.RedefinedVariable.message", {name},
@@ -455,14 +1403,25 @@ bool SemanticAnalysis::declareName(const std::string& name, Symbol symbol, ASTNo
         symbol.column = node->column;
     }
 
-    parent.emplace(name, symbol);
+    innermost[id] = (int32_t)symbols.size();
+    symbols.push_back(SymbolEntry{id, visible, symbol});
     return true;
 }
 
+bool SemanticAnalysis::isDeclaredInCurrentScope(const std::string& name) {
+    if (scopeMarks.empty()) return false;
+
+    auto it = nameIds.find(name);
+    if (it == nameIds.end()) return false;
+
+    int32_t visible = innermost[it->second];
+    return visible != noEntry && (size_t)visible >= scopeMarks.back();
+}
+
 SemanticAnalysis::Symbol* SemanticAnalysis::findName(const std::string& name) {
-    for (int i = (int)scopes.size()-1; i >= 0; i--){
-        if (scopes[i].contains(name))
-            return &scopes[i].find(name)->second;
-    }
-    return nullptr;
+    auto it = nameIds.find(name);
+    if (it == nameIds.end()) return nullptr; // never declared anywhere
+
+    int32_t visible = innermost[it->second];
+    return visible == noEntry ? nullptr : &symbols[visible].symbol;
 }
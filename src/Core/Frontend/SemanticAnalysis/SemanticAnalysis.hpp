@@ -1,12 +1,17 @@
 #pragma once
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 #include "Core/Extras/ErrorManager/ErrorManager.hpp"
+#include "Core/Extras/SymbolIndex/SymbolIndex.hpp"
 #include "Core/Frontend/Nodes.hpp"
 #include "Core/Frontend/Token.hpp"
 #include "Core/Frontend/Orchestrator/Orchestrator.hpp"
+#include "Types.hpp"
 
 struct Program;
 
@@ -17,9 +22,21 @@ struct SemanticAnalysis {
 
     // Main entry
     void analyzeProgram(Program& program);
+    /* Analyzes a single module of the program. Modules before it in `program.order` only have their top-level
+     * declarations replayed, so it sees the same names as in analyzeProgram() without analyzing them again.
+     * Used by the Compiler to re-check only the modules an edit affects.
+     */
+    void analyzeModuleOf(Program& program, ModuleId id);
+
+    // Resolves the signature of every function in a module that isn't analyzed otherwise, for its symbol index
+    void resolveSignatures(Program& program, ModuleNode* module);
+
+    // Called for every call resolved to a declared function, so the Compiler knows which modules this one depends on
+    std::function<void(FunctionNode*)> onResolvedCall;
 
     // Per-node analyzers
     void analyzeModule(ModuleNode* module);
+    void declareModule(ModuleNode* module); // declaration pass of analyzeModule()
     void analyzeBlock(BlockNode* block);
     void analyzeDeclaration(DeclarationNode* node);
     void analyzeAssignment(AssignmentNode* node);
@@ -27,7 +44,7 @@ struct SemanticAnalysis {
     void analyzeClass(ClassNode* node);
     void analyzeEnum(EnumNode* node);
     void analyzeInterface(InterfaceNode* node);
-    void analyzeCallExpression(CallExpressionNode* node);
+    const Type* analyzeCallExpression(CallExpressionNode* node);
     void analyzeDecorator(DecoratorNode* node);
     void analyzeIf(IfNode* node);
     void analyzeSwitch(SwitchNode* node);
@@ -38,30 +55,132 @@ struct SemanticAnalysis {
     void analyzeThrow(ThrowStatementNode* node);
     void analyzeBreak(BreakStatementNode* node);
     void analyzeContinue(ContinueStatementNode* node);
-    void analyzeLambda(LambdaNode* node);
-    void analyzeExpression(ASTNode* node); // dispatcher for expressions only
+    void analyzeExpressionStatement(ASTNode* node); // a value nobody uses, a task mustn't be one
+    const Type* analyzeLambda(LambdaNode* node, const Type* expected);
+    void analyzeNamespace(NamespaceNode* node);
+
+    /* Dispatcher for expressions only. Infers the type of the expression and annotates the node with it.
+     * If `expected` is given, it's pushed down into the expression (check mode): literals, collections and lambdas
+     * take their type from it. Reporting a mismatch against `expected` is up to the caller, since only it knows which error fits.
+     */
+    const Type* analyzeExpression(ASTNode* node, const Type* expected = nullptr);
 
-    void analyzeStatement(ASTNode* node);
-    ResolvedType resolveType(RawTypeNode* type);
+    void analyzeStatement(ASTNode* statement);
+    const Type* resolveType(RawTypeNode* type); // nullptr if the type is unknown
+    const Type* functionType(FunctionNode* node); // signature of the function, cached on the node
 
 private:
+    // All functions sharing one name in one scope (or one namespace level).
+    struct OverloadSet {
+        std::string name;
+        std::vector<FunctionNode*> functions;
+    };
+
     struct Symbol {
         enum class Kind { Variable, Function, Parameter, Class, Enum, Interface, Decorator };
         Kind kind;
         bool isConst = false;
-        std::string filePath;
+        std::string_view filePath; // points into the AST, which outlives the analysis
         int line = 0, column = 0;
+        const Type* type = nullptr; // nullptr until known, treated as dynamic
+        OverloadSet* overloads = nullptr; // functions only
+    };
+
+    /* Key of the signature index: (overload set, arity, parameter type IDs). The set stands in for the name,
+     * so equal names in different scopes never collide. With empty `params` it keys all candidates of an arity.
+     */
+    struct SignatureKey {
+        const OverloadSet* set;
+        uint32_t arity;
+        std::vector<uint32_t> params;
+        bool operator==(const SignatureKey& other) const = default;
+    };
+    struct SignatureKeyHash { size_t operator()(const SignatureKey& key) const; };
+
+    // Names are interned once, every lookup after that works on NameId.
+    using NameId = uint32_t;
+    static constexpr int32_t noEntry = -1;
+
+    // One live declaration of a name. `shadowed` links to the declaration it hides in an outer scope.
+    struct SymbolEntry {
+        NameId name;
+        int32_t shadowed;
+        Symbol symbol;
     };
 
-    std::vector<std::unordered_map<std::string, Symbol>> scopes;
+    /* The symbol table is flat: all live declarations sit in one stack, scopes are just marks into it,
+     * and `innermost[name]` points to the visible declaration of every name. Lookups are O(1) no matter how
+     * deep the nesting goes, and popping a scope only unwinds the entries it added.
+     */
+    std::unordered_map<std::string, NameId> nameIds;
+    std::vector<int32_t> innermost; // indexed by NameId
+    std::vector<SymbolEntry> symbols;
+    std::vector<size_t> scopeMarks;
+
     int loopDepth = 0;
     int functionDepth = 0;
+    bool isAsync = false; // inside an async function, not a lambda of it: `await` may suspend here
+
+    TypeContext* types = nullptr; // owned by the Program
+
+    // Overloads are indexed once when declared, so resolving a call is a hash lookup.
+    std::vector<MemoryPtr<OverloadSet>> overloadSets;
+    std::unordered_map<SignatureKey, FunctionNode*, SignatureKeyHash> signatureIndex; // every signature, once per arity reachable through default arguments
+    std::unordered_map<SignatureKey, std::vector<FunctionNode*>, SignatureKeyHash> arityIndex; // candidates per arity, for calls that need conversions
+    std::unordered_map<const std::vector<ASTNode*>*, OverloadSet*> namespaceOverloads; // overload sets of namespace members, built on first use
+    const Type* currentReturnType = nullptr; // declared return type of the function being analyzed
+    // Types a lambda returns, its result is inferred from them. `depth` is its functionDepth, returns of functions inside it don't count.
+    struct LambdaReturns {
+        int depth;
+        std::vector<const Type*> types;
+    };
+    LambdaReturns* lambdaReturns = nullptr;
+
+    NamespaceInfo* namespaces = nullptr; // root of the program's namespace tree
+    NamespaceInfo* currentNamespace = nullptr; // level of the namespace body being analyzed, nullptr outside of namespaces
+    const ModuleInfo* currentModule = nullptr;
+
+    void beginProgram(Program& program); // resets every table and opens the global scope
+    void redeclareModule(ModuleNode* module); // top-level names of an already analyzed module
+
+    // Resolves `a.b.c` through the namespace tree if `a` names a namespace (or a namespace alias) and returns the type of the chain.
+    // Returns nullptr if the chain doesn't start with a namespace, so the caller can treat it as a regular member access.
+    const Type* analyzeNamespaceAccess(MemberAccessNode* node);
+    // Declarations of `name` at a namespace level. Members of modules known only by their symbol index are created here on first use.
+    const std::vector<ASTNode*>* namespaceMember(NamespaceInfo* level, const std::string& name);
+    MemoryPtr<ASTNode> importDeclaration(const SymbolIndex& index, const SymbolIndex::Entry& entry, const std::string& name);
+
+    // Overloads
+    void declareFunction(FunctionNode* node); // like declareName(), but same-named functions in one scope form an overload set
+    void addOverload(OverloadSet* set, FunctionNode* function); // indexes the function, reports signatures that already exist
+    OverloadSet* namespaceOverloadSet(const std::vector<ASTNode*>& declarations);
+    const Type* overloadSetType(OverloadSet* set); // type of the function when used as a value
+    const Type* resolveCall(CallExpressionNode* node, OverloadSet* set); // picks the overload, checks arguments and returns the result type
+
+    // Type checking helpers
+    const Type* inferExpression(ASTNode* node, const Type* expected);
+    const Type* analyzeLiteral(LiteralNode* node, const Type* expected);
+    const Type* analyzeBinary(BinaryOperationNode* node, const Type* expected);
+    const Type* analyzeUnary(UnaryOperationNode* node, const Type* expected);
+    const Type* analyzeAwait(UnaryOperationNode* node); // of a task, inside an async function
+    const Type* analyzeMemberAccess(MemberAccessNode* node);
+    // Signature of a method of an array, set or dict, the same ones NIR has operations for, or of an iterator.
+    // nullptr for anything else.
+    const Type* collectionMethod(const Type* collection, const std::string& name, size_t argumentCount);
+    const Type* analyzeCollection(ASTNode* node, const Type* expected);
+    const Type* binaryResultType(const std::string& op, const Type* left, const Type* right); // nullptr if the operator doesn't apply
+    const Type* symbolType(Symbol* symbol) { return symbol && symbol->type ? symbol->type : types->dynamic(); }
+    void checkArguments(CallExpressionNode* node, const Type* signature);
+    // Reports `error` at `node` if a value of type `actual` doesn't fit into `expected`. Returns true if it fits.
+    bool expectType(ASTNode* node, const Type* actual, const Type* expected, AnalysisErrors error, const std::string& what = "");
 
     // Scope helpers
     void pushScope();
     void popScope();
+    NameId intern(const std::string& name);
     bool declareName(const std::string& name, Symbol symbol, ASTNode* node);
-    Symbol* findName(const std::string& name);
+    bool isDeclaredInCurrentScope(const std::string& name);
+    Symbol* findName(const std::string& name); // the pointer is only valid until the next declaration
 
     // just helpers
     bool match(ASTNode* node, ASTNodeType type) {
@@ -0,0 +1,225 @@
+#include "Types.hpp"
+
+#include <cstring>
+#include <format>
+#include <functional>
+#include <optional>
+
+// ==== Type ====
+
+bool Type::isInteger() const {
+    if (kind != Kind::Primitive) return false;
+    switch (primitive) {
+        case ResolvedType::Int8: case ResolvedType::Int16: case ResolvedType::Int: case ResolvedType::Int64: case ResolvedType::Int128:
+        case ResolvedType::UInt8: case ResolvedType::UInt16: case ResolvedType::UInt: case ResolvedType::UInt64: case ResolvedType::UInt128:
+            return true;
+        default: return false;
+    }
+}
+
+bool Type::isFloat() const { return isPrimitive(ResolvedType::Float) || isPrimitive(ResolvedType::Float64); }
+
+bool Type::isNumeric() const { return isInteger() || isFloat() || isPrimitive(ResolvedType::Number); }
+
+std::string Type::toString() const {
+    switch (kind) {
+        case Kind::Primitive: {
+            for (const auto& [name, type] : getTypeMap())
+                if (type == primitive) return name;
+            return "unknown";
+        }
+        case Kind::Array: return std::format("{}[]", components[0]->toString());
+        case Kind::Set: return std::format("set<{}>", components[0]->toString());
+        case Kind::Dict: return std::format("dict<{}, {}>", components[0]->toString(), components[1]->toString());
+        case Kind::Result: return std::format("result<{}, {}>", components[0]->toString(), components[1]->toString());
+        case Kind::Iterator: return std::format("iter<{}>", components[0]->toString());
+        case Kind::Task: return std::format("task<{}>", components[0]->toString());
+        case Kind::Tuple: {
+            std::string elements;
+            for (size_t i = 0; i < components.size(); i++) {
+                if (i) elements += ", ";
+                elements += components[i]->toString();
+            }
+            return std::format("({})", elements);
+        }
+        case Kind::Function: {
+            std::string params;
+            for (size_t i = 0; i < paramCount(); i++) {
+                if (i) params += ", ";
+                params += param(i)->toString();
+            }
+            return std::format("fn({}) -> {}", params, returnType()->toString());
+        }
+        case Kind::Nullable: return std::format("{}?", components[0]->toString());
+        case Kind::UserDefined: return name;
+        case Kind::Null: return "null";
+        case Kind::Dynamic: return "dynamic";
+    }
+    return "unknown";
+}
+
+// One byte of kind, then whatever the kind needs: the primitive, the name, or the components.
+// The length of a name and the component count of functions and tuples are u32s, nothing a program writes outgrows them.
+void Type::encode(std::string& out) const {
+    auto count = [&out](size_t value) {
+        auto u32 = static_cast<uint32_t>(value);
+        out.append(reinterpret_cast<const char*>(&u32), sizeof(u32));
+    };
+    out += static_cast<char>(kind);
+    switch (kind) {
+        case Kind::Primitive: out += static_cast<char>(primitive); break;
+        case Kind::UserDefined:
+            count(name.size());
+            out += name;
+            break;
+        case Kind::Function: case Kind::Tuple: count(components.size()); [[fallthrough]];
+        default: for (const Type* component : components) component->encode(out); break;
+    }
+}
+
+// ==== TypeContext ====
+
+TypeContext::TypeContext() {
+    for (size_t i = 0; i < primitives.size(); i++) {
+        Type type{Type::Kind::Primitive};
+        type.primitive = static_cast<ResolvedType>(i);
+        primitives[i] = intern(std::move(type));
+    }
+    nullType = intern(Type{Type::Kind::Null});
+    dynamicType = intern(Type{Type::Kind::Dynamic});
+}
+
+const Type* TypeContext::array(const Type* element) { return intern(Type{Type::Kind::Array, ResolvedType::Array, {element}}); }
+const Type* TypeContext::set(const Type* element) { return intern(Type{Type::Kind::Set, ResolvedType::Set, {element}}); }
+const Type* TypeContext::dict(const Type* key, const Type* value) { return intern(Type{Type::Kind::Dict, ResolvedType::Dict, {key, value}}); }
+const Type* TypeContext::result(const Type* value, const Type* error) { return intern(Type{Type::Kind::Result, ResolvedType::Result, {value, error}}); }
+const Type* TypeContext::iterator(const Type* element) { return intern(Type{Type::Kind::Iterator, ResolvedType::Iterator, {element}}); }
+const Type* TypeContext::task(const Type* result) { return intern(Type{Type::Kind::Task, ResolvedType::Task, {result}}); }
+const Type* TypeContext::tuple(const std::vector<const Type*>& elements) { return intern(Type{Type::Kind::Tuple, ResolvedType::Unknown, elements}); }
+
+const Type* TypeContext::function(const Type* returnType, const std::vector<const Type*>& params) {
+    Type type{Type::Kind::Function};
+    type.components.reserve(params.size() + 1);
+    type.components.push_back(returnType);
+    type.components.insert(type.components.end(), params.begin(), params.end());
+    return intern(std::move(type));
+}
+
+const Type* TypeContext::nullable(const Type* inner) {
+    // T?? is still T?, and null/dynamic already hold null
+    if (inner->kind == Type::Kind::Nullable || inner == nullType || inner == dynamicType) return inner;
+    return intern(Type{Type::Kind::Nullable, ResolvedType::Unknown, {inner}});
+}
+
+const Type* TypeContext::userDefined(const std::string& name) {
+    Type type{Type::Kind::UserDefined, ResolvedType::UserDefined};
+    type.name = name;
+    return intern(std::move(type));
+}
+
+const Type* TypeContext::decode(std::string_view& bytes) {
+    auto next = [&bytes]() -> int {
+        if (bytes.empty()) return -1;
+        auto byte = static_cast<unsigned char>(bytes.front());
+        bytes.remove_prefix(1);
+        return byte;
+    };
+    auto count = [&bytes]() -> std::optional<uint32_t> {
+        uint32_t value = 0;
+        if (bytes.size() < sizeof(value)) return std::nullopt;
+        std::memcpy(&value, bytes.data(), sizeof(value));
+        bytes.remove_prefix(sizeof(value));
+        return value;
+    };
+
+    int kind = next();
+    switch (static_cast<Type::Kind>(kind)) {
+        case Type::Kind::Primitive: {
+            int primitive = next();
+            return primitive >= 0 && primitive < static_cast<int>(primitives.size()) ? primitives[primitive] : nullptr;
+        }
+        case Type::Kind::Array: case Type::Kind::Set: case Type::Kind::Iterator: case Type::Kind::Task: case Type::Kind::Nullable: {
+            const Type* element = decode(bytes);
+            if (!element) return nullptr;
+            switch (static_cast<Type::Kind>(kind)) {
+                case Type::Kind::Array: return array(element);
+                case Type::Kind::Set: return set(element);
+                case Type::Kind::Iterator: return iterator(element);
+                case Type::Kind::Task: return task(element);
+                default: return nullable(element);
+            }
+        }
+        case Type::Kind::Dict: case Type::Kind::Result: {
+            const Type* first = decode(bytes);
+            const Type* second = first ? decode(bytes) : nullptr;
+            if (!second) return nullptr;
+            return kind == static_cast<int>(Type::Kind::Dict) ? dict(first, second) : result(first, second);
+        }
+        case Type::Kind::Function: case Type::Kind::Tuple: {
+            std::optional<uint32_t> size = count();
+            if (!size || *size < 1 || *size > bytes.size()) return nullptr; // every component takes a byte at least
+            std::vector<const Type*> components;
+            components.reserve(*size);
+            for (uint32_t i = 0; i < *size; i++) {
+                const Type* component = decode(bytes);
+                if (!component) return nullptr;
+                components.push_back(component);
+            }
+            if (kind == static_cast<int>(Type::Kind::Tuple)) return tuple(components);
+            return function(components.front(), std::vector<const Type*>(components.begin() + 1, components.end()));
+        }
+        case Type::Kind::UserDefined: {
+            std::optional<uint32_t> length = count();
+            if (!length || bytes.size() < *length) return nullptr;
+            std::string name(bytes.substr(0, *length));
+            bytes.remove_prefix(*length);
+            return userDefined(name);
+        }
+        case Type::Kind::Null: return nullType;
+        case Type::Kind::Dynamic: return dynamicType;
+    }
+    return nullptr;
+}
+
+bool TypeContext::isAssignable(const Type* from, const Type* to) const {
+    if (from == to) return true;
+    if (from == dynamicType || to == dynamicType) return true;
+
+    if (to->kind == Type::Kind::Nullable)
+        return from == nullType || isAssignable(from, to->element()) ||
+            (from->kind == Type::Kind::Nullable && isAssignable(from->element(), to->element()));
+
+    // every numeric type widens into the arbitrary precision `number`
+    if (to->isPrimitive(ResolvedType::Number)) return from->isNumeric();
+
+    // containers are compatible when their components are, so `[]` of dynamic elements fits into int[]
+    if (from->kind == to->kind && from->components.size() == to->components.size() && from->kind != Type::Kind::Primitive && from->kind != Type::Kind::UserDefined) {
+        for (size_t i = 0; i < from->components.size(); i++)
+            if (!isAssignable(from->components[i], to->components[i])) return false;
+        return true;
+    }
+
+    return false;
+}
+
+const Type* TypeContext::intern(Type&& type) {
+    if (auto it = interned.find(&type); it != interned.end()) return *it;
+
+    type.id = static_cast<uint32_t>(storage.size());
+    storage.push_back(makeMemoryPtr<Type>(std::move(type)));
+    const Type* result = storage.back().get();
+    interned.insert(result);
+    return result;
+}
+
+// Components are interned already, so hashing and comparing them by address is enough.
+size_t TypeContext::ShapeHash::operator()(const Type* type) const {
+    size_t hash = std::hash<int>{}(static_cast<int>(type->kind)) * 31 + std::hash<int>{}(static_cast<int>(type->primitive));
+    for (const Type* component : type->components) hash = hash * 31 + std::hash<const Type*>{}(component);
+    if (!type->name.empty()) hash ^= std::hash<std::string>{}(type->name);
+    return hash;
+}
+
+bool TypeContext::ShapeEqual::operator()(const Type* a, const Type* b) const {
+    return a->kind == b->kind && a->primitive == b->primitive && a->components == b->components && a->name == b->name;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "../../../HelperFunctions.hpp"
+#include "Core/Frontend/Token.hpp"
+
+/* Type is the semantic type of a value, as opposed to RawTypeNode which is just what the user wrote.
+ * Types are hash-consed by TypeContext: every distinct type exists exactly once, so two types are
+ * equal if and only if their pointers are. Never construct a Type yourself, ask the TypeContext for it.
+ */
+struct Type {
+    enum class Kind {
+        Primitive,   // int, float, str, bool, void, ...
+        Array, Set, Dict, Result,
+        Iterator,    // iter<T>, a lazy sequence of T: nothing is computed before the loop over it asks for it
+        Task,        // task<T>, a running call of an async function: `await` gives its T once it's done
+        Tuple,       // (T, U, ...), what zip and enumerate give
+        Function,
+        Nullable,    // T?
+        UserDefined, // classes, enums, interfaces
+        Null,        // type of the `null` literal, only fits into nullables
+        Dynamic,     // not known at compile time (untyped parameters, lambdas, ...); checks are deferred to runtime
+    };
+
+    Kind kind;
+    ResolvedType primitive = ResolvedType::Unknown; // set for primitives only
+
+    /* Component types, meaning depends on the kind:
+     * Array, Set, Iterator, Task - [element]
+     * Dict - [key, value]
+     * Result - [value, error]
+     * Function - [return, parameters...]
+     * Tuple - [elements...]
+     * Nullable - [inner]
+     */
+    std::vector<const Type*> components;
+    std::string name; // for user-defined types
+    uint32_t id = 0; // dense index in the TypeContext, usable as a hash key
+
+    bool isPrimitive(ResolvedType t) const { return kind == Kind::Primitive && primitive == t; }
+    bool isDynamic() const { return kind == Kind::Dynamic; }
+    bool isInteger() const;
+    bool isFloat() const;
+    bool isNumeric() const; // integers, floats and number
+    bool isVoid() const { return isPrimitive(ResolvedType::Void); }
+
+    const Type* element() const { return components.empty() ? nullptr : components.front(); } // Array, Set, Iterator, Task, Nullable
+    const Type* returnType() const { return components.front(); } // Function only
+    size_t paramCount() const { return components.size() - 1; } // Function only
+    const Type* param(size_t i) const { return components[i + 1]; } // Function only
+
+    std::string toString() const;
+    // Compact binary form, read back with TypeContext::decode(). Used by symbol indexes.
+    void encode(std::string& out) const;
+};
+
+struct TypeContext {
+    TypeContext();
+
+    const Type* primitive(ResolvedType type) const { return primitives[static_cast<size_t>(type)]; }
+    const Type* array(const Type* element);
+    const Type* set(const Type* element);
+    const Type* dict(const Type* key, const Type* value);
+    const Type* result(const Type* value, const Type* error);
+    const Type* iterator(const Type* element);
+    const Type* task(const Type* result);
+    const Type* tuple(const std::vector<const Type*>& elements);
+    const Type* function(const Type* returnType, const std::vector<const Type*>& params);
+    const Type* nullable(const Type* inner);
+    const Type* userDefined(const std::string& name);
+    const Type* null() const { return nullType; }
+    const Type* dynamic() const { return dynamicType; }
+
+    // Reads a type written by Type::encode() and moves `bytes` past it. Returns nullptr if the bytes are malformed.
+    const Type* decode(std::string_view& bytes);
+
+    // Can a value of type `from` be stored where `to` is expected without an explicit cast?
+    bool isAssignable(const Type* from, const Type* to) const;
+
+    size_t size() const { return storage.size(); }
+
+private:
+    struct ShapeHash { size_t operator()(const Type* type) const; };
+    struct ShapeEqual { bool operator()(const Type* a, const Type* b) const; };
+
+    std::vector<MemoryPtr<Type>> storage; // owns every type ever created, addresses are stable
+    std::unordered_set<const Type*, ShapeHash, ShapeEqual> interned;
+
+    std::array<const Type*, static_cast<size_t>(ResolvedType::Unknown) + 1> primitives{};
+    const Type* nullType = nullptr;
+    const Type* dynamicType = nullptr;
+
+    const Type* intern(Type&& type);
+};
@@ -56,7 +56,7 @@ enum class ResolvedType {
     UInt8, UInt16, UInt, UInt64, UInt128,
     Float, Float64,
     Number, Bool, Str,
-    Array, Dict, Set, Result,
+    Array, Dict, Set, Result, Iterator, Task,
     Void, UserDefined, Unknown
 };
 
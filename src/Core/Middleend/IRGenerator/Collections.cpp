@@ -0,0 +1,907 @@
+#include "Collections.hpp"
+
+// LLVM Primitives
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
+
+#include "Decimals.hpp"
+#include "Pointers.hpp"
+
+static constexpr uint64_t GroupSize = 16, MinimumCapacity = 16, MinimumArray = 4;
+static constexpr int8_t Empty = -128, Deleted = -2; // a full slot has the high bit clear
+
+enum ArrayField : unsigned { Length, Capacity, Data };
+enum TableField : unsigned { Size, Slots, GrowthLeft, Control, Keys, Values };
+
+// ==== Helpers ====
+
+llvm::Type* Collections::bytePointer() { return pointerTo(llvm::Type::getInt8Ty(context)); }
+
+llvm::Type* Collections::sizeType() { return module.getDataLayout().getIntPtrType(context); }
+
+llvm::Value* Collections::field(llvm::IRBuilderBase& at, llvm::StructType* type, llvm::Value* collection, unsigned index) {
+    return at.CreateConstInBoundsGEP2_32(type, collection, 0, index);
+}
+
+llvm::Value* Collections::load(llvm::IRBuilderBase& at, llvm::StructType* type, llvm::Value* collection, unsigned index) {
+    return at.CreateLoad(type->getElementType(index), field(at, type, collection, index));
+}
+
+llvm::Value* Collections::allocate(llvm::IRBuilderBase& at, llvm::Value* count, llvm::Type* type) {
+    llvm::Value* bytes = at.CreateMul(count, at.getInt64(module.getDataLayout().getTypeAllocSize(type)));
+    llvm::Value* memory = collector
+        ? at.CreateCall(collector->allocate(), {bytes})
+        : at.CreateCall(libc("malloc", bytePointer(), {sizeType()}), {at.CreateZExtOrTrunc(bytes, sizeType())});
+    return at.CreatePointerCast(memory, pointerTo(type));
+}
+
+llvm::Value* Collections::allocateHeader(llvm::IRBuilderBase& at, llvm::StructType* layout) {
+    uint64_t size = module.getDataLayout().getTypeAllocSize(layout);
+    if (collector) {
+        // the tracer goes after the fields
+        llvm::Value* object = at.CreateCall(collector->allocate(), {at.getInt64(size + 8)});
+        collector->traced(at, object, trace(layout));
+        return at.CreatePointerCast(object, pointerTo(layout));
+    }
+    if (!counter) return allocate(at, at.getInt64(1), layout);
+    llvm::Value* object = at.CreateCall(counter->allocate(), {at.getInt64(size)});
+    return at.CreatePointerCast(object, pointerTo(layout));
+}
+
+llvm::Function* Collections::create(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters) {
+    return llvm::Function::Create(llvm::FunctionType::get(result, parameters, false), llvm::GlobalValue::LinkOnceODRLinkage, name, module);
+}
+
+llvm::FunctionCallee Collections::libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters, bool variadic) {
+    return module.getOrInsertFunction(name, llvm::FunctionType::get(result, parameters, variadic));
+}
+
+llvm::StructType* Collections::arrayType(const std::string& name, const Element& element) {
+    std::string typeName = "neoluma." + name;
+    llvm::StructType* type = llvm::StructType::getTypeByName(context, typeName);
+    if (!type) {
+        llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+        type = llvm::StructType::create(context, {int64, int64, pointerTo(element.type)}, typeName);
+    }
+    layouts.try_emplace(type, Layout{name, element, std::nullopt});
+    return type;
+}
+
+llvm::StructType* Collections::tableType(const std::string& name, const Element& key, const std::optional<Element>& value) {
+    std::string typeName = "neoluma." + name;
+    llvm::StructType* type = llvm::StructType::getTypeByName(context, typeName);
+    if (!type) {
+        llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+        std::vector<llvm::Type*> fields = {int64, int64, int64, bytePointer(), pointerTo(key.type)};
+        if (value) fields.push_back(pointerTo(value->type));
+        type = llvm::StructType::create(context, fields, typeName);
+    }
+    layouts.try_emplace(type, Layout{name, key, value});
+    return type;
+}
+
+llvm::Value* Collections::length(llvm::IRBuilderBase& at, llvm::Value* collection) {
+    // the first field of every layout
+    llvm::Type* int64 = at.getInt64Ty();
+    return at.CreateLoad(int64, at.CreatePointerCast(collection, pointerTo(int64)));
+}
+
+llvm::Value* Collections::stored(llvm::IRBuilderBase& at, llvm::Value* value, const Element& element, llvm::Value* collection) {
+    if (isCounted(element) && collection) {
+        // a collection other threads can reach hands them what goes into it
+        llvm::Function* function = at.GetInsertBlock()->getParent();
+        llvm::BasicBlock* shareBlock = llvm::BasicBlock::Create(context, "stored.share", function);
+        llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "stored.done", function);
+        at.CreateCondBr(counter->isShared(at, collection), shareBlock, done, llvm::MDBuilder(context).createBranchWeights(1, 1000));
+        at.SetInsertPoint(shareBlock);
+        shareElement(at, value, element);
+        at.CreateBr(done);
+        at.SetInsertPoint(done);
+    }
+    return value;
+}
+
+llvm::Value* Collections::object(llvm::IRBuilderBase& at, llvm::Value* value, const Element& element) {
+    return element.isNumber ? Decimals::limbs(at, value) : at.CreatePointerCast(value, bytePointer());
+}
+
+void Collections::releaseElement(llvm::IRBuilderBase& at, llvm::Value* value, const Element& element) {
+    if (element.isString) at.CreateCall(counter->release(), {value});
+    else if (element.isNumber) at.CreateCall(counter->release(), {object(at, value, element)});
+    else if (element.collection) at.CreateCall(release(element.collection), {value});
+}
+
+void Collections::shareElement(llvm::IRBuilderBase& at, llvm::Value* value, const Element& element) {
+    if (element.isString) at.CreateCall(counter->share(), {value});
+    else if (element.isNumber) at.CreateCall(counter->share(), {object(at, value, element)});
+    else if (element.collection) at.CreateCall(share(element.collection), {value});
+}
+
+llvm::Function* Collections::release(llvm::StructType* layout) {
+    std::string name = "neoluma." + layouts.at(layout).name + ".release";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    const Layout& elements = layouts.at(layout);
+    bool isArray = layout->getNumElements() == 3;
+    llvm::Function* function = create(name, llvm::Type::getVoidTy(context), {pointerTo(layout)});
+    counter->dropsReferences(function, true);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* last = llvm::BasicBlock::Create(context, "last", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* header = function->getArg(0);
+    llvm::Value* object = body.CreatePointerCast(header, bytePointer());
+    body.CreateCondBr(counter->decrement(body, object), last, done);
+
+    body.SetInsertPoint(last);
+    llvm::Value* buffer = load(body, layout, header, isArray ? Data : Keys);
+    llvm::Value* values = !isArray && elements.value ? load(body, layout, header, Values) : nullptr;
+    if (isCounted(elements.key) || (elements.value && isCounted(*elements.value))) {
+        // an array's elements are below its length, a table's keys and values in the full slots
+        llvm::Value* bound = load(body, layout, header, isArray ? Length : Slots);
+        llvm::Value* control = isArray ? nullptr : load(body, layout, header, Control);
+        llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "loop", function, done);
+        llvm::BasicBlock* check = llvm::BasicBlock::Create(context, "check", function, done);
+        llvm::BasicBlock* drop = llvm::BasicBlock::Create(context, "drop", function, done);
+        llvm::BasicBlock* next = llvm::BasicBlock::Create(context, "next", function, done);
+        llvm::BasicBlock* freed = llvm::BasicBlock::Create(context, "freed", function, done);
+        llvm::BasicBlock* before = body.GetInsertBlock();
+        body.CreateBr(loop);
+
+        body.SetInsertPoint(loop);
+        llvm::PHINode* index = body.CreatePHI(body.getInt64Ty(), 2);
+        body.CreateCondBr(body.CreateICmpULT(index, bound), check, freed);
+
+        body.SetInsertPoint(check);
+        if (isArray) body.CreateBr(drop);
+        else body.CreateCondBr(body.CreateICmpSGE(body.CreateLoad(body.getInt8Ty(), body.CreateInBoundsGEP(body.getInt8Ty(), control, index)), body.getInt8(0)), drop, next);
+
+        body.SetInsertPoint(drop);
+        if (isCounted(elements.key)) releaseElement(body, body.CreateLoad(elements.key.type, body.CreateInBoundsGEP(elements.key.type, buffer, index)), elements.key);
+        if (values && isCounted(*elements.value)) releaseElement(body, body.CreateLoad(elements.value->type, body.CreateInBoundsGEP(elements.value->type, values, index)), *elements.value);
+        body.CreateBr(next);
+
+        body.SetInsertPoint(next);
+        llvm::Value* nextIndex = body.CreateAdd(index, body.getInt64(1));
+        body.CreateBr(loop);
+        index->addIncoming(body.getInt64(0), before);
+        index->addIncoming(nextIndex, next);
+        body.SetInsertPoint(freed);
+    }
+
+    llvm::FunctionCallee free = libc("free", body.getVoidTy(), {bytePointer()});
+    body.CreateCall(free, {body.CreatePointerCast(buffer, bytePointer())});
+    if (!isArray) body.CreateCall(free, {load(body, layout, header, Control)});
+    if (values) body.CreateCall(free, {body.CreatePointerCast(values, bytePointer())});
+    counter->free(body, object);
+    body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Collections::share(llvm::StructType* layout) {
+    std::string name = "neoluma." + layouts.at(layout).name + ".share";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    const Layout& elements = layouts.at(layout);
+    bool isArray = layout->getNumElements() == 3;
+    llvm::Function* function = create(name, llvm::Type::getVoidTy(context), {pointerTo(layout)});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* counted = llvm::BasicBlock::Create(context, "counted", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* header = function->getArg(0);
+    llvm::Value* object = body.CreatePointerCast(header, bytePointer());
+
+    // one shared already shares what's in it
+    llvm::BasicBlock* check = llvm::BasicBlock::Create(context, "check", function, counted);
+    body.CreateCondBr(body.CreateIsNull(object), done, check);
+    body.SetInsertPoint(check);
+    body.CreateCondBr(counter->isShared(body, object), done, counted);
+
+    body.SetInsertPoint(counted);
+    body.CreateCall(counter->share(), {object});
+    if (isCounted(elements.key) || (elements.value && isCounted(*elements.value))) {
+        llvm::Value* buffer = load(body, layout, header, isArray ? Data : Keys);
+        llvm::Value* values = !isArray && elements.value ? load(body, layout, header, Values) : nullptr;
+        llvm::Value* bound = load(body, layout, header, isArray ? Length : Slots);
+        llvm::Value* control = isArray ? nullptr : load(body, layout, header, Control);
+        llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "loop", function, done);
+        llvm::BasicBlock* element = llvm::BasicBlock::Create(context, "element", function, done);
+        llvm::BasicBlock* mark = llvm::BasicBlock::Create(context, "mark", function, done);
+        llvm::BasicBlock* next = llvm::BasicBlock::Create(context, "next", function, done);
+        llvm::BasicBlock* before = body.GetInsertBlock();
+        body.CreateBr(loop);
+
+        body.SetInsertPoint(loop);
+        llvm::PHINode* index = body.CreatePHI(body.getInt64Ty(), 2);
+        body.CreateCondBr(body.CreateICmpULT(index, bound), element, done);
+
+        body.SetInsertPoint(element);
+        if (isArray) body.CreateBr(mark);
+        else body.CreateCondBr(body.CreateICmpSGE(body.CreateLoad(body.getInt8Ty(), body.CreateInBoundsGEP(body.getInt8Ty(), control, index)), body.getInt8(0)), mark, next);
+
+        body.SetInsertPoint(mark);
+        if (isCounted(elements.key)) shareElement(body, body.CreateLoad(elements.key.type, body.CreateInBoundsGEP(elements.key.type, buffer, index)), elements.key);
+        if (values && isCounted(*elements.value)) shareElement(body, body.CreateLoad(elements.value->type, body.CreateInBoundsGEP(elements.value->type, values, index)), *elements.value);
+        body.CreateBr(next);
+
+        body.SetInsertPoint(next);
+        llvm::Value* nextIndex = body.CreateAdd(index, body.getInt64(1));
+        body.CreateBr(loop);
+        index->addIncoming(body.getInt64(0), before);
+        index->addIncoming(nextIndex, next);
+    }
+    else body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Collections::trace(llvm::StructType* layout) {
+    std::string name = "neoluma." + layouts.at(layout).name + ".trace";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    const Layout& elements = layouts.at(layout);
+    bool isArray = layout->getNumElements() == 3;
+    llvm::Function* function = create(name, llvm::Type::getVoidTy(context), {bytePointer()});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* header = body.CreatePointerCast(function->getArg(0), pointerTo(layout));
+    llvm::Function* mark = collector->mark();
+
+    // a buffer not allocated yet is null, and so is the bound
+    llvm::Value* buffer = load(body, layout, header, isArray ? Data : Keys);
+    llvm::Value* values = !isArray && elements.value ? load(body, layout, header, Values) : nullptr;
+    llvm::Value* control = isArray ? nullptr : load(body, layout, header, Control);
+    body.CreateCall(mark, {body.CreatePointerCast(buffer, bytePointer())});
+    if (control) body.CreateCall(mark, {control});
+    if (values) body.CreateCall(mark, {body.CreatePointerCast(values, bytePointer())});
+
+    if (isTraced(elements.key) || (values && isTraced(*elements.value))) {
+        // an array's elements are below its length, a table's keys and values in the full slots
+        llvm::Value* bound = load(body, layout, header, isArray ? Length : Slots);
+        llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "loop", function, done);
+        llvm::BasicBlock* check = llvm::BasicBlock::Create(context, "check", function, done);
+        llvm::BasicBlock* element = llvm::BasicBlock::Create(context, "element", function, done);
+        llvm::BasicBlock* next = llvm::BasicBlock::Create(context, "next", function, done);
+        llvm::BasicBlock* before = body.GetInsertBlock();
+        body.CreateBr(loop);
+
+        body.SetInsertPoint(loop);
+        llvm::PHINode* index = body.CreatePHI(body.getInt64Ty(), 2);
+        body.CreateCondBr(body.CreateICmpULT(index, bound), check, done);
+
+        body.SetInsertPoint(check);
+        if (isArray) body.CreateBr(element);
+        else body.CreateCondBr(body.CreateICmpSGE(body.CreateLoad(body.getInt8Ty(), body.CreateInBoundsGEP(body.getInt8Ty(), control, index)), body.getInt8(0)), element, next);
+
+        body.SetInsertPoint(element);
+        auto markAt = [&](llvm::Value* from, const Element& held) {
+            llvm::Value* value = body.CreateLoad(held.type, body.CreateInBoundsGEP(held.type, from, index));
+            body.CreateCall(mark, {object(body, value, held)});
+        };
+        if (isTraced(elements.key)) markAt(buffer, elements.key);
+        if (values && isTraced(*elements.value)) markAt(values, *elements.value);
+        body.CreateBr(next);
+
+        body.SetInsertPoint(next);
+        llvm::Value* nextIndex = body.CreateAdd(index, body.getInt64(1));
+        body.CreateBr(loop);
+        index->addIncoming(body.getInt64(0), before);
+        index->addIncoming(nextIndex, next);
+    }
+    else body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+// ==== Arrays ====
+
+llvm::Function* Collections::arrayNew(llvm::StructType* array) {
+    std::string name = "neoluma." + layouts.at(array).name + ".new";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    llvm::Type* element = layouts.at(array).key.type;
+    llvm::Function* function = create(name, pointerTo(array), {llvm::Type::getInt64Ty(context)});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* length = function->getArg(0);
+
+    llvm::Value* header = allocateHeader(body, array);
+    llvm::Value* capacity = body.CreateBinaryIntrinsic(llvm::Intrinsic::umax, length, body.getInt64(MinimumArray));
+    llvm::Value* frame = nullptr;
+    if (collector) {
+        // empty till it has its buffer, which may take a collection
+        body.CreateStore(body.getInt64(0), field(body, array, header, Length));
+        body.CreateStore(llvm::Constant::getNullValue(pointerTo(element)), field(body, array, header, Data));
+        frame = collector->pushFrame(body, 1);
+        collector->setRoot(body, frame, 0, header);
+    }
+    llvm::Value* data = allocate(body, capacity, element);
+    if (frame) collector->popFrame(body, frame);
+    if (isTraced(layouts.at(array).key)) body.CreateMemSet(data, body.getInt8(0), body.CreateMul(length, body.getInt64(module.getDataLayout().getTypeAllocSize(element))), llvm::MaybeAlign(8));
+    body.CreateStore(capacity, field(body, array, header, Capacity));
+    body.CreateStore(data, field(body, array, header, Data));
+    body.CreateStore(length, field(body, array, header, Length));
+    body.CreateRet(header);
+    return function;
+}
+
+llvm::Function* Collections::arrayGrow(llvm::StructType* array) {
+    std::string name = "neoluma." + layouts.at(array).name + ".grow";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    llvm::Type* element = layouts.at(array).key.type;
+    llvm::Function* function = create(name, llvm::Type::getVoidTy(context), {pointerTo(array)});
+    function->addFnAttr(llvm::Attribute::NoInline);
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* header = function->getArg(0);
+
+    llvm::Value* capacity = body.CreateBinaryIntrinsic(llvm::Intrinsic::umax, body.CreateShl(load(body, array, header, Capacity), 1), body.getInt64(MinimumArray));
+    llvm::Value* elementSize = body.getInt64(module.getDataLayout().getTypeAllocSize(element));
+    llvm::Value* data = body.CreatePointerCast(load(body, array, header, Data), bytePointer());
+    llvm::Value* moved = nullptr;
+    if (collector) {
+        // the old buffer stays till nothing reaches it
+        moved = body.CreatePointerCast(allocate(body, capacity, element), bytePointer());
+        body.CreateMemCpy(moved, llvm::MaybeAlign(8), data, llvm::MaybeAlign(8), body.CreateMul(load(body, array, header, Length), elementSize));
+    }
+    else moved = body.CreateCall(libc("realloc", bytePointer(), {bytePointer(), sizeType()}), {data, body.CreateZExtOrTrunc(body.CreateMul(capacity, elementSize), sizeType())});
+    body.CreateStore(capacity, field(body, array, header, Capacity));
+    body.CreateStore(body.CreatePointerCast(moved, pointerTo(element)), field(body, array, header, Data));
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Collections::arrayPush(llvm::StructType* array) {
+    std::string name = "neoluma." + layouts.at(array).name + ".push";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    const Element& element = layouts.at(array).key;
+    llvm::Function* function = create(name, llvm::Type::getVoidTy(context), {pointerTo(array), element.type});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* grow = llvm::BasicBlock::Create(context, "grow", function);
+    llvm::BasicBlock* store = llvm::BasicBlock::Create(context, "store", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* header = function->getArg(0);
+
+    llvm::Value* length = load(body, array, header, Length);
+    llvm::Value* full = body.CreateICmpEQ(length, load(body, array, header, Capacity));
+    body.CreateCondBr(full, grow, store, llvm::MDBuilder(context).createBranchWeights(1, 1000));
+
+    body.SetInsertPoint(grow);
+    body.CreateCall(arrayGrow(array), {header});
+    body.CreateBr(store);
+
+    body.SetInsertPoint(store);
+    body.CreateStore(stored(body, function->getArg(1), element, header), this->element(body, array, header, length));
+    body.CreateStore(body.CreateAdd(length, body.getInt64(1)), field(body, array, header, Length));
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Collections::arrayGet(llvm::StructType* array) {
+    std::string name = "neoluma." + layouts.at(array).name + ".get";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    llvm::Type* element = layouts.at(array).key.type;
+    llvm::Function* function = create(name, element, {pointerTo(array), llvm::Type::getInt64Ty(context)});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* inRange = llvm::BasicBlock::Create(context, "in.range", function);
+    llvm::BasicBlock* outside = llvm::BasicBlock::Create(context, "out.of.range", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* header = function->getArg(0);
+    llvm::Value* index = function->getArg(1);
+
+    // unsigned, so a negative index is out of range too
+    llvm::Value* length = load(body, array, header, Length);
+    body.CreateCondBr(body.CreateICmpULT(index, length), inRange, outside, llvm::MDBuilder(context).createBranchWeights(1000, 1));
+
+    body.SetInsertPoint(outside);
+    body.CreateCall(outOfRange(), {index, length});
+    body.CreateUnreachable();
+
+    body.SetInsertPoint(inRange);
+    body.CreateRet(body.CreateLoad(element, this->element(body, array, header, index)));
+    return function;
+}
+
+llvm::Function* Collections::arraySet(llvm::StructType* array) {
+    std::string name = "neoluma." + layouts.at(array).name + ".set";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    const Element& element = layouts.at(array).key;
+    llvm::Function* function = create(name, llvm::Type::getVoidTy(context), {pointerTo(array), llvm::Type::getInt64Ty(context), element.type});
+    if (counter) counter->dropsReferences(function, false);
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* inRange = llvm::BasicBlock::Create(context, "in.range", function);
+    llvm::BasicBlock* outside = llvm::BasicBlock::Create(context, "out.of.range", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* header = function->getArg(0);
+    llvm::Value* index = function->getArg(1);
+
+    llvm::Value* length = load(body, array, header, Length);
+    body.CreateCondBr(body.CreateICmpULT(index, length), inRange, outside, llvm::MDBuilder(context).createBranchWeights(1000, 1));
+
+    body.SetInsertPoint(outside);
+    body.CreateCall(outOfRange(), {index, length});
+    body.CreateUnreachable();
+
+    body.SetInsertPoint(inRange);
+    llvm::Value* address = this->element(body, array, header, index);
+    llvm::Value* replaced = isCounted(element) ? body.CreateLoad(element.type, address) : nullptr;
+    body.CreateStore(stored(body, function->getArg(2), element, header), address);
+    if (replaced) releaseElement(body, replaced, element);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Value* Collections::element(llvm::IRBuilderBase& at, llvm::StructType* array, llvm::Value* collection, llvm::Value* index) {
+    return at.CreateInBoundsGEP(layouts.at(array).key.type, load(at, array, collection, Data), index);
+}
+
+llvm::Function* Collections::outOfRange() {
+    if (llvm::Function* existing = module.getFunction("neoluma.array.outOfRange")) return existing;
+
+    llvm::Function* function = create("neoluma.array.outOfRange", llvm::Type::getVoidTy(context), {llvm::Type::getInt64Ty(context), llvm::Type::getInt64Ty(context)});
+    function->addFnAttr(llvm::Attribute::NoReturn);
+    function->addFnAttr(llvm::Attribute::Cold);
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    body.CreateCall(libc("fflush", body.getInt32Ty(), {bytePointer()}), {llvm::Constant::getNullValue(bytePointer())}); // what the program printed comes first
+    llvm::Value* message = globalString(body, "index %lld is out of range for a length of %lld\n", "neoluma.array.message", &module);
+    body.CreateCall(libc("fprintf", body.getInt32Ty(), {bytePointer(), bytePointer()}, true), {errorStream(body), message, function->getArg(0), function->getArg(1)});
+    body.CreateCall(libc("abort", body.getVoidTy(), {}));
+    body.CreateUnreachable();
+    return function;
+}
+
+// ==== Strings ====
+
+// murmur3's finalizer, every bit of the input reaches the 7 bits in the control bytes
+static llvm::Value* mix(llvm::IRBuilderBase& at, llvm::Value* x) {
+    x = at.CreateXor(x, at.CreateLShr(x, 33));
+    x = at.CreateMul(x, at.getInt64(0xff51afd7ed558ccdULL));
+    x = at.CreateXor(x, at.CreateLShr(x, 33));
+    x = at.CreateMul(x, at.getInt64(0xc4ceb9fe1a85ec53ULL));
+    return at.CreateXor(x, at.CreateLShr(x, 33));
+}
+
+llvm::Function* Collections::stringHash() {
+    if (llvm::Function* existing = module.getFunction("neoluma.str.hash")) return existing;
+
+    // FNV-1a over the bytes
+    llvm::Function* function = create("neoluma.str.hash", llvm::Type::getInt64Ty(context), {bytePointer()});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "loop", function);
+    llvm::BasicBlock* step = llvm::BasicBlock::Create(context, "step", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    body.CreateBr(loop);
+
+    body.SetInsertPoint(loop);
+    llvm::PHINode* cursor = body.CreatePHI(bytePointer(), 2);
+    llvm::PHINode* hash = body.CreatePHI(body.getInt64Ty(), 2);
+    llvm::Value* character = body.CreateLoad(body.getInt8Ty(), cursor);
+    body.CreateCondBr(body.CreateIsNull(character), done, step);
+
+    body.SetInsertPoint(step);
+    llvm::Value* next = body.CreateMul(body.CreateXor(hash, body.CreateZExt(character, body.getInt64Ty())), body.getInt64(0x100000001b3ULL));
+    llvm::Value* nextCursor = body.CreateConstInBoundsGEP1_64(body.getInt8Ty(), cursor, 1);
+    body.CreateBr(loop);
+
+    cursor->addIncoming(function->getArg(0), entry);
+    cursor->addIncoming(nextCursor, step);
+    hash->addIncoming(body.getInt64(0xcbf29ce484222325ULL), entry);
+    hash->addIncoming(next, step);
+
+    body.SetInsertPoint(done);
+    body.CreateRet(mix(body, hash));
+    return function;
+}
+
+// ==== Hash tables ====
+
+llvm::Value* Collections::hash(llvm::IRBuilderBase& at, llvm::Value* key, const Element& element) {
+    if (element.isString) return at.CreateCall(stringHash(), {key});
+
+    llvm::Type* type = key->getType();
+    if (type->isFloatingPointTy()) {
+        // -0.0 == 0.0, adding 0.0 makes them one bit pattern
+        key = at.CreateFAdd(key, llvm::ConstantFP::get(type, 0.0));
+        key = at.CreateBitCast(key, at.getIntNTy(type->getPrimitiveSizeInBits()));
+    }
+    else if (type->isPointerTy()) key = at.CreatePtrToInt(key, at.getInt64Ty()); // collections are keys by identity
+
+    unsigned width = key->getType()->getIntegerBitWidth();
+    if (width > 64) key = at.CreateXor(at.CreateTrunc(key, at.getInt64Ty()), at.CreateTrunc(at.CreateLShr(key, 64), at.getInt64Ty()));
+    else key = at.CreateZExt(key, at.getInt64Ty());
+    return mix(at, key);
+}
+
+llvm::Value* Collections::equals(llvm::IRBuilderBase& at, llvm::Value* left, llvm::Value* right, const Element& element) {
+    if (element.isString) return at.CreateIsNull(at.CreateCall(libc("strcmp", at.getInt32Ty(), {bytePointer(), bytePointer()}), {left, right}));
+    if (left->getType()->isFloatingPointTy()) return at.CreateFCmpOEQ(left, right);
+    return at.CreateICmpEQ(left, right);
+}
+
+llvm::Value* Collections::group(llvm::IRBuilderBase& at, llvm::Value* control, llvm::Value* start) {
+    llvm::Type* vector = llvm::FixedVectorType::get(at.getInt8Ty(), GroupSize);
+    llvm::Value* address = at.CreatePointerCast(at.CreateInBoundsGEP(at.getInt8Ty(), control, start), pointerTo(vector));
+    return at.CreateAlignedLoad(vector, address, llvm::MaybeAlign(1));
+}
+
+llvm::Value* Collections::mask(llvm::IRBuilderBase& at, llvm::Value* matches) {
+    return at.CreateZExt(at.CreateBitCast(matches, at.getIntNTy(GroupSize)), at.getInt32Ty());
+}
+
+static llvm::Value* splat(llvm::IRBuilderBase& at, llvm::Value* byte) { return at.CreateVectorSplat(GroupSize, byte); }
+
+// Low 7 bits of the hash, what goes into the control byte
+static llvm::Value* controlByte(llvm::IRBuilderBase& at, llvm::Value* hash) { return at.CreateTrunc(at.CreateAnd(hash, at.getInt64(0x7f)), at.getInt8Ty()); }
+
+llvm::Value* Collections::freeSlot(llvm::IRBuilderBase& at, llvm::Value* control, llvm::Value* capacity, llvm::Value* hash) {
+    llvm::Function* function = at.GetInsertBlock()->getParent();
+    llvm::BasicBlock* before = at.GetInsertBlock();
+    llvm::BasicBlock* probe = llvm::BasicBlock::Create(context, "probe", function);
+    llvm::BasicBlock* advance = llvm::BasicBlock::Create(context, "probe.next", function);
+    llvm::BasicBlock* found = llvm::BasicBlock::Create(context, "probe.found", function);
+
+    // groups go in triangular steps, which visits every one of them when there's a power of two
+    llvm::Value* groupMask = at.CreateSub(at.CreateLShr(capacity, 4), at.getInt64(1));
+    llvm::Value* first = at.CreateAnd(at.CreateLShr(hash, 7), groupMask);
+    at.CreateBr(probe);
+
+    at.SetInsertPoint(probe);
+    llvm::PHINode* index = at.CreatePHI(at.getInt64Ty(), 2);
+    llvm::PHINode* step = at.CreatePHI(at.getInt64Ty(), 2);
+    llvm::Value* start = at.CreateShl(index, 4);
+    llvm::Value* free = mask(at, at.CreateICmpSLT(group(at, control, start), llvm::Constant::getNullValue(llvm::FixedVectorType::get(at.getInt8Ty(), GroupSize))));
+    at.CreateCondBr(at.CreateIsNotNull(free), found, advance);
+
+    at.SetInsertPoint(advance);
+    llvm::Value* nextStep = at.CreateAdd(step, at.getInt64(1));
+    llvm::Value* nextIndex = at.CreateAnd(at.CreateAdd(index, nextStep), groupMask);
+    at.CreateBr(probe);
+
+    index->addIncoming(first, before);
+    index->addIncoming(nextIndex, advance);
+    step->addIncoming(at.getInt64(0), before);
+    step->addIncoming(nextStep, advance);
+
+    at.SetInsertPoint(found);
+    return at.CreateAdd(start, at.CreateZExt(at.CreateBinaryIntrinsic(llvm::Intrinsic::cttz, free, at.getTrue()), at.getInt64Ty()));
+}
+
+llvm::Function* Collections::tableNew(llvm::StructType* table) {
+    std::string name = "neoluma." + layouts.at(table).name + ".new";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    const Layout& layout = layouts.at(table);
+    llvm::Function* function = create(name, pointerTo(table), {llvm::Type::getInt64Ty(context)});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* count = function->getArg(0);
+
+    // the power of two that keeps `count` keys under 7/8
+    llvm::Value* wanted = body.CreateAdd(body.CreateAdd(count, body.CreateUDiv(count, body.getInt64(7))), body.getInt64(1));
+    llvm::Value* bits = body.CreateSub(body.getInt64(64), body.CreateBinaryIntrinsic(llvm::Intrinsic::ctlz, body.CreateSub(wanted, body.getInt64(1)), body.getFalse()));
+    llvm::Value* capacity = body.CreateBinaryIntrinsic(llvm::Intrinsic::umax, body.CreateShl(body.getInt64(1), bits), body.getInt64(MinimumCapacity));
+
+    llvm::Value* header = allocateHeader(body, table);
+    llvm::Value* frame = nullptr;
+    if (collector) {
+        // no slots and no buffers till they're all there, each of them may take a collection
+        body.CreateStore(body.getInt64(0), field(body, table, header, Slots));
+        for (unsigned buffer : {Control, Keys, Values}) {
+            if (buffer < table->getNumElements()) body.CreateStore(llvm::Constant::getNullValue(table->getElementType(buffer)), field(body, table, header, buffer));
+        }
+        frame = collector->pushFrame(body, 1);
+        collector->setRoot(body, frame, 0, header);
+    }
+    llvm::Value* control = allocate(body, capacity, body.getInt8Ty());
+    body.CreateMemSet(control, body.getInt8(Empty), capacity, llvm::MaybeAlign(1));
+    body.CreateStore(body.getInt64(0), field(body, table, header, Size));
+    body.CreateStore(body.CreateSub(capacity, body.CreateLShr(capacity, 3)), field(body, table, header, GrowthLeft));
+    body.CreateStore(control, field(body, table, header, Control));
+    body.CreateStore(allocate(body, capacity, layout.key.type), field(body, table, header, Keys));
+    if (layout.value) {
+        // what `set` replaces is dropped, in a slot that held nothing yet it's null
+        llvm::Value* values = allocate(body, capacity, layout.value->type);
+        if (isCounted(*layout.value) || isTraced(*layout.value)) body.CreateMemSet(values, body.getInt8(0), body.CreateMul(capacity, body.getInt64(module.getDataLayout().getTypeAllocSize(layout.value->type))), llvm::MaybeAlign(8));
+        body.CreateStore(values, field(body, table, header, Values));
+    }
+    body.CreateStore(capacity, field(body, table, header, Slots));
+    if (frame) collector->popFrame(body, frame);
+    body.CreateRet(header);
+    return function;
+}
+
+llvm::Function* Collections::tableLookup(llvm::StructType* table) {
+    std::string name = "neoluma." + layouts.at(table).name + ".lookup";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    const Element& key = layouts.at(table).key;
+    llvm::Function* function = create(name, llvm::Type::getInt64Ty(context), {pointerTo(table), key.type, llvm::Type::getInt64Ty(context)});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* probe = llvm::BasicBlock::Create(context, "probe", function);
+    llvm::BasicBlock* candidate = llvm::BasicBlock::Create(context, "candidate", function);
+    llvm::BasicBlock* compare = llvm::BasicBlock::Create(context, "compare", function);
+    llvm::BasicBlock* found = llvm::BasicBlock::Create(context, "found", function);
+    llvm::BasicBlock* next = llvm::BasicBlock::Create(context, "candidate.next", function);
+    llvm::BasicBlock* exhausted = llvm::BasicBlock::Create(context, "exhausted", function);
+    llvm::BasicBlock* missing = llvm::BasicBlock::Create(context, "missing", function);
+    llvm::BasicBlock* advance = llvm::BasicBlock::Create(context, "probe.next", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* header = function->getArg(0);
+    llvm::Value* wanted = function->getArg(1);
+    llvm::Value* hash = function->getArg(2);
+
+    llvm::Value* control = load(body, table, header, Control);
+    llvm::Value* keys = load(body, table, header, Keys);
+    llvm::Value* groupMask = body.CreateSub(body.CreateLShr(load(body, table, header, Slots), 4), body.getInt64(1));
+    llvm::Value* first = body.CreateAnd(body.CreateLShr(hash, 7), groupMask);
+    llvm::Value* bits = splat(body, controlByte(body, hash));
+    llvm::Value* empty = splat(body, body.getInt8(Empty));
+    body.CreateBr(probe);
+
+    // the control bytes of a group that match the 7 bits are the only keys to compare
+    body.SetInsertPoint(probe);
+    llvm::PHINode* index = body.CreatePHI(body.getInt64Ty(), 2);
+    llvm::PHINode* step = body.CreatePHI(body.getInt64Ty(), 2);
+    llvm::Value* start = body.CreateShl(index, 4);
+    llvm::Value* bytes = group(body, control, start);
+    llvm::Value* matches = mask(body, body.CreateICmpEQ(bytes, bits));
+    body.CreateBr(candidate);
+
+    body.SetInsertPoint(candidate);
+    llvm::PHINode* remaining = body.CreatePHI(body.getInt32Ty(), 2);
+    body.CreateCondBr(body.CreateIsNull(remaining), exhausted, compare);
+
+    body.SetInsertPoint(compare);
+    llvm::Value* slot = body.CreateAdd(start, body.CreateZExt(body.CreateBinaryIntrinsic(llvm::Intrinsic::cttz, remaining, body.getTrue()), body.getInt64Ty()));
+    llvm::Value* candidateKey = body.CreateLoad(key.type, body.CreateInBoundsGEP(key.type, keys, slot));
+    body.CreateCondBr(equals(body, candidateKey, wanted, key), found, next, llvm::MDBuilder(context).createBranchWeights(1000, 1));
+
+    body.SetInsertPoint(found);
+    body.CreateRet(slot);
+
+    body.SetInsertPoint(next);
+    llvm::Value* rest = body.CreateAnd(remaining, body.CreateSub(remaining, body.getInt32(1)));
+    body.CreateBr(candidate);
+    remaining->addIncoming(matches, probe);
+    remaining->addIncoming(rest, next);
+
+    // a group with an empty slot was never full, no key went past it
+    body.SetInsertPoint(exhausted);
+    body.CreateCondBr(body.CreateIsNotNull(mask(body, body.CreateICmpEQ(bytes, empty))), missing, advance, llvm::MDBuilder(context).createBranchWeights(1000, 1));
+
+    body.SetInsertPoint(missing);
+    body.CreateRet(body.getInt64(-1));
+
+    body.SetInsertPoint(advance);
+    llvm::Value* nextStep = body.CreateAdd(step, body.getInt64(1));
+    llvm::Value* nextIndex = body.CreateAnd(body.CreateAdd(index, nextStep), groupMask);
+    body.CreateBr(probe);
+    index->addIncoming(first, entry);
+    index->addIncoming(nextIndex, advance);
+    step->addIncoming(body.getInt64(0), entry);
+    step->addIncoming(nextStep, advance);
+    return function;
+}
+
+llvm::Function* Collections::tableFind(llvm::StructType* table) {
+    std::string name = "neoluma." + layouts.at(table).name + ".find";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    const Element& key = layouts.at(table).key;
+    llvm::Function* function = create(name, llvm::Type::getInt64Ty(context), {pointerTo(table), key.type});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* hashed = hash(body, function->getArg(1), key);
+    body.CreateRet(body.CreateCall(tableLookup(table), {function->getArg(0), function->getArg(1), hashed}));
+    return function;
+}
+
+llvm::Function* Collections::tableInsert(llvm::StructType* table) {
+    std::string name = "neoluma." + layouts.at(table).name + ".insert";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    const Element& key = layouts.at(table).key;
+    llvm::Function* function = create(name, llvm::Type::getInt64Ty(context), {pointerTo(table), key.type});
+    if (counter) counter->dropsReferences(function, false);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* existing = llvm::BasicBlock::Create(context, "existing", function);
+    llvm::BasicBlock* absent = llvm::BasicBlock::Create(context, "absent", function);
+    llvm::BasicBlock* rehash = llvm::BasicBlock::Create(context, "rehash", function);
+    llvm::BasicBlock* place = llvm::BasicBlock::Create(context, "place", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* header = function->getArg(0);
+    llvm::Value* added = function->getArg(1);
+
+    llvm::Value* hashed = hash(body, added, key);
+    llvm::Value* slot = body.CreateCall(tableLookup(table), {header, added, hashed});
+    body.CreateCondBr(body.CreateICmpSGE(slot, body.getInt64(0)), existing, absent);
+
+    // the key stays the one in the table, the reference handed over with this one goes back
+    body.SetInsertPoint(existing);
+    if (isCounted(key)) releaseElement(body, added, key);
+    body.CreateRet(slot);
+
+    // taking an empty slot is what uses the growth up, a deleted one is free
+    body.SetInsertPoint(absent);
+    body.CreateCondBr(body.CreateIsNull(load(body, table, header, GrowthLeft)), rehash, place, llvm::MDBuilder(context).createBranchWeights(1, 1000));
+
+    body.SetInsertPoint(rehash);
+    body.CreateCall(tableRehash(table), {header});
+    body.CreateBr(place);
+
+    body.SetInsertPoint(place);
+    llvm::Value* control = load(body, table, header, Control);
+    llvm::Value* free = freeSlot(body, control, load(body, table, header, Slots), hashed);
+    llvm::Value* controlSlot = body.CreateInBoundsGEP(body.getInt8Ty(), control, free);
+    llvm::Value* wasEmpty = body.CreateICmpEQ(body.CreateLoad(body.getInt8Ty(), controlSlot), body.getInt8(Empty));
+    body.CreateStore(controlByte(body, hashed), controlSlot);
+    body.CreateStore(stored(body, added, key, header), this->key(body, table, header, free));
+    body.CreateStore(body.CreateAdd(load(body, table, header, Size), body.getInt64(1)), field(body, table, header, Size));
+    body.CreateStore(body.CreateSub(load(body, table, header, GrowthLeft), body.CreateZExt(wasEmpty, body.getInt64Ty())), field(body, table, header, GrowthLeft));
+    body.CreateRet(free);
+    return function;
+}
+
+llvm::Function* Collections::tableRehash(llvm::StructType* table) {
+    std::string name = "neoluma." + layouts.at(table).name + ".rehash";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    const Layout& layout = layouts.at(table);
+    llvm::Function* function = create(name, llvm::Type::getVoidTy(context), {pointerTo(table)});
+    function->addFnAttr(llvm::Attribute::NoInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "loop", function);
+    llvm::BasicBlock* check = llvm::BasicBlock::Create(context, "check", function);
+    llvm::BasicBlock* move = llvm::BasicBlock::Create(context, "move", function);
+    llvm::BasicBlock* next = llvm::BasicBlock::Create(context, "next", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* header = function->getArg(0);
+    llvm::FunctionCallee free = libc("free", body.getVoidTy(), {bytePointer()});
+
+    // twice the size if the keys took half of the growth, the same size if deleted slots did
+    llvm::Value* size = load(body, table, header, Size);
+    llvm::Value* capacity = load(body, table, header, Slots);
+    llvm::Value* control = load(body, table, header, Control);
+    llvm::Value* keys = load(body, table, header, Keys);
+    llvm::Value* values = layout.value ? load(body, table, header, Values) : nullptr;
+    llvm::Value* crowded = body.CreateICmpUGE(body.CreateMul(size, body.getInt64(16)), body.CreateMul(capacity, body.getInt64(7)));
+    llvm::Value* newCapacity = body.CreateSelect(crowded, body.CreateShl(capacity, 1), capacity);
+    // the old buffers are reached through the table till it's switched over, the new ones through a frame
+    llvm::Value* frame = collector ? collector->pushFrame(body, 2) : nullptr;
+    llvm::Value* newControl = allocate(body, newCapacity, body.getInt8Ty());
+    body.CreateMemSet(newControl, body.getInt8(Empty), newCapacity, llvm::MaybeAlign(1));
+    if (frame) collector->setRoot(body, frame, 0, newControl);
+    llvm::Value* newKeys = allocate(body, newCapacity, layout.key.type);
+    if (frame) collector->setRoot(body, frame, 1, newKeys);
+    llvm::Value* newValues = layout.value ? allocate(body, newCapacity, layout.value->type) : nullptr;
+    if (frame) collector->popFrame(body, frame);
+    if (layout.value && (isCounted(*layout.value) || isTraced(*layout.value)))
+        body.CreateMemSet(newValues, body.getInt8(0), body.CreateMul(newCapacity, body.getInt64(module.getDataLayout().getTypeAllocSize(layout.value->type))), llvm::MaybeAlign(8));
+    body.CreateBr(loop);
+
+    body.SetInsertPoint(loop);
+    llvm::PHINode* slot = body.CreatePHI(body.getInt64Ty(), 2);
+    body.CreateCondBr(body.CreateICmpULT(slot, capacity), check, done);
+
+    body.SetInsertPoint(check);
+    llvm::Value* full = body.CreateICmpSGE(body.CreateLoad(body.getInt8Ty(), body.CreateInBoundsGEP(body.getInt8Ty(), control, slot)), body.getInt8(0));
+    body.CreateCondBr(full, move, next);
+
+    // the new table has no deleted slots and every key in it is different, the first free slot is the one
+    body.SetInsertPoint(move);
+    llvm::Value* key = body.CreateLoad(layout.key.type, body.CreateInBoundsGEP(layout.key.type, keys, slot));
+    llvm::Value* hashed = hash(body, key, layout.key);
+    llvm::Value* target = freeSlot(body, newControl, newCapacity, hashed);
+    body.CreateStore(controlByte(body, hashed), body.CreateInBoundsGEP(body.getInt8Ty(), newControl, target));
+    body.CreateStore(key, body.CreateInBoundsGEP(layout.key.type, newKeys, target));
+    if (layout.value) {
+        llvm::Type* valueType = layout.value->type;
+        body.CreateStore(body.CreateLoad(valueType, body.CreateInBoundsGEP(valueType, values, slot)), body.CreateInBoundsGEP(valueType, newValues, target));
+    }
+    body.CreateBr(next);
+
+    body.SetInsertPoint(next);
+    llvm::Value* nextSlot = body.CreateAdd(slot, body.getInt64(1));
+    body.CreateBr(loop);
+    slot->addIncoming(body.getInt64(0), entry);
+    slot->addIncoming(nextSlot, next);
+
+    body.SetInsertPoint(done);
+    if (!collector) {
+        body.CreateCall(free, {control});
+        body.CreateCall(free, {body.CreatePointerCast(keys, bytePointer())});
+        if (layout.value) body.CreateCall(free, {body.CreatePointerCast(values, bytePointer())});
+    }
+    body.CreateStore(newCapacity, field(body, table, header, Slots));
+    body.CreateStore(body.CreateSub(body.CreateSub(newCapacity, body.CreateLShr(newCapacity, 3)), size), field(body, table, header, GrowthLeft));
+    body.CreateStore(newControl, field(body, table, header, Control));
+    body.CreateStore(newKeys, field(body, table, header, Keys));
+    if (layout.value) body.CreateStore(newValues, field(body, table, header, Values));
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Collections::tableRemove(llvm::StructType* table) {
+    std::string name = "neoluma." + layouts.at(table).name + ".remove";
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    const Element& key = layouts.at(table).key;
+    llvm::Function* function = create(name, llvm::Type::getVoidTy(context), {pointerTo(table), key.type});
+    if (counter) counter->dropsReferences(function, false);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* erase = llvm::BasicBlock::Create(context, "erase", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* header = function->getArg(0);
+
+    llvm::Value* slot = body.CreateCall(tableLookup(table), {header, function->getArg(1), hash(body, function->getArg(1), key)});
+    body.CreateCondBr(body.CreateICmpSLT(slot, body.getInt64(0)), done, erase);
+
+    // no probe goes past a group with an empty slot, so the slot can be empty again there and its growth comes back
+    body.SetInsertPoint(erase);
+    llvm::Value* control = load(body, table, header, Control);
+    llvm::Value* bytes = group(body, control, body.CreateAnd(slot, body.getInt64(~(GroupSize - 1))));
+    llvm::Value* hasEmpty = body.CreateIsNotNull(mask(body, body.CreateICmpEQ(bytes, splat(body, body.getInt8(Empty)))));
+    body.CreateStore(body.CreateSelect(hasEmpty, body.getInt8(Empty), body.getInt8(Deleted)), body.CreateInBoundsGEP(body.getInt8Ty(), control, slot));
+    body.CreateStore(body.CreateSub(load(body, table, header, Size), body.getInt64(1)), field(body, table, header, Size));
+    body.CreateStore(body.CreateAdd(load(body, table, header, GrowthLeft), body.CreateZExt(hasEmpty, body.getInt64Ty())), field(body, table, header, GrowthLeft));
+    if (isCounted(key)) releaseElement(body, body.CreateLoad(key.type, this->key(body, table, header, slot)), key);
+    const std::optional<Element>& removed = layouts.at(table).value;
+    if (removed && isCounted(*removed)) {
+        llvm::Value* address = value(body, table, header, slot);
+        llvm::Value* held = body.CreateLoad(removed->type, address);
+        body.CreateStore(llvm::Constant::getNullValue(removed->type), address);
+        releaseElement(body, held, *removed);
+    }
+    body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Value* Collections::capacity(llvm::IRBuilderBase& at, llvm::StructType* table, llvm::Value* collection) { return load(at, table, collection, Slots); }
+
+llvm::Value* Collections::isFull(llvm::IRBuilderBase& at, llvm::StructType* table, llvm::Value* collection, llvm::Value* slot) {
+    llvm::Value* control = at.CreateInBoundsGEP(at.getInt8Ty(), load(at, table, collection, Control), slot);
+    return at.CreateICmpSGE(at.CreateLoad(at.getInt8Ty(), control), at.getInt8(0));
+}
+
+llvm::Value* Collections::key(llvm::IRBuilderBase& at, llvm::StructType* table, llvm::Value* collection, llvm::Value* slot) {
+    return at.CreateInBoundsGEP(layouts.at(table).key.type, load(at, table, collection, Keys), slot);
+}
+
+llvm::Value* Collections::value(llvm::IRBuilderBase& at, llvm::StructType* table, llvm::Value* collection, llvm::Value* slot) {
+    return at.CreateInBoundsGEP(layouts.at(table).value->type, load(at, table, collection, Values), slot);
+}
+
+llvm::Function* Collections::missingKey() {
+    if (llvm::Function* existing = module.getFunction("neoluma.dict.missingKey")) return existing;
+
+    llvm::Function* function = create("neoluma.dict.missingKey", llvm::Type::getVoidTy(context), {});
+    function->addFnAttr(llvm::Attribute::NoReturn);
+    function->addFnAttr(llvm::Attribute::Cold);
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    body.CreateCall(libc("fflush", body.getInt32Ty(), {bytePointer()}), {llvm::Constant::getNullValue(bytePointer())});
+    llvm::Value* message = globalString(body, "key not found in the dict\n", "neoluma.dict.message", &module);
+    body.CreateCall(libc("fputs", body.getInt32Ty(), {bytePointer(), bytePointer()}), {message, errorStream(body)});
+    body.CreateCall(libc("abort", body.getVoidTy(), {}));
+    body.CreateUnreachable();
+    return function;
+}
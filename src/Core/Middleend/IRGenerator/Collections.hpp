@@ -0,0 +1,120 @@
+#pragma once
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// LLVM Primitives
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+
+#include "GarbageCollector.hpp"
+#include "ReferenceCounter.hpp"
+
+/* Collections is the runtime of arrays, sets and dicts. Like the other runtime pieces it's emitted into the modules that
+ * use it with linkonce_odr linkage, and every piece of it is specialized to the element types of one collection type:
+ * the Frontend already proved every element of a collection has its element type, so nothing is ever boxed.
+ *
+ * An array is [length, capacity, data], the data a contiguous buffer of the elements, so `int[]` is one of i32s.
+ * It doubles when it's full.
+ *
+ * Sets and dicts are open-addressing hash tables laid out like SwissTable: a control byte for every slot, either empty,
+ * deleted or the low 7 bits of the hash of the key in it, and the keys, and the values of a dict, in arrays of their
+ * own. The rest of the hash picks the group of 16 slots a lookup starts from. It compares all 16 control bytes of the
+ * group with the 7 bits at once, one vector compare (SSE2 or NEON), looks only at the keys that matched, and stops at
+ * the first group with an empty slot in it. Tables grow at 7/8 full.
+ *
+ * With `collector` (the default memory mode) a collection and its buffers are on the collector's heap. The collection is
+ * traced: its last 8 bytes point to a function of its runtime marking its buffers, and the strings, collections and
+ * limbs of numbers in them. A runtime function that allocates while what it's building is only in registers roots it in a frame of its
+ * own. Without a collector or ARC collections are malloc'd and never freed.
+ *
+ * With `counter` (ARC) a collection is an object of the Reference Counter and holds a reference to every string and
+ * collection in it. Whatever goes in through `push`, `set` or `insert` is handed over with its reference, a key that
+ * was there already gives it back. `release` frees what the last reference held, and a collection shared with other
+ * threads shares what's in it.
+ */
+struct Collections {
+    // What a collection holds
+    struct Element {
+        llvm::Type* type;
+        bool isString = false; // compared and hashed by the characters
+        llvm::StructType* collection = nullptr; // the layout of a collection in a collection
+        bool isNumber = false; // holds its limbs, if it has any
+    };
+
+    // `errorStream` emits the FILE* of stderr where a builder is, out of range indices are reported there
+    Collections(llvm::Module& module, GarbageCollector* collector, ReferenceCounter* counter, std::function<llvm::Value*(llvm::IRBuilderBase&)> errorStream)
+        : module(module), context(module.getContext()), collector(collector), counter(counter), errorStream(std::move(errorStream)) {}
+
+    // Layouts, values of collection types are pointers to them. `name` is the type in the language, every name gets its own runtime.
+    llvm::StructType* arrayType(const std::string& name, const Element& element); // {i64 length, i64 capacity, T* data}
+    llvm::StructType* tableType(const std::string& name, const Element& key, const std::optional<Element>& value); // {i64 size, i64 capacity, i64 growth left, i8* control, K* keys, V* values}, a set has no values
+
+    llvm::Value* length(llvm::IRBuilderBase& at, llvm::Value* collection); // i64, of any of them
+    // `value` as it goes into `collection`: shared if the collection is
+    llvm::Value* stored(llvm::IRBuilderBase& at, llvm::Value* value, const Element& element, llvm::Value* collection = nullptr);
+    llvm::Function* release(llvm::StructType* layout); // void (C*): drops a reference, the last one frees it and drops what it holds
+    llvm::Function* share(llvm::StructType* layout); // void (C*): it and everything in it are counted atomically from now on
+
+    // Arrays
+    llvm::Function* arrayNew(llvm::StructType* array); // A* (i64 length), the elements aren't initialized, but for null when they're traced
+    llvm::Function* arrayPush(llvm::StructType* array); // void (A*, T)
+    llvm::Function* arrayGet(llvm::StructType* array); // T (A*, i64), an index out of range stops the program
+    llvm::Function* arraySet(llvm::StructType* array); // void (A*, i64, T), the same
+    llvm::Value* element(llvm::IRBuilderBase& at, llvm::StructType* array, llvm::Value* collection, llvm::Value* index); // T*, unchecked
+
+    // Sets and dicts
+    llvm::Function* tableNew(llvm::StructType* table); // Tb* (i64 count): room for `count` keys before it grows
+    llvm::Function* tableFind(llvm::StructType* table); // i64 (Tb*, K): the slot of the key, -1 if it isn't there
+    llvm::Function* tableInsert(llvm::StructType* table); // i64 (Tb*, K): the slot of the key, added first if it wasn't there
+    llvm::Function* tableRemove(llvm::StructType* table); // void (Tb*, K), the key is only compared
+    llvm::Value* capacity(llvm::IRBuilderBase& at, llvm::StructType* table, llvm::Value* collection); // i64, slots are below it
+    llvm::Value* isFull(llvm::IRBuilderBase& at, llvm::StructType* table, llvm::Value* collection, llvm::Value* slot); // i1, the slot holds a key
+    llvm::Value* key(llvm::IRBuilderBase& at, llvm::StructType* table, llvm::Value* collection, llvm::Value* slot); // K*
+    llvm::Value* value(llvm::IRBuilderBase& at, llvm::StructType* table, llvm::Value* collection, llvm::Value* slot); // V*, dicts only
+    llvm::Function* missingKey(); // void (), doesn't return: `get` of a key the dict doesn't have
+
+private:
+    struct Layout {
+        std::string name;
+        Element key; // the element of an array
+        std::optional<Element> value;
+    };
+
+    llvm::Module& module;
+    llvm::LLVMContext& context;
+    GarbageCollector* collector;
+    ReferenceCounter* counter;
+    std::function<llvm::Value*(llvm::IRBuilderBase&)> errorStream;
+    std::unordered_map<llvm::StructType*, Layout> layouts;
+
+    llvm::Type* bytePointer();
+    llvm::Type* sizeType(); // of the C library
+    llvm::Value* field(llvm::IRBuilderBase& at, llvm::StructType* type, llvm::Value* collection, unsigned index);
+    llvm::Value* load(llvm::IRBuilderBase& at, llvm::StructType* type, llvm::Value* collection, unsigned index);
+    llvm::Value* allocate(llvm::IRBuilderBase& at, llvm::Value* count, llvm::Type* type); // T* of `count` of them, from malloc or the collector
+    llvm::Value* allocateHeader(llvm::IRBuilderBase& at, llvm::StructType* layout); // counted with ARC, traced with the collector
+    bool isCounted(const Element& element) const { return counter && (element.isString || element.collection || element.isNumber); }
+    bool isTraced(const Element& element) const { return collector && (element.isString || element.collection || element.isNumber); }
+    llvm::Value* object(llvm::IRBuilderBase& at, llvm::Value* value, const Element& element); // i8*: what a counted or traced element holds
+    void releaseElement(llvm::IRBuilderBase& at, llvm::Value* value, const Element& element);
+    void shareElement(llvm::IRBuilderBase& at, llvm::Value* value, const Element& element);
+    llvm::Function* create(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters);
+    llvm::FunctionCallee libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters, bool variadic = false);
+
+    llvm::Function* arrayGrow(llvm::StructType* array); // void (A*): twice the capacity
+    llvm::Function* outOfRange(); // void (i64 index, i64 length), doesn't return
+    llvm::Function* trace(llvm::StructType* layout); // void (i8*): marks the buffers of a collection and what's in them
+    llvm::Function* stringHash(); // i64 (i8*)
+
+    llvm::Value* hash(llvm::IRBuilderBase& at, llvm::Value* key, const Element& element); // i64
+    llvm::Value* equals(llvm::IRBuilderBase& at, llvm::Value* left, llvm::Value* right, const Element& element); // i1
+    llvm::Value* group(llvm::IRBuilderBase& at, llvm::Value* control, llvm::Value* start); // <16 x i8> from `start`
+    llvm::Value* mask(llvm::IRBuilderBase& at, llvm::Value* matches); // i32 of a bit per slot of a <16 x i1>
+    llvm::Function* tableLookup(llvm::StructType* table); // i64 (Tb*, K, i64 hash)
+    llvm::Function* tableRehash(llvm::StructType* table); // void (Tb*): bigger, or the same size without the deleted slots
+    // Probes `control` for the first slot that's empty or deleted, where a key of `hash` goes. Leaves `at` after the probe.
+    llvm::Value* freeSlot(llvm::IRBuilderBase& at, llvm::Value* control, llvm::Value* capacity, llvm::Value* hash);
+};
@@ -0,0 +1,1377 @@
+#include "Decimals.hpp"
+
+// LLVM Primitives
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
+
+#include "Pointers.hpp"
+
+static constexpr uint64_t LimbBase = 1000000000, LimbDigits = 9;
+static constexpr uint64_t KaratsubaThreshold = 32; // limbs, below it schoolbook multiplies faster
+static constexpr int64_t QuotientDigits = 34; // of a quotient that isn't exact, the precision of a decimal128
+
+enum NumberField : unsigned { Coefficient, Exponent, Length };
+
+// ==== Helpers ====
+
+llvm::StructType* Decimals::numberType(llvm::LLVMContext& context) {
+    if (llvm::StructType* type = llvm::StructType::getTypeByName(context, "neoluma.number")) return type;
+    llvm::Type* int32 = llvm::Type::getInt32Ty(context);
+    return llvm::StructType::create(context, {llvm::Type::getInt64Ty(context), int32, int32}, "neoluma.number");
+}
+
+llvm::Value* Decimals::limbs(llvm::IRBuilderBase& at, llvm::Value* number) {
+    llvm::Type* bytePointer = pointerTo(at.getInt8Ty());
+    llvm::Value* limbs = at.CreateIntToPtr(at.CreateExtractValue(number, Coefficient), bytePointer);
+    return at.CreateSelect(at.CreateIsNull(at.CreateExtractValue(number, Length)), llvm::Constant::getNullValue(bytePointer), limbs);
+}
+
+llvm::Type* Decimals::bytePointer() { return pointerTo(llvm::Type::getInt8Ty(context)); }
+
+llvm::Type* Decimals::limbPointer() { return pointerTo(llvm::Type::getInt32Ty(context)); }
+
+llvm::Type* Decimals::sizeType() { return module.getDataLayout().getIntPtrType(context); }
+
+llvm::Function* Decimals::create(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters) {
+    return llvm::Function::Create(llvm::FunctionType::get(result, parameters, false), llvm::GlobalValue::LinkOnceODRLinkage, name, module);
+}
+
+llvm::FunctionCallee Decimals::libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters, bool variadic) {
+    return module.getOrInsertFunction(name, llvm::FunctionType::get(result, parameters, variadic));
+}
+
+llvm::Function* Decimals::failure(const std::string& name, const std::string& message) {
+    if (llvm::Function* existing = module.getFunction(name)) return existing;
+
+    llvm::Function* function = create(name, llvm::Type::getVoidTy(context), {});
+    function->addFnAttr(llvm::Attribute::NoReturn);
+    function->addFnAttr(llvm::Attribute::Cold);
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    body.CreateCall(libc("fflush", body.getInt32Ty(), {bytePointer()}), {llvm::Constant::getNullValue(bytePointer())}); // what the program printed comes first
+    llvm::Value* text = globalString(body, message + "\n", name + ".message", &module);
+    body.CreateCall(libc("fputs", body.getInt32Ty(), {bytePointer(), bytePointer()}), {text, errorStream(body)});
+    body.CreateCall(libc("abort", body.getVoidTy(), {}));
+    body.CreateUnreachable();
+    return function;
+}
+
+llvm::Value* Decimals::number(llvm::IRBuilderBase& at, llvm::Value* coefficient, llvm::Value* exponent, llvm::Value* length) {
+    llvm::Value* value = llvm::UndefValue::get(numberType(context));
+    value = at.CreateInsertValue(value, coefficient, Coefficient);
+    value = at.CreateInsertValue(value, exponent, Exponent);
+    return at.CreateInsertValue(value, length, Length);
+}
+
+llvm::Value* Decimals::isNegative(llvm::IRBuilderBase& at, llvm::Value* number) {
+    llvm::Value* length = at.CreateExtractValue(number, Length);
+    llvm::Value* coefficient = at.CreateExtractValue(number, Coefficient);
+    return at.CreateSelect(at.CreateIsNull(length), at.CreateICmpSLT(coefficient, at.getInt64(0)), at.CreateICmpSLT(length, at.getInt32(0)));
+}
+
+llvm::Value* Decimals::power(llvm::IRBuilderBase& at, llvm::Value* exponent) {
+    llvm::Type* int64 = at.getInt64Ty();
+    llvm::ArrayType* type = llvm::ArrayType::get(int64, 19);
+    llvm::GlobalVariable* table = module.getNamedGlobal("neoluma.number.powers");
+    if (!table) {
+        std::vector<uint64_t> powers(1, 1);
+        while (powers.size() < 19) powers.push_back(powers.back() * 10);
+        table = new llvm::GlobalVariable(module, type, true, llvm::GlobalValue::LinkOnceODRLinkage, llvm::ConstantDataArray::get(context, powers), "neoluma.number.powers");
+    }
+    return at.CreateLoad(int64, at.CreateInBoundsGEP(type, table, {at.getInt64(0), at.CreateZExtOrTrunc(exponent, int64)}));
+}
+
+llvm::Value* Decimals::limb(llvm::IRBuilderBase& at, llvm::Value* limbs, llvm::Value* index) {
+    return at.CreateInBoundsGEP(at.getInt32Ty(), limbs, index);
+}
+
+llvm::Value* Decimals::allocateLimbs(llvm::IRBuilderBase& at, llvm::Value* count) {
+    llvm::Value* bytes = at.CreateZExtOrTrunc(at.CreateMul(count, at.getInt64(4)), sizeType());
+    return at.CreatePointerCast(at.CreateCall(libc("malloc", bytePointer(), {sizeType()}), {bytes}), limbPointer());
+}
+
+llvm::Value* Decimals::resultLimbs(llvm::IRBuilderBase& at, llvm::Value* count) {
+    llvm::Value* bytes = at.CreateMul(count, at.getInt64(4));
+    if (collector) return at.CreatePointerCast(at.CreateCall(collector->allocate(), {bytes}), limbPointer());
+    if (counter) return at.CreatePointerCast(at.CreateCall(counter->allocate(), {bytes}), limbPointer());
+    return allocateLimbs(at, count);
+}
+
+void Decimals::freeLimbs(llvm::IRBuilderBase& at, llvm::Value* limbs) {
+    at.CreateCall(libc("free", at.getVoidTy(), {bytePointer()}), {at.CreatePointerCast(limbs, bytePointer())});
+}
+
+llvm::Value* Decimals::digitCount(llvm::IRBuilderBase& at, llvm::Value* limb) {
+    llvm::Value* count = at.getInt64(1);
+    for (uint64_t power = 10; power < LimbBase; power *= 10) count = at.CreateAdd(count, at.CreateZExt(at.CreateICmpUGE(limb, at.getInt32(power)), at.getInt64Ty()));
+    return count;
+}
+
+llvm::Value* Decimals::digitCount(llvm::IRBuilderBase& at, llvm::Value* limbs, llvm::Value* count) {
+    llvm::Value* top = at.CreateSub(count, at.getInt64(1));
+    return at.CreateAdd(at.CreateMul(top, at.getInt64(LimbDigits)), digitCount(at, at.CreateLoad(at.getInt32Ty(), limb(at, limbs, top))));
+}
+
+llvm::Value* Decimals::trim(llvm::IRBuilderBase& at, llvm::Value* limbs, llvm::Value* count) {
+    // limbs always have room for one, so reading the first when there are none is fine
+    llvm::AllocaInst* trimmed = variable(at, at.getInt64Ty(), count);
+    loop(at, [&] {
+        llvm::Value* current = at.CreateLoad(at.getInt64Ty(), trimmed);
+        llvm::Value* any = at.CreateICmpUGT(current, at.getInt64(0));
+        llvm::Value* top = at.CreateSelect(any, at.CreateSub(current, at.getInt64(1)), at.getInt64(0));
+        return at.CreateAnd(any, at.CreateIsNull(at.CreateLoad(at.getInt32Ty(), limb(at, limbs, top))));
+    }, [&] {
+        at.CreateStore(at.CreateSub(at.CreateLoad(at.getInt64Ty(), trimmed), at.getInt64(1)), trimmed);
+    });
+    return at.CreateLoad(at.getInt64Ty(), trimmed);
+}
+
+llvm::Value* Decimals::inlineLimbs(llvm::IRBuilderBase& at, llvm::Value* coefficient) {
+    llvm::ArrayType* type = llvm::ArrayType::get(at.getInt32Ty(), 3);
+    llvm::Value* limbs = at.CreateConstInBoundsGEP2_32(type, variable(at, type, nullptr), 0, 0);
+    // unsigned, so the magnitude of the smallest coefficient is right too
+    llvm::Value* magnitude = at.CreateSelect(at.CreateICmpSLT(coefficient, at.getInt64(0)), at.CreateNeg(coefficient), coefficient);
+    for (uint64_t i = 0; i < 3; i++) {
+        at.CreateStore(at.CreateTrunc(at.CreateURem(magnitude, at.getInt64(LimbBase)), at.getInt32Ty()), limb(at, limbs, at.getInt64(i)));
+        magnitude = at.CreateUDiv(magnitude, at.getInt64(LimbBase));
+    }
+    return limbs;
+}
+
+llvm::AllocaInst* Decimals::variable(llvm::IRBuilderBase& at, llvm::Type* type, llvm::Value* initial) {
+    llvm::BasicBlock& entry = at.GetInsertBlock()->getParent()->getEntryBlock();
+    llvm::IRBuilder<> start(&entry, entry.begin());
+    llvm::AllocaInst* slot = start.CreateAlloca(type);
+    if (initial) at.CreateStore(initial, slot);
+    return slot;
+}
+
+void Decimals::loop(llvm::IRBuilderBase& at, const std::function<llvm::Value*()>& condition, const std::function<void()>& body) {
+    llvm::Function* function = at.GetInsertBlock()->getParent();
+    llvm::BasicBlock* header = llvm::BasicBlock::Create(context, "loop", function);
+    llvm::BasicBlock* inside = llvm::BasicBlock::Create(context, "loop.body", function);
+    llvm::BasicBlock* after = llvm::BasicBlock::Create(context, "loop.end", function);
+    at.CreateBr(header);
+
+    at.SetInsertPoint(header);
+    at.CreateCondBr(condition(), inside, after);
+    at.SetInsertPoint(inside);
+    body();
+    at.CreateBr(header);
+    at.SetInsertPoint(after);
+}
+
+void Decimals::loop(llvm::IRBuilderBase& at, llvm::Value* begin, llvm::Value* end, const std::function<void(llvm::Value*)>& body) {
+    llvm::AllocaInst* index = variable(at, at.getInt64Ty(), begin);
+    loop(at, [&] { return at.CreateICmpSLT(at.CreateLoad(at.getInt64Ty(), index), end); }, [&] {
+        llvm::Value* current = at.CreateLoad(at.getInt64Ty(), index);
+        body(current);
+        at.CreateStore(at.CreateAdd(current, at.getInt64(1)), index);
+    });
+}
+
+void Decimals::align(llvm::IRBuilderBase& at, llvm::Value* left, llvm::Value* right, llvm::BasicBlock* slow,
+    llvm::Value*& leftCoefficient, llvm::Value*& rightCoefficient, llvm::Value*& exponent) {
+    llvm::Function* function = at.GetInsertBlock()->getParent();
+    llvm::BasicBlock* near = llvm::BasicBlock::Create(context, "align", function);
+    llvm::BasicBlock* scale = llvm::BasicBlock::Create(context, "align.scale", function);
+    llvm::BasicBlock* aligned = llvm::BasicBlock::Create(context, "aligned", function);
+    llvm::MDBuilder weights(context);
+
+    llvm::Value* inlined = at.CreateIsNull(at.CreateOr(at.CreateExtractValue(left, Length), at.CreateExtractValue(right, Length)));
+    at.CreateCondBr(inlined, near, slow, weights.createBranchWeights(1000, 1));
+
+    // the one with the bigger exponent is scaled down to the other, by at most 10^18
+    at.SetInsertPoint(near);
+    llvm::Value* leftExponent = at.CreateExtractValue(left, Exponent);
+    llvm::Value* rightExponent = at.CreateExtractValue(right, Exponent);
+    exponent = at.CreateBinaryIntrinsic(llvm::Intrinsic::smin, leftExponent, rightExponent);
+    llvm::Value* leftShift = at.CreateSub(at.CreateSExt(leftExponent, at.getInt64Ty()), at.CreateSExt(exponent, at.getInt64Ty()));
+    llvm::Value* rightShift = at.CreateSub(at.CreateSExt(rightExponent, at.getInt64Ty()), at.CreateSExt(exponent, at.getInt64Ty()));
+    llvm::Value* close = at.CreateAnd(at.CreateICmpULE(leftShift, at.getInt64(18)), at.CreateICmpULE(rightShift, at.getInt64(18)));
+    at.CreateCondBr(close, scale, slow, weights.createBranchWeights(1000, 1));
+
+    at.SetInsertPoint(scale);
+    llvm::Value* leftScaled = at.CreateBinaryIntrinsic(llvm::Intrinsic::smul_with_overflow, at.CreateExtractValue(left, Coefficient), power(at, leftShift));
+    llvm::Value* rightScaled = at.CreateBinaryIntrinsic(llvm::Intrinsic::smul_with_overflow, at.CreateExtractValue(right, Coefficient), power(at, rightShift));
+    llvm::Value* overflow = at.CreateOr(at.CreateExtractValue(leftScaled, 1), at.CreateExtractValue(rightScaled, 1));
+    at.CreateCondBr(overflow, slow, aligned, weights.createBranchWeights(1, 1000));
+
+    at.SetInsertPoint(aligned);
+    leftCoefficient = at.CreateExtractValue(leftScaled, 0);
+    rightCoefficient = at.CreateExtractValue(rightScaled, 0);
+}
+
+// ==== Conversions ====
+
+llvm::Constant* Decimals::constant(const std::string& literal) {
+    // the digits and where the point goes: 1.50 is 150 × 10^-2, 1.5e3 is 15 × 10^2
+    std::string digits;
+    int64_t exponent = 0;
+    bool fraction = false;
+    size_t i = 0;
+    for (; i < literal.size() && literal[i] != 'e' && literal[i] != 'E'; i++) {
+        if (literal[i] == '.') fraction = true;
+        else {
+            digits += literal[i];
+            if (fraction) exponent--;
+        }
+    }
+    if (i < literal.size()) exponent += std::stoll(literal.substr(i + 1));
+    digits.erase(0, std::min(digits.find_first_not_of('0'), digits.size()));
+
+    llvm::Type* int32 = llvm::Type::getInt32Ty(context);
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    auto make = [&](llvm::Constant* coefficient, int32_t length) {
+        return llvm::ConstantStruct::get(numberType(context), {coefficient, llvm::ConstantInt::get(int32, exponent, true), llvm::ConstantInt::get(int32, length, true)});
+    };
+    if (digits.size() < 19 || (digits.size() == 19 && digits <= "9223372036854775807")) return make(llvm::ConstantInt::get(int64, digits.empty() ? 0 : std::stoll(digits)), 0);
+
+    // too big for a coefficient: limbs of a constant, never written to
+    std::vector<uint32_t> limbs;
+    for (size_t end = digits.size(); end > 0; end -= std::min(end, LimbDigits)) {
+        size_t start = end - std::min(end, LimbDigits);
+        limbs.push_back(static_cast<uint32_t>(std::stoul(digits.substr(start, end - start))));
+    }
+    llvm::Constant* data = llvm::ConstantDataArray::get(context, limbs);
+    if (!collector && !counter) {
+        auto* global = new llvm::GlobalVariable(module, data->getType(), true, llvm::GlobalValue::PrivateLinkage, data, "neoluma.number.literal");
+        global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        return make(llvm::ConstantExpr::getPtrToInt(global, int64), static_cast<int32_t>(limbs.size()));
+    }
+    // with a header like a string literal's, marked as not on the heap
+    llvm::StructType* type = llvm::StructType::get(context, {int64, data->getType()});
+    llvm::Constant* header = collector ? collector->staticHeader() : counter->staticHeader();
+    auto* global = new llvm::GlobalVariable(module, type, true, llvm::GlobalValue::PrivateLinkage, llvm::ConstantStruct::get(type, {header, data}), "neoluma.number.literal");
+    global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    global->setAlignment(llvm::Align(8));
+    llvm::Constant* indices[] = {llvm::ConstantInt::get(int32, 0), llvm::ConstantInt::get(int32, 1), llvm::ConstantInt::get(int32, 0)};
+    return make(llvm::ConstantExpr::getPtrToInt(llvm::ConstantExpr::getInBoundsGetElementPtr(type, global, indices), int64), static_cast<int32_t>(limbs.size()));
+}
+
+llvm::Value* Decimals::fromInteger(llvm::IRBuilderBase& at, llvm::Value* value, bool isSigned) {
+    unsigned width = value->getType()->getIntegerBitWidth();
+    if (width < 64 || (width == 64 && isSigned)) {
+        llvm::Value* coefficient = isSigned ? at.CreateSExt(value, at.getInt64Ty()) : at.CreateZExt(value, at.getInt64Ty());
+        return number(at, coefficient, at.getInt32(0), at.getInt32(0));
+    }
+
+    // uint64 and the 128-bit ones may not fit
+    llvm::Type* int128 = at.getInt128Ty();
+    llvm::Value* wide = isSigned ? at.CreateSExt(value, int128) : at.CreateZExt(value, int128);
+    llvm::Value* negative = isSigned ? at.CreateICmpSLT(wide, llvm::ConstantInt::get(int128, 0)) : at.getFalse();
+    llvm::Value* magnitude = isSigned ? at.CreateSelect(negative, at.CreateNeg(wide), wide) : wide;
+    return at.CreateCall(fromMagnitude(), {magnitude, negative, at.getInt32(0)});
+}
+
+llvm::Value* Decimals::fromReal(llvm::IRBuilderBase& at, llvm::Value* value) {
+    bool isFloat = value->getType()->isFloatTy();
+    llvm::Value* wide = isFloat ? at.CreateFPExt(value, at.getDoubleTy()) : value;
+    return at.CreateCall(fromDouble(), {wide, at.getInt32(isFloat ? 7 : 15)});
+}
+
+llvm::Function* Decimals::fromMagnitude() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.fromMagnitude")) return existing;
+
+    llvm::Type* int128 = llvm::Type::getInt128Ty(context);
+    llvm::Function* function = create("neoluma.number.fromMagnitude", numberType(context), {int128, llvm::Type::getInt1Ty(context), llvm::Type::getInt32Ty(context)});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* small = llvm::BasicBlock::Create(context, "inline", function);
+    llvm::BasicBlock* big = llvm::BasicBlock::Create(context, "big", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* magnitude = function->getArg(0);
+    llvm::Value* negative = function->getArg(1);
+    llvm::Value* exponent = function->getArg(2);
+    body.CreateCondBr(body.CreateICmpULE(magnitude, llvm::ConstantInt::get(int128, INT64_MAX)), small, big);
+
+    body.SetInsertPoint(small);
+    llvm::Value* coefficient = body.CreateTrunc(magnitude, body.getInt64Ty());
+    body.CreateRet(number(body, body.CreateSelect(negative, body.CreateNeg(coefficient), coefficient), exponent, body.getInt32(0)));
+
+    // 128 bits are at most 39 digits
+    body.SetInsertPoint(big);
+    llvm::Value* limbs = resultLimbs(body, body.getInt64(5));
+    for (uint64_t i = 0; i < 5; i++) {
+        body.CreateStore(body.CreateTrunc(body.CreateURem(magnitude, llvm::ConstantInt::get(int128, LimbBase)), body.getInt32Ty()), limb(body, limbs, body.getInt64(i)));
+        magnitude = body.CreateUDiv(magnitude, llvm::ConstantInt::get(int128, LimbBase));
+    }
+    llvm::Value* length = body.CreateTrunc(trim(body, limbs, body.getInt64(5)), body.getInt32Ty());
+    body.CreateRet(number(body, body.CreatePtrToInt(limbs, body.getInt64Ty()), exponent, body.CreateSelect(negative, body.CreateNeg(length), length)));
+    return function;
+}
+
+llvm::Function* Decimals::fromDouble() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.fromDouble")) return existing;
+
+    llvm::Function* function = create("neoluma.number.fromDouble", numberType(context), {llvm::Type::getDoubleTy(context), llvm::Type::getInt32Ty(context)});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* finite = llvm::BasicBlock::Create(context, "finite", function);
+    llvm::BasicBlock* notFinite = llvm::BasicBlock::Create(context, "not.finite", function);
+    llvm::BasicBlock* zero = llvm::BasicBlock::Create(context, "zero", function);
+    llvm::BasicBlock* convert = llvm::BasicBlock::Create(context, "convert", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* value = function->getArg(0);
+    llvm::Value* digits = body.CreateZExt(function->getArg(1), body.getInt64Ty());
+    llvm::Type* int64 = body.getInt64Ty();
+
+    llvm::Value* magnitude = body.CreateUnaryIntrinsic(llvm::Intrinsic::fabs, value);
+    body.CreateCondBr(body.CreateFCmpOLT(magnitude, llvm::ConstantFP::getInfinity(body.getDoubleTy())), finite, notFinite);
+
+    body.SetInsertPoint(notFinite);
+    body.CreateCall(failure("neoluma.number.notFinite", "nan and infinity have no number"));
+    body.CreateUnreachable();
+
+    body.SetInsertPoint(finite);
+    body.CreateCondBr(body.CreateFCmpOEQ(value, llvm::ConstantFP::get(body.getDoubleTy(), 0.0)), zero, convert);
+
+    body.SetInsertPoint(zero);
+    body.CreateRet(number(body, body.getInt64(0), body.getInt32(0), body.getInt32(0)));
+
+    // the digits printf rounds it to, [-]d.ddde±x
+    body.SetInsertPoint(convert);
+    llvm::ArrayType* bufferType = llvm::ArrayType::get(body.getInt8Ty(), 32);
+    llvm::Value* buffer = body.CreateConstInBoundsGEP2_32(bufferType, variable(body, bufferType, nullptr), 0, 0);
+    llvm::Value* precision = body.CreateTrunc(body.CreateSub(digits, body.getInt64(1)), body.getInt32Ty());
+    body.CreateCall(libc("snprintf", body.getInt32Ty(), {bytePointer(), sizeType(), bytePointer()}, true),
+        {buffer, llvm::ConstantInt::get(sizeType(), 32), globalString(body, "%.*e", "neoluma.number.scientific", &module), precision, value});
+    llvm::Value* negative = body.CreateICmpEQ(body.CreateLoad(body.getInt8Ty(), buffer), body.getInt8('-'));
+    llvm::Value* start = body.CreateZExt(negative, int64);
+
+    llvm::AllocaInst* coefficient = variable(body, int64, body.getInt64(0));
+    loop(body, body.getInt64(0), digits, [&](llvm::Value* i) {
+        // the point is after the first digit
+        llvm::Value* position = body.CreateAdd(body.CreateAdd(start, i), body.CreateZExt(body.CreateICmpNE(i, body.getInt64(0)), int64));
+        llvm::Value* digit = body.CreateZExt(body.CreateSub(body.CreateLoad(body.getInt8Ty(), body.CreateInBoundsGEP(body.getInt8Ty(), buffer, position)), body.getInt8('0')), int64);
+        body.CreateStore(body.CreateAdd(body.CreateMul(body.CreateLoad(int64, coefficient), body.getInt64(10)), digit), coefficient);
+    });
+    llvm::Value* written = body.CreateInBoundsGEP(body.getInt8Ty(), buffer, body.CreateAdd(body.CreateAdd(start, digits), body.getInt64(2)));
+    llvm::Value* scientific = body.CreateCall(libc("atoi", body.getInt32Ty(), {bytePointer()}), {written});
+    llvm::AllocaInst* exponent = variable(body, body.getInt32Ty(), body.CreateSub(scientific, precision));
+
+    // 0.5 is 5 × 10^-1, not 500000000000000 × 10^-15
+    loop(body, [&] { return body.CreateIsNull(body.CreateURem(body.CreateLoad(int64, coefficient), body.getInt64(10))); }, [&] {
+        body.CreateStore(body.CreateUDiv(body.CreateLoad(int64, coefficient), body.getInt64(10)), coefficient);
+        body.CreateStore(body.CreateAdd(body.CreateLoad(body.getInt32Ty(), exponent), body.getInt32(1)), exponent);
+    });
+    llvm::Value* result = body.CreateLoad(int64, coefficient);
+    body.CreateRet(number(body, body.CreateSelect(negative, body.CreateNeg(result), result), body.CreateLoad(body.getInt32Ty(), exponent), body.getInt32(0)));
+    return function;
+}
+
+// ==== Operations ====
+
+llvm::Function* Decimals::add() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.add")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Function* function = create("neoluma.number.add", type, {type, type});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* slow = llvm::BasicBlock::Create(context, "slow", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+
+    llvm::Value *left, *right, *exponent;
+    align(body, function->getArg(0), function->getArg(1), slow, left, right, exponent);
+    llvm::Value* sum = body.CreateBinaryIntrinsic(llvm::Intrinsic::sadd_with_overflow, left, right);
+    body.CreateCondBr(body.CreateExtractValue(sum, 1), slow, done, llvm::MDBuilder(context).createBranchWeights(1, 1000));
+
+    body.SetInsertPoint(done);
+    body.CreateRet(number(body, body.CreateExtractValue(sum, 0), exponent, body.getInt32(0)));
+
+    body.SetInsertPoint(slow);
+    body.CreateRet(body.CreateCall(addBig(), {function->getArg(0), function->getArg(1)}));
+    return function;
+}
+
+llvm::Function* Decimals::subtract() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.sub")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Function* function = create("neoluma.number.sub", type, {type, type});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* negated = body.CreateCall(negate(), {function->getArg(1)});
+    body.CreateRet(body.CreateCall(add(), {function->getArg(0), negated}));
+    return function;
+}
+
+llvm::Function* Decimals::negate() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.neg")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Function* function = create("neoluma.number.neg", type, {type});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* small = llvm::BasicBlock::Create(context, "inline", function);
+    llvm::BasicBlock* flip = llvm::BasicBlock::Create(context, "flip", function);
+    llvm::BasicBlock* big = llvm::BasicBlock::Create(context, "big", function);
+    llvm::BasicBlock* smallest = llvm::BasicBlock::Create(context, "smallest", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* value = function->getArg(0);
+    llvm::Value* coefficient = body.CreateExtractValue(value, Coefficient);
+    llvm::Value* exponent = body.CreateExtractValue(value, Exponent);
+    llvm::Value* length = body.CreateExtractValue(value, Length);
+    body.CreateCondBr(body.CreateIsNull(length), small, big, llvm::MDBuilder(context).createBranchWeights(1000, 1));
+
+    body.SetInsertPoint(big);
+    body.CreateRet(number(body, coefficient, exponent, body.CreateNeg(length)));
+
+    // -(-2^63) is one more than a coefficient holds
+    body.SetInsertPoint(small);
+    body.CreateCondBr(body.CreateICmpEQ(coefficient, body.getInt64(INT64_MIN)), smallest, flip, llvm::MDBuilder(context).createBranchWeights(1, 1000));
+
+    body.SetInsertPoint(flip);
+    body.CreateRet(number(body, body.CreateNeg(coefficient), exponent, length));
+
+    body.SetInsertPoint(smallest);
+    llvm::Value* magnitude = llvm::ConstantInt::get(body.getInt128Ty(), uint64_t(1) << 63);
+    body.CreateRet(body.CreateCall(fromMagnitude(), {magnitude, body.getFalse(), exponent}));
+    return function;
+}
+
+llvm::Function* Decimals::multiply() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.mul")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Function* function = create("neoluma.number.mul", type, {type, type});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* fast = llvm::BasicBlock::Create(context, "fast", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::BasicBlock* slow = llvm::BasicBlock::Create(context, "slow", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::MDBuilder weights(context);
+    llvm::Value* left = function->getArg(0);
+    llvm::Value* right = function->getArg(1);
+
+    llvm::Value* inlined = body.CreateIsNull(body.CreateOr(body.CreateExtractValue(left, Length), body.CreateExtractValue(right, Length)));
+    body.CreateCondBr(inlined, fast, slow, weights.createBranchWeights(1000, 1));
+
+    // exponents add, nothing needs aligning
+    body.SetInsertPoint(fast);
+    llvm::Value* product = body.CreateBinaryIntrinsic(llvm::Intrinsic::smul_with_overflow, body.CreateExtractValue(left, Coefficient), body.CreateExtractValue(right, Coefficient));
+    body.CreateCondBr(body.CreateExtractValue(product, 1), slow, done, weights.createBranchWeights(1, 1000));
+
+    body.SetInsertPoint(done);
+    llvm::Value* exponent = body.CreateAdd(body.CreateExtractValue(left, Exponent), body.CreateExtractValue(right, Exponent));
+    body.CreateRet(number(body, body.CreateExtractValue(product, 0), exponent, body.getInt32(0)));
+
+    body.SetInsertPoint(slow);
+    body.CreateRet(body.CreateCall(multiplyBig(), {left, right}));
+    return function;
+}
+
+llvm::Function* Decimals::divide() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.div")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Function* function = create("neoluma.number.div", type, {type, type});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* fast = llvm::BasicBlock::Create(context, "fast", function);
+    llvm::BasicBlock* exact = llvm::BasicBlock::Create(context, "exact", function);
+    llvm::BasicBlock* slow = llvm::BasicBlock::Create(context, "slow", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* left = function->getArg(0);
+    llvm::Value* right = function->getArg(1);
+    llvm::Value* dividend = body.CreateExtractValue(left, Coefficient);
+    llvm::Value* divisor = body.CreateExtractValue(right, Coefficient);
+
+    // zero, and -2^63 / -1 which doesn't fit, are the slow path's
+    llvm::Value* inlined = body.CreateIsNull(body.CreateOr(body.CreateExtractValue(left, Length), body.CreateExtractValue(right, Length)));
+    llvm::Value* overflows = body.CreateAnd(body.CreateICmpEQ(dividend, body.getInt64(INT64_MIN)), body.CreateICmpEQ(divisor, body.getInt64(-1)));
+    body.CreateCondBr(body.CreateAnd(inlined, body.CreateAnd(body.CreateIsNotNull(divisor), body.CreateNot(overflows))), fast, slow);
+
+    // a quotient of coefficients is exact or it isn't inline
+    body.SetInsertPoint(fast);
+    body.CreateCondBr(body.CreateIsNull(body.CreateSRem(dividend, divisor)), exact, slow);
+
+    body.SetInsertPoint(exact);
+    llvm::Value* exponent = body.CreateSub(body.CreateExtractValue(left, Exponent), body.CreateExtractValue(right, Exponent));
+    body.CreateRet(number(body, body.CreateSDiv(dividend, divisor), exponent, body.getInt32(0)));
+
+    body.SetInsertPoint(slow);
+    body.CreateRet(body.CreateCall(divideBig(), {left, right}));
+    return function;
+}
+
+llvm::Function* Decimals::remainder() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.rem")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Function* function = create("neoluma.number.rem", type, {type, type});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* fast = llvm::BasicBlock::Create(context, "fast", function);
+    llvm::BasicBlock* slow = llvm::BasicBlock::Create(context, "slow", function);
+    llvm::IRBuilder<> body(entry);
+
+    llvm::Value *left, *right, *exponent;
+    align(body, function->getArg(0), function->getArg(1), slow, left, right, exponent);
+    llvm::Value* overflows = body.CreateAnd(body.CreateICmpEQ(left, body.getInt64(INT64_MIN)), body.CreateICmpEQ(right, body.getInt64(-1)));
+    body.CreateCondBr(body.CreateAnd(body.CreateIsNotNull(right), body.CreateNot(overflows)), fast, slow);
+
+    body.SetInsertPoint(fast);
+    body.CreateRet(number(body, body.CreateSRem(left, right), exponent, body.getInt32(0)));
+
+    body.SetInsertPoint(slow);
+    body.CreateRet(body.CreateCall(remainderBig(), {function->getArg(0), function->getArg(1)}));
+    return function;
+}
+
+llvm::Function* Decimals::compare() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.compare")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Function* function = create("neoluma.number.compare", llvm::Type::getInt32Ty(context), {type, type});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* slow = llvm::BasicBlock::Create(context, "slow", function);
+    llvm::IRBuilder<> body(entry);
+
+    llvm::Value *left, *right, *exponent;
+    align(body, function->getArg(0), function->getArg(1), slow, left, right, exponent);
+    llvm::Value* greater = body.CreateZExt(body.CreateICmpSGT(left, right), body.getInt32Ty());
+    body.CreateRet(body.CreateSub(greater, body.CreateZExt(body.CreateICmpSLT(left, right), body.getInt32Ty())));
+
+    body.SetInsertPoint(slow);
+    body.CreateRet(body.CreateCall(compareBig(), {function->getArg(0), function->getArg(1)}));
+    return function;
+}
+
+llvm::Function* Decimals::release() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.release")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Function* function = create("neoluma.number.release", llvm::Type::getVoidTy(context), {type});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* big = llvm::BasicBlock::Create(context, "big", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* value = function->getArg(0);
+    body.CreateCondBr(body.CreateIsNull(body.CreateExtractValue(value, Length)), done, big, llvm::MDBuilder(context).createBranchWeights(1000, 1));
+
+    body.SetInsertPoint(big);
+    freeLimbs(body, body.CreateIntToPtr(body.CreateExtractValue(value, Coefficient), limbPointer()));
+    body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Decimals::format() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.format")) return existing;
+
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Type* int8 = llvm::Type::getInt8Ty(context);
+    llvm::StructType* result = llvm::StructType::get(context, {bytePointer(), int64});
+    llvm::Function* function = create("neoluma.number.format", result, {numberType(context), bytePointer(), int64});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* small = llvm::BasicBlock::Create(context, "inline", function);
+    llvm::BasicBlock* big = llvm::BasicBlock::Create(context, "big", function);
+    llvm::BasicBlock* measure = llvm::BasicBlock::Create(context, "measure", function);
+    llvm::BasicBlock* allocate = llvm::BasicBlock::Create(context, "allocate", function);
+    llvm::BasicBlock* write = llvm::BasicBlock::Create(context, "write", function);
+    llvm::BasicBlock* sign = llvm::BasicBlock::Create(context, "sign", function);
+    llvm::BasicBlock* layout = llvm::BasicBlock::Create(context, "layout", function);
+    llvm::BasicBlock* plain = llvm::BasicBlock::Create(context, "plain", function);
+    llvm::BasicBlock* whole = llvm::BasicBlock::Create(context, "whole", function);
+    llvm::BasicBlock* point = llvm::BasicBlock::Create(context, "point", function);
+    llvm::BasicBlock* fraction = llvm::BasicBlock::Create(context, "fraction", function);
+    llvm::BasicBlock* scientific = llvm::BasicBlock::Create(context, "scientific", function);
+    llvm::BasicBlock* mantissa = llvm::BasicBlock::Create(context, "mantissa", function);
+    llvm::BasicBlock* power = llvm::BasicBlock::Create(context, "power", function);
+    llvm::BasicBlock* finish = llvm::BasicBlock::Create(context, "finish", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* value = function->getArg(0);
+    llvm::Value* buffer = function->getArg(1);
+    llvm::Value* capacity = function->getArg(2);
+    llvm::Value* coefficient = body.CreateExtractValue(value, Coefficient);
+    llvm::Value* length = body.CreateExtractValue(value, Length);
+    llvm::Value* negative = isNegative(body, value);
+    body.CreateCondBr(body.CreateIsNull(length), small, big);
+
+    // zero still has a digit
+    body.SetInsertPoint(small);
+    llvm::Value* smallLimbs = inlineLimbs(body, coefficient);
+    llvm::Value* smallCount = body.CreateBinaryIntrinsic(llvm::Intrinsic::umax, trim(body, smallLimbs, body.getInt64(3)), body.getInt64(1));
+    llvm::BasicBlock* smallEnd = body.GetInsertBlock();
+    body.CreateBr(measure);
+
+    body.SetInsertPoint(big);
+    llvm::Value* bigLimbs = body.CreateIntToPtr(coefficient, limbPointer());
+    llvm::Value* bigCount = body.CreateZExt(body.CreateBinaryIntrinsic(llvm::Intrinsic::abs, length, body.getFalse()), int64);
+    body.CreateBr(measure);
+
+    // room for the text, then every limb's 9 digits after it, the first ones leading zeros
+    body.SetInsertPoint(measure);
+    llvm::PHINode* limbs = body.CreatePHI(limbPointer(), 2);
+    limbs->addIncoming(smallLimbs, smallEnd);
+    limbs->addIncoming(bigLimbs, big);
+    llvm::PHINode* count = body.CreatePHI(int64, 2);
+    count->addIncoming(smallCount, smallEnd);
+    count->addIncoming(bigCount, big);
+    llvm::Value* digits = digitCount(body, limbs, count);
+    llvm::Value* room = body.CreateAdd(digits, body.getInt64(16)); // a sign, a point and an exponent of up to 11 characters
+    llvm::Value* region = body.CreateMul(count, body.getInt64(LimbDigits));
+    llvm::Value* size = body.CreateAdd(body.CreateAdd(room, region), body.getInt64(1));
+    body.CreateCondBr(body.CreateICmpULE(size, capacity), write, allocate);
+
+    body.SetInsertPoint(allocate);
+    llvm::Value* memory = body.CreateCall(libc("malloc", bytePointer(), {sizeType()}), {body.CreateZExtOrTrunc(size, sizeType())});
+    body.CreateBr(write);
+
+    body.SetInsertPoint(write);
+    llvm::PHINode* output = body.CreatePHI(bytePointer(), 2);
+    output->addIncoming(buffer, measure);
+    output->addIncoming(memory, allocate);
+    llvm::Value* digitRegion = body.CreateInBoundsGEP(int8, output, room);
+    loop(body, body.getInt64(0), count, [&](llvm::Value* i) {
+        llvm::Value* limbValue = body.CreateLoad(body.getInt32Ty(), limb(body, limbs, i));
+        llvm::Value* end = body.CreateMul(body.CreateSub(count, i), body.getInt64(LimbDigits));
+        for (uint64_t k = 1; k <= LimbDigits; k++) {
+            llvm::Value* digit = body.CreateTrunc(body.CreateURem(limbValue, body.getInt32(10)), int8);
+            body.CreateStore(body.CreateAdd(digit, body.getInt8('0')), body.CreateInBoundsGEP(int8, digitRegion, body.CreateSub(end, body.getInt64(k))));
+            limbValue = body.CreateUDiv(limbValue, body.getInt32(10));
+        }
+    });
+    llvm::Value* text = body.CreateInBoundsGEP(int8, digitRegion, body.CreateSub(region, digits));
+    llvm::AllocaInst* position = variable(body, int64, body.getInt64(0));
+    auto put = [&](llvm::Value* character) {
+        llvm::Value* at = body.CreateLoad(int64, position);
+        body.CreateStore(character, body.CreateInBoundsGEP(int8, output, at));
+        body.CreateStore(body.CreateAdd(at, body.getInt64(1)), position);
+    };
+    auto copy = [&](llvm::Value* source, llvm::Value* bytes) {
+        llvm::Value* at = body.CreateLoad(int64, position);
+        body.CreateMemCpy(body.CreateInBoundsGEP(int8, output, at), llvm::MaybeAlign(1), source, llvm::MaybeAlign(1), bytes);
+        body.CreateStore(body.CreateAdd(at, bytes), position);
+    };
+    body.CreateCondBr(negative, sign, layout);
+
+    body.SetInsertPoint(sign);
+    put(body.getInt8('-'));
+    body.CreateBr(layout);
+
+    // plain unless the exponent is positive or there'd be more than 5 zeros after the point, then like 1.5E+7
+    body.SetInsertPoint(layout);
+    llvm::Value* exponent = body.CreateSExt(body.CreateExtractValue(value, Exponent), int64);
+    llvm::Value* adjusted = body.CreateAdd(body.CreateSub(digits, body.getInt64(1)), exponent);
+    llvm::Value* isPlain = body.CreateAnd(body.CreateICmpSLE(exponent, body.getInt64(0)), body.CreateICmpSGE(adjusted, body.getInt64(-6)));
+    body.CreateCondBr(isPlain, plain, scientific);
+
+    body.SetInsertPoint(plain);
+    llvm::Value* integral = body.CreateAdd(digits, exponent);
+    body.CreateCondBr(body.CreateICmpSGT(integral, body.getInt64(0)), whole, fraction);
+
+    body.SetInsertPoint(whole);
+    copy(text, integral);
+    body.CreateCondBr(body.CreateICmpSLT(exponent, body.getInt64(0)), point, finish);
+
+    body.SetInsertPoint(point);
+    put(body.getInt8('.'));
+    copy(body.CreateInBoundsGEP(int8, text, integral), body.CreateNeg(exponent));
+    body.CreateBr(finish);
+
+    body.SetInsertPoint(fraction);
+    put(body.getInt8('0'));
+    put(body.getInt8('.'));
+    llvm::Value* zeros = body.CreateNeg(integral);
+    llvm::Value* at = body.CreateLoad(int64, position);
+    body.CreateMemSet(body.CreateInBoundsGEP(int8, output, at), body.getInt8('0'), zeros, llvm::MaybeAlign(1));
+    body.CreateStore(body.CreateAdd(at, zeros), position);
+    copy(text, digits);
+    body.CreateBr(finish);
+
+    body.SetInsertPoint(scientific);
+    put(body.CreateLoad(int8, text));
+    body.CreateCondBr(body.CreateICmpUGT(digits, body.getInt64(1)), mantissa, power);
+
+    body.SetInsertPoint(mantissa);
+    put(body.getInt8('.'));
+    copy(body.CreateConstInBoundsGEP1_64(int8, text, 1), body.CreateSub(digits, body.getInt64(1)));
+    body.CreateBr(power);
+
+    body.SetInsertPoint(power);
+    llvm::Value* end = body.CreateLoad(int64, position);
+    llvm::Value* written = body.CreateCall(libc("snprintf", body.getInt32Ty(), {bytePointer(), sizeType(), bytePointer()}, true),
+        {body.CreateInBoundsGEP(int8, output, end), llvm::ConstantInt::get(sizeType(), 16), globalString(body, "E%+lld", "neoluma.number.exponent", &module), adjusted});
+    body.CreateStore(body.CreateAdd(end, body.CreateSExt(written, int64)), position);
+    body.CreateBr(finish);
+
+    body.SetInsertPoint(finish);
+    llvm::Value* total = body.CreateLoad(int64, position);
+    body.CreateStore(body.getInt8(0), body.CreateInBoundsGEP(int8, output, total));
+    body.CreateRet(body.CreateInsertValue(body.CreateInsertValue(llvm::UndefValue::get(result), output, 0), total, 1));
+    return function;
+}
+
+// ==== Slow paths ====
+
+llvm::Function* Decimals::scaled() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.scaled")) return existing;
+
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Function* function = create("neoluma.number.scaled", limbPointer(), {numberType(context), llvm::Type::getInt32Ty(context), pointerTo(int64)});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* small = llvm::BasicBlock::Create(context, "inline", function);
+    llvm::BasicBlock* big = llvm::BasicBlock::Create(context, "big", function);
+    llvm::BasicBlock* scale = llvm::BasicBlock::Create(context, "scale", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* value = function->getArg(0);
+    llvm::Value* coefficient = body.CreateExtractValue(value, Coefficient);
+    llvm::Value* length = body.CreateExtractValue(value, Length);
+    llvm::Value* difference = body.CreateSub(body.CreateSExt(body.CreateExtractValue(value, Exponent), int64), body.CreateSExt(function->getArg(1), int64));
+    body.CreateCondBr(body.CreateIsNull(length), small, big);
+
+    body.SetInsertPoint(small);
+    llvm::Value* smallLimbs = inlineLimbs(body, coefficient);
+    llvm::Value* smallCount = trim(body, smallLimbs, body.getInt64(3));
+    llvm::BasicBlock* smallEnd = body.GetInsertBlock();
+    body.CreateBr(scale);
+
+    body.SetInsertPoint(big);
+    llvm::Value* bigLimbs = body.CreateIntToPtr(coefficient, limbPointer());
+    llvm::Value* bigCount = body.CreateZExt(body.CreateBinaryIntrinsic(llvm::Intrinsic::abs, length, body.getFalse()), int64);
+    body.CreateBr(scale);
+
+    // whole limbs of zeros below, then a multiplication by what's left of the power
+    body.SetInsertPoint(scale);
+    llvm::PHINode* limbs = body.CreatePHI(limbPointer(), 2);
+    limbs->addIncoming(smallLimbs, smallEnd);
+    limbs->addIncoming(bigLimbs, big);
+    llvm::PHINode* count = body.CreatePHI(int64, 2);
+    count->addIncoming(smallCount, smallEnd);
+    count->addIncoming(bigCount, big);
+    llvm::Value* shift = body.CreateUDiv(difference, body.getInt64(LimbDigits));
+    llvm::Value* factor = body.CreateTrunc(power(body, body.CreateURem(difference, body.getInt64(LimbDigits))), body.getInt32Ty());
+    llvm::Value* result = allocateLimbs(body, body.CreateAdd(body.CreateAdd(count, shift), body.getInt64(1)));
+    body.CreateMemSet(result, body.getInt8(0), body.CreateMul(shift, body.getInt64(4)), llvm::MaybeAlign(4));
+    llvm::Value* written = body.CreateCall(multiplySmall(), {limbs, count, factor, limb(body, result, shift)});
+    body.CreateStore(trim(body, result, body.CreateAdd(shift, written)), function->getArg(2));
+    body.CreateRet(result);
+    return function;
+}
+
+llvm::Function* Decimals::normalize() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.normalize")) return existing;
+
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Type* int128 = llvm::Type::getInt128Ty(context);
+    llvm::Function* function = create("neoluma.number.normalize", numberType(context), {limbPointer(), int64, llvm::Type::getInt1Ty(context), llvm::Type::getInt32Ty(context)});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* few = llvm::BasicBlock::Create(context, "few", function);
+    llvm::BasicBlock* small = llvm::BasicBlock::Create(context, "inline", function);
+    llvm::BasicBlock* big = llvm::BasicBlock::Create(context, "big", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* limbs = function->getArg(0);
+    llvm::Value* negative = function->getArg(2);
+    llvm::Value* exponent = function->getArg(3);
+
+    llvm::Value* count = trim(body, limbs, function->getArg(1));
+    body.CreateCondBr(body.CreateICmpULE(count, body.getInt64(3)), few, big);
+
+    body.SetInsertPoint(few);
+    llvm::AllocaInst* sum = variable(body, int128, llvm::ConstantInt::get(int128, 0));
+    loop(body, body.getInt64(0), count, [&](llvm::Value* i) {
+        llvm::Value* index = body.CreateSub(body.CreateSub(count, i), body.getInt64(1));
+        llvm::Value* digits = body.CreateZExt(body.CreateLoad(body.getInt32Ty(), limb(body, limbs, index)), int128);
+        body.CreateStore(body.CreateAdd(body.CreateMul(body.CreateLoad(int128, sum), llvm::ConstantInt::get(int128, LimbBase)), digits), sum);
+    });
+    llvm::Value* magnitude = body.CreateLoad(int128, sum);
+    body.CreateCondBr(body.CreateICmpULE(magnitude, llvm::ConstantInt::get(int128, INT64_MAX)), small, big);
+
+    body.SetInsertPoint(small);
+    freeLimbs(body, limbs);
+    llvm::Value* coefficient = body.CreateTrunc(magnitude, int64);
+    body.CreateRet(number(body, body.CreateSelect(negative, body.CreateNeg(coefficient), coefficient), exponent, body.getInt32(0)));
+
+    // the collector's or the counter's object is only made once the result is known, the operation's own are malloc'd
+    body.SetInsertPoint(big);
+    llvm::Value* result = limbs;
+    if (collector || counter) {
+        result = resultLimbs(body, count);
+        body.CreateMemCpy(result, llvm::MaybeAlign(4), limbs, llvm::MaybeAlign(4), body.CreateMul(count, body.getInt64(4)));
+        freeLimbs(body, limbs);
+    }
+    llvm::Value* length = body.CreateTrunc(count, body.getInt32Ty());
+    body.CreateRet(number(body, body.CreatePtrToInt(result, int64), exponent, body.CreateSelect(negative, body.CreateNeg(length), length)));
+    return function;
+}
+
+llvm::Function* Decimals::addBig() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.addBig")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Function* function = create("neoluma.number.addBig", type, {type, type});
+    function->addFnAttr(llvm::Attribute::NoInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* same = llvm::BasicBlock::Create(context, "same.sign", function);
+    llvm::BasicBlock* different = llvm::BasicBlock::Create(context, "different.sign", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* left = function->getArg(0);
+    llvm::Value* right = function->getArg(1);
+
+    llvm::Value* exponent = body.CreateBinaryIntrinsic(llvm::Intrinsic::smin, body.CreateExtractValue(left, Exponent), body.CreateExtractValue(right, Exponent));
+    llvm::AllocaInst* countSlot = variable(body, int64, nullptr);
+    llvm::Value* a = body.CreateCall(scaled(), {left, exponent, countSlot});
+    llvm::Value* na = body.CreateLoad(int64, countSlot);
+    llvm::Value* b = body.CreateCall(scaled(), {right, exponent, countSlot});
+    llvm::Value* nb = body.CreateLoad(int64, countSlot);
+    llvm::Value* leftNegative = isNegative(body, left);
+    llvm::Value* rightNegative = isNegative(body, right);
+    body.CreateCondBr(body.CreateICmpEQ(leftNegative, rightNegative), same, different);
+
+    // magnitudes add, the longer one first
+    body.SetInsertPoint(same);
+    llvm::Value* longer = body.CreateICmpUGE(na, nb);
+    llvm::Value* first = body.CreateSelect(longer, a, b);
+    llvm::Value* firstCount = body.CreateSelect(longer, na, nb);
+    llvm::Value* sum = allocateLimbs(body, body.CreateAdd(firstCount, body.getInt64(1)));
+    llvm::Value* carry = body.CreateCall(addLimbs(), {first, firstCount, body.CreateSelect(longer, b, a), body.CreateSelect(longer, nb, na), sum});
+    body.CreateStore(carry, limb(body, sum, firstCount));
+    llvm::Value* sumCount = body.CreateAdd(firstCount, body.getInt64(1));
+    body.CreateBr(done);
+
+    // the smaller magnitude comes off the bigger, which has the sign
+    body.SetInsertPoint(different);
+    llvm::Value* bigger = body.CreateICmpSGE(body.CreateCall(compareLimbs(), {a, na, b, nb}), body.getInt32(0));
+    llvm::Value* biggerCount = body.CreateSelect(bigger, na, nb);
+    llvm::Value* difference = allocateLimbs(body, body.CreateAdd(biggerCount, body.getInt64(1)));
+    body.CreateCall(subtractLimbs(), {body.CreateSelect(bigger, a, b), biggerCount, body.CreateSelect(bigger, b, a), body.CreateSelect(bigger, nb, na), difference});
+    llvm::Value* differenceNegative = body.CreateSelect(bigger, leftNegative, rightNegative);
+    body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    llvm::PHINode* limbs = body.CreatePHI(limbPointer(), 2);
+    limbs->addIncoming(sum, same);
+    limbs->addIncoming(difference, different);
+    llvm::PHINode* count = body.CreatePHI(int64, 2);
+    count->addIncoming(sumCount, same);
+    count->addIncoming(biggerCount, different);
+    llvm::PHINode* negative = body.CreatePHI(body.getInt1Ty(), 2);
+    negative->addIncoming(leftNegative, same);
+    negative->addIncoming(differenceNegative, different);
+    freeLimbs(body, a);
+    freeLimbs(body, b);
+    body.CreateRet(body.CreateCall(normalize(), {limbs, count, negative, exponent}));
+    return function;
+}
+
+llvm::Function* Decimals::multiplyBig() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.mulBig")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Function* function = create("neoluma.number.mulBig", type, {type, type});
+    function->addFnAttr(llvm::Attribute::NoInline);
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* left = function->getArg(0);
+    llvm::Value* right = function->getArg(1);
+
+    llvm::Value* leftExponent = body.CreateExtractValue(left, Exponent);
+    llvm::Value* rightExponent = body.CreateExtractValue(right, Exponent);
+    llvm::AllocaInst* countSlot = variable(body, int64, nullptr);
+    llvm::Value* a = body.CreateCall(scaled(), {left, leftExponent, countSlot});
+    llvm::Value* na = body.CreateLoad(int64, countSlot);
+    llvm::Value* b = body.CreateCall(scaled(), {right, rightExponent, countSlot});
+    llvm::Value* nb = body.CreateLoad(int64, countSlot);
+
+    llvm::Value* count = body.CreateAdd(na, nb);
+    llvm::Value* product = allocateLimbs(body, body.CreateAdd(count, body.getInt64(1)));
+    body.CreateCall(multiplyLimbs(), {a, na, b, nb, product});
+    freeLimbs(body, a);
+    freeLimbs(body, b);
+    llvm::Value* negative = body.CreateXor(isNegative(body, left), isNegative(body, right));
+    body.CreateRet(body.CreateCall(normalize(), {product, count, negative, body.CreateAdd(leftExponent, rightExponent)}));
+    return function;
+}
+
+llvm::Function* Decimals::divideBig() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.divBig")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Type* int32 = llvm::Type::getInt32Ty(context);
+    llvm::Function* function = create("neoluma.number.divBig", type, {type, type});
+    function->addFnAttr(llvm::Attribute::NoInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* byZero = llvm::BasicBlock::Create(context, "by.zero", function);
+    llvm::BasicBlock* check = llvm::BasicBlock::Create(context, "check", function);
+    llvm::BasicBlock* zero = llvm::BasicBlock::Create(context, "zero", function);
+    llvm::BasicBlock* divide = llvm::BasicBlock::Create(context, "divide", function);
+    llvm::BasicBlock* exact = llvm::BasicBlock::Create(context, "exact", function);
+    llvm::BasicBlock* round = llvm::BasicBlock::Create(context, "round", function);
+    llvm::BasicBlock* up = llvm::BasicBlock::Create(context, "up", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* left = function->getArg(0);
+    llvm::Value* right = function->getArg(1);
+    auto isZero = [&](llvm::Value* value) { return body.CreateIsNull(body.CreateOr(body.CreateExtractValue(value, Coefficient), body.CreateZExt(body.CreateExtractValue(value, Length), int64))); };
+    llvm::Value* leftExponent = body.CreateSExt(body.CreateExtractValue(left, Exponent), int64);
+    llvm::Value* ideal = body.CreateSub(leftExponent, body.CreateSExt(body.CreateExtractValue(right, Exponent), int64));
+    body.CreateCondBr(isZero(right), byZero, check);
+
+    body.SetInsertPoint(byZero);
+    body.CreateCall(failure("neoluma.number.divisionByZero", "division of a number by zero"));
+    body.CreateUnreachable();
+
+    body.SetInsertPoint(check);
+    body.CreateCondBr(isZero(left), zero, divide);
+
+    body.SetInsertPoint(zero);
+    body.CreateRet(number(body, body.getInt64(0), body.CreateTrunc(ideal, int32), body.getInt32(0)));
+
+    // the dividend gets enough zeros for the quotient to have a digit more than it keeps
+    body.SetInsertPoint(divide);
+    llvm::AllocaInst* countSlot = variable(body, int64, nullptr);
+    llvm::Value* a = body.CreateCall(scaled(), {left, body.CreateExtractValue(left, Exponent), countSlot});
+    llvm::Value* dividendDigits = digitCount(body, a, body.CreateLoad(int64, countSlot));
+    freeLimbs(body, a);
+    llvm::Value* b = body.CreateCall(scaled(), {right, body.CreateExtractValue(right, Exponent), countSlot});
+    llvm::Value* nb = body.CreateLoad(int64, countSlot);
+    llvm::Value* zeros = body.CreateSub(body.CreateAdd(body.getInt64(QuotientDigits + 1), digitCount(body, b, nb)), dividendDigits);
+    zeros = body.CreateBinaryIntrinsic(llvm::Intrinsic::smax, zeros, body.getInt64(0));
+    a = body.CreateCall(scaled(), {left, body.CreateTrunc(body.CreateSub(leftExponent, zeros), int32), countSlot});
+    llvm::Value* na = body.CreateLoad(int64, countSlot);
+
+    llvm::Value* quotient = allocateLimbs(body, body.CreateAdd(na, body.getInt64(1)));
+    llvm::Value* remainder = allocateLimbs(body, body.CreateAdd(nb, body.getInt64(1)));
+    llvm::Value* remainderCount = body.CreateCall(divideLimbs(), {a, na, b, nb, quotient, remainder});
+    freeLimbs(body, a);
+    freeLimbs(body, b);
+    freeLimbs(body, remainder);
+    llvm::AllocaInst* count = variable(body, int64, trim(body, quotient, na));
+    llvm::AllocaInst* exponent = variable(body, int64, body.CreateSub(ideal, zeros));
+    auto divideBy = [&](llvm::Value* divisor) {
+        llvm::Value* rest = body.CreateCall(divideSmall(), {quotient, body.CreateLoad(int64, count), divisor, quotient});
+        body.CreateStore(trim(body, quotient, body.CreateLoad(int64, count)), count);
+        return rest;
+    };
+    body.CreateCondBr(body.CreateIsNull(remainderCount), exact, round);
+
+    // an exact quotient loses the zeros it got, down to the exponent it would have without them
+    body.SetInsertPoint(exact);
+    loop(body, [&] {
+        llvm::Value* above = body.CreateICmpSLT(body.CreateLoad(int64, exponent), ideal);
+        llvm::Value* lowest = body.CreateLoad(int32, quotient);
+        return body.CreateAnd(above, body.CreateIsNull(body.CreateURem(lowest, body.getInt32(10))));
+    }, [&] {
+        divideBy(body.getInt32(10));
+        body.CreateStore(body.CreateAdd(body.CreateLoad(int64, exponent), body.getInt64(1)), exponent);
+    });
+    body.CreateBr(done);
+
+    // anything else keeps QuotientDigits: the remainder isn't zero, so a dropped 5 is always more than half
+    body.SetInsertPoint(round);
+    llvm::Value* drop = body.CreateSub(digitCount(body, quotient, body.CreateLoad(int64, count)), body.getInt64(QuotientDigits));
+    body.CreateStore(body.CreateAdd(body.CreateLoad(int64, exponent), drop), exponent);
+    llvm::AllocaInst* remaining = variable(body, int64, drop);
+    loop(body, [&] { return body.CreateICmpSGT(body.CreateLoad(int64, remaining), body.getInt64(1)); }, [&] {
+        llvm::Value* dropping = body.CreateBinaryIntrinsic(llvm::Intrinsic::umin, body.CreateSub(body.CreateLoad(int64, remaining), body.getInt64(1)), body.getInt64(LimbDigits));
+        divideBy(body.CreateTrunc(power(body, dropping), int32));
+        body.CreateStore(body.CreateSub(body.CreateLoad(int64, remaining), dropping), remaining);
+    });
+    llvm::Value* last = divideBy(body.getInt32(10));
+    body.CreateCondBr(body.CreateICmpUGE(last, body.getInt32(5)), up, done);
+
+    body.SetInsertPoint(up);
+    llvm::Value* one = variable(body, int32, body.getInt32(1));
+    llvm::Value* current = body.CreateLoad(int64, count);
+    llvm::Value* carry = body.CreateCall(addLimbs(), {quotient, current, one, body.getInt64(1), quotient});
+    body.CreateStore(carry, limb(body, quotient, current));
+    body.CreateStore(body.CreateAdd(current, body.CreateZExt(carry, int64)), count);
+    body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    llvm::Value* negative = body.CreateXor(isNegative(body, left), isNegative(body, right));
+    body.CreateRet(body.CreateCall(normalize(), {quotient, body.CreateLoad(int64, count), negative, body.CreateTrunc(body.CreateLoad(int64, exponent), int32)}));
+    return function;
+}
+
+llvm::Function* Decimals::remainderBig() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.remBig")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Function* function = create("neoluma.number.remBig", type, {type, type});
+    function->addFnAttr(llvm::Attribute::NoInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* byZero = llvm::BasicBlock::Create(context, "by.zero", function);
+    llvm::BasicBlock* divide = llvm::BasicBlock::Create(context, "divide", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* left = function->getArg(0);
+    llvm::Value* right = function->getArg(1);
+    llvm::Value* rightZero = body.CreateIsNull(body.CreateOr(body.CreateExtractValue(right, Coefficient), body.CreateZExt(body.CreateExtractValue(right, Length), int64)));
+    body.CreateCondBr(rightZero, byZero, divide);
+
+    body.SetInsertPoint(byZero);
+    body.CreateCall(failure("neoluma.number.divisionByZero", "division of a number by zero"));
+    body.CreateUnreachable();
+
+    body.SetInsertPoint(divide);
+    llvm::Value* exponent = body.CreateBinaryIntrinsic(llvm::Intrinsic::smin, body.CreateExtractValue(left, Exponent), body.CreateExtractValue(right, Exponent));
+    llvm::AllocaInst* countSlot = variable(body, int64, nullptr);
+    llvm::Value* a = body.CreateCall(scaled(), {left, exponent, countSlot});
+    llvm::Value* na = body.CreateLoad(int64, countSlot);
+    llvm::Value* b = body.CreateCall(scaled(), {right, exponent, countSlot});
+    llvm::Value* nb = body.CreateLoad(int64, countSlot);
+
+    llvm::Value* quotient = allocateLimbs(body, body.CreateAdd(na, body.getInt64(1)));
+    llvm::Value* remainder = allocateLimbs(body, body.CreateAdd(nb, body.getInt64(1)));
+    llvm::Value* count = body.CreateCall(divideLimbs(), {a, na, b, nb, quotient, remainder});
+    freeLimbs(body, a);
+    freeLimbs(body, b);
+    freeLimbs(body, quotient);
+    body.CreateRet(body.CreateCall(normalize(), {remainder, count, isNegative(body, left), exponent}));
+    return function;
+}
+
+llvm::Function* Decimals::compareBig() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.compareBig")) return existing;
+
+    llvm::StructType* type = numberType(context);
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Function* function = create("neoluma.number.compareBig", llvm::Type::getInt32Ty(context), {type, type});
+    function->addFnAttr(llvm::Attribute::NoInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* differ = llvm::BasicBlock::Create(context, "signs.differ", function);
+    llvm::BasicBlock* same = llvm::BasicBlock::Create(context, "same.sign", function);
+    llvm::BasicBlock* zero = llvm::BasicBlock::Create(context, "zero", function);
+    llvm::BasicBlock* magnitudes = llvm::BasicBlock::Create(context, "magnitudes", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* left = function->getArg(0);
+    llvm::Value* right = function->getArg(1);
+
+    // signs decide first, -1, 0 or 1
+    auto sign = [&](llvm::Value* value) {
+        llvm::Value* isZero = body.CreateIsNull(body.CreateOr(body.CreateExtractValue(value, Coefficient), body.CreateZExt(body.CreateExtractValue(value, Length), int64)));
+        return body.CreateSelect(isZero, body.getInt32(0), body.CreateSelect(isNegative(body, value), body.getInt32(-1), body.getInt32(1)));
+    };
+    llvm::Value* leftSign = sign(left);
+    llvm::Value* rightSign = sign(right);
+    body.CreateCondBr(body.CreateICmpEQ(leftSign, rightSign), same, differ);
+
+    body.SetInsertPoint(differ);
+    body.CreateRet(body.CreateSelect(body.CreateICmpSGT(leftSign, rightSign), body.getInt32(1), body.getInt32(-1)));
+
+    body.SetInsertPoint(same);
+    body.CreateCondBr(body.CreateIsNull(leftSign), zero, magnitudes);
+
+    body.SetInsertPoint(zero);
+    body.CreateRet(body.getInt32(0));
+
+    body.SetInsertPoint(magnitudes);
+    llvm::Value* exponent = body.CreateBinaryIntrinsic(llvm::Intrinsic::smin, body.CreateExtractValue(left, Exponent), body.CreateExtractValue(right, Exponent));
+    llvm::AllocaInst* countSlot = variable(body, int64, nullptr);
+    llvm::Value* a = body.CreateCall(scaled(), {left, exponent, countSlot});
+    llvm::Value* na = body.CreateLoad(int64, countSlot);
+    llvm::Value* b = body.CreateCall(scaled(), {right, exponent, countSlot});
+    llvm::Value* nb = body.CreateLoad(int64, countSlot);
+    llvm::Value* order = body.CreateCall(compareLimbs(), {a, na, b, nb});
+    freeLimbs(body, a);
+    freeLimbs(body, b);
+    body.CreateRet(body.CreateSelect(body.CreateICmpSLT(leftSign, body.getInt32(0)), body.CreateNeg(order), order));
+    return function;
+}
+
+// ==== Limbs ====
+
+llvm::Function* Decimals::compareLimbs() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.compareLimbs")) return existing;
+
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Function* function = create("neoluma.number.compareLimbs", llvm::Type::getInt32Ty(context), {limbPointer(), int64, limbPointer(), int64});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* longer = llvm::BasicBlock::Create(context, "longer", function);
+    llvm::BasicBlock* same = llvm::BasicBlock::Create(context, "same.length", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* a = function->getArg(0);
+    llvm::Value* na = function->getArg(1);
+    llvm::Value* b = function->getArg(2);
+    llvm::Value* nb = function->getArg(3);
+    body.CreateCondBr(body.CreateICmpEQ(na, nb), same, longer);
+
+    body.SetInsertPoint(longer);
+    body.CreateRet(body.CreateSelect(body.CreateICmpUGT(na, nb), body.getInt32(1), body.getInt32(-1)));
+
+    // the first limb from the top that differs
+    body.SetInsertPoint(same);
+    loop(body, body.getInt64(0), na, [&](llvm::Value* i) {
+        llvm::BasicBlock* unequal = llvm::BasicBlock::Create(context, "unequal", function);
+        llvm::BasicBlock* next = llvm::BasicBlock::Create(context, "next", function);
+        llvm::Value* index = body.CreateSub(body.CreateSub(na, i), body.getInt64(1));
+        llvm::Value* x = body.CreateLoad(body.getInt32Ty(), limb(body, a, index));
+        llvm::Value* y = body.CreateLoad(body.getInt32Ty(), limb(body, b, index));
+        body.CreateCondBr(body.CreateICmpNE(x, y), unequal, next);
+        body.SetInsertPoint(unequal);
+        body.CreateRet(body.CreateSelect(body.CreateICmpUGT(x, y), body.getInt32(1), body.getInt32(-1)));
+        body.SetInsertPoint(next);
+    });
+    body.CreateRet(body.getInt32(0));
+    return function;
+}
+
+llvm::Function* Decimals::addLimbs() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.addLimbs")) return existing;
+
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Type* int32 = llvm::Type::getInt32Ty(context);
+    llvm::Function* function = create("neoluma.number.addLimbs", int32, {limbPointer(), int64, limbPointer(), int64, limbPointer()});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* a = function->getArg(0);
+    llvm::Value* b = function->getArg(2);
+    llvm::Value* out = function->getArg(4);
+
+    // below the base twice over, so an i32 holds the sum of two limbs and the carry
+    llvm::AllocaInst* carry = variable(body, int32, body.getInt32(0));
+    auto step = [&](llvm::Value* i, bool both) {
+        llvm::Value* sum = body.CreateAdd(body.CreateLoad(int32, limb(body, a, i)), body.CreateLoad(int32, carry));
+        if (both) sum = body.CreateAdd(sum, body.CreateLoad(int32, limb(body, b, i)));
+        llvm::Value* over = body.CreateICmpUGE(sum, body.getInt32(LimbBase));
+        body.CreateStore(body.CreateSelect(over, body.CreateSub(sum, body.getInt32(LimbBase)), sum), limb(body, out, i));
+        body.CreateStore(body.CreateZExt(over, int32), carry);
+    };
+    loop(body, body.getInt64(0), function->getArg(3), [&](llvm::Value* i) { step(i, true); });
+    loop(body, function->getArg(3), function->getArg(1), [&](llvm::Value* i) { step(i, false); });
+    body.CreateRet(body.CreateLoad(int32, carry));
+    return function;
+}
+
+llvm::Function* Decimals::subtractLimbs() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.subLimbs")) return existing;
+
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Type* int32 = llvm::Type::getInt32Ty(context);
+    llvm::Function* function = create("neoluma.number.subLimbs", llvm::Type::getVoidTy(context), {limbPointer(), int64, limbPointer(), int64, limbPointer()});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* a = function->getArg(0);
+    llvm::Value* b = function->getArg(2);
+    llvm::Value* out = function->getArg(4);
+
+    llvm::AllocaInst* borrow = variable(body, int32, body.getInt32(0));
+    auto step = [&](llvm::Value* i, bool both) {
+        llvm::Value* difference = body.CreateSub(body.CreateLoad(int32, limb(body, a, i)), body.CreateLoad(int32, borrow));
+        if (both) difference = body.CreateSub(difference, body.CreateLoad(int32, limb(body, b, i)));
+        llvm::Value* under = body.CreateICmpSLT(difference, body.getInt32(0));
+        body.CreateStore(body.CreateSelect(under, body.CreateAdd(difference, body.getInt32(LimbBase)), difference), limb(body, out, i));
+        body.CreateStore(body.CreateZExt(under, int32), borrow);
+    };
+    loop(body, body.getInt64(0), function->getArg(3), [&](llvm::Value* i) { step(i, true); });
+    loop(body, function->getArg(3), function->getArg(1), [&](llvm::Value* i) { step(i, false); });
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Decimals::multiplySmall() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.mulSmall")) return existing;
+
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Type* int32 = llvm::Type::getInt32Ty(context);
+    llvm::Function* function = create("neoluma.number.mulSmall", int64, {limbPointer(), int64, int32, limbPointer()});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* extra = llvm::BasicBlock::Create(context, "extra", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* a = function->getArg(0);
+    llvm::Value* na = function->getArg(1);
+    llvm::Value* factor = body.CreateZExt(function->getArg(2), int64);
+    llvm::Value* out = function->getArg(3);
+
+    llvm::AllocaInst* carry = variable(body, int64, body.getInt64(0));
+    loop(body, body.getInt64(0), na, [&](llvm::Value* i) {
+        llvm::Value* product = body.CreateAdd(body.CreateMul(body.CreateZExt(body.CreateLoad(int32, limb(body, a, i)), int64), factor), body.CreateLoad(int64, carry));
+        body.CreateStore(body.CreateTrunc(body.CreateURem(product, body.getInt64(LimbBase)), int32), limb(body, out, i));
+        body.CreateStore(body.CreateUDiv(product, body.getInt64(LimbBase)), carry);
+    });
+    llvm::Value* last = body.CreateLoad(int64, carry);
+    body.CreateCondBr(body.CreateIsNull(last), done, extra);
+
+    body.SetInsertPoint(extra);
+    body.CreateStore(body.CreateTrunc(last, int32), limb(body, out, na));
+    body.CreateRet(body.CreateAdd(na, body.getInt64(1)));
+
+    body.SetInsertPoint(done);
+    body.CreateRet(na);
+    return function;
+}
+
+llvm::Function* Decimals::divideSmall() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.divSmall")) return existing;
+
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Type* int32 = llvm::Type::getInt32Ty(context);
+    llvm::Function* function = create("neoluma.number.divSmall", int32, {limbPointer(), int64, int32, limbPointer()});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* a = function->getArg(0);
+    llvm::Value* na = function->getArg(1);
+    llvm::Value* divisor = body.CreateZExt(function->getArg(2), int64);
+    llvm::Value* out = function->getArg(3);
+
+    // from the top, what's left over goes into the next limb down
+    llvm::AllocaInst* rest = variable(body, int64, body.getInt64(0));
+    loop(body, body.getInt64(0), na, [&](llvm::Value* i) {
+        llvm::Value* index = body.CreateSub(body.CreateSub(na, i), body.getInt64(1));
+        llvm::Value* current = body.CreateZExt(body.CreateLoad(int32, limb(body, a, index)), int64);
+        llvm::Value* dividend = body.CreateAdd(body.CreateMul(body.CreateLoad(int64, rest), body.getInt64(LimbBase)), current);
+        body.CreateStore(body.CreateTrunc(body.CreateUDiv(dividend, divisor), int32), limb(body, out, index));
+        body.CreateStore(body.CreateURem(dividend, divisor), rest);
+    });
+    body.CreateRet(body.CreateTrunc(body.CreateLoad(int64, rest), int32));
+    return function;
+}
+
+llvm::Function* Decimals::multiplyLimbs() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.mulLimbs")) return existing;
+
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Type* int32 = llvm::Type::getInt32Ty(context);
+    llvm::Function* function = create("neoluma.number.mulLimbs", llvm::Type::getVoidTy(context), {limbPointer(), int64, limbPointer(), int64, limbPointer()});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* schoolbook = llvm::BasicBlock::Create(context, "schoolbook", function);
+    llvm::BasicBlock* karatsuba = llvm::BasicBlock::Create(context, "karatsuba", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* a = function->getArg(0);
+    llvm::Value* na = function->getArg(1);
+    llvm::Value* b = function->getArg(2);
+    llvm::Value* nb = function->getArg(3);
+    llvm::Value* out = function->getArg(4);
+    llvm::Value* count = body.CreateAdd(na, nb);
+    llvm::Value* large = body.CreateAnd(body.CreateICmpUGE(na, body.getInt64(KaratsubaThreshold)), body.CreateICmpUGE(nb, body.getInt64(KaratsubaThreshold)));
+    body.CreateCondBr(large, karatsuba, schoolbook);
+
+    // a limb times a limb, plus a limb and the carry, is below 2^63
+    body.SetInsertPoint(schoolbook);
+    body.CreateMemSet(out, body.getInt8(0), body.CreateMul(count, body.getInt64(4)), llvm::MaybeAlign(4));
+    llvm::AllocaInst* carry = variable(body, int64, nullptr);
+    loop(body, body.getInt64(0), na, [&](llvm::Value* i) {
+        llvm::Value* x = body.CreateZExt(body.CreateLoad(int32, limb(body, a, i)), int64);
+        body.CreateStore(body.getInt64(0), carry);
+        loop(body, body.getInt64(0), nb, [&](llvm::Value* j) {
+            llvm::Value* slot = limb(body, out, body.CreateAdd(i, j));
+            llvm::Value* product = body.CreateMul(x, body.CreateZExt(body.CreateLoad(int32, limb(body, b, j)), int64));
+            product = body.CreateAdd(body.CreateAdd(product, body.CreateZExt(body.CreateLoad(int32, slot), int64)), body.CreateLoad(int64, carry));
+            body.CreateStore(body.CreateTrunc(body.CreateURem(product, body.getInt64(LimbBase)), int32), slot);
+            body.CreateStore(body.CreateUDiv(product, body.getInt64(LimbBase)), carry);
+        });
+        body.CreateStore(body.CreateTrunc(body.CreateLoad(int64, carry), int32), limb(body, out, body.CreateAdd(i, nb)));
+    });
+    body.CreateRetVoid();
+
+    // a = a1·B^m + a0 and b = b1·B^m + b0: a0·b0 and a1·b1 go right where they belong in `out`, and the middle term is
+    // (a0 + a1)(b0 + b1) - a0·b0 - a1·b1, three multiplications instead of four
+    body.SetInsertPoint(karatsuba);
+    llvm::Value* half = body.CreateUDiv(body.CreateBinaryIntrinsic(llvm::Intrinsic::umin, na, nb), body.getInt64(2));
+    llvm::Value* a1 = limb(body, a, half);
+    llvm::Value* na1 = body.CreateSub(na, half);
+    llvm::Value* b1 = limb(body, b, half);
+    llvm::Value* nb1 = body.CreateSub(nb, half);
+    llvm::Value* twice = body.CreateMul(half, body.getInt64(2));
+    llvm::Value* high = limb(body, out, twice);
+    llvm::Value* highCount = body.CreateSub(count, twice);
+    body.CreateCall(function, {a, half, b, half, out});
+    body.CreateCall(function, {a1, na1, b1, nb1, high});
+
+    auto sum = [&](llvm::Value* upper, llvm::Value* upperCount, llvm::Value* lower) {
+        llvm::Value* result = allocateLimbs(body, body.CreateAdd(upperCount, body.getInt64(1)));
+        llvm::Value* carry = body.CreateCall(addLimbs(), {upper, upperCount, lower, half, result});
+        body.CreateStore(carry, limb(body, result, upperCount));
+        return result;
+    };
+    llvm::Value* sa = sum(a1, na1, a);
+    llvm::Value* nsa = body.CreateAdd(na1, body.getInt64(1));
+    llvm::Value* sb = sum(b1, nb1, b);
+    llvm::Value* nsb = body.CreateAdd(nb1, body.getInt64(1));
+    llvm::Value* nz = body.CreateAdd(nsa, nsb);
+    llvm::Value* middle = allocateLimbs(body, nz);
+    body.CreateCall(function, {sa, nsa, sb, nsb, middle});
+    body.CreateCall(subtractLimbs(), {middle, nz, out, twice, middle});
+    body.CreateCall(subtractLimbs(), {middle, nz, high, highCount, middle});
+    llvm::Value* middleCount = trim(body, middle, nz);
+    llvm::Value* shifted = limb(body, out, half);
+    body.CreateCall(addLimbs(), {shifted, body.CreateSub(count, half), middle, middleCount, shifted});
+    freeLimbs(body, sa);
+    freeLimbs(body, sb);
+    freeLimbs(body, middle);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Decimals::divideLimbs() {
+    if (llvm::Function* existing = module.getFunction("neoluma.number.divLimbs")) return existing;
+
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    llvm::Type* int32 = llvm::Type::getInt32Ty(context);
+    llvm::Function* function = create("neoluma.number.divLimbs", int64, {limbPointer(), int64, limbPointer(), int64, limbPointer(), limbPointer()});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* single = llvm::BasicBlock::Create(context, "single", function);
+    llvm::BasicBlock* general = llvm::BasicBlock::Create(context, "general", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* a = function->getArg(0);
+    llvm::Value* na = function->getArg(1);
+    llvm::Value* b = function->getArg(2);
+    llvm::Value* nb = function->getArg(3);
+    llvm::Value* quotient = function->getArg(4);
+    llvm::Value* remainder = function->getArg(5);
+    body.CreateCondBr(body.CreateICmpEQ(nb, body.getInt64(1)), single, general);
+
+    body.SetInsertPoint(single);
+    llvm::Value* rest = body.CreateCall(divideSmall(), {a, na, body.CreateLoad(int32, b), quotient});
+    body.CreateStore(rest, remainder);
+    body.CreateRet(body.CreateZExt(body.CreateIsNotNull(rest), int64));
+
+    // long division a limb at a time: the remainder gets the next limb of `a`, and the limb of the quotient is found
+    // between the bounds the top limbs give, by bisection
+    body.SetInsertPoint(general);
+    llvm::Value* product = allocateLimbs(body, body.CreateAdd(nb, body.getInt64(1)));
+    llvm::Value* top = body.CreateZExt(body.CreateLoad(int32, limb(body, b, body.CreateSub(nb, body.getInt64(1)))), int64);
+    llvm::AllocaInst* count = variable(body, int64, body.getInt64(0));
+    llvm::AllocaInst* low = variable(body, int64, nullptr);
+    llvm::AllocaInst* high = variable(body, int64, nullptr);
+    loop(body, body.getInt64(0), na, [&](llvm::Value* i) {
+        llvm::BasicBlock* estimate = llvm::BasicBlock::Create(context, "estimate", function);
+        llvm::BasicBlock* store = llvm::BasicBlock::Create(context, "store", function);
+        llvm::Value* index = body.CreateSub(body.CreateSub(na, i), body.getInt64(1));
+        llvm::Value* current = body.CreateLoad(int64, count);
+        body.CreateMemMove(limb(body, remainder, body.getInt64(1)), llvm::MaybeAlign(4), remainder, llvm::MaybeAlign(4), body.CreateMul(current, body.getInt64(4)));
+        body.CreateStore(body.CreateLoad(int32, limb(body, a, index)), remainder);
+        body.CreateStore(trim(body, remainder, body.CreateAdd(current, body.getInt64(1))), count);
+        body.CreateStore(body.getInt64(0), low);
+        body.CreateCondBr(body.CreateICmpUGE(body.CreateLoad(int64, count), nb), estimate, store);
+
+        // the remainder has nb or nb + 1 limbs, its top ones over b's top one bound the quotient's limb both ways
+        body.SetInsertPoint(estimate);
+        llvm::Value* remainderCount = body.CreateLoad(int64, count);
+        llvm::Value* first = body.CreateZExt(body.CreateLoad(int32, limb(body, remainder, body.CreateSub(remainderCount, body.getInt64(1)))), int64);
+        llvm::Value* second = body.CreateZExt(body.CreateLoad(int32, limb(body, remainder, body.CreateSub(remainderCount, body.getInt64(2)))), int64);
+        llvm::Value* leading = body.CreateSelect(body.CreateICmpEQ(remainderCount, nb), first, body.CreateAdd(body.CreateMul(first, body.getInt64(LimbBase)), second));
+        body.CreateStore(body.CreateUDiv(leading, body.CreateAdd(top, body.getInt64(1))), low);
+        llvm::Value* highest = body.CreateUDiv(body.CreateAdd(leading, body.getInt64(1)), top);
+        body.CreateStore(body.CreateBinaryIntrinsic(llvm::Intrinsic::umin, highest, body.getInt64(LimbBase - 1)), high);
+        loop(body, [&] { return body.CreateICmpULT(body.CreateLoad(int64, low), body.CreateLoad(int64, high)); }, [&] {
+            llvm::Value* lower = body.CreateLoad(int64, low);
+            llvm::Value* upper = body.CreateLoad(int64, high);
+            llvm::Value* middle = body.CreateLShr(body.CreateAdd(body.CreateAdd(lower, upper), body.getInt64(1)), 1);
+            llvm::Value* productCount = body.CreateCall(multiplySmall(), {b, nb, body.CreateTrunc(middle, int32), product});
+            llvm::Value* fits = body.CreateICmpSLE(body.CreateCall(compareLimbs(), {product, productCount, remainder, body.CreateLoad(int64, count)}), body.getInt32(0));
+            body.CreateStore(body.CreateSelect(fits, middle, lower), low);
+            body.CreateStore(body.CreateSelect(fits, upper, body.CreateSub(middle, body.getInt64(1))), high);
+        });
+        llvm::Value* digit = body.CreateTrunc(body.CreateLoad(int64, low), int32);
+        llvm::Value* productCount = trim(body, product, body.CreateCall(multiplySmall(), {b, nb, digit, product}));
+        body.CreateCall(subtractLimbs(), {remainder, body.CreateLoad(int64, count), product, productCount, remainder});
+        body.CreateStore(trim(body, remainder, body.CreateLoad(int64, count)), count);
+        body.CreateBr(store);
+
+        body.SetInsertPoint(store);
+        body.CreateStore(body.CreateTrunc(body.CreateLoad(int64, low), int32), limb(body, quotient, index));
+    });
+    freeLimbs(body, product);
+    body.CreateRet(body.CreateLoad(int64, count));
+    return function;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+// LLVM Primitives
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+
+#include "GarbageCollector.hpp"
+#include "ReferenceCounter.hpp"
+
+/* Decimals is the runtime of `number`, a decimal of any precision: a coefficient times 10 to an exponent. Like the
+ * other runtime pieces it's emitted into the modules that use it, with linkonce_odr linkage.
+ *
+ * A number is {i64 coefficient, i32 exponent, i32 length}, passed around by value. With a length of 0 the coefficient
+ * is the value itself and nothing is allocated: the operations are inlined where they're used, and are hardware
+ * arithmetic with overflow checks, an addition aligns the exponents and adds and that's all. Only when that overflows
+ * does an operation take its slow path, which works on limbs: the coefficient is then a pointer to |length| limbs of
+ * 9 decimal digits, the least significant first, and the sign of the length is the sign of the number. Limbs are
+ * multiplied by Karatsuba from KaratsubaThreshold limbs on, schoolbook below it. Every result that fits a coefficient
+ * again is made inline again.
+ *
+ * Numbers keep the exponent they were written with, like decimals for money do: 1.50 + 1.25 is 2.75 and 1.50 * 2 is
+ * 3.00. A quotient is exact if it can be, and rounded to the nearest of 34 significant digits if it can't. `%` has the
+ * sign of the dividend. A float becomes the decimal it prints as, 15 significant digits of a double and 7 of a float.
+ *
+ * The limbs an operation only needs for a while are malloc'd and freed by it. The limbs of a result go where the memory
+ * mode keeps strings: with `collector` they're an object of its heap, and a number is a root or traced wherever a
+ * string would be; with `counter` they're counted, a number holds a reference to them like a string does. Literals too
+ * big for a coefficient have their limbs in a constant, with a static header. Without either the limbs are malloc'd,
+ * and the IR Generator releases the result of an operation that's only an operand of the next one. Numbers kept in
+ * variables and collections share their limbs when they're copied, so those are never freed, like strings.
+ */
+struct Decimals {
+    // `errorStream` emits the FILE* of stderr where a builder is, division by zero is reported there
+    Decimals(llvm::Module& module, GarbageCollector* collector, ReferenceCounter* counter, std::function<llvm::Value*(llvm::IRBuilderBase&)> errorStream)
+        : module(module), context(module.getContext()), collector(collector), counter(counter), errorStream(std::move(errorStream)) {}
+
+    static llvm::StructType* numberType(llvm::LLVMContext& context); // {i64 coefficient, i32 exponent, i32 length}
+    static llvm::Value* limbs(llvm::IRBuilderBase& at, llvm::Value* number); // i8*: the object a number holds, null if it has none
+
+    // Conversions
+    llvm::Constant* constant(const std::string& literal); // digits, maybe a point and an exponent, exactly as written
+    llvm::Value* fromInteger(llvm::IRBuilderBase& at, llvm::Value* value, bool isSigned);
+    llvm::Value* fromReal(llvm::IRBuilderBase& at, llvm::Value* value); // a float or a double
+
+    // Operations, N (N, N) and inlined: their slow paths are calls
+    llvm::Function* add();
+    llvm::Function* subtract();
+    llvm::Function* multiply();
+    llvm::Function* divide(); // by zero stops the program
+    llvm::Function* remainder(); // the same
+    llvm::Function* negate(); // N (N)
+    llvm::Function* compare(); // i32 (N, N): -1, 0 or 1, 1.0 and 1 are equal
+    llvm::Function* release(); // void (N): frees its malloc'd limbs, for a number nothing else holds
+    // {i8*, i64} (N, i8* buffer, i64 capacity): the text and its length, terminated. In the buffer if it fits, at most
+    // FormatBuffer bytes are needed for an inline number.
+    llvm::Function* format();
+    static constexpr uint64_t FormatBuffer = 64;
+
+private:
+    llvm::Module& module;
+    llvm::LLVMContext& context;
+    GarbageCollector* collector;
+    ReferenceCounter* counter;
+    std::function<llvm::Value*(llvm::IRBuilderBase&)> errorStream;
+
+    llvm::Type* bytePointer();
+    llvm::Type* limbPointer(); // i32*
+    llvm::Type* sizeType(); // of the C library
+    llvm::Function* create(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters);
+    llvm::FunctionCallee libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters, bool variadic = false);
+    llvm::Function* failure(const std::string& name, const std::string& message); // void (), doesn't return
+
+    // Emitting
+    llvm::Value* number(llvm::IRBuilderBase& at, llvm::Value* coefficient, llvm::Value* exponent, llvm::Value* length);
+    llvm::Value* isNegative(llvm::IRBuilderBase& at, llvm::Value* number); // i1, inline or not
+    llvm::Value* power(llvm::IRBuilderBase& at, llvm::Value* exponent); // i64 10^exponent, of 0 to 18
+    llvm::Value* limb(llvm::IRBuilderBase& at, llvm::Value* limbs, llvm::Value* index); // i32*
+    llvm::Value* allocateLimbs(llvm::IRBuilderBase& at, llvm::Value* count);
+    llvm::Value* resultLimbs(llvm::IRBuilderBase& at, llvm::Value* count); // of a result, from the collector or the counter if there's one
+    void freeLimbs(llvm::IRBuilderBase& at, llvm::Value* limbs);
+    llvm::Value* digitCount(llvm::IRBuilderBase& at, llvm::Value* limb); // i64, 1 to 9
+    llvm::Value* digitCount(llvm::IRBuilderBase& at, llvm::Value* limbs, llvm::Value* count); // i64, of limbs without leading zeros
+    llvm::Value* trim(llvm::IRBuilderBase& at, llvm::Value* limbs, llvm::Value* count); // i64, the count without leading zero limbs
+    llvm::Value* inlineLimbs(llvm::IRBuilderBase& at, llvm::Value* coefficient); // [3 x i32]* of the frame, |coefficient|
+    llvm::AllocaInst* variable(llvm::IRBuilderBase& at, llvm::Type* type, llvm::Value* initial); // a slot of the function
+    // `while (condition()) body()` and `for (i = begin; i < end; i++) body(i)`, emitted where `at` is, leaving it after
+    void loop(llvm::IRBuilderBase& at, const std::function<llvm::Value*()>& condition, const std::function<void()>& body);
+    void loop(llvm::IRBuilderBase& at, llvm::Value* begin, llvm::Value* end, const std::function<void(llvm::Value*)>& body);
+    // Both inline, with their coefficients scaled to the smaller exponent, or a branch to `slow`. Leaves `at` where they are.
+    void align(llvm::IRBuilderBase& at, llvm::Value* left, llvm::Value* right, llvm::BasicBlock* slow,
+        llvm::Value*& leftCoefficient, llvm::Value*& rightCoefficient, llvm::Value*& exponent);
+
+    // Slow paths
+    llvm::Function* fromMagnitude(); // N (i128 magnitude, i1 negative, i32 exponent), of an unsigned magnitude
+    llvm::Function* fromDouble(); // N (double, i32 significant digits)
+    llvm::Function* addBig(); // N (N, N)
+    llvm::Function* multiplyBig();
+    llvm::Function* divideBig();
+    llvm::Function* remainderBig();
+    llvm::Function* compareBig(); // i32 (N, N)
+    llvm::Function* scaled(); // i32* (N, i32 exponent, i64* count): new limbs of |N| to `exponent`, at most its own, no leading zeros
+    llvm::Function* normalize(); // N (i32* limbs, i64 count, i1 negative, i32 exponent): inline if it fits, then the limbs are freed
+
+    // Limbs: an i32* and an i64 count for each
+    llvm::Function* compareLimbs(); // i32 (a, na, b, nb), neither with leading zeros
+    llvm::Function* addLimbs(); // i32 (a, na, b, nb, out): na >= nb, writes na limbs and returns the carry. `out` may be `a`.
+    llvm::Function* subtractLimbs(); // void (a, na, b, nb, out): a >= b, na >= nb, writes na limbs. `out` may be `a`.
+    llvm::Function* multiplySmall(); // i64 (a, na, i32 factor, out): factor below the base, writes and returns na or na + 1. `out` may be `a`.
+    llvm::Function* divideSmall(); // i32 (a, na, i32 divisor, out): writes na limbs and returns the remainder. `out` may be `a`.
+    llvm::Function* multiplyLimbs(); // void (a, na, b, nb, out): writes na + nb limbs
+    llvm::Function* divideLimbs(); // i64 (a, na, b, nb, quotient, remainder): b without leading zeros, writes na limbs of the quotient, returns the remainder's count
+};
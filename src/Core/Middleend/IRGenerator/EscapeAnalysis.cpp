@@ -0,0 +1,454 @@
+#include "EscapeAnalysis.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <unordered_set>
+
+#include "Core/Frontend/SemanticAnalysis/Types.hpp"
+
+namespace {
+
+void collectFunctions(std::vector<MemoryPtr<ASTNode>>& body, std::vector<FunctionNode*>& functions) {
+    for (auto& statement : body) {
+        if (statement->type == ASTNodeType::Function) {
+            auto* function = static_cast<FunctionNode*>(statement.get());
+            if (function->body && !function->isIntrinsic) functions.push_back(function);
+        }
+        else if (statement->type == ASTNodeType::Namespace) collectFunctions(static_cast<NamespaceNode*>(statement.get())->body, functions);
+    }
+}
+
+// Names of the variables an iterable reads its collections from: `xs` and `ys` of `xs.iter().zip(ys)`
+void iteratedNames(ASTNode* node, std::vector<std::string>& names) {
+    if (!node) return;
+    if (node->type == ASTNodeType::Variable) names.push_back(static_cast<VariableNode*>(node)->varName);
+    else if (node->type == ASTNodeType::MemberAccess) {
+        auto* access = static_cast<MemberAccessNode*>(node);
+        iteratedNames(access->parent.get(), names);
+        iteratedNames(access->val.get(), names);
+    }
+    else if (node->type == ASTNodeType::CallExpression)
+        for (auto& argument : static_cast<CallExpressionNode*>(node)->arguments) iteratedNames(argument.get(), names);
+}
+
+// `sum` or `collect` of `xs.iter().sum()`, what `node` is a consumer of iterators for
+bool isConsumer(MemberAccessNode* node) {
+    auto* call = node->val && node->val->type == ASTNodeType::CallExpression ? static_cast<CallExpressionNode*>(node->val.get()) : nullptr;
+    if (!call || call->resolvedFunction || !call->callee || call->callee->type != ASTNodeType::Variable) return false;
+    const std::string& name = static_cast<VariableNode*>(call->callee.get())->varName;
+    const Type* parent = node->parent->inferredType;
+    return (name == "sum" || name == "collect") && parent && parent->kind == Type::Kind::Iterator;
+}
+
+// Classes of one function body: union-find over its locals and allocations
+struct Flow {
+    using Id = size_t;
+
+    const std::unordered_map<const FunctionNode*, std::vector<bool>>& escapingParameters;
+    std::vector<Id> parent;
+    std::vector<bool> escapes;
+    std::vector<const ASTNode*> nodes;
+    std::vector<bool> isAllocation;
+    std::vector<std::pair<size_t, const ASTNode*>> regions; // depth and owner of the region each one is made in
+
+    std::vector<std::unordered_map<std::string, Id>> scopes;
+    std::vector<const ASTNode*> owners; // the function, then every loop body it's inside
+
+    std::unordered_set<const ASTNode*> assigned; // declarations
+    // Loops over collections being walked, with the names they read them from, and the ones that may drop an element
+    std::vector<std::pair<const ASTNode*, std::vector<std::string>>> iterating;
+    std::unordered_set<const ASTNode*> unstable;
+
+    // Loops around what's being looked at, and how many of them are around each declaration
+    std::vector<const ASTNode*> loops;
+    std::unordered_map<const ASTNode*, size_t> depths;
+    // Per loop, the locals declared outside it it appends to, with one append; unset once it does anything else
+    std::unordered_map<const ASTNode*, std::unordered_map<const ASTNode*, std::optional<const ASTNode*>>> appends;
+    std::unordered_set<const ASTNode*> captured, leaving; // locals a lambda sees, loops that return or throw
+    size_t lambdas = 0; // lambdas around what's being looked at
+    const ASTNode* appending = nullptr; // the `s` of `s = s + ...`, read by the append and nothing else
+
+    // A use of a local, an append if `site` is set
+    void use(const ASTNode* declaration, const ASTNode* site = nullptr) {
+        if (lambdas) captured.insert(declaration);
+        auto depth = depths.find(declaration);
+        if (depth == depths.end()) return;
+        for (size_t i = depth->second; i < loops.size(); i++) {
+            auto [it, added] = appends[loops[i]].try_emplace(declaration, site);
+            if (!site || lambdas) it->second.reset();
+        }
+    }
+
+    void disturbAll() { for (auto& [loop, names] : iterating) unstable.insert(loop); }
+    void disturb(const std::string& name) {
+        for (auto& [loop, names] : iterating)
+            if (std::find(names.begin(), names.end(), name) != names.end()) unstable.insert(loop);
+    }
+
+    Id add(const ASTNode* node, bool allocation) {
+        parent.push_back(parent.size());
+        escapes.push_back(false);
+        nodes.push_back(node);
+        isAllocation.push_back(allocation);
+        regions.emplace_back(owners.size() - 1, owners.back());
+        return parent.size() - 1;
+    }
+
+    Id find(Id id) {
+        while (parent[id] != id) id = parent[id] = parent[parent[id]];
+        return id;
+    }
+
+    void unite(Id a, std::optional<Id> b) {
+        if (!b) return;
+        a = find(a);
+        Id other = find(*b);
+        if (a == other) return;
+        parent[other] = a;
+        if (escapes[other]) escapes[a] = true;
+    }
+
+    void escape(std::optional<Id> id) { if (id) escapes[find(*id)] = true; }
+
+    Id declare(const std::string& name, const ASTNode* declaration) {
+        Id id = add(declaration, false);
+        scopes.back()[name] = id;
+        depths[declaration] = loops.size();
+        return id;
+    }
+
+    std::optional<Id> lookup(const std::string& name) const {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto it = scope->find(name);
+            if (it != scope->end()) return it->second;
+        }
+        return std::nullopt; // a global
+    }
+
+    bool parameterEscapes(const FunctionNode* function, size_t index) const {
+        if (function->isIntrinsic) return false;
+        if (function->isAsync) return true; // its task holds on to them after the call returns
+        auto it = escapingParameters.find(function);
+        return it == escapingParameters.end() || index >= it->second.size() || it->second[index];
+    }
+
+    // ==== Expressions ====
+
+    // The class of the string `node` evaluates to, if it's an allocation or a local
+    std::optional<Id> value(ASTNode* node) {
+        if (!node) return std::nullopt;
+        switch (node->type) {
+            case ASTNodeType::Literal: {
+                auto* literal = static_cast<LiteralNode*>(node);
+                if (!literal->isInterpolation()) return std::nullopt;
+                for (const auto& interpolation : literal->interpolations) value(interpolation.get()); // copied in, never kept
+                return add(node, true);
+            }
+            case ASTNodeType::Variable: {
+                std::optional<Id> local = lookup(static_cast<VariableNode*>(node)->varName);
+                if (local && node != appending) use(nodes[*local]);
+                return local;
+            }
+            case ASTNodeType::BinaryOperation: {
+                auto* binary = static_cast<BinaryOperationNode*>(node);
+                value(binary->leftOperand.get());
+                value(binary->rightOperand.get());
+                const Type* type = binary->leftOperand->inferredType;
+                if (binary->value == "+" && type && type->isPrimitive(ResolvedType::Str)) return add(node, true);
+                return std::nullopt;
+            }
+            case ASTNodeType::UnaryOperation:
+                if (node->value == "await") disturbAll(); // other tasks run in the meantime
+                value(static_cast<UnaryOperationNode*>(node)->operand.get());
+                return std::nullopt;
+            case ASTNodeType::CallExpression: call(static_cast<CallExpressionNode*>(node)); return std::nullopt;
+            case ASTNodeType::MemberAccess: {
+                // methods chain, xs.iter().map(f).sum() is built from the left
+                auto* access = static_cast<MemberAccessNode*>(node);
+                bool consumer = isConsumer(access);
+                if (consumer) {
+                    iterating.emplace_back(node, std::vector<std::string>());
+                    iteratedNames(access->parent.get(), iterating.back().second);
+                }
+                value(access->parent.get());
+                ASTNode* last = node;
+                while (last->type == ASTNodeType::MemberAccess) last = static_cast<MemberAccessNode*>(last)->val.get();
+                if (last && last->type == ASTNodeType::CallExpression) call(static_cast<CallExpressionNode*>(last));
+                if (consumer) iterating.pop_back();
+                return std::nullopt;
+            }
+            case ASTNodeType::Lambda: {
+                // generated inline where it's called back, so its locals are the function's. What it returns escapes.
+                auto* lambda = static_cast<LambdaNode*>(node);
+                scopes.emplace_back();
+                lambdas++;
+                for (auto& parameter : lambda->params)
+                    if (parameter->type == ASTNodeType::Variable) declare(static_cast<VariableNode*>(parameter.get())->varName, parameter.get());
+                block(lambda->body.get());
+                lambdas--;
+                scopes.pop_back();
+                return std::nullopt;
+            }
+            default:
+                // collections and the rest aren't generated natively, whatever they hold escapes
+                escapeAll(node);
+                return std::nullopt;
+        }
+    }
+
+    void call(CallExpressionNode* node) {
+        FunctionNode* function = node->resolvedFunction;
+        for (size_t i = 0; i < node->arguments.size(); i++) {
+            std::optional<Id> argument = value(node->arguments[i].get());
+            if (!function || parameterEscapes(function, i)) escape(argument);
+            // a function passed as a callback is called
+            const Type* type = node->arguments[i]->inferredType;
+            if (node->arguments[i]->type == ASTNodeType::Variable && type && type->kind == Type::Kind::Function) disturbAll();
+        }
+        // anything the program does may drop anything; `set` and `remove` of collections drop what they replace
+        std::string method = !function && node->callee && node->callee->type == ASTNodeType::Variable ? static_cast<VariableNode*>(node->callee.get())->varName : "";
+        if ((function && !function->isIntrinsic) || method == "set" || method == "remove") disturbAll();
+    }
+
+    void escapeAll(ASTNode* node) {
+        switch (node->type) {
+            case ASTNodeType::Array: for (auto& element : static_cast<ArrayNode*>(node)->elements) escape(value(element.get())); break;
+            case ASTNodeType::Set: for (auto& element : static_cast<SetNode*>(node)->elements) escape(value(element.get())); break;
+            case ASTNodeType::Tuple: for (auto& element : static_cast<TupleNode*>(node)->elements) escape(value(element.get())); break;
+            case ASTNodeType::Dict:
+                for (auto& [key, element] : static_cast<DictNode*>(node)->elements) { escape(value(key.get())); escape(value(element.get())); }
+                break;
+            default: break;
+        }
+    }
+
+    // ==== Statements ====
+
+    void block(ASTNode* node) {
+        if (!node) return;
+        scopes.emplace_back();
+        if (node->type == ASTNodeType::Block)
+            for (auto& statement : static_cast<BlockNode*>(node)->statements) this->statement(statement.get());
+        else statement(node);
+        scopes.pop_back();
+    }
+
+    void statement(ASTNode* node) {
+        switch (node->type) {
+            case ASTNodeType::Block: block(node); break;
+            case ASTNodeType::Declaration: {
+                auto* declaration = static_cast<DeclarationNode*>(node);
+                std::optional<Id> initial = value(declaration->value.get()); // `x := x + "a"` reads the outer x
+                unite(declare(declaration->variable->varName, node), initial);
+                break;
+            }
+            case ASTNodeType::Assignment: {
+                auto* assignment = static_cast<AssignmentNode*>(node);
+                bool append = !EscapeAnalysis::appendedOperands(assignment).empty();
+                if (append && assignment->op == "=") {
+                    ASTNode* left = assignment->value.get();
+                    while (left->type == ASTNodeType::BinaryOperation) left = static_cast<BinaryOperationNode*>(left)->leftOperand.get();
+                    appending = left;
+                }
+                std::optional<Id> assigned = value(assignment->value.get());
+                appending = nullptr;
+                // `x += y` on strings makes a new one, right here
+                const Type* type = assignment->variable->inferredType;
+                if (assignment->op == "+=" && type && type->isPrimitive(ResolvedType::Str)) assigned = add(node, true);
+                else if (assignment->op != "=") assigned = std::nullopt;
+
+                std::optional<Id> target;
+                if (assignment->variable->type == ASTNodeType::Variable) {
+                    const std::string& name = static_cast<VariableNode*>(assignment->variable.get())->varName;
+                    target = lookup(name);
+                    disturb(name);
+                }
+                if (target) {
+                    this->assigned.insert(nodes[*target]);
+                    // what the loop leaves is allocated like the append's string: `s += ...` makes it, `s + ...` does
+                    use(nodes[*target], !append ? nullptr : assignment->op == "=" ? assignment->value.get() : node);
+                }
+                if (target) unite(*target, assigned);
+                else escape(assigned); // a global or a member
+                break;
+            }
+            case ASTNodeType::IfStatement: {
+                auto* branch = static_cast<IfNode*>(node);
+                value(branch->condition.get());
+                block(branch->thenBlock.get());
+                block(branch->elseBlock.get());
+                break;
+            }
+            case ASTNodeType::WhileLoop: {
+                auto* loop = static_cast<WhileLoopNode*>(node);
+                loops.push_back(node); // the condition is evaluated on every iteration too
+                value(loop->condition.get()); // evaluated outside the body, its strings belong to the enclosing region
+                owners.push_back(node);
+                block(loop->body.get());
+                owners.pop_back();
+                loops.pop_back();
+                break;
+            }
+            case ASTNodeType::ForLoop: {
+                auto* loop = static_cast<ForLoopNode*>(node);
+                // its callbacks run while it does
+                iterating.emplace_back(node, std::vector<std::string>());
+                iteratedNames(loop->iterable.get(), iterating.back().second);
+                escape(value(loop->iterable.get()));
+                owners.push_back(node);
+                loops.push_back(node);
+                scopes.emplace_back();
+                declare(loop->variable->varName, node);
+                for (auto& variable : loop->unpacked) declare(variable->varName, variable.get());
+                block(loop->body.get());
+                scopes.pop_back();
+                loops.pop_back();
+                owners.pop_back();
+                iterating.pop_back();
+                break;
+            }
+            case ASTNodeType::Switch: {
+                auto* switchNode = static_cast<SwitchNode*>(node);
+                value(switchNode->expression.get());
+                for (auto& caseNode : switchNode->cases) {
+                    value(caseNode->condition.get());
+                    block(caseNode->body.get());
+                }
+                if (switchNode->defaultCase) block(switchNode->defaultCase->body.get());
+                break;
+            }
+            case ASTNodeType::TryCatch: {
+                auto* tryCatch = static_cast<TryCatchNode*>(node);
+                block(tryCatch->tryBlock.get());
+                scopes.emplace_back();
+                if (tryCatch->exception) declare(tryCatch->exception->varName, node);
+                block(tryCatch->catchBlock.get());
+                scopes.pop_back();
+                break;
+            }
+            case ASTNodeType::ReturnStatement:
+                escape(value(static_cast<ReturnStatementNode*>(node)->expression.get()));
+                if (!lambdas) leaving.insert(loops.begin(), loops.end());
+                break;
+            case ASTNodeType::ThrowStatement:
+                escape(value(static_cast<ThrowStatementNode*>(node)->expression.get()));
+                leaving.insert(loops.begin(), loops.end());
+                break;
+            case ASTNodeType::Function: case ASTNodeType::Class: case ASTNodeType::Import: break;
+            default: value(node); break; // expression statement
+        }
+    }
+};
+
+} // namespace
+
+void EscapeAnalysis::analyzeProgram(const std::vector<ModuleNode*>& modules) {
+    escapingParameters.clear();
+    regions.clear();
+    locals.clear();
+    assigned.clear();
+    unstable.clear();
+    appended.clear();
+
+    std::vector<FunctionNode*> functions;
+    for (ModuleNode* module : modules)
+        if (module) collectFunctions(module->body, functions);
+    for (FunctionNode* function : functions) escapingParameters[function].assign(function->parameters.size(), false);
+
+    // parameters only ever start escaping, so this stops after at most one round per parameter
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (FunctionNode* function : functions) changed |= analyzeFunction(function, false);
+    }
+    for (FunctionNode* function : functions) analyzeFunction(function, true);
+}
+
+bool EscapeAnalysis::analyzeFunction(FunctionNode* function, bool record) {
+    Flow flow{escapingParameters};
+    flow.owners.push_back(function);
+    flow.scopes.emplace_back();
+    std::vector<Flow::Id> parameters;
+    for (auto& parameter : function->parameters) parameters.push_back(flow.declare(parameter->parameterName, parameter.get()));
+    flow.block(function->body.get());
+
+    bool changed = false;
+    std::vector<bool>& escaping = escapingParameters[function];
+    for (size_t i = 0; i < parameters.size(); i++) {
+        if (escaping[i] || !flow.escapes[flow.find(parameters[i])]) continue;
+        escaping[i] = true;
+        changed = true;
+    }
+    if (!record) return changed;
+    assigned.insert(flow.assigned.begin(), flow.assigned.end());
+    unstable.insert(flow.unstable.begin(), flow.unstable.end());
+    for (auto& [loop, locals] : flow.appends) {
+        if (flow.leaving.contains(loop)) continue;
+        for (auto& [declaration, site] : locals)
+            if (site && !flow.captured.contains(declaration)) appended[loop].push_back(Append{declaration, *site});
+    }
+
+    // the region of a class is the one of its outermost member, they're all inside it
+    std::unordered_map<Flow::Id, std::pair<size_t, const ASTNode*>> classRegions;
+    std::unordered_map<Flow::Id, bool> allocates;
+    for (Flow::Id id = 0; id < flow.nodes.size(); id++) {
+        Flow::Id root = flow.find(id);
+        auto [it, added] = classRegions.try_emplace(root, flow.regions[id]);
+        if (!added && flow.regions[id].first < it->second.first) it->second = flow.regions[id];
+        else if (!added && flow.regions[id].first == it->second.first && flow.regions[id].second != it->second.second) it->second = {0, function};
+        if (flow.isAllocation[id]) allocates[root] = true;
+    }
+
+    for (Flow::Id id = 0; id < flow.nodes.size(); id++) {
+        Flow::Id root = flow.find(id);
+        if (flow.escapes[root] || !allocates.contains(root)) continue;
+        const ASTNode* owner = classRegions[root].second;
+        if (flow.isAllocation[id]) regions[flow.nodes[id]] = owner;
+        else locals[owner].push_back(flow.nodes[id]);
+        locals.try_emplace(owner);
+    }
+    return changed;
+}
+
+const ASTNode* EscapeAnalysis::regionOf(const ASTNode* allocation) const {
+    auto it = regions.find(allocation);
+    return it == regions.end() ? nullptr : it->second;
+}
+
+bool EscapeAnalysis::parameterEscapes(const FunctionNode* function, size_t index) const {
+    return Flow{escapingParameters}.parameterEscapes(function, index);
+}
+
+const std::vector<EscapeAnalysis::Append>& EscapeAnalysis::appendedLocals(const ASTNode* loop) const {
+    static const std::vector<Append> none;
+    auto it = appended.find(loop);
+    return it == appended.end() ? none : it->second;
+}
+
+std::vector<ASTNode*> EscapeAnalysis::appendedOperands(AssignmentNode* assignment) {
+    const Type* type = assignment->variable->inferredType;
+    if (!type || !type->isPrimitive(ResolvedType::Str) || assignment->variable->type != ASTNodeType::Variable || !assignment->value) return {};
+    if (assignment->op == "+=") return {assignment->value.get()};
+    if (assignment->op != "=") return {};
+
+    // down the left operands of the chain, to the variable itself
+    std::vector<ASTNode*> operands;
+    ASTNode* node = assignment->value.get();
+    while (node && node->type == ASTNodeType::BinaryOperation && node->value == "+") {
+        auto* binary = static_cast<BinaryOperationNode*>(node);
+        const Type* left = binary->leftOperand->inferredType;
+        if (!left || !left->isPrimitive(ResolvedType::Str)) return {};
+        operands.push_back(binary->rightOperand.get());
+        node = binary->leftOperand.get();
+    }
+    const std::string& name = static_cast<VariableNode*>(assignment->variable.get())->varName;
+    if (operands.empty() || !node || node->type != ASTNodeType::Variable || static_cast<VariableNode*>(node)->varName != name) return {};
+    std::reverse(operands.begin(), operands.end());
+    return operands;
+}
+
+const std::vector<const ASTNode*>& EscapeAnalysis::regionLocals(const ASTNode* owner) const {
+    static const std::vector<const ASTNode*> none;
+    auto it = locals.find(owner);
+    return it == locals.end() ? none : it->second;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Core/Frontend/Nodes.hpp"
+
+/* Escape Analysis finds the strings the IR Generator can put in a region instead of the heap: the ones that never
+ * leave the function, so nothing can see them after it returns, or after the loop iteration that made them.
+ *
+ * Allocations are the places that make a new string: `+` on strings (`+=` included) and interpolated literals.
+ * Within a function, an allocation and the locals it can end up in are one class, merged on every declaration and
+ * assignment, without looking at the order of statements. A class escapes if any of it is returned, stored to a
+ * global, or passed to a parameter that escapes in the function called. Parameters escape the same way, so that's a
+ * fixed point over the whole program; intrinsics only read their arguments.
+ *
+ * A class that doesn't escape lives in the region of the innermost function or loop body holding all of it. Anything
+ * the analysis doesn't understand escapes.
+ *
+ * On the way it notes what ARC asks about: which locals are ever assigned, and which loops over collections may see
+ * an element of them dropped while they run, so the elements they give can't be borrowed. And which string locals a
+ * loop does nothing with but `+=`: the loop can append to a buffer of its own instead of copying the string every time.
+ */
+struct EscapeAnalysis {
+    void analyzeProgram(const std::vector<ModuleNode*>& modules);
+
+    // The FunctionNode or loop whose region `allocation` goes to, nullptr for the heap
+    const ASTNode* regionOf(const ASTNode* allocation) const;
+    bool hasRegion(const ASTNode* owner) const { return locals.contains(owner); }
+    // Declarations of the locals that may hold a string of the region of `owner`
+    const std::vector<const ASTNode*>& regionLocals(const ASTNode* owner) const;
+
+    // A parameter escapes if what's passed to it can outlive the call
+    bool parameterEscapes(const FunctionNode* function, size_t index) const;
+    // The declaration of a local (a DeclarationNode, a parameter, a for loop for its variable) is assigned after it
+    bool isAssigned(const ASTNode* declaration) const { return assigned.contains(declaration); }
+    // Nothing a for loop or a `sum`/`collect` runs (its body, its callbacks) can drop a reference to an element of the
+    // collections it goes through: it assigns none of the variables they're read from, doesn't `set` or `remove` in
+    // any collection, doesn't call functions of the program and doesn't await
+    bool isStable(const ASTNode* loop) const { return !unstable.contains(loop); }
+
+    // A string local declared outside a loop that only appends to it (`+=`, or `s = s + ...`): nothing in the loop reads it or assigns it
+    // otherwise, no lambda sees it, and the loop doesn't return or throw, so it's read again only once the loop is over
+    struct Append {
+        const ASTNode* declaration;
+        const ASTNode* site; // one of the appends, the string the loop leaves goes to its region
+    };
+    const std::vector<Append>& appendedLocals(const ASTNode* loop) const;
+    // What an assignment appends to the string local it assigns: the value of `s += a`, `a` and `b` of `s = s + a + b`.
+    // Empty if it isn't an append.
+    static std::vector<ASTNode*> appendedOperands(AssignmentNode* assignment);
+
+private:
+    std::unordered_map<const FunctionNode*, std::vector<bool>> escapingParameters;
+    std::unordered_map<const ASTNode*, const ASTNode*> regions; // allocation -> owner
+    std::unordered_map<const ASTNode*, std::vector<const ASTNode*>> locals; // owner -> locals, for every owner with a region
+    std::unordered_set<const ASTNode*> assigned, unstable;
+    std::unordered_map<const ASTNode*, std::vector<Append>> appended; // loop -> locals
+
+    bool analyzeFunction(FunctionNode* function, bool record); // true if a parameter was found to escape
+};
@@ -0,0 +1,1088 @@
+#include "Executor.hpp"
+
+// LLVM Primitives
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Intrinsics.h"
+#if LLVM_VERSION_MAJOR >= 17
+#include "llvm/TargetParser/Triple.h"
+#else
+#include "llvm/ADT/Triple.h"
+#endif
+
+#include "Pointers.hpp"
+
+static constexpr uint64_t PromiseAlignment = 16; // both ends of llvm.coro.promise need it, and it's the same for every task
+static constexpr uint64_t SyncSize = 64; // bytes of a pthread mutex or condition variable, more than any C library takes
+static constexpr uint64_t MaxEvents = 64; // taken by one epoll_wait
+static constexpr uint64_t InitialRing = 64, InitialTimers = 16, InitialText = 4096;
+
+// Linux
+static constexpr int32_t ProcessorsOnline = 84; // _SC_NPROCESSORS_ONLN
+static constexpr int32_t MonotonicClock = 1;
+static constexpr int32_t SeekCurrent = 1;
+enum OpenFlag : int32_t { ReadOnly = 0, WriteOnly = 01, Create = 0100, Truncate = 01000, NonBlocking = 04000, CloseOnExec = 02000000 };
+enum ErrorNumber : int32_t { Interrupted = 4, WouldBlock = 11, Exists = 17 };
+enum PollEvent : uint32_t { Readable = 1, Writable = 4, OneShot = 1u << 30 };
+enum PollControl : int32_t { Add = 1, Remove = 2, Modify = 3 };
+
+enum WorkerField : unsigned { Lock, Head = 2, Tail, Capacity, Ring };
+enum TimerField : unsigned { Deadline, Task };
+enum PromiseField : unsigned { PromiseWaiter, PromiseResult };
+
+// ==== Helpers ====
+
+llvm::PointerType* Executor::taskType(llvm::LLVMContext& context) {
+    llvm::StructType* type = llvm::StructType::getTypeByName(context, "neoluma.task");
+    if (!type) type = llvm::StructType::create(context, "neoluma.task");
+    return pointerTo(type);
+}
+
+llvm::StructType* Executor::promiseType(llvm::LLVMContext& context, llvm::Type* result) {
+    llvm::Type* waiter = llvm::Type::getInt64Ty(context);
+    if (!result || result->isVoidTy()) return llvm::StructType::get(context, llvm::ArrayRef<llvm::Type*>(waiter));
+    return llvm::StructType::get(context, {waiter, result});
+}
+
+llvm::Type* Executor::bytePointer() { return pointerTo(llvm::Type::getInt8Ty(context)); }
+
+llvm::Type* Executor::sizeType() { return module.getDataLayout().getIntPtrType(context); }
+
+llvm::StructType* Executor::workerType() {
+    if (llvm::StructType* type = llvm::StructType::getTypeByName(context, "neoluma.executor.worker")) return type;
+    llvm::Type* i64 = llvm::Type::getInt64Ty(context);
+    // padded to 64 bytes, so two workers never share a cache line
+    return llvm::StructType::create(context, {llvm::Type::getInt32Ty(context), llvm::Type::getInt32Ty(context), i64, i64, i64,
+        pointerTo(bytePointer()), llvm::ArrayType::get(llvm::Type::getInt8Ty(context), 24)}, "neoluma.executor.worker");
+}
+
+llvm::StructType* Executor::timerType() {
+    return llvm::StructType::get(context, {llvm::Type::getInt64Ty(context), bytePointer()});
+}
+
+llvm::StructType* Executor::eventType() {
+    // {u32 events, u64 data}, which x86-64 packs so the old 32-bit layout still works
+    llvm::Triple triple(module.getTargetTriple());
+    return llvm::StructType::get(context, {llvm::Type::getInt32Ty(context), llvm::Type::getInt64Ty(context)}, triple.getArch() == llvm::Triple::x86_64);
+}
+
+llvm::GlobalVariable* Executor::state(const std::string& name, llvm::Type* type) {
+    std::string symbol = "neoluma.executor." + name;
+    if (llvm::GlobalVariable* existing = module.getNamedGlobal(symbol)) return existing;
+    auto* global = new llvm::GlobalVariable(module, type, false, llvm::GlobalValue::LinkOnceODRLinkage, llvm::Constant::getNullValue(type), symbol);
+    if (type->isArrayTy()) global->setAlignment(llvm::Align(16)); // a mutex or a condition variable
+    if (name == "self") {
+        // the worker running on this thread, -1 on the others
+        global->setInitializer(llvm::ConstantInt::getSigned(type, -1));
+        global->setThreadLocal(true);
+    }
+    return global;
+}
+
+llvm::Function* Executor::create(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters) {
+    return llvm::Function::Create(llvm::FunctionType::get(result, parameters, false), llvm::GlobalValue::LinkOnceODRLinkage, name, module);
+}
+
+llvm::FunctionCallee Executor::libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters, bool variadic) {
+    return module.getOrInsertFunction(name, llvm::FunctionType::get(result, parameters, variadic));
+}
+
+llvm::Function* Executor::intrinsic(llvm::Intrinsic::ID id, llvm::ArrayRef<llvm::Type*> types) {
+#if LLVM_VERSION_MAJOR >= 20
+    return llvm::Intrinsic::getOrInsertDeclaration(&module, id, types);
+#else
+    return llvm::Intrinsic::getDeclaration(&module, id, types);
+#endif
+}
+
+llvm::Function* Executor::failure() {
+    if (llvm::Function* existing = module.getFunction("neoluma.fs.failed")) return existing;
+
+    llvm::Function* function = create("neoluma.fs.failed", llvm::Type::getVoidTy(context), {bytePointer(), bytePointer()});
+    function->addFnAttr(llvm::Attribute::NoReturn);
+    function->addFnAttr(llvm::Attribute::Cold);
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* error = errorNumber(body); // before anything else can change it
+    body.CreateCall(libc("fflush", body.getInt32Ty(), {bytePointer()}), {llvm::Constant::getNullValue(bytePointer())}); // what the program printed comes first
+    llvm::Value* reason = body.CreateCall(libc("strerror", bytePointer(), {body.getInt32Ty()}), {error});
+    body.CreateCall(libc("fprintf", body.getInt32Ty(), {bytePointer(), bytePointer()}, true), {errorStream(body), function->getArg(0), function->getArg(1), reason});
+    body.CreateCall(libc("abort", body.getVoidTy(), {}));
+    body.CreateUnreachable();
+    return function;
+}
+
+llvm::AllocaInst* Executor::variable(llvm::IRBuilderBase& at, llvm::Type* type, llvm::Value* initial) {
+    llvm::BasicBlock& entry = at.GetInsertBlock()->getParent()->getEntryBlock();
+    llvm::IRBuilder<> start(&entry, entry.begin());
+    llvm::AllocaInst* slot = start.CreateAlloca(type);
+    if (initial) at.CreateStore(initial, slot);
+    return slot;
+}
+
+void Executor::loop(llvm::IRBuilderBase& at, const std::function<llvm::Value*()>& condition, const std::function<void()>& body) {
+    llvm::Function* function = at.GetInsertBlock()->getParent();
+    llvm::BasicBlock* header = llvm::BasicBlock::Create(context, "loop", function);
+    llvm::BasicBlock* inside = llvm::BasicBlock::Create(context, "loop.body", function);
+    llvm::BasicBlock* after = llvm::BasicBlock::Create(context, "loop.end", function);
+    at.CreateBr(header);
+
+    at.SetInsertPoint(header);
+    at.CreateCondBr(condition(), inside, after);
+    at.SetInsertPoint(inside);
+    body();
+    at.CreateBr(header);
+    at.SetInsertPoint(after);
+}
+
+void Executor::ifThen(llvm::IRBuilderBase& at, llvm::Value* condition, const std::function<void()>& body) {
+    llvm::Function* function = at.GetInsertBlock()->getParent();
+    llvm::BasicBlock* then = llvm::BasicBlock::Create(context, "then", function);
+    llvm::BasicBlock* after = llvm::BasicBlock::Create(context, "then.end", function);
+    at.CreateCondBr(condition, then, after);
+    at.SetInsertPoint(then);
+    body();
+    at.CreateBr(after);
+    at.SetInsertPoint(after);
+}
+
+static llvm::LoadInst* atomicLoad(llvm::IRBuilderBase& at, llvm::Type* type, llvm::Value* pointer,
+    llvm::AtomicOrdering ordering = llvm::AtomicOrdering::SequentiallyConsistent) {
+    llvm::LoadInst* load = at.CreateLoad(type, pointer);
+    load->setAtomic(ordering);
+    return load;
+}
+
+static void atomicStore(llvm::IRBuilderBase& at, llvm::Value* value, llvm::Value* pointer,
+    llvm::AtomicOrdering ordering = llvm::AtomicOrdering::SequentiallyConsistent) {
+    at.CreateStore(value, pointer)->setAtomic(ordering);
+}
+
+static llvm::Value* atomicAdd(llvm::IRBuilderBase& at, llvm::Value* pointer, int64_t value) {
+    return at.CreateAtomicRMW(llvm::AtomicRMWInst::Add, pointer, at.getInt64(value), llvm::MaybeAlign(), llvm::AtomicOrdering::SequentiallyConsistent);
+}
+
+void Executor::lock(llvm::IRBuilderBase& at, llvm::Value* spinlock) {
+    loop(at, [&] {
+        llvm::Value* held = at.CreateAtomicRMW(llvm::AtomicRMWInst::Xchg, spinlock, at.getInt32(1), llvm::MaybeAlign(), llvm::AtomicOrdering::Acquire);
+        return at.CreateICmpNE(held, at.getInt32(0));
+    }, [] {});
+}
+
+void Executor::unlock(llvm::IRBuilderBase& at, llvm::Value* spinlock) {
+    atomicStore(at, at.getInt32(0), spinlock, llvm::AtomicOrdering::Release);
+}
+
+llvm::Value* Executor::waiter(llvm::IRBuilderBase& at, llvm::Value* task) {
+    // the waiter comes first in every promise, so it's found without knowing the result
+    llvm::Value* handle = at.CreatePointerCast(task, bytePointer());
+    llvm::Value* promise = at.CreateCall(intrinsic(llvm::Intrinsic::coro_promise), {handle, at.getInt32(PromiseAlignment), at.getFalse()});
+    return at.CreatePointerCast(promise, pointerTo(at.getInt64Ty()));
+}
+
+llvm::Value* Executor::errorNumber(llvm::IRBuilderBase& at) {
+    llvm::Value* location = at.CreateCall(libc("__errno_location", pointerTo(at.getInt32Ty()), {}));
+    return at.CreateLoad(at.getInt32Ty(), location);
+}
+
+void Executor::wait(llvm::IRBuilderBase& at, const Coroutine& coroutine, llvm::Value* descriptor, uint32_t events) {
+    llvm::Type* i32 = at.getInt32Ty();
+    llvm::StructType* type = eventType();
+    llvm::AllocaInst* event = variable(at, type, nullptr);
+    at.CreateStore(at.getInt32(events | OneShot), at.CreateStructGEP(type, event, 0));
+    at.CreateStore(at.CreatePtrToInt(coroutine.handle, at.getInt64Ty()), at.CreateStructGEP(type, event, 1));
+    llvm::FunctionCallee control = libc("epoll_ctl", i32, {i32, i32, i32, pointerTo(type)});
+    llvm::Value* poll = at.CreateLoad(i32, state("epoll", i32));
+
+    suspend(at, coroutine, [&](llvm::IRBuilderBase& before) {
+        // a descriptor waited for before is still registered, one shot left it disabled
+        llvm::AllocaInst* result = variable(before, i32, before.CreateCall(control, {poll, before.getInt32(Add), descriptor, event}));
+        ifThen(before, before.CreateICmpSLT(before.CreateLoad(i32, result), before.getInt32(0)), [&] {
+            ifThen(before, before.CreateICmpEQ(errorNumber(before), before.getInt32(Exists)), [&] {
+                before.CreateStore(before.CreateCall(control, {poll, before.getInt32(Modify), descriptor, event}), result);
+            });
+        });
+        // epoll can't wait for it: try again on the next turn rather than never
+        ifThen(before, before.CreateICmpSLT(before.CreateLoad(i32, result), before.getInt32(0)), [&] {
+            before.CreateCall(scheduleFunction(), {coroutine.handle});
+        });
+    });
+    at.CreateCall(control, {poll, at.getInt32(Remove), descriptor, llvm::Constant::getNullValue(pointerTo(type))});
+}
+
+// ==== Coroutines ====
+
+Executor::Coroutine Executor::begin(llvm::IRBuilderBase& at, llvm::Function* function, llvm::Type* result) {
+    // the coroutine passes only split functions marked for it
+#if LLVM_VERSION_MAJOR >= 15
+    function->setPresplitCoroutine();
+#else
+    function->addFnAttr("coroutine.presplit", "0");
+#endif
+    llvm::StructType* promise = promiseType(context, result);
+    llvm::Value* none = llvm::Constant::getNullValue(bytePointer());
+    Coroutine coroutine;
+    coroutine.promise = variable(at, promise, nullptr);
+    coroutine.promise->setAlignment(llvm::Align(PromiseAlignment));
+    coroutine.id = at.CreateCall(intrinsic(llvm::Intrinsic::coro_id),
+        {at.getInt32(PromiseAlignment), at.CreatePointerCast(coroutine.promise, bytePointer()), none, none});
+
+    // the frame is malloc'd unless LLVM can put it in the caller's
+    llvm::BasicBlock* entry = at.GetInsertBlock();
+    llvm::BasicBlock* allocate = llvm::BasicBlock::Create(context, "coroutine.allocate", function);
+    llvm::BasicBlock* framed = llvm::BasicBlock::Create(context, "coroutine.begin", function);
+    at.CreateCondBr(at.CreateCall(intrinsic(llvm::Intrinsic::coro_alloc), {coroutine.id}), allocate, framed);
+
+    at.SetInsertPoint(allocate);
+    llvm::Value* size = at.CreateZExtOrTrunc(at.CreateCall(intrinsic(llvm::Intrinsic::coro_size, {at.getInt64Ty()})), sizeType());
+    llvm::Value* memory = at.CreateCall(libc("malloc", bytePointer(), {sizeType()}), {size});
+    at.CreateBr(framed);
+
+    at.SetInsertPoint(framed);
+    llvm::PHINode* frame = at.CreatePHI(bytePointer(), 2);
+    frame->addIncoming(none, entry);
+    frame->addIncoming(memory, allocate);
+    coroutine.handle = at.CreateCall(intrinsic(llvm::Intrinsic::coro_begin), {coroutine.id, frame});
+    at.CreateStore(at.getInt64(0), at.CreateStructGEP(promise, coroutine.promise, PromiseWaiter));
+
+    // where it's left: the ramp returns the handle, a destroyed one frees its frame first
+    coroutine.suspended = llvm::BasicBlock::Create(context, "coroutine.suspended", function);
+    coroutine.cleanup = llvm::BasicBlock::Create(context, "coroutine.cleanup", function);
+    llvm::IRBuilder<> end(coroutine.suspended);
+#if LLVM_VERSION_MAJOR >= 18
+    end.CreateCall(intrinsic(llvm::Intrinsic::coro_end), {coroutine.handle, end.getFalse(), llvm::ConstantTokenNone::get(context)});
+#else
+    end.CreateCall(intrinsic(llvm::Intrinsic::coro_end), {coroutine.handle, end.getFalse()});
+#endif
+    end.CreateRet(end.CreatePointerCast(coroutine.handle, function->getReturnType()));
+
+    end.SetInsertPoint(coroutine.cleanup);
+    llvm::Value* allocated = end.CreateCall(intrinsic(llvm::Intrinsic::coro_free), {coroutine.id, coroutine.handle});
+    ifThen(end, end.CreateIsNotNull(allocated), [&] { end.CreateCall(libc("free", end.getVoidTy(), {bytePointer()}), {allocated}); });
+    end.CreateBr(coroutine.suspended);
+
+    coroutine.start = llvm::BasicBlock::Create(context, "coroutine.start", function);
+    at.CreateBr(coroutine.start);
+    at.SetInsertPoint(coroutine.start);
+    return coroutine;
+}
+
+void Executor::suspend(llvm::IRBuilderBase& at, const Coroutine& coroutine, const std::function<void(llvm::IRBuilderBase&)>& before) {
+    llvm::Value* save = at.CreateCall(intrinsic(llvm::Intrinsic::coro_save), {coroutine.handle});
+    if (before) before(at);
+    llvm::Value* suspension = at.CreateCall(intrinsic(llvm::Intrinsic::coro_suspend), {save, at.getFalse()});
+    llvm::BasicBlock* resumed = llvm::BasicBlock::Create(context, "coroutine.resumed", at.GetInsertBlock()->getParent());
+    llvm::SwitchInst* next = at.CreateSwitch(suspension, coroutine.suspended, 2);
+    next->addCase(at.getInt8(0), resumed);
+    next->addCase(at.getInt8(1), coroutine.cleanup);
+    at.SetInsertPoint(resumed);
+}
+
+void Executor::start(llvm::IRBuilderBase& at, const Coroutine& coroutine) {
+    suspend(at, coroutine, [&](llvm::IRBuilderBase& before) { before.CreateCall(scheduleFunction(), {coroutine.handle}); });
+}
+
+void Executor::finish(llvm::IRBuilderBase& at, Coroutine& coroutine, llvm::Value* result) {
+    llvm::StructType* promise = llvm::cast<llvm::StructType>(coroutine.promise->getAllocatedType());
+    if (result) at.CreateStore(result, at.CreateStructGEP(promise, coroutine.promise, PromiseResult));
+    if (!coroutine.final) {
+        llvm::Function* function = at.GetInsertBlock()->getParent();
+        coroutine.final = llvm::BasicBlock::Create(context, "coroutine.final", function);
+        llvm::IRBuilder<> end(coroutine.final);
+
+        // nothing of the frame is touched once the waiter can run: it destroys this one
+        llvm::Value* save = end.CreateCall(intrinsic(llvm::Intrinsic::coro_save), {coroutine.handle});
+        llvm::Value* waiter = end.CreateAtomicRMW(llvm::AtomicRMWInst::Xchg, end.CreateStructGEP(promise, coroutine.promise, PromiseWaiter),
+            end.getInt64(Done), llvm::MaybeAlign(), llvm::AtomicOrdering::AcquireRelease);
+        llvm::BasicBlock* wake = llvm::BasicBlock::Create(context, "coroutine.wake", function);
+        llvm::BasicBlock* unblock = llvm::BasicBlock::Create(context, "coroutine.unblock", function);
+        llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "coroutine.done", function);
+        llvm::SwitchInst* woken = end.CreateSwitch(waiter, wake, 2);
+        woken->addCase(end.getInt64(0), done);
+        woken->addCase(end.getInt64(Blocked), unblock);
+
+        end.SetInsertPoint(wake);
+        end.CreateCall(scheduleFunction(), {end.CreateIntToPtr(waiter, bytePointer())});
+        end.CreateBr(done);
+        end.SetInsertPoint(unblock);
+        end.CreateCall(finishedFunction());
+        end.CreateBr(done);
+
+        end.SetInsertPoint(done);
+        llvm::Value* suspension = end.CreateCall(intrinsic(llvm::Intrinsic::coro_suspend), {save, end.getTrue()});
+        llvm::BasicBlock* resumed = llvm::BasicBlock::Create(context, "coroutine.over", function);
+        llvm::SwitchInst* next = end.CreateSwitch(suspension, coroutine.suspended, 2);
+        next->addCase(end.getInt8(0), resumed);
+        next->addCase(end.getInt8(1), coroutine.cleanup);
+        end.SetInsertPoint(resumed);
+        end.CreateUnreachable(); // a finished coroutine is never resumed
+    }
+    at.CreateBr(coroutine.final);
+}
+
+llvm::Value* Executor::await(llvm::IRBuilderBase& at, const Coroutine& coroutine, llvm::Value* task, llvm::Type* result) {
+    llvm::Function* function = at.GetInsertBlock()->getParent();
+    llvm::BasicBlock* waiting = llvm::BasicBlock::Create(context, "await", function);
+    llvm::BasicBlock* ready = llvm::BasicBlock::Create(context, "await.ready", function);
+
+    // the task wakes this one if it's still running, and a finished one is taken as it is
+    llvm::Value* save = at.CreateCall(intrinsic(llvm::Intrinsic::coro_save), {coroutine.handle});
+    llvm::Value* self = at.CreatePtrToInt(coroutine.handle, at.getInt64Ty());
+    llvm::Value* exchange = at.CreateAtomicCmpXchg(waiter(at, task), at.getInt64(0), self, llvm::MaybeAlign(),
+        llvm::AtomicOrdering::AcquireRelease, llvm::AtomicOrdering::Acquire);
+    at.CreateCondBr(at.CreateExtractValue(exchange, 1), waiting, ready);
+
+    at.SetInsertPoint(waiting);
+    llvm::Value* suspension = at.CreateCall(intrinsic(llvm::Intrinsic::coro_suspend), {save, at.getFalse()});
+    llvm::SwitchInst* next = at.CreateSwitch(suspension, coroutine.suspended, 2);
+    next->addCase(at.getInt8(0), ready);
+    next->addCase(at.getInt8(1), coroutine.cleanup);
+
+    at.SetInsertPoint(ready);
+    llvm::Value* value = this->result(at, task, result);
+    llvm::Value* destroyed = at.CreateCall(intrinsic(llvm::Intrinsic::coro_destroy), {at.CreatePointerCast(task, bytePointer())});
+    return value ? value : destroyed;
+}
+
+llvm::Value* Executor::result(llvm::IRBuilderBase& at, llvm::Value* task, llvm::Type* result) {
+    if (!result || result->isVoidTy()) return nullptr;
+    llvm::StructType* promise = promiseType(context, result);
+    llvm::Value* handle = at.CreatePointerCast(task, bytePointer());
+    llvm::Value* slot = at.CreateCall(intrinsic(llvm::Intrinsic::coro_promise), {handle, at.getInt32(PromiseAlignment), at.getFalse()});
+    return at.CreateLoad(result, at.CreateStructGEP(promise, at.CreatePointerCast(slot, pointerTo(promise)), PromiseResult));
+}
+
+llvm::Function* Executor::blockOn() {
+    if (llvm::Function* existing = module.getFunction("neoluma.executor.blockOn")) return existing;
+
+    llvm::Function* function = create("neoluma.executor.blockOn", llvm::Type::getVoidTy(context), {taskType(context)});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Type* i64 = body.getInt64Ty();
+    llvm::Value* waiter = this->waiter(body, function->getArg(0));
+    llvm::Value* exchange = body.CreateAtomicCmpXchg(waiter, body.getInt64(0), body.getInt64(Blocked), llvm::MaybeAlign(),
+        llvm::AtomicOrdering::AcquireRelease, llvm::AtomicOrdering::Acquire);
+
+    if (threaded) {
+        // the workers run it, the one finishing it broadcasts
+        ifThen(body, body.CreateExtractValue(exchange, 1), [&] {
+            llvm::Type* sync = llvm::ArrayType::get(body.getInt8Ty(), SyncSize);
+            llvm::Value* mutex = body.CreatePointerCast(state("done.mutex", sync), bytePointer());
+            llvm::Value* condition = body.CreatePointerCast(state("done.condition", sync), bytePointer());
+            body.CreateCall(libc("pthread_mutex_lock", body.getInt32Ty(), {bytePointer()}), {mutex});
+            loop(body, [&] { return body.CreateICmpNE(atomicLoad(body, i64, waiter, llvm::AtomicOrdering::Acquire), body.getInt64(Done)); }, [&] {
+                body.CreateCall(libc("pthread_cond_wait", body.getInt32Ty(), {bytePointer(), bytePointer()}), {condition, mutex});
+            });
+            body.CreateCall(libc("pthread_mutex_unlock", body.getInt32Ty(), {bytePointer()}), {mutex});
+        });
+    } else {
+        ifThen(body, body.CreateICmpNE(atomicLoad(body, body.getInt32Ty(), state("started", body.getInt32Ty()), llvm::AtomicOrdering::Acquire), body.getInt32(2)), [&] {
+            body.CreateCall(startFunction());
+        });
+        body.CreateCall(runFunction(), {body.getInt64(0), waiter});
+    }
+    body.CreateRetVoid();
+    return function;
+}
+
+// ==== std.time and std.fs, the async ones ====
+
+llvm::Function* Executor::sleepAsync() {
+    if (llvm::Function* existing = module.getFunction("neoluma.time.sleepMsAsync")) return existing;
+
+    llvm::Function* function = create("neoluma.time.sleepMsAsync", taskType(context), {llvm::Type::getInt32Ty(context)});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    Coroutine coroutine = begin(body, function, nullptr);
+    llvm::Value* deadline = body.CreateAdd(body.CreateCall(clockFunction()), body.CreateSExt(function->getArg(0), body.getInt64Ty()));
+    suspend(body, coroutine, [&](llvm::IRBuilderBase& before) { before.CreateCall(timerFunction(), {deadline, coroutine.handle}); });
+    finish(body, coroutine, nullptr);
+    return function;
+}
+
+llvm::Function* Executor::readTextAsync(llvm::Constant* objectHeader, llvm::Function* allocate) {
+    if (llvm::Function* existing = module.getFunction("neoluma.fs.readTextAsync")) return existing;
+
+    llvm::Function* function = create("neoluma.fs.readTextAsync", taskType(context), {bytePointer()});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Type* i32 = body.getInt32Ty();
+    llvm::Type* size = sizeType();
+    Coroutine coroutine = begin(body, function, bytePointer());
+
+    // opened by the call, so a missing file is reported where it's read, and the path is kept for the errors after
+    llvm::Value* path = function->getArg(0);
+    llvm::FunctionCallee open = libc("open", i32, {bytePointer(), i32}, true);
+    llvm::Value* descriptor = body.CreateCall(open, {path, body.getInt32(ReadOnly | NonBlocking | CloseOnExec)});
+    ifThen(body, body.CreateICmpSLT(descriptor, body.getInt32(0)), [&] {
+        body.CreateCall(failure(), {globalString(body, "error: can't open '%s' to read: %s\n", "neoluma.fs.openReadFailed", &module), path});
+    });
+    llvm::Value* kept = body.CreateCall(libc("strdup", bytePointer(), {bytePointer()}), {path});
+    start(body, coroutine);
+
+    // the text grows by doubling, the header goes in front of it
+    uint64_t headerSize = objectHeader ? 8 : 0;
+    llvm::FunctionCallee realloc = libc("realloc", bytePointer(), {bytePointer(), size});
+    llvm::AllocaInst* capacity = variable(body, size, llvm::ConstantInt::get(size, InitialText));
+    llvm::AllocaInst* buffer = variable(body, bytePointer(), body.CreateCall(libc("malloc", bytePointer(), {size}), {llvm::ConstantInt::get(size, InitialText)}));
+    llvm::AllocaInst* length = variable(body, size, llvm::ConstantInt::get(size, headerSize));
+    llvm::AllocaInst* got = variable(body, size, nullptr);
+    llvm::AllocaInst* more = variable(body, body.getInt1Ty(), nullptr);
+    llvm::AllocaInst* waited = variable(body, body.getInt1Ty(), body.getFalse());
+    loop(body, [&] {
+        // room for the terminator and a byte more
+        llvm::Value* room = body.CreateSub(body.CreateLoad(size, capacity), body.CreateLoad(size, length));
+        ifThen(body, body.CreateICmpULT(room, llvm::ConstantInt::get(size, 2)), [&] {
+            llvm::Value* doubled = body.CreateShl(body.CreateLoad(size, capacity), 1);
+            body.CreateStore(body.CreateCall(realloc, {body.CreateLoad(bytePointer(), buffer), doubled}), buffer);
+            body.CreateStore(doubled, capacity);
+        });
+        llvm::Value* end = body.CreateGEP(body.getInt8Ty(), body.CreateLoad(bytePointer(), buffer), body.CreateLoad(size, length));
+        llvm::Value* wanted = body.CreateSub(body.CreateSub(body.CreateLoad(size, capacity), body.CreateLoad(size, length)), llvm::ConstantInt::get(size, 1));
+        llvm::Value* read = body.CreateCall(libc("read", size, {i32, bytePointer(), size}), {descriptor, end, wanted});
+        body.CreateStore(read, got);
+        ifThen(body, body.CreateICmpSGT(read, llvm::ConstantInt::get(size, 0)), [&] {
+            body.CreateStore(body.CreateAdd(body.CreateLoad(size, length), read), length);
+        });
+        body.CreateStore(body.CreateICmpNE(read, llvm::ConstantInt::get(size, 0)), more);
+
+        // a FIFO opened before its writer reads as ended, where a blocking open would wait for the writer: an empty
+        // one that can't seek is waited for once
+        llvm::Value* empty = body.CreateAnd(body.CreateICmpEQ(read, llvm::ConstantInt::get(size, 0)),
+            body.CreateICmpEQ(body.CreateLoad(size, length), llvm::ConstantInt::get(size, headerSize)));
+        ifThen(body, body.CreateAnd(empty, body.CreateNot(body.CreateLoad(body.getInt1Ty(), waited))), [&] {
+            llvm::FunctionCallee seek = libc("lseek", body.getInt64Ty(), {i32, body.getInt64Ty(), i32});
+            llvm::Value* position = body.CreateCall(seek, {descriptor, body.getInt64(0), body.getInt32(SeekCurrent)});
+            body.CreateStore(body.CreateICmpSLT(position, body.getInt64(0)), more);
+        });
+        return body.CreateLoad(body.getInt1Ty(), more);
+    }, [&] {
+        ifThen(body, body.CreateICmpEQ(body.CreateLoad(size, got), llvm::ConstantInt::get(size, 0)), [&] {
+            body.CreateStore(body.getTrue(), waited);
+            wait(body, coroutine, descriptor, Readable);
+        });
+        ifThen(body, body.CreateICmpSLT(body.CreateLoad(size, got), llvm::ConstantInt::get(size, 0)), [&] {
+            llvm::Value* error = errorNumber(body);
+            ifThen(body, body.CreateICmpEQ(error, body.getInt32(WouldBlock)), [&] { wait(body, coroutine, descriptor, Readable); });
+            ifThen(body, body.CreateAnd(body.CreateICmpNE(error, body.getInt32(WouldBlock)), body.CreateICmpNE(error, body.getInt32(Interrupted))), [&] {
+                body.CreateCall(failure(), {globalString(body, "error: can't read '%s': %s\n", "neoluma.fs.readFailed", &module), kept});
+            });
+        });
+    });
+
+    body.CreateCall(libc("close", i32, {i32}), {descriptor});
+    body.CreateCall(libc("free", body.getVoidTy(), {bytePointer()}), {kept});
+    llvm::Value* text = body.CreateLoad(bytePointer(), buffer);
+    body.CreateStore(body.getInt8(0), body.CreateGEP(body.getInt8Ty(), text, body.CreateLoad(size, length)));
+    if (objectHeader) {
+        body.CreateStore(objectHeader, body.CreatePointerCast(text, pointerTo(body.getInt64Ty())));
+        text = body.CreateConstGEP1_64(body.getInt8Ty(), text, headerSize);
+    }
+    else if (allocate) {
+        llvm::Value* bytes = body.CreateAdd(body.CreateLoad(size, length), llvm::ConstantInt::get(size, 1));
+        llvm::Value* object = body.CreateCall(allocate, {body.CreateZExtOrTrunc(bytes, body.getInt64Ty())});
+        body.CreateMemCpy(object, llvm::MaybeAlign(1), text, llvm::MaybeAlign(1), bytes);
+        body.CreateCall(libc("free", body.getVoidTy(), {bytePointer()}), {text});
+        text = object;
+    }
+    finish(body, coroutine, text);
+    return function;
+}
+
+llvm::Function* Executor::writeTextAsync() {
+    if (llvm::Function* existing = module.getFunction("neoluma.fs.writeTextAsync")) return existing;
+
+    llvm::Function* function = create("neoluma.fs.writeTextAsync", taskType(context), {bytePointer(), bytePointer()});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Type* i32 = body.getInt32Ty();
+    llvm::Type* size = sizeType();
+    Coroutine coroutine = begin(body, function, nullptr);
+
+    llvm::Value* path = function->getArg(0);
+    llvm::FunctionCallee open = libc("open", i32, {bytePointer(), i32}, true);
+    llvm::Value* descriptor = body.CreateCall(open, {path, body.getInt32(WriteOnly | Create | Truncate | NonBlocking | CloseOnExec), body.getInt32(0644)});
+    ifThen(body, body.CreateICmpSLT(descriptor, body.getInt32(0)), [&] {
+        body.CreateCall(failure(), {globalString(body, "error: can't open '%s' to write: %s\n", "neoluma.fs.openWriteFailed", &module), path});
+    });
+    // the caller's strings may be gone by the time it's written
+    llvm::FunctionCallee duplicate = libc("strdup", bytePointer(), {bytePointer()});
+    llvm::Value* kept = body.CreateCall(duplicate, {path});
+    llvm::Value* content = body.CreateCall(duplicate, {function->getArg(1)});
+    llvm::Value* length = body.CreateCall(libc("strlen", size, {bytePointer()}), {content});
+    start(body, coroutine);
+
+    llvm::AllocaInst* written = variable(body, size, llvm::ConstantInt::get(size, 0));
+    loop(body, [&] { return body.CreateICmpULT(body.CreateLoad(size, written), length); }, [&] {
+        llvm::Value* done = body.CreateLoad(size, written);
+        llvm::Value* wrote = body.CreateCall(libc("write", size, {i32, bytePointer(), size}),
+            {descriptor, body.CreateGEP(body.getInt8Ty(), content, done), body.CreateSub(length, done)});
+        ifThen(body, body.CreateICmpSGE(wrote, llvm::ConstantInt::get(size, 0)), [&] { body.CreateStore(body.CreateAdd(done, wrote), written); });
+        ifThen(body, body.CreateICmpSLT(wrote, llvm::ConstantInt::get(size, 0)), [&] {
+            llvm::Value* error = errorNumber(body);
+            ifThen(body, body.CreateICmpEQ(error, body.getInt32(WouldBlock)), [&] { wait(body, coroutine, descriptor, Writable); });
+            ifThen(body, body.CreateAnd(body.CreateICmpNE(error, body.getInt32(WouldBlock)), body.CreateICmpNE(error, body.getInt32(Interrupted))), [&] {
+                body.CreateCall(failure(), {globalString(body, "error: can't write '%s': %s\n", "neoluma.fs.writeFailed", &module), kept});
+            });
+        });
+    });
+
+    body.CreateCall(libc("close", i32, {i32}), {descriptor});
+    llvm::FunctionCallee free = libc("free", body.getVoidTy(), {bytePointer()});
+    body.CreateCall(free, {content});
+    body.CreateCall(free, {kept});
+    finish(body, coroutine, nullptr);
+    return function;
+}
+
+// ==== Runtime ====
+
+llvm::Function* Executor::startFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.executor.start")) return existing;
+
+    llvm::Function* function = create("neoluma.executor.start", llvm::Type::getVoidTy(context), {});
+    function->addFnAttr(llvm::Attribute::Cold);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* initialize = llvm::BasicBlock::Create(context, "initialize", function);
+    llvm::BasicBlock* other = llvm::BasicBlock::Create(context, "other", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* i32 = body.getInt32Ty();
+    llvm::Type* i64 = body.getInt64Ty();
+    llvm::Type* size = sizeType();
+
+    // 0 before, 1 while a thread starts it, 2 once it's running
+    llvm::Value* started = state("started", i32);
+    llvm::Value* exchange = body.CreateAtomicCmpXchg(started, body.getInt32(0), body.getInt32(1), llvm::MaybeAlign(),
+        llvm::AtomicOrdering::AcquireRelease, llvm::AtomicOrdering::Acquire);
+    body.CreateCondBr(body.CreateExtractValue(exchange, 1), initialize, other);
+
+    body.SetInsertPoint(other);
+    loop(body, [&] { return body.CreateICmpNE(atomicLoad(body, i32, started, llvm::AtomicOrdering::Acquire), body.getInt32(2)); }, [&] {
+        body.CreateCall(libc("sched_yield", i32, {}));
+    });
+    body.CreateRetVoid();
+
+    body.SetInsertPoint(initialize);
+    llvm::Value* count = body.getInt64(1);
+    if (threaded) {
+        llvm::Value* online = body.CreateSExtOrTrunc(body.CreateCall(libc("sysconf", size, {i32}), {body.getInt32(ProcessorsOnline)}), i64);
+        count = body.CreateSelect(body.CreateICmpSGT(online, body.getInt64(1)), online, body.getInt64(1));
+    }
+    body.CreateStore(count, state("workerCount", i64));
+    llvm::Value* bytes = body.CreateZExtOrTrunc(body.CreateMul(count, body.getInt64(module.getDataLayout().getTypeAllocSize(workerType()))), size);
+    llvm::Value* workers = body.CreateCall(libc("aligned_alloc", bytePointer(), {size, size}), {llvm::ConstantInt::get(size, 64), bytes});
+    body.CreateMemSet(workers, body.getInt8(0), bytes, llvm::MaybeAlign(64));
+    body.CreateStore(body.CreatePointerCast(workers, pointerTo(workerType())), state("workers", pointerTo(workerType())));
+
+    // the poller wakes up for descriptors and timers, and for the eventfd when a thread that isn't a worker queues a task
+    llvm::Value* poll = body.CreateCall(libc("epoll_create1", i32, {i32}), {body.getInt32(CloseOnExec)});
+    body.CreateStore(poll, state("epoll", i32));
+    llvm::Value* wakeup = body.CreateCall(libc("eventfd", i32, {i32, i32}), {body.getInt32(0), body.getInt32(NonBlocking | CloseOnExec)});
+    body.CreateStore(wakeup, state("wakeup", i32));
+    llvm::AllocaInst* event = variable(body, eventType(), nullptr);
+    body.CreateStore(body.getInt32(Readable), body.CreateStructGEP(eventType(), event, 0));
+    body.CreateStore(body.getInt64(0), body.CreateStructGEP(eventType(), event, 1));
+    body.CreateCall(libc("epoll_ctl", i32, {i32, i32, i32, pointerTo(eventType())}), {poll, body.getInt32(Add), wakeup, event});
+
+    if (threaded) {
+        llvm::AllocaInst* thread = variable(body, i64, nullptr);
+        llvm::AllocaInst* index = variable(body, i64, body.getInt64(0));
+        loop(body, [&] { return body.CreateICmpULT(body.CreateLoad(i64, index), count); }, [&] {
+            llvm::Value* worker = body.CreateLoad(i64, index);
+            body.CreateCall(libc("pthread_create", i32, {pointerTo(i64), bytePointer(), threadFunction()->getType(), bytePointer()}),
+                {thread, llvm::Constant::getNullValue(bytePointer()), threadFunction(), body.CreateIntToPtr(worker, bytePointer())});
+            body.CreateCall(libc("pthread_detach", i32, {i64}), {body.CreateLoad(i64, thread)});
+            body.CreateStore(body.CreateAdd(worker, body.getInt64(1)), index);
+        });
+    }
+    atomicStore(body, body.getInt32(2), started, llvm::AtomicOrdering::Release);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Executor::scheduleFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.executor.schedule")) return existing;
+
+    llvm::Function* function = create("neoluma.executor.schedule", llvm::Type::getVoidTy(context), {bytePointer()});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* own = llvm::BasicBlock::Create(context, "own", function);
+    llvm::BasicBlock* next = llvm::BasicBlock::Create(context, "next", function);
+    llvm::BasicBlock* push = llvm::BasicBlock::Create(context, "push", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* i32 = body.getInt32Ty();
+    llvm::Type* i64 = body.getInt64Ty();
+
+    ifThen(body, body.CreateICmpNE(atomicLoad(body, i32, state("started", i32), llvm::AtomicOrdering::Acquire), body.getInt32(2)), [&] {
+        body.CreateCall(startFunction());
+    });
+    // a worker keeps what it queues, the other threads hand tasks round
+    llvm::Value* self = body.CreateLoad(i64, state("self", i64));
+    llvm::Value* isWorker = body.CreateICmpSGE(self, body.getInt64(0));
+    body.CreateCondBr(isWorker, own, next);
+
+    body.SetInsertPoint(next);
+    llvm::Value* turn = body.CreateAtomicRMW(llvm::AtomicRMWInst::Add, state("next", i64), body.getInt64(1), llvm::MaybeAlign(), llvm::AtomicOrdering::Monotonic);
+    llvm::Value* other = body.CreateURem(turn, body.CreateLoad(i64, state("workerCount", i64)));
+    body.CreateBr(push);
+
+    body.SetInsertPoint(own);
+    body.CreateBr(push);
+
+    body.SetInsertPoint(push);
+    llvm::PHINode* worker = body.CreatePHI(i64, 2);
+    worker->addIncoming(self, own);
+    worker->addIncoming(other, next);
+    body.CreateCall(pushFunction(), {worker, function->getArg(0)});
+
+    // somebody has to run it: a sleeping worker, or the poller
+    llvm::BasicBlock* sleeping = llvm::BasicBlock::Create(context, "sleeping", function);
+    llvm::BasicBlock* awake = llvm::BasicBlock::Create(context, "awake", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    body.CreateCondBr(body.CreateICmpSGT(atomicLoad(body, i64, state("sleeping", i64)), body.getInt64(0)), sleeping, awake);
+
+    body.SetInsertPoint(sleeping);
+    body.CreateCall(wakeFunction(), {body.getFalse()});
+    body.CreateBr(done);
+
+    body.SetInsertPoint(awake);
+    llvm::Value* polling = body.CreateICmpNE(atomicLoad(body, i32, state("polling", i32)), body.getInt32(0));
+    ifThen(body, body.CreateAnd(body.CreateNot(isWorker), polling), [&] {
+        llvm::AllocaInst* one = variable(body, i64, body.getInt64(1));
+        body.CreateCall(libc("write", sizeType(), {i32, bytePointer(), sizeType()}),
+            {body.CreateLoad(i32, state("wakeup", i32)), body.CreatePointerCast(one, bytePointer()), llvm::ConstantInt::get(sizeType(), 8)});
+    });
+    body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Executor::pushFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.executor.push")) return existing;
+
+    llvm::Function* function = create("neoluma.executor.push", llvm::Type::getVoidTy(context), {llvm::Type::getInt64Ty(context), bytePointer()});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Type* i64 = body.getInt64Ty();
+    llvm::Type* ring = pointerTo(bytePointer());
+    llvm::StructType* type = workerType();
+
+    llvm::Value* worker = body.CreateGEP(type, body.CreateLoad(pointerTo(type), state("workers", pointerTo(type))), function->getArg(0));
+    llvm::Value* headSlot = body.CreateStructGEP(type, worker, Head);
+    llvm::Value* tailSlot = body.CreateStructGEP(type, worker, Tail);
+    llvm::Value* capacitySlot = body.CreateStructGEP(type, worker, Capacity);
+    llvm::Value* ringSlot = body.CreateStructGEP(type, worker, Ring);
+    lock(body, body.CreateStructGEP(type, worker, Lock));
+
+    // a full ring doubles, its tasks moved to the start in order
+    llvm::Value* head = atomicLoad(body, i64, headSlot, llvm::AtomicOrdering::Monotonic);
+    llvm::Value* tail = atomicLoad(body, i64, tailSlot, llvm::AtomicOrdering::Monotonic);
+    llvm::Value* capacity = body.CreateLoad(i64, capacitySlot);
+    ifThen(body, body.CreateICmpEQ(body.CreateSub(tail, head), capacity), [&] {
+        llvm::Value* old = body.CreateLoad(ring, ringSlot);
+        llvm::Value* doubled = body.CreateSelect(body.CreateIsNull(capacity), body.getInt64(InitialRing), body.CreateShl(capacity, 1));
+        llvm::Value* bytes = body.CreateZExtOrTrunc(body.CreateMul(doubled, body.getInt64(module.getDataLayout().getPointerSize())), sizeType());
+        llvm::Value* grown = body.CreatePointerCast(body.CreateCall(libc("malloc", bytePointer(), {sizeType()}), {bytes}), ring);
+        llvm::Value* mask = body.CreateSub(capacity, body.getInt64(1));
+        llvm::AllocaInst* index = variable(body, i64, body.getInt64(0));
+        llvm::Value* count = body.CreateSub(tail, head);
+        loop(body, [&] { return body.CreateICmpULT(body.CreateLoad(i64, index), count); }, [&] {
+            llvm::Value* at = body.CreateLoad(i64, index);
+            llvm::Value* task = body.CreateLoad(bytePointer(), body.CreateGEP(bytePointer(), old, body.CreateAnd(body.CreateAdd(head, at), mask)));
+            body.CreateStore(task, body.CreateGEP(bytePointer(), grown, at));
+            body.CreateStore(body.CreateAdd(at, body.getInt64(1)), index);
+        });
+        body.CreateCall(libc("free", body.getVoidTy(), {bytePointer()}), {body.CreatePointerCast(old, bytePointer())});
+        body.CreateStore(grown, ringSlot);
+        body.CreateStore(doubled, capacitySlot);
+        atomicStore(body, body.getInt64(0), headSlot, llvm::AtomicOrdering::Monotonic);
+        atomicStore(body, count, tailSlot, llvm::AtomicOrdering::Monotonic);
+    });
+
+    tail = atomicLoad(body, i64, tailSlot, llvm::AtomicOrdering::Monotonic);
+    llvm::Value* mask = body.CreateSub(body.CreateLoad(i64, capacitySlot), body.getInt64(1));
+    body.CreateStore(function->getArg(1), body.CreateGEP(bytePointer(), body.CreateLoad(ring, ringSlot), body.CreateAnd(tail, mask)));
+    atomicStore(body, body.CreateAdd(tail, body.getInt64(1)), tailSlot, llvm::AtomicOrdering::Monotonic);
+    unlock(body, body.CreateStructGEP(type, worker, Lock));
+    atomicAdd(body, state("queued", i64), 1);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Executor::takeFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.executor.take")) return existing;
+
+    llvm::Function* function = create("neoluma.executor.take", bytePointer(), {llvm::Type::getInt64Ty(context), llvm::Type::getInt1Ty(context)});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* locked = llvm::BasicBlock::Create(context, "locked", function);
+    llvm::BasicBlock* take = llvm::BasicBlock::Create(context, "take", function);
+    llvm::BasicBlock* empty = llvm::BasicBlock::Create(context, "empty", function);
+    llvm::BasicBlock* none = llvm::BasicBlock::Create(context, "none", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* i64 = body.getInt64Ty();
+    llvm::StructType* type = workerType();
+
+    llvm::Value* worker = body.CreateGEP(type, body.CreateLoad(pointerTo(type), state("workers", pointerTo(type))), function->getArg(0));
+    llvm::Value* headSlot = body.CreateStructGEP(type, worker, Head);
+    llvm::Value* tailSlot = body.CreateStructGEP(type, worker, Tail);
+    llvm::Value* lockSlot = body.CreateStructGEP(type, worker, Lock);
+    // an empty deque isn't locked for nothing, stealing looks at all of them
+    auto isEmpty = [&] {
+        return body.CreateICmpEQ(atomicLoad(body, i64, headSlot, llvm::AtomicOrdering::Monotonic), atomicLoad(body, i64, tailSlot, llvm::AtomicOrdering::Monotonic));
+    };
+    body.CreateCondBr(isEmpty(), none, locked);
+
+    body.SetInsertPoint(locked);
+    lock(body, lockSlot);
+    body.CreateCondBr(isEmpty(), empty, take);
+
+    // the owner takes the newest, a thief the oldest
+    body.SetInsertPoint(take);
+    llvm::Value* steal = function->getArg(1);
+    llvm::Value* head = atomicLoad(body, i64, headSlot, llvm::AtomicOrdering::Monotonic);
+    llvm::Value* tail = atomicLoad(body, i64, tailSlot, llvm::AtomicOrdering::Monotonic);
+    llvm::Value* last = body.CreateSub(tail, body.getInt64(1));
+    llvm::Value* index = body.CreateSelect(steal, head, last);
+    atomicStore(body, body.CreateSelect(steal, body.CreateAdd(head, body.getInt64(1)), head), headSlot, llvm::AtomicOrdering::Monotonic);
+    atomicStore(body, body.CreateSelect(steal, tail, last), tailSlot, llvm::AtomicOrdering::Monotonic);
+    llvm::Value* mask = body.CreateSub(body.CreateLoad(i64, body.CreateStructGEP(type, worker, Capacity)), body.getInt64(1));
+    llvm::Value* ring = body.CreateLoad(pointerTo(bytePointer()), body.CreateStructGEP(type, worker, Ring));
+    llvm::Value* task = body.CreateLoad(bytePointer(), body.CreateGEP(bytePointer(), ring, body.CreateAnd(index, mask)));
+    unlock(body, lockSlot);
+    atomicAdd(body, state("queued", i64), -1);
+    body.CreateRet(task);
+
+    body.SetInsertPoint(empty);
+    unlock(body, lockSlot);
+    body.CreateBr(none);
+
+    body.SetInsertPoint(none);
+    body.CreateRet(llvm::Constant::getNullValue(bytePointer()));
+    return function;
+}
+
+llvm::Function* Executor::runFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.executor.run")) return existing;
+
+    llvm::Type* i64 = llvm::Type::getInt64Ty(context);
+    llvm::Function* function = create("neoluma.executor.run", llvm::Type::getVoidTy(context), {i64, pointerTo(i64)});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* next = llvm::BasicBlock::Create(context, "next", function);
+    llvm::BasicBlock* own = llvm::BasicBlock::Create(context, "own", function);
+    llvm::BasicBlock* steal = llvm::BasicBlock::Create(context, "steal", function);
+    llvm::BasicBlock* victim = llvm::BasicBlock::Create(context, "steal.victim", function);
+    llvm::BasicBlock* run = llvm::BasicBlock::Create(context, "run", function);
+    llvm::BasicBlock* idle = llvm::BasicBlock::Create(context, "idle", function);
+    llvm::BasicBlock* poller = llvm::BasicBlock::Create(context, "poller", function);
+    llvm::BasicBlock* sleeper = llvm::BasicBlock::Create(context, "sleeper", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* i32 = body.getInt32Ty();
+    llvm::Value* self = function->getArg(0);
+    llvm::Value* until = function->getArg(1);
+    body.CreateStore(self, state("self", i64));
+    body.CreateBr(next);
+
+    body.SetInsertPoint(next);
+    // a worker thread runs for good, the thread blocking on a task until it's done
+    auto isDone = [&] {
+        llvm::AllocaInst* finished = variable(body, body.getInt1Ty(), body.getFalse());
+        ifThen(body, body.CreateIsNotNull(until), [&] {
+            body.CreateStore(body.CreateICmpEQ(atomicLoad(body, i64, until, llvm::AtomicOrdering::Acquire), body.getInt64(Done)), finished);
+        });
+        return body.CreateLoad(body.getInt1Ty(), finished);
+    };
+    body.CreateCondBr(isDone(), done, own);
+
+    // its own deque first
+    body.SetInsertPoint(own);
+    llvm::Value* mine = body.CreateCall(takeFunction(), {self, body.getFalse()});
+    body.CreateCondBr(body.CreateIsNull(mine), steal, run);
+
+    // then the others', from the next one on
+    body.SetInsertPoint(steal);
+    llvm::PHINode* offset = body.CreatePHI(i64, 2);
+    offset->addIncoming(body.getInt64(1), own);
+    llvm::Value* count = body.CreateLoad(i64, state("workerCount", i64));
+    body.CreateCondBr(body.CreateICmpULT(offset, count), victim, idle);
+
+    body.SetInsertPoint(victim);
+    llvm::Value* stolen = body.CreateCall(takeFunction(), {body.CreateURem(body.CreateAdd(self, offset), count), body.getTrue()});
+    offset->addIncoming(body.CreateAdd(offset, body.getInt64(1)), victim);
+    body.CreateCondBr(body.CreateIsNull(stolen), steal, run);
+
+    body.SetInsertPoint(run);
+    llvm::PHINode* task = body.CreatePHI(bytePointer(), 2);
+    task->addIncoming(mine, own);
+    task->addIncoming(stolen, victim);
+    body.CreateCall(intrinsic(llvm::Intrinsic::coro_resume), {task});
+    body.CreateBr(next);
+
+    // nothing to run: one idle worker polls, the others sleep until there's something
+    body.SetInsertPoint(idle);
+    llvm::Value* polling = state("polling", i32);
+    llvm::Value* queued = state("queued", i64);
+    llvm::Value* sleeping = state("sleeping", i64);
+    llvm::Value* exchange = body.CreateAtomicCmpXchg(polling, body.getInt32(0), body.getInt32(1), llvm::MaybeAlign(),
+        llvm::AtomicOrdering::SequentiallyConsistent, llvm::AtomicOrdering::SequentiallyConsistent);
+    body.CreateCondBr(body.CreateExtractValue(exchange, 1), poller, sleeper);
+
+    body.SetInsertPoint(poller);
+    llvm::Value* nothing = body.CreateICmpEQ(atomicLoad(body, i64, queued), body.getInt64(0));
+    ifThen(body, body.CreateAnd(nothing, body.CreateNot(isDone())), [&] { body.CreateCall(pollFunction()); });
+    atomicStore(body, body.getInt32(0), polling);
+    // another worker polls from now on, and runs what this one can't
+    ifThen(body, body.CreateICmpSGT(atomicLoad(body, i64, sleeping), body.getInt64(0)), [&] {
+        body.CreateCall(wakeFunction(), {body.CreateICmpSGT(atomicLoad(body, i64, queued), body.getInt64(1))});
+    });
+    body.CreateBr(next);
+
+    body.SetInsertPoint(sleeper);
+    llvm::Type* sync = llvm::ArrayType::get(body.getInt8Ty(), SyncSize);
+    llvm::Value* mutex = body.CreatePointerCast(state("idle.mutex", sync), bytePointer());
+    body.CreateCall(libc("pthread_mutex_lock", i32, {bytePointer()}), {mutex});
+    atomicAdd(body, sleeping, 1);
+    llvm::Value* stillNothing = body.CreateICmpEQ(atomicLoad(body, i64, queued), body.getInt64(0));
+    ifThen(body, body.CreateAnd(stillNothing, body.CreateICmpNE(atomicLoad(body, i32, polling), body.getInt32(0))), [&] {
+        body.CreateCall(libc("pthread_cond_wait", i32, {bytePointer(), bytePointer()}),
+            {body.CreatePointerCast(state("idle.condition", sync), bytePointer()), mutex});
+    });
+    atomicAdd(body, sleeping, -1);
+    body.CreateCall(libc("pthread_mutex_unlock", i32, {bytePointer()}), {mutex});
+    body.CreateBr(next);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Executor::threadFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.executor.thread")) return existing;
+
+    llvm::Function* function = create("neoluma.executor.thread", bytePointer(), {bytePointer()});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* until = llvm::Constant::getNullValue(pointerTo(body.getInt64Ty()));
+    body.CreateCall(runFunction(), {body.CreatePtrToInt(function->getArg(0), body.getInt64Ty()), until});
+    body.CreateRet(llvm::Constant::getNullValue(bytePointer()));
+    return function;
+}
+
+llvm::Function* Executor::pollFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.executor.poll")) return existing;
+
+    llvm::Function* function = create("neoluma.executor.poll", llvm::Type::getVoidTy(context), {});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Type* i32 = body.getInt32Ty();
+    llvm::Type* i64 = body.getInt64Ty();
+    llvm::StructType* timer = timerType();
+    llvm::Value* timersLock = state("timers.lock", i32);
+    llvm::Value* timersSlot = state("timers", pointerTo(timer));
+    llvm::Value* countSlot = state("timerCount", i64);
+
+    // until the nearest timer, or for good without one
+    llvm::AllocaInst* timeout = variable(body, i32, body.getInt32(-1));
+    lock(body, timersLock);
+    ifThen(body, body.CreateICmpUGT(body.CreateLoad(i64, countSlot), body.getInt64(0)), [&] {
+        llvm::Value* nearest = body.CreateLoad(i64, body.CreateStructGEP(timer, body.CreateLoad(pointerTo(timer), timersSlot), Deadline));
+        llvm::Value* left = body.CreateSub(nearest, body.CreateCall(clockFunction()));
+        left = body.CreateSelect(body.CreateICmpSLT(left, body.getInt64(0)), body.getInt64(0), left);
+        left = body.CreateSelect(body.CreateICmpSGT(left, body.getInt64(INT32_MAX)), body.getInt64(INT32_MAX), left);
+        body.CreateStore(body.CreateTrunc(left, i32), timeout);
+    });
+    unlock(body, timersLock);
+
+    llvm::ArrayType* events = llvm::ArrayType::get(eventType(), MaxEvents);
+    llvm::AllocaInst* ready = variable(body, events, nullptr);
+    llvm::Value* first = body.CreateConstInBoundsGEP2_32(events, ready, 0, 0);
+    llvm::Value* count = body.CreateCall(libc("epoll_wait", i32, {i32, pointerTo(eventType()), i32, i32}),
+        {body.CreateLoad(i32, state("epoll", i32)), first, body.getInt32(MaxEvents), body.CreateLoad(i32, timeout)});
+    count = body.CreateSExt(body.CreateSelect(body.CreateICmpSGT(count, body.getInt32(0)), count, body.getInt32(0)), i64);
+
+    // every event is a task waiting for its descriptor, but the eventfd's
+    llvm::AllocaInst* index = variable(body, i64, body.getInt64(0));
+    loop(body, [&] { return body.CreateICmpULT(body.CreateLoad(i64, index), count); }, [&] {
+        llvm::Value* current = body.CreateLoad(i64, index);
+        llvm::Value* data = body.CreateLoad(i64, body.CreateStructGEP(eventType(), body.CreateGEP(eventType(), first, current), 1));
+        llvm::Function* parent = body.GetInsertBlock()->getParent();
+        llvm::BasicBlock* drain = llvm::BasicBlock::Create(context, "drain", parent);
+        llvm::BasicBlock* wake = llvm::BasicBlock::Create(context, "wake", parent);
+        llvm::BasicBlock* after = llvm::BasicBlock::Create(context, "event.end", parent);
+        body.CreateCondBr(body.CreateIsNull(data), drain, wake);
+
+        body.SetInsertPoint(drain);
+        llvm::AllocaInst* counter = variable(body, i64, nullptr);
+        body.CreateCall(libc("read", sizeType(), {i32, bytePointer(), sizeType()}),
+            {body.CreateLoad(i32, state("wakeup", i32)), body.CreatePointerCast(counter, bytePointer()), llvm::ConstantInt::get(sizeType(), 8)});
+        body.CreateBr(after);
+
+        body.SetInsertPoint(wake);
+        body.CreateCall(scheduleFunction(), {body.CreateIntToPtr(data, bytePointer())});
+        body.CreateBr(after);
+
+        body.SetInsertPoint(after);
+        body.CreateStore(body.CreateAdd(current, body.getInt64(1)), index);
+    });
+
+    // then the timers that are due, popped off the heap one at a time
+    llvm::Value* now = body.CreateCall(clockFunction());
+    llvm::AllocaInst* due = variable(body, bytePointer(), nullptr);
+    loop(body, [&] {
+        body.CreateStore(llvm::Constant::getNullValue(bytePointer()), due);
+        lock(body, timersLock);
+        llvm::Value* timers = body.CreateLoad(pointerTo(timer), timersSlot);
+        llvm::Value* size = body.CreateLoad(i64, countSlot);
+        llvm::AllocaInst* isDue = variable(body, body.getInt1Ty(), body.getFalse());
+        ifThen(body, body.CreateICmpUGT(size, body.getInt64(0)), [&] {
+            body.CreateStore(body.CreateICmpSLE(body.CreateLoad(i64, body.CreateStructGEP(timer, timers, Deadline)), now), isDue);
+        });
+        ifThen(body, body.CreateLoad(body.getInt1Ty(), isDue), [&] {
+            body.CreateStore(body.CreateLoad(bytePointer(), body.CreateStructGEP(timer, timers, Task)), due);
+            llvm::Value* remaining = body.CreateSub(size, body.getInt64(1));
+            llvm::Value* last = body.CreateLoad(timer, body.CreateGEP(timer, timers, remaining));
+            llvm::Value* lastDeadline = body.CreateExtractValue(last, Deadline);
+            body.CreateStore(remaining, countSlot);
+
+            // the last one sifts down from the top
+            llvm::AllocaInst* hole = variable(body, i64, body.getInt64(0));
+            llvm::AllocaInst* child = variable(body, i64, nullptr);
+            auto deadline = [&](llvm::Value* at) { return body.CreateLoad(i64, body.CreateStructGEP(timer, body.CreateGEP(timer, timers, at), Deadline)); };
+            loop(body, [&] {
+                llvm::Value* left = body.CreateAdd(body.CreateShl(body.CreateLoad(i64, hole), 1), body.getInt64(1));
+                llvm::Value* right = body.CreateAdd(left, body.getInt64(1));
+                llvm::Value* hasLeft = body.CreateICmpULT(left, remaining);
+                llvm::Value* hasRight = body.CreateICmpULT(right, remaining);
+                // indices past the heap read the first timer instead, their answer isn't used
+                llvm::Value* safeLeft = body.CreateSelect(hasLeft, left, body.getInt64(0));
+                llvm::Value* safeRight = body.CreateSelect(hasRight, right, body.getInt64(0));
+                llvm::Value* useRight = body.CreateAnd(hasRight, body.CreateICmpSLT(deadline(safeRight), deadline(safeLeft)));
+                llvm::Value* smaller = body.CreateSelect(useRight, safeRight, safeLeft);
+                body.CreateStore(smaller, child);
+                return body.CreateAnd(hasLeft, body.CreateICmpSLT(deadline(smaller), lastDeadline));
+            }, [&] {
+                llvm::Value* from = body.CreateLoad(i64, child);
+                body.CreateStore(body.CreateLoad(timer, body.CreateGEP(timer, timers, from)), body.CreateGEP(timer, timers, body.CreateLoad(i64, hole)));
+                body.CreateStore(from, hole);
+            });
+            body.CreateStore(last, body.CreateGEP(timer, timers, body.CreateLoad(i64, hole)));
+        });
+        unlock(body, timersLock);
+        return body.CreateIsNotNull(body.CreateLoad(bytePointer(), due));
+    }, [&] {
+        body.CreateCall(scheduleFunction(), {body.CreateLoad(bytePointer(), due)});
+    });
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Executor::wakeFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.executor.wake")) return existing;
+
+    llvm::Function* function = create("neoluma.executor.wake", llvm::Type::getVoidTy(context), {llvm::Type::getInt1Ty(context)});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Type* i32 = body.getInt32Ty();
+    llvm::Type* sync = llvm::ArrayType::get(body.getInt8Ty(), SyncSize);
+    llvm::Value* mutex = body.CreatePointerCast(state("idle.mutex", sync), bytePointer());
+    llvm::Value* condition = body.CreatePointerCast(state("idle.condition", sync), bytePointer());
+    llvm::FunctionCallee signal = libc("pthread_cond_signal", i32, {bytePointer()});
+    llvm::FunctionCallee broadcast = libc("pthread_cond_broadcast", i32, {bytePointer()});
+
+    body.CreateCall(libc("pthread_mutex_lock", i32, {bytePointer()}), {mutex});
+    llvm::BasicBlock* one = llvm::BasicBlock::Create(context, "one", function);
+    llvm::BasicBlock* all = llvm::BasicBlock::Create(context, "all", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    body.CreateCondBr(function->getArg(0), all, one);
+    body.SetInsertPoint(one);
+    body.CreateCall(signal, {condition});
+    body.CreateBr(done);
+    body.SetInsertPoint(all);
+    body.CreateCall(broadcast, {condition});
+    body.CreateBr(done);
+    body.SetInsertPoint(done);
+    body.CreateCall(libc("pthread_mutex_unlock", i32, {bytePointer()}), {mutex});
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Executor::finishedFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.executor.finished")) return existing;
+
+    llvm::Function* function = create("neoluma.executor.finished", llvm::Type::getVoidTy(context), {});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Type* i32 = body.getInt32Ty();
+    llvm::Type* sync = llvm::ArrayType::get(body.getInt8Ty(), SyncSize);
+    // under the mutex, so the blocked thread can't miss it between its check and its wait
+    llvm::Value* mutex = body.CreatePointerCast(state("done.mutex", sync), bytePointer());
+    body.CreateCall(libc("pthread_mutex_lock", i32, {bytePointer()}), {mutex});
+    body.CreateCall(libc("pthread_cond_broadcast", i32, {bytePointer()}), {body.CreatePointerCast(state("done.condition", sync), bytePointer())});
+    body.CreateCall(libc("pthread_mutex_unlock", i32, {bytePointer()}), {mutex});
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Executor::timerFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.executor.timer")) return existing;
+
+    llvm::Type* i64 = llvm::Type::getInt64Ty(context);
+    llvm::Function* function = create("neoluma.executor.timer", llvm::Type::getVoidTy(context), {i64, bytePointer()});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Type* i32 = body.getInt32Ty();
+    llvm::StructType* timer = timerType();
+    llvm::Value* timersLock = state("timers.lock", i32);
+    llvm::Value* timersSlot = state("timers", pointerTo(timer));
+    llvm::Value* countSlot = state("timerCount", i64);
+    llvm::Value* capacitySlot = state("timerCapacity", i64);
+    llvm::Value* deadline = function->getArg(0);
+
+    lock(body, timersLock);
+    llvm::Value* count = body.CreateLoad(i64, countSlot);
+    ifThen(body, body.CreateICmpEQ(count, body.CreateLoad(i64, capacitySlot)), [&] {
+        llvm::Value* capacity = body.CreateLoad(i64, capacitySlot);
+        llvm::Value* doubled = body.CreateSelect(body.CreateIsNull(capacity), body.getInt64(InitialTimers), body.CreateShl(capacity, 1));
+        llvm::Value* bytes = body.CreateZExtOrTrunc(body.CreateMul(doubled, body.getInt64(module.getDataLayout().getTypeAllocSize(timer))), sizeType());
+        llvm::Value* old = body.CreatePointerCast(body.CreateLoad(pointerTo(timer), timersSlot), bytePointer());
+        llvm::Value* grown = body.CreateCall(libc("realloc", bytePointer(), {bytePointer(), sizeType()}), {old, bytes});
+        body.CreateStore(body.CreatePointerCast(grown, pointerTo(timer)), timersSlot);
+        body.CreateStore(doubled, capacitySlot);
+    });
+
+    // a min-heap of deadlines: the new one sifts up from the end
+    llvm::Value* timers = body.CreateLoad(pointerTo(timer), timersSlot);
+    llvm::AllocaInst* hole = variable(body, i64, count);
+    llvm::AllocaInst* parent = variable(body, i64, nullptr);
+    loop(body, [&] {
+        llvm::Value* current = body.CreateLoad(i64, hole);
+        llvm::Value* any = body.CreateICmpUGT(current, body.getInt64(0));
+        llvm::Value* above = body.CreateSelect(any, body.CreateLShr(body.CreateSub(current, body.getInt64(1)), 1), body.getInt64(0));
+        body.CreateStore(above, parent);
+        llvm::Value* later = body.CreateICmpSGT(body.CreateLoad(i64, body.CreateStructGEP(timer, body.CreateGEP(timer, timers, above), Deadline)), deadline);
+        return body.CreateAnd(any, later);
+    }, [&] {
+        llvm::Value* above = body.CreateLoad(i64, parent);
+        body.CreateStore(body.CreateLoad(timer, body.CreateGEP(timer, timers, above)), body.CreateGEP(timer, timers, body.CreateLoad(i64, hole)));
+        body.CreateStore(above, hole);
+    });
+    llvm::Value* slot = body.CreateGEP(timer, timers, body.CreateLoad(i64, hole));
+    body.CreateStore(deadline, body.CreateStructGEP(timer, slot, Deadline));
+    body.CreateStore(function->getArg(1), body.CreateStructGEP(timer, slot, Task));
+    body.CreateStore(body.CreateAdd(count, body.getInt64(1)), countSlot);
+    unlock(body, timersLock);
+
+    // the poller sleeps until the deadline it knew of
+    ifThen(body, body.CreateICmpNE(atomicLoad(body, i32, state("polling", i32)), body.getInt32(0)), [&] {
+        llvm::AllocaInst* one = variable(body, i64, body.getInt64(1));
+        body.CreateCall(libc("write", sizeType(), {i32, bytePointer(), sizeType()}),
+            {body.CreateLoad(i32, state("wakeup", i32)), body.CreatePointerCast(one, bytePointer()), llvm::ConstantInt::get(sizeType(), 8)});
+    });
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* Executor::clockFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.executor.clock")) return existing;
+
+    llvm::Type* i64 = llvm::Type::getInt64Ty(context);
+    llvm::Function* function = create("neoluma.executor.clock", i64, {});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::StructType* timespec = llvm::StructType::get(context, {sizeType(), sizeType()});
+    llvm::AllocaInst* now = body.CreateAlloca(timespec);
+    body.CreateCall(libc("clock_gettime", body.getInt32Ty(), {body.getInt32Ty(), pointerTo(timespec)}), {body.getInt32(MonotonicClock), now});
+    llvm::Value* seconds = body.CreateSExtOrTrunc(body.CreateLoad(sizeType(), body.CreateStructGEP(timespec, now, 0)), i64);
+    llvm::Value* nanoseconds = body.CreateSExtOrTrunc(body.CreateLoad(sizeType(), body.CreateStructGEP(timespec, now, 1)), i64);
+    body.CreateRet(body.CreateAdd(body.CreateMul(seconds, body.getInt64(1000)), body.CreateSDiv(nanoseconds, body.getInt64(1000000))));
+    return function;
+}
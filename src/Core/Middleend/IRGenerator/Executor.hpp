@@ -0,0 +1,119 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// LLVM Primitives
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+
+/* Executor is the runtime of async functions. Like the other runtime pieces it's emitted into the modules that use it,
+ * with linkonce_odr linkage.
+ *
+ * An async function is a stackless coroutine of LLVM (switched-resume lowering): its frame holds only what lives across
+ * an `await`, and the coroutine passes split it into a ramp, which the call runs, and a resume and a destroy function.
+ * Its handle is the task. The promise of a task is {intptr waiter, T result}: the waiter is 0 until somebody waits,
+ * Done once the task has finished, Blocked if a thread blocks on it, and the handle of the awaiting task otherwise.
+ * A task is queued as soon as it's called. Awaiting it suspends the awaiting one until it's done, and destroys it.
+ * LLVM elides the allocation of a frame when the handle never escapes the caller; a queued task always does, so
+ * frames are malloc'd.
+ *
+ * Tasks run on one worker per core, each with its own deque: a worker pushes and pops its end, LIFO, the others steal
+ * from the other end when they run dry. The deques are short critical sections behind a spinlock. An idle worker
+ * steals, then becomes the poller if there's none: it sleeps in epoll_wait until a descriptor a task waits for is
+ * ready or the nearest timer is due, and queues the tasks that can go on. The other idle workers sleep on a condition
+ * variable. Without threads the thread blocking on the entry task is the only worker: tasks take turns at their awaits,
+ * never two at once. That's how they run with the collector, whose heap and roots nothing locks; ARC and no memory
+ * management get the workers.
+ * Files are opened non-blocking. A regular file is always ready, only pipes, FIFOs and the like are waited for.
+ * Only Linux has one: there's no poll or kqueue fallback, async functions are an error on other targets.
+ */
+struct Executor {
+    // `threaded` starts a worker per core, without it the entry's thread runs every task. `errorStream` emits the
+    // FILE* of stderr where a builder is, failed I/O is reported there.
+    Executor(llvm::Module& module, bool threaded, std::function<llvm::Value*(llvm::IRBuilderBase&)> errorStream)
+        : module(module), context(module.getContext()), threaded(threaded), errorStream(std::move(errorStream)) {}
+
+    enum Waiter : uint64_t { Done = 1, Blocked = 2 };
+
+    // A coroutine being emitted
+    struct Coroutine {
+        llvm::Value* id; // token of llvm.coro.id
+        llvm::Value* handle;
+        llvm::AllocaInst* promise;
+        llvm::BasicBlock* start; // the frame is there from here on, the body goes here
+        llvm::BasicBlock* suspended; // the coroutine is left where it is: the ramp returns the handle
+        llvm::BasicBlock* cleanup; // frees the frame, then goes to `suspended`
+        llvm::BasicBlock* final = nullptr; // the final suspension, LLVM takes only one: every finish goes there
+    };
+
+    static llvm::PointerType* taskType(llvm::LLVMContext& context); // %neoluma.task*, the handle as the program sees it
+    static llvm::StructType* promiseType(llvm::LLVMContext& context, llvm::Type* result); // {intptr waiter, result}, {intptr} for void
+
+    /* Turns `function`, which must return a task, into a coroutine: emits the start of its frame where `at` is, in the
+     * entry block, and leaves `at` at `start`. The ramp runs until the first suspension and returns the handle there.
+     */
+    Coroutine begin(llvm::IRBuilderBase& at, llvm::Function* function, llvm::Type* result);
+    // Suspends the coroutine where `at` is. `before` runs once it can be resumed, it hands the handle to whoever will.
+    // Leaves `at` where it goes on.
+    void suspend(llvm::IRBuilderBase& at, const Coroutine& coroutine, const std::function<void(llvm::IRBuilderBase&)>& before);
+    void start(llvm::IRBuilderBase& at, const Coroutine& coroutine); // the initial suspension: it's queued
+    // Finishes with `result`, nullptr for void: stores it and goes to the final suspension, which wakes the waiter and
+    // suspends for good. Terminates the block.
+    void finish(llvm::IRBuilderBase& at, Coroutine& coroutine, llvm::Value* result);
+    // Waits for `task` without blocking, then destroys it and gives its result. For void that's the call destroying
+    // it, like a call of a void function.
+    llvm::Value* await(llvm::IRBuilderBase& at, const Coroutine& coroutine, llvm::Value* task, llvm::Type* result);
+    // The result of a finished task, it stays alive
+    llvm::Value* result(llvm::IRBuilderBase& at, llvm::Value* task, llvm::Type* result);
+
+    llvm::Function* blockOn(); // void (task): the calling thread waits until it's done, running tasks if there are no workers
+
+    // sleepMsAsync, readTextAsync and writeTextAsync of std.time and std.fs, coroutines of their own
+    llvm::Function* sleepAsync(); // task (i32 milliseconds)
+    // task (i8* path): gives the text. `objectHeader` is written in front of it if it's given, for the collector.
+    // With `allocate` (i8* (i64), ARC's) it's copied into an object of its own instead.
+    llvm::Function* readTextAsync(llvm::Constant* objectHeader, llvm::Function* allocate = nullptr);
+    llvm::Function* writeTextAsync(); // task (i8* path, i8* content): both are copied before it returns
+
+private:
+    llvm::Module& module;
+    llvm::LLVMContext& context;
+    bool threaded;
+    std::function<llvm::Value*(llvm::IRBuilderBase&)> errorStream;
+
+    llvm::Type* bytePointer();
+    llvm::Type* sizeType(); // of the C library
+    llvm::StructType* workerType(); // {i32 lock, i64 head, i64 tail, i64 capacity, i8** ring}, a cache line
+    llvm::StructType* timerType(); // {i64 deadline, i8* task}
+    llvm::StructType* eventType(); // struct epoll_event, packed on x86-64
+    llvm::GlobalVariable* state(const std::string& name, llvm::Type* type);
+    llvm::Function* create(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters);
+    llvm::FunctionCallee libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters, bool variadic = false);
+    llvm::Function* intrinsic(llvm::Intrinsic::ID id, llvm::ArrayRef<llvm::Type*> types = {});
+    llvm::Function* failure(); // void (i8* format, i8* path), doesn't return: reports a failed file operation and errno
+
+    // Emitting
+    llvm::AllocaInst* variable(llvm::IRBuilderBase& at, llvm::Type* type, llvm::Value* initial); // a slot of the function
+    void loop(llvm::IRBuilderBase& at, const std::function<llvm::Value*()>& condition, const std::function<void()>& body);
+    void ifThen(llvm::IRBuilderBase& at, llvm::Value* condition, const std::function<void()>& body);
+    void lock(llvm::IRBuilderBase& at, llvm::Value* spinlock); // i32*
+    void unlock(llvm::IRBuilderBase& at, llvm::Value* spinlock);
+    llvm::Value* waiter(llvm::IRBuilderBase& at, llvm::Value* task); // intptr* of its promise
+    llvm::Value* errorNumber(llvm::IRBuilderBase& at); // i32 errno
+    void wait(llvm::IRBuilderBase& at, const Coroutine& coroutine, llvm::Value* descriptor, uint32_t events); // until it's ready
+
+    // Runtime
+    llvm::Function* startFunction(); // void (): the deques, epoll and the workers, once
+    llvm::Function* scheduleFunction(); // void (i8* task): queued on the deque of this worker, or of the next one
+    llvm::Function* pushFunction(); // void (i64 worker, i8* task)
+    llvm::Function* takeFunction(); // i8* (i64 worker, i1 steal): null if its deque is empty
+    llvm::Function* runFunction(); // void (i64 worker, intptr* until): runs tasks until *until is Done, for good if it's null
+    llvm::Function* threadFunction(); // i8* (i8* worker), of pthread_create
+    llvm::Function* pollFunction(); // void (): waits for descriptors and timers, queues what's ready
+    llvm::Function* wakeFunction(); // void (i1 all): a sleeping worker, or all of them
+    llvm::Function* finishedFunction(); // void (): a task a thread blocks on is done
+    llvm::Function* timerFunction(); // void (i64 deadline, i8* task): queued once the monotonic clock reaches it, in ms
+    llvm::Function* clockFunction(); // i64 (): monotonic milliseconds
+};
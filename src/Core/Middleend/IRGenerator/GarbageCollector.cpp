@@ -0,0 +1,981 @@
+#include "GarbageCollector.hpp"
+
+#include <algorithm>
+#include <format>
+
+// LLVM Primitives
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/MDBuilder.h"
+#if LLVM_VERSION_MAJOR >= 17
+#include "llvm/TargetParser/Triple.h"
+#else
+#include "llvm/ADT/Triple.h"
+#endif
+
+#include "Pointers.hpp"
+
+static constexpr uint64_t BlockSize = 32 * 1024, LineShift = 7, LineSize = 1 << LineShift, LineCount = BlockSize / LineSize;
+static constexpr uint64_t FirstLine = LineCount / LineSize; // line marks are a byte per line at the start of the block
+static constexpr uint64_t HeaderSize = 8, LargeHeaderSize = 16; // a large object also links to the next one
+static constexpr uint64_t LargeObject = 8 * 1024;
+static constexpr uint64_t MinimumNursery = 256 * 1024, InitialNursery = 4 * 1024 * 1024, MaximumNursery = 64 * 1024 * 1024;
+static constexpr uint64_t InitialThreshold = 16 * 1024 * 1024;
+
+// Header: size in the low 32 bits, then a byte of flags, then the index of the block. A traced object is Visited at a
+// collection once its flag is the same as the epoch's, which flips at every collection.
+enum HeaderFlags : uint64_t { Static = 1, Large = 2, Old = 4, Marked = 8, Traced = 16, Visited = 32 };
+static constexpr uint64_t FlagsShift = 32, BlockShift = 40;
+
+static uint64_t initialValue(const std::string& name, const GarbageCollector::Settings& settings) {
+    if (name == "nursery") return InitialNursery;
+    if (name == "threshold") return settings.heapSize ? std::min(InitialThreshold, settings.heapSize) : InitialThreshold;
+    if (name == "line") return FirstLine;
+    return 0;
+}
+
+// Object bytes with the header, in multiples of 8
+static llvm::Value* objectBytes(llvm::IRBuilder<>& at, llvm::Value* size) {
+    return at.CreateAnd(at.CreateAdd(size, at.getInt64(HeaderSize + 7)), at.getInt64(~uint64_t(7)));
+}
+
+// for (i = from; i < to; i++) body(i), the builder is left after the loop
+static void forRange(llvm::IRBuilder<>& at, llvm::Value* from, llvm::Value* to, const std::function<void(llvm::Value*)>& body) {
+    llvm::Function* function = at.GetInsertBlock()->getParent();
+    llvm::BasicBlock* before = at.GetInsertBlock();
+    llvm::BasicBlock* header = llvm::BasicBlock::Create(at.getContext(), "loop", function);
+    llvm::BasicBlock* inside = llvm::BasicBlock::Create(at.getContext(), "loop.body", function);
+    llvm::BasicBlock* after = llvm::BasicBlock::Create(at.getContext(), "loop.end", function);
+    at.CreateBr(header);
+
+    at.SetInsertPoint(header);
+    llvm::PHINode* index = at.CreatePHI(from->getType(), 2);
+    index->addIncoming(from, before);
+    at.CreateCondBr(at.CreateICmpULT(index, to), inside, after);
+
+    at.SetInsertPoint(inside);
+    body(index);
+    index->addIncoming(at.CreateAdd(index, llvm::ConstantInt::get(from->getType(), 1)), at.GetInsertBlock());
+    at.CreateBr(header);
+    at.SetInsertPoint(after);
+}
+
+// if (condition) body(), the builder is left after it
+static void ifThen(llvm::IRBuilder<>& at, llvm::Value* condition, const std::function<void()>& body) {
+    llvm::Function* function = at.GetInsertBlock()->getParent();
+    llvm::BasicBlock* then = llvm::BasicBlock::Create(at.getContext(), "then", function);
+    llvm::BasicBlock* after = llvm::BasicBlock::Create(at.getContext(), "then.end", function);
+    at.CreateCondBr(condition, then, after);
+    at.SetInsertPoint(then);
+    body();
+    at.CreateBr(after);
+    at.SetInsertPoint(after);
+}
+
+// ==== Helpers ====
+
+llvm::Type* GarbageCollector::bytePointer() { return pointerTo(llvm::Type::getInt8Ty(context)); }
+
+llvm::Type* GarbageCollector::sizeType() { return module.getDataLayout().getIntPtrType(context); }
+
+llvm::GlobalVariable* GarbageCollector::state(const std::string& name, llvm::Type* type) {
+    std::string symbol = "neoluma.gc." + name;
+    if (llvm::GlobalVariable* existing = module.getNamedGlobal(symbol)) return existing;
+    llvm::Constant* initial = type->isPointerTy() ? llvm::Constant::getNullValue(type) : llvm::ConstantInt::get(type, initialValue(name, settings));
+    return new llvm::GlobalVariable(module, type, false, llvm::GlobalValue::LinkOnceODRLinkage, initial, symbol);
+}
+
+llvm::Value* GarbageCollector::load(llvm::IRBuilderBase& at, const std::string& name, llvm::Type* type) { return at.CreateLoad(type, state(name, type)); }
+
+void GarbageCollector::store(llvm::IRBuilderBase& at, const std::string& name, llvm::Value* value) { at.CreateStore(value, state(name, value->getType())); }
+
+void GarbageCollector::add(llvm::IRBuilderBase& at, const std::string& name, llvm::Value* value) {
+    store(at, name, at.CreateAdd(load(at, name, at.getInt64Ty()), value));
+}
+
+llvm::Function* GarbageCollector::create(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters) {
+    return llvm::Function::Create(llvm::FunctionType::get(result, parameters, false), llvm::GlobalValue::LinkOnceODRLinkage, name, module);
+}
+
+llvm::FunctionCallee GarbageCollector::libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters, bool variadic) {
+    return module.getOrInsertFunction(name, llvm::FunctionType::get(result, parameters, variadic));
+}
+
+llvm::Value* GarbageCollector::objectHeader(llvm::IRBuilderBase& at, llvm::Value* object) {
+    llvm::Value* header = at.CreateGEP(at.getInt8Ty(), object, at.getInt64(-int64_t(HeaderSize)));
+    return at.CreatePointerCast(header, pointerTo(at.getInt64Ty()));
+}
+
+llvm::Value* GarbageCollector::limbs(llvm::IRBuilderBase& at, llvm::Value* slot) {
+    // {i64 coefficient, i32 exponent, i32 length}: the coefficient points to limbs unless the length is 0
+    llvm::Type* i32 = at.getInt32Ty();
+    llvm::StructType* number = llvm::StructType::get(context, {at.getInt64Ty(), i32, i32});
+    llvm::Value* fields = at.CreatePointerCast(slot, pointerTo(number));
+    llvm::Value* length = at.CreateLoad(i32, at.CreateStructGEP(number, fields, 2));
+    llvm::Value* coefficient = at.CreateLoad(at.getInt64Ty(), at.CreateStructGEP(number, fields, 0));
+    return at.CreateSelect(at.CreateIsNull(length), llvm::Constant::getNullValue(bytePointer()), at.CreateIntToPtr(coefficient, bytePointer()));
+}
+
+llvm::Constant* GarbageCollector::staticHeader() { return llvm::ConstantInt::get(llvm::Type::getInt64Ty(context), Static << FlagsShift); }
+
+llvm::GlobalVariable* GarbageCollector::frames() { return state("frames", bytePointer()); }
+
+llvm::Function* GarbageCollector::mark() { return markFunction(); }
+
+// ==== Allocation ====
+
+llvm::Function* GarbageCollector::allocate() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.alloc")) return existing;
+
+    llvm::Function* function = create("neoluma.gc.alloc", bytePointer(), {llvm::Type::getInt64Ty(context)});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* bump = llvm::BasicBlock::Create(context, "bump", function);
+    llvm::BasicBlock* slow = llvm::BasicBlock::Create(context, "slow", function);
+    llvm::IRBuilder<> body(entry);
+
+    // the object fits in what's left of the hole: a pointer bump and a header
+    llvm::Value* size = function->getArg(0);
+    llvm::Value* cursor = load(body, "cursor", bytePointer());
+    llvm::Value* next = body.CreateGEP(body.getInt8Ty(), cursor, objectBytes(body, size));
+    llvm::Value* fits = body.CreateICmpULE(body.CreatePtrToInt(next, body.getInt64Ty()), body.CreatePtrToInt(load(body, "limit", bytePointer()), body.getInt64Ty()));
+    body.CreateCondBr(fits, bump, slow, llvm::MDBuilder(context).createBranchWeights(1000, 1));
+
+    body.SetInsertPoint(bump);
+    store(body, "cursor", next);
+    llvm::Value* object = body.CreateConstInBoundsGEP1_64(body.getInt8Ty(), cursor, HeaderSize);
+    body.CreateStore(body.CreateOr(size, body.CreateShl(load(body, "block", body.getInt64Ty()), BlockShift)), objectHeader(body, object));
+    body.CreateRet(object);
+
+    body.SetInsertPoint(slow);
+    body.CreateRet(body.CreateCall(slowPathFunction(), {size}));
+    return function;
+}
+
+llvm::Function* GarbageCollector::slowPathFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.slowPath")) return existing;
+
+    llvm::Function* function = create("neoluma.gc.slowPath", bytePointer(), {llvm::Type::getInt64Ty(context)});
+    function->addFnAttr(llvm::Attribute::NoInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* large = llvm::BasicBlock::Create(context, "large", function);
+    llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "loop", function);
+    llvm::BasicBlock* minor = llvm::BasicBlock::Create(context, "minor", function);
+    llvm::BasicBlock* find = llvm::BasicBlock::Create(context, "find", function);
+    llvm::BasicBlock* bump = llvm::BasicBlock::Create(context, "bump", function);
+    llvm::BasicBlock* exhausted = llvm::BasicBlock::Create(context, "exhausted", function);
+    llvm::BasicBlock* retry = llvm::BasicBlock::Create(context, "retry", function);
+    llvm::BasicBlock* old = llvm::BasicBlock::Create(context, "old", function);
+    llvm::BasicBlock* full = llvm::BasicBlock::Create(context, "full", function);
+    llvm::BasicBlock* limit = llvm::BasicBlock::Create(context, "limit", function);
+    llvm::BasicBlock* grow = llvm::BasicBlock::Create(context, "grow", function);
+    llvm::BasicBlock* outOfMemory = llvm::BasicBlock::Create(context, "oom", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* i64 = body.getInt64Ty();
+
+    llvm::Value* size = function->getArg(0);
+    llvm::Value* bytes = objectBytes(body, size);
+    // collections that already ran for this object
+    llvm::Value* minorRan = body.CreateAlloca(body.getInt1Ty(), nullptr, "minor.ran");
+    llvm::Value* fullRan = body.CreateAlloca(body.getInt1Ty(), nullptr, "full.ran");
+    body.CreateStore(body.getFalse(), minorRan);
+    body.CreateStore(body.getFalse(), fullRan);
+    body.CreateCondBr(body.CreateICmpUGT(bytes, body.getInt64(LargeObject)), large, loop);
+
+    body.SetInsertPoint(large);
+    body.CreateRet(body.CreateCall(largeFunction(), {size}));
+
+    // the nursery took its budget: a minor collection before any more of it
+    body.SetInsertPoint(loop);
+    body.CreateCondBr(body.CreateICmpUGE(load(body, "young", i64), load(body, "nursery", i64)), minor, find);
+
+    body.SetInsertPoint(minor);
+    body.CreateCall(collectFunction(), {body.getFalse()});
+    body.CreateBr(find);
+
+    body.SetInsertPoint(find);
+    body.CreateCondBr(body.CreateCall(holeFunction(), {bytes}), bump, exhausted);
+
+    body.SetInsertPoint(bump);
+    llvm::Value* cursor = load(body, "cursor", bytePointer());
+    store(body, "cursor", body.CreateGEP(body.getInt8Ty(), cursor, bytes));
+    llvm::Value* object = body.CreateConstInBoundsGEP1_64(body.getInt8Ty(), cursor, HeaderSize);
+    body.CreateStore(body.CreateOr(size, body.CreateShl(load(body, "block", i64), BlockShift)), objectHeader(body, object));
+    body.CreateRet(object);
+
+    // No hole is left: a new block, unless the heap would grow past its threshold or its limit. Then the nursery is
+    // collected first, if it has anything in it, and the whole heap if that didn't help.
+    body.SetInsertPoint(exhausted);
+    llvm::Value* grown = body.CreateAdd(load(body, "heap", i64), body.getInt64(BlockSize));
+    llvm::Value* overLimit = settings.heapSize ? body.CreateICmpUGT(grown, body.getInt64(settings.heapSize)) : body.getFalse();
+    llvm::Value* overThreshold = body.CreateOr(body.CreateICmpUGT(grown, load(body, "threshold", i64)), overLimit);
+    llvm::Value* anyYoung = body.CreateICmpUGE(load(body, "young", i64), body.getInt64(MinimumNursery));
+    llvm::Value* tryMinor = body.CreateAnd(anyYoung, body.CreateNot(body.CreateLoad(body.getInt1Ty(), minorRan)));
+    body.CreateCondBr(body.CreateAnd(overThreshold, tryMinor), retry, old);
+
+    body.SetInsertPoint(retry);
+    body.CreateCall(collectFunction(), {body.getFalse()});
+    body.CreateStore(body.getTrue(), minorRan);
+    body.CreateBr(find);
+
+    body.SetInsertPoint(old);
+    body.CreateCondBr(body.CreateAnd(overThreshold, body.CreateNot(body.CreateLoad(body.getInt1Ty(), fullRan))), full, limit);
+
+    body.SetInsertPoint(full);
+    body.CreateCall(collectFunction(), {body.getTrue()});
+    body.CreateStore(body.getTrue(), fullRan);
+    body.CreateBr(loop);
+
+    body.SetInsertPoint(limit);
+    body.CreateCondBr(overLimit, outOfMemory, grow);
+
+    body.SetInsertPoint(grow);
+    body.CreateCall(growFunction());
+    body.CreateBr(bump);
+
+    body.SetInsertPoint(outOfMemory);
+    body.CreateCall(outOfMemoryFunction());
+    body.CreateUnreachable();
+    return function;
+}
+
+llvm::Function* GarbageCollector::holeFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.hole")) return existing;
+
+    // goes on from the line after the last hole, through the blocks in order
+    llvm::Function* function = create("neoluma.gc.hole", llvm::Type::getInt1Ty(context), {llvm::Type::getInt64Ty(context)});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* blockLoop = llvm::BasicBlock::Create(context, "block", function);
+    llvm::BasicBlock* none = llvm::BasicBlock::Create(context, "none", function);
+    llvm::BasicBlock* blockStart = llvm::BasicBlock::Create(context, "block.start", function);
+    llvm::BasicBlock* lineLoop = llvm::BasicBlock::Create(context, "line", function);
+    llvm::BasicBlock* lineCheck = llvm::BasicBlock::Create(context, "line.check", function);
+    llvm::BasicBlock* skip = llvm::BasicBlock::Create(context, "skip", function);
+    llvm::BasicBlock* holeStart = llvm::BasicBlock::Create(context, "hole.start", function);
+    llvm::BasicBlock* holeLoop = llvm::BasicBlock::Create(context, "hole", function);
+    llvm::BasicBlock* holeCheck = llvm::BasicBlock::Create(context, "hole.check", function);
+    llvm::BasicBlock* holeNext = llvm::BasicBlock::Create(context, "hole.next", function);
+    llvm::BasicBlock* holeEnd = llvm::BasicBlock::Create(context, "hole.end", function);
+    llvm::BasicBlock* claim = llvm::BasicBlock::Create(context, "claim", function);
+    llvm::BasicBlock* nextBlock = llvm::BasicBlock::Create(context, "block.next", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* i64 = body.getInt64Ty();
+    llvm::Value* bytes = function->getArg(0);
+
+    // what the last hole got is counted as allocated once it's left
+    llvm::Value* cursorNow = load(body, "cursor", bytePointer());
+    add(body, "allocated", body.CreateSub(body.CreatePtrToInt(cursorNow, i64), body.CreatePtrToInt(load(body, "start", bytePointer()), i64)));
+    store(body, "start", cursorNow);
+    body.CreateBr(blockLoop);
+
+    body.SetInsertPoint(blockLoop);
+    llvm::Value* index = load(body, "scan", i64);
+    body.CreateCondBr(body.CreateICmpULT(index, load(body, "blockCount", i64)), blockStart, none);
+
+    body.SetInsertPoint(none);
+    body.CreateRet(body.getFalse());
+
+    // a block a full collection gave back is skipped
+    body.SetInsertPoint(blockStart);
+    llvm::Value* base = body.CreateLoad(bytePointer(), body.CreateGEP(bytePointer(), load(body, "blocks", pointerTo(bytePointer())), index));
+    body.CreateCondBr(body.CreateIsNull(base), nextBlock, lineLoop);
+
+    body.SetInsertPoint(lineLoop);
+    llvm::Value* line = load(body, "line", i64);
+    body.CreateCondBr(body.CreateICmpULT(line, body.getInt64(LineCount)), lineCheck, nextBlock);
+
+    body.SetInsertPoint(lineCheck);
+    llvm::Value* marked = body.CreateLoad(body.getInt8Ty(), body.CreateGEP(body.getInt8Ty(), base, line));
+    body.CreateCondBr(body.CreateICmpNE(marked, body.getInt8(0)), skip, holeStart);
+
+    body.SetInsertPoint(skip);
+    store(body, "line", body.CreateAdd(line, body.getInt64(1)));
+    body.CreateBr(lineLoop);
+
+    // a hole is every free line up to the next marked one
+    body.SetInsertPoint(holeStart);
+    store(body, "line", body.CreateAdd(line, body.getInt64(1)));
+    body.CreateBr(holeLoop);
+
+    body.SetInsertPoint(holeLoop);
+    llvm::Value* end = load(body, "line", i64);
+    body.CreateCondBr(body.CreateICmpULT(end, body.getInt64(LineCount)), holeCheck, holeEnd);
+
+    body.SetInsertPoint(holeCheck);
+    llvm::Value* endMarked = body.CreateLoad(body.getInt8Ty(), body.CreateGEP(body.getInt8Ty(), base, end));
+    body.CreateCondBr(body.CreateICmpEQ(endMarked, body.getInt8(0)), holeNext, holeEnd);
+
+    body.SetInsertPoint(holeNext);
+    store(body, "line", body.CreateAdd(end, body.getInt64(1)));
+    body.CreateBr(holeLoop);
+
+    // one too small for the object is passed over until the next collection
+    body.SetInsertPoint(holeEnd);
+    llvm::Value* holeEndLine = load(body, "line", i64);
+    llvm::Value* freeBytes = body.CreateMul(body.CreateSub(holeEndLine, line), body.getInt64(LineSize));
+    body.CreateCondBr(body.CreateICmpUGE(freeBytes, bytes), claim, lineLoop);
+
+    body.SetInsertPoint(claim);
+    llvm::Value* cursor = body.CreateGEP(body.getInt8Ty(), base, body.CreateMul(line, body.getInt64(LineSize)));
+    store(body, "cursor", cursor);
+    store(body, "start", cursor);
+    store(body, "limit", body.CreateGEP(body.getInt8Ty(), base, body.CreateMul(holeEndLine, body.getInt64(LineSize))));
+    store(body, "block", index);
+    add(body, "young", freeBytes);
+    body.CreateRet(body.getTrue());
+
+    body.SetInsertPoint(nextBlock);
+    store(body, "scan", body.CreateAdd(index, body.getInt64(1)));
+    store(body, "line", body.getInt64(FirstLine));
+    body.CreateBr(blockLoop);
+    return function;
+}
+
+llvm::Function* GarbageCollector::growFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.grow")) return existing;
+
+    // a slot a full collection emptied is taken first, the table grows otherwise
+    llvm::Function* function = create("neoluma.gc.grow", llvm::Type::getVoidTy(context), {});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* search = llvm::BasicBlock::Create(context, "search", function);
+    llvm::BasicBlock* check = llvm::BasicBlock::Create(context, "check", function);
+    llvm::BasicBlock* next = llvm::BasicBlock::Create(context, "next", function);
+    llvm::BasicBlock* append = llvm::BasicBlock::Create(context, "append", function);
+    llvm::BasicBlock* resize = llvm::BasicBlock::Create(context, "resize", function);
+    llvm::BasicBlock* resized = llvm::BasicBlock::Create(context, "resized", function);
+    llvm::BasicBlock* appended = llvm::BasicBlock::Create(context, "appended", function);
+    llvm::BasicBlock* allocate = llvm::BasicBlock::Create(context, "allocate", function);
+    llvm::BasicBlock* clear = llvm::BasicBlock::Create(context, "clear", function);
+    llvm::BasicBlock* outOfMemory = llvm::BasicBlock::Create(context, "oom", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* i64 = body.getInt64Ty();
+    llvm::Type* table = pointerTo(bytePointer());
+    uint64_t pointerSize = module.getDataLayout().getPointerSize();
+
+    llvm::Value* count = load(body, "blockCount", i64);
+    body.CreateBr(search);
+
+    body.SetInsertPoint(search);
+    llvm::PHINode* index = body.CreatePHI(i64, 2);
+    index->addIncoming(body.getInt64(0), entry);
+    body.CreateCondBr(body.CreateICmpULT(index, count), check, append);
+
+    body.SetInsertPoint(check);
+    llvm::Value* slot = body.CreateLoad(bytePointer(), body.CreateGEP(bytePointer(), load(body, "blocks", table), index));
+    body.CreateCondBr(body.CreateIsNull(slot), allocate, next);
+
+    body.SetInsertPoint(next);
+    index->addIncoming(body.CreateAdd(index, body.getInt64(1)), next);
+    body.CreateBr(search);
+
+    body.SetInsertPoint(append);
+    llvm::Value* capacity = load(body, "blockCapacity", i64);
+    body.CreateCondBr(body.CreateICmpEQ(count, capacity), resize, appended);
+
+    body.SetInsertPoint(resize);
+    llvm::Value* doubled = body.CreateSelect(body.CreateICmpEQ(capacity, body.getInt64(0)), body.getInt64(16), body.CreateShl(capacity, 1));
+    llvm::Value* bytes = body.CreateZExtOrTrunc(body.CreateMul(doubled, body.getInt64(pointerSize)), sizeType());
+    llvm::Value* blocks = body.CreateCall(libc("realloc", bytePointer(), {bytePointer(), sizeType()}), {body.CreatePointerCast(load(body, "blocks", table), bytePointer()), bytes});
+    body.CreateCondBr(body.CreateIsNull(blocks), outOfMemory, resized);
+
+    body.SetInsertPoint(resized);
+    store(body, "blocks", body.CreatePointerCast(blocks, table));
+    store(body, "blockCapacity", doubled);
+    body.CreateBr(appended);
+
+    body.SetInsertPoint(appended);
+    store(body, "blockCount", body.CreateAdd(count, body.getInt64(1)));
+    body.CreateBr(allocate);
+
+    body.SetInsertPoint(allocate);
+    llvm::PHINode* taken = body.CreatePHI(i64, 2);
+    taken->addIncoming(index, check);
+    taken->addIncoming(count, appended);
+    llvm::Value* block = body.CreateCall(libc("malloc", bytePointer(), {sizeType()}), {llvm::ConstantInt::get(sizeType(), BlockSize)});
+    body.CreateCondBr(body.CreateIsNull(block), outOfMemory, clear);
+
+    // Every line of a new block is free, all of it is the next hole. Holes are only looked for past it until the
+    // next collection: the lines the nursery took in blocks already passed aren't marked.
+    body.SetInsertPoint(clear);
+    body.CreateMemSet(block, body.getInt8(0), FirstLine * LineSize, llvm::MaybeAlign(16));
+    body.CreateStore(block, body.CreateGEP(bytePointer(), load(body, "blocks", table), taken));
+    llvm::Value* cursor = body.CreateConstInBoundsGEP1_64(body.getInt8Ty(), block, FirstLine * LineSize);
+    store(body, "cursor", cursor);
+    store(body, "start", cursor);
+    store(body, "limit", body.CreateConstInBoundsGEP1_64(body.getInt8Ty(), block, BlockSize));
+    store(body, "block", taken);
+    store(body, "scan", load(body, "blockCount", i64));
+    add(body, "young", body.getInt64(BlockSize - FirstLine * LineSize));
+    add(body, "heap", body.getInt64(BlockSize));
+    body.CreateRetVoid();
+
+    body.SetInsertPoint(outOfMemory);
+    body.CreateCall(outOfMemoryFunction());
+    body.CreateUnreachable();
+    return function;
+}
+
+llvm::Function* GarbageCollector::largeFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.large")) return existing;
+
+    // large objects are young in their own list until a collection, their bytes count against the nursery
+    llvm::Function* function = create("neoluma.gc.large", bytePointer(), {llvm::Type::getInt64Ty(context)});
+    function->addFnAttr(llvm::Attribute::NoInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* minor = llvm::BasicBlock::Create(context, "minor", function);
+    llvm::BasicBlock* limit = llvm::BasicBlock::Create(context, "limit", function);
+    llvm::BasicBlock* full = llvm::BasicBlock::Create(context, "full", function);
+    llvm::BasicBlock* allocate = llvm::BasicBlock::Create(context, "allocate", function);
+    llvm::BasicBlock* link = llvm::BasicBlock::Create(context, "link", function);
+    llvm::BasicBlock* outOfMemory = llvm::BasicBlock::Create(context, "oom", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* i64 = body.getInt64Ty();
+
+    llvm::Value* size = function->getArg(0);
+    llvm::Value* bytes = body.CreateAdd(size, body.getInt64(LargeHeaderSize));
+    body.CreateCondBr(body.CreateICmpUGE(load(body, "young", i64), load(body, "nursery", i64)), minor, limit);
+
+    body.SetInsertPoint(minor);
+    body.CreateCall(collectFunction(), {body.getFalse()});
+    body.CreateBr(limit);
+
+    auto overLimit = [&] { return body.CreateICmpUGT(body.CreateAdd(load(body, "heap", i64), bytes), body.getInt64(settings.heapSize)); };
+    body.SetInsertPoint(limit);
+    if (settings.heapSize) body.CreateCondBr(overLimit(), full, allocate);
+    else body.CreateBr(allocate);
+
+    body.SetInsertPoint(full);
+    body.CreateCall(collectFunction(), {body.getTrue()});
+    if (settings.heapSize) body.CreateCondBr(overLimit(), outOfMemory, allocate);
+    else body.CreateBr(allocate);
+
+    body.SetInsertPoint(allocate);
+    llvm::Value* memory = body.CreateCall(libc("malloc", bytePointer(), {sizeType()}), {body.CreateZExtOrTrunc(bytes, sizeType())});
+    body.CreateCondBr(body.CreateIsNull(memory), outOfMemory, link);
+
+    body.SetInsertPoint(link);
+    body.CreateStore(load(body, "largeYoung", bytePointer()), body.CreatePointerCast(memory, pointerTo(bytePointer())));
+    store(body, "largeYoung", memory);
+    llvm::Value* object = body.CreateConstInBoundsGEP1_64(body.getInt8Ty(), memory, LargeHeaderSize);
+    body.CreateStore(body.CreateOr(size, body.getInt64(Large << FlagsShift)), objectHeader(body, object));
+    add(body, "young", bytes);
+    add(body, "heap", bytes);
+    add(body, "largeBytes", bytes);
+    add(body, "allocated", bytes);
+    body.CreateRet(object);
+
+    body.SetInsertPoint(outOfMemory);
+    body.CreateCall(outOfMemoryFunction());
+    body.CreateUnreachable();
+    return function;
+}
+
+// ==== Collection ====
+
+llvm::Function* GarbageCollector::collectFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.collect")) return existing;
+
+    llvm::Function* function = create("neoluma.gc.collect", llvm::Type::getVoidTy(context), {llvm::Type::getInt1Ty(context)});
+    function->addFnAttr(llvm::Attribute::NoInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* clear = llvm::BasicBlock::Create(context, "clear", function);
+    llvm::BasicBlock* roots = llvm::BasicBlock::Create(context, "roots", function);
+    llvm::BasicBlock* globals = llvm::BasicBlock::Create(context, "globals", function);
+    llvm::BasicBlock* sweepFull = llvm::BasicBlock::Create(context, "sweep.full", function);
+    llvm::BasicBlock* sweepMinor = llvm::BasicBlock::Create(context, "sweep.minor", function);
+    llvm::BasicBlock* reset = llvm::BasicBlock::Create(context, "reset", function);
+    llvm::BasicBlock* fullStats = llvm::BasicBlock::Create(context, "stats.full", function);
+    llvm::BasicBlock* minorStats = llvm::BasicBlock::Create(context, "stats.minor", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* i64 = body.getInt64Ty();
+    llvm::Type* slots = pointerTo(bytePointer());
+
+    llvm::Value* full = function->getArg(0);
+    llvm::Value* started = body.CreateCall(clockFunction());
+    llvm::Value* kept = body.CreateAlloca(bytePointer(), nullptr, "kept");
+    llvm::Value* used = body.CreateSub(body.CreatePtrToInt(load(body, "cursor", bytePointer()), i64), body.CreatePtrToInt(load(body, "start", bytePointer()), i64));
+    add(body, "allocated", used);
+    store(body, "full", body.CreateZExt(full, body.getInt8Ty()));
+    store(body, "epoch", body.CreateXor(load(body, "epoch", i64), body.getInt64(Visited << FlagsShift)));
+    llvm::Value* blockCount = load(body, "blockCount", i64);
+    body.CreateCondBr(full, clear, roots);
+
+    // a full collection starts with no line marked
+    body.SetInsertPoint(clear);
+    forRange(body, body.getInt64(0), blockCount, [&](llvm::Value* index) {
+        llvm::Value* block = body.CreateLoad(bytePointer(), body.CreateGEP(bytePointer(), load(body, "blocks", slots), index));
+        ifThen(body, body.CreateIsNotNull(block), [&] { body.CreateMemSet(block, body.getInt8(0), FirstLine * LineSize, llvm::MaybeAlign(16)); });
+    });
+    body.CreateBr(roots);
+
+    // every frame of a chain: [next frame, root count, roots..., numbers...]
+    auto walk = [&](const std::string& chain) {
+        llvm::BasicBlock* before = body.GetInsertBlock();
+        llvm::BasicBlock* frameLoop = llvm::BasicBlock::Create(context, chain, function, globals);
+        llvm::BasicBlock* frameBody = llvm::BasicBlock::Create(context, chain + ".body", function, globals);
+        llvm::BasicBlock* after = llvm::BasicBlock::Create(context, chain + ".end", function, globals);
+        llvm::Value* top = load(body, chain, bytePointer());
+        body.CreateBr(frameLoop);
+
+        body.SetInsertPoint(frameLoop);
+        llvm::PHINode* frame = body.CreatePHI(bytePointer(), 2);
+        frame->addIncoming(top, before);
+        body.CreateCondBr(body.CreateIsNull(frame), after, frameBody);
+
+        body.SetInsertPoint(frameBody);
+        llvm::Value* frameSlots = body.CreatePointerCast(frame, slots);
+        llvm::Value* counts = body.CreatePtrToInt(body.CreateLoad(bytePointer(), body.CreateConstGEP1_64(bytePointer(), frameSlots, 1)), i64);
+        llvm::Value* rootCount = body.CreateAnd(counts, body.getInt64(0xFFFFFFFF));
+        forRange(body, body.getInt64(0), rootCount, [&](llvm::Value* index) {
+            llvm::Value* slot = body.CreateGEP(bytePointer(), frameSlots, body.CreateAdd(index, body.getInt64(2)));
+            body.CreateCall(markFunction(), {body.CreateLoad(bytePointer(), slot)});
+        });
+        llvm::Value* numbers = body.CreateGEP(bytePointer(), frameSlots, body.CreateAdd(rootCount, body.getInt64(2)));
+        forRange(body, body.getInt64(0), body.CreateLShr(counts, 32), [&](llvm::Value* index) {
+            llvm::Value* slot = body.CreateGEP(bytePointer(), numbers, body.CreateShl(index, 1));
+            body.CreateCall(markFunction(), {limbs(body, slot)});
+        });
+        frame->addIncoming(body.CreateLoad(bytePointer(), frameSlots), body.GetInsertBlock());
+        body.CreateBr(frameLoop);
+        body.SetInsertPoint(after);
+    };
+
+    // the shadow stack, then the frames of suspended tasks, which live as long as their coroutines
+    body.SetInsertPoint(roots);
+    walk("frames");
+    walk("tasks");
+    body.CreateBr(globals);
+
+    // and every global a string was stored into
+    body.SetInsertPoint(globals);
+    llvm::Value* remembered = load(body, "roots", pointerTo(slots));
+    forRange(body, body.getInt64(0), load(body, "rootCount", i64), [&](llvm::Value* index) {
+        llvm::Value* slot = body.CreateLoad(slots, body.CreateGEP(slots, remembered, index));
+        // the slot of a number is remembered with its lowest bit set
+        llvm::Value* address = body.CreatePtrToInt(slot, i64);
+        llvm::Value* isNumber = body.CreateTrunc(address, body.getInt1Ty());
+        llvm::Value* number = body.CreateIntToPtr(body.CreateAnd(address, body.getInt64(~uint64_t(1))), slots);
+        ifThen(body, isNumber, [&] { body.CreateCall(markFunction(), {limbs(body, number)}); });
+        ifThen(body, body.CreateNot(isNumber), [&] { body.CreateCall(markFunction(), {body.CreateLoad(bytePointer(), slot)}); });
+    });
+    body.CreateCondBr(full, sweepFull, sweepMinor);
+
+    // After a full collection the heap may grow to twice what's live before the next one. Live lines are counted for
+    // it, and blocks with none are given back.
+    body.SetInsertPoint(sweepFull);
+    body.CreateStore(llvm::Constant::getNullValue(bytePointer()), kept);
+    body.CreateCall(sweepFunction(), {state("largeOld", bytePointer()), kept});
+    body.CreateCall(sweepFunction(), {state("largeYoung", bytePointer()), kept});
+    store(body, "largeOld", body.CreateLoad(bytePointer(), kept));
+    llvm::Value* lines = body.CreateAlloca(i64, nullptr, "lines");
+    body.CreateStore(body.getInt64(0), lines);
+    llvm::Value* blockLines = body.CreateAlloca(i64, nullptr, "block.lines");
+    forRange(body, body.getInt64(0), blockCount, [&](llvm::Value* index) {
+        llvm::Value* slot = body.CreateGEP(bytePointer(), load(body, "blocks", slots), index);
+        llvm::Value* block = body.CreateLoad(bytePointer(), slot);
+        ifThen(body, body.CreateIsNotNull(block), [&] {
+            body.CreateStore(body.getInt64(0), blockLines);
+            forRange(body, body.getInt64(FirstLine), body.getInt64(LineCount), [&](llvm::Value* line) {
+                llvm::Value* mark = body.CreateZExt(body.CreateLoad(body.getInt8Ty(), body.CreateGEP(body.getInt8Ty(), block, line)), i64);
+                body.CreateStore(body.CreateAdd(body.CreateLoad(i64, blockLines), mark), blockLines);
+            });
+            llvm::Value* marked = body.CreateLoad(i64, blockLines);
+            body.CreateStore(body.CreateAdd(body.CreateLoad(i64, lines), marked), lines);
+            ifThen(body, body.CreateIsNull(marked), [&] {
+                body.CreateCall(libc("free", body.getVoidTy(), {bytePointer()}), {block});
+                body.CreateStore(llvm::Constant::getNullValue(bytePointer()), slot);
+                store(body, "heap", body.CreateSub(load(body, "heap", i64), body.getInt64(BlockSize)));
+            });
+        });
+    });
+    llvm::Value* live = body.CreateAdd(body.CreateMul(body.CreateLoad(i64, lines), body.getInt64(LineSize)), load(body, "largeBytes", i64));
+    llvm::Value* threshold = body.CreateBinaryIntrinsic(llvm::Intrinsic::umax, body.CreateShl(live, 1), body.getInt64(InitialThreshold));
+    if (settings.heapSize) threshold = body.CreateBinaryIntrinsic(llvm::Intrinsic::umin, threshold, body.getInt64(settings.heapSize));
+    store(body, "threshold", threshold);
+    body.CreateBr(reset);
+
+    body.SetInsertPoint(sweepMinor);
+    body.CreateCall(sweepFunction(), {state("largeYoung", bytePointer()), state("largeOld", bytePointer())});
+    body.CreateBr(reset);
+
+    // allocation starts over from the first block, in the holes the collection left
+    body.SetInsertPoint(reset);
+    store(body, "young", body.getInt64(0));
+    store(body, "scan", body.getInt64(0));
+    store(body, "line", body.getInt64(FirstLine));
+    llvm::Value* null = llvm::Constant::getNullValue(bytePointer());
+    store(body, "cursor", null);
+    store(body, "limit", null);
+    store(body, "start", null);
+    llvm::Value* elapsed = body.CreateSub(body.CreateCall(clockFunction()), started);
+    body.CreateCondBr(full, fullStats, minorStats);
+
+    body.SetInsertPoint(fullStats);
+    add(body, "fullCount", body.getInt64(1));
+    add(body, "fullTime", elapsed);
+    store(body, "fullLongest", body.CreateBinaryIntrinsic(llvm::Intrinsic::umax, load(body, "fullLongest", i64), elapsed));
+    body.CreateRetVoid();
+
+    // The nursery is halved when a minor collection took longer than the target, doubled when it took under a quarter
+    // of it. It stays under half the full collection threshold, or the old generation would never get to fill it.
+    body.SetInsertPoint(minorStats);
+    add(body, "minorCount", body.getInt64(1));
+    add(body, "minorTime", elapsed);
+    store(body, "minorLongest", body.CreateBinaryIntrinsic(llvm::Intrinsic::umax, load(body, "minorLongest", i64), elapsed));
+    llvm::Value* nursery = load(body, "nursery", i64);
+    llvm::Value* target = body.getInt64(settings.pauseTarget);
+    llvm::Value* smaller = body.CreateBinaryIntrinsic(llvm::Intrinsic::umax, body.CreateLShr(nursery, 1), body.getInt64(MinimumNursery));
+    llvm::Value* ceiling = body.CreateBinaryIntrinsic(llvm::Intrinsic::umin, body.CreateLShr(load(body, "threshold", i64), 1), body.getInt64(MaximumNursery));
+    llvm::Value* larger = body.CreateBinaryIntrinsic(llvm::Intrinsic::umax, body.CreateBinaryIntrinsic(llvm::Intrinsic::umin, body.CreateShl(nursery, 1), ceiling), nursery);
+    llvm::Value* quick = body.CreateICmpULT(body.CreateShl(elapsed, 2), target);
+    store(body, "nursery", body.CreateSelect(body.CreateICmpUGT(elapsed, target), smaller, body.CreateSelect(quick, larger, nursery)));
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* GarbageCollector::markFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.mark")) return existing;
+
+    // marking an object is marking the lines it's on, a traced one has what it holds marked first
+    llvm::Function* function = create("neoluma.gc.mark", llvm::Type::getVoidTy(context), {bytePointer()});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* header = llvm::BasicBlock::Create(context, "header", function);
+    llvm::BasicBlock* traced = llvm::BasicBlock::Create(context, "traced", function);
+    llvm::BasicBlock* visit = llvm::BasicBlock::Create(context, "visit", function);
+    llvm::BasicBlock* trace = llvm::BasicBlock::Create(context, "trace", function);
+    llvm::BasicBlock* kind = llvm::BasicBlock::Create(context, "kind", function);
+    llvm::BasicBlock* large = llvm::BasicBlock::Create(context, "large", function);
+    llvm::BasicBlock* markLarge = llvm::BasicBlock::Create(context, "large.mark", function);
+    llvm::BasicBlock* lines = llvm::BasicBlock::Create(context, "lines", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* i64 = body.getInt64Ty();
+
+    llvm::Value* object = function->getArg(0);
+    body.CreateCondBr(body.CreateIsNull(object), done, header);
+
+    body.SetInsertPoint(header);
+    llvm::Value* headerPointer = objectHeader(body, object);
+    llvm::Value* value = body.CreateLoad(i64, headerPointer);
+    llvm::Value* flags = body.CreateLShr(value, FlagsShift);
+    body.CreateCondBr(body.CreateIsNotNull(body.CreateAnd(flags, body.getInt64(Static))), done, traced);
+
+    body.SetInsertPoint(traced);
+    body.CreateCondBr(body.CreateIsNotNull(body.CreateAnd(flags, body.getInt64(Traced))), visit, kind);
+
+    // once per collection: the flag is flipped to the epoch's before the tracer runs
+    body.SetInsertPoint(visit);
+    llvm::Value* visited = body.CreateAnd(value, body.getInt64(Visited << FlagsShift));
+    body.CreateCondBr(body.CreateICmpEQ(visited, load(body, "epoch", i64)), done, trace);
+
+    body.SetInsertPoint(trace);
+    body.CreateStore(body.CreateXor(value, body.getInt64(Visited << FlagsShift)), headerPointer);
+    llvm::FunctionType* tracerType = llvm::FunctionType::get(body.getVoidTy(), {bytePointer()}, false);
+    llvm::Value* tracerSlot = body.CreateGEP(body.getInt8Ty(), object, body.CreateSub(body.CreateAnd(value, body.getInt64(0xffffffff)), body.getInt64(8)));
+    llvm::Value* tracer = body.CreateLoad(pointerTo(tracerType), body.CreatePointerCast(tracerSlot, pointerTo(pointerTo(tracerType))));
+    body.CreateCall(tracerType, tracer, {object});
+    body.CreateBr(kind);
+
+    body.SetInsertPoint(kind);
+    body.CreateCondBr(body.CreateIsNotNull(body.CreateAnd(flags, body.getInt64(Large))), large, lines);
+
+    // an old large object stays until a full collection looks at it
+    body.SetInsertPoint(large);
+    llvm::Value* young = body.CreateIsNull(body.CreateAnd(flags, body.getInt64(Old)));
+    llvm::Value* full = body.CreateIsNotNull(load(body, "full", body.getInt8Ty()));
+    body.CreateCondBr(body.CreateOr(young, full), markLarge, done);
+
+    body.SetInsertPoint(markLarge);
+    body.CreateStore(body.CreateOr(body.CreateLoad(i64, headerPointer), body.getInt64(Marked << FlagsShift)), headerPointer);
+    body.CreateBr(done);
+
+    body.SetInsertPoint(lines);
+    llvm::Value* bytes = objectBytes(body, body.CreateAnd(value, body.getInt64(0xffffffff)));
+    llvm::Value* block = body.CreateLoad(bytePointer(), body.CreateGEP(bytePointer(), load(body, "blocks", pointerTo(bytePointer())), body.CreateLShr(value, BlockShift)));
+    llvm::Value* offset = body.CreateSub(body.CreatePtrToInt(headerPointer, i64), body.CreatePtrToInt(block, i64));
+    llvm::Value* first = body.CreateLShr(offset, LineShift);
+    llvm::Value* last = body.CreateLShr(body.CreateSub(body.CreateAdd(offset, bytes), body.getInt64(1)), LineShift);
+    body.CreateMemSet(body.CreateGEP(body.getInt8Ty(), block, first), body.getInt8(1), body.CreateAdd(body.CreateSub(last, first), body.getInt64(1)), llvm::MaybeAlign(1));
+    body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* GarbageCollector::sweepFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.sweep")) return existing;
+
+    // marked large objects go to `to` as old ones, the rest are freed
+    llvm::Type* list = pointerTo(bytePointer());
+    llvm::Function* function = create("neoluma.gc.sweep", llvm::Type::getVoidTy(context), {list, list});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "loop", function);
+    llvm::BasicBlock* visit = llvm::BasicBlock::Create(context, "visit", function);
+    llvm::BasicBlock* keep = llvm::BasicBlock::Create(context, "keep", function);
+    llvm::BasicBlock* release = llvm::BasicBlock::Create(context, "free", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* i64 = body.getInt64Ty();
+    llvm::Value* from = function->getArg(0);
+    llvm::Value* to = function->getArg(1);
+
+    llvm::Value* first = body.CreateLoad(bytePointer(), from);
+    body.CreateStore(llvm::Constant::getNullValue(bytePointer()), from);
+    body.CreateBr(loop);
+
+    body.SetInsertPoint(loop);
+    llvm::PHINode* memory = body.CreatePHI(bytePointer(), 3);
+    memory->addIncoming(first, entry);
+    body.CreateCondBr(body.CreateIsNull(memory), done, visit);
+
+    body.SetInsertPoint(visit);
+    llvm::Value* link = body.CreatePointerCast(memory, list);
+    llvm::Value* next = body.CreateLoad(bytePointer(), link);
+    llvm::Value* headerPointer = objectHeader(body, body.CreateConstInBoundsGEP1_64(body.getInt8Ty(), memory, LargeHeaderSize));
+    llvm::Value* header = body.CreateLoad(i64, headerPointer);
+    body.CreateCondBr(body.CreateIsNotNull(body.CreateAnd(header, body.getInt64(Marked << FlagsShift))), keep, release);
+
+    body.SetInsertPoint(keep);
+    body.CreateStore(body.CreateOr(body.CreateAnd(header, body.getInt64(~(Marked << FlagsShift))), body.getInt64(Old << FlagsShift)), headerPointer);
+    body.CreateStore(body.CreateLoad(bytePointer(), to), link);
+    body.CreateStore(memory, to);
+    body.CreateBr(loop);
+
+    body.SetInsertPoint(release);
+    llvm::Value* bytes = body.CreateAdd(body.CreateAnd(header, body.getInt64(0xffffffff)), body.getInt64(LargeHeaderSize));
+    store(body, "heap", body.CreateSub(load(body, "heap", i64), bytes));
+    store(body, "largeBytes", body.CreateSub(load(body, "largeBytes", i64), bytes));
+    body.CreateCall(libc("free", body.getVoidTy(), {bytePointer()}), {memory});
+    body.CreateBr(loop);
+
+    memory->addIncoming(next, keep);
+    memory->addIncoming(next, release);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+// ==== Traced objects ====
+
+void GarbageCollector::traced(llvm::IRBuilderBase& at, llvm::Value* object, llvm::Function* tracer) {
+    llvm::Type* i64 = at.getInt64Ty();
+    llvm::Value* headerPointer = objectHeader(at, object);
+    llvm::Value* value = at.CreateLoad(i64, headerPointer);
+    llvm::Value* slot = at.CreateGEP(at.getInt8Ty(), object, at.CreateSub(at.CreateAnd(value, at.getInt64(0xffffffff)), at.getInt64(8)));
+    at.CreateStore(tracer, at.CreatePointerCast(slot, pointerTo(tracer->getType())));
+    // visited at the collection before, so not at the next one
+    llvm::Value* flags = at.CreateOr(at.getInt64(Traced << FlagsShift), load(at, "epoch", i64));
+    at.CreateStore(at.CreateOr(value, flags), headerPointer);
+}
+
+llvm::Value* GarbageCollector::pushFrame(llvm::IRBuilderBase& at, unsigned count) {
+    llvm::BasicBlock& entry = at.GetInsertBlock()->getParent()->getEntryBlock();
+    llvm::ArrayType* frameType = llvm::ArrayType::get(bytePointer(), count + 2);
+    llvm::Value* frame = llvm::IRBuilder<>(&entry, entry.begin()).CreateAlloca(frameType, nullptr, "gc.frame");
+
+    llvm::Value* top = frames();
+    at.CreateStore(at.CreateLoad(bytePointer(), top), at.CreateConstInBoundsGEP2_32(frameType, frame, 0, 0));
+    at.CreateStore(at.CreateIntToPtr(at.getInt64(count), bytePointer()), at.CreateConstInBoundsGEP2_32(frameType, frame, 0, 1));
+    for (unsigned i = 0; i < count; i++) at.CreateStore(llvm::Constant::getNullValue(bytePointer()), at.CreateConstInBoundsGEP2_32(frameType, frame, 0, i + 2));
+    at.CreateStore(at.CreatePointerCast(frame, bytePointer()), top);
+    return frame;
+}
+
+void GarbageCollector::setRoot(llvm::IRBuilderBase& at, llvm::Value* frame, unsigned index, llvm::Value* object) {
+    llvm::Value* slots = at.CreatePointerCast(frame, pointerTo(bytePointer()));
+    at.CreateStore(at.CreatePointerCast(object, bytePointer()), at.CreateConstInBoundsGEP1_64(bytePointer(), slots, index + 2));
+}
+
+void GarbageCollector::popFrame(llvm::IRBuilderBase& at, llvm::Value* frame) {
+    llvm::Value* previous = at.CreateLoad(bytePointer(), at.CreatePointerCast(frame, pointerTo(bytePointer())));
+    at.CreateStore(previous, frames());
+}
+
+// ==== Roots ====
+
+void GarbageCollector::writeBarrier(llvm::IRBuilder<>& at, llvm::GlobalVariable* global) {
+    // the card is a byte next to the global, defined by every module that stores into it
+    std::string name = global->getName().str() + ".card";
+    llvm::GlobalVariable* card = module.getNamedGlobal(name);
+    if (!card) card = new llvm::GlobalVariable(module, at.getInt8Ty(), false, llvm::GlobalValue::LinkOnceODRLinkage, at.getInt8(0), name);
+
+    llvm::Function* function = at.GetInsertBlock()->getParent();
+    llvm::BasicBlock* mark = llvm::BasicBlock::Create(context, "barrier", function);
+    llvm::BasicBlock* end = llvm::BasicBlock::Create(context, "barrier.end", function);
+    at.CreateCondBr(at.CreateICmpEQ(at.CreateLoad(at.getInt8Ty(), card), at.getInt8(0)), mark, end, llvm::MDBuilder(context).createBranchWeights(1, 1000));
+
+    at.SetInsertPoint(mark);
+    at.CreateStore(at.getInt8(1), card);
+    llvm::Value* slot = at.CreatePointerCast(global, pointerTo(bytePointer()));
+    if (global->getValueType()->isStructTy()) slot = at.CreateIntToPtr(at.CreateOr(at.CreatePtrToInt(slot, at.getInt64Ty()), at.getInt64(1)), slot->getType());
+    at.CreateCall(rememberFunction(), {slot});
+    at.CreateBr(end);
+    at.SetInsertPoint(end);
+}
+
+llvm::Function* GarbageCollector::rememberFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.remember")) return existing;
+
+    llvm::Type* slot = pointerTo(bytePointer());
+    llvm::Function* function = create("neoluma.gc.remember", llvm::Type::getVoidTy(context), {slot});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* resize = llvm::BasicBlock::Create(context, "resize", function);
+    llvm::BasicBlock* resized = llvm::BasicBlock::Create(context, "resized", function);
+    llvm::BasicBlock* append = llvm::BasicBlock::Create(context, "append", function);
+    llvm::BasicBlock* outOfMemory = llvm::BasicBlock::Create(context, "oom", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* i64 = body.getInt64Ty();
+    llvm::Type* table = pointerTo(slot);
+
+    llvm::Value* count = load(body, "rootCount", i64);
+    llvm::Value* capacity = load(body, "rootCapacity", i64);
+    body.CreateCondBr(body.CreateICmpEQ(count, capacity), resize, append);
+
+    body.SetInsertPoint(resize);
+    llvm::Value* doubled = body.CreateSelect(body.CreateICmpEQ(capacity, body.getInt64(0)), body.getInt64(16), body.CreateShl(capacity, 1));
+    llvm::Value* bytes = body.CreateZExtOrTrunc(body.CreateMul(doubled, body.getInt64(module.getDataLayout().getPointerSize())), sizeType());
+    llvm::Value* roots = body.CreateCall(libc("realloc", bytePointer(), {bytePointer(), sizeType()}), {body.CreatePointerCast(load(body, "roots", table), bytePointer()), bytes});
+    body.CreateCondBr(body.CreateIsNull(roots), outOfMemory, resized);
+
+    body.SetInsertPoint(resized);
+    store(body, "roots", body.CreatePointerCast(roots, table));
+    store(body, "rootCapacity", doubled);
+    body.CreateBr(append);
+
+    body.SetInsertPoint(append);
+    body.CreateStore(function->getArg(0), body.CreateGEP(slot, load(body, "roots", table), count));
+    store(body, "rootCount", body.CreateAdd(count, body.getInt64(1)));
+    body.CreateRetVoid();
+
+    body.SetInsertPoint(outOfMemory);
+    body.CreateCall(outOfMemoryFunction());
+    body.CreateUnreachable();
+    return function;
+}
+
+// ==== Coroutine frames ====
+
+llvm::Function* GarbageCollector::attach() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.attach")) return existing;
+
+    llvm::Function* function = create("neoluma.gc.attach", llvm::Type::getVoidTy(context), {bytePointer()});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* link = llvm::BasicBlock::Create(context, "link", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* slots = pointerTo(bytePointer());
+
+    llvm::Value* frame = body.CreatePointerCast(function->getArg(0), slots);
+    llvm::Value* first = load(body, "tasks", bytePointer());
+    body.CreateStore(llvm::Constant::getNullValue(bytePointer()), body.CreateConstGEP1_64(bytePointer(), frame, -1));
+    body.CreateStore(first, frame);
+    store(body, "tasks", function->getArg(0));
+    body.CreateCondBr(body.CreateIsNull(first), done, link);
+
+    body.SetInsertPoint(link);
+    body.CreateStore(function->getArg(0), body.CreateConstGEP1_64(bytePointer(), body.CreatePointerCast(first, slots), -1));
+    body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* GarbageCollector::detach() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.detach")) return existing;
+
+    llvm::Function* function = create("neoluma.gc.detach", llvm::Type::getVoidTy(context), {bytePointer()});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* middle = llvm::BasicBlock::Create(context, "middle", function);
+    llvm::BasicBlock* first = llvm::BasicBlock::Create(context, "first", function);
+    llvm::BasicBlock* unlinked = llvm::BasicBlock::Create(context, "unlinked", function);
+    llvm::BasicBlock* back = llvm::BasicBlock::Create(context, "back", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* slots = pointerTo(bytePointer());
+
+    llvm::Value* frame = body.CreatePointerCast(function->getArg(0), slots);
+    llvm::Value* previous = body.CreateLoad(bytePointer(), body.CreateConstGEP1_64(bytePointer(), frame, -1));
+    llvm::Value* next = body.CreateLoad(bytePointer(), frame);
+    body.CreateCondBr(body.CreateIsNull(previous), first, middle);
+
+    body.SetInsertPoint(middle);
+    body.CreateStore(next, body.CreatePointerCast(previous, slots));
+    body.CreateBr(unlinked);
+
+    body.SetInsertPoint(first);
+    store(body, "tasks", next);
+    body.CreateBr(unlinked);
+
+    body.SetInsertPoint(unlinked);
+    body.CreateCondBr(body.CreateIsNull(next), done, back);
+
+    body.SetInsertPoint(back);
+    body.CreateStore(previous, body.CreateConstGEP1_64(bytePointer(), body.CreatePointerCast(next, slots), -1));
+    body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+// ==== Reporting ====
+
+llvm::Function* GarbageCollector::clockFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.clock")) return existing;
+
+    // timespec_get is in every C library since C11, `long` is 32 bits on Windows
+    llvm::Function* function = create("neoluma.gc.clock", llvm::Type::getInt64Ty(context), {});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Type* field = llvm::Triple(module.getTargetTriple()).isOSWindows() ? body.getInt32Ty() : sizeType();
+    llvm::Type* seconds = llvm::Triple(module.getTargetTriple()).isOSWindows() ? body.getInt64Ty() : sizeType();
+    llvm::StructType* timespec = llvm::StructType::get(context, {seconds, field});
+    llvm::Value* time = body.CreateAlloca(timespec);
+    body.CreateCall(libc("timespec_get", body.getInt32Ty(), {bytePointer(), body.getInt32Ty()}), {body.CreatePointerCast(time, bytePointer()), body.getInt32(1)});
+    llvm::Value* secondsValue = body.CreateSExt(body.CreateLoad(seconds, body.CreateStructGEP(timespec, time, 0)), body.getInt64Ty());
+    llvm::Value* nanoseconds = body.CreateSExt(body.CreateLoad(field, body.CreateStructGEP(timespec, time, 1)), body.getInt64Ty());
+    body.CreateRet(body.CreateAdd(body.CreateMul(secondsValue, body.getInt64(1000000000)), nanoseconds));
+    return function;
+}
+
+llvm::Function* GarbageCollector::outOfMemoryFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.outOfMemory")) return existing;
+
+    llvm::Function* function = create("neoluma.gc.outOfMemory", llvm::Type::getVoidTy(context), {});
+    function->addFnAttr(llvm::Attribute::NoReturn);
+    function->addFnAttr(llvm::Attribute::Cold);
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    std::string message = settings.heapSize ? std::format("out of memory: the heap is limited to {} MiB\n", settings.heapSize >> 20) : "out of memory\n";
+    body.CreateCall(libc("fputs", body.getInt32Ty(), {bytePointer(), bytePointer()}), {globalString(body, message, "neoluma.gc.message", &module), errorStream(body)});
+    body.CreateCall(libc("abort", body.getVoidTy(), {}));
+    body.CreateUnreachable();
+    return function;
+}
+
+llvm::Function* GarbageCollector::report() {
+    if (llvm::Function* existing = module.getFunction("neoluma.gc.report")) return existing;
+
+    llvm::Function* function = create("neoluma.gc.report", llvm::Type::getVoidTy(context), {bytePointer()});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Type* i64 = body.getInt64Ty();
+    llvm::FunctionCallee fprintf = libc("fprintf", body.getInt32Ty(), {bytePointer(), bytePointer()}, true);
+    llvm::Value* stream = function->getArg(0);
+    body.CreateCall(libc("fflush", body.getInt32Ty(), {bytePointer()}), {llvm::Constant::getNullValue(bytePointer())}); // after what the program printed
+    auto milliseconds = [&](const std::string& name) { return body.CreateFDiv(body.CreateUIToFP(load(body, name, i64), body.getDoubleTy()), llvm::ConstantFP::get(body.getDoubleTy(), 1e6)); };
+    auto mebibytes = [&](llvm::Value* bytes) { return body.CreateFDiv(body.CreateUIToFP(bytes, body.getDoubleTy()), llvm::ConstantFP::get(body.getDoubleTy(), 1024.0 * 1024.0)); };
+
+    for (std::string kind : {"minor", "full"}) {
+        llvm::Value* format = globalString(body, std::format("GC: %llu {} collections, %.3f ms in total, %.3f ms the longest\n", kind), "neoluma.gc.format", &module);
+        body.CreateCall(fprintf, {stream, format, load(body, kind + "Count", i64), milliseconds(kind + "Time"), milliseconds(kind + "Longest")});
+    }
+    llvm::Value* used = body.CreateSub(body.CreatePtrToInt(load(body, "cursor", bytePointer()), i64), body.CreatePtrToInt(load(body, "start", bytePointer()), i64));
+    llvm::Value* allocated = body.CreateAdd(load(body, "allocated", i64), used);
+    llvm::Value* format = globalString(body, "GC: %.1f MiB allocated, %.1f MiB of heap, %.1f MiB of nursery\n", "neoluma.gc.format", &module);
+    body.CreateCall(fprintf, {stream, format, mebibytes(allocated), mebibytes(load(body, "heap", i64)), mebibytes(load(body, "nursery", i64))});
+    body.CreateRetVoid();
+    return function;
+}
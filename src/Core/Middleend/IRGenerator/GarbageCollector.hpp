@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// LLVM Primitives
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+
+/* Garbage Collector is the runtime of the default memory mode. Like the other runtime pieces it's emitted into the LLVM
+ * modules that use it, every piece with linkonce_odr linkage, so the program ends up with one copy of it and of its state.
+ *
+ * The heap is made of 32 KiB blocks of 128-byte lines. New objects are allocated by bumping a cursor through a hole, a
+ * run of free lines, and only the end of a hole takes a call into the runtime. Objects past 8 KiB get a malloc of their own.
+ * Every object has an 8-byte header in front of it: its size, flags and the index of its block. String literals carry
+ * one too, marked static, so any `str` can be told apart without looking the address up.
+ *
+ * Generations are sticky mark bits over the lines (mark-region): lines marked at a collection stay marked until the
+ * next full one, so they're the old generation, and everything allocated in between is the nursery.
+ * - A minor collection runs when the nursery has taken its budget of lines. It marks what the roots reach, and the
+ *   lines the nursery took and nothing marked are free again. Survivors are old from then on.
+ * - A full collection runs when the heap would grow past twice what was live after the last one. It clears every mark first.
+ * Objects never move: a string the IR Generator keeps in a register is still valid after a collection.
+ *
+ * Roots are precise. Every function holding strings, collections or numbers pushes a frame of their slots on a shadow
+ * stack, and one stored into a global marks that global's card, which hands its slot to the collector the first time.
+ * A coroutine outlives the calls that resume it, so its frame is linked into a list of tasks from its start until it's
+ * destroyed. A number is two words, {coefficient, exponent and length}, and only holds an object, its limbs, when its
+ * length isn't 0: a frame has its numbers after the other roots, and a global's slot is handed over with its lowest
+ * bit set.
+ *
+ * Strings and limbs hold no references. A collection is traced: its header is flagged, and its last 8 bytes point to a function
+ * of its runtime that marks its buffers and what's in them. Nothing puts a barrier in front of a store into a
+ * collection, so every collection reached is traced again at a minor collection too, old or young. A flag that flips
+ * with every collection keeps one reached twice from being traced twice.
+ * The nursery budget follows the pause target: it halves after a minor collection that took longer, and doubles
+ * after one well under it.
+ *
+ * The collector belongs to one thread: nothing locks the heap, the shadow stack or the remembered globals, so the
+ * Executor runs every task on the thread of `main` when there's a collector.
+ */
+struct GarbageCollector {
+    struct Settings {
+        uint64_t heapSize = 0; // bytes the heap may take, 0 for no limit
+        uint64_t pauseTarget = 1000000; // nanoseconds a minor collection should stay under
+        bool stats = false; // the program reports its collections when `main` returns
+    };
+
+    // `errorStream` emits the FILE* of stderr where a builder is, out of memory is reported there
+    GarbageCollector(llvm::Module& module, const Settings& settings, std::function<llvm::Value*(llvm::IRBuilderBase&)> errorStream)
+        : module(module), context(module.getContext()), settings(settings), errorStream(std::move(errorStream)) {}
+
+    const Settings& options() const { return settings; }
+
+    llvm::Function* allocate(); // i8* (i64 size): a new object, its header already written. Inlined, the call is only the slow path.
+    llvm::Function* report(); // void (i8* stream): numbers of collections, their pauses and the heap, printed to `stream`
+    // i8*: the frame on top of the shadow stack, [previous frame, root count, roots..., numbers...]. The low 32 bits of
+    // the count are the roots, the high ones the numbers, two words each.
+    llvm::GlobalVariable* frames();
+    // The frame of a coroutine is [previous, next, root count, roots...], linked in both directions into a list of its
+    // own. The links point at `next`, so from there a frame looks like one of the shadow stack.
+    llvm::Function* attach(); // void (i8* next): the frame goes first in the list
+    llvm::Function* detach(); // void (i8* next)
+    llvm::Constant* staticHeader(); // i64: header of an object that isn't on the heap
+    llvm::Function* mark(); // void (i8* object): what a tracer calls for everything its object holds, null included
+
+    // Flags a new object as traced by `tracer` (void (i8* object)), which goes into its last 8 bytes. Called before
+    // anything else is allocated: the object's fields have to be valid for `tracer` by then.
+    void traced(llvm::IRBuilderBase& at, llvm::Value* object, llvm::Function* tracer);
+    // A runtime function holding objects only in registers while it allocates keeps them in a frame of its own:
+    // `count` roots, null till they're set. It's popped before the function returns.
+    llvm::Value* pushFrame(llvm::IRBuilderBase& at, unsigned count);
+    void setRoot(llvm::IRBuilderBase& at, llvm::Value* frame, unsigned index, llvm::Value* object);
+    void popFrame(llvm::IRBuilderBase& at, llvm::Value* frame);
+
+    // Store barrier for a global holding a string: the first store hands the global to the collector
+    void writeBarrier(llvm::IRBuilder<>& at, llvm::GlobalVariable* global); // of a string, a collection or a number
+
+private:
+    llvm::Module& module;
+    llvm::LLVMContext& context;
+    Settings settings;
+    std::function<llvm::Value*(llvm::IRBuilderBase&)> errorStream;
+
+    llvm::Type* bytePointer();
+    llvm::Type* sizeType(); // of the C library
+    llvm::GlobalVariable* state(const std::string& name, llvm::Type* type);
+    llvm::Value* load(llvm::IRBuilderBase& at, const std::string& name, llvm::Type* type);
+    void store(llvm::IRBuilderBase& at, const std::string& name, llvm::Value* value);
+    void add(llvm::IRBuilderBase& at, const std::string& name, llvm::Value* value); // to an i64 counter
+    llvm::Function* create(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters);
+    llvm::FunctionCallee libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters, bool variadic = false);
+    llvm::Value* objectHeader(llvm::IRBuilderBase& at, llvm::Value* object); // i64* in front of `object`
+    llvm::Value* limbs(llvm::IRBuilderBase& at, llvm::Value* slot); // i8*: of the number in `slot`, null if it has none
+
+    llvm::Function* slowPathFunction(); // i8* (i64 size): a new hole, a collection or a new block first
+    llvm::Function* holeFunction(); // i1 (i64 bytes): moves the cursor to the next hole that fits
+    llvm::Function* growFunction(); // void (): a new block, all of it the hole
+    llvm::Function* largeFunction(); // i8* (i64 size)
+    llvm::Function* collectFunction(); // void (i1 full)
+    llvm::Function* markFunction(); // void (i8* object), a traced one's tracer first
+    llvm::Function* sweepFunction(); // void (i8** from, i8** to): large objects, survivors go to `to`
+    llvm::Function* rememberFunction(); // void (i8** slot)
+    llvm::Function* clockFunction(); // i64 (): nanoseconds
+    llvm::Function* outOfMemoryFunction(); // void (), doesn't return
+};
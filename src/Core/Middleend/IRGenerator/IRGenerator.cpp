@@ -1,597 +1,2575 @@
 #include "IRGenerator.hpp"
-/* Deprecated structure.
-#include "Core/Compiler.hpp"
+
+#include <algorithm>
+#include <format>
 
 // LLVM Primitives
-#include "llvm/IR/Verifier.h"
-#include "llvm/Support/raw_ostream.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
-#include "llvm/IR/Instructions.h"
-#include "llvm/IR/TypedPointerType.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+#if LLVM_VERSION_MAJOR >= 17
+#include "llvm/TargetParser/Triple.h"
+#else
+#include "llvm/ADT/Triple.h"
+#endif
+
+#include "Core/Extras/SymbolIndex/SymbolIndex.hpp"
+#include "Core/Frontend/SemanticAnalysis/Types.hpp"
+#include "Pointers.hpp"
+
+// the triple and layout of Codegen, so the optimizer knows the target
+static void describeTarget(llvm::Module& module, const std::string& triple, const std::string& layout) {
+#if LLVM_VERSION_MAJOR >= 21
+    if (!triple.empty()) module.setTargetTriple(llvm::Triple(triple));
+#else
+    if (!triple.empty()) module.setTargetTriple(triple);
+#endif
+    if (!layout.empty()) module.setDataLayout(layout);
+}
 
-void IRGenerator::generate(const ProgramUnit& programUnit, const std::vector<ModuleInfo>& infos) {
-    program = makeMemoryPtr<llvm::Module>("program", context);
-    builder = makeMemoryPtr<llvm::IRBuilder<>>(context);
+static bool isUnsigned(const Type* type) {
+    if (!type || type->kind != Type::Kind::Primitive) return false;
+    switch (type->primitive) {
+        case ResolvedType::UInt8: case ResolvedType::UInt16: case ResolvedType::UInt: case ResolvedType::UInt64: case ResolvedType::UInt128:
+            return true;
+        default: return false;
+    }
+}
 
-    for (ModuleId id : programUnit.order) generateModule(infos[id].module);
+static bool isReal(const Type* type) { return type && type->isFloat(); }
 
-    if (llvm::verifyModule(*program, &llvm::errs())) {
-        // later make a handler
-        return;
-    };
-    program->print(llvm::outs(), nullptr);
+// every pointer is one `ptr` type from LLVM 17 on, only the Frontend's types tell strings apart
+static bool isString(const Type* type) { return type && type->isPrimitive(ResolvedType::Str); }
+
+static bool isComparison(const std::string& op) { return op == "==" || op == "!=" || op == "<" || op == ">" || op == "<=" || op == ">="; }
+
+static bool isCollection(const Type* type) {
+    return type && (type->kind == Type::Kind::Array || type->kind == Type::Kind::Set || type->kind == Type::Kind::Dict);
+}
+
+// `length` of `xs.length` and `push` of `xs.push(x)`
+static std::string memberName(const MemberAccessNode* node) {
+    ASTNode* member = node->val.get();
+    if (member && member->type == ASTNodeType::CallExpression) member = static_cast<CallExpressionNode*>(member)->callee.get();
+    return member && member->type == ASTNodeType::Variable ? static_cast<VariableNode*>(member)->varName : "";
+}
+
+// ==== Program ====
+
+void IRGenerator::declareProgram(const std::vector<ModuleNode*>& modules) {
+    globals.clear();
+    functions.clear();
+    namespacePrefixes.clear();
+    for (ModuleNode* node : modules)
+        if (node) declareTopLevel(node->body, "");
+    escapes.analyzeProgram(modules);
 }
 
-void IRGenerator::generateModule(ModuleNode* module) {
-    // Declaration pass
-    for (const auto& statement : module->body) {
+void IRGenerator::declareTopLevel(std::vector<MemoryPtr<ASTNode>>& body, const std::string& prefix) {
+    for (auto& statement : body) {
         switch (statement->type) {
             case ASTNodeType::Function:
-            case ASTNodeType::Decorator:
-                generateFunctionSignature(static_cast<FunctionNode*>(statement.get())); break;
-            case ASTNodeType::Class: generateClassType(static_cast<ClassNode*>(statement.get())); break;
-            case ASTNodeType::Enum: generateEnum(static_cast<EnumNode*>(statement.get())); break;
+                namespacePrefixes[statement.get()] = prefix;
+                functions[static_cast<FunctionNode*>(statement.get())->name].push_back(static_cast<FunctionNode*>(statement.get()));
+                break;
+            case ASTNodeType::Declaration: {
+                auto* declaration = static_cast<DeclarationNode*>(statement.get());
+                namespacePrefixes[declaration] = prefix;
+                globals[declaration->variable->varName].push_back(declaration);
+                break;
+            }
+            case ASTNodeType::Namespace: {
+                auto* node = static_cast<NamespaceNode*>(statement.get());
+                declareTopLevel(node->body, prefix + namespacePath(node->name.get()) + ".");
+                break;
+            }
             default: break;
         }
     }
+}
+
+MemoryPtr<llvm::Module> IRGenerator::generate(const std::string& name, const std::vector<ModuleNode*>& modules, FunctionNode* entry) {
+    module = makeMemoryPtr<llvm::Module>(name, context);
+    describeTarget(*module, targetTriple, dataLayout);
+    reported.clear();
+    roots.clear();
+    if (garbageCollector) collector = makeMemoryPtr<GarbageCollector>(*module, *garbageCollector, [this](llvm::IRBuilderBase& at) { return standardStream(2, at); });
+    else if (referenceCounting) counter = makeMemoryPtr<ReferenceCounter>(*module, *referenceCounting);
+    regionAllocator = makeMemoryPtr<RegionAllocator>(*module, collector ? collector->staticHeader() : counter ? counter->staticHeader() : nullptr);
+    collections = makeMemoryPtr<Collections>(*module, collector.get(), counter.get(), [this](llvm::IRBuilderBase& at) { return standardStream(2, at); });
+    decimals = makeMemoryPtr<Decimals>(*module, collector.get(), counter.get(), [this](llvm::IRBuilderBase& at) { return standardStream(2, at); });
+    llvm::Triple triple(targetTriple);
+    if (triple.isOSLinux()) executor = makeMemoryPtr<Executor>(*module, !collector, [this](llvm::IRBuilderBase& at) { return standardStream(2, at); });
+
+    // initializers that aren't constants run before main, in the order of the modules
+    initializer = llvm::Function::Create(llvm::FunctionType::get(builder.getVoidTy(), false), llvm::GlobalValue::InternalLinkage, "neoluma.init", module.get());
+    initializerBlock = llvm::BasicBlock::Create(context, "entry", initializer);
+
+    for (ModuleNode* node : modules) {
+        if (!node) continue;
+        generateTopLevel(node->body);
+        if (entry && entry->filePath == node->filePath) generateEntry(entry);
+    }
+
+    if (&initializer->getEntryBlock() == initializerBlock && initializerBlock->empty()) initializer->eraseFromParent();
+    else {
+        builder.SetInsertPoint(initializerBlock);
+        builder.CreateRetVoid();
+        generateFrame(initializer);
+        llvm::appendToGlobalCtors(*module, initializer, 65535);
+    }
+    initializer = nullptr;
+    initializerBlock = nullptr;
+    collector.reset();
+    regionAllocator.reset();
+    collections.reset();
+    decimals.reset();
+    executor.reset();
+    counter.reset();
+    return std::move(module);
+}
+
+MemoryPtr<llvm::Module> IRGenerator::generateBridge(FunctionNode* function) {
+    module = makeMemoryPtr<llvm::Module>(bridgeName(function), context);
+    describeTarget(*module, targetTriple, dataLayout);
+    reported.clear();
+    collections = makeMemoryPtr<Collections>(*module, nullptr, nullptr, [this](llvm::IRBuilderBase& at) { return standardStream(2, at); });
+
+    llvm::Function* callee = declareFunction(function);
+    collections.reset();
+    if (!callee) return nullptr;
+    // a number doesn't fit a slot, the interpreter never calls with one
+    auto fits = [](llvm::Type* type) { return !type->isStructTy(); };
+    if (!fits(callee->getReturnType()) || !std::all_of(callee->arg_begin(), callee->arg_end(), [&](llvm::Argument& parameter) { return fits(parameter.getType()); })) return nullptr;
+
+    // a slot holds an integer extended to 64 bits, a float as a double, or a pointer
+    llvm::Type* slotType = builder.getInt64Ty();
+    llvm::Type* slotsType = pointerTo(slotType);
+    auto slot = [&](llvm::Value* slots, uint64_t index, llvm::Type* held) {
+        return builder.CreatePointerCast(builder.CreateConstInBoundsGEP1_64(slotType, slots, index), pointerTo(held));
+    };
+    auto heldType = [&](llvm::Type* type) { return type->isIntegerTy() ? slotType : type->isFloatingPointTy() ? builder.getDoubleTy() : type; };
+
+    llvm::Function* bridge = llvm::Function::Create(llvm::FunctionType::get(builder.getVoidTy(), {slotsType, slotsType}, false),
+        llvm::GlobalValue::ExternalLinkage, bridgeName(function), module.get());
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", bridge));
+
+    std::vector<llvm::Value*> arguments;
+    for (llvm::Argument& parameter : callee->args()) {
+        llvm::Type* type = parameter.getType();
+        llvm::Value* value = builder.CreateLoad(heldType(type), slot(bridge->getArg(0), parameter.getArgNo(), heldType(type)));
+        if (type->isIntegerTy()) value = builder.CreateTrunc(value, type);
+        else if (type->isFloatTy()) value = builder.CreateFPTrunc(value, type);
+        arguments.push_back(value);
+    }
+
+    llvm::Value* result = builder.CreateCall(callee, arguments);
+    llvm::Type* type = result->getType();
+    if (!type->isVoidTy()) {
+        if (type->isIntegerTy()) result = builder.CreateIntCast(result, slotType, !type->isIntegerTy(1) && !isUnsigned(function->inferredType->returnType()));
+        else if (type->isFloatTy()) result = builder.CreateFPExt(result, builder.getDoubleTy());
+        builder.CreateStore(result, slot(bridge->getArg(1), 0, heldType(type)));
+    }
+    builder.CreateRetVoid();
+    return std::move(module);
+}
 
-    // Generation pass
-    for (const auto& statement : module->body) {
+void IRGenerator::generateTopLevel(std::vector<MemoryPtr<ASTNode>>& body) {
+    for (auto& statement : body) {
         switch (statement->type) {
-            case ASTNodeType::Function:
-            case ASTNodeType::Decorator:
-                generateFunctionBody(static_cast<FunctionNode*>(statement.get())); break;
-            case ASTNodeType::Class: generateClassMethods(static_cast<ClassNode*>(statement.get())); break;
-            default: break;
+            case ASTNodeType::Function: generateFunction(static_cast<FunctionNode*>(statement.get())); break;
+            case ASTNodeType::Declaration: generateGlobal(static_cast<DeclarationNode*>(statement.get())); break;
+            case ASTNodeType::Namespace: generateTopLevel(static_cast<NamespaceNode*>(statement.get())->body); break;
+            case ASTNodeType::Class: unsupported(statement.get(), "classes"); break;
+            case ASTNodeType::Enum: unsupported(statement.get(), "enums"); break;
+            // nothing to generate: resolved by the Frontend or only a shape for type checks
+            case ASTNodeType::Import: case ASTNodeType::Preprocessor: case ASTNodeType::Interface: case ASTNodeType::Decorator: break;
+            default: unsupported(statement.get(), "top-level statements"); break;
         }
     }
 }
 
-llvm::Value* IRGenerator::generateStatement(ASTNode* node) {
-    switch(node->type) {
-        case ASTNodeType::Declaration: return generateDeclaration(static_cast<DeclarationNode*>(node));
-        case ASTNodeType::Assignment: return generateAssignment(static_cast<AssignmentNode*>(node));
-        case ASTNodeType::Function:
-            generateFunctionSignature(static_cast<FunctionNode*>(node));
-            if (!static_cast<FunctionNode*>(node)->isIntrinsic) generateFunctionBody(static_cast<FunctionNode*>(node));
-            return nullptr;
-        case ASTNodeType::ReturnStatement: return generateReturn(static_cast<ReturnStatementNode*>(node));
-        case ASTNodeType::IfStatement: return generateIf(static_cast<IfNode*>(node));
-        case ASTNodeType::WhileLoop: return generateWhile(static_cast<WhileLoopNode*>(node));
-        case ASTNodeType::ForLoop: return generateFor(static_cast<ForLoopNode*>(node));
-        case ASTNodeType::CallExpression: return generateCall(static_cast<CallExpressionNode*>(node));
-        case ASTNodeType::BreakStatement: return generateBreak();
-        case ASTNodeType::ContinueStatement: return generateContinue();
-        case ASTNodeType::ThrowStatement: return generateThrow(static_cast<ThrowStatementNode*>(node));
-        case ASTNodeType::Switch: return generateSwitch(static_cast<SwitchNode*>(node));
-        case ASTNodeType::TryCatch: return generateTryCatch(static_cast<TryCatchNode*>(node));
-        case ASTNodeType::Lambda: return generateLambda(static_cast<LambdaNode*>(node));
-        default: return generateExpression(node);
+void IRGenerator::generateFunction(FunctionNode* function) {
+    if (function->isIntrinsic || !function->body) return;
+    for (const auto& decorator : function->decorators) {
+        std::string name = match(decorator->callee.get(), ASTNodeType::Variable) ? static_cast<VariableNode*>(decorator->callee.get())->varName : "";
+        if (name != "entry" && name != "comptime" && name != "unsafe") unsupported(decorator.get(), "user-defined decorators");
     }
+
+    llvm::Function* llvmFunction = declareFunction(function);
+    if (!llvmFunction || !llvmFunction->empty()) return;
+
+    // an async function returns its task, what it returns goes into the promise
+    const Type* returnType = function->inferredType->returnType();
+    llvm::Type* result = llvmFunction->getReturnType();
+    if (function->isAsync) {
+        returnType = returnType->element();
+        result = returnType->isDynamic() && !returnsValue(function->body.get()) ? builder.getVoidTy() : llvmType(returnType);
+        if (!executor) {
+            // the Executor waits with epoll, there's no poll or kqueue fallback
+            errorManager->addError(ErrorType::Codegen, CodegenErrors::TargetNotSupported,
+                ErrorSpan{function->filePath, function->name, function->line, function->column},
+                "ErrorManager.Codegen.TargetNotSupported.async.message", {function->name, targetTriple},
+                "ErrorManager.Codegen.TargetNotSupported.async.hint", {});
+            return;
+        }
+        if (!result) {
+            unsupported(function, std::format("async functions returning '{}'", returnType->toString()));
+            return;
+        }
+    }
+
+    currentFunction = llvmFunction;
+    currentReturnType = result->isVoidTy() ? nullptr : returnType;
+    breakBlock = continueBlock = nullptr;
+    currentLoop = nullptr;
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", llvmFunction));
+    if (function->isAsync) coroutine = executor->begin(builder, llvmFunction, result);
+
+    // parameters live in stack slots like any other local, mem2reg turns them back into registers
+    scopes.assign(1, {});
+    for (size_t i = 0; i < function->parameters.size(); i++) {
+        llvm::Argument* argument = llvmFunction->getArg(i);
+        const Type* type = function->inferredType->param(i);
+        llvm::AllocaInst* slot = createSlot(argument->getType(), function->parameters[i]->parameterName, type);
+        builder.CreateStore(argument, slot);
+        // one that escapes comes with the caller's reference, one that's assigned to takes its own
+        bool escaping = function->isAsync || escapes.parameterEscapes(function, i);
+        bool owned = isCounted(type) && (escaping || escapes.isAssigned(function->parameters[i].get()));
+        if (owned && !escaping) retainValue(argument, type);
+        scopes.back()[function->parameters[i]->parameterName] = Local{slot, type, owned};
+    }
+    // the call returns here, with the arguments in the frame of the coroutine and the task queued
+    if (coroutine) executor->start(builder, *coroutine);
+    beginRegion(function);
+
+    for (auto& statement : function->body->statements) {
+        if (isTerminated()) break;
+        generateStatement(statement.get());
+    }
+
+    // Flow Analysis made sure a function returning a value can't get here
+    if (!isTerminated()) {
+        if (!currentReturnType) {
+            releaseLocals(0);
+            releaseRegions();
+            if (coroutine) executor->finish(builder, *coroutine, nullptr);
+            else builder.CreateRetVoid();
+        }
+        else builder.CreateUnreachable();
+    }
+    generateFrame(llvmFunction, coroutine ? &*coroutine : nullptr);
+    // a coroutine's retains and releases are split over its resumes, it's left as it is
+    if (counter && !coroutine) counter->optimize(*llvmFunction);
+    coroutine.reset();
+    scopes.clear();
+    regions.clear();
+    declarationSlots.clear();
+    currentFunction = nullptr;
 }
 
-llvm::Value* IRGenerator::generateExpression(ASTNode* node) {
-    switch (node->type) {
-        case ASTNodeType::Literal: return generateLiteral(static_cast<LiteralNode*>(node));
-        case ASTNodeType::Variable: return generateVariable(static_cast<VariableNode*>(node));
-        case ASTNodeType::CallExpression: return generateCall(static_cast<CallExpressionNode*>(node));
-        case ASTNodeType::BinaryOperation: return generateBinaryOp(static_cast<BinaryOperationNode*>(node));
-        case ASTNodeType::UnaryOperation: return generateUnaryOp(static_cast<UnaryOperationNode*>(node));
-        case ASTNodeType::MemberAccess: return nullptr; // fixme: requires classes
-        case ASTNodeType::Array:
-        case ASTNodeType::Set:
-        case ASTNodeType::Dict:
-            return nullptr; //fixme: requires std
-        case ASTNodeType::Lambda: return generateLambda(static_cast<LambdaNode*>(node));
-        default: return nullptr;
+void IRGenerator::generateGlobal(DeclarationNode* declaration) {
+    llvm::GlobalVariable* global = declareGlobal(declaration);
+    if (!global || !global->isDeclaration()) return;
+
+    llvm::Type* type = global->getValueType();
+    global->setInitializer(llvm::Constant::getNullValue(type));
+    if (!declaration->value) return;
+
+    currentFunction = initializer;
+    currentReturnType = nullptr;
+    scopes.assign(1, {});
+    builder.SetInsertPoint(initializerBlock);
+
+    temporaries.emplace_back();
+    llvm::Value* value = convert(generateExpression(declaration->value.get()), valueType(declaration->value.get()), declaration->inferredType);
+    if (value && !llvm::isa<llvm::Constant>(value)) {
+        storeVariable(acquire(value, declaration->inferredType), global, declaration->inferredType);
+        releaseTemporaries(temporaries.size() - 1);
+    }
+    temporaries.pop_back();
+    initializerBlock = builder.GetInsertBlock();
+    scopes.clear();
+    currentFunction = nullptr;
+    if (!value) return;
+
+    bool isConst = false;
+    for (const auto& modifier : declaration->modifiers) if (modifier->modifier == ASTModifierType::Const) isConst = true;
+
+    // folded constants become data, everything else is computed at startup
+    if (auto* constant = llvm::dyn_cast<llvm::Constant>(value)) {
+        global->setInitializer(constant);
+        global->setConstant(isConst);
     }
 }
 
-llvm::Value* IRGenerator::generateLiteral(LiteralNode* node) {
-    if (node->value == "true") return llvm::ConstantInt::get(llvm::Type::getInt1Ty(context), 1);
-    if (node->value == "false") return llvm::ConstantInt::get(llvm::Type::getInt1Ty(context), 0);
-    if (node->value == "null") return llvm::ConstantPointerNull::get(llvm::PointerType::getUnqual(context));
+void IRGenerator::generateEntry(FunctionNode* entry) {
+    llvm::Function* function = declareFunction(entry);
+    if (!function || (entry->isAsync && !executor)) return;
+
+    llvm::Function* main = llvm::Function::Create(llvm::FunctionType::get(builder.getInt32Ty(), false), llvm::GlobalValue::ExternalLinkage, "main", module.get());
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", main));
+    llvm::Value* result = builder.CreateCall(function);
+    const Type* resultType = entry->inferredType->returnType();
+    if (entry->isAsync) {
+        // `main` blocks until the entry's task is done, and the whole program with it
+        builder.CreateCall(executor->blockOn(), {result});
+        resultType = resultType->element();
+        result = executor->result(builder, result, llvmType(resultType));
+    }
+    if (collector && collector->options().stats) builder.CreateCall(collector->report(), {standardStream(2)});
+    if (counter && counter->options().stats) builder.CreateCall(counter->report(), {standardStream(2)});
 
-    if (node->value.contains('.'))  // float
-        return llvm::ConstantFP::get(llvm::Type::getDoubleTy(context), stod(node->value));
+    // an integer result is the exit code
+    if (result && result->getType()->isIntegerTy() && !result->getType()->isIntegerTy(1))
+        builder.CreateRet(builder.CreateIntCast(result, builder.getInt32Ty(), !isUnsigned(resultType)));
+    else builder.CreateRet(builder.getInt32(0));
+}
 
-    try {
-        return llvm::ConstantInt::get(llvm::Type::getInt32Ty(context), stoi(node->value));
-    } catch (const std::exception&) {}
+void IRGenerator::generateFrame(llvm::Function* function, const Executor::Coroutine* coroutine) {
+    auto it = roots.find(function);
+    if (it == roots.end()) return;
+    std::vector<llvm::AllocaInst*> slots = std::move(it->second);
+    roots.erase(it);
+
+    // [previous frame, root count, roots..., numbers...]: the slots become the roots, null until they're stored to.
+    // A number takes two words, and the count word has how many there are in its high half.
+    // A coroutine's is [previous, next, root count, roots...], in its coroutine frame, and isn't on the shadow stack.
+    llvm::Type* numberType = Decimals::numberType(context);
+    size_t pointers = std::stable_partition(slots.begin(), slots.end(), [numberType](llvm::AllocaInst* slot) { return slot->getAllocatedType() != numberType; }) - slots.begin();
+    size_t numbers = slots.size() - pointers;
+    llvm::BasicBlock& entry = function->getEntryBlock();
+    unsigned header = coroutine ? 3 : 2;
+    llvm::ArrayType* frameType = llvm::ArrayType::get(stringType(), pointers + 2 * numbers + header);
+    llvm::AllocaInst* frame = llvm::IRBuilder<>(&entry, entry.begin()).CreateAlloca(frameType, nullptr, "frame");
+    llvm::BasicBlock::iterator start = entry.begin();
+    while (llvm::isa<llvm::AllocaInst>(*start)) ++start;
+
+    llvm::IRBuilder<> prologue(&entry, start);
+    if (coroutine) prologue.SetInsertPoint(coroutine->start, coroutine->start->begin());
+    prologue.CreateStore(prologue.CreateIntToPtr(prologue.getInt64(pointers | numbers << 32), stringType()), prologue.CreateConstInBoundsGEP2_32(frameType, frame, 0, header - 1));
+    for (size_t i = 0; i < slots.size(); i++) {
+        unsigned index = header + (i < pointers ? i : pointers + 2 * (i - pointers));
+        llvm::Value* root = prologue.CreatePointerCast(prologue.CreateConstInBoundsGEP2_32(frameType, frame, 0, index, slots[i]->getName()), slots[i]->getType());
+        prologue.CreateStore(llvm::Constant::getNullValue(slots[i]->getAllocatedType()), root);
+        slots[i]->replaceAllUsesWith(root); // a collection's is typed, a number's is two words
+        slots[i]->eraseFromParent();
+    }
 
-    return llvm::cast<llvm::Value>(builder->CreateGlobalString(node->value));
+    if (coroutine) {
+        llvm::Value* next = prologue.CreatePointerCast(prologue.CreateConstInBoundsGEP2_32(frameType, frame, 0, 1), stringType());
+        prologue.CreateCall(collector->attach(), {next});
+        llvm::IRBuilder<>(coroutine->cleanup, coroutine->cleanup->getFirstInsertionPt()).CreateCall(collector->detach(), {next});
+        return;
+    }
+    llvm::Value* top = collector->frames();
+    llvm::Value* previous = prologue.CreateConstInBoundsGEP2_32(frameType, frame, 0, 0);
+    prologue.CreateStore(prologue.CreateLoad(stringType(), top), previous);
+    prologue.CreateStore(prologue.CreatePointerCast(frame, stringType()), top);
+
+    for (llvm::BasicBlock& block : *function) {
+        if (!llvm::isa<llvm::ReturnInst>(block.getTerminator())) continue;
+        llvm::IRBuilder<> epilogue(block.getTerminator());
+        epilogue.CreateStore(epilogue.CreateLoad(stringType(), previous), top);
+    }
 }
 
-llvm::Value* IRGenerator::generateVariable(VariableNode* node) {
-    auto* alloc = findVariable(node->varName);
-    return builder->CreateLoad(variableTypes[node->varName], alloc, node->varName);
+// ==== Helpers ====
+
+void IRGenerator::unsupported(const ASTNode* node, const std::string& feature) {
+    if (!reported.insert(node).second) return;
+    errorManager->addError(ErrorType::Codegen, CodegenErrors::UnsupportedFeature,
+        ErrorSpan{node->filePath, node->value, node->line, node->column},
+        "ErrorManager.Codegen.UnsupportedFeature.message", {feature},
+        "ErrorManager.Codegen.UnsupportedFeature.hint", {feature});
 }
 
-llvm::Value* IRGenerator::generateDeclaration(DeclarationNode* node) {
-    // initializating type and value
-    llvm::Type* type = nullptr;
-    llvm::Value* value = nullptr;
+std::string IRGenerator::modulePath(const std::string& filePath, const std::filesystem::path& sourceFolder) {
+    std::filesystem::path path(filePath);
+    std::filesystem::path relative = sourceFolder.empty() ? path.filename() : path.lexically_relative(sourceFolder);
+    if (relative.empty() || *relative.begin() == "..") relative = path.filename();
+    relative.replace_extension();
 
-    if (!node->isTypeInference && node->rawType)
-        type = resolveType(node->rawType->varType->varName);
-    else if (node->value) {
-        value = generateExpression(node->value.get());
-        type = value->getType();
+    std::string name;
+    for (const auto& component : relative) {
+        if (!name.empty()) name += '.';
+        name += component.string();
     }
+    return name;
+}
 
-    if (type == nullptr) type = llvm::Type::getInt32Ty(context); // fallback
+std::string IRGenerator::symbolName(const FunctionNode* function) const {
+    auto prefix = namespacePrefixes.find(function);
+    std::string parameters;
+    if (function->inferredType && function->inferredType->kind == Type::Kind::Function) {
+        for (size_t i = 0; i < function->inferredType->paramCount(); i++) {
+            if (i) parameters += ',';
+            parameters += function->inferredType->param(i)->toString();
+        }
+    }
+    return std::format("{}.{}{}({})", modulePath(function->filePath, sourceFolder), prefix != namespacePrefixes.end() ? prefix->second : "", function->name, parameters);
+}
 
-    auto* alloc = builder->CreateAlloca(type, nullptr, node->variable->varName);
-    declareVariable(node->variable->varName, alloc, type);
+std::string IRGenerator::globalName(const DeclarationNode* declaration) const {
+    auto prefix = namespacePrefixes.find(declaration);
+    return std::format("{}.{}{}", modulePath(declaration->filePath, sourceFolder), prefix != namespacePrefixes.end() ? prefix->second : "", declaration->variable->varName);
+}
 
-    if (node->value && value == nullptr) value = generateExpression(node->value.get());
-    if (value) builder->CreateStore(value, alloc);
+llvm::Type* IRGenerator::llvmType(const Type* type) {
+    if (isCollection(type)) {
+        llvm::StructType* collection = collectionType(type);
+        return collection ? pointerTo(collection) : nullptr;
+    }
+    if (type && type->kind == Type::Kind::Iterator) return rangeType();
+    if (type && type->kind == Type::Kind::Task) return Executor::taskType(context); // the handle of its coroutine
+    if (type && type->kind == Type::Kind::Tuple) {
+        // only ever in registers, as the elements of an iterator
+        std::vector<llvm::Type*> fields;
+        for (const Type* component : type->components) {
+            llvm::Type* field = llvmType(component);
+            if (!field || field->isVoidTy()) return nullptr;
+            fields.push_back(field);
+        }
+        return llvm::StructType::get(context, fields);
+    }
+    if (!type || type->kind != Type::Kind::Primitive) return nullptr;
+    switch (type->primitive) {
+        case ResolvedType::Int8: case ResolvedType::UInt8: return builder.getInt8Ty();
+        case ResolvedType::Int16: case ResolvedType::UInt16: return builder.getInt16Ty();
+        case ResolvedType::Int: case ResolvedType::UInt: return builder.getInt32Ty();
+        case ResolvedType::Int64: case ResolvedType::UInt64: return builder.getInt64Ty();
+        case ResolvedType::Int128: case ResolvedType::UInt128: return builder.getInt128Ty();
+        case ResolvedType::Float: return builder.getFloatTy();
+        case ResolvedType::Float64: return builder.getDoubleTy();
+        case ResolvedType::Number: return Decimals::numberType(context);
+        case ResolvedType::Bool: return builder.getInt1Ty();
+        case ResolvedType::Str: return stringType();
+        case ResolvedType::Void: return builder.getVoidTy();
+        default: return nullptr;
+    }
+}
 
-    return alloc;
+llvm::StructType* IRGenerator::collectionType(const Type* type) {
+    // elements the Frontend couldn't give one type would have to be boxed, nothing here does that
+    std::vector<Collections::Element> elements;
+    for (const Type* component : type->components) {
+        std::optional<Collections::Element> element = collectionElement(component);
+        if (!element) return nullptr;
+        elements.push_back(*element);
+    }
+    if (type->kind == Type::Kind::Array) return collections->arrayType(type->toString(), elements[0]);
+    if (elements[0].type->isStructTy()) return nullptr; // 1.0 and 1.00 are one key, numbers aren't hashed by their value yet
+    return collections->tableType(type->toString(), elements[0], type->kind == Type::Kind::Dict ? std::optional(elements[1]) : std::nullopt);
 }
 
-llvm::Value* IRGenerator::generateAssignment(AssignmentNode* node) {
-    auto* alloc = findVariable(getRootVarName(node->variable.get()));
-    if (!alloc) return nullptr;
+std::optional<Collections::Element> IRGenerator::collectionElement(const Type* type) {
+    llvm::Type* element = llvmType(type);
+    if (!element || element->isVoidTy()) return std::nullopt;
+    return Collections::Element{element, type->isPrimitive(ResolvedType::Str), isCollection(type) ? collectionType(type) : nullptr, type->isPrimitive(ResolvedType::Number)};
+}
 
-    auto* value = generateExpression(node->value.get());
+llvm::StructType* IRGenerator::rangeType() {
+    if (llvm::StructType* existing = llvm::StructType::getTypeByName(context, "neoluma.range")) return existing;
+    return llvm::StructType::create(context, {builder.getInt64Ty(), builder.getInt64Ty(), builder.getInt64Ty()}, "neoluma.range");
+}
 
-    builder->CreateStore(value, alloc);
-    return value;
+llvm::Value* IRGenerator::rangeCount(llvm::Value* range) {
+    // the distance towards stop in steps, rounded up. A range going the other way or with a zero step is empty.
+    llvm::Value* start = builder.CreateExtractValue(range, 0);
+    llvm::Value* stop = builder.CreateExtractValue(range, 1);
+    llvm::Value* step = builder.CreateExtractValue(range, 2);
+    llvm::Value* upwards = builder.CreateICmpSGT(step, builder.getInt64(0));
+    llvm::Value* distance = builder.CreateSelect(upwards, builder.CreateSub(stop, start), builder.CreateSub(start, stop));
+    llvm::Value* magnitude = builder.CreateBinaryIntrinsic(llvm::Intrinsic::umax, builder.CreateBinaryIntrinsic(llvm::Intrinsic::abs, step, builder.getFalse()), builder.getInt64(1));
+    llvm::Value* count = builder.CreateAdd(builder.CreateUDiv(builder.CreateSub(distance, builder.getInt64(1)), magnitude), builder.getInt64(1));
+    llvm::Value* empty = builder.CreateOr(builder.CreateICmpSLE(distance, builder.getInt64(0)), builder.CreateICmpEQ(step, builder.getInt64(0)));
+    return builder.CreateSelect(empty, builder.getInt64(0), count);
 }
 
-llvm::Value* IRGenerator::generateBinaryOp(BinaryOperationNode* node) {
-    auto* left  = generateExpression(node->leftOperand.get());
-    auto* right = generateExpression(node->rightOperand.get());
-
-    if (node->value == on[Operators::Add]) return builder->CreateAdd(left, right);
-    if (node->value == on[Operators::Subtract]) return builder->CreateSub(left, right);
-    if (node->value == on[Operators::Multiply]) return builder->CreateMul(left, right);
-    if (node->value == on[Operators::Divide]) return builder->CreateSDiv(left, right);
-    if (node->value == on[Operators::Modulo]) return builder->CreateSRem(left, right);
-    if (node->value == on[Operators::Power]) return nullptr; //requires pow from libm
-    if (node->value == on[Operators::Equal]) return builder->CreateICmpEQ(left, right);
-    if (node->value == on[Operators::NotEqual]) return builder->CreateICmpNE(left, right);
-    if (node->value == on[Operators::LessThan]) return builder->CreateICmpSLT(left, right);
-    if (node->value == on[Operators::GreaterThan]) return builder->CreateICmpSGT(left, right);
-    if (node->value == on[Operators::LessThanOrEqual]) return builder->CreateICmpSLE(left, right);
-    if (node->value == on[Operators::GreaterThanOrEqual]) return builder->CreateICmpSGE(left, right);
-    if (node->value == on[Operators::LogicalAnd]) return builder->CreateAnd(left, right);
-    if (node->value == on[Operators::LogicalOr]) return builder->CreateOr(left, right);
-    return nullptr;
+const Type* IRGenerator::valueType(ASTNode* node) {
+    // the Frontend leaves `get` of a dict untyped, here it's the value or the program stops
+    if (match(node, ASTNodeType::MemberAccess)) {
+        auto* access = static_cast<MemberAccessNode*>(node);
+        const Type* parent = access->parent->inferredType;
+        if (parent && parent->kind == Type::Kind::Dict && memberName(access) == "get") return parent->components[1];
+    }
+    return node->inferredType;
 }
 
-llvm::Value* IRGenerator::generateUnaryOp(UnaryOperationNode* node) {
-    auto* operand = generateExpression(node->operand.get());
+llvm::Type* IRGenerator::stringType() { return pointerTo(builder.getInt8Ty()); }
 
-    if (node->value == on[Operators::Subtract]) return builder->CreateNeg(operand);
-    if (node->value == on[Operators::LogicalNot]) return builder->CreateNot(operand);
+llvm::Type* IRGenerator::sizeType() { return module->getDataLayout().getIntPtrType(context); }
 
-    return nullptr;
+llvm::Value* IRGenerator::stringConstant(const std::string& text) {
+    // with a header like the collector's and the counter's objects have, marked as not on the heap
+    if (collector || counter) {
+        llvm::Constant* data = llvm::ConstantDataArray::getString(context, text);
+        llvm::StructType* type = llvm::StructType::get(context, {builder.getInt64Ty(), data->getType()});
+        auto* global = new llvm::GlobalVariable(*module, type, true, llvm::GlobalValue::PrivateLinkage, llvm::ConstantStruct::get(type, {collector ? collector->staticHeader() : counter->staticHeader(), data}), ".str");
+        global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        global->setAlignment(llvm::Align(8));
+        llvm::Constant* indices[] = {builder.getInt32(0), builder.getInt32(1), builder.getInt32(0)};
+        return llvm::ConstantExpr::getInBoundsGetElementPtr(type, global, indices);
+    }
+
+    llvm::GlobalVariable* global = builder.CreateGlobalString(text, ".str", 0, module.get());
+    return builder.CreateConstInBoundsGEP2_32(global->getValueType(), global, 0, 0);
 }
 
-llvm::Value* IRGenerator::generateIf(IfNode* node) {
-    auto* thenBlock = llvm::BasicBlock::Create(context, "if.thenBlock", currentFunction);
-    auto* elseBlock = llvm::BasicBlock::Create(context, "if.elseBlock", currentFunction);
-    // A block following after If. LLVM has to fallback to something after meeting condition somehow
-    auto* afterBlock = llvm::BasicBlock::Create(context, "if.afterBlock", currentFunction);
+llvm::Function* IRGenerator::declareFunction(FunctionNode* function) {
+    const Type* type = function->inferredType;
+    if (!type || type->kind != Type::Kind::Function) {
+        unsupported(function, "untyped functions");
+        return nullptr;
+    }
 
-    // condition
-    auto* condition = generateExpression(node->condition.get());
-    builder->CreateCondBr(condition, thenBlock, elseBlock);
+    llvm::Type* result = type->returnType()->isDynamic() && !returnsValue(function->body.get()) ? builder.getVoidTy() : llvmType(type->returnType());
+    if (!result) {
+        unsupported(function, std::format("functions returning '{}'", type->returnType()->toString()));
+        return nullptr;
+    }
+    std::vector<llvm::Type*> parameters;
+    for (size_t i = 0; i < type->paramCount(); i++) {
+        llvm::Type* parameter = llvmType(type->param(i));
+        if (!parameter || parameter->isVoidTy()) {
+            unsupported(i < function->parameters.size() ? static_cast<ASTNode*>(function->parameters[i].get()) : function,
+                type->param(i)->isDynamic() ? "untyped parameters" : std::format("parameters of type '{}'", type->param(i)->toString()));
+            return nullptr;
+        }
+        parameters.push_back(parameter);
+    }
 
-    // then
-    builder->SetInsertPoint(thenBlock);
-    generateStatement(node->thenBlock.get());
-    builder->CreateBr(afterBlock);
+    std::string name = symbolName(function);
+    if (llvm::Function* existing = module->getFunction(name)) return existing;
 
-    // else
-    builder->SetInsertPoint(elseBlock);
-    if (node->elseBlock) generateStatement(node->elseBlock.get());
-    builder->CreateBr(afterBlock);
+    llvm::Function* llvmFunction = llvm::Function::Create(llvm::FunctionType::get(result, parameters, false), llvm::GlobalValue::ExternalLinkage, name, module.get());
+    for (size_t i = 0; i < function->parameters.size() && i < parameters.size(); i++) llvmFunction->getArg(i)->setName(function->parameters[i]->parameterName);
+    return llvmFunction;
+}
 
-    // merge back from condition
-    builder->SetInsertPoint(afterBlock);
-    return nullptr;
+llvm::GlobalVariable* IRGenerator::declareGlobal(DeclarationNode* declaration) {
+    const Type* type = declaration->inferredType;
+    llvm::Type* llvmVariableType = llvmType(type);
+    if (!llvmVariableType || llvmVariableType->isVoidTy()) {
+        unsupported(declaration, !type || type->isDynamic() ? "untyped variables" : std::format("variables of type '{}'", type->toString()));
+        return nullptr;
+    }
+
+    std::string name = globalName(declaration);
+    if (llvm::GlobalVariable* existing = module->getNamedGlobal(name)) return existing;
+    return new llvm::GlobalVariable(*module, llvmVariableType, false, llvm::GlobalValue::ExternalLinkage, nullptr, name);
 }
 
-llvm::Value* IRGenerator::generateFor(ForLoopNode* node) {
-    auto* iterable = generateExpression(node->iterable.get());
+DeclarationNode* IRGenerator::findGlobal(const std::string& name, const std::string& filePath) {
+    auto it = globals.find(name);
+    if (it == globals.end()) return nullptr;
+    for (DeclarationNode* declaration : it->second)
+        if (declaration->filePath == filePath) return declaration;
+    return it->second.front();
+}
 
-    auto* conditionBlock = llvm::BasicBlock::Create(context, "for.condition", currentFunction);
-    auto* body = llvm::BasicBlock::Create(context, "for.body", currentFunction);
-    auto* afterBlock = llvm::BasicBlock::Create(context, "for.afterBlock", currentFunction);
+FunctionNode* IRGenerator::findFunction(const std::string& name, const std::string& filePath, const Type* type) {
+    auto it = functions.find(name);
+    if (it == functions.end()) return nullptr;
+    FunctionNode* found = nullptr;
+    for (FunctionNode* function : it->second) {
+        if (function->inferredType != type) continue;
+        if (function->filePath == filePath) return function;
+        if (!found) found = function;
+    }
+    return found;
+}
 
-    // save old breaks and continues for nested loops
-    auto* prevBreak = currentBreakBB;
-    auto* prevContinue = currentContinueBB;
-    currentBreakBB = afterBlock;
-    currentContinueBB = conditionBlock;
+llvm::Value* IRGenerator::variablePointer(const std::string& name, const std::string& filePath, const Type*& type) {
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+        auto it = scope->find(name);
+        if (it == scope->end()) continue;
+        type = it->second.type;
+        return it->second.slot;
+    }
 
-    // initialization of iterable variable
-    pushScope();
-    auto* iterableAlloc = builder->CreateAlloca(llvm::Type::getInt32Ty(context), nullptr, node->variable->varName);
-    declareVariable(node->variable->varName, iterableAlloc, llvm::Type::getInt32Ty(context));
-    builder->CreateBr(conditionBlock);
+    DeclarationNode* declaration = findGlobal(name, filePath);
+    if (!declaration) return nullptr;
+    type = declaration->inferredType;
+    return declareGlobal(declaration);
+}
 
-    // fixme: conditionBlock is temporarily mute, we don't have range() in std for now
-    builder->SetInsertPoint(conditionBlock);
-    builder->CreateCondBr(llvm::ConstantInt::getTrue(context), body, afterBlock);
+llvm::AllocaInst* IRGenerator::createSlot(llvm::Type* type, const std::string& name, const Type* held) {
+    // every slot goes into the entry block, where mem2reg looks for them
+    llvm::BasicBlock& entry = currentFunction->getEntryBlock();
+    llvm::IRBuilder<> entryBuilder(&entry, entry.begin());
+    llvm::AllocaInst* slot = entryBuilder.CreateAlloca(type, nullptr, name);
+    if (isTraced(held)) roots[currentFunction].push_back(slot);
+    return slot;
+}
 
-    // body
-    builder->SetInsertPoint(body);
-    generateBlock(node->body.get());
-    builder->CreateBr(conditionBlock);
+void IRGenerator::storeVariable(llvm::Value* value, llvm::Value* pointer, const Type* type, bool release) {
+    auto* global = llvm::dyn_cast<llvm::GlobalVariable>(pointer);
+    if (!isCounted(type)) {
+        builder.CreateStore(value, pointer);
+        if (global && isTraced(type)) collector->writeBarrier(builder, global);
+        return;
+    }
 
-    builder->SetInsertPoint(afterBlock);
+    // any thread may read a global
+    if (global) shareValue(value, type);
+    llvm::Value* old = release ? builder.CreateLoad(value->getType(), pointer) : nullptr;
+    builder.CreateStore(value, pointer);
+    if (old) releaseValue(old, type);
+}
 
-    popScope();
-    currentBreakBB = prevBreak;
-    currentContinueBB = prevContinue;
+IRGenerator::Local* IRGenerator::findLocal(const std::string& name, size_t* scope) {
+    for (size_t i = scopes.size(); i-- > 0;) {
+        auto it = scopes[i].find(name);
+        if (it == scopes[i].end()) continue;
+        if (scope) *scope = i;
+        return &it->second;
+    }
     return nullptr;
 }
 
-llvm::Value* IRGenerator::generateWhile(WhileLoopNode* node) {
-    auto* conditionBlock = llvm::BasicBlock::Create(context, "while.condition", currentFunction);
-    auto* body = llvm::BasicBlock::Create(context, "while.body", currentFunction);
-    auto* afterBlock = llvm::BasicBlock::Create(context, "while.afterBlock", currentFunction);
+llvm::Value* IRGenerator::keep(llvm::Value* string) {
+    if (!collector) return string;
+    llvm::AllocaInst* slot = createSlot(stringType(), "kept");
+    roots[currentFunction].push_back(slot);
+    builder.CreateStore(string, slot);
+    return string;
+}
 
-    // for nested loops we save the old breaks and continues
-    auto* prevBreak = currentBreakBB;
-    auto* prevContinue = currentContinueBB;
+llvm::Value* IRGenerator::keep(llvm::Value* value, const Type* type) {
+    if (!isTraced(type)) return value;
+    if (value->getType() != Decimals::numberType(context)) return keep(builder.CreatePointerCast(value, stringType())), value;
+    builder.CreateStore(value, createSlot(value->getType(), "kept", type));
+    return value;
+}
 
-    currentBreakBB = afterBlock;
-    currentContinueBB = conditionBlock;
+llvm::Value* IRGenerator::regionFor(const ASTNode* allocation) {
+    const ASTNode* owner = escapes.regionOf(allocation);
+    for (const Region& region : regions)
+        if (region.owner == owner) return region.slot;
+    return nullptr; // not an allocation Escape Analysis placed, or generated outside its function (a default argument)
+}
 
-    // condition
-    builder->CreateBr(conditionBlock);
-    builder->SetInsertPoint(conditionBlock);
-    auto* condition = generateExpression(node->condition.get());
-    builder->CreateCondBr(condition, body, afterBlock);
+void IRGenerator::beginRegion(const ASTNode* owner) {
+    if (!escapes.hasRegion(owner)) return;
+    llvm::AllocaInst* slot = createSlot(regionAllocator->regionType(), "region");
+    regionAllocator->begin(builder, slot);
+    regions.push_back(Region{owner, slot});
+}
 
-    // body
-    builder->SetInsertPoint(body);
-    generateBlock(node->body.get());
-    builder->CreateBr(conditionBlock);
+void IRGenerator::resetRegion(const ASTNode* owner, bool release) {
+    auto it = std::find_if(regions.begin(), regions.end(), [owner](const Region& region) { return region.owner == owner; });
+    if (it == regions.end()) return;
+    builder.CreateCall(release ? regionAllocator->release() : regionAllocator->reset(), {it->slot});
 
-    // after the loop
-    builder->SetInsertPoint(afterBlock);
+    // locals of the loop still point into the region: they're roots, and the collector would read what's there now
+    if (collector) {
+        for (const ASTNode* local : escapes.regionLocals(owner)) {
+            auto slot = declarationSlots.find(local);
+            if (slot != declarationSlots.end()) builder.CreateStore(llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(stringType())), slot->second);
+        }
+    }
+    if (release) regions.erase(it);
+}
 
-    // recover the nested breaks and continues
-    currentBreakBB = prevBreak;
-    currentContinueBB = prevContinue;
+void IRGenerator::beginAppending(const ASTNode* loop) {
+    for (const EscapeAnalysis::Append& append : escapes.appendedLocals(loop)) {
+        auto slot = declarationSlots.find(append.declaration);
+        if (slot == declarationSlots.end()) continue;
+        // an outer loop may be appending to it already
+        if (std::any_of(appending.begin(), appending.end(), [&](const Appending& other) { return other.local == slot->second; })) continue;
+        const Local* local = nullptr;
+        size_t scope = scopes.size();
+        while (!local && scope-- > 0)
+            for (auto& [name, candidate] : scopes[scope])
+                if (candidate.slot == slot->second) local = &candidate;
+        if (!local) continue;
+
+        bool release = local->owned && (!currentCallback || scope >= currentCallback->scopes);
+        Appending appended{loop, slot->second, local->type, createSlot(stringType(), "appended"), createSlot(sizeType(), "appended.length"),
+            createSlot(sizeType(), "appended.capacity"), append.site, release};
+        builder.CreateStore(llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(stringType())), appended.buffer);
+        builder.CreateStore(builder.CreateCall(libc("strlen", sizeType(), {stringType()}), {builder.CreateLoad(stringType(), appended.local)}), appended.length);
+        builder.CreateStore(llvm::ConstantInt::get(sizeType(), 0), appended.capacity);
+        appending.push_back(appended);
+    }
+}
 
-    return nullptr;
+void IRGenerator::endAppending(const ASTNode* loop) {
+    for (auto it = appending.begin(); it != appending.end();) {
+        if (it->loop != loop) {
+            ++it;
+            continue;
+        }
+        // a loop that never appended leaves the local as it was
+        llvm::BasicBlock* flush = llvm::BasicBlock::Create(context, "appended.flush", currentFunction);
+        llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "appended.done", currentFunction);
+        llvm::Value* buffer = builder.CreateLoad(stringType(), it->buffer);
+        builder.CreateCondBr(builder.CreateIsNull(buffer), done, flush);
+
+        builder.SetInsertPoint(flush);
+        llvm::Value* string = buildString({{buffer, builder.CreateLoad(sizeType(), it->length)}}, regionFor(it->site));
+        storeVariable(string, it->local, it->type, it->release);
+        builder.CreateCall(libc("free", builder.getVoidTy(), {stringType()}), {buffer});
+        builder.CreateBr(done);
+        builder.SetInsertPoint(done);
+        it = appending.erase(it);
+    }
+}
+
+void IRGenerator::releaseRegions() {
+    // the frame goes away with them, nothing needs clearing
+    for (auto region = regions.rbegin(); region != regions.rend(); ++region) builder.CreateCall(regionAllocator->release(), {region->slot});
 }
 
-llvm::Value* IRGenerator::generateSwitch(SwitchNode* node) {
-    auto* expression = generateExpression(node->expression.get());
+bool IRGenerator::isTraced(const Type* type) {
+    return collector && type && (isString(type) || type->isPrimitive(ResolvedType::Number) || (isCollection(type) && collectionType(type)));
+}
 
-    auto* defaultBlock = llvm::BasicBlock::Create(context, "switch.default", currentFunction);
-    auto* afterBlock = llvm::BasicBlock::Create(context, "switch.afterBlock", currentFunction);
+bool IRGenerator::isCounted(const Type* type) {
+    if (!counter || !type) return false;
+    if (type->kind == Type::Kind::Tuple) return std::any_of(type->components.begin(), type->components.end(), [this](const Type* component) { return isCounted(component); });
+    return isString(type) || type->isPrimitive(ResolvedType::Number) || (isCollection(type) && collectionType(type));
+}
 
-    // preservation
-    auto* prevBreak = currentBreakBB;
-    currentBreakBB = afterBlock;
+void IRGenerator::retainValue(llvm::Value* value, const Type* type) {
+    if (!isCounted(type)) return;
+    if (type->kind == Type::Kind::Tuple) {
+        for (unsigned i = 0; i < type->components.size(); i++) retainValue(builder.CreateExtractValue(value, i), type->components[i]);
+        return;
+    }
+    // a collection has the same header in front of it as a string, and so do a number's limbs
+    if (type->isPrimitive(ResolvedType::Number)) value = Decimals::limbs(builder, value);
+    builder.CreateCall(counter->retain(), {builder.CreatePointerCast(value, stringType())});
+}
 
-    auto* switchInstance = builder->CreateSwitch(expression, defaultBlock, node->cases.size());
+void IRGenerator::releaseValue(llvm::Value* value, const Type* type) {
+    if (!isCounted(type)) return;
+    if (type->kind == Type::Kind::Tuple) {
+        for (unsigned i = 0; i < type->components.size(); i++) releaseValue(builder.CreateExtractValue(value, i), type->components[i]);
+        return;
+    }
+    if (isString(type)) builder.CreateCall(counter->release(), {value});
+    else if (type->isPrimitive(ResolvedType::Number)) builder.CreateCall(counter->release(), {Decimals::limbs(builder, value)});
+    else builder.CreateCall(collections->release(collectionType(type)), {value});
+}
 
-    // cases
-    for (const auto& sCase : node->cases) {
-        auto* caseBlock = llvm::BasicBlock::Create(context, "switch.case", currentFunction);
-        auto* caseValue = generateExpression(sCase->condition.get()); // should be ConstantInt
-        switchInstance->addCase(llvm::cast<llvm::ConstantInt>(caseValue), caseBlock);
-        builder->SetInsertPoint(caseBlock);
-        generateStatement(sCase->body.get());
-        builder->CreateBr(afterBlock);
+void IRGenerator::shareValue(llvm::Value* value, const Type* type) {
+    if (!isCounted(type)) return;
+    if (type->kind == Type::Kind::Tuple) {
+        for (unsigned i = 0; i < type->components.size(); i++) shareValue(builder.CreateExtractValue(value, i), type->components[i]);
+        return;
     }
+    if (isString(type)) builder.CreateCall(counter->share(), {value});
+    else if (type->isPrimitive(ResolvedType::Number)) builder.CreateCall(counter->share(), {Decimals::limbs(builder, value)});
+    else builder.CreateCall(collections->share(collectionType(type)), {value});
+}
 
-    // default
-    builder->SetInsertPoint(defaultBlock);
-    if (node->defaultCase) generateStatement(node->defaultCase->body.get());
-    builder->CreateBr(afterBlock);
+llvm::Value* IRGenerator::fresh(llvm::Value* value, const Type* type) {
+    if (value && isCounted(type) && !temporaries.empty()) temporaries.back().emplace_back(value, type);
+    return value;
+}
 
-    builder->SetInsertPoint(afterBlock);
-    currentBreakBB = prevBreak;
-    return nullptr;
+llvm::Value* IRGenerator::acquire(llvm::Value* value, const Type* type) {
+    if (!value || !isCounted(type)) return value;
+    // the innermost statement made it most likely
+    for (auto frame = temporaries.rbegin(); frame != temporaries.rend(); ++frame) {
+        auto it = std::find_if(frame->begin(), frame->end(), [value](const auto& temporary) { return temporary.first == value; });
+        if (it == frame->end()) continue;
+        frame->erase(it);
+        return value;
+    }
+    retainValue(value, type);
+    return value;
 }
 
-llvm::Function* IRGenerator::generateFunctionSignature(FunctionNode* node) {
-    if (node->isIntrinsic) intrinsicFunctions[node->name] = true;
+void IRGenerator::releaseTemporaries(size_t from) {
+    for (size_t i = temporaries.size(); i-- > from;)
+        for (auto temporary = temporaries[i].rbegin(); temporary != temporaries[i].rend(); ++temporary) releaseValue(temporary->first, temporary->second);
+}
 
-    std::vector<llvm::Type*> parameterTypes;
-    for (const auto& parameter : node->parameters)
-        parameterTypes.push_back(resolveType(parameter->parameterRawType->varType->varName));
+void IRGenerator::releaseLocals(size_t from, const Local* moved) {
+    if (!counter) return;
+    for (size_t i = scopes.size(); i-- > from;) {
+        for (auto& [name, local] : scopes[i]) {
+            if (!local.owned || &local == moved) continue;
+            releaseValue(builder.CreateLoad(local.slot->getAllocatedType(), local.slot), local.type);
+        }
+    }
+}
 
-    llvm::Type* returnType = node->returnType ? resolveType(node->returnType->varType->varName)
-                        : llvm::Type::getVoidTy(context);
+llvm::Value* IRGenerator::generateCondition(ASTNode* node) {
+    temporaries.emplace_back();
+    llvm::Value* condition = generateExpression(node);
+    if (condition) releaseTemporaries(temporaries.size() - 1);
+    temporaries.pop_back();
+    return condition;
+}
 
-    llvm::FunctionType* functionType = llvm::FunctionType::get(returnType, parameterTypes, false);
-    llvm::Function* function = llvm::Function::Create(functionType, llvm::Function::ExternalLinkage, node->name, program.get());
-    functions.emplace(node->name, function);
-    return function;
+llvm::Value* IRGenerator::convert(llvm::Value* value, const Type* from, const Type* to) {
+    if (!value || !from || !to || from == to) return value;
+
+    // `number` takes every numeric type, the others are never converted implicitly
+    if (to->isPrimitive(ResolvedType::Number)) {
+        if (from->isInteger()) {
+            // uint64 and the 128-bit ones may need limbs
+            llvm::Value* number = decimals->fromInteger(builder, value, !isUnsigned(from));
+            return llvm::isa<llvm::CallInst>(number) ? fresh(keep(number, to), to) : number;
+        }
+        if (from->isFloat()) return decimals->fromReal(builder, value);
+    }
+    return value;
 }
 
-void IRGenerator::generateFunctionBody(FunctionNode* node) {
-    llvm::Function* function = functions.at(node->name);
-    currentFunction = function;
-    llvm::BasicBlock* entryBlock = llvm::BasicBlock::Create(context, "entry", function);
-    builder->SetInsertPoint(entryBlock);
+// ==== Statements ====
 
-    pushScope();
+void IRGenerator::generateStatement(ASTNode* node) {
+    temporaries.emplace_back();
+    switch (node->type) {
+        case ASTNodeType::Declaration: generateDeclaration(static_cast<DeclarationNode*>(node)); break;
+        case ASTNodeType::Assignment: generateAssignment(static_cast<AssignmentNode*>(node)); break;
+        case ASTNodeType::Block: generateBlock(node); break;
+        case ASTNodeType::IfStatement: generateIf(static_cast<IfNode*>(node)); break;
+        case ASTNodeType::WhileLoop: generateWhile(static_cast<WhileLoopNode*>(node)); break;
+        case ASTNodeType::Switch: generateSwitch(static_cast<SwitchNode*>(node)); break;
+        case ASTNodeType::ReturnStatement: generateReturn(static_cast<ReturnStatementNode*>(node)); break;
+        case ASTNodeType::BreakStatement:
+            if (!breakBlock) break;
+            releaseTemporaries(loopTemporaries);
+            releaseLocals(loopScopes);
+            builder.CreateBr(breakBlock);
+            break;
+        case ASTNodeType::ContinueStatement:
+            if (!continueBlock) break;
+            releaseTemporaries(loopTemporaries);
+            releaseLocals(loopScopes);
+            resetRegion(currentLoop, false);
+            builder.CreateBr(continueBlock);
+            break;
+        case ASTNodeType::ForLoop: generateFor(static_cast<ForLoopNode*>(node)); break;
+        case ASTNodeType::TryCatch: unsupported(node, "try/catch"); break;
+        case ASTNodeType::ThrowStatement: unsupported(node, "throw"); break;
+        case ASTNodeType::Function: unsupported(node, "nested functions"); break;
+        case ASTNodeType::Class: unsupported(node, "classes"); break;
+        case ASTNodeType::Import: break;
+        default: generateExpression(node); break;
+    }
+    // what the statement made and nothing took
+    if (!isTerminated()) releaseTemporaries(temporaries.size() - 1);
+    temporaries.pop_back();
+}
 
-    auto* llvmArg = function->arg_begin();
-    for (const auto& parameter : node->parameters) {
-        llvmArg->setName(parameter->parameterName);
+void IRGenerator::generateBlock(ASTNode* node) {
+    if (!node) return;
+    if (!match(node, ASTNodeType::Block)) {
+        generateStatement(node);
+        return;
+    }
 
-        // fixme: for now, array sizes are syntactically supported, but IR doesn't address it. i will fix that after the working alpha
-        auto* paramAlloc = builder->CreateAlloca(llvmArg->getType(), nullptr, parameter->parameterName);
-        builder->CreateStore(&*llvmArg, paramAlloc);
-        llvmArg++;
+    scopes.emplace_back();
+    for (auto& statement : static_cast<BlockNode*>(node)->statements) {
+        if (isTerminated()) break; // the rest is dead, Flow Analysis already said so
+        generateStatement(statement.get());
     }
+    if (!isTerminated()) releaseLocals(scopes.size() - 1);
+    scopes.pop_back();
+}
+
+void IRGenerator::generateDeclaration(DeclarationNode* node) {
+    const Type* type = node->inferredType;
+    llvm::Type* llvmVariableType = llvmType(type);
+    if (!llvmVariableType || llvmVariableType->isVoidTy()) {
+        unsupported(node, !type || type->isDynamic() ? "untyped variables" : std::format("variables of type '{}'", type->toString()));
+        return;
+    }
+
+    // the value is generated first: in `x := x + 1` the right `x` is still the outer one
+    llvm::Value* value = nullptr;
+    if (node->value) {
+        value = convert(generateExpression(node->value.get()), valueType(node->value.get()), type);
+        if (!value) return;
+    }
+
+    llvm::AllocaInst* slot = createSlot(llvmVariableType, node->variable->varName, type);
+    bool owned = isCounted(type);
+    if (value) builder.CreateStore(owned ? acquire(value, type) : value, slot);
+    else if (owned) builder.CreateStore(llvm::Constant::getNullValue(llvmVariableType), slot); // in a loop it'd still hold the last iteration's
+    scopes.back()[node->variable->varName] = Local{slot, type, owned};
+    declarationSlots[node] = slot;
+}
+
+void IRGenerator::generateAssignment(AssignmentNode* node) {
+    if (!match(node->variable.get(), ASTNodeType::Variable)) {
+        unsupported(node, "assignments to members and elements");
+        return;
+    }
+
+    auto* variable = static_cast<VariableNode*>(node->variable.get());
+    const Type* type = nullptr;
+    llvm::Value* pointer = variablePointer(variable->varName, variable->filePath, type);
+    if (!pointer) {
+        unsupported(variable, "assignments to this name");
+        return;
+    }
+
+    // A local borrowing its value doesn't drop it, nor does a lambda assigning a local of the function around it: the
+    // old value may be borrowed further out. It's held until the function returns.
+    size_t scope = 0;
+    Local* local = findLocal(variable->varName, &scope);
+    bool release = !local || (local->owned && (!currentCallback || scope >= currentCallback->scopes));
+
+    // a loop only appending to the local takes what's appended into its buffer
+    auto appended = std::find_if(appending.begin(), appending.end(), [pointer](const Appending& appended) { return appended.local == pointer; });
+    std::vector<ASTNode*> operands = EscapeAnalysis::appendedOperands(node);
+    if (appended != appending.end() && !operands.empty()) {
+        std::vector<StringPiece> pieces;
+        for (ASTNode* operand : operands)
+            if (!appendPieces(operand, pieces)) return;
+        appendString(*appended, pointer, pieces);
+        return;
+    }
+
+    // `s += ...` is built in one go too, after what's appended is evaluated
+    if (node->op == "+=" && type && type->isPrimitive(ResolvedType::Str)) {
+        std::vector<StringPiece> pieces;
+        if (!appendPieces(node->value.get(), pieces)) return;
+        std::vector<StringPiece> current;
+        appendValue(builder.CreateLoad(stringType(), pointer), type, current);
+        pieces.insert(pieces.begin(), current.begin(), current.end());
+        storeVariable(buildString(pieces, regionFor(node)), pointer, type, release);
+        return;
+    }
+
+    llvm::Value* value = convert(generateExpression(node->value.get()), valueType(node->value.get()), type);
+    if (!value) return;
+
+    // x += y is x = x + y
+    if (node->op != "=") {
+        llvm::Value* current = builder.CreateLoad(llvmType(type), pointer);
+        value = generateOperation(node->op.substr(0, node->op.size() - 1), current, value, type, node);
+        if (!value) return;
+    }
+    storeVariable(acquire(value, type), pointer, type, release);
+}
+
+void IRGenerator::generateIf(IfNode* node) {
+    llvm::Value* condition = generateCondition(node->condition.get());
+    if (!condition) return;
+
+    llvm::BasicBlock* thenBlock = llvm::BasicBlock::Create(context, "if.then", currentFunction);
+    llvm::BasicBlock* elseBlock = node->elseBlock ? llvm::BasicBlock::Create(context, "if.else", currentFunction) : nullptr;
+    llvm::BasicBlock* endBlock = llvm::BasicBlock::Create(context, "if.end", currentFunction);
+    builder.CreateCondBr(condition, thenBlock, elseBlock ? elseBlock : endBlock);
+
+    builder.SetInsertPoint(thenBlock);
+    generateBlock(node->thenBlock.get());
+    if (!isTerminated()) builder.CreateBr(endBlock);
+
+    // `else if` is an IfNode in place of the else block
+    if (elseBlock) {
+        builder.SetInsertPoint(elseBlock);
+        generateBlock(node->elseBlock.get());
+        if (!isTerminated()) builder.CreateBr(endBlock);
+    }
+    builder.SetInsertPoint(endBlock);
+}
+
+void IRGenerator::generateWhile(WhileLoopNode* node) {
+    llvm::BasicBlock* conditionBlock = llvm::BasicBlock::Create(context, "while.cond", currentFunction);
+    llvm::BasicBlock* bodyBlock = llvm::BasicBlock::Create(context, "while.body", currentFunction);
+    llvm::BasicBlock* endBlock = llvm::BasicBlock::Create(context, "while.end", currentFunction);
+    beginRegion(node); // strings of one iteration, freed when it's over
+    beginAppending(node);
+    builder.CreateBr(conditionBlock);
+
+    builder.SetInsertPoint(conditionBlock);
+    llvm::Value* condition = generateCondition(node->condition.get());
+    if (!condition) return;
+    builder.CreateCondBr(condition, bodyBlock, endBlock);
+
+    llvm::BasicBlock* savedBreak = breakBlock;
+    llvm::BasicBlock* savedContinue = continueBlock;
+    const ASTNode* savedLoop = currentLoop;
+    size_t savedScopes = loopScopes, savedTemporaries = loopTemporaries;
+    breakBlock = endBlock;
+    continueBlock = conditionBlock;
+    currentLoop = node;
+    loopScopes = scopes.size();
+    loopTemporaries = temporaries.size();
+
+    builder.SetInsertPoint(bodyBlock);
+    generateBlock(node->body.get());
+    if (!isTerminated()) {
+        resetRegion(node, false);
+        builder.CreateBr(conditionBlock);
+    }
+
+    breakBlock = savedBreak;
+    continueBlock = savedContinue;
+    currentLoop = savedLoop;
+    loopScopes = savedScopes;
+    loopTemporaries = savedTemporaries;
+    builder.SetInsertPoint(endBlock);
+    resetRegion(node, true);
+    endAppending(node);
+}
+
+void IRGenerator::generateFor(ForLoopNode* node) {
+    // the iterator is set up once, before the loop; the header pulls an element, or leaves when there are no more
+    std::optional<Iterator> iterator = openIterator(node->iterable.get(), node);
+    if (!iterator) return;
+    llvm::BasicBlock* nextBlock = llvm::BasicBlock::Create(context, "for.next", currentFunction);
+    llvm::BasicBlock* endBlock = llvm::BasicBlock::Create(context, "for.end", currentFunction);
+    beginRegion(node);
+    beginAppending(node);
+    builder.CreateBr(nextBlock);
+
+    builder.SetInsertPoint(nextBlock);
+    llvm::Value* element = iterator->next(endBlock);
+    if (!element) return;
+
+    // `for (i, x: ...)` takes the tuple apart
+    scopes.emplace_back();
+    // an element that comes with a reference is the variable's, a borrowed one gets its own if it's assigned to
+    auto bind = [&](VariableNode* variable, llvm::Value* value, const ASTNode* declaration) {
+        const Type* type = variable->inferredType;
+        bool owned = isCounted(type) && (iterator->owned || escapes.isAssigned(declaration));
+        if (owned && !iterator->owned) retainValue(value, type);
+        llvm::AllocaInst* slot = createSlot(value->getType(), variable->varName, type);
+        builder.CreateStore(value, slot);
+        scopes.back()[variable->varName] = Local{slot, type, owned};
+        declarationSlots[declaration] = slot;
+    };
+    if (node->unpacked.empty()) bind(node->variable.get(), element, node);
+    else {
+        bind(node->variable.get(), builder.CreateExtractValue(element, 0), node);
+        for (size_t i = 0; i < node->unpacked.size(); i++)
+            bind(node->unpacked[i].get(), builder.CreateExtractValue(element, i + 1), node->unpacked[i].get());
+    }
+
+    llvm::BasicBlock* savedBreak = breakBlock;
+    llvm::BasicBlock* savedContinue = continueBlock;
+    const ASTNode* savedLoop = currentLoop;
+    size_t savedScopes = loopScopes, savedTemporaries = loopTemporaries;
+    breakBlock = endBlock;
+    continueBlock = nextBlock;
+    currentLoop = node;
+    loopScopes = scopes.size() - 1;
+    loopTemporaries = temporaries.size();
 
     generateBlock(node->body.get());
-    popScope();
+    if (!isTerminated()) {
+        releaseLocals(scopes.size() - 1);
+        resetRegion(node, false);
+        builder.CreateBr(nextBlock);
+    }
+    scopes.pop_back();
+
+    breakBlock = savedBreak;
+    continueBlock = savedContinue;
+    currentLoop = savedLoop;
+    loopScopes = savedScopes;
+    loopTemporaries = savedTemporaries;
+    builder.SetInsertPoint(endBlock);
+    resetRegion(node, true);
+    endAppending(node);
+}
+
+void IRGenerator::generateSwitch(SwitchNode* node) {
+    llvm::Value* value = generateExpression(node->expression.get());
+    if (!value) return;
+    const Type* type = valueType(node->expression.get());
+
+    // a chain of comparisons, cases don't fall through. SimplifyCFG turns integer chains into a jump table.
+    llvm::BasicBlock* endBlock = llvm::BasicBlock::Create(context, "switch.end", currentFunction);
+    for (const auto& caseNode : node->cases) {
+        temporaries.emplace_back();
+        llvm::Value* candidate = convert(generateExpression(caseNode->condition.get()), valueType(caseNode->condition.get()), type);
+        llvm::Value* matches = candidate ? generateOperation("==", value, candidate, type, caseNode.get()) : nullptr;
+        if (matches) releaseTemporaries(temporaries.size() - 1);
+        temporaries.pop_back();
+        if (!matches) return;
+
+        llvm::BasicBlock* bodyBlock = llvm::BasicBlock::Create(context, "switch.case", currentFunction, endBlock);
+        llvm::BasicBlock* nextBlock = llvm::BasicBlock::Create(context, "switch.next", currentFunction, endBlock);
+        builder.CreateCondBr(matches, bodyBlock, nextBlock);
+
+        builder.SetInsertPoint(bodyBlock);
+        generateBlock(caseNode->body.get());
+        if (!isTerminated()) builder.CreateBr(endBlock);
+        builder.SetInsertPoint(nextBlock);
+    }
 
-    if (!builder->GetInsertBlock()->getTerminator())
-        builder->CreateRetVoid();
+    if (node->defaultCase) generateBlock(node->defaultCase->body.get());
+    if (!isTerminated()) builder.CreateBr(endBlock);
+    builder.SetInsertPoint(endBlock);
 }
 
-llvm::Value* IRGenerator::generateLambda(LambdaNode* node) {
-    std::string name = "__lambda_" + std::to_string(lambdaCounter++);
+void IRGenerator::generateReturn(ReturnStatementNode* node) {
+    // a return of a lambda generated inline goes on after the lambda, with its result
+    if (currentCallback) {
+        if (node->expression) {
+            llvm::Value* value = convert(generateExpression(node->expression.get()), valueType(node->expression.get()), currentCallback->type);
+            if (!value) return;
+            builder.CreateStore(acquire(value, currentCallback->type), currentCallback->result);
+        }
+        releaseTemporaries(currentCallback->temporaries);
+        releaseLocals(currentCallback->scopes);
+        builder.CreateBr(currentCallback->exit);
+        return;
+    }
+
+    // a local returned as it is is moved out, with its reference
+    const Local* moved = nullptr;
+    if (counter && node->expression && match(node->expression.get(), ASTNodeType::Variable))
+        if (const Local* local = findLocal(static_cast<VariableNode*>(node->expression.get())->varName); local && local->owned) moved = local;
+    auto take = [&](llvm::Value* value) { return moved ? value : acquire(value, currentReturnType); };
+
+    // a coroutine finishes instead, the value goes to whoever awaits it
+    if (coroutine) {
+        llvm::Value* value = nullptr;
+        if (node->expression) value = generateExpression(node->expression.get());
+        if (currentReturnType && !currentReturnType->isVoid()) {
+            value = convert(value, valueType(node->expression.get()), currentReturnType);
+            if (!value) return;
+            keep(take(value), currentReturnType); // until it's destroyed
+        }
+        else {
+            value = nullptr;
+            moved = nullptr;
+        }
+        releaseTemporaries(0);
+        releaseLocals(0, moved);
+        releaseRegions();
+        executor->finish(builder, *coroutine, value);
+        return;
+    }
 
-    std::vector<llvm::Type*> parameterTypes;
-    for (const auto& parameter : node->params)
-        if (parameter->type == ASTNodeType::Variable)
-            parameterTypes.push_back(llvm::Type::getInt32Ty(context));
+    if (!node->expression || !currentReturnType || currentReturnType->isVoid()) {
+        if (node->expression) generateExpression(node->expression.get());
+        releaseTemporaries(0);
+        releaseLocals(0);
+        releaseRegions();
+        builder.CreateRetVoid();
+        return;
+    }
 
-    // create function
-    auto* fnType = llvm::FunctionType::get(llvm::Type::getVoidTy(context), parameterTypes, false);
-    auto* fn = llvm::Function::Create(fnType, llvm::Function::ExternalLinkage, name, program.get());
+    // what's returned escapes, so it's never in a region
+    llvm::Value* value = convert(generateExpression(node->expression.get()), valueType(node->expression.get()), currentReturnType);
+    if (!value) return;
+    value = take(value);
+    releaseTemporaries(0);
+    releaseLocals(0, moved);
+    releaseRegions();
+    builder.CreateRet(value);
+}
 
-    // generate body
-    auto* prevFunction = currentFunction;
-    currentFunction = fn;
+// ==== Expressions ====
 
-    auto* entryBlock = llvm::BasicBlock::Create(context, "entry", fn);
-    builder->SetInsertPoint(entryBlock);
+llvm::Value* IRGenerator::generateExpression(ASTNode* node) {
+    if (!node) return nullptr;
 
-    pushScope();
-    auto arg = fn->arg_begin();
-    for (const auto& parameter : node->params)
-        if (parameter->type == ASTNodeType::Variable) {
-            auto* var = static_cast<VariableNode*>(parameter.get());
-            arg->setName(var->varName);
-            auto* alloc = builder->CreateAlloca(arg->getType());
-            builder->CreateStore(&*arg, alloc);
-            declareVariable(var->varName, alloc, arg->getType());
-            arg++;
+    switch (node->type) {
+        case ASTNodeType::Literal: return generateLiteral(static_cast<LiteralNode*>(node));
+        case ASTNodeType::Variable: return generateVariable(static_cast<VariableNode*>(node));
+        case ASTNodeType::BinaryOperation: return generateBinary(static_cast<BinaryOperationNode*>(node));
+        case ASTNodeType::UnaryOperation: return generateUnary(static_cast<UnaryOperationNode*>(node));
+        case ASTNodeType::CallExpression: return generateCall(static_cast<CallExpressionNode*>(node));
+        case ASTNodeType::MemberAccess: {
+            // only namespace calls so far: std.math.sqrt(x) is a chain ending in a call the Frontend resolved
+            ASTNode* last = node;
+            while (match(last, ASTNodeType::MemberAccess)) last = static_cast<MemberAccessNode*>(last)->val.get();
+            if (match(last, ASTNodeType::CallExpression) && static_cast<CallExpressionNode*>(last)->resolvedFunction)
+                return generateCall(static_cast<CallExpressionNode*>(last));
+            // and methods of collections and iterators
+            const Type* parent = static_cast<MemberAccessNode*>(node)->parent->inferredType;
+            if (isCollection(parent)) return generateMethod(static_cast<MemberAccessNode*>(node));
+            if (parent && parent->kind == Type::Kind::Iterator) return generateConsumer(static_cast<MemberAccessNode*>(node));
+            unsupported(node, "member access");
+            return nullptr;
         }
+        case ASTNodeType::Array: case ASTNodeType::Set: case ASTNodeType::Dict: return generateCollection(node);
+        case ASTNodeType::Tuple: unsupported(node, "tuples"); return nullptr;
+        case ASTNodeType::Result: unsupported(node, "results"); return nullptr;
+        case ASTNodeType::Lambda: unsupported(node, "lambdas as values"); return nullptr;
+        default: unsupported(node, "this expression"); return nullptr;
+    }
+}
+
+llvm::Value* IRGenerator::generateLiteral(LiteralNode* node) {
+    const Type* type = node->inferredType;
+    llvm::Type* literalType = llvmType(type);
+
+    switch (node->literalType) {
+        case ASTLiteralType::Integer:
+        case ASTLiteralType::Float:
+            // an integer literal takes the type it's used as, `x: float = 5` included. A number is exactly what's written.
+            if (type && type->isPrimitive(ResolvedType::Number)) return decimals->constant(node->value);
+            if (literalType && literalType->isIntegerTy() && !literalType->isIntegerTy(1))
+                return llvm::ConstantInt::get(llvm::cast<llvm::IntegerType>(literalType), node->value, 10);
+            if (literalType && literalType->isFloatingPointTy()) return llvm::ConstantFP::get(literalType, node->value);
+            break;
+        case ASTLiteralType::Bool: return builder.getInt1(node->value == "true");
+        case ASTLiteralType::String:
+            if (node->isInterpolation()) return generateInterpolation(node);
+            return stringConstant(node->value);
+        case ASTLiteralType::Null: unsupported(node, "null values"); return nullptr;
+    }
+    unsupported(node, std::format("values of type '{}'", type ? type->toString() : "?"));
+    return nullptr;
+}
+
+llvm::Value* IRGenerator::generateInterpolation(LiteralNode* node) {
+    std::vector<StringPiece> pieces;
+    if (!appendInterpolation(node, pieces)) return nullptr;
+    llvm::Value* region = regionFor(node);
+    llvm::Value* string = buildString(pieces, region);
+    return region ? string : fresh(string, node->inferredType);
+}
+
+llvm::Value* IRGenerator::generateVariable(VariableNode* node) {
+    const Type* type = nullptr;
+    llvm::Value* pointer = variablePointer(node->varName, node->filePath, type);
+    llvm::Type* valueType = pointer ? llvmType(type) : nullptr;
+    if (!valueType) {
+        unsupported(node, pointer ? std::format("values of type '{}'", type->toString()) : "functions as values");
+        return nullptr;
+    }
+    // a global can be stored to again while its old string is still in use, a local's value is borrowed
+    llvm::Value* value = builder.CreateLoad(valueType, pointer, node->varName);
+    if (!llvm::isa<llvm::GlobalVariable>(pointer)) return value;
+    retainValue(value, type);
+    return fresh(keep(value, type), type);
+}
 
-    generateStatement(node->body.get());
-    popScope();
+llvm::Value* IRGenerator::generateBinary(BinaryOperationNode* node) {
+    const std::string& op = node->value;
+    if (op == "&&" || op == "||" || op == "and" || op == "or") return generateLogical(node);
+
+    // `a + b + c` on strings is one string, the ones in between are never made
+    const Type* leftType = valueType(node->leftOperand.get());
+    if (op == "+" && leftType && leftType->isPrimitive(ResolvedType::Str)) {
+        std::vector<StringPiece> pieces;
+        if (!appendPieces(node->leftOperand.get(), pieces) || !appendPieces(node->rightOperand.get(), pieces)) return nullptr;
+        llvm::Value* region = regionFor(node);
+        llvm::Value* string = buildString(pieces, region);
+        return region ? string : fresh(string, leftType);
+    }
 
-    if (!builder->GetInsertBlock()->getTerminator())
-        builder->CreateRetVoid();
+    llvm::Value* left = generateExpression(node->leftOperand.get());
+    llvm::Value* right = generateExpression(node->rightOperand.get());
+    if (!left || !right) return nullptr;
 
-    currentFunction = prevFunction;
-    builder->SetInsertPoint(&currentFunction->back());
+    // operands are of one type, comparisons only differ in their result. `==` and `!=` also compare a number with
+    // anything it takes, as a number.
+    const Type* type = valueType(node->leftOperand.get());
+    if (!type || type->isDynamic()) {
+        unsupported(node, "operations on untyped values");
+        return nullptr;
+    }
+    const Type* rightType = valueType(node->rightOperand.get());
+    if (rightType && rightType->isPrimitive(ResolvedType::Number) && !type->isPrimitive(ResolvedType::Number)) {
+        left = convert(left, type, rightType);
+        type = rightType;
+    }
+    else if (type->isPrimitive(ResolvedType::Number)) right = convert(right, rightType, type);
+    llvm::Value* result = generateOperation(op, left, right, type, node);
+    if (!result) return nullptr;
+    releaseOperand(node->leftOperand.get(), left);
+    releaseOperand(node->rightOperand.get(), right);
+    return result;
+}
 
-    return fn;
+void IRGenerator::releaseOperand(ASTNode* node, llvm::Value* value) {
+    // results of number arithmetic always have limbs of their own, anything else may share them. The collector and
+    // the counter take care of the limbs they allocated.
+    if (collector || counter || !match(node, ASTNodeType::BinaryOperation)) return;
+    const std::string& op = static_cast<BinaryOperationNode*>(node)->value;
+    const Type* type = valueType(node);
+    if (type && type->isPrimitive(ResolvedType::Number) && (op == "+" || op == "-" || op == "*" || op == "/" || op == "%"))
+        builder.CreateCall(decimals->release(), {value});
 }
 
-llvm::Value* IRGenerator::generateDecorator(DecoratorNode* node) {
-    // decorator is a function that wraps behaviors of functions and does external stuff
+llvm::Value* IRGenerator::generateLogical(BinaryOperationNode* node) {
+    bool isAnd = node->value == "&&" || node->value == "and";
+    llvm::Value* left = generateExpression(node->leftOperand.get());
+    if (!left) return nullptr;
+
+    // the right operand only runs when the left one doesn't decide
+    llvm::BasicBlock* leftBlock = builder.GetInsertBlock();
+    llvm::BasicBlock* rightBlock = llvm::BasicBlock::Create(context, isAnd ? "and.rhs" : "or.rhs", currentFunction);
+    llvm::BasicBlock* endBlock = llvm::BasicBlock::Create(context, isAnd ? "and.end" : "or.end", currentFunction);
+    if (isAnd) builder.CreateCondBr(left, rightBlock, endBlock);
+    else builder.CreateCondBr(left, endBlock, rightBlock);
+
+    builder.SetInsertPoint(rightBlock);
+    llvm::Value* right = generateCondition(node->rightOperand.get());
+    if (!right) return nullptr;
+    rightBlock = builder.GetInsertBlock();
+    builder.CreateBr(endBlock);
+
+    builder.SetInsertPoint(endBlock);
+    llvm::PHINode* result = builder.CreatePHI(builder.getInt1Ty(), 2);
+    result->addIncoming(builder.getInt1(!isAnd), leftBlock);
+    result->addIncoming(right, rightBlock);
+    return result;
+}
 
-    std::vector<llvm::Type*> parameterTypes;
-    for (const auto& parameter : node->parameters) {
-        if (parameter->parameterRawType)
-            parameterTypes.push_back(resolveType(parameter->parameterRawType->varType->varName));
-        else
-            parameterTypes.push_back(llvm::Type::getInt32Ty(context));
+llvm::Value* IRGenerator::generateOperation(const std::string& op, llvm::Value* left, llvm::Value* right, const Type* type, ASTNode* site) {
+    if (type->isPrimitive(ResolvedType::Str)) {
+        if (op == "+") {
+            std::vector<StringPiece> pieces;
+            appendValue(left, type, pieces);
+            appendValue(right, type, pieces);
+            llvm::Value* region = regionFor(site);
+            llvm::Value* string = buildString(pieces, region);
+            return region ? string : fresh(string, type);
+        }
+        if (isComparison(op)) {
+            // strings compare like their bytes do, so it's strcmp against zero
+            llvm::Value* order = builder.CreateCall(libc("strcmp", builder.getInt32Ty(), {stringType(), stringType()}), {left, right});
+            left = order;
+            right = builder.getInt32(0);
+            type = nullptr;
+        }
+    }
+    if (type && type->isPrimitive(ResolvedType::Number)) {
+        if (isComparison(op)) {
+            // the same: the order of the two, against zero
+            left = builder.CreateCall(decimals->compare(), {left, right});
+            right = builder.getInt32(0);
+            type = nullptr;
+        }
+        else if (op == "+") return fresh(keep(builder.CreateCall(decimals->add(), {left, right}), type), type);
+        else if (op == "-") return fresh(keep(builder.CreateCall(decimals->subtract(), {left, right}), type), type);
+        else if (op == "*") return fresh(keep(builder.CreateCall(decimals->multiply(), {left, right}), type), type);
+        else if (op == "/") return fresh(keep(builder.CreateCall(decimals->divide(), {left, right}), type), type);
+        else if (op == "%") return fresh(keep(builder.CreateCall(decimals->remainder(), {left, right}), type), type);
+        else {
+            unsupported(site, std::format("operator '{}' on numbers", op));
+            return nullptr;
+        }
     }
 
-    // create function
-    auto* fnType = llvm::FunctionType::get(llvm::Type::getVoidTy(context), parameterTypes, false);
-    auto* fn = llvm::Function::Create(fnType, llvm::Function::ExternalLinkage, node->name, program.get());
-    functions[node->name] = fn;
+    bool real = isReal(type);
+    bool isSigned = !isUnsigned(type);
 
-    // generate body
-    auto* entryBlock = llvm::BasicBlock::Create(context, "entry", fn);
-    builder->SetInsertPoint(entryBlock);
+    if (op == "==") return real ? builder.CreateFCmpOEQ(left, right) : builder.CreateICmpEQ(left, right);
+    if (op == "!=") return real ? builder.CreateFCmpUNE(left, right) : builder.CreateICmpNE(left, right);
+    if (op == "<") return real ? builder.CreateFCmpOLT(left, right) : isSigned ? builder.CreateICmpSLT(left, right) : builder.CreateICmpULT(left, right);
+    if (op == ">") return real ? builder.CreateFCmpOGT(left, right) : isSigned ? builder.CreateICmpSGT(left, right) : builder.CreateICmpUGT(left, right);
+    if (op == "<=") return real ? builder.CreateFCmpOLE(left, right) : isSigned ? builder.CreateICmpSLE(left, right) : builder.CreateICmpULE(left, right);
+    if (op == ">=") return real ? builder.CreateFCmpOGE(left, right) : isSigned ? builder.CreateICmpSGE(left, right) : builder.CreateICmpUGE(left, right);
 
-    pushScope();
-    auto arg = fn->arg_begin();
-    for (const auto& parameter : node->parameters)
-    {
-        arg->setName(parameter->parameterName);
-        auto* alloc = builder->CreateAlloca(arg->getType(), nullptr, parameter->parameterName);
-        builder->CreateStore(&*arg, alloc);
-        declareVariable(parameter->parameterName, alloc, arg->getType());
-        arg++;
+    if (!type || type->isPrimitive(ResolvedType::Bool)) {
+        unsupported(site, std::format("operator '{}' here", op));
+        return nullptr;
     }
-    generateStatement(node->body.get());
-    popScope();
 
-    if (!builder->GetInsertBlock()->getTerminator())
-        builder->CreateRetVoid();
+    if (op == "+") return real ? builder.CreateFAdd(left, right) : builder.CreateAdd(left, right);
+    if (op == "-") return real ? builder.CreateFSub(left, right) : builder.CreateSub(left, right);
+    if (op == "*") return real ? builder.CreateFMul(left, right) : builder.CreateMul(left, right);
+    if (op == "/") return real ? builder.CreateFDiv(left, right) : isSigned ? builder.CreateSDiv(left, right) : builder.CreateUDiv(left, right);
+    if (op == "%") return real ? builder.CreateFRem(left, right) : isSigned ? builder.CreateSRem(left, right) : builder.CreateURem(left, right);
+    if (op == "^") {
+        if (real) return builder.CreateBinaryIntrinsic(llvm::Intrinsic::pow, left, right);
+        return builder.CreateCall(powerFunction(llvm::cast<llvm::IntegerType>(left->getType()), isSigned), {left, right});
+    }
+    if (op == "&") return builder.CreateAnd(left, right);
+    if (op == "|") return builder.CreateOr(left, right);
+    if (op == "^^") return builder.CreateXor(left, right);
+    if (op == "<<") return builder.CreateShl(left, right);
+    if (op == ">>") return isSigned ? builder.CreateAShr(left, right) : builder.CreateLShr(left, right);
 
-    return fn;
+    unsupported(site, std::format("operator '{}'", op));
+    return nullptr;
 }
 
-llvm::Value* IRGenerator::generateBlock(BlockNode* node) {
-    // In LLVM, the block returns only the last statement, other statements
-    // before that are already in IR via builder.
-    llvm::Value* lastStmt = nullptr;
-    for (const auto& stmt : node->statements)
-        lastStmt = generateStatement(stmt.get());
-    return lastStmt;
+llvm::Value* IRGenerator::generateUnary(UnaryOperationNode* node) {
+    llvm::Value* operand = generateExpression(node->operand.get());
+    if (!operand) return nullptr;
+
+    // the Frontend only lets async functions await
+    const Type* operandType = valueType(node->operand.get());
+    if (node->value == "await" && coroutine && operandType && operandType->kind == Type::Kind::Task) {
+        // untyped, it's of a function that returns nothing: one that returns something untyped isn't generated
+        llvm::Type* result = node->inferredType && node->inferredType->isDynamic() ? builder.getVoidTy() : llvmType(node->inferredType);
+        if (!result) {
+            unsupported(node, std::format("awaiting tasks of '{}'", node->inferredType ? node->inferredType->toString() : "?"));
+            return nullptr;
+        }
+        return fresh(keep(executor->await(builder, *coroutine, operand, result), node->inferredType), node->inferredType);
+    }
+
+    const std::string& op = node->value;
+    if (op == "-" && operand->getType() == Decimals::numberType(context)) {
+        // the negated number shares the operand's limbs
+        llvm::Value* negated = builder.CreateCall(decimals->negate(), {operand});
+        retainValue(negated, operandType);
+        return fresh(keep(negated, operandType), operandType);
+    }
+    if (op == "-") return operand->getType()->isFloatingPointTy() ? builder.CreateFNeg(operand) : builder.CreateNeg(operand);
+    if (op == "~" || op == "!" || op == "not") return builder.CreateNot(operand);
+
+    unsupported(node, std::format("operator '{}'", op));
+    return nullptr;
 }
 
 llvm::Value* IRGenerator::generateCall(CallExpressionNode* node) {
-    auto varName = static_cast<VariableNode*>(node->callee.get())->varName;
-    auto* function = program->getFunction(varName);
-
-    // generate arguments
-    std::vector<llvm::Value*> args;
-    for (const auto& arg : node->arguments)
-        args.push_back(generateExpression(arg.get()));
-
-    // if intrinsic - handle differently
-    if (intrinsicFunctions.count(varName))
-        return generateIntrinsicCall(varName, args);
-
-    // usual call
-    return builder->CreateCall(function, args, "calltmp");
-}
-
-// all std magic happens here
-llvm::Value* IRGenerator::generateIntrinsicCall(const std::string& name, std::vector<llvm::Value*>& args) {
-
-    Intrinsic system calls list:
-    Neoluma | glibc
-    __read -> read
-    __write -> write
-    __malloc -> malloc
-    __free -> free
-    __memcpy -> memcpy
-    __memset -> memset
-    __exit -> exit
-    __panic -> not in libc, made via __panic -> fprintf(stderr) + exit(1)
-
-    auto* ptr = llvm::PointerType::getUnqual(context);
-    auto* i8  = llvm::Type::getInt8Ty(context);
-    auto* i32 = llvm::Type::getInt32Ty(context);
-    auto* i64 = llvm::Type::getInt64Ty(context);
-    auto* voidTy = llvm::Type::getVoidTy(context);
-
-    if (name == "__read") {
-        auto* fnType = llvm::FunctionType::get(i64, {i32, ptr, i64}, false);
-        auto fn = program->getOrInsertFunction("read", fnType);
-        return builder->CreateCall(fn, args);
-    }
-    if (name == "__write") {
-        auto* fnType = llvm::FunctionType::get(i64, {i32, ptr, i64}, false);
-        auto fn = program->getOrInsertFunction("write", fnType);
-        return builder->CreateCall(fn, args);
-    }
-    if (name == "__malloc") {
-        auto* fnType = llvm::FunctionType::get(ptr, {i64}, false);
-        auto fn = program->getOrInsertFunction("malloc", fnType);
-        return builder->CreateCall(fn, args);
-    }
-    if (name == "__free") {
-        auto* fnType = llvm::FunctionType::get(voidTy, {ptr}, false);
-        auto fn = program->getOrInsertFunction("free", fnType);
-        return builder->CreateCall(fn, args);
-    }
-    if (name == "__memcpy") {
-        auto* fnType = llvm::FunctionType::get(ptr, {ptr, ptr, i64}, false);
-        auto fn = program->getOrInsertFunction("memcpy", fnType);
-        return builder->CreateCall(fn, args);
-    }
-    if (name == "__memset") {
-        auto* fnType = llvm::FunctionType::get(ptr, {ptr, i8, i64}, false);
-        auto fn = program->getOrInsertFunction("memset", fnType);
-        return builder->CreateCall(fn, args);
-    }
-    if (name == "__exit") {
-        auto* fnType = llvm::FunctionType::get(voidTy, {i32}, false);
-        auto fn = program->getOrInsertFunction("exit", fnType);
-        builder->CreateCall(fn, args);
-        builder->CreateUnreachable();
+    FunctionNode* function = node->resolvedFunction;
+    if (!function) {
+        unsupported(node, "calls of values and constructors");
         return nullptr;
     }
-    if (name == "__panic") {
-        // fprintf(stderr, msg)
-        auto* fprintfType = llvm::FunctionType::get(i32, {ptr, ptr}, true);
-        auto fprintfFn = program->getOrInsertFunction("fprintf", fprintfType);
 
-        // stderr is FILE*
-        auto* stderrVar = program->getOrInsertGlobal("stderr", ptr);
-        auto* stderrVal = builder->CreateLoad(ptr, stderrVar);
+    // missing arguments are the defaults of the parameters
+    std::vector<llvm::Value*> arguments;
+    for (size_t i = 0; i < std::max(node->arguments.size(), function->parameters.size()); i++) {
+        ASTNode* argument = i < node->arguments.size() ? node->arguments[i].get() : function->parameters[i]->defaultValue.get();
+        llvm::Value* value = generateExpression(argument);
+        if (!value) return nullptr;
+        if (!function->isIntrinsic && function->inferredType && i < function->inferredType->paramCount()) {
+            const Type* type = function->inferredType->param(i);
+            value = convert(value, valueType(argument), type);
+            // a parameter that escapes takes a reference along, a task's may be counted on another thread
+            if (function->isAsync || escapes.parameterEscapes(function, i)) value = acquire(value, type);
+            if (function->isAsync) shareValue(value, type);
+        }
+        arguments.push_back(value);
+    }
 
-        builder->CreateCall(fprintfFn, {stderrVal, args[0]});
+    if (function->isIntrinsic) return generateIntrinsicCall(node, function, arguments);
 
-        // exit(1)
-        auto* exitType = llvm::FunctionType::get(voidTy, {i32}, false);
-        auto exitFn = program->getOrInsertFunction("exit", exitType);
-        builder->CreateCall(exitFn, {llvm::ConstantInt::get(i32, 1)});
+    llvm::Function* callee = declareFunction(function);
+    if (!callee) return nullptr;
+    return fresh(keep(builder.CreateCall(callee, arguments), node->inferredType), node->inferredType);
+}
 
-        builder->CreateUnreachable();
+llvm::Value* IRGenerator::generateCollection(ASTNode* node) {
+    const Type* type = node->inferredType;
+    llvm::StructType* layout = isCollection(type) ? collectionType(type) : nullptr;
+    if (!layout) {
+        unsupported(node, std::format("values of type '{}'", type ? type->toString() : "?"));
         return nullptr;
     }
 
-    return nullptr;
+    // the elements come first, a collection is only made once they all could be
+    std::vector<std::pair<llvm::Value*, llvm::Value*>> elements; // a key and its value for dicts
+    auto element = [&](ASTNode* element, const Type* to) { return acquire(convert(generateExpression(element), valueType(element), to), to); };
+    if (match(node, ASTNodeType::Dict)) {
+        for (auto& [key, value] : static_cast<DictNode*>(node)->elements) {
+            elements.emplace_back(element(key.get(), type->components[0]), element(value.get(), type->components[1]));
+            if (!elements.back().first || !elements.back().second) return nullptr;
+        }
+    }
+    else {
+        for (auto& value : match(node, ASTNodeType::Array) ? static_cast<ArrayNode*>(node)->elements : static_cast<SetNode*>(node)->elements) {
+            elements.emplace_back(element(value.get(), type->element()), nullptr);
+            if (!elements.back().first) return nullptr;
+        }
+    }
+
+    llvm::Value* count = builder.getInt64(elements.size());
+    if (type->kind == Type::Kind::Array) {
+        llvm::Value* array = builder.CreateCall(collections->arrayNew(layout), {count});
+        Collections::Element stored = *collectionElement(type->element());
+        for (size_t i = 0; i < elements.size(); i++)
+            builder.CreateStore(collections->stored(builder, elements[i].first, stored), collections->element(builder, layout, array, builder.getInt64(i)));
+        return fresh(keep(array, type), type);
+    }
+
+    llvm::Value* table = keep(builder.CreateCall(collections->tableNew(layout), {count}), type);
+    for (const auto& [key, value] : elements) {
+        llvm::Value* slot = builder.CreateCall(collections->tableInsert(layout), {table, key});
+        if (!value) continue;
+        // a key given twice keeps the last value
+        llvm::Value* pointer = collections->value(builder, layout, table, slot);
+        llvm::Value* old = isCounted(type->components[1]) ? builder.CreateLoad(value->getType(), pointer) : nullptr;
+        builder.CreateStore(collections->stored(builder, value, *collectionElement(type->components[1])), pointer);
+        if (old) releaseValue(old, type->components[1]);
+    }
+    return fresh(table, type);
 }
 
-llvm::Value* IRGenerator::generateBreak() {
-    builder->CreateBr(currentBreakBB);
+llvm::Value* IRGenerator::generateMethod(MemberAccessNode* node) {
+    const Type* type = node->parent->inferredType;
+    llvm::StructType* layout = collectionType(type);
+    if (!layout) {
+        unsupported(node, std::format("values of type '{}'", type->toString()));
+        return nullptr;
+    }
+
+    std::string name = memberName(node);
+    std::vector<ASTNode*> arguments;
+    if (match(node->val.get(), ASTNodeType::CallExpression))
+        for (auto& argument : static_cast<CallExpressionNode*>(node->val.get())->arguments) arguments.push_back(argument.get());
+
+    // the Frontend checked the arguments against the same signatures
+    llvm::Value* collection = generateExpression(node->parent.get());
+    if (!collection) return nullptr;
+    std::vector<llvm::Value*> values;
+    auto argument = [&](size_t i, const Type* to) {
+        llvm::Value* value = convert(generateExpression(arguments[i]), valueType(arguments[i]), to);
+        if (value) values.push_back(value);
+        return value != nullptr;
+    };
+    auto index = [&](llvm::Value* value) { return builder.CreateSExtOrTrunc(value, builder.getInt64Ty()); }; // an int, nothing to convert
+    size_t count = arguments.size();
+
+    if ((name == "length" || name == "size") && count == 0) return builder.CreateTrunc(collections->length(builder, collection), builder.getInt32Ty());
+
+    if (type->kind == Type::Kind::Array) {
+        const Type* element = type->element();
+        // what goes in is handed over with a reference, what comes out gets one of its own
+        if ((name == "push" || name == "append") && count == 1) {
+            if (!argument(0, element)) return nullptr;
+            return builder.CreateCall(collections->arrayPush(layout), {collection, acquire(values[0], element)});
+        }
+        if (name == "get" && count == 1) {
+            if (!argument(0, nullptr)) return nullptr;
+            llvm::Value* value = builder.CreateCall(collections->arrayGet(layout), {collection, index(values[0])});
+            retainValue(value, element);
+            return fresh(value, element);
+        }
+        if (name == "set" && count == 2) {
+            if (!argument(0, nullptr) || !argument(1, element)) return nullptr;
+            return builder.CreateCall(collections->arraySet(layout), {collection, index(values[0]), acquire(values[1], element)});
+        }
+    }
+    else {
+        const Type* key = type->components[0];
+        bool isDict = type->kind == Type::Kind::Dict;
+        if ((name == "contains" || name == "has") && count == 1) {
+            if (!argument(0, key)) return nullptr;
+            return builder.CreateICmpSGE(builder.CreateCall(collections->tableFind(layout), {collection, values[0]}), builder.getInt64(0));
+        }
+        if (name == "remove" && count == 1) {
+            if (!argument(0, key)) return nullptr;
+            return builder.CreateCall(collections->tableRemove(layout), {collection, values[0]});
+        }
+        if (!isDict && (name == "add" || name == "insert") && count == 1) {
+            if (!argument(0, key)) return nullptr;
+            return builder.CreateCall(collections->tableInsert(layout), {collection, acquire(values[0], key)});
+        }
+        if (isDict && name == "set" && count == 2) {
+            const Type* value = type->components[1];
+            if (!argument(0, key) || !argument(1, value)) return nullptr;
+            llvm::Value* slot = builder.CreateCall(collections->tableInsert(layout), {collection, acquire(values[0], key)});
+            llvm::Value* pointer = collections->value(builder, layout, collection, slot);
+            llvm::Value* old = isCounted(value) ? builder.CreateLoad(values[1]->getType(), pointer) : nullptr;
+            llvm::Value* stored = builder.CreateStore(collections->stored(builder, acquire(values[1], value), *collectionElement(value), collection), pointer);
+            if (old) releaseValue(old, value);
+            return stored;
+        }
+        if (isDict && name == "get" && count == 1) {
+            if (!argument(0, key)) return nullptr;
+            // `V?` in NIR; natively there's no null to give back, a missing key stops the program
+            llvm::Value* slot = builder.CreateCall(collections->tableFind(layout), {collection, values[0]});
+            llvm::BasicBlock* missingBlock = llvm::BasicBlock::Create(context, "dict.missing", currentFunction);
+            llvm::BasicBlock* foundBlock = llvm::BasicBlock::Create(context, "dict.found", currentFunction);
+            builder.CreateCondBr(builder.CreateICmpSLT(slot, builder.getInt64(0)), missingBlock, foundBlock);
+            builder.SetInsertPoint(missingBlock);
+            builder.CreateCall(collections->missingKey());
+            builder.CreateUnreachable();
+            builder.SetInsertPoint(foundBlock);
+            llvm::Value* value = builder.CreateLoad(llvmType(type->components[1]), collections->value(builder, layout, collection, slot));
+            retainValue(value, type->components[1]);
+            return fresh(value, type->components[1]);
+        }
+    }
+
+    unsupported(node, std::format("'{}' of '{}'", name, type->toString()));
     return nullptr;
 }
 
-llvm::Value* IRGenerator::generateContinue() {
-    builder->CreateBr(currentContinueBB);
+llvm::Value* IRGenerator::generateIntrinsicCall(CallExpressionNode* node, FunctionNode* function, std::vector<llvm::Value*>& arguments) {
+    // intrinsics are told apart by the std namespace they're declared in, not by the file that happens to hold it
+    const std::string& library = function->namespaceName;
+    const std::string& name = function->name;
+
+    if (library == "std.io") {
+        if (name == "print" || name == "println" || name == "eprint" || name == "eprintln") {
+            std::string format;
+            std::vector<llvm::Value*> values;
+            if (!arguments.empty()) {
+                const Type* type = valueType(node->arguments[0].get());
+                llvm::Value* value = formatValue(arguments[0], type, format);
+                if (!value) {
+                    unsupported(node->arguments[0].get(), std::format("printing values of type '{}'", type ? type->toString() : "?"));
+                    return nullptr;
+                }
+                releaseOperand(node->arguments[0].get(), arguments[0]);
+                values.push_back(value);
+            }
+            if (name.ends_with("ln")) format += '\n';
+
+            values.insert(values.begin(), stringConstant(format));
+            if (name.starts_with("e")) {
+                values.insert(values.begin(), standardStream(2));
+                return builder.CreateCall(libc("fprintf", builder.getInt32Ty(), {stringType(), stringType()}, true), values);
+            }
+            return builder.CreateCall(libc("printf", builder.getInt32Ty(), {stringType()}, true), values);
+        }
+        if (name == "input" || name == "readLine") {
+            if (!arguments.empty()) {
+                builder.CreateCall(libc("printf", builder.getInt32Ty(), {stringType()}, true), {stringConstant("%s"), arguments[0]});
+                builder.CreateCall(libc("fflush", builder.getInt32Ty(), {stringType()}), {llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(stringType()))});
+            }
+            return fresh(keep(builder.CreateCall(readLineFunction())), node->inferredType);
+        }
+    }
+
+    if (library == "std.iter" && name == "range" && !arguments.empty()) {
+        // range(stop), range(start, stop) or range(start, stop, step): nothing is computed before a loop asks
+        std::vector<llvm::Value*> bounds;
+        for (llvm::Value* argument : arguments) bounds.push_back(builder.CreateSExt(argument, builder.getInt64Ty()));
+        if (bounds.size() == 1) bounds.insert(bounds.begin(), builder.getInt64(0));
+        if (bounds.size() == 2) bounds.push_back(builder.getInt64(1));
+        llvm::Value* range = llvm::UndefValue::get(rangeType());
+        for (unsigned i = 0; i < 3; i++) range = builder.CreateInsertValue(range, bounds[i], i);
+        return range;
+    }
+
+    if (library == "std.math" && !arguments.empty()) {
+        bool real = arguments[0]->getType()->isFloatingPointTy();
+        if (name == "abs") return real ? builder.CreateUnaryIntrinsic(llvm::Intrinsic::fabs, arguments[0]) : builder.CreateBinaryIntrinsic(llvm::Intrinsic::abs, arguments[0], builder.getFalse());
+        if (name == "min" && arguments.size() == 2) return builder.CreateBinaryIntrinsic(real ? llvm::Intrinsic::minnum : llvm::Intrinsic::smin, arguments[0], arguments[1]);
+        if (name == "max" && arguments.size() == 2) return builder.CreateBinaryIntrinsic(real ? llvm::Intrinsic::maxnum : llvm::Intrinsic::smax, arguments[0], arguments[1]);
+        if (name == "clamp" && arguments.size() == 3) {
+            // like the compile-time version: an upper bound below the lower one is the lower one
+            llvm::Intrinsic::ID min = real ? llvm::Intrinsic::minnum : llvm::Intrinsic::smin;
+            llvm::Intrinsic::ID max = real ? llvm::Intrinsic::maxnum : llvm::Intrinsic::smax;
+            llvm::Value* upper = builder.CreateBinaryIntrinsic(max, arguments[1], arguments[2]);
+            return builder.CreateBinaryIntrinsic(min, builder.CreateBinaryIntrinsic(max, arguments[0], arguments[1]), upper);
+        }
+        if (real) {
+            if (name == "sqrt") return builder.CreateUnaryIntrinsic(llvm::Intrinsic::sqrt, arguments[0]);
+            if (name == "floor") return builder.CreateUnaryIntrinsic(llvm::Intrinsic::floor, arguments[0]);
+            if (name == "ceil") return builder.CreateUnaryIntrinsic(llvm::Intrinsic::ceil, arguments[0]);
+            if (name == "round") return builder.CreateUnaryIntrinsic(llvm::Intrinsic::round, arguments[0]);
+            if (name == "sin") return builder.CreateUnaryIntrinsic(llvm::Intrinsic::sin, arguments[0]);
+            if (name == "cos") return builder.CreateUnaryIntrinsic(llvm::Intrinsic::cos, arguments[0]);
+            if (name == "tan") return builder.CreateCall(libc("tanf", builder.getFloatTy(), {builder.getFloatTy()}), {arguments[0]});
+            if (name == "pow" && arguments.size() == 2) return builder.CreateBinaryIntrinsic(llvm::Intrinsic::pow, arguments[0], arguments[1]);
+        }
+    }
+
+    // these block the thread calling them, the *Async ones below don't
+    if (library == "std.time" && name == "sleepMs" && arguments.size() == 1) return builder.CreateCall(sleepFunction(), arguments);
+    if (library == "std.fs") {
+        if (name == "readText" && arguments.size() == 1) return fresh(keep(builder.CreateCall(readTextFunction(), arguments)), node->inferredType);
+        if (name == "writeText" && arguments.size() == 2) return builder.CreateCall(writeTextFunction(), arguments);
+    }
+
+    // tasks of the Executor: waiting and I/O suspend only the coroutine that awaits them
+    if (executor && library == "std.time" && name == "sleepMsAsync" && arguments.size() == 1) return builder.CreateCall(executor->sleepAsync(), arguments);
+    if (executor && library == "std.fs") {
+        if (name == "readTextAsync" && arguments.size() == 1) return builder.CreateCall(executor->readTextAsync(collector ? collector->staticHeader() : nullptr, counter ? counter->allocate() : nullptr), arguments);
+        if (name == "writeTextAsync" && arguments.size() == 2) return builder.CreateCall(executor->writeTextAsync(), arguments);
+    }
+
+    unsupported(node, std::format("'{}.{}'", library, name));
     return nullptr;
 }
 
-llvm::Value* IRGenerator::generateReturn(ReturnStatementNode* node) {
-    if (node->expression) {
-        auto val = generateExpression(node->expression.get());
-        builder->CreateRet(val);
+// ==== Strings ====
+
+bool IRGenerator::appendPieces(ASTNode* node, std::vector<StringPiece>& pieces) {
+    if (match(node, ASTNodeType::BinaryOperation) && node->value == "+") {
+        auto* binary = static_cast<BinaryOperationNode*>(node);
+        const Type* type = valueType(binary->leftOperand.get());
+        if (type && type->isPrimitive(ResolvedType::Str)) return appendPieces(binary->leftOperand.get(), pieces) && appendPieces(binary->rightOperand.get(), pieces);
     }
-    else builder->CreateRetVoid();
-    return nullptr;
+    if (match(node, ASTNodeType::Literal) && static_cast<LiteralNode*>(node)->literalType == ASTLiteralType::String) {
+        auto* literal = static_cast<LiteralNode*>(node);
+        if (literal->isInterpolation()) return appendInterpolation(literal, pieces);
+        // its length is known here, nothing measures it
+        if (!literal->value.empty()) pieces.push_back({stringConstant(literal->value), llvm::ConstantInt::get(sizeType(), literal->value.size())});
+        return true;
+    }
+
+    llvm::Value* value = generateExpression(node);
+    if (!value) return false;
+    if (!appendValue(value, valueType(node), pieces)) {
+        const Type* type = valueType(node);
+        unsupported(node, std::format("formatting values of type '{}'", type ? type->toString() : "?"));
+        return false;
+    }
+    releaseOperand(node, value);
+    return true;
 }
 
-llvm::Value* IRGenerator::generateThrow(ThrowStatementNode* node) {
-    generateExpression(node->expression.get());
-    builder->CreateUnreachable(); // this is pain in the ass to make im skipping ts
-    return nullptr;
+bool IRGenerator::appendInterpolation(LiteralNode* node, std::vector<StringPiece>& pieces) {
+    auto text = [&](const std::string& piece) {
+        if (!piece.empty()) pieces.push_back({stringConstant(piece), llvm::ConstantInt::get(sizeType(), piece.size())});
+    };
+    for (size_t i = 0; i < node->interpolations.size(); i++) {
+        text(node->pieces[i]);
+        // formatted in place, `${a + b}` on strings adds its pieces to these ones
+        if (!appendPieces(node->interpolations[i].get(), pieces)) return false;
+    }
+    text(node->pieces.back());
+    return true;
 }
 
-llvm::Type* IRGenerator::resolveType(const std::string& typeName) {
-    auto tm = getTypeNames();
+bool IRGenerator::appendValue(llvm::Value* value, const Type* type, std::vector<StringPiece>& pieces) {
+    if (!type || type->kind != Type::Kind::Primitive) return false;
 
-    if (typeName == tm[ResolvedType::Int8]) return llvm::Type::getInt8Ty(context);
-    if (typeName == tm[ResolvedType::Int16]) return llvm::Type::getInt16Ty(context);
-    if (typeName == tm[ResolvedType::Int]) return llvm::Type::getInt32Ty(context);
-    if (typeName == tm[ResolvedType::Int64]) return llvm::Type::getInt64Ty(context);
-    if (typeName == tm[ResolvedType::Int128]) return llvm::Type::getInt128Ty(context);
-    if (typeName == tm[ResolvedType::Bool]) return llvm::Type::getInt1Ty(context);
-    if (typeName == tm[ResolvedType::Float]) return llvm::Type::getFloatTy(context);
-    if (typeName == tm[ResolvedType::Float64]) return llvm::Type::getDoubleTy(context);
-    if (typeName == tm[ResolvedType::Void]) return llvm::Type::getVoidTy(context);
-    if (typeName == tm[ResolvedType::Str]) return llvm::Type::getInt8Ty(context)->getPointerTo(0);
-    if (typeName == tm[ResolvedType::Bool]) return llvm::Type::getInt1Ty(context);
+    // numbers are formatted into a buffer of the frame, only their digits are copied
+    auto buffer = [&](uint64_t size) {
+        llvm::ArrayType* type = llvm::ArrayType::get(builder.getInt8Ty(), size);
+        return builder.CreateConstInBoundsGEP2_32(type, createSlot(type, "digits"), 0, 0);
+    };
+    auto integer = [&](bool isSigned) {
+        llvm::Value* data = buffer(24);
+        llvm::Value* wide = isSigned ? builder.CreateSExt(value, builder.getInt64Ty()) : builder.CreateZExt(value, builder.getInt64Ty());
+        llvm::Value* length = builder.CreateCall(formatIntegerFunction(), {data, wide, builder.getInt1(isSigned)});
+        pieces.push_back({data, builder.CreateZExtOrTrunc(length, sizeType())});
+        return true;
+    };
+    auto real = [&](const char* format) {
+        // %.15g of a double takes at most 23 characters
+        llvm::Value* data = buffer(32);
+        llvm::Value* wide = value->getType()->isDoubleTy() ? value : builder.CreateFPExt(value, builder.getDoubleTy());
+        llvm::FunctionCallee snprintf = libc("snprintf", builder.getInt32Ty(), {stringType(), sizeType(), stringType()}, true);
+        llvm::Value* length = builder.CreateCall(snprintf, {data, llvm::ConstantInt::get(sizeType(), 32), stringConstant(format), wide});
+        pieces.push_back({data, builder.CreateZExt(length, sizeType())});
+        return true;
+    };
+    auto decimal = [&] {
+        // a number with limbs may not fit, then it's malloc'd
+        llvm::Value* text = builder.CreateCall(decimals->format(), {value, buffer(Decimals::FormatBuffer), builder.getInt64(Decimals::FormatBuffer)});
+        pieces.push_back({builder.CreateExtractValue(text, 0), builder.CreateZExtOrTrunc(builder.CreateExtractValue(text, 1), sizeType())});
+        return true;
+    };
 
-    // fixme: address the pointer of str and class
-    for (const auto& classType : classTypes)
-        if (typeName == classType.first) return llvm::TypedPointerType::get(classType.second, 0);
+    switch (type->primitive) {
+        case ResolvedType::Str:
+            pieces.push_back({value, builder.CreateCall(libc("strlen", sizeType(), {stringType()}), {value})});
+            return true;
+        case ResolvedType::Bool:
+            pieces.push_back({builder.CreateSelect(value, stringConstant("true"), stringConstant("false")),
+                builder.CreateSelect(value, llvm::ConstantInt::get(sizeType(), 4), llvm::ConstantInt::get(sizeType(), 5))});
+            return true;
+        case ResolvedType::Int8: case ResolvedType::Int16: case ResolvedType::Int: case ResolvedType::Int64: return integer(true);
+        case ResolvedType::UInt8: case ResolvedType::UInt16: case ResolvedType::UInt: case ResolvedType::UInt64: return integer(false);
+        case ResolvedType::Float: return real("%g");
+        case ResolvedType::Float64: return real("%.15g");
+        case ResolvedType::Number: return decimal();
+        default: return false; // 128-bit integers aren't formatted yet
+    }
+}
 
-    return llvm::Type::getInt8Ty(context); // default
+llvm::Value* IRGenerator::buildString(const std::vector<StringPiece>& pieces, llvm::Value* region) {
+    // lengths of literals are constants, so a piece of text costs a memcpy of a known size
+    llvm::Value* length = llvm::ConstantInt::get(sizeType(), 0);
+    for (const StringPiece& piece : pieces) length = builder.CreateAdd(length, piece.length);
+    auto copy = [&](llvm::Value* buffer) {
+        llvm::Value* offset = llvm::ConstantInt::get(sizeType(), 0);
+        for (const StringPiece& piece : pieces) {
+            builder.CreateMemCpy(builder.CreateInBoundsGEP(builder.getInt8Ty(), buffer, offset), llvm::MaybeAlign(1), piece.data, llvm::MaybeAlign(1), piece.length);
+            offset = builder.CreateAdd(offset, piece.length);
+        }
+    };
+    // the character, or the terminator of an empty string, picks the static one
+    auto shortString = [&] {
+        llvm::ArrayType* type = llvm::ArrayType::get(builder.getInt8Ty(), 2);
+        llvm::Value* character = builder.CreateConstInBoundsGEP2_32(type, createSlot(type, "character"), 0, 0);
+        builder.CreateStore(builder.getInt8(0), character);
+        copy(character);
+        llvm::Constant* table = shortStrings();
+        llvm::Value* index = builder.CreateZExt(builder.CreateLoad(builder.getInt8Ty(), character), builder.getInt64Ty());
+        return builder.CreateInBoundsGEP(llvm::cast<llvm::GlobalVariable>(table)->getValueType(), table, {builder.getInt64(0), index, builder.getInt32(1), builder.getInt64(0)});
+    };
+    auto heapString = [&] {
+        llvm::Value* buffer = allocateString(builder, builder.CreateAdd(length, llvm::ConstantInt::get(sizeType(), 1)), region);
+        copy(buffer);
+        builder.CreateStore(builder.getInt8(0), builder.CreateInBoundsGEP(builder.getInt8Ty(), buffer, length));
+        return region ? buffer : keep(buffer);
+    };
+
+    if (auto* known = llvm::dyn_cast<llvm::ConstantInt>(length)) return known->getZExtValue() > 1 ? heapString() : shortString();
+    llvm::BasicBlock* shortBlock = llvm::BasicBlock::Create(context, "str.short", currentFunction);
+    llvm::BasicBlock* heapBlock = llvm::BasicBlock::Create(context, "str.heap", currentFunction);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "str.done", currentFunction);
+    builder.CreateCondBr(builder.CreateICmpULE(length, llvm::ConstantInt::get(sizeType(), 1)), shortBlock, heapBlock);
+
+    builder.SetInsertPoint(shortBlock);
+    llvm::Value* fromTable = shortString();
+    llvm::BasicBlock* shortEnd = builder.GetInsertBlock();
+    builder.CreateBr(done);
+    builder.SetInsertPoint(heapBlock);
+    llvm::Value* fromHeap = heapString();
+    llvm::BasicBlock* heapEnd = builder.GetInsertBlock();
+    builder.CreateBr(done);
+
+    builder.SetInsertPoint(done);
+    llvm::PHINode* string = builder.CreatePHI(stringType(), 2);
+    string->addIncoming(fromTable, shortEnd);
+    string->addIncoming(fromHeap, heapEnd);
+    return string;
 }
 
-void IRGenerator::pushScope() { scopes.emplace_back(); }
+void IRGenerator::appendString(const Appending& appended, llvm::Value* local, const std::vector<StringPiece>& pieces) {
+    llvm::Value* length = builder.CreateLoad(sizeType(), appended.length);
+    llvm::Value* needed = length;
+    for (const StringPiece& piece : pieces) needed = builder.CreateAdd(needed, piece.length);
+
+    // the buffer doubles, so growing is rare
+    llvm::BasicBlock* grow = llvm::BasicBlock::Create(context, "append.grow", currentFunction);
+    llvm::BasicBlock* copy = llvm::BasicBlock::Create(context, "append.copy", currentFunction);
+    llvm::Value* full = builder.CreateICmpUGT(needed, builder.CreateLoad(sizeType(), appended.capacity));
+    builder.CreateCondBr(full, grow, copy, llvm::MDBuilder(context).createBranchWeights(1, 64));
+
+    builder.SetInsertPoint(grow);
+    builder.CreateCall(reserveFunction(), {appended.buffer, appended.capacity, builder.CreateLoad(stringType(), local), length, needed});
+    builder.CreateBr(copy);
+
+    builder.SetInsertPoint(copy);
+    llvm::Value* buffer = builder.CreateLoad(stringType(), appended.buffer);
+    llvm::Value* offset = length;
+    for (const StringPiece& piece : pieces) {
+        builder.CreateMemCpy(builder.CreateInBoundsGEP(builder.getInt8Ty(), buffer, offset), llvm::MaybeAlign(1), piece.data, llvm::MaybeAlign(1), piece.length);
+        offset = builder.CreateAdd(offset, piece.length);
+    }
+    builder.CreateStore(needed, appended.length);
+}
 
-void IRGenerator::popScope() { if (!scopes.empty()) scopes.pop_back(); }
+// ==== Iterators ====
 
-void IRGenerator::declareVariable(const std::string& name, llvm::Value* value, llvm::Type* type) {
-    if (scopes.empty()) pushScope();
-    scopes.back()[name] = value;
-    variableTypes[name] = type;
+std::optional<IRGenerator::Iterator> IRGenerator::openIterator(ASTNode* node, const ASTNode* consumer) {
+    const Type* type = node->inferredType;
+    if (isCollection(type)) {
+        llvm::StructType* layout = collectionType(type);
+        if (!layout) {
+            unsupported(node, std::format("values of type '{}'", type->toString()));
+            return std::nullopt;
+        }
+        llvm::Value* collection = generateExpression(node);
+        if (!collection) return std::nullopt;
+        // with ARC a loop that may drop what's in the collection holds the collection and every element it gives
+        bool owned = counter && !escapes.isStable(consumer);
+        if (owned) {
+            retainValue(collection, type);
+            fresh(collection, type);
+        }
+        return collectionIterator(collection, type, layout, owned);
+    }
+    if (!type || type->kind != Type::Kind::Iterator) {
+        unsupported(node, std::format("for loops over '{}'", type ? type->toString() : "?"));
+        return std::nullopt;
+    }
+    llvm::Type* element = llvmType(type->element());
+    if (!element || element->isVoidTy()) {
+        unsupported(node, std::format("iterators of '{}'", type->element()->toString()));
+        return std::nullopt;
+    }
+
+    // a range is a value, `iter.range(10)` or a variable holding one. The rest are stages on top of another iterator.
+    auto* access = match(node, ASTNodeType::MemberAccess) ? static_cast<MemberAccessNode*>(node) : nullptr;
+    auto* call = access && match(access->val.get(), ASTNodeType::CallExpression) ? static_cast<CallExpressionNode*>(access->val.get()) : nullptr;
+    if (!call || call->resolvedFunction) {
+        llvm::Value* range = generateExpression(node);
+        if (!range) return std::nullopt;
+        return rangeIterator(range, type->element());
+    }
+
+    std::string name = memberName(access);
+    if (name == "iter") return openIterator(access->parent.get(), consumer);
+    std::optional<Iterator> parent = openIterator(access->parent.get(), consumer);
+    if (!parent) return std::nullopt;
+    const Type* from = access->parent->inferredType->element();
+    ASTNode* argument = call->arguments.empty() ? nullptr : call->arguments[0].get();
+
+    // the callbacks borrow what they're given, an element that came with a reference is dropped once it's mapped or
+    // filtered out
+    if (name == "map" && argument)
+        return Iterator{[=, this](llvm::BasicBlock* exhausted) -> llvm::Value* {
+            llvm::Value* value = parent->next(exhausted);
+            llvm::Value* mapped = value ? generateCallback(argument, {value}, {from}) : nullptr;
+            if (mapped && parent->owned) releaseValue(value, from);
+            return mapped;
+        }, isCounted(type->element())};
+    if (name == "filter" && argument)
+        return Iterator{[=, this](llvm::BasicBlock* exhausted) -> llvm::Value* {
+            // pulls until one passes
+            llvm::BasicBlock* scanBlock = llvm::BasicBlock::Create(context, "filter.scan", currentFunction);
+            builder.CreateBr(scanBlock);
+            builder.SetInsertPoint(scanBlock);
+            llvm::Value* value = parent->next(exhausted);
+            llvm::Value* passes = value ? generateCallback(argument, {value}, {from}) : nullptr;
+            if (!passes) return nullptr;
+            llvm::BasicBlock* passBlock = llvm::BasicBlock::Create(context, "filter.pass", currentFunction);
+            llvm::BasicBlock* rejectBlock = parent->owned ? llvm::BasicBlock::Create(context, "filter.reject", currentFunction) : scanBlock;
+            builder.CreateCondBr(passes, passBlock, rejectBlock);
+            if (parent->owned) {
+                builder.SetInsertPoint(rejectBlock);
+                releaseValue(value, from);
+                builder.CreateBr(scanBlock);
+            }
+            builder.SetInsertPoint(passBlock);
+            return value;
+        }, parent->owned};
+    if (name == "take" && argument) {
+        // the count is read once, when the pipeline is set up
+        llvm::Value* count = generateExpression(argument);
+        if (!count) return std::nullopt;
+        llvm::AllocaInst* remaining = createSlot(builder.getInt64Ty(), "take.remaining");
+        builder.CreateStore(builder.CreateSExtOrTrunc(count, builder.getInt64Ty()), remaining);
+        return Iterator{[=, this](llvm::BasicBlock* exhausted) -> llvm::Value* {
+            llvm::Value* left = builder.CreateLoad(builder.getInt64Ty(), remaining);
+            llvm::BasicBlock* pullBlock = llvm::BasicBlock::Create(context, "take.pull", currentFunction);
+            builder.CreateCondBr(builder.CreateICmpSGT(left, builder.getInt64(0)), pullBlock, exhausted);
+            builder.SetInsertPoint(pullBlock);
+            builder.CreateStore(builder.CreateSub(left, builder.getInt64(1)), remaining);
+            return parent->next(exhausted);
+        }, parent->owned};
+    }
+    if (name == "enumerate") {
+        llvm::AllocaInst* position = createSlot(builder.getInt64Ty(), "enumerate.index");
+        builder.CreateStore(builder.getInt64(0), position);
+        llvm::Type* indexType = llvmType(type->element()->components[0]);
+        return Iterator{[=, this](llvm::BasicBlock* exhausted) -> llvm::Value* {
+            llvm::Value* value = parent->next(exhausted);
+            if (!value) return nullptr;
+            llvm::Value* index = builder.CreateLoad(builder.getInt64Ty(), position);
+            builder.CreateStore(builder.CreateNUWAdd(index, builder.getInt64(1)), position);
+            llvm::Value* pair = builder.CreateInsertValue(llvm::UndefValue::get(element), builder.CreateTrunc(index, indexType), 0);
+            return builder.CreateInsertValue(pair, value, 1);
+        }, parent->owned};
+    }
+    if (name == "zip" && argument) {
+        // ends with the shorter one
+        std::optional<Iterator> other = openIterator(argument, consumer);
+        if (!other) return std::nullopt;
+        // the pair either comes with a reference to both or to neither
+        const Type* firstType = type->element()->components[0];
+        const Type* secondType = type->element()->components[1];
+        bool owned = parent->owned || other->owned;
+        return Iterator{[=, this](llvm::BasicBlock* exhausted) -> llvm::Value* {
+            llvm::Value* first = parent->next(exhausted);
+            if (!first) return nullptr;
+            llvm::BasicBlock* dropBlock = parent->owned ? llvm::BasicBlock::Create(context, "zip.drop", currentFunction) : exhausted;
+            llvm::Value* second = other->next(dropBlock);
+            if (!second) return nullptr;
+            if (parent->owned) {
+                llvm::BasicBlock* pulled = builder.GetInsertBlock();
+                builder.SetInsertPoint(dropBlock);
+                releaseValue(first, firstType);
+                builder.CreateBr(exhausted);
+                builder.SetInsertPoint(pulled);
+            }
+            if (owned && !parent->owned) retainValue(first, firstType);
+            if (owned && !other->owned) retainValue(second, secondType);
+            return builder.CreateInsertValue(builder.CreateInsertValue(llvm::UndefValue::get(element), first, 0), second, 1);
+        }, owned};
+    }
+
+    unsupported(node, std::format("'{}' of '{}'", name, access->parent->inferredType->toString()));
+    return std::nullopt;
 }
 
-llvm::Value* IRGenerator::findVariable(const std::string& name) {
-    for (int i = (int)scopes.size()-1; i >= 0; i--) if (scopes[i].count(name)) return scopes[i][name];
-    return nullptr;
+IRGenerator::Iterator IRGenerator::rangeIterator(llvm::Value* range, const Type* element) {
+    // counted once up front, which leaves LLVM a loop with a known trip count to unroll and vectorize
+    llvm::Value* count = rangeCount(range);
+    llvm::AllocaInst* position = createSlot(builder.getInt64Ty(), "range.index");
+    builder.CreateStore(builder.getInt64(0), position);
+    llvm::Type* type = llvmType(element);
+    return Iterator{[=, this](llvm::BasicBlock* exhausted) -> llvm::Value* {
+        llvm::Value* index = builder.CreateLoad(builder.getInt64Ty(), position);
+        llvm::BasicBlock* pullBlock = llvm::BasicBlock::Create(context, "range.pull", currentFunction);
+        builder.CreateCondBr(builder.CreateICmpULT(index, count), pullBlock, exhausted);
+        builder.SetInsertPoint(pullBlock);
+        builder.CreateStore(builder.CreateNUWAdd(index, builder.getInt64(1)), position);
+        llvm::Value* offset = builder.CreateMul(index, builder.CreateExtractValue(range, 2));
+        return builder.CreateTrunc(builder.CreateAdd(builder.CreateExtractValue(range, 0), offset), type);
+    }};
+}
+
+IRGenerator::Iterator IRGenerator::collectionIterator(llvm::Value* collection, const Type* type, llvm::StructType* layout, bool owned) {
+    // an index through an array, or a slot through a table, skipping the ones without a key. Whoever pulls may change
+    // the collection in between, so its length and buffers are read again every time. Sets and dicts give their keys.
+    llvm::AllocaInst* position = createSlot(builder.getInt64Ty(), "iter.index");
+    builder.CreateStore(builder.getInt64(0), position);
+    bool isArray = type->kind == Type::Kind::Array;
+    llvm::Type* element = llvmType(type->components[0]);
+    return Iterator{[=, this](llvm::BasicBlock* exhausted) -> llvm::Value* {
+        llvm::BasicBlock* scanBlock = llvm::BasicBlock::Create(context, "iter.scan", currentFunction);
+        llvm::BasicBlock* checkBlock = isArray ? nullptr : llvm::BasicBlock::Create(context, "iter.check", currentFunction);
+        llvm::BasicBlock* pullBlock = llvm::BasicBlock::Create(context, "iter.pull", currentFunction);
+        builder.CreateBr(scanBlock);
+
+        builder.SetInsertPoint(scanBlock);
+        llvm::Value* index = builder.CreateLoad(builder.getInt64Ty(), position);
+        llvm::Value* bound = isArray ? collections->length(builder, collection) : collections->capacity(builder, layout, collection);
+        builder.CreateCondBr(builder.CreateICmpULT(index, bound), checkBlock ? checkBlock : pullBlock, exhausted);
+        if (checkBlock) {
+            builder.SetInsertPoint(checkBlock);
+            builder.CreateStore(builder.CreateNUWAdd(index, builder.getInt64(1)), position);
+            builder.CreateCondBr(collections->isFull(builder, layout, collection, index), pullBlock, scanBlock);
+        }
+
+        builder.SetInsertPoint(pullBlock);
+        if (isArray) builder.CreateStore(builder.CreateNUWAdd(index, builder.getInt64(1)), position);
+        llvm::Value* address = isArray ? collections->element(builder, layout, collection, index) : collections->key(builder, layout, collection, index);
+        llvm::Value* value = builder.CreateLoad(element, address);
+        if (owned) retainValue(value, type->components[0]);
+        return value;
+    }, owned};
 }
 
-std::string IRGenerator::getRootVarName(ASTNode* node) {
-    if (node->type == ASTNodeType::Variable)
-        return static_cast<VariableNode*>(node)->varName;
-    if (node->type == ASTNodeType::MemberAccess)
-        return getRootVarName(static_cast<MemberAccessNode*>(node)->parent.get());
-    return "";
+llvm::Value* IRGenerator::generateCallback(ASTNode* callback, const std::vector<llvm::Value*>& arguments, const std::vector<const Type*>& types) {
+    const Type* type = callback->inferredType;
+    if (!type || type->kind != Type::Kind::Function || type->paramCount() != arguments.size()) {
+        unsupported(callback, "untyped callbacks");
+        return nullptr;
+    }
+
+    // a function is called
+    if (match(callback, ASTNodeType::Variable)) {
+        auto* variable = static_cast<VariableNode*>(callback);
+        FunctionNode* function = findFunction(variable->varName, variable->filePath, type);
+        llvm::Function* callee = function ? declareFunction(function) : nullptr;
+        if (!callee) {
+            unsupported(callback, "callbacks of this function");
+            return nullptr;
+        }
+        std::vector<llvm::Value*> values;
+        for (size_t i = 0; i < arguments.size(); i++) {
+            values.push_back(convert(arguments[i], types[i], type->param(i)));
+            if (escapes.parameterEscapes(function, i)) retainValue(values.back(), type->param(i));
+        }
+        return keep(builder.CreateCall(callee, values), type->returnType());
+    }
+    if (!match(callback, ASTNodeType::Lambda)) {
+        unsupported(callback, "callbacks other than lambdas and functions");
+        return nullptr;
+    }
+
+    // a lambda is generated right here, its parameters are locals of the function
+    auto* lambda = static_cast<LambdaNode*>(callback);
+    const Type* result = type->returnType();
+    llvm::Type* resultType = llvmType(result);
+    if (!resultType || resultType->isVoidTy()) {
+        unsupported(lambda, result->isDynamic() ? "lambdas with untyped results" : std::format("lambdas returning '{}'", result->toString()));
+        return nullptr;
+    }
+
+    // borrowed like a function's, unless they're assigned
+    scopes.emplace_back();
+    for (size_t i = 0; i < lambda->params.size(); i++) {
+        auto* parameter = static_cast<VariableNode*>(lambda->params[i].get());
+        const Type* parameterType = type->param(i);
+        llvm::Value* argument = convert(arguments[i], types[i], parameterType);
+        bool owned = isCounted(parameterType) && escapes.isAssigned(parameter);
+        if (owned) retainValue(argument, parameterType);
+        llvm::AllocaInst* slot = createSlot(llvmType(parameterType), parameter->varName, parameterType);
+        builder.CreateStore(argument, slot);
+        scopes.back()[parameter->varName] = Local{slot, parameterType, owned};
+        declarationSlots[parameter] = slot;
+    }
+
+    Callback frame{createSlot(resultType, "lambda.result", result), llvm::BasicBlock::Create(context, "lambda.end", currentFunction), result,
+        scopes.size() - 1, temporaries.size()};
+    builder.CreateStore(llvm::Constant::getNullValue(resultType), frame.result);
+    Callback* savedCallback = currentCallback;
+    llvm::BasicBlock* savedBreak = breakBlock;
+    llvm::BasicBlock* savedContinue = continueBlock;
+    currentCallback = &frame;
+    breakBlock = nullptr; // loops around it are out of reach
+    continueBlock = nullptr;
+
+    generateBlock(lambda->body.get());
+    if (!isTerminated()) {
+        releaseLocals(frame.scopes);
+        builder.CreateBr(frame.exit);
+    }
+
+    currentCallback = savedCallback;
+    breakBlock = savedBreak;
+    continueBlock = savedContinue;
+    scopes.pop_back();
+    builder.SetInsertPoint(frame.exit);
+    return builder.CreateLoad(resultType, frame.result);
+}
+
+llvm::Value* IRGenerator::generateConsumer(MemberAccessNode* node) {
+    std::string name = memberName(node);
+    if (name != "sum" && name != "collect") {
+        unsupported(node, "iterators other than ranges outside of for loops, sum and collect");
+        return nullptr;
+    }
+
+    const Type* type = node->inferredType;
+    llvm::StructType* layout = name == "collect" ? collectionType(type) : nullptr;
+    llvm::Type* resultType = layout ? pointerTo(layout) : llvmType(type);
+    if (!resultType) {
+        unsupported(node, std::format("values of type '{}'", type ? type->toString() : "?"));
+        return nullptr;
+    }
+    std::optional<Iterator> iterator = openIterator(node->parent.get(), node);
+    if (!iterator) return nullptr;
+
+    // a loop of its own, the whole pipeline fused into it. What an iteration makes is dropped before the next one.
+    llvm::AllocaInst* accumulator = createSlot(resultType, name, type);
+    llvm::Value* initial = layout ? static_cast<llvm::Value*>(builder.CreateCall(collections->arrayNew(layout), {builder.getInt64(0)})) : llvm::Constant::getNullValue(resultType);
+    builder.CreateStore(initial, accumulator);
+    llvm::BasicBlock* nextBlock = llvm::BasicBlock::Create(context, name + ".next", currentFunction);
+    llvm::BasicBlock* endBlock = llvm::BasicBlock::Create(context, name + ".end", currentFunction);
+    builder.CreateBr(nextBlock);
+
+    builder.SetInsertPoint(nextBlock);
+    llvm::Value* element = iterator->next(endBlock);
+    if (!element) return nullptr;
+    const Type* elementType = node->parent->inferredType->element();
+    llvm::Value* current = builder.CreateLoad(resultType, accumulator);
+    if (layout) builder.CreateCall(collections->arrayPush(layout), {current, iterator->owned ? element : acquire(element, elementType)});
+    else {
+        temporaries.emplace_back();
+        llvm::Value* total = generateOperation("+", current, element, type, node);
+        if (!total) {
+            temporaries.pop_back();
+            return nullptr;
+        }
+        builder.CreateStore(acquire(total, type), accumulator);
+        releaseValue(current, type);
+        if (iterator->owned) releaseValue(element, elementType);
+        releaseTemporaries(temporaries.size() - 1);
+        temporaries.pop_back();
+    }
+    builder.CreateBr(nextBlock);
+
+    builder.SetInsertPoint(endBlock);
+    llvm::Value* result = builder.CreateLoad(resultType, accumulator);
+    return fresh(result, type);
+}
+
+// ==== Runtime pieces ====
+
+llvm::FunctionCallee IRGenerator::libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters, bool variadic) {
+    return module->getOrInsertFunction(name, llvm::FunctionType::get(result, parameters, variadic));
+}
+
+llvm::Value* IRGenerator::standardStream(int descriptor, llvm::IRBuilderBase& at) {
+    llvm::Triple triple(targetTriple);
+    if (triple.isOSWindows())
+        return at.CreateCall(libc("__acrt_iob_func", stringType(), {builder.getInt32Ty()}), {builder.getInt32(descriptor)});
+
+    static const char* names[] = {"stdin", "stdout", "stderr"};
+    static const char* darwinNames[] = {"__stdinp", "__stdoutp", "__stderrp"};
+    llvm::Constant* stream = module->getOrInsertGlobal(triple.isOSDarwin() ? darwinNames[descriptor] : names[descriptor], stringType());
+    return at.CreateLoad(stringType(), stream);
+}
+
+llvm::Value* IRGenerator::allocateString(llvm::IRBuilderBase& at, llvm::Value* size, llvm::Value* region) {
+    if (region) return at.CreateCall(regionAllocator->allocate(), {region, at.CreateZExtOrTrunc(size, at.getInt64Ty())});
+    if (collector) return at.CreateCall(collector->allocate(), {at.CreateZExtOrTrunc(size, at.getInt64Ty())});
+    if (counter) return at.CreateCall(counter->allocate(), {at.CreateZExtOrTrunc(size, at.getInt64Ty())});
+    return at.CreateCall(libc("malloc", stringType(), {sizeType()}), {size});
+}
+
+llvm::Value* IRGenerator::formatValue(llvm::Value* value, const Type* type, std::string& format) {
+    if (!type || type->kind != Type::Kind::Primitive) return nullptr;
+
+    // varargs promote everything below int to int and float to double
+    switch (type->primitive) {
+        case ResolvedType::Str: format += "%s"; return value;
+        case ResolvedType::Bool: format += "%s"; return builder.CreateSelect(value, stringConstant("true"), stringConstant("false"));
+        case ResolvedType::Int8: case ResolvedType::Int16: case ResolvedType::Int:
+            format += "%d";
+            return builder.CreateSExt(value, builder.getInt32Ty());
+        case ResolvedType::UInt8: case ResolvedType::UInt16: case ResolvedType::UInt:
+            format += "%u";
+            return builder.CreateZExt(value, builder.getInt32Ty());
+        case ResolvedType::Int64: format += "%lld"; return value;
+        case ResolvedType::UInt64: format += "%llu"; return value;
+        case ResolvedType::Float: format += "%g"; return builder.CreateFPExt(value, builder.getDoubleTy());
+        case ResolvedType::Float64: format += "%.15g"; return value;
+        case ResolvedType::Number: {
+            llvm::ArrayType* bufferType = llvm::ArrayType::get(builder.getInt8Ty(), Decimals::FormatBuffer);
+            llvm::Value* buffer = builder.CreateConstInBoundsGEP2_32(bufferType, createSlot(bufferType, "digits"), 0, 0);
+            format += "%s";
+            return builder.CreateExtractValue(builder.CreateCall(decimals->format(), {value, buffer, builder.getInt64(Decimals::FormatBuffer)}), 0);
+        }
+        default: return nullptr; // 128-bit integers have no printf conversion
+    }
+}
+
+llvm::Function* IRGenerator::formatIntegerFunction() {
+    if (llvm::Function* existing = module->getFunction("neoluma.str.formatInt")) return existing;
+
+    // counts the digits first, then writes them from the last one back: no reversing, no terminator
+    llvm::Type* int64 = builder.getInt64Ty();
+    llvm::Function* function = llvm::Function::Create(llvm::FunctionType::get(int64, {stringType(), int64, builder.getInt1Ty()}, false),
+        llvm::GlobalValue::InternalLinkage, "neoluma.str.formatInt", module.get());
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* count = llvm::BasicBlock::Create(context, "count", function);
+    llvm::BasicBlock* start = llvm::BasicBlock::Create(context, "start", function);
+    llvm::BasicBlock* write = llvm::BasicBlock::Create(context, "write", function);
+    llvm::BasicBlock* exit = llvm::BasicBlock::Create(context, "exit", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* buffer = function->getArg(0);
+    llvm::Value* value = function->getArg(1);
+    llvm::Value* ten = body.getInt64(10);
+
+    llvm::Value* negative = body.CreateAnd(function->getArg(2), body.CreateICmpSLT(value, body.getInt64(0)));
+    llvm::Value* magnitude = body.CreateSelect(negative, body.CreateSub(body.getInt64(0), value), value); // INT64_MIN too, read unsigned
+    body.CreateBr(count);
+
+    body.SetInsertPoint(count);
+    llvm::PHINode* digits = body.CreatePHI(int64, 2);
+    llvm::PHINode* rest = body.CreatePHI(int64, 2);
+    llvm::Value* more = body.CreateICmpUGE(rest, ten);
+    digits->addIncoming(body.getInt64(1), entry);
+    digits->addIncoming(body.CreateAdd(digits, body.getInt64(1)), count);
+    rest->addIncoming(magnitude, entry);
+    rest->addIncoming(body.CreateUDiv(rest, ten), count);
+    body.CreateCondBr(more, count, start);
+
+    body.SetInsertPoint(start);
+    body.CreateStore(body.getInt8('-'), buffer); // overwritten by the first digit if it's not negative
+    llvm::Value* length = body.CreateAdd(digits, body.CreateZExt(negative, int64));
+    body.CreateBr(write);
+
+    body.SetInsertPoint(write);
+    llvm::PHINode* position = body.CreatePHI(int64, 2);
+    llvm::PHINode* remaining = body.CreatePHI(int64, 2);
+    llvm::Value* quotient = body.CreateUDiv(remaining, ten);
+    llvm::Value* digit = body.CreateSub(remaining, body.CreateMul(quotient, ten));
+    llvm::Value* previous = body.CreateSub(position, body.getInt64(1));
+    body.CreateStore(body.CreateAdd(body.CreateTrunc(digit, body.getInt8Ty()), body.getInt8('0')), body.CreateInBoundsGEP(body.getInt8Ty(), buffer, previous));
+    position->addIncoming(length, start);
+    position->addIncoming(previous, write);
+    remaining->addIncoming(magnitude, start);
+    remaining->addIncoming(quotient, write);
+    body.CreateCondBr(body.CreateICmpNE(quotient, body.getInt64(0)), write, exit);
+
+    body.SetInsertPoint(exit);
+    body.CreateRet(length);
+    return function;
+}
+
+llvm::Function* IRGenerator::reserveFunction() {
+    if (llvm::Function* existing = module->getFunction("neoluma.str.reserve")) return existing;
+
+    // twice what's needed, so a string appended to n times is copied about twice in all. The first one copies in what
+    // the local held before the loop.
+    llvm::Type* size = sizeType();
+    llvm::Function* function = llvm::Function::Create(llvm::FunctionType::get(builder.getVoidTy(), {stringType()->getPointerTo(), size->getPointerTo(), stringType(), size, size}, false),
+        llvm::GlobalValue::InternalLinkage, "neoluma.str.reserve", module.get());
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* first = llvm::BasicBlock::Create(context, "first", function);
+    llvm::BasicBlock* exit = llvm::BasicBlock::Create(context, "exit", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* old = body.CreateLoad(stringType(), function->getArg(0));
+    llvm::Value* twice = body.CreateShl(function->getArg(4), 1);
+    llvm::Value* minimum = llvm::ConstantInt::get(size, 64);
+    llvm::Value* capacity = body.CreateSelect(body.CreateICmpULT(twice, minimum), minimum, twice);
+    llvm::Value* buffer = body.CreateCall(libc("realloc", stringType(), {stringType(), size}), {old, capacity});
+    body.CreateStore(buffer, function->getArg(0));
+    body.CreateStore(capacity, function->getArg(1));
+    body.CreateCondBr(body.CreateIsNull(old), first, exit);
+
+    body.SetInsertPoint(first);
+    body.CreateMemCpy(buffer, llvm::MaybeAlign(1), function->getArg(2), llvm::MaybeAlign(1), function->getArg(3));
+    body.CreateBr(exit);
+
+    body.SetInsertPoint(exit);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Constant* IRGenerator::shortStrings() {
+    if (llvm::GlobalVariable* existing = module->getNamedGlobal("neoluma.str.short")) return existing;
+
+    // with the header of a literal, so nothing counts, frees or collects them
+    llvm::Constant* header = collector ? collector->staticHeader() : counter ? counter->staticHeader() : builder.getInt64(0);
+    llvm::ArrayType* text = llvm::ArrayType::get(builder.getInt8Ty(), 2);
+    llvm::StructType* entry = llvm::StructType::get(context, {builder.getInt64Ty(), text});
+    std::vector<llvm::Constant*> entries;
+    for (unsigned character = 0; character < 256; character++)
+        entries.push_back(llvm::ConstantStruct::get(entry, {header, llvm::ConstantDataArray::get(context, llvm::ArrayRef<uint8_t>{uint8_t(character), 0})}));
+    llvm::ArrayType* type = llvm::ArrayType::get(entry, entries.size());
+    auto* table = new llvm::GlobalVariable(*module, type, true, llvm::GlobalValue::PrivateLinkage, llvm::ConstantArray::get(type, entries), "neoluma.str.short");
+    table->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    table->setAlignment(llvm::Align(8));
+    return table;
+}
+
+llvm::Function* IRGenerator::powerFunction(llvm::IntegerType* type, bool isSigned) {
+    std::string name = std::format("neoluma.ipow.{}{}", isSigned ? "i" : "u", type->getBitWidth());
+    if (llvm::Function* existing = module->getFunction(name)) return existing;
+
+    // exponentiation by squaring; a negative exponent gives 1, like an empty product
+    llvm::Function* function = llvm::Function::Create(llvm::FunctionType::get(type, {type, type}, false), llvm::GlobalValue::InternalLinkage, name, module.get());
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "loop", function);
+    llvm::BasicBlock* step = llvm::BasicBlock::Create(context, "step", function);
+    llvm::BasicBlock* exit = llvm::BasicBlock::Create(context, "exit", function);
+    llvm::IRBuilder<> body(entry);
+    body.CreateBr(loop);
+
+    body.SetInsertPoint(loop);
+    llvm::PHINode* result = body.CreatePHI(type, 2);
+    llvm::PHINode* base = body.CreatePHI(type, 2);
+    llvm::PHINode* exponent = body.CreatePHI(type, 2);
+    llvm::Value* zero = llvm::ConstantInt::get(type, 0);
+    body.CreateCondBr(isSigned ? body.CreateICmpSLE(exponent, zero) : body.CreateICmpEQ(exponent, zero), exit, step);
+
+    body.SetInsertPoint(step);
+    llvm::Value* odd = body.CreateTrunc(exponent, body.getInt1Ty());
+    llvm::Value* nextResult = body.CreateSelect(odd, body.CreateMul(result, base), result);
+    llvm::Value* nextBase = body.CreateMul(base, base);
+    llvm::Value* nextExponent = body.CreateLShr(exponent, 1);
+    body.CreateBr(loop);
+
+    result->addIncoming(llvm::ConstantInt::get(type, 1), entry);
+    result->addIncoming(nextResult, step);
+    base->addIncoming(function->getArg(0), entry);
+    base->addIncoming(nextBase, step);
+    exponent->addIncoming(function->getArg(1), entry);
+    exponent->addIncoming(nextExponent, step);
+
+    body.SetInsertPoint(exit);
+    body.CreateRet(result);
+    return function;
+}
+
+llvm::Function* IRGenerator::readLineFunction() {
+    if (llvm::Function* existing = module->getFunction("neoluma.io.readLine")) return existing;
+
+    // reads stdin up to a newline into a buffer that doubles when it's full
+    llvm::Function* function = llvm::Function::Create(llvm::FunctionType::get(stringType(), false), llvm::GlobalValue::InternalLinkage, "neoluma.io.readLine", module.get());
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "loop", function);
+    llvm::BasicBlock* grow = llvm::BasicBlock::Create(context, "grow", function);
+    llvm::BasicBlock* store = llvm::BasicBlock::Create(context, "store", function);
+    llvm::BasicBlock* exit = llvm::BasicBlock::Create(context, "exit", function);
+
+    llvm::IRBuilderBase::InsertPoint saved = builder.saveIP();
+    builder.SetInsertPoint(entry);
+    llvm::Type* size = sizeType();
+    llvm::Value* one = llvm::ConstantInt::get(size, 1);
+    llvm::Value* stream = standardStream(0);
+    llvm::Value* initial = builder.CreateCall(libc("malloc", stringType(), {size}), {llvm::ConstantInt::get(size, 64)});
+    builder.CreateBr(loop);
+
+    builder.SetInsertPoint(loop);
+    llvm::PHINode* buffer = builder.CreatePHI(stringType(), 2);
+    llvm::PHINode* capacity = builder.CreatePHI(size, 2);
+    llvm::PHINode* length = builder.CreatePHI(size, 2);
+    llvm::Value* character = builder.CreateCall(libc("fgetc", builder.getInt32Ty(), {stringType()}), {stream});
+    llvm::Value* done = builder.CreateOr(builder.CreateICmpEQ(character, builder.getInt32(-1)), builder.CreateICmpEQ(character, builder.getInt32('\n')));
+    llvm::BasicBlock* check = llvm::BasicBlock::Create(context, "check", function, grow);
+    builder.CreateCondBr(done, exit, check);
+
+    // one byte is always left for the terminator
+    builder.SetInsertPoint(check);
+    builder.CreateCondBr(builder.CreateICmpEQ(builder.CreateAdd(length, one), capacity), grow, store);
+
+    builder.SetInsertPoint(grow);
+    llvm::Value* doubled = builder.CreateShl(capacity, 1);
+    llvm::Value* moved = builder.CreateCall(libc("realloc", stringType(), {stringType(), size}), {buffer, doubled});
+    builder.CreateBr(store);
+
+    builder.SetInsertPoint(store);
+    llvm::PHINode* storage = builder.CreatePHI(stringType(), 2);
+    storage->addIncoming(buffer, check);
+    storage->addIncoming(moved, grow);
+    llvm::PHINode* storageCapacity = builder.CreatePHI(size, 2);
+    storageCapacity->addIncoming(capacity, check);
+    storageCapacity->addIncoming(doubled, grow);
+    builder.CreateStore(builder.CreateTrunc(character, builder.getInt8Ty()), builder.CreateInBoundsGEP(builder.getInt8Ty(), storage, length));
+    llvm::Value* nextLength = builder.CreateAdd(length, one);
+    builder.CreateBr(loop);
+
+    buffer->addIncoming(initial, entry);
+    buffer->addIncoming(storage, store);
+    capacity->addIncoming(llvm::ConstantInt::get(size, 64), entry);
+    capacity->addIncoming(storageCapacity, store);
+    length->addIncoming(llvm::ConstantInt::get(size, 0), entry);
+    length->addIncoming(nextLength, store);
+
+    builder.SetInsertPoint(exit);
+    builder.CreateStore(builder.getInt8(0), builder.CreateInBoundsGEP(builder.getInt8Ty(), buffer, length));
+    if (collector || counter) {
+        // the line moves to the collector's heap or into a counted object, the buffer can go
+        llvm::Value* line = allocateString(builder, builder.CreateAdd(length, one));
+        builder.CreateMemCpy(line, llvm::MaybeAlign(1), buffer, llvm::MaybeAlign(1), builder.CreateAdd(length, one));
+        builder.CreateCall(libc("free", builder.getVoidTy(), {stringType()}), {buffer});
+        builder.CreateRet(line);
+    }
+    else builder.CreateRet(buffer);
+
+    builder.restoreIP(saved);
+    return function;
+}
+
+llvm::Function* IRGenerator::sleepFunction() {
+    if (llvm::Function* existing = module->getFunction("neoluma.time.sleepMs")) return existing;
+
+    llvm::Function* function = llvm::Function::Create(llvm::FunctionType::get(builder.getVoidTy(), {builder.getInt32Ty()}, false),
+        llvm::GlobalValue::InternalLinkage, "neoluma.time.sleepMs", module.get());
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* milliseconds = body.CreateBinaryIntrinsic(llvm::Intrinsic::smax, function->getArg(0), body.getInt32(0));
+    if (llvm::Triple(targetTriple).isOSWindows()) {
+        body.CreateCall(libc("Sleep", body.getVoidTy(), {body.getInt32Ty()}), {milliseconds});
+        body.CreateRetVoid();
+        return function;
+    }
+
+    // struct timespec, a signal cuts it short and it goes on with what's left
+    llvm::StructType* timespec = llvm::StructType::get(context, {body.getInt64Ty(), body.getInt64Ty()});
+    llvm::AllocaInst* left = body.CreateAlloca(timespec);
+    llvm::Value* wide = body.CreateZExt(milliseconds, body.getInt64Ty());
+    body.CreateStore(body.CreateUDiv(wide, body.getInt64(1000)), body.CreateStructGEP(timespec, left, 0));
+    body.CreateStore(body.CreateMul(body.CreateURem(wide, body.getInt64(1000)), body.getInt64(1000000)), body.CreateStructGEP(timespec, left, 1));
+    llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "loop", function);
+    llvm::BasicBlock* exit = llvm::BasicBlock::Create(context, "exit", function);
+    body.CreateBr(loop);
+
+    body.SetInsertPoint(loop);
+    llvm::Value* interrupted = body.CreateCall(libc("nanosleep", body.getInt32Ty(), {pointerTo(timespec), pointerTo(timespec)}), {left, left});
+    body.CreateCondBr(body.CreateICmpNE(interrupted, body.getInt32(0)), loop, exit);
+
+    body.SetInsertPoint(exit);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* IRGenerator::fileFailureFunction() {
+    if (llvm::Function* existing = module->getFunction("neoluma.fs.error")) return existing;
+
+    // reports errno with `format`, which takes the path and the reason, and stops the program
+    llvm::Function* function = llvm::Function::Create(llvm::FunctionType::get(builder.getVoidTy(), {stringType(), stringType()}, false),
+        llvm::GlobalValue::InternalLinkage, "neoluma.fs.error", module.get());
+    function->addFnAttr(llvm::Attribute::NoReturn);
+    function->addFnAttr(llvm::Attribute::Cold);
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Triple triple(targetTriple);
+    const char* location = triple.isOSWindows() ? "_errno" : triple.isOSDarwin() ? "__error" : "__errno_location";
+    llvm::Value* error = body.CreateLoad(body.getInt32Ty(), body.CreateCall(libc(location, pointerTo(body.getInt32Ty()), {})));
+    body.CreateCall(libc("fflush", body.getInt32Ty(), {stringType()}), {llvm::Constant::getNullValue(stringType())}); // what the program printed comes first
+    llvm::Value* reason = body.CreateCall(libc("strerror", stringType(), {body.getInt32Ty()}), {error});
+    body.CreateCall(libc("fprintf", body.getInt32Ty(), {stringType(), stringType()}, true), {standardStream(2, body), function->getArg(0), function->getArg(1), reason});
+    body.CreateCall(libc("abort", body.getVoidTy(), {}));
+    body.CreateUnreachable();
+    return function;
+}
+
+llvm::Function* IRGenerator::readTextFunction() {
+    if (llvm::Function* existing = module->getFunction("neoluma.fs.readText")) return existing;
+
+    // the whole file into a buffer that doubles when it's full
+    llvm::Function* function = llvm::Function::Create(llvm::FunctionType::get(stringType(), {stringType()}, false),
+        llvm::GlobalValue::InternalLinkage, "neoluma.fs.readText", module.get());
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* opened = llvm::BasicBlock::Create(context, "opened", function);
+    llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "loop", function);
+    llvm::BasicBlock* grow = llvm::BasicBlock::Create(context, "grow", function);
+    llvm::BasicBlock* read = llvm::BasicBlock::Create(context, "read", function);
+    llvm::BasicBlock* ended = llvm::BasicBlock::Create(context, "ended", function);
+    llvm::BasicBlock* exit = llvm::BasicBlock::Create(context, "exit", function);
+    llvm::BasicBlock* failed = llvm::BasicBlock::Create(context, "failed", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* size = sizeType();
+    llvm::Value* path = function->getArg(0);
+    llvm::AllocaInst* buffer = body.CreateAlloca(stringType());
+    llvm::AllocaInst* capacity = body.CreateAlloca(size);
+    llvm::AllocaInst* length = body.CreateAlloca(size);
+    llvm::Value* file = body.CreateCall(libc("fopen", stringType(), {stringType(), stringType()}), {path, stringConstant("rb")});
+    body.CreateCondBr(body.CreateIsNull(file), failed, opened);
+
+    body.SetInsertPoint(failed);
+    body.CreateCall(fileFailureFunction(), {stringConstant("error: can't open '%s' to read: %s\n"), path});
+    body.CreateUnreachable();
+
+    body.SetInsertPoint(opened);
+    body.CreateStore(body.CreateCall(libc("malloc", stringType(), {size}), {llvm::ConstantInt::get(size, 4096)}), buffer);
+    body.CreateStore(llvm::ConstantInt::get(size, 4096), capacity);
+    body.CreateStore(llvm::ConstantInt::get(size, 0), length);
+    body.CreateBr(loop);
+
+    // one byte is always left for the terminator
+    body.SetInsertPoint(loop);
+    llvm::Value* room = body.CreateSub(body.CreateLoad(size, capacity), body.CreateLoad(size, length));
+    body.CreateCondBr(body.CreateICmpULT(room, llvm::ConstantInt::get(size, 2)), grow, read);
+
+    body.SetInsertPoint(grow);
+    llvm::Value* doubled = body.CreateShl(body.CreateLoad(size, capacity), 1);
+    body.CreateStore(body.CreateCall(libc("realloc", stringType(), {stringType(), size}), {body.CreateLoad(stringType(), buffer), doubled}), buffer);
+    body.CreateStore(doubled, capacity);
+    body.CreateBr(read);
+
+    body.SetInsertPoint(read);
+    llvm::Value* done = body.CreateLoad(size, length);
+    llvm::Value* wanted = body.CreateSub(body.CreateSub(body.CreateLoad(size, capacity), done), llvm::ConstantInt::get(size, 1));
+    llvm::Value* end = body.CreateGEP(body.getInt8Ty(), body.CreateLoad(stringType(), buffer), done);
+    llvm::Value* got = body.CreateCall(libc("fread", size, {stringType(), size, size, stringType()}), {end, llvm::ConstantInt::get(size, 1), wanted, file});
+    body.CreateStore(body.CreateAdd(done, got), length);
+    body.CreateCondBr(body.CreateICmpEQ(got, llvm::ConstantInt::get(size, 0)), ended, loop);
+
+    body.SetInsertPoint(ended);
+    llvm::BasicBlock* readFailed = llvm::BasicBlock::Create(context, "read.failed", function, exit);
+    body.CreateCondBr(body.CreateICmpNE(body.CreateCall(libc("ferror", body.getInt32Ty(), {stringType()}), {file}), body.getInt32(0)), readFailed, exit);
+
+    body.SetInsertPoint(readFailed);
+    body.CreateCall(fileFailureFunction(), {stringConstant("error: can't read '%s': %s\n"), path});
+    body.CreateUnreachable();
+
+    body.SetInsertPoint(exit);
+    body.CreateCall(libc("fclose", body.getInt32Ty(), {stringType()}), {file});
+    llvm::Value* text = body.CreateLoad(stringType(), buffer);
+    llvm::Value* bytes = body.CreateAdd(body.CreateLoad(size, length), llvm::ConstantInt::get(size, 1));
+    body.CreateStore(body.getInt8(0), body.CreateGEP(body.getInt8Ty(), text, body.CreateLoad(size, length)));
+    if (collector || counter) {
+        // the text moves to the collector's heap or into a counted object, the buffer can go
+        llvm::Value* kept = allocateString(body, bytes);
+        body.CreateMemCpy(kept, llvm::MaybeAlign(1), text, llvm::MaybeAlign(1), bytes);
+        body.CreateCall(libc("free", body.getVoidTy(), {stringType()}), {text});
+        body.CreateRet(kept);
+    }
+    else body.CreateRet(text);
+    return function;
+}
+
+llvm::Function* IRGenerator::writeTextFunction() {
+    if (llvm::Function* existing = module->getFunction("neoluma.fs.writeText")) return existing;
+
+    llvm::Function* function = llvm::Function::Create(llvm::FunctionType::get(builder.getVoidTy(), {stringType(), stringType()}, false),
+        llvm::GlobalValue::InternalLinkage, "neoluma.fs.writeText", module.get());
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* opened = llvm::BasicBlock::Create(context, "opened", function);
+    llvm::BasicBlock* openFailed = llvm::BasicBlock::Create(context, "open.failed", function);
+    llvm::BasicBlock* writeFailed = llvm::BasicBlock::Create(context, "write.failed", function);
+    llvm::BasicBlock* exit = llvm::BasicBlock::Create(context, "exit", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Type* size = sizeType();
+    llvm::Value* path = function->getArg(0);
+    llvm::Value* content = function->getArg(1);
+    llvm::Value* file = body.CreateCall(libc("fopen", stringType(), {stringType(), stringType()}), {path, stringConstant("wb")});
+    body.CreateCondBr(body.CreateIsNull(file), openFailed, opened);
+
+    body.SetInsertPoint(openFailed);
+    body.CreateCall(fileFailureFunction(), {stringConstant("error: can't open '%s' to write: %s\n"), path});
+    body.CreateUnreachable();
+
+    // a short write or a failed flush when it's closed both mean the text isn't all there
+    body.SetInsertPoint(opened);
+    llvm::Value* length = body.CreateCall(libc("strlen", size, {stringType()}), {content});
+    llvm::Value* wrote = body.CreateCall(libc("fwrite", size, {stringType(), size, size, stringType()}), {content, llvm::ConstantInt::get(size, 1), length, file});
+    llvm::Value* close = body.CreateCall(libc("fclose", body.getInt32Ty(), {stringType()}), {file});
+    body.CreateCondBr(body.CreateOr(body.CreateICmpNE(wrote, length), body.CreateICmpNE(close, body.getInt32(0))), writeFailed, exit);
+
+    body.SetInsertPoint(writeFailed);
+    body.CreateCall(fileFailureFunction(), {stringConstant("error: can't write '%s': %s\n"), path});
+    body.CreateUnreachable();
+
+    body.SetInsertPoint(exit);
+    body.CreateRetVoid();
+    return function;
 }
-*/
\ No newline at end of file
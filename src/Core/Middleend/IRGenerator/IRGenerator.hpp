@@ -1,88 +1,276 @@
 #pragma once
-#include <vector>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
-#include "Core/Frontend/Nodes.hpp"
-#include "Core/Frontend/Orchestrator/Orchestrator.hpp"
-#include "HelperFunctions.hpp"
-/* Deprecated structure
-// LLVM Pritimives
+// LLVM Primitives
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
-#include "llvm/IR/IRBuilder.h"
-#include "llvm/IR/Value.h"
 
-struct Compiler;
+#include "Core/Extras/ErrorManager/ErrorManager.hpp"
+#include "Core/Frontend/Nodes.hpp"
+#include "Collections.hpp"
+#include "Decimals.hpp"
+#include "EscapeAnalysis.hpp"
+#include "Executor.hpp"
+#include "GarbageCollector.hpp"
+#include "HelperFunctions.hpp"
+#include "ReferenceCounter.hpp"
+#include "RegionAllocator.hpp"
+
+struct Type;
+
+/* IR Generator lowers modules that went through the whole Frontend into LLVM IR.
+ * Everything it needs is already in the tree: `inferredType` on every expression, `resolvedFunction` on every call,
+ * constants folded and dead code removed. It never checks anything the Frontend checked.
+ *
+ * Functions of other modules are referred to by symbol name only, so any set of modules can be generated into one
+ * LLVM module, or every module into its own, and linked together later.
+ * Symbols are `<module path>.<name>(<parameter types>)`, the entry function also gets a C `main` that calls it.
+ *
+ * Values map onto machine types one to one: integers, floats and bool are LLVM scalars and `str` is a pointer to a
+ * null-terminated, immutable string. `number`, collections and tasks are values of the runtime pieces emitted with them
+ * (Decimals, Collections, Executor). Anything else that needs a runtime (classes, lambdas as values, exceptions, dynamic
+ * values) is reported as CodegenErrors::UnsupportedFeature.
+ */
+struct IRGenerator {
+    // ErrorManager is used to report errors
+    ErrorManager* errorManager = nullptr;
+    std::filesystem::path sourceFolder; // module paths in symbol names are relative to it
+    std::string targetTriple, dataLayout; // of the target machine, some runtime pieces depend on them
+    // The default memory mode collects strings with these. Without them strings are malloc'd and never freed.
+    std::optional<GarbageCollector::Settings> garbageCollector;
+    // ARC counts references to strings and collections with these instead
+    std::optional<ReferenceCounter::Settings> referenceCounting;
+
+    explicit IRGenerator(llvm::LLVMContext& context) : context(context), builder(context) {}
+
+    // Registers top-level names of the whole program, so code of any module can refer to the others
+    void declareProgram(const std::vector<ModuleNode*>& modules);
+    // Generates `modules` into a new LLVM module. `entry` gets a C `main` if it's one of their functions.
+    MemoryPtr<llvm::Module> generate(const std::string& name, const std::vector<ModuleNode*>& modules, FunctionNode* entry);
 
-class IRGenerator {
-public:
-    Compiler* compiler = nullptr;
-    void setCompiler(Compiler* compiler) { this->compiler = compiler; }
+    // Generates `void <bridgeName>(i64* arguments, i64* result)` into a new LLVM module: it calls `function`, generated
+    // elsewhere, with arguments read from 8-byte slots and writes the result to one, the way the Interpreter keeps them
+    MemoryPtr<llvm::Module> generateBridge(FunctionNode* function);
 
-    // Main function
-    void generate(const ProgramUnit& programUnit, const std::vector<ModuleInfo>& infos);
+    // Symbol name of a function, the same in every LLVM module
+    std::string symbolName(const FunctionNode* function) const;
+    std::string bridgeName(const FunctionNode* function) const { return "neoluma.bridge." + symbolName(function); }
+    // Symbol name of a global variable
+    std::string globalName(const DeclarationNode* declaration) const;
+    // `a.b` for <sourceFolder>/a/b.nm, files outside of it go by their name
+    static std::string modulePath(const std::string& filePath, const std::filesystem::path& sourceFolder);
 
 private:
-    llvm::LLVMContext context;
-    MemoryPtr<llvm::Module> program;
-    MemoryPtr<llvm::IRBuilder<>> builder;
+    struct Local {
+        llvm::AllocaInst* slot;
+        const Type* type;
+        bool owned = false; // with ARC: holds a reference of its own, dropped when its scope ends
+    };
 
-    std::vector<std::unordered_map<std::string, llvm::Value*>> scopes;
+    llvm::LLVMContext& context;
+    llvm::IRBuilder<> builder;
+    MemoryPtr<llvm::Module> module;
+    // Of the module being generated, if strings are collected: every string slot of a function is a root in its
+    // shadow-stack frame, strings fresh out of a call are kept in one too, and stores into globals go through the
+    // write barrier
+    MemoryPtr<GarbageCollector> collector;
+    /* Of the module being generated, with ARC. A value an expression makes (a string built, a call's result, an element
+     * read out of a collection) comes with a reference, dropped at the end of its statement unless something takes
+     * it: a local, a collection, a return, an escaping parameter. Anything else is borrowed from whoever holds it.
+     * Parameters that only get read are borrowed by the callee, loops over a collection nothing can change while they
+     * run borrow its elements, and a returned local is moved out. Each function goes through `optimize` once it's done.
+     */
+    MemoryPtr<ReferenceCounter> counter;
+    std::vector<std::vector<std::pair<llvm::Value*, const Type*>>> temporaries; // with a reference to drop, a frame per statement
+    MemoryPtr<RegionAllocator> regionAllocator; // of the module being generated
+    MemoryPtr<Collections> collections; // of the module being generated
+    MemoryPtr<Decimals> decimals; // the same
+    MemoryPtr<Executor> executor; // the same, on Linux: it waits with epoll. It runs every task on one thread with a collector.
+    EscapeAnalysis escapes; // of the whole program
+
+    std::unordered_map<std::string, std::vector<DeclarationNode*>> globals; // top-level variables of the program by name
+    std::unordered_map<std::string, std::vector<FunctionNode*>> functions; // top-level functions of the program by name
+    std::unordered_map<const ASTNode*, std::string> namespacePrefixes; // "a.b." for functions and variables inside namespace a.b
+    std::vector<std::unordered_map<std::string, Local>> scopes; // locals of the current function
+    std::unordered_set<const ASTNode*> reported; // a construct is reported once, however many times it's reached
+    std::unordered_map<llvm::Function*, std::vector<llvm::AllocaInst*>> roots; // string and collection slots, they go into the function's frame once it's done
+
+    // Strings Escape Analysis proves never leave their function or loop iteration go to a region of it, in every memory
+    // mode: no roots, no barriers, and all of them freed at once when the iteration ends or the function returns
+    struct Region {
+        const ASTNode* owner; // the function or the loop
+        llvm::AllocaInst* slot;
+    };
+    std::vector<Region> regions; // of the current function, the innermost last
+    std::unordered_map<const ASTNode*, llvm::AllocaInst*> declarationSlots; // of the current function
+
+    // A string local a loop only appends to (see EscapeAnalysis::appendedLocals) takes the appends into a buffer that
+    // grows by doubling, one copy of each piece however long the string gets. The local gets the string on the way out.
+    struct Appending {
+        const ASTNode* loop;
+        llvm::AllocaInst* local;
+        const Type* type;
+        llvm::AllocaInst* buffer; // i8* from malloc, null until the first append copies the local's string in
+        llvm::AllocaInst* length; // of sizeType(), not terminated
+        llvm::AllocaInst* capacity;
+        const ASTNode* site; // its region is the string's
+        bool release; // the local's old value, like an assignment
+    };
+    std::vector<Appending> appending; // of the loops being generated
+
+    // An iterator being generated. Its state is in slots of the function, set up where it was opened. `next` emits
+    // pulling one element where the builder is: it gives the element, or branches to `exhausted` if there are no more.
+    struct Iterator {
+        std::function<llvm::Value*(llvm::BasicBlock* exhausted)> next;
+        bool owned = false; // with ARC: an element comes with a reference for whoever pulled it
+    };
+    // A lambda generated inline, where it's called back: its returns go on after it
+    struct Callback {
+        llvm::AllocaInst* result;
+        llvm::BasicBlock* exit;
+        const Type* type;
+        size_t scopes, temporaries; // of the function where it starts, what a return drops is above them
+    };
+    Callback* currentCallback = nullptr;
+
+    // A part of a string being built, not terminated
+    struct StringPiece {
+        llvm::Value* data; // i8*
+        llvm::Value* length; // of sizeType()
+    };
+
+    llvm::Function* currentFunction = nullptr;
+    const Type* currentReturnType = nullptr; // of its promise for an async function
+    // Of the current function if it's async. Its call gives the handle as a task<T>, and `await` suspends the awaiting
+    // coroutine until the task is done. An async entry is run to the end by `main`.
+    std::optional<Executor::Coroutine> coroutine;
+    llvm::BasicBlock* breakBlock = nullptr;
+    llvm::BasicBlock* continueBlock = nullptr;
+    const ASTNode* currentLoop = nullptr; // the loop `continue` goes on with
+    size_t loopScopes = 0, loopTemporaries = 0; // where the current loop's iteration starts, `break` and `continue` drop what's above
+    llvm::Function* initializer = nullptr; // runs global initializers that aren't constants, removed if there are none
+    llvm::BasicBlock* initializerBlock = nullptr;
 
     // Helper functions
-    bool match(ASTNode* node, ASTNodeType type) {
-        if (node->type == type) return true;
-        return false;
-    }
-    void pushScope();
-    void popScope();
-    void declareVariable(const std::string& name, llvm::Value* value, llvm::Type* type);
-    llvm::Value* findVariable(const std::string& name);
-    std::string getRootVarName(ASTNode* node); // for member access
-    std::unordered_map<Operators, std::string> on = getOperatorNames();
+    bool match(ASTNode* node, ASTNodeType type) { return node && node->type == type; }
+    void unsupported(const ASTNode* node, const std::string& feature);
+
+    llvm::Type* llvmType(const Type* type);
+    llvm::StructType* collectionType(const Type* type); // nullptr if an element has no machine type
+    std::optional<Collections::Element> collectionElement(const Type* type);
+    llvm::StructType* rangeType(); // {i64 start, i64 stop, i64 step}
+    llvm::Value* rangeCount(llvm::Value* range); // i64, how many elements it gives
+    const Type* valueType(ASTNode* node); // the type of what `node` generates, which may be more than the Frontend knows
+    llvm::Type* stringType();
+    llvm::Type* sizeType();
+    llvm::Value* stringConstant(const std::string& text);
+    llvm::Value* convert(llvm::Value* value, const Type* from, const Type* to); // implicit conversions the Frontend allows
+    llvm::Function* declareFunction(FunctionNode* function);
+    llvm::GlobalVariable* declareGlobal(DeclarationNode* declaration);
+    DeclarationNode* findGlobal(const std::string& name, const std::string& filePath);
+    FunctionNode* findFunction(const std::string& name, const std::string& filePath, const Type* type); // nullptr if it's overloaded
+    llvm::Value* variablePointer(const std::string& name, const std::string& filePath, const Type*& type); // local or global, nullptr if neither
+    llvm::AllocaInst* createSlot(llvm::Type* type, const std::string& name, const Type* held = nullptr); // a root of the collector if `held` is a string, a number or a collection
+    // With the write barrier if it's a string in a global. With ARC `value` comes with a reference, the old one is dropped.
+    // `release` false leaves the old value to whoever it's borrowed from.
+    void storeVariable(llvm::Value* value, llvm::Value* pointer, const Type* type, bool release = true);
+    Local* findLocal(const std::string& name, size_t* scope = nullptr); // and the index of its scope
+    llvm::Value* keep(llvm::Value* string); // a string only held in a register stays reachable, in a slot of the frame
+    llvm::Value* keep(llvm::Value* value, const Type* type); // only if `type` is a string, a number or a collection
+    llvm::Value* regionFor(const ASTNode* allocation); // the region `allocation` goes to, nullptr for the heap
+    void beginRegion(const ASTNode* owner); // if anything goes to its region
+    void resetRegion(const ASTNode* owner, bool release); // at the end of an iteration, or for good
+    void releaseRegions(); // all of them, before returning
+    void beginAppending(const ASTNode* loop); // before the loop starts
+    void endAppending(const ASTNode* loop); // on the way out, the locals get their strings
+    bool isTerminated() { return builder.GetInsertBlock()->getTerminator() != nullptr; }
+
+    // ARC
+    bool isTraced(const Type* type); // strings, numbers and collections, with the collector
+    bool isCounted(const Type* type); // strings, numbers, collections and tuples holding them, with ARC
+    void retainValue(llvm::Value* value, const Type* type);
+    void releaseValue(llvm::Value* value, const Type* type);
+    void shareValue(llvm::Value* value, const Type* type); // to another thread: a global, a task
+    llvm::Value* fresh(llvm::Value* value, const Type* type); // made with a reference, dropped with the statement's
+    llvm::Value* acquire(llvm::Value* value, const Type* type); // a reference to keep: a fresh value's own, or a new one
+    void releaseTemporaries(size_t from); // of the frames from `from` on, they stay
+    void releaseLocals(size_t from, const Local* moved = nullptr); // owned ones of the scopes from `from` on
+    llvm::Value* generateCondition(ASTNode* node); // with its temporaries dropped, before it's branched on
 
     // Generators
-    void generateModule(ModuleNode* module);
-    llvm::Function* generateFunctionSignature(FunctionNode* node);
-    void generateFunctionBody(FunctionNode* node);
+    void declareTopLevel(std::vector<MemoryPtr<ASTNode>>& body, const std::string& prefix);
+    void generateTopLevel(std::vector<MemoryPtr<ASTNode>>& body);
+    void generateFunction(FunctionNode* function);
+    void generateGlobal(DeclarationNode* declaration);
+    void generateEntry(FunctionNode* entry);
+    // Pushes the frame of its roots on entry and pops it on return. A coroutine's is linked into the tasks from its start
+    // until it's destroyed.
+    void generateFrame(llvm::Function* function, const Executor::Coroutine* coroutine = nullptr);
+
+    void generateStatement(ASTNode* node);
+    void generateBlock(ASTNode* node);
+    void generateDeclaration(DeclarationNode* node);
+    void generateAssignment(AssignmentNode* node);
+    void generateIf(IfNode* node);
+    void generateWhile(WhileLoopNode* node);
+    void generateFor(ForLoopNode* node);
+    void generateSwitch(SwitchNode* node);
+    void generateReturn(ReturnStatementNode* node);
 
-    llvm::Value* generateStatement(ASTNode* node);
     llvm::Value* generateExpression(ASTNode* node);
     llvm::Value* generateLiteral(LiteralNode* node);
+    llvm::Value* generateInterpolation(LiteralNode* node);
     llvm::Value* generateVariable(VariableNode* node);
-    llvm::Value* generateDeclaration(DeclarationNode* node);
-    llvm::Value* generateAssignment(AssignmentNode* node);
-    llvm::Value* generateBinaryOp(BinaryOperationNode* node);
-    llvm::Value* generateUnaryOp(UnaryOperationNode* node);
+    llvm::Value* generateBinary(BinaryOperationNode* node);
+    llvm::Value* generateLogical(BinaryOperationNode* node);
+    llvm::Value* generateOperation(const std::string& op, llvm::Value* left, llvm::Value* right, const Type* type, ASTNode* site);
+    void releaseOperand(ASTNode* node, llvm::Value* value); // frees the limbs of a number `node` made only to be used once
+    llvm::Value* generateUnary(UnaryOperationNode* node);
     llvm::Value* generateCall(CallExpressionNode* node);
-    llvm::Value* generateIntrinsicCall(const std::string& name, std::vector<llvm::Value*>& args);
-    llvm::Value* generateIf(IfNode* node);
-    llvm::Value* generateWhile(WhileLoopNode* node);
-    llvm::Value* generateFor(ForLoopNode* node);
-    llvm::Value* generateReturn(ReturnStatementNode* node);
-    llvm::Value* generateBlock(BlockNode* block);
-    llvm::Value* generateBreak();
-    llvm::Value* generateContinue();
-    llvm::Value* generateThrow(ThrowStatementNode* node);
-    llvm::Value* generateSwitch(SwitchNode* node);
-    llvm::Value* generateTryCatch(TryCatchNode* node);
-    llvm::Value* generateLambda(LambdaNode* node);
-    llvm::Value* generateDecorator(DecoratorNode* node);
-    llvm::StructType* generateClassType(ClassNode* node);
-    void generateClassMethods(ClassNode* node);
-    llvm::Value* generateEnum(EnumNode* node);
-    void generateInterface(InterfaceNode* node);
-
-    llvm::Type* resolveType(const std::string& typeName);
-
-    // Private fields for certain generate functions are stored here
-    llvm::BasicBlock* currentBreakBB = nullptr; // break block
-    llvm::BasicBlock* currentContinueBB = nullptr;// continue block
-    llvm::Function* currentFunction = nullptr; // needed for IfNode and others to access
-    std::unordered_map<std::string, llvm::Type*> variableTypes; // llvm 17+ everything is opaque ptrs so need to store type somewhere
-    std::unordered_map<std::string, llvm::Function*> functions; // function signatures
-    std::unordered_map<std::string, llvm::StructType*> classTypes; // types of classes
-    std::unordered_map<std::string, bool> intrinsicFunctions; // for intrinsic calls
-    int lambdaCounter = 0;
+    llvm::Value* generateCollection(ASTNode* node);
+    llvm::Value* generateMethod(MemberAccessNode* node); // of an array, set or dict
+    llvm::Value* generateIntrinsicCall(CallExpressionNode* node, FunctionNode* function, std::vector<llvm::Value*>& arguments);
+
+    // Strings are built in one go: a chain of concatenations and interpolations is flattened into pieces, numbers are
+    // formatted into stack buffers, and the result is allocated once with every piece copied into it
+    bool appendPieces(ASTNode* node, std::vector<StringPiece>& pieces); // a `str` expression, concatenations and interpolations flattened
+    bool appendInterpolation(LiteralNode* node, std::vector<StringPiece>& pieces);
+    bool appendValue(llvm::Value* value, const Type* type, std::vector<StringPiece>& pieces); // formatted like interpolation does
+    // A string of one character or none is one of the static ones, nothing is allocated for it
+    llvm::Value* buildString(const std::vector<StringPiece>& pieces, llvm::Value* region);
+    void appendString(const Appending& appended, llvm::Value* local, const std::vector<StringPiece>& pieces);
+
+    // Iterators are pulled and fused into whatever consumes them: `xs.iter().map(f).filter(g)` becomes one loop with the
+    // callbacks generated inline. Ranges are the only iterators that are values of their own, the others only live in a
+    // for loop, `sum` or `collect`.
+    std::optional<Iterator> openIterator(ASTNode* node, const ASTNode* consumer); // of an iterator or a collection, for the loop or `sum`/`collect` pulling
+    Iterator rangeIterator(llvm::Value* range, const Type* element);
+    Iterator collectionIterator(llvm::Value* collection, const Type* type, llvm::StructType* layout, bool owned);
+    // A lambda or a function, called with borrowed arguments. Its result comes with a reference.
+    llvm::Value* generateCallback(ASTNode* callback, const std::vector<llvm::Value*>& arguments, const std::vector<const Type*>& types);
+    llvm::Value* generateConsumer(MemberAccessNode* node); // `sum` or `collect` of an iterator
+
+    // Runtime pieces, emitted into the module the first time they are used
+    llvm::FunctionCallee libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters, bool variadic = false);
+    llvm::Value* standardStream(int descriptor) { return standardStream(descriptor, builder); }
+    llvm::Value* standardStream(int descriptor, llvm::IRBuilderBase& at); // FILE* of stdin/stdout/stderr, spelled differently on every C library
+    llvm::Value* allocateString(llvm::IRBuilderBase& at, llvm::Value* size, llvm::Value* region = nullptr); // uninitialized, `size` bytes with the terminator
+    llvm::Value* formatValue(llvm::Value* value, const Type* type, std::string& format); // appends a printf conversion for the value
+    llvm::Function* formatIntegerFunction(); // i64 (i8* buffer, i64 value, i1 signed): its decimal digits, not terminated, at most 20 and a sign
+    llvm::Function* reserveFunction(); // void (i8** buffer, i64* capacity, i8* string, i64 length, i64 needed): room for an append
+    llvm::Constant* shortStrings(); // [256 x {i64 header, [2 x i8]}]: the string of every byte, the empty one at 0
+    llvm::Function* powerFunction(llvm::IntegerType* type, bool isSigned);
+    llvm::Function* readLineFunction();
+    // std.time and std.fs that block the thread, for code that isn't async
+    llvm::Function* sleepFunction(); // void (i32 milliseconds)
+    llvm::Function* readTextFunction(); // i8* (i8* path): the whole file, a failure stops the program
+    llvm::Function* writeTextFunction(); // void (i8* path, i8* content), the same
+    llvm::Function* fileFailureFunction(); // void (i8* format, i8* path), doesn't return
 };
-*/
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+
+/* Pointers across LLVM versions. From LLVM 17 every pointer is an opaque `ptr` and the type pointed to only shows in
+ * the loads, stores and GEPs, older versions still carry it in the pointer type. The runtimes spell their pointers
+ * with these, so what a pointer points to stays readable in the code either way.
+ */
+
+inline llvm::PointerType* pointerTo(llvm::Type* pointee) {
+#if LLVM_VERSION_MAJOR >= 17
+    return llvm::PointerType::getUnqual(pointee->getContext());
+#else
+    return pointee->getPointerTo();
+#endif
+}
+
+// a private constant holding `text`, as an i8* to its first character
+inline llvm::Constant* globalString(llvm::IRBuilderBase& at, const std::string& text, const std::string& name, llvm::Module* module) {
+#if LLVM_VERSION_MAJOR >= 17
+    return at.CreateGlobalString(text, name, 0, module);
+#else
+    return at.CreateGlobalStringPtr(text, name, 0, module);
+#endif
+}
@@ -0,0 +1,362 @@
+#include "ReferenceCounter.hpp"
+
+#include <algorithm>
+
+// LLVM Primitives
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
+
+#include "Pointers.hpp"
+
+static constexpr uint64_t HeaderSize = 8;
+// Header: the count in the low bits, the flags on top. Static is the sign bit, one compare tells it apart.
+static constexpr uint64_t Static = 1ULL << 63, Shared = 1ULL << 62, CountMask = Shared - 1;
+
+// C functions the IR Generator calls that never touch a counted object's references
+static bool isNeutralLibrary(llvm::StringRef name) {
+    static const char* names[] = {"printf", "fprintf", "fputs", "fflush", "strlen", "strcmp", "snprintf", "malloc", "realloc", "free", "fgetc"};
+    return std::any_of(std::begin(names), std::end(names), [&](const char* neutral) { return name == neutral; });
+}
+
+// ==== Helpers ====
+
+llvm::Type* ReferenceCounter::bytePointer() { return pointerTo(llvm::Type::getInt8Ty(context)); }
+
+llvm::Type* ReferenceCounter::sizeType() { return module.getDataLayout().getIntPtrType(context); }
+
+llvm::GlobalVariable* ReferenceCounter::state(const std::string& name) {
+    std::string symbol = "neoluma.arc." + name;
+    if (llvm::GlobalVariable* existing = module.getNamedGlobal(symbol)) return existing;
+    llvm::Type* int64 = llvm::Type::getInt64Ty(context);
+    return new llvm::GlobalVariable(module, int64, false, llvm::GlobalValue::LinkOnceODRLinkage, llvm::ConstantInt::get(int64, 0), symbol);
+}
+
+void ReferenceCounter::count(llvm::IRBuilderBase& at, const std::string& name) {
+    at.CreateAtomicRMW(llvm::AtomicRMWInst::Add, state(name), at.getInt64(1), llvm::MaybeAlign(8), llvm::AtomicOrdering::Monotonic);
+}
+
+llvm::Value* ReferenceCounter::header(llvm::IRBuilderBase& at, llvm::Value* object) {
+    llvm::Value* address = at.CreateGEP(at.getInt8Ty(), at.CreatePointerCast(object, bytePointer()), at.getInt64(-int64_t(HeaderSize)));
+    return at.CreatePointerCast(address, pointerTo(at.getInt64Ty()));
+}
+
+llvm::Function* ReferenceCounter::create(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters) {
+    return llvm::Function::Create(llvm::FunctionType::get(result, parameters, false), llvm::GlobalValue::LinkOnceODRLinkage, name, module);
+}
+
+llvm::FunctionCallee ReferenceCounter::libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters, bool variadic) {
+    return module.getOrInsertFunction(name, llvm::FunctionType::get(result, parameters, variadic));
+}
+
+llvm::Constant* ReferenceCounter::staticHeader() { return llvm::ConstantInt::get(llvm::Type::getInt64Ty(context), Static); }
+
+llvm::Constant* ReferenceCounter::initialHeader() { return llvm::ConstantInt::get(llvm::Type::getInt64Ty(context), 1); }
+
+void ReferenceCounter::dropsReferences(llvm::Function* function, bool release) {
+    drops.insert(function);
+    if (release) releases.insert(function);
+}
+
+// ==== Counting ====
+
+llvm::Function* ReferenceCounter::allocate() {
+    if (llvm::Function* existing = module.getFunction("neoluma.arc.alloc")) return existing;
+
+    llvm::Function* function = create("neoluma.arc.alloc", bytePointer(), {llvm::Type::getInt64Ty(context)});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* size = body.CreateAdd(function->getArg(0), body.getInt64(HeaderSize));
+    llvm::Value* memory = body.CreateCall(libc("malloc", bytePointer(), {sizeType()}), {body.CreateZExtOrTrunc(size, sizeType())});
+    body.CreateStore(initialHeader(), body.CreatePointerCast(memory, pointerTo(body.getInt64Ty())));
+    if (settings.stats) count(body, "allocated");
+    body.CreateRet(body.CreateConstInBoundsGEP1_64(body.getInt8Ty(), memory, HeaderSize));
+    return function;
+}
+
+llvm::Function* ReferenceCounter::retain() {
+    if (llvm::Function* existing = module.getFunction("neoluma.arc.retain")) return existing;
+
+    llvm::Function* function = create("neoluma.arc.retain", llvm::Type::getVoidTy(context), {bytePointer()});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* counted = llvm::BasicBlock::Create(context, "counted", function);
+    llvm::BasicBlock* local = llvm::BasicBlock::Create(context, "local", function);
+    llvm::BasicBlock* shared = llvm::BasicBlock::Create(context, "shared", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* object = function->getArg(0);
+
+    // a null header is an object that was never made, a negative one is static
+    body.CreateCondBr(body.CreateIsNull(object), done, counted);
+    body.SetInsertPoint(counted);
+    llvm::Value* address = header(body, object);
+    llvm::Value* value = body.CreateLoad(body.getInt64Ty(), address);
+    llvm::BasicBlock* check = llvm::BasicBlock::Create(context, "check", function, local);
+    body.CreateCondBr(body.CreateICmpSLT(value, body.getInt64(0)), done, check, llvm::MDBuilder(context).createBranchWeights(1, 1000));
+
+    body.SetInsertPoint(check);
+    if (settings.stats) count(body, "retains");
+    body.CreateCondBr(body.CreateIsNotNull(body.CreateAnd(value, body.getInt64(Shared))), shared, local, llvm::MDBuilder(context).createBranchWeights(1, 1000));
+
+    body.SetInsertPoint(local);
+    body.CreateStore(body.CreateAdd(value, body.getInt64(1)), address);
+    body.CreateBr(done);
+
+    body.SetInsertPoint(shared);
+    body.CreateAtomicRMW(llvm::AtomicRMWInst::Add, address, body.getInt64(1), llvm::MaybeAlign(8), llvm::AtomicOrdering::Monotonic);
+    if (settings.stats) count(body, "atomic");
+    body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Value* ReferenceCounter::decrement(llvm::IRBuilderBase& at, llvm::Value* object) {
+    llvm::Function* function = at.GetInsertBlock()->getParent();
+    llvm::BasicBlock* before = at.GetInsertBlock();
+    llvm::BasicBlock* counted = llvm::BasicBlock::Create(context, "release.counted", function);
+    llvm::BasicBlock* check = llvm::BasicBlock::Create(context, "release.check", function);
+    llvm::BasicBlock* local = llvm::BasicBlock::Create(context, "release.local", function);
+    llvm::BasicBlock* shared = llvm::BasicBlock::Create(context, "release.shared", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "release.done", function);
+    llvm::Value* one = at.getInt64(1);
+
+    at.CreateCondBr(at.CreateIsNull(object), done, counted);
+    at.SetInsertPoint(counted);
+    llvm::Value* address = header(at, object);
+    llvm::Value* value = at.CreateLoad(at.getInt64Ty(), address);
+    at.CreateCondBr(at.CreateICmpSLT(value, at.getInt64(0)), done, check, llvm::MDBuilder(context).createBranchWeights(1, 1000));
+
+    at.SetInsertPoint(check);
+    if (settings.stats) count(at, "releases");
+    at.CreateCondBr(at.CreateIsNotNull(at.CreateAnd(value, at.getInt64(Shared))), shared, local, llvm::MDBuilder(context).createBranchWeights(1, 1000));
+
+    // the last reference is never written back, the object goes
+    at.SetInsertPoint(local);
+    llvm::Value* localLast = at.CreateICmpEQ(at.CreateAnd(value, at.getInt64(CountMask)), one);
+    llvm::BasicBlock* write = llvm::BasicBlock::Create(context, "release.write", function, shared);
+    at.CreateCondBr(localLast, done, write);
+    at.SetInsertPoint(write);
+    at.CreateStore(at.CreateSub(value, one), address);
+    at.CreateBr(done);
+
+    // acquire-release: whatever the other threads did to the object happens before it's freed
+    at.SetInsertPoint(shared);
+    llvm::Value* previous = at.CreateAtomicRMW(llvm::AtomicRMWInst::Sub, address, one, llvm::MaybeAlign(8), llvm::AtomicOrdering::AcquireRelease);
+    if (settings.stats) count(at, "atomic");
+    llvm::Value* sharedLast = at.CreateICmpEQ(at.CreateAnd(previous, at.getInt64(CountMask)), one);
+    llvm::BasicBlock* sharedEnd = at.GetInsertBlock();
+    at.CreateBr(done);
+
+    at.SetInsertPoint(done);
+    llvm::PHINode* last = at.CreatePHI(at.getInt1Ty(), 5);
+    last->addIncoming(at.getFalse(), before);
+    last->addIncoming(at.getFalse(), counted);
+    last->addIncoming(at.getTrue(), local);
+    last->addIncoming(at.getFalse(), write);
+    last->addIncoming(sharedLast, sharedEnd);
+    return last;
+}
+
+void ReferenceCounter::free(llvm::IRBuilderBase& at, llvm::Value* object) {
+    llvm::Value* memory = at.CreatePointerCast(header(at, object), bytePointer());
+    at.CreateCall(libc("free", at.getVoidTy(), {bytePointer()}), {memory});
+    if (settings.stats) count(at, "freed");
+}
+
+llvm::Function* ReferenceCounter::release() {
+    if (llvm::Function* existing = module.getFunction("neoluma.arc.release")) return existing;
+
+    llvm::Function* function = create("neoluma.arc.release", llvm::Type::getVoidTy(context), {bytePointer()});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    dropsReferences(function, true);
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* object = function->getArg(0);
+
+    // a string holds nothing, it's only freed
+    llvm::Value* last = decrement(body, object);
+    llvm::BasicBlock* freeBlock = llvm::BasicBlock::Create(context, "free", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    body.CreateCondBr(last, freeBlock, done);
+    body.SetInsertPoint(freeBlock);
+    free(body, object);
+    body.CreateBr(done);
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Value* ReferenceCounter::isShared(llvm::IRBuilderBase& at, llvm::Value* object) {
+    llvm::Value* value = at.CreateLoad(at.getInt64Ty(), header(at, object));
+    return at.CreateICmpEQ(at.CreateAnd(value, at.getInt64(Static | Shared)), at.getInt64(Shared));
+}
+
+llvm::Function* ReferenceCounter::share() {
+    if (llvm::Function* existing = module.getFunction("neoluma.arc.share")) return existing;
+
+    // the object isn't reachable from another thread yet, whoever shares it still has it to themselves
+    llvm::Function* function = create("neoluma.arc.share", llvm::Type::getVoidTy(context), {bytePointer()});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* counted = llvm::BasicBlock::Create(context, "counted", function);
+    llvm::BasicBlock* mark = llvm::BasicBlock::Create(context, "mark", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* object = function->getArg(0);
+    body.CreateCondBr(body.CreateIsNull(object), done, counted);
+
+    body.SetInsertPoint(counted);
+    llvm::Value* address = header(body, object);
+    llvm::Value* value = body.CreateLoad(body.getInt64Ty(), address);
+    body.CreateCondBr(body.CreateICmpSLT(value, body.getInt64(0)), done, mark);
+
+    body.SetInsertPoint(mark);
+    body.CreateStore(body.CreateOr(value, body.getInt64(Shared)), address);
+    body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* ReferenceCounter::report() {
+    if (llvm::Function* existing = module.getFunction("neoluma.arc.report")) return existing;
+
+    llvm::Function* function = create("neoluma.arc.report", llvm::Type::getVoidTy(context), {bytePointer()});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Type* int64 = body.getInt64Ty();
+    llvm::FunctionCallee fprintf = libc("fprintf", body.getInt32Ty(), {bytePointer(), bytePointer()}, true);
+    llvm::Value* stream = function->getArg(0);
+    body.CreateCall(libc("fflush", body.getInt32Ty(), {bytePointer()}), {llvm::Constant::getNullValue(bytePointer())}); // after what the program printed
+    auto load = [&](const std::string& name) { return body.CreateLoad(int64, state(name)); };
+
+    llvm::Value* allocated = load("allocated");
+    llvm::Value* freed = load("freed");
+    llvm::Value* objects = globalString(body, "ARC: %llu objects allocated, %llu freed, %llu still referenced\n", "neoluma.arc.format", &module);
+    body.CreateCall(fprintf, {stream, objects, allocated, freed, body.CreateSub(allocated, freed)});
+    llvm::Value* counts = globalString(body, "ARC: %llu retains, %llu releases, %llu of them atomic\n", "neoluma.arc.format", &module);
+    body.CreateCall(fprintf, {stream, counts, load("retains"), load("releases"), load("atomic")});
+    body.CreateRetVoid();
+    return function;
+}
+
+// ==== Elision ====
+
+bool ReferenceCounter::isRetain(const llvm::Instruction& instruction) const {
+    auto* call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+    return call && call->getCalledFunction() && call->getCalledFunction()->getName() == "neoluma.arc.retain";
+}
+
+bool ReferenceCounter::isRelease(const llvm::Instruction& instruction) const {
+    auto* call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+    return call && releases.contains(call->getCalledFunction());
+}
+
+bool ReferenceCounter::mayDrop(const llvm::Instruction& instruction) const {
+    auto* call = llvm::dyn_cast<llvm::CallBase>(&instruction);
+    if (!call) return false;
+    const llvm::Function* callee = call->getCalledFunction();
+    if (!callee) return true;
+    // a suspended coroutine lets other tasks run, and they may hold the same objects
+    if (callee->isIntrinsic()) return callee->getIntrinsicID() == llvm::Intrinsic::coro_suspend;
+    if (isNeutralLibrary(callee->getName())) return false;
+    // functions of the program are external, the runtime's never are. The executor's run tasks.
+    bool runtime = callee->getName().startswith("neoluma.") && !callee->hasExternalLinkage();
+    return !runtime || callee->getName().startswith("neoluma.executor.") || drops.contains(callee);
+}
+
+// the object a retain or release is of, through the casts to i8*
+static llvm::Value* objectOf(const llvm::Instruction& call) { return llvm::cast<llvm::CallInst>(call).getArgOperand(0)->stripPointerCasts(); }
+
+void ReferenceCounter::optimize(llvm::Function& function) {
+    if (function.empty()) return;
+    {
+        llvm::DominatorTree tree(function);
+        std::vector<llvm::AllocaInst*> slots;
+        for (llvm::Instruction& instruction : function.getEntryBlock())
+            if (auto* slot = llvm::dyn_cast<llvm::AllocaInst>(&instruction); slot && llvm::isAllocaPromotable(slot)) slots.push_back(slot);
+        if (!slots.empty()) llvm::PromoteMemToReg(slots, tree);
+    }
+
+    // null and literals are never counted, and a local moved out leaves null behind
+    std::vector<llvm::Instruction*> constant;
+    for (llvm::BasicBlock& block : function)
+        for (llvm::Instruction& instruction : block)
+            if ((isRetain(instruction) || isRelease(instruction)) && llvm::isa<llvm::Constant>(objectOf(instruction))) constant.push_back(&instruction);
+    for (llvm::Instruction* instruction : constant) instruction->eraseFromParent();
+
+    pairBlocks(function);
+    hoistLoops(function);
+}
+
+void ReferenceCounter::pairBlocks(llvm::Function& function) {
+    for (llvm::BasicBlock& block : function) {
+        for (auto it = block.begin(); it != block.end();) {
+            llvm::Instruction& retained = *it++;
+            if (!isRetain(retained)) continue;
+            llvm::Value* object = objectOf(retained);
+            for (auto next = retained.getIterator(), end = block.end(); ++next != end;) {
+                if (isRelease(*next) && objectOf(*next) == object) {
+                    if (&*it == &*next) ++it;
+                    next->eraseFromParent();
+                    retained.eraseFromParent();
+                    break;
+                }
+                if (mayDrop(*next)) break;
+            }
+        }
+    }
+}
+
+void ReferenceCounter::hoistLoops(llvm::Function& function) {
+    llvm::DominatorTree tree(function);
+    llvm::LoopInfo loops(tree);
+
+    // inner loops first, what's hoisted out of one may go on out of the next
+    llvm::SmallVector<llvm::Loop*, 4> order = loops.getLoopsInPreorder();
+    for (auto loop = order.rbegin(); loop != order.rend(); ++loop) {
+        llvm::BasicBlock* preheader = (*loop)->getLoopPreheader();
+        llvm::BasicBlock* latch = (*loop)->getLoopLatch();
+        if (!preheader || !latch || !(*loop)->hasDedicatedExits()) continue;
+
+        // retains and releases of objects from outside the loop, and how often each one shows up in it
+        std::unordered_map<llvm::Value*, std::pair<std::vector<llvm::Instruction*>, std::vector<llvm::Instruction*>>> counted;
+        for (llvm::BasicBlock* block : (*loop)->blocks()) {
+            for (llvm::Instruction& instruction : *block) {
+                bool retains = isRetain(instruction);
+                if (!retains && !isRelease(instruction)) continue;
+                llvm::Value* object = objectOf(instruction);
+                if (!(*loop)->isLoopInvariant(object)) continue;
+                auto& [retained, released] = counted[object];
+                (retains ? retained : released).push_back(&instruction);
+            }
+        }
+
+        llvm::SmallVector<llvm::BasicBlock*, 4> exiting, exits;
+        (*loop)->getExitingBlocks(exiting);
+        (*loop)->getUniqueExitBlocks(exits);
+        for (auto& [object, calls] : counted) {
+            if (calls.first.size() != 1 || calls.second.size() != 1) continue;
+            llvm::Instruction* retained = calls.first[0];
+            llvm::Instruction* released = calls.second[0];
+            llvm::BasicBlock* from = retained->getParent();
+            llvm::BasicBlock* to = released->getParent();
+            // once on every iteration that goes around, the retain first
+            if (loops.getLoopFor(from) != *loop || loops.getLoopFor(to) != *loop) continue;
+            if (!tree.dominates(retained, released) || !tree.dominates(to, latch)) continue;
+            // and no way out between them: the object would leave the loop with the retain and without the release
+            bool balanced = std::all_of(exiting.begin(), exiting.end(), [&](llvm::BasicBlock* block) {
+                return (block != from && tree.dominates(block, from)) || tree.dominates(to, block);
+            });
+            if (!balanced) continue;
+
+            retained->moveBefore(preheader->getTerminator());
+            for (llvm::BasicBlock* exit : exits) released->clone()->insertBefore(&*exit->getFirstInsertionPt());
+            released->eraseFromParent();
+        }
+    }
+}
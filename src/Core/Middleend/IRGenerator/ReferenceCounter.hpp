@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// LLVM Primitives
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+
+/* Reference Counter is the runtime of the ARC memory mode. Like the other runtime pieces it's emitted into the modules
+ * that use it, with linkonce_odr linkage.
+ *
+ * Strings, collections and the limbs of numbers have an 8-byte header in front of them: the count in the low 62 bits, then two flags.
+ * - Static: literals and strings of a region. They're never counted, retain and release leave them alone.
+ * - Shared: the object can be reached from more than one thread, a global or a task holds it. Only then is it counted
+ *   with atomic instructions; everything else belongs to the thread that made it and is counted with a plain add.
+ * Sharing a collection shares what's in it, and whatever goes into a shared collection later.
+ *
+ * The IR Generator decides who holds a reference: a value made by an expression is owned by it until a local, a
+ * collection, a return or a parameter that keeps it takes it over, and is released at the end of the statement if
+ * nothing did. Locals release theirs when their scope ends. Parameters Escape Analysis proves are only read are
+ * borrowed, so neither the caller nor the callee counts them. Whatever is left `optimize` cancels per function.
+ */
+struct ReferenceCounter {
+    struct Settings {
+        bool stats = false; // the program reports its objects and counts when `main` returns
+    };
+
+    ReferenceCounter(llvm::Module& module, const Settings& settings) : module(module), context(module.getContext()), settings(settings) {}
+
+    const Settings& options() const { return settings; }
+
+    llvm::Constant* staticHeader(); // i64: header of a literal or a string in a region
+    llvm::Constant* initialHeader(); // i64: header of a new object, one reference from the thread that made it
+
+    llvm::Function* allocate(); // i8* (i64 size): a new object with one reference, from malloc
+    llvm::Function* retain(); // void (i8*), null and static objects included. Inlined.
+    llvm::Function* release(); // void (i8*): of a string, freed with its last reference. Inlined.
+    llvm::Function* share(); // void (i8*): counted atomically from now on, of a string
+    llvm::Value* isShared(llvm::IRBuilderBase& at, llvm::Value* object); // i1
+    // Drops a reference, null and static objects give false. True if it was the last one: whoever called frees what
+    // the object holds, then `free`s it. Leaves `at` after it.
+    llvm::Value* decrement(llvm::IRBuilderBase& at, llvm::Value* object);
+    void free(llvm::IRBuilderBase& at, llvm::Value* object);
+    llvm::Function* report(); // void (i8* stream): objects made and freed, retains and releases, printed to `stream`
+
+    // Runtime functions of other pieces that may drop references: `release` ones drop the one of their argument, like
+    // the releases of collections do. The rest (a `set` dropping what it replaces) only keep `optimize` from moving
+    // retains and releases across them.
+    void dropsReferences(llvm::Function* function, bool release);
+
+    /* Elides what the IR Generator's conventions leave over in a function it generated. Its slots go into registers
+     * first, so a value is one SSA value wherever it's used.
+     * - A retain and a later release of the same object in one block cancel out, unless something between them may
+     *   drop references: a call of the program, or of a runtime function that does.
+     * - A retain and a release of an object defined outside a loop, done once on every iteration that goes around it,
+     *   are hoisted out of it: one retain before the loop, a release on every way out.
+     */
+    void optimize(llvm::Function& function);
+
+private:
+    llvm::Module& module;
+    llvm::LLVMContext& context;
+    Settings settings;
+    std::unordered_set<const llvm::Function*> releases, drops;
+
+    llvm::Type* bytePointer();
+    llvm::Type* sizeType(); // of the C library
+    llvm::GlobalVariable* state(const std::string& name); // an i64 counter of the report
+    void count(llvm::IRBuilderBase& at, const std::string& name); // one more, atomically: any thread may count
+    llvm::Value* header(llvm::IRBuilderBase& at, llvm::Value* object); // i64* in front of `object`
+    llvm::Function* create(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters);
+    llvm::FunctionCallee libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters, bool variadic = false);
+
+    bool isRetain(const llvm::Instruction& instruction) const;
+    bool isRelease(const llvm::Instruction& instruction) const;
+    bool mayDrop(const llvm::Instruction& instruction) const; // a call that may drop a reference to anything
+    void pairBlocks(llvm::Function& function);
+    void hoistLoops(llvm::Function& function);
+};
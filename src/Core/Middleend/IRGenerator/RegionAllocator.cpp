@@ -0,0 +1,181 @@
+#include "RegionAllocator.hpp"
+
+// LLVM Primitives
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
+
+#include "Pointers.hpp"
+
+static constexpr uint64_t ChunkHeaderSize = 16, HeaderSize = 8;
+static constexpr uint64_t MinimumChunk = 4 * 1024, MaximumChunk = 1024 * 1024; // chunks double in size up to the maximum
+
+enum RegionField : unsigned { Current, Cursor, Limit, First };
+
+// ==== Helpers ====
+
+llvm::Type* RegionAllocator::bytePointer() { return pointerTo(llvm::Type::getInt8Ty(context)); }
+
+llvm::Type* RegionAllocator::regionType() { return llvm::ArrayType::get(bytePointer(), 4); }
+
+llvm::Value* RegionAllocator::field(llvm::IRBuilderBase& at, llvm::Value* region, unsigned index) {
+    return at.CreateConstInBoundsGEP2_32(regionType(), region, 0, index);
+}
+
+llvm::Value* RegionAllocator::chunkField(llvm::IRBuilderBase& at, llvm::Value* chunk, unsigned index) {
+    return at.CreateConstInBoundsGEP1_32(bytePointer(), at.CreatePointerCast(chunk, pointerTo(bytePointer())), index);
+}
+
+llvm::Function* RegionAllocator::create(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters) {
+    return llvm::Function::Create(llvm::FunctionType::get(result, parameters, false), llvm::GlobalValue::LinkOnceODRLinkage, name, module);
+}
+
+llvm::FunctionCallee RegionAllocator::libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters) {
+    return module.getOrInsertFunction(name, llvm::FunctionType::get(result, parameters, false));
+}
+
+void RegionAllocator::begin(llvm::IRBuilderBase& at, llvm::Value* region) {
+    at.CreateStore(llvm::Constant::getNullValue(regionType()), region);
+}
+
+// ==== Allocation ====
+
+llvm::Function* RegionAllocator::allocate() {
+    if (llvm::Function* existing = module.getFunction("neoluma.region.alloc")) return existing;
+
+    llvm::Type* regionPointer = pointerTo(regionType());
+    llvm::Function* function = create("neoluma.region.alloc", bytePointer(), {regionPointer, llvm::Type::getInt64Ty(context)});
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* bump = llvm::BasicBlock::Create(context, "bump", function);
+    llvm::BasicBlock* slow = llvm::BasicBlock::Create(context, "slow", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context, "done", function);
+    llvm::IRBuilder<> body(entry);
+
+    // in multiples of 8, with the header if there is one
+    llvm::Value* region = function->getArg(0);
+    uint64_t header = objectHeader ? HeaderSize : 0;
+    llvm::Value* bytes = body.CreateAnd(body.CreateAdd(function->getArg(1), body.getInt64(header + 7)), body.getInt64(~uint64_t(7)));
+    llvm::Value* cursor = body.CreateLoad(bytePointer(), field(body, region, Cursor));
+    llvm::Value* next = body.CreateGEP(body.getInt8Ty(), cursor, bytes);
+    llvm::Value* limit = body.CreateLoad(bytePointer(), field(body, region, Limit));
+    // an empty region has both at null, so the first allocation always takes the slow path
+    llvm::Value* fits = body.CreateICmpULE(body.CreatePtrToInt(next, body.getInt64Ty()), body.CreatePtrToInt(limit, body.getInt64Ty()));
+    body.CreateCondBr(body.CreateAnd(fits, body.CreateIsNotNull(cursor)), bump, slow, llvm::MDBuilder(context).createBranchWeights(1000, 1));
+
+    body.SetInsertPoint(bump);
+    body.CreateStore(next, field(body, region, Cursor));
+    body.CreateBr(done);
+
+    body.SetInsertPoint(slow);
+    llvm::Value* grown = body.CreateCall(growFunction(), {region, bytes});
+    body.CreateBr(done);
+
+    body.SetInsertPoint(done);
+    llvm::PHINode* start = body.CreatePHI(bytePointer(), 2);
+    start->addIncoming(cursor, bump);
+    start->addIncoming(grown, slow);
+    if (!objectHeader) {
+        body.CreateRet(start);
+        return function;
+    }
+    body.CreateStore(objectHeader, body.CreatePointerCast(start, pointerTo(body.getInt64Ty())));
+    body.CreateRet(body.CreateConstInBoundsGEP1_64(body.getInt8Ty(), start, HeaderSize));
+    return function;
+}
+
+llvm::Function* RegionAllocator::growFunction() {
+    if (llvm::Function* existing = module.getFunction("neoluma.region.grow")) return existing;
+
+    llvm::Function* function = create("neoluma.region.grow", bytePointer(), {pointerTo(regionType()), llvm::Type::getInt64Ty(context)});
+    function->addFnAttr(llvm::Attribute::NoInline);
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* region = function->getArg(0);
+    llvm::Value* bytes = function->getArg(1);
+    llvm::Type* int64 = body.getInt64Ty();
+
+    // twice the size of the current chunk, but at least what's asked for
+    llvm::Value* current = body.CreateLoad(bytePointer(), field(body, region, Current));
+    llvm::Value* limit = body.CreateLoad(bytePointer(), field(body, region, Limit));
+    llvm::Value* previousSize = body.CreateSub(body.CreatePtrToInt(limit, int64), body.CreatePtrToInt(current, int64));
+    llvm::Value* doubled = body.CreateBinaryIntrinsic(llvm::Intrinsic::umin, body.CreateShl(previousSize, 1), body.getInt64(MaximumChunk));
+    llvm::Value* size = body.CreateBinaryIntrinsic(llvm::Intrinsic::umax, doubled, body.getInt64(MinimumChunk));
+    size = body.CreateBinaryIntrinsic(llvm::Intrinsic::umax, size, body.CreateAdd(bytes, body.getInt64(ChunkHeaderSize)));
+
+    llvm::Type* sizeType = module.getDataLayout().getIntPtrType(context);
+    llvm::Value* chunk = body.CreateCall(libc("malloc", bytePointer(), {sizeType}), {body.CreateZExtOrTrunc(size, sizeType)});
+    llvm::Value* end = body.CreateGEP(body.getInt8Ty(), chunk, size);
+    body.CreateStore(current, chunkField(body, chunk, 0));
+    body.CreateStore(end, chunkField(body, chunk, 1));
+
+    llvm::Value* first = body.CreateLoad(bytePointer(), field(body, region, First));
+    body.CreateStore(body.CreateSelect(body.CreateIsNull(first), chunk, first), field(body, region, First));
+    body.CreateStore(chunk, field(body, region, Current));
+    body.CreateStore(end, field(body, region, Limit));
+
+    llvm::Value* start = body.CreateConstInBoundsGEP1_64(body.getInt8Ty(), chunk, ChunkHeaderSize);
+    body.CreateStore(body.CreateGEP(body.getInt8Ty(), start, bytes), field(body, region, Cursor));
+    body.CreateRet(start);
+    return function;
+}
+
+// ==== Freeing ====
+
+void RegionAllocator::freeChunks(llvm::IRBuilder<>& at, llvm::Value* region, llvm::Value* until) {
+    llvm::Function* function = at.GetInsertBlock()->getParent();
+    llvm::BasicBlock* before = at.GetInsertBlock();
+    llvm::BasicBlock* loop = llvm::BasicBlock::Create(context, "free", function);
+    llvm::BasicBlock* next = llvm::BasicBlock::Create(context, "free.next", function);
+    llvm::BasicBlock* after = llvm::BasicBlock::Create(context, "free.end", function);
+    llvm::Value* current = at.CreateLoad(bytePointer(), field(at, region, Current));
+    at.CreateBr(loop);
+
+    at.SetInsertPoint(loop);
+    llvm::PHINode* chunk = at.CreatePHI(bytePointer(), 2);
+    chunk->addIncoming(current, before);
+    at.CreateCondBr(at.CreateICmpEQ(chunk, until), after, next);
+
+    at.SetInsertPoint(next);
+    llvm::Value* previous = at.CreateLoad(bytePointer(), chunkField(at, chunk, 0));
+    at.CreateCall(libc("free", at.getVoidTy(), {bytePointer()}), {chunk});
+    chunk->addIncoming(previous, next);
+    at.CreateBr(loop);
+    at.SetInsertPoint(after);
+}
+
+llvm::Function* RegionAllocator::reset() {
+    if (llvm::Function* existing = module.getFunction("neoluma.region.reset")) return existing;
+
+    llvm::Function* function = create("neoluma.region.reset", llvm::Type::getVoidTy(context), {pointerTo(regionType())});
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock* rewind = llvm::BasicBlock::Create(context, "rewind", function);
+    llvm::BasicBlock* empty = llvm::BasicBlock::Create(context, "empty", function);
+    llvm::IRBuilder<> body(entry);
+    llvm::Value* region = function->getArg(0);
+
+    llvm::Value* first = body.CreateLoad(bytePointer(), field(body, region, First));
+    body.CreateCondBr(body.CreateIsNull(first), empty, rewind);
+
+    body.SetInsertPoint(rewind);
+    freeChunks(body, region, first);
+    body.CreateStore(first, field(body, region, Current));
+    body.CreateStore(body.CreateConstInBoundsGEP1_64(body.getInt8Ty(), first, ChunkHeaderSize), field(body, region, Cursor));
+    body.CreateStore(body.CreateLoad(bytePointer(), chunkField(body, first, 1)), field(body, region, Limit));
+    body.CreateRetVoid();
+
+    body.SetInsertPoint(empty);
+    body.CreateRetVoid();
+    return function;
+}
+
+llvm::Function* RegionAllocator::release() {
+    if (llvm::Function* existing = module.getFunction("neoluma.region.release")) return existing;
+
+    llvm::Function* function = create("neoluma.region.release", llvm::Type::getVoidTy(context), {pointerTo(regionType())});
+    llvm::IRBuilder<> body(llvm::BasicBlock::Create(context, "entry", function));
+    llvm::Value* region = function->getArg(0);
+    freeChunks(body, region, llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(bytePointer())));
+    begin(body, region);
+    body.CreateRetVoid();
+    return function;
+}
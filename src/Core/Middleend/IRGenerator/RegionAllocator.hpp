@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// LLVM Primitives
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+
+/* Region Allocator is the runtime of the strings Escape Analysis keeps off the heap. Like the Garbage Collector it's
+ * emitted into the modules that use it, with linkonce_odr linkage.
+ *
+ * A region is a stack slot of the function, [current chunk, cursor, limit, first chunk], and owns a chain of chunks
+ * from malloc, each starting with [previous chunk, its limit]. Strings are allocated by bumping the cursor, and freed
+ * all at once:
+ * - reset rewinds to the start of the first chunk and frees the others. A loop body resets its region after every
+ *   iteration, so once the first chunk is big enough an iteration doesn't call malloc at all.
+ * - release frees every chunk, on the way out of the loop or the function.
+ * With `objectHeader` set (the default memory mode), every string gets it in front like the collector's objects do,
+ * marked static, so the collector never looks into a region.
+ */
+struct RegionAllocator {
+    RegionAllocator(llvm::Module& module, llvm::Constant* objectHeader) : module(module), context(module.getContext()), objectHeader(objectHeader) {}
+
+    llvm::Type* regionType(); // [4 x i8*]
+    void begin(llvm::IRBuilderBase& at, llvm::Value* region); // an empty region, its first allocation takes a chunk
+
+    llvm::Function* allocate(); // i8* (region*, i64 size). Inlined, the call is only a new chunk.
+    llvm::Function* reset(); // void (region*)
+    llvm::Function* release(); // void (region*)
+
+private:
+    llvm::Module& module;
+    llvm::LLVMContext& context;
+    llvm::Constant* objectHeader;
+
+    llvm::Type* bytePointer();
+    llvm::Value* field(llvm::IRBuilderBase& at, llvm::Value* region, unsigned index);
+    llvm::Value* chunkField(llvm::IRBuilderBase& at, llvm::Value* chunk, unsigned index); // i8** into the chunk header
+    llvm::Function* create(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters);
+    llvm::FunctionCallee libc(const std::string& name, llvm::Type* result, std::vector<llvm::Type*> parameters);
+
+    llvm::Function* growFunction(); // i8* (region*, i64 bytes): a chunk big enough, `bytes` of it taken
+    void freeChunks(llvm::IRBuilder<>& at, llvm::Value* region, llvm::Value* until); // from the current chunk back to `until`
+};
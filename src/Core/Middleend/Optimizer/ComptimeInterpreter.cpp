@@ -0,0 +1,476 @@
+#include "ComptimeInterpreter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// ==== Entry points ====
+
+std::optional<ComptimeInterpreter::Value> ComptimeInterpreter::evaluateCall(CallExpressionNode* call) {
+    reset();
+    return evalCall(call);
+}
+
+std::optional<ComptimeInterpreter::Value> ComptimeInterpreter::evaluateExpression(ASTNode* node) {
+    reset();
+    return eval(node);
+}
+
+void ComptimeInterpreter::reset() {
+    failure = Failure::None;
+    failedAt = nullptr;
+    fuel = fuelLimit;
+    memoryUsed = 0;
+    frames.clear();
+    frames.emplace_back(1); // the caller's frame has nothing but the globals
+}
+
+std::optional<ComptimeInterpreter::Constant> ComptimeInterpreter::toConstant(const Value& value) {
+    if (auto* integer = std::get_if<Integer>(&value.data)) return *integer;
+    if (auto* real = std::get_if<double>(&value.data)) return *real;
+    if (auto* text = std::get_if<std::string>(&value.data)) return *text;
+    if (auto* boolean = std::get_if<bool>(&value.data)) return *boolean;
+    return std::nullopt;
+}
+
+bool ComptimeInterpreter::isComptime(FunctionNode* function) {
+    if (!function) return false;
+    for (const auto& decorator : function->decorators)
+        if (decorator->callee->type == ASTNodeType::Variable && static_cast<VariableNode*>(decorator->callee.get())->varName == "comptime") return true;
+    return false;
+}
+
+// ==== Sandbox ====
+
+bool ComptimeInterpreter::step(ASTNode* node) {
+    if (fuel == 0) return fail(Failure::OutOfFuel, node);
+    fuel--;
+    return true;
+}
+
+bool ComptimeInterpreter::allocate(size_t bytes, ASTNode* node) {
+    memoryUsed += bytes;
+    if (memoryUsed > memoryLimit) return fail(Failure::OutOfMemory, node);
+    return true;
+}
+
+bool ComptimeInterpreter::fail(Failure reason, ASTNode* node) {
+    // the innermost failure is the one worth reporting
+    if (failure == Failure::None) {
+        failure = reason;
+        failedAt = node;
+    }
+    return false;
+}
+
+// ==== Expressions ====
+
+// Wraps a folder constant into an interpreter value.
+static ComptimeInterpreter::Value fromConstant(const ComptimeInterpreter::Constant& constant) {
+    return std::visit([](const auto& v) { return ComptimeInterpreter::Value{v}; }, constant);
+}
+
+std::optional<ComptimeInterpreter::Value> ComptimeInterpreter::eval(ASTNode* node) {
+    if (!node || !step(node)) return std::nullopt;
+
+    switch (node->type) {
+        case ASTNodeType::Literal: {
+            auto* literal = static_cast<LiteralNode*>(node);
+            if (literal->literalType == ASTLiteralType::Null) return Value{};
+
+            bool overflow = false;
+            std::optional<Constant> constant = ConstantFolder::parseLiteral(literal, overflow);
+            if (!constant) {
+                fail(overflow ? Failure::Runtime : Failure::Unsupported, node);
+                return std::nullopt;
+            }
+            if (auto* text = std::get_if<std::string>(&*constant); text && !allocate(text->size(), node)) return std::nullopt;
+            return fromConstant(*constant);
+        }
+        case ASTNodeType::Variable: {
+            const std::string& name = static_cast<VariableNode*>(node)->varName;
+            if (Value* value = lookup(name)) return *value;
+            if (const Constant* constant = globals ? globals(name) : nullptr) return fromConstant(*constant);
+            fail(Failure::Unsupported, node); // a runtime variable, a function used as a value, ...
+            return std::nullopt;
+        }
+        case ASTNodeType::BinaryOperation: return evalBinary(static_cast<BinaryOperationNode*>(node));
+        case ASTNodeType::UnaryOperation: {
+            auto* unary = static_cast<UnaryOperationNode*>(node);
+            std::optional<Value> operand = eval(unary->operand.get());
+            if (!operand) return std::nullopt;
+
+            std::optional<Constant> constant = toConstant(*operand);
+            std::optional<Constant> result = constant && unary->inferredType ? ConstantFolder::evaluateUnary(unary->value, *constant, unary->inferredType) : std::nullopt;
+            if (!result) {
+                fail(Failure::Unsupported, node);
+                return std::nullopt;
+            }
+            if (auto* integer = std::get_if<Integer>(&*result); integer && !ConstantFolder::fitsInto(*integer, unary->inferredType)) {
+                fail(Failure::Runtime, node);
+                return std::nullopt;
+            }
+            return fromConstant(*result);
+        }
+        case ASTNodeType::CallExpression: return evalCall(static_cast<CallExpressionNode*>(node));
+        case ASTNodeType::MemberAccess: {
+            // only namespace calls like `std.math.abs(x)`, which Semantic Analysis resolved to a function
+            auto* access = static_cast<MemberAccessNode*>(node);
+            if (access->val->type == ASTNodeType::CallExpression && static_cast<CallExpressionNode*>(access->val.get())->resolvedFunction)
+                return evalCall(static_cast<CallExpressionNode*>(access->val.get()));
+            fail(Failure::Unsupported, node);
+            return std::nullopt;
+        }
+        case ASTNodeType::Array: {
+            auto* array = static_cast<ArrayNode*>(node);
+            if (!allocate(array->elements.size() * sizeof(Value), node)) return std::nullopt;
+
+            auto elements = std::make_shared<std::vector<Value>>();
+            elements->reserve(array->elements.size());
+            for (const auto& element : array->elements) {
+                std::optional<Value> value = eval(element.get());
+                if (!value) return std::nullopt;
+                elements->push_back(std::move(*value));
+            }
+            return Value{elements};
+        }
+        default:
+            fail(Failure::Unsupported, node);
+            return std::nullopt;
+    }
+}
+
+std::optional<ComptimeInterpreter::Value> ComptimeInterpreter::evalBinary(BinaryOperationNode* node) {
+    const std::string& op = node->value;
+    std::optional<Value> left = eval(node->leftOperand.get());
+    if (!left) return std::nullopt;
+
+    // short-circuit, the right side may not even be evaluable
+    if ((op == "&&" || op == "and" || op == "||" || op == "or") && std::holds_alternative<bool>(left->data)) {
+        bool isOr = op == "||" || op == "or";
+        if (std::get<bool>(left->data) == isOr) return left;
+        return eval(node->rightOperand.get());
+    }
+
+    std::optional<Value> right = eval(node->rightOperand.get());
+    if (!right) return std::nullopt;
+
+    // comparisons with null, which has no constant form
+    bool leftNull = std::holds_alternative<std::monostate>(left->data), rightNull = std::holds_alternative<std::monostate>(right->data);
+    if ((op == "==" || op == "!=") && (leftNull || rightNull)) return Value{(leftNull && rightNull) == (op == "==")};
+
+    std::optional<Constant> a = toConstant(*left), b = toConstant(*right);
+    if (!a || !b || !node->leftOperand->inferredType || !node->inferredType) {
+        fail(Failure::Unsupported, node);
+        return std::nullopt;
+    }
+
+    bool overflow = false;
+    std::optional<Constant> result = ConstantFolder::evaluateBinary(op, *a, *b, node->leftOperand->inferredType, node->inferredType, overflow);
+    if (!result) {
+        // integer operations only fail on overflow, division by zero or a bad shift, all runtime errors
+        fail(std::holds_alternative<Integer>(*a) ? Failure::Runtime : Failure::Unsupported, node);
+        return std::nullopt;
+    }
+    if (auto* integer = std::get_if<Integer>(&*result); integer && !ConstantFolder::fitsInto(*integer, node->inferredType)) {
+        fail(Failure::Runtime, node);
+        return std::nullopt;
+    }
+    if (auto* text = std::get_if<std::string>(&*result); text && !allocate(text->size(), node)) return std::nullopt;
+    return fromConstant(*result);
+}
+
+std::optional<ComptimeInterpreter::Value> ComptimeInterpreter::evalCall(CallExpressionNode* node) {
+    // lambdas and dynamic calls have no function to run
+    if (!node->resolvedFunction) {
+        fail(Failure::Unsupported, node);
+        return std::nullopt;
+    }
+
+    std::vector<Value> arguments;
+    arguments.reserve(node->arguments.size());
+    for (const auto& argument : node->arguments) {
+        std::optional<Value> value = eval(argument.get());
+        if (!value) return std::nullopt;
+        arguments.push_back(std::move(*value));
+    }
+    return call(node->resolvedFunction, arguments, node);
+}
+
+std::optional<ComptimeInterpreter::Value> ComptimeInterpreter::call(FunctionNode* function, std::vector<Value>& arguments, ASTNode* site) {
+    if (onCall) onCall(function);
+    if (function->isIntrinsic && !function->isAsync) return callIntrinsic(function, arguments, site);
+    if (!function->body || function->isAsync) { // a task is a runtime value
+        fail(Failure::Unsupported, site);
+        return std::nullopt;
+    }
+    if (static_cast<int>(frames.size()) > callDepthLimit) {
+        fail(Failure::TooDeep, site);
+        return std::nullopt;
+    }
+
+    frames.emplace_back(1);
+    for (size_t i = 0; i < function->parameters.size(); i++) {
+        ParameterNode* parameter = function->parameters[i].get();
+        if (i < arguments.size()) declare(parameter->parameterName, std::move(arguments[i]));
+        else {
+            std::optional<Value> value = eval(parameter->defaultValue.get());
+            if (!value) {
+                frames.pop_back();
+                return std::nullopt;
+            }
+            declare(parameter->parameterName, std::move(*value));
+        }
+    }
+
+    returnValue = Value{};
+    Flow flow = execBlock(function->body.get());
+    frames.pop_back();
+
+    if (flow == Flow::Failed) return std::nullopt;
+    return flow == Flow::Return ? std::move(returnValue) : Value{};
+}
+
+std::optional<ComptimeInterpreter::Value> ComptimeInterpreter::callIntrinsic(FunctionNode* function, std::vector<Value>& arguments, ASTNode* site) {
+    // only the pure parts of std run at compile time: std.math and std.iter.range
+    const std::string& module = function->namespaceName; // the namespace, a file of the same name elsewhere isn't std
+    const std::string& name = function->name;
+
+    // arguments are typed, but a dynamic value can still slip in
+    for (const Value& argument : arguments)
+        if (!std::holds_alternative<Integer>(argument.data) && !std::holds_alternative<double>(argument.data)) {
+            fail(Failure::Unsupported, site);
+            return std::nullopt;
+        }
+    bool integers = std::all_of(arguments.begin(), arguments.end(), [](const Value& v) { return std::holds_alternative<Integer>(v.data); });
+    bool reals = std::all_of(arguments.begin(), arguments.end(), [](const Value& v) { return std::holds_alternative<double>(v.data); });
+
+    if (module == "std.iter" && name == "range" && integers && !arguments.empty()) {
+        Integer start = 0, stop = 0, step = 1;
+        if (arguments.size() == 1) stop = std::get<Integer>(arguments[0].data);
+        else {
+            start = std::get<Integer>(arguments[0].data);
+            stop = std::get<Integer>(arguments[1].data);
+            if (arguments.size() == 3) step = std::get<Integer>(arguments[2].data);
+        }
+        if (step == 0) {
+            fail(Failure::Runtime, site);
+            return std::nullopt;
+        }
+
+        Integer count = step > 0 ? (stop > start ? (stop - start + step - 1) / step : 0) : (start > stop ? (start - stop - step - 1) / -step : 0);
+        if (count > static_cast<Integer>(memoryLimit / sizeof(Value)) || !allocate(static_cast<size_t>(count) * sizeof(Value), site)) {
+            fail(Failure::OutOfMemory, site);
+            return std::nullopt;
+        }
+
+        auto elements = std::make_shared<std::vector<Value>>();
+        elements->reserve(static_cast<size_t>(count));
+        for (Integer i = 0, value = start; i < count; i++, value += step) elements->push_back(Value{value});
+        return Value{elements};
+    }
+
+    if (module == "std.math" && !arguments.empty()) {
+        // integer overloads
+        if (integers) {
+            auto integer = [&](size_t i) { return std::get<Integer>(arguments[i].data); };
+            std::optional<Integer> result;
+            if (name == "abs") result = integer(0) < 0 ? -integer(0) : integer(0);
+            else if (name == "min") result = std::min(integer(0), integer(1));
+            else if (name == "max") result = std::max(integer(0), integer(1));
+            else if (name == "clamp") result = std::clamp(integer(0), integer(1), std::max(integer(1), integer(2)));
+            if (result) {
+                // abs of the smallest int64 doesn't fit, the native call would wrap around
+                if (!ConstantFolder::fitsInto(*result, site->inferredType)) {
+                    fail(Failure::Runtime, site);
+                    return std::nullopt;
+                }
+                return Value{*result};
+            }
+        } else if (reals) {
+            auto real = [&](size_t i) { return std::get<double>(arguments[i].data); };
+            double result = 0;
+            if (name == "abs") result = std::fabs(real(0));
+            else if (name == "min") result = std::min(real(0), real(1));
+            else if (name == "max") result = std::max(real(0), real(1));
+            else if (name == "clamp") result = std::clamp(real(0), real(1), std::max(real(1), real(2)));
+            else if (name == "sqrt") result = std::sqrt(real(0));
+            else if (name == "pow") result = std::pow(real(0), real(1));
+            else if (name == "floor") result = std::floor(real(0));
+            else if (name == "ceil") result = std::ceil(real(0));
+            else if (name == "round") result = std::round(real(0));
+            else if (name == "sin") result = std::sin(real(0));
+            else if (name == "cos") result = std::cos(real(0));
+            else if (name == "tan") result = std::tan(real(0));
+            else {
+                fail(Failure::Unsupported, site);
+                return std::nullopt;
+            }
+            if (!std::isfinite(result)) {
+                fail(Failure::Runtime, site);
+                return std::nullopt;
+            }
+            return Value{static_cast<double>(static_cast<float>(result))}; // std.math works on float
+        }
+    }
+
+    // I/O, time, randomness: none of it belongs in a build
+    fail(Failure::Unsupported, site);
+    return std::nullopt;
+}
+
+// ==== Statements ====
+
+ComptimeInterpreter::Flow ComptimeInterpreter::execBlock(ASTNode* block) {
+    if (!block) return Flow::Normal;
+    if (block->type != ASTNodeType::Block) return exec(block);
+
+    frames.back().emplace_back();
+    Flow flow = Flow::Normal;
+    for (const auto& statement : static_cast<BlockNode*>(block)->statements) {
+        flow = exec(statement.get());
+        if (flow != Flow::Normal) break;
+    }
+    frames.back().pop_back();
+    return flow;
+}
+
+ComptimeInterpreter::Flow ComptimeInterpreter::exec(ASTNode* statement) {
+    if (!statement) return Flow::Normal;
+    if (!step(statement)) return Flow::Failed;
+
+    switch (statement->type) {
+        case ASTNodeType::Block: return execBlock(statement);
+        case ASTNodeType::Declaration: {
+            auto* node = static_cast<DeclarationNode*>(statement);
+            Value value;
+            if (node->value) {
+                std::optional<Value> result = eval(node->value.get());
+                if (!result) return Flow::Failed;
+                value = std::move(*result);
+            }
+            declare(node->variable->varName, std::move(value));
+            return Flow::Normal;
+        }
+        case ASTNodeType::Assignment: {
+            auto* node = static_cast<AssignmentNode*>(statement);
+            if (node->variable->type != ASTNodeType::Variable) return halt(Failure::Unsupported, statement);
+
+            Value* target = lookup(static_cast<VariableNode*>(node->variable.get())->varName);
+            if (!target) return halt(Failure::Unsupported, statement); // not a local of the evaluated code
+            std::optional<Value> value = eval(node->value.get());
+            if (!value) return Flow::Failed;
+
+            if (node->op == "=") {
+                *target = std::move(*value);
+                return Flow::Normal;
+            }
+
+            // x += y is x = x + y
+            std::optional<Constant> a = toConstant(*target), b = toConstant(*value);
+            const Type* type = node->variable->inferredType;
+            bool overflow = false;
+            std::optional<Constant> result = a && b && type ? ConstantFolder::evaluateBinary(node->op.substr(0, node->op.size() - 1), *a, *b, type, type, overflow) : std::nullopt;
+            if (!result) return halt(a && std::holds_alternative<Integer>(*a) ? Failure::Runtime : Failure::Unsupported, statement);
+            if (auto* integer = std::get_if<Integer>(&*result); integer && !ConstantFolder::fitsInto(*integer, type)) return halt(Failure::Runtime, statement);
+            if (auto* text = std::get_if<std::string>(&*result); text && !allocate(text->size(), statement)) return Flow::Failed;
+            *target = fromConstant(*result);
+            return Flow::Normal;
+        }
+        case ASTNodeType::IfStatement: {
+            auto* node = static_cast<IfNode*>(statement);
+            std::optional<Value> condition = eval(node->condition.get());
+            if (!condition) return Flow::Failed;
+            if (!std::holds_alternative<bool>(condition->data)) return halt(Failure::Unsupported, node->condition.get());
+            return execBlock(std::get<bool>(condition->data) ? node->thenBlock.get() : node->elseBlock.get());
+        }
+        case ASTNodeType::WhileLoop: {
+            auto* node = static_cast<WhileLoopNode*>(statement);
+            while (true) {
+                std::optional<Value> condition = eval(node->condition.get());
+                if (!condition) return Flow::Failed;
+                if (!std::holds_alternative<bool>(condition->data)) return halt(Failure::Unsupported, node->condition.get());
+                if (!std::get<bool>(condition->data)) return Flow::Normal;
+
+                Flow flow = execBlock(node->body.get());
+                if (flow == Flow::Break) return Flow::Normal;
+                if (flow == Flow::Return || flow == Flow::Failed) return flow;
+            }
+        }
+        case ASTNodeType::ForLoop: {
+            auto* node = static_cast<ForLoopNode*>(statement);
+            if (!node->unpacked.empty()) return halt(Failure::Unsupported, node); // no value here is a tuple
+            std::optional<Value> iterable = eval(node->iterable.get());
+            if (!iterable) return Flow::Failed;
+
+            // strings are iterated by character
+            std::vector<Value> characters;
+            const std::vector<Value>* items = nullptr;
+            if (auto* array = std::get_if<Array>(&iterable->data)) items = array->get();
+            else if (auto* text = std::get_if<std::string>(&iterable->data)) {
+                for (char c : *text) characters.push_back(Value{std::string(1, c)});
+                items = &characters;
+            }
+            else return halt(Failure::Unsupported, node->iterable.get());
+
+            // the array is held by `iterable`, so changes through the loop variable's scope can't free it
+            for (size_t i = 0; i < items->size(); i++) {
+                frames.back().emplace_back();
+                declare(node->variable->varName, (*items)[i]);
+                Flow flow = execBlock(node->body.get());
+                frames.back().pop_back();
+                if (flow == Flow::Break) break;
+                if (flow == Flow::Return || flow == Flow::Failed) return flow;
+            }
+            return Flow::Normal;
+        }
+        case ASTNodeType::Switch: {
+            auto* node = static_cast<SwitchNode*>(statement);
+            std::optional<Value> value = eval(node->expression.get());
+            if (!value) return Flow::Failed;
+
+            for (const auto& c : node->cases) {
+                std::optional<Value> candidate = eval(c->condition.get());
+                if (!candidate) return Flow::Failed;
+                if (equals(*value, *candidate)) return execBlock(c->body.get());
+            }
+            return node->defaultCase ? execBlock(node->defaultCase->body.get()) : Flow::Normal;
+        }
+        case ASTNodeType::ReturnStatement: {
+            auto* node = static_cast<ReturnStatementNode*>(statement);
+            returnValue = Value{};
+            if (node->expression) {
+                std::optional<Value> value = eval(node->expression.get());
+                if (!value) return Flow::Failed;
+                returnValue = std::move(*value);
+            }
+            return Flow::Return;
+        }
+        case ASTNodeType::BreakStatement: return Flow::Break;
+        case ASTNodeType::ContinueStatement: return Flow::Continue;
+        case ASTNodeType::ThrowStatement: return halt(Failure::Runtime, statement);
+
+        // nested declarations and error handling stay a runtime matter
+        case ASTNodeType::Function: case ASTNodeType::Class: case ASTNodeType::Enum: case ASTNodeType::Interface:
+        case ASTNodeType::Namespace: case ASTNodeType::Decorator: case ASTNodeType::TryCatch:
+            return halt(Failure::Unsupported, statement);
+
+        default: return eval(statement) ? Flow::Normal : Flow::Failed;
+    }
+}
+
+// ==== Helpers ====
+
+ComptimeInterpreter::Value* ComptimeInterpreter::lookup(const std::string& name) {
+    // only the current frame: functions don't see their caller's locals
+    auto& scopes = frames.back();
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope)
+        if (auto it = scope->find(name); it != scope->end()) return &it->second;
+    return nullptr;
+}
+
+bool ComptimeInterpreter::equals(const Value& a, const Value& b) {
+    if (a.data.index() != b.data.index()) return false;
+    if (auto* array = std::get_if<Array>(&a.data)) return *array == std::get<Array>(b.data); // same array
+    if (std::holds_alternative<std::monostate>(a.data)) return true;
+    return toConstant(a) == toConstant(b);
+}
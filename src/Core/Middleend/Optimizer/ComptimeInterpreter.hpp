@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "ConstantFolder.hpp"
+
+/* Comptime Interpreter runs analyzed Neoluma code inside the compiler: `@comptime` calls and `const` initializers
+ * that plain folding can't reduce. It's a tree-walking interpreter over the typed AST, sandboxed on purpose:
+ * only pure code runs (no I/O, no classes, no lambdas), every step burns fuel and every string or array counts
+ * against a memory budget, so a runaway `@comptime` loop fails the build instead of hanging it.
+ */
+struct ComptimeInterpreter {
+    // Limits of a single evaluation
+    uint64_t fuelLimit = 1'000'000; // evaluated nodes
+    size_t memoryLimit = 64 * 1024 * 1024; // bytes of strings and arrays
+    int callDepthLimit = 256;
+
+    using Integer = ConstantFolder::Integer;
+    using Constant = ConstantFolder::Constant;
+
+    struct Value;
+    using Array = std::shared_ptr<std::vector<Value>>; // arrays are references, like at runtime
+
+    // monostate stands for null and for the result of void functions
+    struct Value {
+        std::variant<std::monostate, Integer, double, std::string, bool, Array> data;
+    };
+
+    enum class Failure { None, OutOfFuel, OutOfMemory, TooDeep, Unsupported, Runtime };
+    Failure failure = Failure::None;
+    ASTNode* failedAt = nullptr; // node that couldn't be evaluated
+
+    // Lookup of constants declared outside the evaluated code, nullptr if the name isn't a known constant.
+    std::function<const Constant*(const std::string&)> globals;
+    // Told about every function before it runs, since the result depends on its body.
+    std::function<void(FunctionNode*)> onCall;
+
+    // Entry points. Both return std::nullopt on failure, see `failure` and `failedAt`.
+    std::optional<Value> evaluateCall(CallExpressionNode* call);
+    std::optional<Value> evaluateExpression(ASTNode* node);
+
+    static std::optional<Constant> toConstant(const Value& value); // std::nullopt for null and arrays
+    static bool isComptime(FunctionNode* function); // marked with @comptime
+
+private:
+    enum class Flow { Normal, Return, Break, Continue, Failed };
+
+    // Every call gets a frame, every block a scope inside of it
+    using Scope = std::unordered_map<std::string, Value>;
+    std::vector<std::vector<Scope>> frames;
+    Value returnValue;
+
+    uint64_t fuel = 0;
+    size_t memoryUsed = 0;
+
+    void reset();
+    bool step(ASTNode* node); // spends one unit of fuel
+    bool allocate(size_t bytes, ASTNode* node);
+    bool fail(Failure reason, ASTNode* node); // records the failure, always false
+    Flow halt(Failure reason, ASTNode* node) { fail(reason, node); return Flow::Failed; }
+
+    std::optional<Value> eval(ASTNode* node);
+    std::optional<Value> evalBinary(BinaryOperationNode* node);
+    std::optional<Value> evalCall(CallExpressionNode* node);
+    std::optional<Value> call(FunctionNode* function, std::vector<Value>& arguments, ASTNode* site);
+    std::optional<Value> callIntrinsic(FunctionNode* function, std::vector<Value>& arguments, ASTNode* site);
+    Flow exec(ASTNode* statement);
+    Flow execBlock(ASTNode* block);
+
+    Value* lookup(const std::string& name);
+    void declare(const std::string& name, Value value) { frames.back().back()[name] = std::move(value); }
+    static bool equals(const Value& a, const Value& b);
+};
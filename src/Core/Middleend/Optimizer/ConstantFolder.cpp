@@ -0,0 +1,584 @@
+#include "ConstantFolder.hpp"
+
+#include <cmath>
+#include <format>
+
+#include "ComptimeInterpreter.hpp"
+#include "Core/Compiler.hpp"
+#include "Core/Frontend/Parser/ASTBuilder.hpp"
+
+// ==== Integer ranges ====
+
+// Width in bits of a sized integer type, 0 for anything else.
+static int integerWidth(const Type* type) {
+    if (!type || type->kind != Type::Kind::Primitive) return 0;
+    switch (type->primitive) {
+        case ResolvedType::Int8: case ResolvedType::UInt8: return 8;
+        case ResolvedType::Int16: case ResolvedType::UInt16: return 16;
+        case ResolvedType::Int: case ResolvedType::UInt: return 32;
+        case ResolvedType::Int64: case ResolvedType::UInt64: return 64;
+        case ResolvedType::Int128: case ResolvedType::UInt128: return 128;
+        default: return 0;
+    }
+}
+
+static bool isUnsigned(const Type* type) {
+    return type->isPrimitive(ResolvedType::UInt8) || type->isPrimitive(ResolvedType::UInt16) || type->isPrimitive(ResolvedType::UInt) ||
+           type->isPrimitive(ResolvedType::UInt64) || type->isPrimitive(ResolvedType::UInt128);
+}
+
+// Smallest and largest value of a sized integer type, uint128 is capped at the largest signed 128-bit value.
+static std::pair<__int128, __int128> integerRange(const Type* type) {
+    int width = integerWidth(type);
+    const __int128 max128 = static_cast<__int128>(~static_cast<unsigned __int128>(0) >> 1);
+    if (isUnsigned(type)) return {0, width == 128 ? max128 : (static_cast<__int128>(1) << width) - 1};
+    if (width == 128) return {-max128 - 1, max128};
+    return {-(static_cast<__int128>(1) << (width - 1)), (static_cast<__int128>(1) << (width - 1)) - 1};
+}
+
+// Turns a compile-time result into AST: literals, and array literals of them.
+static MemoryPtr<ASTNode> makeValue(const ComptimeInterpreter::Value& value, const Type* type, ASTNode* position) {
+    if (std::holds_alternative<std::monostate>(value.data)) {
+        auto literal = ASTBuilder::createLiteral("null", ASTLiteralType::Null);
+        literal->inferredType = type;
+        literal->line = position->line;
+        literal->column = position->column;
+        literal->filePath = position->filePath;
+        return literal;
+    }
+
+    if (auto* array = std::get_if<ComptimeInterpreter::Array>(&value.data)) {
+        const Type* elementType = type && type->kind == Type::Kind::Array ? type->element() : nullptr;
+        std::vector<MemoryPtr<ASTNode>> elements;
+        elements.reserve((*array)->size());
+        for (const auto& element : **array) elements.push_back(makeValue(element, elementType, position));
+
+        auto node = ASTBuilder::createArray(std::move(elements));
+        node->inferredType = type;
+        node->line = position->line;
+        node->column = position->column;
+        node->filePath = position->filePath;
+        return node;
+    }
+
+    return ConstantFolder::makeLiteral(*ComptimeInterpreter::toConstant(value), type, position);
+}
+
+// ==== Main function ====
+
+ConstantFolder::ConstantFolder() : interpreter(makeMemoryPtr<ComptimeInterpreter>()) {
+    // evaluated functions only see module-level constants, never the locals around the call
+    interpreter->globals = [this](const std::string& name) -> const Constant* {
+        if (scopes.empty()) return nullptr;
+        auto it = scopes.front().find(name);
+        return it != scopes.front().end() && it->second ? &*it->second : nullptr;
+    };
+    interpreter->onCall = [this](FunctionNode* function) { if (onComptimeCall) onComptimeCall(function); };
+}
+
+ConstantFolder::~ConstantFolder() = default;
+
+void ConstantFolder::foldProgram(Program& program) {
+    // same modules as Semantic Analysis, others have no types to fold with
+    for (ModuleId id : program.order) {
+        if (id < 0 || id >= static_cast<ModuleId>(program.moduleInfos.size())) continue;
+        if (ModuleNode* module = program.moduleInfos[id].module) foldModule(module);
+    }
+}
+
+void ConstantFolder::foldModule(ModuleNode* module) {
+    pushScope();
+    foldTopLevel(module->body);
+    popScope();
+}
+
+// ==== Statements ====
+
+void ConstantFolder::foldTopLevel(std::vector<MemoryPtr<ASTNode>>& body) {
+    // constants first, so functions above their declaration still see them
+    for (auto& statement : body)
+        if (statement->type == ASTNodeType::Declaration) foldDeclaration(static_cast<DeclarationNode*>(statement.get()));
+    for (auto& statement : body)
+        if (statement->type != ASTNodeType::Declaration) foldStatement(statement);
+}
+
+void ConstantFolder::foldBlock(BlockNode* block) {
+    if (!block) return;
+    pushScope();
+    for (auto& statement : block->statements) foldStatement(statement);
+    popScope();
+}
+
+void ConstantFolder::foldStatement(MemoryPtr<ASTNode>& statement) {
+    if (!statement) return;
+
+    switch (statement->type) {
+        case ASTNodeType::Block: foldBlock(static_cast<BlockNode*>(statement.get())); break;
+        case ASTNodeType::Declaration: foldDeclaration(static_cast<DeclarationNode*>(statement.get())); break;
+        case ASTNodeType::Assignment: foldExpression(static_cast<AssignmentNode*>(statement.get())->value); break; // the target stays a variable
+        case ASTNodeType::Function: foldFunction(static_cast<FunctionNode*>(statement.get())); break;
+        case ASTNodeType::Class: {
+            auto* node = static_cast<ClassNode*>(statement.get());
+            pushScope();
+            for (auto& field : node->fields) foldDeclaration(field.get());
+            if (node->constructor) foldFunction(node->constructor.get());
+            for (auto& method : node->methods) foldFunction(method.get());
+            popScope();
+            break;
+        }
+        case ASTNodeType::Decorator: {
+            auto* node = static_cast<DecoratorNode*>(statement.get());
+            pushScope();
+            for (auto& param : node->parameters) shadow(param->parameterName);
+            foldBlock(node->body.get());
+            popScope();
+            break;
+        }
+        case ASTNodeType::Namespace: {
+            pushScope();
+            foldTopLevel(static_cast<NamespaceNode*>(statement.get())->body);
+            popScope();
+            break;
+        }
+        case ASTNodeType::IfStatement: {
+            auto* node = static_cast<IfNode*>(statement.get());
+            foldExpression(node->condition);
+            foldStatement(node->thenBlock);
+            foldStatement(node->elseBlock);
+            break;
+        }
+        case ASTNodeType::Switch: {
+            auto* node = static_cast<SwitchNode*>(statement.get());
+            foldExpression(node->expression);
+            for (auto& c : node->cases) {
+                foldExpression(c->condition);
+                foldStatement(c->body);
+            }
+            if (node->defaultCase) foldStatement(node->defaultCase->body);
+            break;
+        }
+        case ASTNodeType::WhileLoop: {
+            auto* node = static_cast<WhileLoopNode*>(statement.get());
+            foldExpression(node->condition);
+            foldBlock(node->body.get());
+            break;
+        }
+        case ASTNodeType::ForLoop: {
+            auto* node = static_cast<ForLoopNode*>(statement.get());
+            foldExpression(node->iterable);
+            pushScope();
+            shadow(node->variable->varName);
+            for (auto& variable : node->unpacked) shadow(variable->varName);
+            foldBlock(node->body.get());
+            popScope();
+            break;
+        }
+        case ASTNodeType::TryCatch: {
+            auto* node = static_cast<TryCatchNode*>(statement.get());
+            foldBlock(node->tryBlock.get());
+            pushScope();
+            if (node->exception) shadow(node->exception->varName);
+            foldBlock(node->catchBlock.get());
+            popScope();
+            break;
+        }
+        case ASTNodeType::ReturnStatement: foldExpression(static_cast<ReturnStatementNode*>(statement.get())->expression); break;
+        case ASTNodeType::ThrowStatement: foldExpression(static_cast<ThrowStatementNode*>(statement.get())->expression); break;
+        case ASTNodeType::Enum: case ASTNodeType::Interface: case ASTNodeType::Import: case ASTNodeType::Preprocessor:
+        case ASTNodeType::BreakStatement: case ASTNodeType::ContinueStatement:
+            break;
+        default: foldExpression(statement); break;
+    }
+}
+
+void ConstantFolder::foldFunction(FunctionNode* node) {
+    pushScope();
+    for (auto& param : node->parameters) {
+        foldExpression(param->defaultValue);
+        shadow(param->parameterName);
+    }
+    foldBlock(node->body.get());
+    popScope();
+}
+
+void ConstantFolder::foldDeclaration(DeclarationNode* node) {
+    std::optional<Constant> value = foldExpression(node->value);
+
+    bool isConst = false;
+    for (auto& modifier : node->modifiers) if (modifier->modifier == ASTModifierType::Const) isConst = true;
+
+    // a const initializer that folding couldn't reduce (a call, a loop inside a function) may still run at compile time.
+    // Unlike @comptime it's not required to, so a failure just leaves the initializer to the runtime.
+    // Iterators stay lazy, they're never turned into the values they'd give.
+    const Type* type = node->value ? node->value->inferredType : nullptr;
+    bool isIterator = type && type->kind == Type::Kind::Iterator;
+    if (isConst && !value && !isIterator && node->value && node->value->type != ASTNodeType::Literal) {
+        if (auto result = interpreter->evaluateExpression(node->value.get()); result && !std::holds_alternative<std::monostate>(result->data)) {
+            node->value = makeValue(*result, node->value->inferredType, node->value.get());
+            value = ComptimeInterpreter::toConstant(*result);
+        }
+    }
+
+    // only constants are propagated: a variable may be reassigned anywhere after this
+    if (isConst && value && !node->isNullable) scopes.back()[node->variable->varName] = std::move(value);
+    else shadow(node->variable->varName);
+}
+
+// ==== Expressions ====
+
+std::optional<ConstantFolder::Constant> ConstantFolder::foldExpression(MemoryPtr<ASTNode>& node, bool checkRange) {
+    if (!node) return std::nullopt;
+
+    std::optional<Constant> value;
+    switch (node->type) {
+        case ASTNodeType::Literal: {
+            // the values of an interpolation fold on their own, the text is still built at runtime
+            for (auto& interpolation : static_cast<LiteralNode*>(node.get())->interpolations) foldExpression(interpolation);
+            value = literalValue(static_cast<LiteralNode*>(node.get()));
+            if (value && checkRange && std::holds_alternative<Integer>(*value) && !fitsInto(std::get<Integer>(*value), node->inferredType)) {
+                reportOverflow(node.get(), node->value, node->inferredType);
+                return std::nullopt;
+            }
+            return value; // already a literal
+        }
+        case ASTNodeType::Variable: {
+            const Constant* constant = findConstant(static_cast<VariableNode*>(node.get())->varName);
+            if (!constant) return std::nullopt;
+            value = *constant;
+            break;
+        }
+        case ASTNodeType::BinaryOperation: {
+            auto* binary = static_cast<BinaryOperationNode*>(node.get());
+            const std::string& op = binary->value;
+            std::optional<Constant> left = foldExpression(binary->leftOperand);
+            std::optional<Constant> right = foldExpression(binary->rightOperand);
+
+            // short-circuiting with a known left side: `false && x` is false, `true && x` is just x
+            bool isAnd = op == "&&" || op == "and";
+            bool isOr = op == "||" || op == "or";
+            if ((isAnd || isOr) && left && std::holds_alternative<bool>(*left)) {
+                bool decided = std::get<bool>(*left) == isOr;
+                if (decided) value = left;
+                else if (binary->rightOperand->inferredType && binary->rightOperand->inferredType->isPrimitive(ResolvedType::Bool)) {
+                    node = std::move(binary->rightOperand);
+                    return right;
+                }
+                break;
+            }
+
+            if (left && right) value = foldBinary(binary, *left, *right);
+            break;
+        }
+        case ASTNodeType::UnaryOperation: {
+            auto* unary = static_cast<UnaryOperationNode*>(node.get());
+            std::optional<Constant> operand = foldExpression(unary->operand, unary->value != "-");
+            if (operand && unary->inferredType) value = evaluateUnary(unary->value, *operand, unary->inferredType);
+            break;
+        }
+        case ASTNodeType::CallExpression: {
+            // the callee is a name, never a value to fold
+            auto* call = static_cast<CallExpressionNode*>(node.get());
+            for (auto& argument : call->arguments) foldExpression(argument);
+            if (ComptimeInterpreter::isComptime(call->resolvedFunction)) return foldComptimeCall(node, call);
+            return std::nullopt;
+        }
+        case ASTNodeType::MemberAccess: {
+            auto* access = static_cast<MemberAccessNode*>(node.get());
+            // `a.b.f(x)` with f resolved through the namespace tree, the whole chain is the call
+            if (access->val->type == ASTNodeType::CallExpression) {
+                auto* call = static_cast<CallExpressionNode*>(access->val.get());
+                for (auto& argument : call->arguments) foldExpression(argument);
+                if (ComptimeInterpreter::isComptime(call->resolvedFunction)) return foldComptimeCall(node, call);
+            }
+            foldExpression(access->parent);
+            return std::nullopt;
+        }
+        case ASTNodeType::Array: for (auto& element : static_cast<ArrayNode*>(node.get())->elements) foldExpression(element); return std::nullopt;
+        case ASTNodeType::Set: for (auto& element : static_cast<SetNode*>(node.get())->elements) foldExpression(element); return std::nullopt;
+        case ASTNodeType::Tuple: for (auto& element : static_cast<TupleNode*>(node.get())->elements) foldExpression(element); return std::nullopt;
+        case ASTNodeType::Dict: {
+            for (auto& [key, val] : static_cast<DictNode*>(node.get())->elements) {
+                foldExpression(key);
+                foldExpression(val);
+            }
+            return std::nullopt;
+        }
+        case ASTNodeType::Result: {
+            auto* result = static_cast<ResultNode*>(node.get());
+            foldExpression(result->t);
+            foldExpression(result->e);
+            return std::nullopt;
+        }
+        case ASTNodeType::Lambda: {
+            auto* lambda = static_cast<LambdaNode*>(node.get());
+            pushScope();
+            for (auto& param : lambda->params)
+                if (param->type == ASTNodeType::Variable) shadow(static_cast<VariableNode*>(param.get())->varName);
+            foldStatement(lambda->body);
+            popScope();
+            return std::nullopt;
+        }
+        default: return std::nullopt;
+    }
+
+    if (!value) return std::nullopt;
+    if (checkRange && std::holds_alternative<Integer>(*value) && !fitsInto(std::get<Integer>(*value), node->inferredType)) {
+        reportOverflow(node.get(), integerToString(std::get<Integer>(*value)), node->inferredType);
+        return std::nullopt;
+    }
+
+    node = makeLiteral(*value, node->inferredType, node.get());
+    return value;
+}
+
+std::optional<ConstantFolder::Constant> ConstantFolder::foldBinary(BinaryOperationNode* node, const Constant& left, const Constant& right) {
+    if (!node->leftOperand->inferredType || !node->inferredType) return std::nullopt;
+
+    bool overflow = false;
+    std::optional<Constant> result = evaluateBinary(node->value, left, right, node->leftOperand->inferredType, node->inferredType, overflow);
+    if (overflow)
+        reportOverflow(node, std::format("{} {} {}", integerToString(std::get<Integer>(left)), node->value, integerToString(std::get<Integer>(right))), node->inferredType);
+    return result;
+}
+
+std::optional<ConstantFolder::Constant> ConstantFolder::literalValue(LiteralNode* node) {
+    bool overflow = false;
+    std::optional<Constant> value = parseLiteral(node, overflow);
+    if (overflow) reportOverflow(node, node->value, node->inferredType);
+    return value;
+}
+
+std::optional<ConstantFolder::Constant> ConstantFolder::foldComptimeCall(MemoryPtr<ASTNode>& node, CallExpressionNode* call) {
+    std::optional<ComptimeInterpreter::Value> result = interpreter->evaluateCall(call);
+    if (!result) {
+        reportComptimeFailure(call);
+        return std::nullopt;
+    }
+    if (std::holds_alternative<std::monostate>(result->data)) return std::nullopt; // void or null, nothing to put in place of the call
+    if (node->inferredType && node->inferredType->kind == Type::Kind::Iterator) return std::nullopt; // lazy, it's left to the loop over it
+
+    node = makeValue(*result, node->inferredType, node.get());
+    return ComptimeInterpreter::toConstant(*result);
+}
+
+void ConstantFolder::reportComptimeFailure(CallExpressionNode* call) {
+    const std::string& name = call->resolvedFunction->name;
+    ASTNode* at = interpreter->failedAt ? interpreter->failedAt : call;
+    std::string location = std::format("{}:{}:{}", at->filePath, at->line, at->column);
+
+    std::string reason, detail;
+    switch (interpreter->failure) {
+        case ComptimeInterpreter::Failure::OutOfFuel: reason = "outOfFuel"; detail = std::to_string(interpreter->fuelLimit); break;
+        case ComptimeInterpreter::Failure::OutOfMemory: reason = "outOfMemory"; detail = std::to_string(interpreter->memoryLimit); break;
+        case ComptimeInterpreter::Failure::TooDeep: reason = "tooDeep"; detail = std::to_string(interpreter->callDepthLimit); break;
+        case ComptimeInterpreter::Failure::Runtime: reason = "runtime"; detail = location; break;
+        default: reason = "unsupported"; detail = location; break;
+    }
+
+    errorManager->addError(ErrorType::Analysis, AnalysisErrors::ComptimeEvaluationFailed,
+        ErrorSpan{call->filePath, name, call->line, call->column},
+        std::format("ErrorManager.Analysis.ComptimeEvaluationFailed.{}.message", reason), {name},
+        std::format("ErrorManager.Analysis.ComptimeEvaluationFailed.{}.hint", reason), {detail});
+}
+
+// ==== Evaluation ====
+
+// Integer arithmetic in 128 bits, see evaluateBinary().
+static std::optional<__int128> integerOperation(const std::string& op, __int128 left, __int128 right, const Type* type, bool& overflow) {
+    __int128 result = 0;
+    if (op == "+") overflow = __builtin_add_overflow(left, right, &result);
+    else if (op == "-") overflow = __builtin_sub_overflow(left, right, &result);
+    else if (op == "*") overflow = __builtin_mul_overflow(left, right, &result);
+    else if (op == "/" || op == "%") {
+        if (right == 0) return std::nullopt; // left for the runtime to report
+        if (right == -1 && left == integerRange(type).first) overflow = true; // the one signed division that overflows
+        else result = op == "/" ? left / right : left % right;
+    }
+    else if (op == "^") {
+        if (right < 0) return std::nullopt;
+        result = 1;
+        for (__int128 base = left, exponent = right; exponent > 0 && !overflow; exponent >>= 1) {
+            if (exponent & 1) overflow = __builtin_mul_overflow(result, base, &result);
+            if (exponent > 1 && !overflow) overflow = __builtin_mul_overflow(base, base, &base);
+        }
+    }
+    else if (op == "&") result = left & right;
+    else if (op == "|") result = left | right;
+    else if (op == "^^") result = left ^ right;
+    else if (op == "<<" || op == ">>") {
+        if (right < 0 || right >= integerWidth(type)) return std::nullopt;
+        if (op == ">>") result = left >> static_cast<int>(right);
+        else overflow = __builtin_mul_overflow(left, static_cast<__int128>(1) << static_cast<int>(right), &result); // bits shifted out are an overflow
+    }
+    else return std::nullopt;
+
+    if (overflow) return std::nullopt;
+    return result;
+}
+
+std::optional<ConstantFolder::Constant> ConstantFolder::evaluateBinary(const std::string& op, const Constant& left, const Constant& right, const Type* operandType, const Type* resultType, bool& overflow) {
+    bool isComparison = op == "==" || op == "!=" || op == "<" || op == ">" || op == "<=" || op == ">=";
+    auto compare = [&](const auto& a, const auto& b) -> bool {
+        if (op == "==") return a == b;
+        if (op == "!=") return a != b;
+        if (op == "<") return a < b;
+        if (op == ">") return a > b;
+        if (op == "<=") return a <= b;
+        return a >= b;
+    };
+
+    if (std::holds_alternative<Integer>(left) && std::holds_alternative<Integer>(right) && operandType->isInteger()) {
+        Integer a = std::get<Integer>(left), b = std::get<Integer>(right);
+        if (isComparison) return compare(a, b);
+
+        std::optional<Integer> result = integerOperation(op, a, b, resultType, overflow);
+        if (!result) return std::nullopt;
+        return *result;
+    }
+
+    if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right) && operandType->isFloat()) {
+        double a = std::get<double>(left), b = std::get<double>(right);
+        if (isComparison) return compare(a, b);
+
+        double result;
+        if (op == "+") result = a + b;
+        else if (op == "-") result = a - b;
+        else if (op == "*") result = a * b;
+        else if (op == "/") result = a / b;
+        else if (op == "^") result = std::pow(a, b);
+        else return std::nullopt;
+
+        // float is computed in single precision, like it will be at runtime
+        if (operandType->isPrimitive(ResolvedType::Float)) result = static_cast<float>(result);
+        if (!std::isfinite(result)) return std::nullopt; // infinities and NaNs stay a runtime matter
+        return result;
+    }
+
+    if (std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right)) {
+        const std::string& a = std::get<std::string>(left);
+        const std::string& b = std::get<std::string>(right);
+        if (op == "+") return a + b;
+        if (isComparison) return compare(a, b);
+        return std::nullopt;
+    }
+
+    if (std::holds_alternative<bool>(left) && std::holds_alternative<bool>(right)) {
+        bool a = std::get<bool>(left), b = std::get<bool>(right);
+        if (op == "==") return a == b;
+        if (op == "!=") return a != b;
+        if (op == "&&" || op == "and") return a && b;
+        if (op == "||" || op == "or") return a || b;
+    }
+
+    return std::nullopt;
+}
+
+std::optional<ConstantFolder::Constant> ConstantFolder::evaluateUnary(const std::string& op, const Constant& operand, const Type* resultType) {
+    if (std::holds_alternative<Integer>(operand) && resultType->isInteger()) {
+        if (op == "-") return -std::get<Integer>(operand);
+        // the complement of an unsigned value keeps to its width instead of going negative
+        if (op == "~") return isUnsigned(resultType) ? integerRange(resultType).second - std::get<Integer>(operand) : ~std::get<Integer>(operand);
+    }
+    if (std::holds_alternative<double>(operand) && resultType->isFloat() && op == "-") return -std::get<double>(operand);
+    if (std::holds_alternative<bool>(operand) && (op == "!" || op == "not")) return !std::get<bool>(operand);
+    return std::nullopt;
+}
+
+std::optional<ConstantFolder::Constant> ConstantFolder::parseLiteral(LiteralNode* node, bool& overflow) {
+    const Type* type = node->inferredType;
+    if (!type || type->isPrimitive(ResolvedType::Number)) return std::nullopt; // `number` is arbitrary precision, not folded in machine types
+
+    switch (node->literalType) {
+        case ASTLiteralType::Integer: {
+            Integer value = 0;
+            for (char digit : node->value) {
+                if (__builtin_mul_overflow(value, 10, &value) || __builtin_add_overflow(value, digit - '0', &value)) {
+                    // uint128 goes past the signed 128-bit range, so its largest literals simply aren't folded
+                    overflow = !type->isPrimitive(ResolvedType::UInt128);
+                    return std::nullopt;
+                }
+            }
+            // an integer literal in a float context (`x: float = 5`) is a float
+            if (type->isFloat()) return static_cast<double>(value);
+            return value;
+        }
+        case ASTLiteralType::Float: {
+            double value = std::strtod(node->value.c_str(), nullptr);
+            if (!std::isfinite(value)) return std::nullopt;
+            return value;
+        }
+        case ASTLiteralType::String:
+            if (node->isInterpolation()) return std::nullopt; // built at runtime
+            return node->value;
+        case ASTLiteralType::Bool: return node->value == "true";
+        case ASTLiteralType::Null: return std::nullopt;
+    }
+    return std::nullopt;
+}
+
+// ==== Integer helpers ====
+
+std::string ConstantFolder::integerToString(Integer value) {
+    if (value == 0) return "0";
+    bool negative = value < 0;
+    // negate digit by digit, so the smallest int128 doesn't overflow
+    std::string digits;
+    while (value != 0) {
+        int digit = static_cast<int>(value % 10);
+        digits += static_cast<char>('0' + (negative ? -digit : digit));
+        value /= 10;
+    }
+    if (negative) digits += '-';
+    return {digits.rbegin(), digits.rend()};
+}
+
+bool ConstantFolder::fitsInto(Integer value, const Type* type) {
+    if (!integerWidth(type)) return true; // not a sized integer, e.g. `number` or dynamic
+    auto [min, max] = integerRange(type);
+    return value >= min && value <= max;
+}
+
+void ConstantFolder::reportOverflow(ASTNode* node, const std::string& value, const Type* type) {
+    std::string min, max;
+    if (integerWidth(type)) {
+        auto range = integerRange(type);
+        min = integerToString(range.first);
+        max = integerToString(range.second);
+    }
+    std::string typeName = type ? type->toString() : "int";
+    errorManager->addError(ErrorType::Analysis, AnalysisErrors::LiteralOverflow,
+        ErrorSpan{node->filePath, node->value, node->line, node->column},
+        "ErrorManager.Analysis.LiteralOverflow.message", {value, typeName},
+        integerWidth(type) ? "ErrorManager.Analysis.LiteralOverflow.hint" : "", {typeName, min, max});
+}
+
+// ==== Helpers ====
+
+MemoryPtr<ASTNode> ConstantFolder::makeLiteral(const Constant& value, const Type* type, ASTNode* position) {
+    MemoryPtr<LiteralNode> literal;
+    if (auto* integer = std::get_if<Integer>(&value)) literal = ASTBuilder::createLiteral(integerToString(*integer), ASTLiteralType::Integer);
+    else if (auto* real = std::get_if<double>(&value)) {
+        // shortest text that reads back to the same value, printed in the precision of the type
+        bool single = type && type->isPrimitive(ResolvedType::Float);
+        std::string text = single ? std::format("{}", static_cast<float>(*real)) : std::format("{}", *real);
+        if (text.find_first_of(".eE") == std::string::npos) text += ".0";
+        literal = ASTBuilder::createLiteral(text, ASTLiteralType::Float);
+    }
+    else if (auto* text = std::get_if<std::string>(&value)) literal = ASTBuilder::createLiteral(*text, ASTLiteralType::String);
+    else literal = ASTBuilder::createLiteral(std::get<bool>(value) ? "true" : "false", ASTLiteralType::Bool);
+
+    literal->inferredType = type;
+    literal->line = position->line;
+    literal->column = position->column;
+    literal->filePath = position->filePath;
+    return literal;
+}
+
+const ConstantFolder::Constant* ConstantFolder::findConstant(const std::string& name) {
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+        auto it = scope->find(name);
+        if (it == scope->end()) continue;
+        return it->second ? &*it->second : nullptr; // shadowed by a variable
+    }
+    return nullptr;
+}
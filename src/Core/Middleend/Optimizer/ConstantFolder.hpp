@@ -0,0 +1,84 @@
+#pragma once
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "Core/Extras/ErrorManager/ErrorManager.hpp"
+#include "Core/Frontend/Nodes.hpp"
+#include "Core/Frontend/SemanticAnalysis/Types.hpp"
+
+struct Program;
+struct ComptimeInterpreter;
+
+/* Constant Folder is the first pass of the Optimizer. It runs on the typed AST right after Semantic Analysis,
+ * evaluates operations whose operands are known at compile time and replaces them with literals:
+ * `2 * 60 * 60` becomes `7200`, `"a" + "b"` becomes `"ab"`, and every use of `const x = ...` becomes its value.
+ * Integer results are checked against the range of their sized type, which is where LiteralOverflow is reported.
+ */
+struct ConstantFolder {
+    // ErrorManager is used to report errors
+    ErrorManager* errorManager = nullptr;
+
+    ConstantFolder();
+    ~ConstantFolder();
+
+    // Main entry
+    void foldProgram(Program& program);
+    void foldModule(ModuleNode* module); // modules fold independently, constants never cross them
+
+    // Called for every function run at compile time, so the Compiler knows which bodies a module's constants came from
+    std::function<void(FunctionNode*)> onComptimeCall;
+
+    // Integers are evaluated in 128 bits, enough to catch overflow of every sized type up to int128.
+    using Integer = __int128;
+    using Constant = std::variant<Integer, double, std::string, bool>;
+
+    /* Evaluation of single operations on known values, shared with the ComptimeInterpreter.
+     * `operandType` and `resultType` are the inferred types of the operands and of the operation.
+     * They return std::nullopt if the operation can't be evaluated (division by zero, shift past the width, mismatched values),
+     * `overflow` is set if an integer result doesn't even fit into 128 bits.
+     */
+    static std::optional<Constant> evaluateBinary(const std::string& op, const Constant& left, const Constant& right, const Type* operandType, const Type* resultType, bool& overflow);
+    static std::optional<Constant> evaluateUnary(const std::string& op, const Constant& operand, const Type* resultType);
+    static std::optional<Constant> parseLiteral(LiteralNode* node, bool& overflow); // std::nullopt for null, `number` and interpolated strings
+    static bool fitsInto(Integer value, const Type* type);
+    static std::string integerToString(Integer value); // std::to_string has no 128-bit overload
+    static MemoryPtr<ASTNode> makeLiteral(const Constant& value, const Type* type, ASTNode* position); // typed literal at the position of another node
+
+private:
+    /* Known values of `const` declarations, one map per scope. Any other declaration of the same name
+     * shadows the constant with std::nullopt, so inner variables never get replaced by an outer constant.
+     */
+    std::vector<std::unordered_map<std::string, std::optional<Constant>>> scopes;
+
+    MemoryPtr<ComptimeInterpreter> interpreter; // runs @comptime calls and const initializers that aren't plain operations
+
+    // Statements
+    void foldTopLevel(std::vector<MemoryPtr<ASTNode>>& body); // module and namespace bodies, where declarations are visible before their position
+    void foldBlock(BlockNode* block);
+    void foldStatement(MemoryPtr<ASTNode>& statement);
+    void foldFunction(FunctionNode* node);
+    void foldDeclaration(DeclarationNode* node);
+
+    /* Folds the expression in place and returns its value if it's a compile-time constant.
+     * `checkRange` is off for the operand of unary minus, so `-128` fits into int8 even though `128` alone doesn't.
+     */
+    std::optional<Constant> foldExpression(MemoryPtr<ASTNode>& node, bool checkRange = true);
+    std::optional<Constant> foldBinary(BinaryOperationNode* node, const Constant& left, const Constant& right);
+    std::optional<Constant> literalValue(LiteralNode* node);
+
+    // Replaces `node` (the call itself or the namespace access around it) with the result of running the @comptime `call`.
+    std::optional<Constant> foldComptimeCall(MemoryPtr<ASTNode>& node, CallExpressionNode* call);
+    void reportComptimeFailure(CallExpressionNode* call);
+
+    void reportOverflow(ASTNode* node, const std::string& value, const Type* type);
+
+    // Scope helpers
+    void pushScope() { scopes.emplace_back(); }
+    void popScope() { scopes.pop_back(); }
+    void shadow(const std::string& name) { scopes.back()[name] = std::nullopt; }
+    const Constant* findConstant(const std::string& name);
+};
@@ -0,0 +1,332 @@
+#include "NIR.hpp"
+
+#include <algorithm>
+#include <format>
+#include <unordered_set>
+
+#include "Core/Frontend/SemanticAnalysis/Types.hpp"
+
+// ==== Instructions ====
+
+bool NIRInstruction::hasSideEffects() const {
+    switch (op) {
+        case NIROp::Constant: case NIROp::Null: case NIROp::Undefined: case NIROp::Symbol: case NIROp::LoadGlobal: case NIROp::Phi:
+        case NIROp::Add: case NIROp::Subtract: case NIROp::Multiply: case NIROp::Power:
+        case NIROp::BitAnd: case NIROp::BitOr: case NIROp::BitXor: case NIROp::ShiftLeft: case NIROp::ShiftRight:
+        case NIROp::Equal: case NIROp::NotEqual: case NIROp::Less: case NIROp::LessEqual: case NIROp::Greater: case NIROp::GreaterEqual:
+        case NIROp::Negate: case NIROp::Not: case NIROp::Concat: case NIROp::Interpolate: case NIROp::Convert:
+        case NIROp::Lambda: case NIROp::Wrap: case NIROp::IsNull: case NIROp::Unwrap:
+        case NIROp::MakeOk: case NIROp::MakeError: case NIROp::IsOk:
+        case NIROp::ArrayNew: case NIROp::SetNew: case NIROp::DictNew: case NIROp::Length:
+        case NIROp::SetContains: case NIROp::DictContains: case NIROp::DictGet: case NIROp::DictLookup:
+        case NIROp::Iterate:
+            return false;
+        // division traps on zero, checks and array reads trap too, the rest changes something
+        default: return true;
+    }
+}
+
+const std::vector<NIRBlock*>& NIRBlock::successors() const {
+    static const std::vector<NIRBlock*> none;
+    NIRInstruction* last = terminator();
+    return last ? last->targets : none;
+}
+
+// ==== Functions ====
+
+NIRBlock* NIRFunction::createBlock(const std::string& name) {
+    // names only have to be readable and unique, the index makes them unique
+    auto block = makeMemoryPtr<NIRBlock>();
+    block->name = blocks.empty() ? name : std::format("{}.{}", name, blocks.size());
+    blocks.push_back(std::move(block));
+    return blocks.back().get();
+}
+
+void NIRFunction::computePredecessors() {
+    for (auto& block : blocks) block->predecessors.clear();
+    for (auto& block : blocks)
+        for (NIRBlock* successor : block->successors())
+            if (std::find(successor->predecessors.begin(), successor->predecessors.end(), block.get()) == successor->predecessors.end())
+                successor->predecessors.push_back(block.get());
+}
+
+void NIRFunction::replaceAllUses(NIRInstruction* from, NIRInstruction* to) {
+    for (auto& block : blocks)
+        for (auto& instruction : block->instructions)
+            std::replace(instruction->operands.begin(), instruction->operands.end(), from, to);
+}
+
+size_t NIRFunction::removeDead() {
+    size_t removed = 0;
+
+    // blocks nothing jumps to, and the phi operands that came from them
+    std::unordered_set<const NIRBlock*> reachable;
+    std::vector<NIRBlock*> stack{blocks.front().get()};
+    while (!stack.empty()) {
+        NIRBlock* block = stack.back();
+        stack.pop_back();
+        if (!reachable.insert(block).second) continue;
+        for (NIRBlock* successor : block->successors()) stack.push_back(successor);
+    }
+    if (reachable.size() != blocks.size()) {
+        std::erase_if(blocks, [&](const MemoryPtr<NIRBlock>& block) {
+            if (reachable.contains(block.get())) return false;
+            removed += block->instructions.size();
+            return true;
+        });
+        for (auto& block : blocks) {
+            for (auto& instruction : block->instructions) {
+                if (instruction->op != NIROp::Phi) continue;
+                for (size_t i = instruction->targets.size(); i-- > 0;) {
+                    if (reachable.contains(instruction->targets[i])) continue;
+                    instruction->targets.erase(instruction->targets.begin() + i);
+                    instruction->operands.erase(instruction->operands.begin() + i);
+                }
+            }
+        }
+        computePredecessors();
+    }
+
+    // values nobody uses, till there are none left: removing one may leave its operands unused
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        std::unordered_map<const NIRInstruction*, size_t> uses;
+        for (auto& block : blocks)
+            for (auto& instruction : block->instructions)
+                for (NIRInstruction* operand : instruction->operands) uses[operand]++;
+
+        for (auto& block : blocks) {
+            size_t before = block->instructions.size();
+            std::erase_if(block->instructions, [&](const MemoryPtr<NIRInstruction>& instruction) {
+                return !instruction->isTerminator() && !instruction->hasSideEffects() && !uses.contains(instruction.get());
+            });
+            removed += before - block->instructions.size();
+            changed |= before != block->instructions.size();
+        }
+    }
+    return removed;
+}
+
+// ==== Text form ====
+
+static const char* opName(NIROp op) {
+    switch (op) {
+        case NIROp::Param: return "param";
+        case NIROp::Constant: return "const";
+        case NIROp::Null: return "null";
+        case NIROp::Undefined: return "undef";
+        case NIROp::Symbol: return "symbol";
+        case NIROp::LoadGlobal: return "load";
+        case NIROp::StoreGlobal: return "store";
+        case NIROp::Phi: return "phi";
+        case NIROp::Add: return "add";
+        case NIROp::Subtract: return "sub";
+        case NIROp::Multiply: return "mul";
+        case NIROp::Divide: return "div";
+        case NIROp::Remainder: return "rem";
+        case NIROp::Power: return "pow";
+        case NIROp::BitAnd: return "and";
+        case NIROp::BitOr: return "or";
+        case NIROp::BitXor: return "xor";
+        case NIROp::ShiftLeft: return "shl";
+        case NIROp::ShiftRight: return "shr";
+        case NIROp::Equal: return "eq";
+        case NIROp::NotEqual: return "ne";
+        case NIROp::Less: return "lt";
+        case NIROp::LessEqual: return "le";
+        case NIROp::Greater: return "gt";
+        case NIROp::GreaterEqual: return "ge";
+        case NIROp::Negate: return "neg";
+        case NIROp::Not: return "not";
+        case NIROp::Concat: return "concat";
+        case NIROp::Interpolate: return "interpolate";
+        case NIROp::Convert: return "convert";
+        case NIROp::Call: return "call";
+        case NIROp::CallValue: return "call.value";
+        case NIROp::CallMethod: return "call.method";
+        case NIROp::GetField: return "field.get";
+        case NIROp::SetField: return "field.set";
+        case NIROp::Lambda: return "lambda";
+        case NIROp::Wrap: return "wrap";
+        case NIROp::IsNull: return "isnull";
+        case NIROp::NullCheck: return "nullcheck";
+        case NIROp::Unwrap: return "unwrap";
+        case NIROp::MakeOk: return "result.ok";
+        case NIROp::MakeError: return "result.error";
+        case NIROp::IsOk: return "result.isok";
+        case NIROp::UnwrapOk: return "result.value";
+        case NIROp::UnwrapError: return "result.errorvalue";
+        case NIROp::Retain: return "retain";
+        case NIROp::Release: return "release";
+        case NIROp::ArrayNew: return "array.new";
+        case NIROp::SetNew: return "set.new";
+        case NIROp::DictNew: return "dict.new";
+        case NIROp::Length: return "length";
+        case NIROp::ArrayGet: return "array.get";
+        case NIROp::ArraySet: return "array.set";
+        case NIROp::ArrayPush: return "array.push";
+        case NIROp::SetContains: return "set.contains";
+        case NIROp::SetInsert: return "set.insert";
+        case NIROp::SetRemove: return "set.remove";
+        case NIROp::DictContains: return "dict.contains";
+        case NIROp::DictGet: return "dict.get";
+        case NIROp::DictSet: return "dict.set";
+        case NIROp::DictRemove: return "dict.remove";
+        case NIROp::DictLookup: return "dict.lookup";
+        case NIROp::Iterate: return "iterate";
+        case NIROp::Next: return "next";
+        case NIROp::Await: return "await";
+        case NIROp::Jump: return "jump";
+        case NIROp::Branch: return "branch";
+        case NIROp::Return: return "return";
+        case NIROp::Throw: return "throw";
+        case NIROp::Unreachable: return "unreachable";
+    }
+    return "?";
+}
+
+static std::string escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default: escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+/* One instruction per line, values are numbered in the order they're written:
+ *     %3: int? = dict.lookup %1, %2
+ *     branch %4, then.2, else.3
+ * Names of functions and globals follow `@`, everything else an instruction carries comes last, in quotes.
+ */
+std::string printNIR(const NIRFunction& function) {
+    std::unordered_map<const NIRInstruction*, size_t> numbers;
+    for (const auto& block : function.blocks)
+        for (const auto& instruction : block->instructions)
+            if (instruction->type) numbers.emplace(instruction.get(), numbers.size());
+    auto value = [&](const NIRInstruction* instruction) {
+        auto it = numbers.find(instruction);
+        return it == numbers.end() ? std::string("%?") : std::format("%{}", it->second);
+    };
+
+    std::string out = std::format("{}fn @\"{}\"(", function.isAsync ? "async " : "", escape(function.name));
+    for (size_t i = 0; i < function.params.size(); i++)
+        out += std::format("{}{}: {}", i ? ", " : "", function.params[i]->text, function.params[i]->type->toString());
+    out += std::format(") -> {} {{\n", function.returnType ? function.returnType->toString() : "void");
+
+    for (const auto& block : function.blocks) {
+        out += block->name + ":";
+        if (!block->predecessors.empty()) {
+            out += " ; from";
+            for (size_t i = 0; i < block->predecessors.size(); i++) out += (i ? ", " : " ") + block->predecessors[i]->name;
+        }
+        out += "\n";
+
+        for (const auto& instruction : block->instructions) {
+            out += "    ";
+            if (instruction->type) out += std::format("{}: {} = ", value(instruction.get()), instruction->type->toString());
+            out += opName(instruction->op);
+            if (instruction->op == NIROp::Retain || instruction->op == NIROp::Release) out += instruction->atomic ? "" : ".local";
+
+            std::string arguments;
+            auto add = [&](const std::string& argument) { arguments += (arguments.empty() ? " " : ", ") + argument; };
+            switch (instruction->op) {
+                case NIROp::Phi:
+                    for (size_t i = 0; i < instruction->operands.size(); i++)
+                        add(std::format("[{}, {}]", value(instruction->operands[i]), instruction->targets[i]->name));
+                    break;
+                case NIROp::Call: case NIROp::LoadGlobal: case NIROp::StoreGlobal:
+                    add(std::format("@\"{}\"", escape(instruction->text)));
+                    for (NIRInstruction* operand : instruction->operands) add(value(operand));
+                    break;
+                default:
+                    for (NIRInstruction* operand : instruction->operands) add(value(operand));
+                    for (NIRBlock* target : instruction->targets) add(target->name);
+                    if (!instruction->text.empty()) add(std::format("\"{}\"", escape(instruction->text)));
+                    break;
+            }
+            out += arguments + "\n";
+        }
+    }
+    return out + "}\n";
+}
+
+std::string printNIR(const NIRModule& module) {
+    std::string out = std::format("; NIR of {}\n", module.name);
+    for (const auto& function : module.functions) out += "\n" + printNIR(*function);
+    return out;
+}
+
+// ==== Dominators ====
+
+// "A Simple, Fast Dominance Algorithm" by Cooper, Harvey and Kennedy: idoms are refined over the reverse postorder
+// till nothing changes, which is one or two rounds for code without irreducible loops.
+DominatorTree::DominatorTree(const NIRFunction& function) {
+    if (function.blocks.empty()) return;
+
+    std::unordered_set<const NIRBlock*> visited;
+    std::vector<std::pair<NIRBlock*, size_t>> stack{{function.blocks.front().get(), 0}};
+    visited.insert(stack.back().first);
+    while (!stack.empty()) {
+        auto& [block, next] = stack.back();
+        const auto& successors = block->successors();
+        if (next < successors.size()) {
+            NIRBlock* successor = successors[next++];
+            if (visited.insert(successor).second) stack.emplace_back(successor, 0);
+            continue;
+        }
+        reversePostorder.push_back(block);
+        stack.pop_back();
+    }
+    std::reverse(reversePostorder.begin(), reversePostorder.end());
+    for (size_t i = 0; i < reversePostorder.size(); i++) indexes[reversePostorder[i]] = i;
+
+    NIRBlock* entry = reversePostorder.front();
+    idoms[entry] = entry;
+    auto intersect = [&](NIRBlock* a, NIRBlock* b) {
+        while (a != b) {
+            while (indexes.at(a) > indexes.at(b)) a = idoms.at(a);
+            while (indexes.at(b) > indexes.at(a)) b = idoms.at(b);
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < reversePostorder.size(); i++) {
+            NIRBlock* block = reversePostorder[i];
+            NIRBlock* dominator = nullptr;
+            for (NIRBlock* predecessor : block->predecessors) {
+                if (!idoms.contains(predecessor)) continue; // not processed yet, or unreachable
+                dominator = dominator ? intersect(predecessor, dominator) : predecessor;
+            }
+            auto it = idoms.find(block);
+            if (dominator && (it == idoms.end() || it->second != dominator)) {
+                idoms[block] = dominator;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool DominatorTree::dominates(const NIRBlock* a, const NIRBlock* b) const {
+    if (!indexes.contains(a) || !indexes.contains(b)) return false;
+    while (true) {
+        if (a == b) return true;
+        auto it = idoms.find(b);
+        if (it == idoms.end() || it->second == b) return false; // reached the entry
+        b = it->second;
+    }
+}
+
+NIRBlock* DominatorTree::idom(const NIRBlock* block) const {
+    auto it = idoms.find(block);
+    return it == idoms.end() || it->second == block ? nullptr : it->second;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Core/Frontend/Nodes.hpp"
+#include "HelperFunctions.hpp"
+
+struct Type;
+
+/* NIR (Neoluma IR) sits between the AST and LLVM IR. It's in SSA form like LLVM IR, but it keeps what LLVM can't see:
+ * nullable values and the checks on them, `result` values, reference counting, whole operations on arrays, sets and
+ * dicts, and the points where an async function may be suspended. Passes that know the language run on it, see
+ * PassManager.
+ *
+ * A function is a list of blocks, a block is a list of instructions that ends with exactly one terminator. Every
+ * instruction is a value, the ones without a result have no type. Phis come first in their block, their operands
+ * line up with `targets`, the blocks they come from. Values are typed with the Frontend's types.
+ */
+
+enum class NIROp : uint8_t {
+    // Values
+    Param,          // `text` is the name
+    Constant,       // `text` is the value as it was written, strings unescaped
+    Null,
+    Undefined,      // a variable read before anything was assigned to it
+    Symbol,         // a named entity that isn't a variable: a function used as a value, `self`, an enum member
+    LoadGlobal,     // of `global`, `text` is its symbol name
+    StoreGlobal,    // operand 0 into `global`, `text` is its symbol name
+    Phi,
+
+    // Operands of one type, comparisons give bool
+    Add, Subtract, Multiply, Divide, Remainder, Power,
+    BitAnd, BitOr, BitXor, ShiftLeft, ShiftRight,
+    Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual,
+    Negate, Not,
+    Concat,         // strings
+    Interpolate,    // "a ${b}": operands are the pieces, text and values, in order
+    Convert,        // operand 0 to `type`, the implicit conversions the Frontend allows
+
+    // Calls
+    Call,           // `callee` with the operands as arguments, defaults filled in. `text` is its symbol name.
+    CallValue,      // operand 0 is the callee (a lambda, a function value), the rest are arguments
+    CallMethod,     // method `text` of operand 0, the rest are arguments. Members aren't typed yet.
+    GetField,       // field `text` of operand 0
+    SetField,       // operand 1 into field `text` of operand 0
+    Lambda,         // closure of `site`, a LambdaNode
+
+    // Nullable values
+    Wrap,           // T to T?
+    IsNull,
+    NullCheck,      // T? to T, a runtime error (NullReference) if it's null
+    Unwrap,         // T? to T that is known not to be null, no check
+
+    // Results
+    MakeOk, MakeError,
+    IsOk,
+    UnwrapOk, UnwrapError, // a runtime error if it holds the other one
+
+    // Reference counting, operand 0 is the object. No result.
+    Retain, Release,
+
+    // Collections
+    ArrayNew, SetNew, DictNew, // operands are the elements, for dicts key and value one after another
+    Length,
+    ArrayGet, ArraySet, ArrayPush,
+    SetContains, SetInsert, SetRemove,
+    DictContains, DictGet, DictSet, DictRemove, // DictGet gives V?, null for a missing key
+    DictLookup,     // fused DictContains + DictGet: V?, the one hash lookup both of them need
+
+    // Iteration: Next gives the next element as T?, null at the end
+    Iterate, Next,
+
+    // Async
+    Await,          // suspension point: the function may be suspended here until the task in operand 0 is done
+
+    // Terminators
+    Jump,           // targets[0]
+    Branch,         // operand 0 ? targets[0] : targets[1]
+    Return,         // operand 0 if there's one
+    Throw,          // operand 0 leaves the function
+    Unreachable,
+};
+
+struct NIRBlock;
+
+struct NIRInstruction {
+    NIROp op;
+    const Type* type = nullptr; // nullptr for instructions without a result
+    std::vector<NIRInstruction*> operands;
+    std::vector<NIRBlock*> targets; // successors of a terminator, incoming blocks of a phi
+    NIRBlock* block = nullptr;
+
+    std::string text; // see NIROp
+    FunctionNode* callee = nullptr;
+    DeclarationNode* global = nullptr;
+    ASTNode* site = nullptr; // source of the instruction, for runtime errors
+    bool atomic = true; // Retain/Release: false when the object never leaves its thread
+
+    bool isTerminator() const { return op >= NIROp::Jump; }
+    bool hasSideEffects() const; // false if it can be removed once its result is unused
+};
+
+struct NIRBlock {
+    std::string name; // unique in its function
+    std::vector<MemoryPtr<NIRInstruction>> instructions;
+    std::vector<NIRBlock*> predecessors; // kept up to date by NIRFunction::computePredecessors()
+
+    NIRInstruction* terminator() const { return !instructions.empty() && instructions.back()->isTerminator() ? instructions.back().get() : nullptr; }
+    const std::vector<NIRBlock*>& successors() const;
+};
+
+struct NIRFunction {
+    std::string name; // symbol name, like the IR Generator's
+    FunctionNode* source = nullptr; // nullptr for the global initializers
+    const Type* returnType = nullptr; // nullptr for void
+    bool isAsync = false;
+    std::vector<NIRInstruction*> params; // the Param instructions at the top of the entry block
+    std::vector<MemoryPtr<NIRBlock>> blocks; // [0] is the entry
+
+    NIRBlock* createBlock(const std::string& name);
+    void computePredecessors();
+    void replaceAllUses(NIRInstruction* from, NIRInstruction* to);
+    size_t removeDead(); // instructions without side effects whose result is unused, and unreachable blocks
+};
+
+struct NIRModule {
+    std::string name;
+    std::vector<MemoryPtr<NIRFunction>> functions;
+};
+
+// Text form of a module, the one `ir` outputs are written in
+std::string printNIR(const NIRModule& module);
+std::string printNIR(const NIRFunction& function);
+
+// Dominator tree of a function whose predecessors are up to date
+struct DominatorTree {
+    explicit DominatorTree(const NIRFunction& function);
+
+    bool dominates(const NIRBlock* a, const NIRBlock* b) const; // every path from the entry to b goes through a; a block dominates itself
+    NIRBlock* idom(const NIRBlock* block) const; // nullptr for the entry and unreachable blocks
+    const std::vector<NIRBlock*>& order() const { return reversePostorder; } // reachable blocks, dominators before the blocks they dominate
+
+private:
+    std::unordered_map<const NIRBlock*, NIRBlock*> idoms;
+    std::unordered_map<const NIRBlock*, size_t> indexes; // in reversePostorder
+    std::vector<NIRBlock*> reversePostorder;
+};
@@ -0,0 +1,856 @@
+#include "NIRBuilder.hpp"
+
+#include <algorithm>
+#include <format>
+
+#include "Core/Extras/SymbolIndex/SymbolIndex.hpp"
+#include "Core/Frontend/SemanticAnalysis/Types.hpp"
+#include "Core/Middleend/IRGenerator/IRGenerator.hpp"
+
+static bool isLogical(const std::string& op) { return op == "&&" || op == "||" || op == "and" || op == "or"; }
+
+static bool isInterpolation(const ASTNode* node) {
+    return node->type == ASTNodeType::Literal && static_cast<const LiteralNode*>(node)->isInterpolation();
+}
+
+static bool hasModifier(const FunctionNode* node, ASTModifierType modifier) {
+    return std::any_of(node->modifiers.begin(), node->modifiers.end(), [&](const auto& m) { return m->modifier == modifier; });
+}
+
+// ==== Program ====
+
+NIRModule NIRBuilder::build(const std::string& name, const std::vector<ModuleNode*>& modules) {
+    NIRModule output;
+    output.name = name;
+    module = &output;
+    prefixes.clear();
+    globals.clear();
+
+    for (ModuleNode* node : modules)
+        if (node) declareTopLevel(node->body, "");
+    buildInitializers(modules);
+    for (ModuleNode* node : modules)
+        if (node) buildTopLevel(node->body);
+
+    module = nullptr;
+    return output;
+}
+
+void NIRBuilder::declareTopLevel(std::vector<MemoryPtr<ASTNode>>& body, const std::string& prefix) {
+    for (auto& statement : body) {
+        switch (statement->type) {
+            case ASTNodeType::Function: prefixes[statement.get()] = prefix; break;
+            case ASTNodeType::Declaration: {
+                auto* declaration = static_cast<DeclarationNode*>(statement.get());
+                prefixes[declaration] = prefix;
+                globals[declaration->variable->varName].push_back(declaration);
+                break;
+            }
+            case ASTNodeType::Class: {
+                auto* node = static_cast<ClassNode*>(statement.get());
+                if (node->constructor) prefixes[node->constructor.get()] = prefix + node->name + ".";
+                for (auto& method : node->methods) prefixes[method.get()] = prefix + node->name + ".";
+                break;
+            }
+            case ASTNodeType::Namespace: {
+                auto* node = static_cast<NamespaceNode*>(statement.get());
+                declareTopLevel(node->body, prefix + namespacePath(node->name.get()) + ".");
+                break;
+            }
+            default: break;
+        }
+    }
+}
+
+void NIRBuilder::buildTopLevel(std::vector<MemoryPtr<ASTNode>>& body) {
+    for (auto& statement : body) {
+        switch (statement->type) {
+            case ASTNodeType::Function: buildFunction(static_cast<FunctionNode*>(statement.get())); break;
+            case ASTNodeType::Namespace: buildTopLevel(static_cast<NamespaceNode*>(statement.get())->body); break;
+            case ASTNodeType::Class: {
+                // methods get `self` as their first parameter
+                auto* node = static_cast<ClassNode*>(statement.get());
+                const Type* self = types->userDefined(node->name);
+                if (node->constructor) buildFunction(node->constructor.get(), self);
+                for (auto& method : node->methods) buildFunction(method.get(), self);
+                break;
+            }
+            default: break; // globals are built by buildInitializers()
+        }
+    }
+}
+
+void NIRBuilder::collectInitializers(std::vector<MemoryPtr<ASTNode>>& body, std::vector<DeclarationNode*>& initializers) {
+    for (auto& statement : body) {
+        if (statement->type == ASTNodeType::Namespace) collectInitializers(static_cast<NamespaceNode*>(statement.get())->body, initializers);
+        if (statement->type == ASTNodeType::Declaration && static_cast<DeclarationNode*>(statement.get())->value)
+            initializers.push_back(static_cast<DeclarationNode*>(statement.get()));
+    }
+}
+
+void NIRBuilder::buildInitializers(const std::vector<ModuleNode*>& modules) {
+    std::vector<DeclarationNode*> initializers;
+    for (ModuleNode* node : modules)
+        if (node) collectInitializers(node->body, initializers);
+    if (initializers.empty()) return;
+
+    auto output = makeMemoryPtr<NIRFunction>();
+    output->name = "neoluma.init";
+    function = output.get();
+    module->functions.push_back(std::move(output));
+    scopes.assign(1, {});
+    enter(function->createBlock("entry"));
+    seal(block);
+
+    // in module order, the same order native code and the Interpreter run them in
+    for (DeclarationNode* declaration : initializers) {
+        NIRInstruction* value = coerce(buildExpression(declaration->value.get()), declaration->inferredType, declaration);
+        NIRInstruction* store = emit(NIROp::StoreGlobal, nullptr, {value}, declaration, globalName(declaration));
+        store->global = declaration;
+    }
+    terminate(NIROp::Return, {}, {}, nullptr);
+
+    function->removeDead();
+    function->computePredecessors();
+    definitions.clear();
+    incompletePhis.clear();
+    sealed.clear();
+    removedPhis.clear();
+}
+
+void NIRBuilder::buildFunction(FunctionNode* node, const Type* self) {
+    if (node->isIntrinsic || !node->body) return;
+
+    auto output = makeMemoryPtr<NIRFunction>();
+    output->name = symbolName(node);
+    output->source = node;
+    output->isAsync = hasModifier(node, ASTModifierType::Async);
+
+    const Type* type = node->inferredType;
+    bool typed = type && type->kind == Type::Kind::Function && type->paramCount() == node->parameters.size();
+    if (typed && !(type->returnType()->isDynamic() && !returnsValue(node->body.get())) && !type->returnType()->isVoid())
+        output->returnType = type->returnType();
+
+    function = output.get();
+    module->functions.push_back(std::move(output));
+    scopes.assign(1, {});
+    variableTypes.clear();
+    loops.clear();
+    tries.clear();
+    enter(function->createBlock("entry"));
+    seal(block);
+
+    // `self` is keyed by the function itself, nothing else declares it
+    if (self) {
+        NIRInstruction* param = emit(NIROp::Param, self, {}, node, "self");
+        function->params.push_back(param);
+        declareLocal("self", node, self);
+        writeVariable(node, block, param);
+    }
+    for (size_t i = 0; i < node->parameters.size(); i++) {
+        ParameterNode* parameter = node->parameters[i].get();
+        NIRInstruction* param = emit(NIROp::Param, typed ? type->param(i) : types->dynamic(), {}, parameter, parameter->parameterName);
+        function->params.push_back(param);
+        declareLocal(parameter->parameterName, parameter, param->type);
+        writeVariable(parameter, block, param);
+    }
+
+    for (auto& statement : node->body->statements) buildStatement(statement.get());
+
+    // Flow Analysis made sure a function returning a value can't get to its end
+    if (!terminated()) terminate(function->returnType ? NIROp::Unreachable : NIROp::Return, {}, {}, node);
+
+    function->removeDead();
+    function->computePredecessors();
+    definitions.clear();
+    incompletePhis.clear();
+    sealed.clear();
+    removedPhis.clear();
+    scopes.clear();
+}
+
+// ==== SSA construction ====
+
+NIRInstruction* NIRBuilder::readVariable(const ASTNode* variable, NIRBlock* at) {
+    auto& known = definitions[at];
+    if (auto it = known.find(variable); it != known.end()) return it->second;
+    return readVariableRecursive(variable, at);
+}
+
+NIRInstruction* NIRBuilder::readVariableRecursive(const ASTNode* variable, NIRBlock* at) {
+    const Type* type = variableTypes.contains(variable) ? variableTypes.at(variable) : types->dynamic();
+    NIRInstruction* value;
+    if (!sealed.contains(at)) {
+        // not every predecessor is known yet, the phi is filled in by seal()
+        value = phi(at, type);
+        incompletePhis[at][variable] = value;
+    } else if (at->predecessors.empty()) {
+        value = undefined(type);
+    } else if (at->predecessors.size() == 1) {
+        value = readVariable(variable, at->predecessors.front());
+    } else {
+        // the phi goes in first, so a loop that leads back here finds it instead of looping forever
+        value = phi(at, type);
+        writeVariable(variable, at, value);
+        value = addPhiOperands(variable, value);
+    }
+    writeVariable(variable, at, value);
+    return value;
+}
+
+NIRInstruction* NIRBuilder::addPhiOperands(const ASTNode* variable, NIRInstruction* phi) {
+    for (NIRBlock* predecessor : phi->block->predecessors) {
+        phi->operands.push_back(readVariable(variable, predecessor));
+        phi->targets.push_back(predecessor);
+    }
+    return tryRemoveTrivialPhi(phi);
+}
+
+NIRInstruction* NIRBuilder::tryRemoveTrivialPhi(NIRInstruction* phi) {
+    // a phi is trivial if it only merges one value (and itself)
+    NIRInstruction* same = nullptr;
+    for (NIRInstruction* operand : phi->operands) {
+        if (operand == same || operand == phi) continue;
+        if (same) return phi;
+        same = operand;
+    }
+    if (!same) same = undefined(phi->type);
+
+    std::vector<NIRInstruction*> users;
+    for (auto& candidate : function->blocks)
+        for (auto& instruction : candidate->instructions)
+            if (instruction.get() != phi && instruction->op == NIROp::Phi && std::find(instruction->operands.begin(), instruction->operands.end(), phi) != instruction->operands.end())
+                users.push_back(instruction.get());
+
+    function->replaceAllUses(phi, same);
+    for (auto& [_, known] : definitions)
+        for (auto& [_, value] : known)
+            if (value == phi) value = same;
+
+    // the phi is kept alive till the function is done, recursion up the stack may still look at it
+    auto& instructions = phi->block->instructions;
+    auto it = std::find_if(instructions.begin(), instructions.end(), [&](const auto& instruction) { return instruction.get() == phi; });
+    removedPhis.push_back(std::move(*it));
+    instructions.erase(it);
+
+    // removing this one may have made the phis that used it trivial too
+    for (NIRInstruction* user : users)
+        if (std::none_of(removedPhis.begin(), removedPhis.end(), [&](const auto& removed) { return removed.get() == user; }))
+            tryRemoveTrivialPhi(user);
+    return same;
+}
+
+void NIRBuilder::seal(NIRBlock* target) {
+    auto pending = std::move(incompletePhis[target]);
+    incompletePhis.erase(target);
+    sealed.insert(target);
+    for (auto& [variable, phi] : pending) addPhiOperands(variable, phi);
+}
+
+// ==== Helpers ====
+
+NIRInstruction* NIRBuilder::emit(NIROp op, const Type* type, std::vector<NIRInstruction*> operands, ASTNode* site, const std::string& text) {
+    // code after return, break or throw still gets built, into a block nothing jumps to
+    if (terminated()) {
+        enter(function->createBlock("unreachable"));
+        sealed.insert(block);
+    }
+
+    auto instruction = makeMemoryPtr<NIRInstruction>();
+    instruction->op = op;
+    instruction->type = type;
+    instruction->operands = std::move(operands);
+    instruction->block = block;
+    instruction->site = site;
+    instruction->text = text;
+    block->instructions.push_back(std::move(instruction));
+    return block->instructions.back().get();
+}
+
+NIRInstruction* NIRBuilder::phi(NIRBlock* at, const Type* type) {
+    auto instruction = makeMemoryPtr<NIRInstruction>();
+    instruction->op = NIROp::Phi;
+    instruction->type = type;
+    instruction->block = at;
+
+    auto position = std::find_if(at->instructions.begin(), at->instructions.end(), [](const auto& existing) { return existing->op != NIROp::Phi; });
+    return at->instructions.insert(position, std::move(instruction))->get();
+}
+
+NIRInstruction* NIRBuilder::undefined(const Type* type) {
+    // at the top of the entry, so it dominates every use
+    NIRBlock* entry = function->blocks.front().get();
+    auto instruction = makeMemoryPtr<NIRInstruction>();
+    instruction->op = NIROp::Undefined;
+    instruction->type = type;
+    instruction->block = entry;
+    return entry->instructions.insert(entry->instructions.begin() + function->params.size(), std::move(instruction))->get();
+}
+
+void NIRBuilder::terminate(NIROp op, std::vector<NIRInstruction*> operands, std::vector<NIRBlock*> targets, ASTNode* site) {
+    NIRInstruction* instruction = emit(op, nullptr, std::move(operands), site);
+    instruction->targets = std::move(targets);
+    for (NIRBlock* target : instruction->targets) target->predecessors.push_back(block);
+}
+
+NIRInstruction* NIRBuilder::coerce(NIRInstruction* value, const Type* to, ASTNode* site) {
+    const Type* from = value->type;
+    if (!from || !to || from == to) return value;
+
+    // dynamic values are checked when they're used
+    if (from->isDynamic() || to->isDynamic()) return emit(NIROp::Convert, to, {value}, site);
+
+    if (to->kind == Type::Kind::Nullable) {
+        if (from == types->null()) return value->op == NIROp::Null ? emit(NIROp::Null, to, {}, site) : emit(NIROp::Convert, to, {value}, site);
+        if (from->kind == Type::Kind::Nullable) return emit(NIROp::Convert, to, {value}, site);
+        return emit(NIROp::Wrap, to, {coerce(value, to->element(), site)}, site);
+    }
+
+    // `number` takes every numeric type, containers take the ones of compatible components
+    if ((to->isPrimitive(ResolvedType::Number) && from->isNumeric()) || (from->kind == to->kind && from->kind != Type::Kind::Primitive && from->kind != Type::Kind::UserDefined))
+        return emit(NIROp::Convert, to, {value}, site);
+    return value;
+}
+
+const Type* NIRBuilder::boolType() const { return types->primitive(ResolvedType::Bool); }
+
+const Type* NIRBuilder::typeOf(const ASTNode* node) const { return node && node->inferredType ? node->inferredType : types->dynamic(); }
+
+std::string NIRBuilder::symbolName(const FunctionNode* node) const {
+    auto prefix = prefixes.find(node);
+    std::string parameters;
+    if (node->inferredType && node->inferredType->kind == Type::Kind::Function) {
+        for (size_t i = 0; i < node->inferredType->paramCount(); i++) {
+            if (i) parameters += ',';
+            parameters += node->inferredType->param(i)->toString();
+        }
+    }
+    return std::format("{}.{}{}({})", IRGenerator::modulePath(node->filePath, sourceFolder), prefix != prefixes.end() ? prefix->second : "", node->name, parameters);
+}
+
+std::string NIRBuilder::globalName(const DeclarationNode* node) const {
+    auto prefix = prefixes.find(node);
+    return std::format("{}.{}{}", IRGenerator::modulePath(node->filePath, sourceFolder), prefix != prefixes.end() ? prefix->second : "", node->variable->varName);
+}
+
+DeclarationNode* NIRBuilder::findGlobal(const std::string& name, const std::string& filePath) const {
+    auto it = globals.find(name);
+    if (it == globals.end()) return nullptr;
+    for (DeclarationNode* declaration : it->second)
+        if (declaration->filePath == filePath) return declaration;
+    return it->second.front();
+}
+
+const ASTNode* NIRBuilder::findLocal(const std::string& name) const {
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope)
+        if (auto it = scope->find(name); it != scope->end()) return it->second;
+    return nullptr;
+}
+
+void NIRBuilder::declareLocal(const std::string& name, const ASTNode* variable, const Type* type) {
+    scopes.back()[name] = variable;
+    variableTypes[variable] = type;
+}
+
+// ==== Statements ====
+
+void NIRBuilder::buildStatement(ASTNode* node) {
+    switch (node->type) {
+        case ASTNodeType::Declaration: buildDeclaration(static_cast<DeclarationNode*>(node)); break;
+        case ASTNodeType::Assignment: buildAssignment(static_cast<AssignmentNode*>(node)); break;
+        case ASTNodeType::Block: buildBlock(node); break;
+        case ASTNodeType::IfStatement: buildIf(static_cast<IfNode*>(node)); break;
+        case ASTNodeType::WhileLoop: buildWhile(static_cast<WhileLoopNode*>(node)); break;
+        case ASTNodeType::ForLoop: buildFor(static_cast<ForLoopNode*>(node)); break;
+        case ASTNodeType::Switch: buildSwitch(static_cast<SwitchNode*>(node)); break;
+        case ASTNodeType::TryCatch: buildTryCatch(static_cast<TryCatchNode*>(node)); break;
+        case ASTNodeType::ReturnStatement: buildReturn(static_cast<ReturnStatementNode*>(node)); break;
+        case ASTNodeType::ThrowStatement: buildThrow(static_cast<ThrowStatementNode*>(node)); break;
+        case ASTNodeType::BreakStatement:
+            if (!loops.empty()) jump(loops.back().breakTarget, node);
+            break;
+        case ASTNodeType::ContinueStatement:
+            if (!loops.empty()) jump(loops.back().continueTarget, node);
+            break;
+        case ASTNodeType::Import: case ASTNodeType::Function: case ASTNodeType::Class: break; // nested ones aren't lowered yet
+        default: buildExpression(node); break;
+    }
+}
+
+void NIRBuilder::buildBlock(ASTNode* node) {
+    if (!node) return;
+    if (node->type != ASTNodeType::Block) return buildStatement(node);
+
+    scopes.emplace_back();
+    for (auto& statement : static_cast<BlockNode*>(node)->statements) buildStatement(statement.get());
+    scopes.pop_back();
+}
+
+void NIRBuilder::buildDeclaration(DeclarationNode* node) {
+    const Type* type = typeOf(node);
+
+    // the value comes first: in `x := x + 1` the right `x` is still the outer one
+    NIRInstruction* value;
+    if (node->value) value = coerce(buildExpression(node->value.get()), type, node);
+    else if (type->kind == Type::Kind::Nullable) value = emit(NIROp::Null, type, {}, node);
+    else value = undefined(type);
+
+    declareLocal(node->variable->varName, node, type);
+    writeVariable(node, block, value);
+}
+
+void NIRBuilder::buildAssignment(AssignmentNode* node) {
+    // x += y is x = x + y
+    std::string op = node->op.substr(0, node->op.size() - 1);
+    auto combine = [&](NIRInstruction* current, const Type* type) {
+        NIRInstruction* value = coerce(buildExpression(node->value.get()), type, node);
+        return node->op == "=" ? value : buildOperation(op, current, value, type, node);
+    };
+
+    if (node->variable->type == ASTNodeType::MemberAccess) {
+        auto* target = static_cast<MemberAccessNode*>(node->variable.get());
+        NIRInstruction* object = receiver(target->parent.get());
+        std::string field = target->val->type == ASTNodeType::Variable ? static_cast<VariableNode*>(target->val.get())->varName : target->val->value;
+        NIRInstruction* current = node->op == "=" ? nullptr : emit(NIROp::GetField, types->dynamic(), {object}, node, field);
+        emit(NIROp::SetField, nullptr, {object, combine(current, types->dynamic())}, node, field);
+        return;
+    }
+    if (node->variable->type != ASTNodeType::Variable) {
+        buildExpression(node->value.get());
+        return;
+    }
+
+    auto* variableNode = static_cast<VariableNode*>(node->variable.get());
+    if (const ASTNode* local = findLocal(variableNode->varName)) {
+        const Type* type = variableTypes.at(local);
+        NIRInstruction* current = node->op == "=" ? nullptr : readVariable(local, block);
+        NIRInstruction* value = combine(current, type);
+        writeVariable(local, block, value);
+        return;
+    }
+
+    DeclarationNode* global = findGlobal(variableNode->varName, variableNode->filePath);
+    if (!global) {
+        buildExpression(node->value.get());
+        return;
+    }
+    const Type* type = typeOf(global);
+    NIRInstruction* current = nullptr;
+    if (node->op != "=") {
+        current = emit(NIROp::LoadGlobal, type, {}, node, globalName(global));
+        current->global = global;
+    }
+    NIRInstruction* store = emit(NIROp::StoreGlobal, nullptr, {combine(current, type)}, node, globalName(global));
+    store->global = global;
+}
+
+void NIRBuilder::buildIf(IfNode* node) {
+    NIRInstruction* condition = buildExpression(node->condition.get());
+    NIRBlock* thenBlock = function->createBlock("then");
+    NIRBlock* elseBlock = node->elseBlock ? function->createBlock("else") : nullptr;
+    NIRBlock* end = function->createBlock("endif");
+    branch(condition, thenBlock, elseBlock ? elseBlock : end, node);
+
+    seal(thenBlock);
+    enter(thenBlock);
+    buildBlock(node->thenBlock.get());
+    if (!terminated()) jump(end, node);
+
+    // `else if` is an IfNode in place of the else block
+    if (elseBlock) {
+        seal(elseBlock);
+        enter(elseBlock);
+        buildBlock(node->elseBlock.get());
+        if (!terminated()) jump(end, node);
+    }
+    seal(end);
+    enter(end);
+}
+
+void NIRBuilder::buildWhile(WhileLoopNode* node) {
+    NIRBlock* header = function->createBlock("while");
+    NIRBlock* body = function->createBlock("body");
+    NIRBlock* exit = function->createBlock("endwhile");
+    jump(header, node);
+
+    // the header isn't sealed till the body has jumped back to it
+    enter(header);
+    branch(buildExpression(node->condition.get()), body, exit, node);
+    seal(body);
+    enter(body);
+    loops.push_back(Loop{header, exit});
+    buildBlock(node->body.get());
+    loops.pop_back();
+    if (!terminated()) jump(header, node);
+
+    seal(header);
+    seal(exit);
+    enter(exit);
+}
+
+void NIRBuilder::buildFor(ForLoopNode* node) {
+    // for x in xs: an iterator gives elements till it gives null. `for (i, x: pairs)` unpacks tuples into all its variables.
+    NIRInstruction* iterable = buildExpression(node->iterable.get());
+    std::vector<VariableNode*> variables{node->variable.get()};
+    for (auto& variable : node->unpacked) variables.push_back(variable.get());
+    const Type* elementType = typeOf(node->variable.get());
+    if (variables.size() > 1) {
+        std::vector<const Type*> elements;
+        for (VariableNode* variable : variables) elements.push_back(typeOf(variable));
+        elementType = types->tuple(elements);
+    }
+    NIRInstruction* iterator = emit(NIROp::Iterate, iterable->type ? iterable->type : types->dynamic(), {iterable}, node);
+
+    NIRBlock* header = function->createBlock("for");
+    NIRBlock* body = function->createBlock("body");
+    NIRBlock* exit = function->createBlock("endfor");
+    jump(header, node);
+
+    enter(header);
+    NIRInstruction* next = emit(NIROp::Next, types->nullable(elementType), {iterator}, node);
+    branch(emit(NIROp::IsNull, boolType(), {next}, node), exit, body, node);
+
+    seal(body);
+    enter(body);
+    scopes.emplace_back();
+    NIRInstruction* element = emit(NIROp::Unwrap, elementType, {next}, node);
+    for (size_t i = 0; i < variables.size(); i++) {
+        const Type* type = typeOf(variables[i]);
+        declareLocal(variables[i]->varName, variables[i], type);
+        writeVariable(variables[i], block, variables.size() == 1 ? element : emit(NIROp::GetField, type, {element}, node, std::to_string(i)));
+    }
+    loops.push_back(Loop{header, exit});
+    buildBlock(node->body.get());
+    loops.pop_back();
+    scopes.pop_back();
+    if (!terminated()) jump(header, node);
+
+    seal(header);
+    seal(exit);
+    enter(exit);
+}
+
+void NIRBuilder::buildSwitch(SwitchNode* node) {
+    // a chain of comparisons, cases don't fall through
+    NIRInstruction* value = buildExpression(node->expression.get());
+    NIRBlock* end = function->createBlock("endswitch");
+
+    for (const auto& caseNode : node->cases) {
+        NIRInstruction* candidate = coerce(buildExpression(caseNode->condition.get()), value->type, caseNode.get());
+        NIRBlock* body = function->createBlock("case");
+        NIRBlock* next = function->createBlock("next");
+        branch(emit(NIROp::Equal, boolType(), {value, candidate}, caseNode.get()), body, next, caseNode.get());
+
+        seal(body);
+        enter(body);
+        buildBlock(caseNode->body.get());
+        if (!terminated()) jump(end, caseNode.get());
+        seal(next);
+        enter(next);
+    }
+
+    if (node->defaultCase) buildBlock(node->defaultCase->body.get());
+    if (!terminated()) jump(end, node);
+    seal(end);
+    enter(end);
+}
+
+void NIRBuilder::buildTryCatch(TryCatchNode* node) {
+    NIRBlock* catchBlock = function->createBlock("catch");
+    NIRBlock* end = function->createBlock("endtry");
+
+    tries.push_back(Try{node->exception.get(), catchBlock});
+    buildBlock(node->tryBlock.get());
+    tries.pop_back();
+    if (!terminated()) jump(end, node);
+
+    // every throw wrote the exception before jumping here, reading it merges them
+    seal(catchBlock);
+    enter(catchBlock);
+    scopes.emplace_back();
+    declareLocal(node->exception->varName, node->exception.get(), types->dynamic());
+    buildBlock(node->catchBlock.get());
+    scopes.pop_back();
+    if (!terminated()) jump(end, node);
+
+    seal(end);
+    enter(end);
+}
+
+void NIRBuilder::buildReturn(ReturnStatementNode* node) {
+    if (!node->expression) return terminate(NIROp::Return, {}, {}, node);
+
+    NIRInstruction* value = buildExpression(node->expression.get());
+    if (!function->returnType) return terminate(NIROp::Return, {}, {}, node);
+    terminate(NIROp::Return, {coerce(value, function->returnType, node)}, {}, node);
+}
+
+void NIRBuilder::buildThrow(ThrowStatementNode* node) {
+    NIRInstruction* value = node->expression ? coerce(buildExpression(node->expression.get()), types->dynamic(), node) : emit(NIROp::Null, types->dynamic(), {}, node);
+    if (tries.empty()) return terminate(NIROp::Throw, {value}, {}, node);
+
+    writeVariable(tries.back().exception, block, value);
+    jump(tries.back().catchBlock, node);
+}
+
+// ==== Expressions ====
+
+NIRInstruction* NIRBuilder::buildExpression(ASTNode* node) {
+    switch (node->type) {
+        case ASTNodeType::Literal: return buildLiteral(static_cast<LiteralNode*>(node));
+        case ASTNodeType::Variable: return buildVariable(static_cast<VariableNode*>(node));
+        case ASTNodeType::BinaryOperation: return buildBinary(static_cast<BinaryOperationNode*>(node));
+        case ASTNodeType::UnaryOperation: {
+            auto* unary = static_cast<UnaryOperationNode*>(node);
+            NIRInstruction* operand = buildExpression(unary->operand.get());
+            if (unary->value == "await") return emit(NIROp::Await, typeOf(node), {operand}, node);
+            return emit(unary->value == "-" ? NIROp::Negate : NIROp::Not, typeOf(node), {operand}, node);
+        }
+        case ASTNodeType::CallExpression: return buildCall(static_cast<CallExpressionNode*>(node));
+        case ASTNodeType::MemberAccess: return buildMemberAccess(static_cast<MemberAccessNode*>(node));
+        case ASTNodeType::Array: case ASTNodeType::Set: case ASTNodeType::Dict: return buildCollection(node);
+        case ASTNodeType::Result: {
+            auto* result = static_cast<ResultNode*>(node);
+            ASTNode* inner = result->isError ? result->e.get() : result->t.get();
+            std::vector<NIRInstruction*> operands;
+            if (inner) operands.push_back(buildExpression(inner));
+            return emit(result->isError ? NIROp::MakeError : NIROp::MakeOk, typeOf(node), std::move(operands), node);
+        }
+        case ASTNodeType::Lambda: return emit(NIROp::Lambda, typeOf(node), {}, node);
+        default: return emit(NIROp::Undefined, typeOf(node), {}, node);
+    }
+}
+
+NIRInstruction* NIRBuilder::readName(const std::string& name, const std::string& filePath, ASTNode* site) {
+    if (const ASTNode* local = findLocal(name)) return readVariable(local, block);
+    if (DeclarationNode* global = findGlobal(name, filePath)) {
+        NIRInstruction* load = emit(NIROp::LoadGlobal, typeOf(global), {}, site, globalName(global));
+        load->global = global;
+        return load;
+    }
+    return nullptr;
+}
+
+NIRInstruction* NIRBuilder::buildVariable(VariableNode* node) {
+    if (NIRInstruction* value = readName(node->varName, node->filePath, node)) return value;
+    return emit(NIROp::Symbol, typeOf(node), {}, node, node->varName); // functions, classes and enums used as values
+}
+
+NIRInstruction* NIRBuilder::buildLiteral(LiteralNode* node) {
+    if (node->literalType == ASTLiteralType::Null) return emit(NIROp::Null, types->null(), {}, node);
+    if (isInterpolation(node)) return buildInterpolation(node);
+    return emit(NIROp::Constant, typeOf(node), {}, node, node->value);
+}
+
+NIRInstruction* NIRBuilder::buildInterpolation(LiteralNode* node) {
+    // "a ${b} c" keeps its pieces, it's one operation till the runtime puts them together
+    const Type* str = types->primitive(ResolvedType::Str);
+    std::vector<NIRInstruction*> pieces;
+    for (size_t i = 0; i < node->interpolations.size(); i++) {
+        if (!node->pieces[i].empty()) pieces.push_back(emit(NIROp::Constant, str, {}, node, node->pieces[i]));
+        pieces.push_back(buildExpression(node->interpolations[i].get()));
+    }
+    if (!node->pieces.back().empty()) pieces.push_back(emit(NIROp::Constant, str, {}, node, node->pieces.back()));
+    return emit(NIROp::Interpolate, str, std::move(pieces), node);
+}
+
+NIRInstruction* NIRBuilder::buildBinary(BinaryOperationNode* node) {
+    if (isLogical(node->value)) return buildLogical(node);
+    const std::string& op = node->value;
+
+    // comparing a nullable with the null literal is a check, not a comparison of values
+    if (op == "==" || op == "!=") {
+        ASTNode* left = node->leftOperand.get();
+        ASTNode* right = node->rightOperand.get();
+        auto isNullLiteral = [](ASTNode* operand) { return operand->type == ASTNodeType::Literal && static_cast<LiteralNode*>(operand)->literalType == ASTLiteralType::Null; };
+        if (isNullLiteral(left) != isNullLiteral(right)) {
+            NIRInstruction* value = buildExpression(isNullLiteral(left) ? right : left);
+            NIRInstruction* check = emit(NIROp::IsNull, boolType(), {value}, node);
+            return op == "==" ? check : emit(NIROp::Not, boolType(), {check}, node);
+        }
+    }
+
+    NIRInstruction* left = buildExpression(node->leftOperand.get());
+    NIRInstruction* right = buildExpression(node->rightOperand.get());
+
+    // operands are brought to one type: T goes into T?, anything goes into dynamic
+    const Type* type = typeOf(node);
+    bool comparison = op == "==" || op == "!=" || op == "<" || op == ">" || op == "<=" || op == ">=";
+    if (comparison) {
+        type = left->type ? left->type : types->dynamic();
+        if (right->type && (right->type->isDynamic() || (right->type->kind == Type::Kind::Nullable && type->kind != Type::Kind::Nullable))) type = right->type;
+    }
+    return buildOperation(op, coerce(left, type, node), coerce(right, type, node), typeOf(node), node);
+}
+
+NIRInstruction* NIRBuilder::buildLogical(BinaryOperationNode* node) {
+    // the right operand only runs when the left one doesn't decide, a phi takes whichever value was last
+    bool isAnd = node->value == "&&" || node->value == "and";
+    NIRInstruction* left = buildExpression(node->leftOperand.get());
+    NIRBlock* leftEnd = block;
+    NIRBlock* rightBlock = function->createBlock(isAnd ? "and" : "or");
+    NIRBlock* end = function->createBlock(isAnd ? "endand" : "endor");
+    if (isAnd) branch(left, rightBlock, end, node);
+    else branch(left, end, rightBlock, node);
+
+    seal(rightBlock);
+    enter(rightBlock);
+    NIRInstruction* right = buildExpression(node->rightOperand.get());
+    NIRBlock* rightEnd = block;
+    jump(end, node);
+
+    seal(end);
+    enter(end);
+    NIRInstruction* result = phi(end, boolType());
+    result->operands = {left, right};
+    result->targets = {leftEnd, rightEnd};
+    return result;
+}
+
+NIRInstruction* NIRBuilder::buildOperation(const std::string& op, NIRInstruction* left, NIRInstruction* right, const Type* type, ASTNode* site) {
+    static const std::unordered_map<std::string, NIROp> operations = {
+        {"+", NIROp::Add}, {"-", NIROp::Subtract}, {"*", NIROp::Multiply}, {"/", NIROp::Divide}, {"%", NIROp::Remainder}, {"^", NIROp::Power},
+        {"&", NIROp::BitAnd}, {"|", NIROp::BitOr}, {"^^", NIROp::BitXor}, {"<<", NIROp::ShiftLeft}, {">>", NIROp::ShiftRight},
+        {"==", NIROp::Equal}, {"!=", NIROp::NotEqual}, {"<", NIROp::Less}, {"<=", NIROp::LessEqual}, {">", NIROp::Greater}, {">=", NIROp::GreaterEqual},
+    };
+
+    auto it = operations.find(op);
+    if (it == operations.end()) return emit(NIROp::Undefined, type, {}, site);
+    if (it->second == NIROp::Add && left->type && left->type->isPrimitive(ResolvedType::Str)) return emit(NIROp::Concat, type, {left, right}, site);
+    return emit(it->second, type, {left, right}, site);
+}
+
+NIRInstruction* NIRBuilder::buildCall(CallExpressionNode* node) {
+    if (node->resolvedFunction) return buildDirectCall(node, node->resolvedFunction);
+
+    std::vector<NIRInstruction*> arguments;
+    if (node->callee->type == ASTNodeType::MemberAccess) {
+        auto* access = static_cast<MemberAccessNode*>(node->callee.get());
+        NIRInstruction* object = receiver(access->parent.get());
+        for (auto& argument : node->arguments) arguments.push_back(buildExpression(argument.get()));
+        std::string name = access->val->type == ASTNodeType::Variable ? static_cast<VariableNode*>(access->val.get())->varName : access->val->value;
+        return buildMethodCall(object, name, std::move(arguments), node);
+    }
+
+    // lambdas, function values and constructors
+    arguments.push_back(buildExpression(node->callee.get()));
+    for (auto& argument : node->arguments) arguments.push_back(coerce(buildExpression(argument.get()), types->dynamic(), argument.get()));
+    return emit(NIROp::CallValue, typeOf(node), std::move(arguments), node);
+}
+
+NIRInstruction* NIRBuilder::buildDirectCall(CallExpressionNode* node, FunctionNode* callee) {
+    // missing arguments are the defaults of the parameters
+    std::vector<NIRInstruction*> arguments;
+    const Type* signature = callee->inferredType && callee->inferredType->kind == Type::Kind::Function ? callee->inferredType : nullptr;
+    for (size_t i = 0; i < std::max(node->arguments.size(), callee->parameters.size()); i++) {
+        ASTNode* argument = i < node->arguments.size() ? node->arguments[i].get() : callee->parameters[i]->defaultValue.get();
+        if (!argument) continue;
+        NIRInstruction* value = buildExpression(argument);
+        if (!callee->isIntrinsic && signature && i < signature->paramCount()) value = coerce(value, signature->param(i), argument);
+        arguments.push_back(value);
+    }
+
+    const Type* type = typeOf(node);
+    if (type->isVoid() || (callee->body && type->isDynamic() && !returnsValue(callee->body.get()))) type = nullptr;
+    NIRInstruction* call = emit(NIROp::Call, type, std::move(arguments), node, symbolName(callee));
+    call->callee = callee;
+    return call;
+}
+
+NIRInstruction* NIRBuilder::buildMemberAccess(MemberAccessNode* node) {
+    // std.math.sqrt(x) is a chain ending in a call the Frontend resolved
+    ASTNode* last = node;
+    while (last->type == ASTNodeType::MemberAccess) last = static_cast<MemberAccessNode*>(last)->val.get();
+    if (last->type == ASTNodeType::CallExpression && static_cast<CallExpressionNode*>(last)->resolvedFunction)
+        return buildDirectCall(static_cast<CallExpressionNode*>(last), static_cast<CallExpressionNode*>(last)->resolvedFunction);
+
+    // a chain that doesn't start with a value names something in a namespace
+    ASTNode* root = node;
+    while (root->type == ASTNodeType::MemberAccess) root = static_cast<MemberAccessNode*>(root)->parent.get();
+    if (root->type == ASTNodeType::Variable) {
+        auto* rootVariable = static_cast<VariableNode*>(root);
+        if (!findLocal(rootVariable->varName) && !findGlobal(rootVariable->varName, rootVariable->filePath) && rootVariable->varName != "self")
+            return emit(NIROp::Symbol, typeOf(node), {}, node, namespacePath(node));
+    }
+
+    NIRInstruction* object = receiver(node->parent.get());
+    if (node->val->type == ASTNodeType::CallExpression) {
+        auto* call = static_cast<CallExpressionNode*>(node->val.get());
+        std::vector<NIRInstruction*> arguments;
+        for (auto& argument : call->arguments) arguments.push_back(buildExpression(argument.get()));
+        std::string name = call->callee->type == ASTNodeType::Variable ? static_cast<VariableNode*>(call->callee.get())->varName : call->callee->value;
+        return buildMethodCall(object, name, std::move(arguments), call);
+    }
+
+    std::string name = node->val->type == ASTNodeType::Variable ? static_cast<VariableNode*>(node->val.get())->varName : node->val->value;
+    const Type* type = object->type;
+    bool measurable = type && (type->kind == Type::Kind::Array || type->kind == Type::Kind::Set || type->kind == Type::Kind::Dict || type->isPrimitive(ResolvedType::Str));
+    if (measurable && (name == "length" || name == "size")) return emit(NIROp::Length, types->primitive(ResolvedType::Int), {object}, node);
+    return emit(NIROp::GetField, types->dynamic(), {object}, node, name);
+}
+
+NIRInstruction* NIRBuilder::buildMethodCall(NIRInstruction* object, const std::string& name, std::vector<NIRInstruction*> arguments, ASTNode* site) {
+    // methods of collections are operations of their own, so passes can see what they do
+    const Type* type = object->type;
+    Type::Kind kind = type ? type->kind : Type::Kind::Dynamic;
+    size_t count = arguments.size();
+    auto operation = [&](NIROp op, const Type* result, std::vector<const Type*> parameters) {
+        std::vector<NIRInstruction*> operands{object};
+        for (size_t i = 0; i < count; i++) operands.push_back(coerce(arguments[i], parameters[i], site));
+        return emit(op, result, std::move(operands), site);
+    };
+
+    if (kind == Type::Kind::Array || kind == Type::Kind::Set || kind == Type::Kind::Dict) {
+        if ((name == "length" || name == "size") && count == 0) return operation(NIROp::Length, types->primitive(ResolvedType::Int), {});
+    }
+    if (kind == Type::Kind::Array) {
+        const Type* element = type->element();
+        const Type* index = types->primitive(ResolvedType::Int);
+        if ((name == "push" || name == "append") && count == 1) return operation(NIROp::ArrayPush, nullptr, {element});
+        if (name == "get" && count == 1) return operation(NIROp::ArrayGet, element, {index});
+        if (name == "set" && count == 2) return operation(NIROp::ArraySet, nullptr, {index, element});
+    }
+    if (kind == Type::Kind::Set) {
+        const Type* element = type->element();
+        if ((name == "contains" || name == "has") && count == 1) return operation(NIROp::SetContains, boolType(), {element});
+        if ((name == "add" || name == "insert") && count == 1) return operation(NIROp::SetInsert, nullptr, {element});
+        if (name == "remove" && count == 1) return operation(NIROp::SetRemove, nullptr, {element});
+    }
+    if (kind == Type::Kind::Dict) {
+        const Type* key = type->components[0];
+        const Type* value = type->components[1];
+        if ((name == "contains" || name == "has") && count == 1) return operation(NIROp::DictContains, boolType(), {key});
+        if (name == "get" && count == 1) return operation(NIROp::DictGet, types->nullable(value), {key});
+        if (name == "set" && count == 2) return operation(NIROp::DictSet, nullptr, {key, value});
+        if (name == "remove" && count == 1) return operation(NIROp::DictRemove, nullptr, {key});
+    }
+
+    arguments.insert(arguments.begin(), object);
+    return emit(NIROp::CallMethod, types->dynamic(), std::move(arguments), site, name);
+}
+
+NIRInstruction* NIRBuilder::buildCollection(ASTNode* node) {
+    const Type* type = typeOf(node);
+    std::vector<NIRInstruction*> elements;
+    if (node->type == ASTNodeType::Dict) {
+        const Type* key = type->kind == Type::Kind::Dict ? type->components[0] : types->dynamic();
+        const Type* value = type->kind == Type::Kind::Dict ? type->components[1] : types->dynamic();
+        for (auto& [k, v] : static_cast<DictNode*>(node)->elements) {
+            elements.push_back(coerce(buildExpression(k.get()), key, k.get()));
+            elements.push_back(coerce(buildExpression(v.get()), value, v.get()));
+        }
+        return emit(NIROp::DictNew, type, std::move(elements), node);
+    }
+
+    bool isArray = node->type == ASTNodeType::Array;
+    const Type* element = type->element() && type->kind != Type::Kind::Dynamic ? type->element() : types->dynamic();
+    for (auto& value : isArray ? static_cast<ArrayNode*>(node)->elements : static_cast<SetNode*>(node)->elements)
+        elements.push_back(coerce(buildExpression(value.get()), element, value.get()));
+    return emit(isArray ? NIROp::ArrayNew : NIROp::SetNew, type, std::move(elements), node);
+}
+
+NIRInstruction* NIRBuilder::receiver(ASTNode* node) {
+    NIRInstruction* value = buildExpression(node);
+    if (value->type && value->type->kind == Type::Kind::Nullable) return emit(NIROp::NullCheck, value->type->element(), {value}, node);
+    return value;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "NIR.hpp"
+
+struct TypeContext;
+
+/* NIR Builder lowers modules that went through the whole Frontend into NIR, SSA straight from the tree: variables
+ * become values as the code is walked, with phis where control flow meets ("Simple and Efficient Construction of SSA
+ * Form" by Braun et al.). A block is sealed once all of its predecessors are known, phis asked for before that are
+ * filled in when it is.
+ *
+ * Everything the Frontend accepts gets lowered, there's nothing to give up on: what isn't typed yet (members of
+ * objects, lambdas) stays dynamic. Globals are loaded and stored, their initializers run in `neoluma.init`.
+ * A `throw` inside `try` jumps to its `catch`, a call that throws just leaves the function for now.
+ */
+struct NIRBuilder {
+    TypeContext* types = nullptr; // of the program, the nullable and collection types NIR needs are made in there
+    std::filesystem::path sourceFolder; // module paths in symbol names are relative to it
+
+    NIRModule build(const std::string& name, const std::vector<ModuleNode*>& modules);
+
+private:
+    struct Loop {
+        NIRBlock* continueTarget;
+        NIRBlock* breakTarget;
+    };
+    struct Try {
+        const ASTNode* exception; // variable the thrown value goes to
+        NIRBlock* catchBlock;
+    };
+
+    NIRModule* module = nullptr;
+    std::unordered_map<const ASTNode*, std::string> prefixes; // "a.b." for functions and variables inside namespace a.b, "a.b.C." for methods of C
+    std::unordered_map<std::string, std::vector<DeclarationNode*>> globals; // by name, like IRGenerator::globals
+
+    // Function being built
+    NIRFunction* function = nullptr;
+    NIRBlock* block = nullptr; // where instructions go
+    std::vector<std::unordered_map<std::string, const ASTNode*>> scopes; // name -> the node that declared the variable
+    std::unordered_map<const ASTNode*, const Type*> variableTypes;
+    std::vector<Loop> loops;
+    std::vector<Try> tries;
+
+    // SSA construction
+    std::unordered_map<const NIRBlock*, std::unordered_map<const ASTNode*, NIRInstruction*>> definitions;
+    std::unordered_map<const NIRBlock*, std::unordered_map<const ASTNode*, NIRInstruction*>> incompletePhis;
+    std::unordered_set<const NIRBlock*> sealed;
+    std::vector<MemoryPtr<NIRInstruction>> removedPhis; // trivial ones, freed with the rest of the function's state
+
+    void writeVariable(const ASTNode* variable, NIRBlock* at, NIRInstruction* value) { definitions[at][variable] = value; }
+    NIRInstruction* readVariable(const ASTNode* variable, NIRBlock* at);
+    NIRInstruction* readVariableRecursive(const ASTNode* variable, NIRBlock* at);
+    NIRInstruction* addPhiOperands(const ASTNode* variable, NIRInstruction* phi);
+    NIRInstruction* tryRemoveTrivialPhi(NIRInstruction* phi);
+    void seal(NIRBlock* target);
+
+    // Helpers
+    NIRInstruction* emit(NIROp op, const Type* type, std::vector<NIRInstruction*> operands, ASTNode* site, const std::string& text = "");
+    NIRInstruction* phi(NIRBlock* at, const Type* type);
+    NIRInstruction* undefined(const Type* type);
+    void terminate(NIROp op, std::vector<NIRInstruction*> operands, std::vector<NIRBlock*> targets, ASTNode* site);
+    void jump(NIRBlock* target, ASTNode* site) { terminate(NIROp::Jump, {}, {target}, site); }
+    void branch(NIRInstruction* condition, NIRBlock* whenTrue, NIRBlock* whenFalse, ASTNode* site) { terminate(NIROp::Branch, {condition}, {whenTrue, whenFalse}, site); }
+    void enter(NIRBlock* target) { block = target; }
+    bool terminated() const { return block->terminator() != nullptr; }
+    NIRInstruction* coerce(NIRInstruction* value, const Type* to, ASTNode* site); // implicit conversions the Frontend allows
+    const Type* boolType() const;
+    const Type* typeOf(const ASTNode* node) const; // dynamic where the Frontend left no type
+    std::string symbolName(const FunctionNode* node) const;
+    std::string globalName(const DeclarationNode* node) const;
+    DeclarationNode* findGlobal(const std::string& name, const std::string& filePath) const;
+    const ASTNode* findLocal(const std::string& name) const;
+    void declareLocal(const std::string& name, const ASTNode* variable, const Type* type);
+
+    // Builders
+    void declareTopLevel(std::vector<MemoryPtr<ASTNode>>& body, const std::string& prefix);
+    void buildTopLevel(std::vector<MemoryPtr<ASTNode>>& body);
+    void buildFunction(FunctionNode* node, const Type* self = nullptr);
+    void buildInitializers(const std::vector<ModuleNode*>& modules);
+    void collectInitializers(std::vector<MemoryPtr<ASTNode>>& body, std::vector<DeclarationNode*>& initializers);
+
+    void buildStatement(ASTNode* node);
+    void buildBlock(ASTNode* node);
+    void buildDeclaration(DeclarationNode* node);
+    void buildAssignment(AssignmentNode* node);
+    void buildIf(IfNode* node);
+    void buildWhile(WhileLoopNode* node);
+    void buildFor(ForLoopNode* node);
+    void buildSwitch(SwitchNode* node);
+    void buildTryCatch(TryCatchNode* node);
+    void buildReturn(ReturnStatementNode* node);
+    void buildThrow(ThrowStatementNode* node);
+
+    NIRInstruction* buildExpression(ASTNode* node);
+    NIRInstruction* buildVariable(VariableNode* node);
+    NIRInstruction* readName(const std::string& name, const std::string& filePath, ASTNode* site); // a local or a global, nullptr if it's neither
+    NIRInstruction* buildLiteral(LiteralNode* node);
+    NIRInstruction* buildInterpolation(LiteralNode* node);
+    NIRInstruction* buildBinary(BinaryOperationNode* node);
+    NIRInstruction* buildLogical(BinaryOperationNode* node);
+    NIRInstruction* buildOperation(const std::string& op, NIRInstruction* left, NIRInstruction* right, const Type* type, ASTNode* site);
+    NIRInstruction* buildCall(CallExpressionNode* node);
+    NIRInstruction* buildDirectCall(CallExpressionNode* node, FunctionNode* callee);
+    NIRInstruction* buildMemberAccess(MemberAccessNode* node);
+    NIRInstruction* buildMethodCall(NIRInstruction* receiver, const std::string& name, std::vector<NIRInstruction*> arguments, ASTNode* site);
+    NIRInstruction* buildCollection(ASTNode* node);
+    NIRInstruction* receiver(ASTNode* node); // value a member is accessed on, null-checked if it's nullable
+};
@@ -0,0 +1,41 @@
+#include "PassManager.hpp"
+
+#include <format>
+
+#include "Passes/Passes.hpp"
+
+void PassManager::add(MemoryPtr<NIRPass> pass) {
+    passTimings.push_back(Timing{pass->name()});
+    passes.push_back(std::move(pass));
+}
+
+void PassManager::run(NIRModule& module) {
+    for (size_t i = 0; i < passes.size(); i++) {
+        Timing& timing = passTimings[i];
+        for (auto& function : module.functions) {
+            auto start = std::chrono::steady_clock::now();
+            bool changed = passes[i]->run(*function);
+            timing.time += std::chrono::steady_clock::now() - start;
+            timing.functions++;
+            if (changed) timing.changed++;
+        }
+    }
+}
+
+std::string PassManager::report() const {
+    std::string out = "; pass timings\n";
+    for (const Timing& timing : passTimings)
+        out += std::format(";   {:<24} {:>10.3f} ms, changed {} of {} functions\n", timing.pass, timing.time.count() / 1e6, timing.changed, timing.functions);
+    return out;
+}
+
+PassManager PassManager::defaultPipeline(bool arc) {
+    PassManager manager;
+    manager.add(makeMemoryPtr<NullCheckElimination>());
+    manager.add(makeMemoryPtr<CollectionFusion>());
+    manager.add(makeMemoryPtr<DeadCodeElimination>());
+    // counting comes last, on what's left of the values
+    if (arc) manager.add(makeMemoryPtr<ARCLowering>());
+    manager.add(makeMemoryPtr<ARCPairing>());
+    return manager;
+}
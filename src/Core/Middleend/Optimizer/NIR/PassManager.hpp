@@ -0,0 +1,38 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "NIR.hpp"
+
+// A transformation of NIR, run on one function at a time
+struct NIRPass {
+    virtual ~NIRPass() = default;
+    virtual const char* name() const = 0;
+    virtual bool run(NIRFunction& function) = 0; // true if the function changed
+};
+
+/* Pass Manager runs passes over every function of a module, in the order they were added, and times each of them.
+ * Passes leave predecessors up to date, so the next one can build its DominatorTree right away.
+ */
+struct PassManager {
+    struct Timing {
+        std::string pass;
+        std::chrono::nanoseconds time{};
+        size_t functions = 0, changed = 0; // functions run on, and the ones the pass changed
+    };
+
+    void add(MemoryPtr<NIRPass> pass);
+    void run(NIRModule& module);
+
+    const std::vector<Timing>& timings() const { return passTimings; } // one per pass, summed over every run()
+    std::string report() const; // timings as comment lines of the text form
+
+    // Null-check elimination, collection fusion and dead code elimination after them, then ARC pairing. With `arc`,
+    // ARC lowering runs before the pairing.
+    static PassManager defaultPipeline(bool arc = false);
+
+private:
+    std::vector<MemoryPtr<NIRPass>> passes;
+    std::vector<Timing> passTimings;
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Core/Middleend/Optimizer/NIR/NIR.hpp"
+
+/* What ARC lowering and the passes after it agree on.
+ *
+ * Counted objects are strings, collections, results, closures, class instances and dynamic values, and nullables of
+ * them. A value that only looks at another one (Wrap, Unwrap, NullCheck, a Convert between counted types) is the same
+ * object: counts are kept on its root, the value it was made from. Constants are never freed, they aren't counted.
+ *
+ * Every root a function holds is owned: producers of new objects give +1, the function retains what it only
+ * borrowed (parameters, loads, fields, elements) right after getting it, and releases each root after its last use.
+ * Uses that keep the object (stores, returns, elements of new collections, phis, iterators over it) consume a
+ * reference, the function retains one for each of them. Calls borrow their arguments: the caller holds them for the
+ * whole call.
+ */
+namespace ARC {
+    bool isCounted(const Type* type);
+    NIRInstruction* root(NIRInstruction* value);
+    bool isManaged(const NIRInstruction* root); // a root that is counted at all
+    bool borrows(const NIRInstruction* root); // a root that doesn't come with a reference of its own
+    bool consumes(const NIRInstruction* user, size_t operand); // whether operand `operand` of `user` keeps the object
+
+    // Managed roots live at the start and at the end of every reachable block. Phi operands are used at the end of
+    // the block they come from.
+    struct Liveness {
+        std::unordered_map<const NIRBlock*, std::unordered_set<const NIRInstruction*>> in, out;
+    };
+    Liveness liveness(const NIRFunction& function, const DominatorTree& dominators);
+
+    // Removes blocks of `blocks` that only jump on and have a single predecessor, which then jumps on itself
+    void removeEmptyBlocks(NIRFunction& function, const std::vector<NIRBlock*>& blocks);
+}
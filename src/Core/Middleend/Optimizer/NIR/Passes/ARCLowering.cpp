@@ -0,0 +1,283 @@
+#include "Passes.hpp"
+#include "ARC.hpp"
+
+#include <algorithm>
+#include <map>
+
+#include "Core/Frontend/SemanticAnalysis/Types.hpp"
+
+// ==== Ownership ====
+
+bool ARC::isCounted(const Type* type) {
+    if (!type) return false;
+    switch (type->kind) {
+        case Type::Kind::Primitive: return type->isPrimitive(ResolvedType::Str);
+        case Type::Kind::Nullable: return isCounted(type->element());
+        case Type::Kind::Null: return false;
+        default: return true;
+    }
+}
+
+NIRInstruction* ARC::root(NIRInstruction* value) {
+    while (true) {
+        switch (value->op) {
+            case NIROp::Wrap: case NIROp::Unwrap: case NIROp::NullCheck:
+                value = value->operands[0];
+                continue;
+            case NIROp::Convert:
+                if (!isCounted(value->operands[0]->type) || !isCounted(value->type)) return value; // boxing makes a new object
+                value = value->operands[0];
+                continue;
+            default: return value;
+        }
+    }
+}
+
+bool ARC::isManaged(const NIRInstruction* root) {
+    switch (root->op) {
+        case NIROp::Constant: case NIROp::Null: case NIROp::Undefined: case NIROp::Symbol: return false;
+        default: return isCounted(root->type);
+    }
+}
+
+bool ARC::borrows(const NIRInstruction* root) {
+    switch (root->op) {
+        case NIROp::Param: case NIROp::LoadGlobal: case NIROp::GetField:
+        case NIROp::ArrayGet: case NIROp::DictGet: case NIROp::DictLookup: case NIROp::Next:
+        case NIROp::UnwrapOk: case NIROp::UnwrapError:
+            return true;
+        default: return false;
+    }
+}
+
+bool ARC::consumes(const NIRInstruction* user, size_t operand) {
+    switch (user->op) {
+        case NIROp::StoreGlobal: case NIROp::Return: case NIROp::Throw: case NIROp::MakeOk: case NIROp::MakeError:
+        case NIROp::ArrayNew: case NIROp::SetNew: case NIROp::DictNew: case NIROp::Phi: case NIROp::Iterate:
+            return true;
+        case NIROp::SetField: case NIROp::ArrayPush: case NIROp::SetInsert: return operand == 1;
+        case NIROp::ArraySet: return operand == 2;
+        case NIROp::DictSet: return operand >= 1;
+        default: return false;
+    }
+}
+
+ARC::Liveness ARC::liveness(const NIRFunction& function, const DominatorTree& dominators) {
+    // roots each block uses before it defines them
+    std::unordered_map<const NIRBlock*, std::unordered_set<const NIRInstruction*>> uses;
+    for (NIRBlock* block : dominators.order()) {
+        for (auto& instruction : block->instructions) {
+            for (size_t i = 0; i < instruction->operands.size(); i++) {
+                NIRInstruction* value = root(instruction->operands[i]);
+                if (!isManaged(value)) continue;
+                const NIRBlock* from = instruction->op == NIROp::Phi ? instruction->targets[i] : block;
+                if (value->block != from) uses[from].insert(value);
+            }
+        }
+    }
+
+    Liveness live;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = dominators.order().rbegin(); it != dominators.order().rend(); it++) {
+            NIRBlock* block = *it;
+            auto& out = live.out[block];
+            for (NIRBlock* successor : block->successors())
+                for (const NIRInstruction* value : live.in[successor]) out.insert(value);
+
+            auto& in = live.in[block];
+            size_t before = in.size();
+            for (const NIRInstruction* value : uses[block]) in.insert(value);
+            for (const NIRInstruction* value : out)
+                if (value->block != block) in.insert(value);
+            changed |= in.size() != before;
+        }
+    }
+    return live;
+}
+
+void ARC::removeEmptyBlocks(NIRFunction& function, const std::vector<NIRBlock*>& blocks) {
+    function.computePredecessors();
+    std::unordered_set<const NIRBlock*> empty;
+    for (NIRBlock* block : blocks) {
+        if (block->instructions.size() != 1 || block->instructions[0]->op != NIROp::Jump || block->predecessors.size() != 1) continue;
+        NIRBlock* from = block->predecessors[0];
+        NIRBlock* to = block->instructions[0]->targets[0];
+        auto& targets = from->terminator()->targets;
+        if (to == block || std::find(targets.begin(), targets.end(), to) != targets.end()) continue; // phis of `to` would see `from` twice
+        std::replace(targets.begin(), targets.end(), block, to);
+        for (auto& phi : to->instructions) {
+            if (phi->op != NIROp::Phi) break;
+            std::replace(phi->targets.begin(), phi->targets.end(), block, from);
+        }
+        empty.insert(block);
+        function.computePredecessors();
+    }
+    std::erase_if(function.blocks, [&](const MemoryPtr<NIRBlock>& block) { return empty.contains(block.get()); });
+    function.computePredecessors();
+}
+
+// ==== Lowering ====
+
+static MemoryPtr<NIRInstruction> counting(NIROp op, NIRInstruction* value) {
+    auto instruction = makeMemoryPtr<NIRInstruction>();
+    instruction->op = op;
+    instruction->operands = {value};
+    instruction->site = value->site;
+    return instruction;
+}
+
+// A block of its own on the edge from `from` to `to`, that only jumps on
+static NIRBlock* splitEdge(NIRFunction& function, NIRBlock* from, NIRBlock* to) {
+    NIRBlock* edge = function.createBlock("edge");
+    auto jump = makeMemoryPtr<NIRInstruction>();
+    jump->op = NIROp::Jump;
+    jump->targets = {to};
+    jump->block = edge;
+    edge->instructions.push_back(std::move(jump));
+    std::replace(from->terminator()->targets.begin(), from->terminator()->targets.end(), to, edge);
+    for (auto& phi : to->instructions) {
+        if (phi->op != NIROp::Phi) break;
+        std::replace(phi->targets.begin(), phi->targets.end(), from, edge);
+    }
+    return edge;
+}
+
+bool ARCLowering::run(NIRFunction& function) {
+    // a phi's operand is retained on the way in from its block, which has to be the only way out of that block
+    function.computePredecessors();
+    std::vector<NIRBlock*> edgeBlocks;
+    for (size_t b = 0; b < function.blocks.size(); b++) {
+        NIRBlock* block = function.blocks[b].get();
+        if (block->instructions.empty() || block->instructions.front()->op != NIROp::Phi) continue;
+        for (NIRBlock* predecessor : std::vector<NIRBlock*>(block->predecessors))
+            if (predecessor->successors().size() > 1) edgeBlocks.push_back(splitEdge(function, predecessor, block));
+    }
+    function.computePredecessors();
+    DominatorTree dominators(function);
+    ARC::Liveness live = ARC::liveness(function, dominators);
+    std::vector<NIRBlock*> blocks = dominators.order(); // edges get split below
+
+    // what goes around each instruction, and at the start of blocks (after their phis)
+    std::unordered_map<const NIRInstruction*, std::vector<MemoryPtr<NIRInstruction>>> before, after;
+    std::unordered_map<const NIRBlock*, std::vector<MemoryPtr<NIRInstruction>>> atStart;
+    size_t inserted = 0;
+    auto place = [&](std::vector<MemoryPtr<NIRInstruction>>& list, NIROp op, NIRInstruction* value) {
+        list.push_back(counting(op, value));
+        inserted++;
+    };
+    NIRInstruction* lastParam = function.params.empty() ? nullptr : function.params.back();
+
+    // right after a root: retained if it was borrowed, parameters stay together at the top
+    auto afterDefinition = [&](NIRInstruction* value) -> std::vector<MemoryPtr<NIRInstruction>>& {
+        if (value->op == NIROp::Phi) return atStart[value->block];
+        return after[value->op == NIROp::Param ? lastParam : value];
+    };
+
+    for (NIRBlock* block : blocks) {
+        for (auto& instruction : block->instructions) {
+            if (ARC::isManaged(instruction.get()) && ARC::root(instruction.get()) == instruction.get() && ARC::borrows(instruction.get()))
+                place(afterDefinition(instruction.get()), NIROp::Retain, instruction.get());
+
+            // a reference for each use that keeps the object, phis take theirs at the end of the incoming block
+            for (size_t i = 0; i < instruction->operands.size(); i++) {
+                NIRInstruction* value = ARC::root(instruction->operands[i]);
+                if (!ARC::isManaged(value) || !ARC::consumes(instruction.get(), i)) continue;
+                if (instruction->op == NIROp::Phi) place(before[instruction->targets[i]->terminator()], NIROp::Retain, value);
+                else place(before[instruction.get()], NIROp::Retain, value);
+            }
+        }
+    }
+
+    // a root is released where it stops being live: after its last use in a block it doesn't outlive, or on the way
+    // into a successor it isn't live in
+    std::unordered_map<const NIRInstruction*, size_t> positions; // roots released at the same point go last to first
+    for (NIRBlock* block : blocks)
+        for (auto& instruction : block->instructions) positions.emplace(instruction.get(), positions.size());
+
+    std::vector<std::tuple<NIRBlock*, NIRBlock*, NIRInstruction*>> edges;
+    std::unordered_map<const NIRInstruction*, std::vector<MemoryPtr<NIRInstruction>>> terminatorReleases; // of roots the terminator doesn't use
+    for (NIRBlock* block : blocks) {
+        std::vector<NIRInstruction*> roots;
+        for (const NIRInstruction* value : live.in[block]) roots.push_back(const_cast<NIRInstruction*>(value));
+        for (auto& instruction : block->instructions)
+            if (ARC::isManaged(instruction.get()) && ARC::root(instruction.get()) == instruction.get()) roots.push_back(instruction.get());
+        std::sort(roots.begin(), roots.end(), [&](const NIRInstruction* a, const NIRInstruction* b) { return positions.at(a) > positions.at(b); });
+
+        for (NIRInstruction* value : roots) {
+            if (live.out[block].contains(value)) {
+                for (NIRBlock* successor : block->successors())
+                    if (!live.in[successor].contains(value) && std::find(edges.begin(), edges.end(), std::tuple{block, successor, value}) == edges.end())
+                        edges.emplace_back(block, successor, value);
+                continue;
+            }
+
+            // the last use, phis of successors use it at the terminator
+            NIRInstruction* last = nullptr;
+            bool usedByTerminator = false;
+            for (NIRBlock* successor : block->successors())
+                for (auto& phi : successor->instructions) {
+                    if (phi->op != NIROp::Phi) break;
+                    for (size_t i = 0; i < phi->operands.size(); i++)
+                        if (phi->targets[i] == block && ARC::root(phi->operands[i]) == value) usedByTerminator = true;
+                }
+            if (usedByTerminator) last = block->terminator();
+            for (auto it = block->instructions.rbegin(); !last && it != block->instructions.rend(); it++) {
+                if ((*it)->op == NIROp::Phi) break;
+                for (NIRInstruction* operand : (*it)->operands)
+                    if (ARC::root(operand) == value) last = it->get();
+                usedByTerminator = last && last->isTerminator();
+            }
+
+            if (!last) place(afterDefinition(value), NIROp::Release, value);
+            else if (usedByTerminator) place(before[last], NIROp::Release, value);
+            else if (last->isTerminator()) place(terminatorReleases[last], NIROp::Release, value);
+            else place(after[last], NIROp::Release, value);
+        }
+    }
+
+    // edges into blocks with other predecessors get a block of their own for the releases
+    std::map<std::pair<NIRBlock*, NIRBlock*>, NIRBlock*> split;
+    for (auto& [from, to, value] : edges) {
+        NIRBlock* target = to;
+        if (to->predecessors.size() > 1) {
+            auto [it, added] = split.try_emplace({from, to}, nullptr);
+            if (added) it->second = splitEdge(function, from, to);
+            target = it->second;
+        }
+        place(atStart[target], NIROp::Release, value);
+    }
+
+    // edge blocks nothing was put in go away again
+    std::erase_if(edgeBlocks, [&](NIRBlock* edge) { return !atStart[edge].empty() || !before[edge->terminator()].empty(); });
+    ARC::removeEmptyBlocks(function, edgeBlocks);
+    if (!inserted) return false;
+
+    // terminators: releases of what they don't use, then retains for what they give away, then releases of those
+    for (auto& block : function.blocks) {
+        std::vector<MemoryPtr<NIRInstruction>> instructions;
+        auto take = [&](std::vector<MemoryPtr<NIRInstruction>>& list) {
+            for (auto& instruction : list) {
+                instruction->block = block.get();
+                instructions.push_back(std::move(instruction));
+            }
+            list.clear();
+        };
+        size_t position = 0;
+        for (; position < block->instructions.size() && block->instructions[position]->op == NIROp::Phi; position++)
+            instructions.push_back(std::move(block->instructions[position]));
+        take(atStart[block.get()]);
+        for (; position < block->instructions.size(); position++) {
+            MemoryPtr<NIRInstruction>& instruction = block->instructions[position];
+            if (instruction->isTerminator()) take(terminatorReleases[instruction.get()]);
+            take(before[instruction.get()]);
+            const NIRInstruction* key = instruction.get();
+            instructions.push_back(std::move(instruction));
+            take(after[key]);
+        }
+        block->instructions = std::move(instructions);
+    }
+    function.computePredecessors();
+    return true;
+}
@@ -0,0 +1,211 @@
+#include "Passes.hpp"
+#include "ARC.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+// Whether a reference to anything could be dropped here, which an elided retain might have been keeping alive
+static bool mayRelease(const NIRInstruction* instruction) {
+    switch (instruction->op) {
+        case NIROp::Release:
+        case NIROp::Call: case NIROp::CallValue: case NIROp::CallMethod:
+        case NIROp::StoreGlobal: case NIROp::SetField:
+        case NIROp::ArraySet: case NIROp::SetRemove: case NIROp::DictSet: case NIROp::DictRemove:
+        case NIROp::Await:
+            return true;
+        default: return false;
+    }
+}
+
+static bool uses(const NIRInstruction* instruction, const NIRInstruction* object) {
+    return std::any_of(instruction->operands.begin(), instruction->operands.end(), [&](NIRInstruction* operand) { return ARC::root(operand) == object; });
+}
+
+static bool consumes(const NIRInstruction* instruction, const NIRInstruction* object) {
+    for (size_t i = 0; i < instruction->operands.size(); i++)
+        if (ARC::root(instruction->operands[i]) == object && ARC::consumes(instruction, i)) return true;
+    return false;
+}
+
+// Objects made here that nothing outside the function ever gets to see: not stored, returned, passed or captured
+static std::unordered_set<const NIRInstruction*> privateObjects(const NIRFunction& function) {
+    std::unordered_set<const NIRInstruction*> fresh, escaped;
+    for (auto& block : function.blocks) {
+        for (auto& instruction : block->instructions) {
+            switch (instruction->op) {
+                case NIROp::ArrayNew: case NIROp::SetNew: case NIROp::DictNew: case NIROp::Concat: case NIROp::Interpolate: case NIROp::Iterate:
+                    fresh.insert(instruction.get());
+                    break;
+                case NIROp::Lambda: return {}; // captures aren't operands, anything could be in there
+                default: break;
+            }
+
+            // an iterator keeps its collection, but it's only ever used by Next right here
+            bool leaves = instruction->op == NIROp::Call || instruction->op == NIROp::CallValue || instruction->op == NIROp::CallMethod || instruction->op == NIROp::Await;
+            for (size_t i = 0; i < instruction->operands.size(); i++)
+                if (leaves || (ARC::consumes(instruction.get(), i) && instruction->op != NIROp::Iterate)) escaped.insert(ARC::root(instruction->operands[i]));
+        }
+    }
+    std::erase_if(fresh, [&](const NIRInstruction* object) { return escaped.contains(object); });
+    return fresh;
+}
+
+// The collection an element was read from, and what holds that collection: itself, or the iterator going over it
+static const NIRInstruction* collectionOf(const NIRInstruction* element, const NIRInstruction*& holder) {
+    switch (element->op) {
+        case NIROp::ArrayGet: case NIROp::DictGet: case NIROp::DictLookup:
+            return holder = ARC::root(element->operands[0]);
+        case NIROp::Next:
+            holder = ARC::root(element->operands[0]);
+            return holder->op == NIROp::Iterate ? ARC::root(holder->operands[0]) : nullptr;
+        default: return nullptr;
+    }
+}
+
+static bool mutates(const NIRInstruction* instruction, const NIRInstruction* collection) {
+    switch (instruction->op) {
+        case NIROp::ArraySet: case NIROp::ArrayPush: case NIROp::SetInsert: case NIROp::SetRemove: case NIROp::DictSet: case NIROp::DictRemove:
+            return ARC::root(instruction->operands[0]) == collection;
+        default: return false;
+    }
+}
+
+/* Borrowed roots that need no reference of their own, because something else is sure to hold one while they live:
+ * - parameters, the caller holds them for the whole call
+ * - elements of a collection private to the function that nothing changes from there on, and that lives longer
+ * Their retain after the definition and their releases go away; retains for uses that keep them stay.
+ */
+static bool heldElsewhere(const DominatorTree& dominators, const ARC::Liveness& live, const std::unordered_set<const NIRInstruction*>& privates, const NIRInstruction* value) {
+    if (value->op == NIROp::Param) return true;
+    const NIRInstruction* holder = nullptr;
+    const NIRInstruction* collection = collectionOf(value, holder);
+    if (!collection || !privates.contains(collection)) return false;
+
+    // nothing changes it anywhere the element could still be around
+    std::unordered_set<const NIRBlock*> reachable;
+    std::vector<const NIRBlock*> stack{value->block};
+    while (!stack.empty()) {
+        const NIRBlock* block = stack.back();
+        stack.pop_back();
+        if (!reachable.insert(block).second) continue;
+        for (NIRBlock* successor : block->successors()) stack.push_back(successor);
+    }
+    for (const NIRBlock* block : reachable)
+        for (auto& instruction : block->instructions)
+            if (mutates(instruction.get(), collection)) return false;
+
+    // and whatever holds it is still live wherever the element is released
+    for (NIRBlock* block : dominators.order()) {
+        bool released = false, after = false;
+        for (auto& instruction : block->instructions) {
+            if (instruction->op == NIROp::Release && instruction->operands[0] == value) released = true, after = false;
+            else if (released && uses(instruction.get(), holder)) after = true;
+        }
+        if (released && !after && !live.out.at(block).contains(holder)) return false;
+    }
+    return true;
+}
+
+bool ARCPairing::run(NIRFunction& function) {
+    function.computePredecessors();
+    DominatorTree dominators(function);
+    std::unordered_set<const NIRInstruction*> removed;
+    std::unordered_set<const NIRInstruction*> privates = privateObjects(function);
+
+    // retains right after a borrowed root, and the releases that match them
+    {
+        ARC::Liveness live = ARC::liveness(function, dominators);
+        std::unordered_set<const NIRInstruction*> held;
+        for (NIRBlock* block : dominators.order()) {
+            for (auto& instruction : block->instructions) {
+                if (instruction->op != NIROp::Retain || removed.contains(instruction.get())) continue;
+                NIRInstruction* value = instruction->operands[0];
+                if (!ARC::borrows(value) || held.contains(value) || value->block != block) continue;
+                // the first retain after the definition, before anything uses it
+                bool first = true;
+                for (auto& earlier : block->instructions) {
+                    if (earlier.get() == instruction.get()) break;
+                    if (uses(earlier.get(), value)) first = false;
+                }
+                if (!first || !heldElsewhere(dominators, live, privates, value)) continue;
+                held.insert(value);
+                removed.insert(instruction.get());
+            }
+        }
+        for (auto& block : function.blocks)
+            for (auto& instruction : block->instructions)
+                if (instruction->op == NIROp::Release && held.contains(instruction->operands[0])) removed.insert(instruction.get());
+    }
+
+    // a retain cancels with a release of the same object further on, along a path nothing else joins, if the object
+    // can't go away in between (nothing that may release anything), or if the retain was for a use that keeps the
+    // object and the release is the function letting go of it right after: the use gets the function's reference
+    for (auto& start : function.blocks) {
+        for (size_t position = 0; position < start->instructions.size(); position++) {
+            NIRInstruction* retain = start->instructions[position].get();
+            if (retain->op != NIROp::Retain || removed.contains(retain)) continue;
+            NIRInstruction* object = retain->operands[0];
+            if (object->op == NIROp::Null) continue; // null isn't counted, those are dropped below
+
+            NIRBlock* block = start.get();
+            size_t index = position + 1;
+            bool consumed = false;
+            while (block) {
+                NIRInstruction* release = nullptr;
+                bool blocked = false;
+                for (; index < block->instructions.size(); index++) {
+                    NIRInstruction* instruction = block->instructions[index].get();
+                    if (removed.contains(instruction)) continue;
+                    if (instruction->op == NIROp::Release && instruction->operands[0] == object) {
+                        release = instruction;
+                        break;
+                    }
+                    bool used = instruction->op != NIROp::Retain && uses(instruction, object);
+                    if ((instruction->op == NIROp::Retain && instruction->operands[0] == object) || (consumed && used)) {
+                        blocked = true;
+                        break;
+                    }
+                    if (used && consumes(instruction, object)) {
+                        consumed = true;
+                        continue;
+                    }
+                    if (!consumed && mayRelease(instruction)) {
+                        blocked = true;
+                        break;
+                    }
+                }
+                if (release) {
+                    removed.insert(retain);
+                    removed.insert(release);
+                    break;
+                }
+
+                NIRInstruction* last = block->terminator();
+                if (blocked || !last || last->op != NIROp::Jump || last->targets[0]->predecessors.size() != 1 || last->targets[0] == start.get()) break;
+                block = last->targets[0];
+                index = 0;
+            }
+        }
+    }
+
+    size_t erased = 0;
+    std::vector<NIRBlock*> emptied;
+    for (auto& block : function.blocks) {
+        size_t count = std::erase_if(block->instructions, [&](const MemoryPtr<NIRInstruction>& instruction) {
+            return removed.contains(instruction.get()) || ((instruction->op == NIROp::Retain || instruction->op == NIROp::Release) && instruction->operands[0]->op == NIROp::Null);
+        });
+        if (count) emptied.push_back(block.get());
+        erased += count;
+    }
+    ARC::removeEmptyBlocks(function, emptied); // blocks ARC lowering made for releases on an edge
+
+    // counts of objects no other thread can reach don't need atomic instructions
+    size_t local = 0;
+    for (auto& block : function.blocks)
+        for (auto& instruction : block->instructions)
+            if ((instruction->op == NIROp::Retain || instruction->op == NIROp::Release) && instruction->atomic && privates.contains(instruction->operands[0])) {
+                instruction->atomic = false;
+                local++;
+            }
+    return erased + local > 0;
+}
@@ -0,0 +1,121 @@
+#include "Passes.hpp"
+
+#include <algorithm>
+
+#include "Core/Frontend/SemanticAnalysis/Types.hpp"
+
+namespace {
+
+// A read of a collection: what it asks (the op, DictGet standing for DictLookup too), of which collection, with what
+struct Read {
+    NIROp op;
+    const NIRInstruction* collection;
+    const NIRInstruction* argument; // nullptr for Length
+    NIRInstruction* value;
+};
+
+using Reads = std::vector<Read>;
+
+NIROp readKind(NIROp op) { return op == NIROp::DictLookup ? NIROp::DictGet : op; }
+
+bool isRead(NIROp op) {
+    return op == NIROp::DictGet || op == NIROp::DictLookup || op == NIROp::DictContains || op == NIROp::SetContains || op == NIROp::Length;
+}
+
+// Whether an instruction may change what the reads saw. Calls and suspension points change anything.
+bool invalidates(const NIRInstruction* instruction, Reads& reads) {
+    switch (instruction->op) {
+        case NIROp::Call: case NIROp::CallValue: case NIROp::CallMethod: case NIROp::Await:
+            reads.clear();
+            return true;
+        case NIROp::ArraySet: case NIROp::ArrayPush: case NIROp::SetInsert: case NIROp::SetRemove: case NIROp::DictSet: case NIROp::DictRemove:
+            std::erase_if(reads, [&](const Read& read) { return read.collection == instruction->operands[0]; });
+            return true;
+        default: return false;
+    }
+}
+
+NIRInstruction* find(Reads& reads, NIROp op, const NIRInstruction* collection, const NIRInstruction* argument) {
+    for (Read& read : reads)
+        if (read.op == op && read.collection == collection && read.argument == argument) return read.value;
+    return nullptr;
+}
+
+// Inserts a new instruction right before `position`, in its block
+NIRInstruction* insertBefore(NIRInstruction* position, NIROp op, const Type* type, std::vector<NIRInstruction*> operands) {
+    auto instruction = makeMemoryPtr<NIRInstruction>();
+    instruction->op = op;
+    instruction->type = type;
+    instruction->operands = std::move(operands);
+    instruction->block = position->block;
+    instruction->site = position->site;
+
+    auto& instructions = position->block->instructions;
+    auto it = std::find_if(instructions.begin(), instructions.end(), [&](const auto& existing) { return existing.get() == position; });
+    return instructions.insert(it, std::move(instruction))->get();
+}
+
+// `contains` becomes `not isnull lookup`
+void answerWith(NIRInstruction* contains, NIRInstruction* lookup) {
+    NIRInstruction* isNull = insertBefore(contains, NIROp::IsNull, contains->type, {lookup});
+    contains->op = NIROp::Not;
+    contains->operands = {isNull};
+}
+
+}
+
+bool CollectionFusion::run(NIRFunction& function) {
+    function.computePredecessors();
+    DominatorTree dominators(function);
+
+    // reads are known along straight paths: a block entered from one place only starts with what its predecessor ended with
+    std::unordered_map<const NIRBlock*, Reads> known;
+    bool changed = false;
+    for (NIRBlock* block : dominators.order()) {
+        Reads reads;
+        if (block->predecessors.size() == 1 && known.contains(block->predecessors[0])) reads = known.at(block->predecessors[0]);
+
+        // instructions are inserted on the way, the ones to look at are the ones there were
+        std::vector<NIRInstruction*> instructions;
+        for (auto& instruction : block->instructions) instructions.push_back(instruction.get());
+
+        for (NIRInstruction* instruction : instructions) {
+            if (invalidates(instruction, reads) || !isRead(instruction->op)) continue;
+            const NIRInstruction* collection = instruction->operands[0];
+            const NIRInstruction* argument = instruction->operands.size() > 1 ? instruction->operands[1] : nullptr;
+            NIROp op = readKind(instruction->op);
+
+            if (NIRInstruction* earlier = find(reads, op, collection, argument)) {
+                function.replaceAllUses(instruction, earlier);
+                changed = true;
+                continue;
+            }
+
+            // has, then get: the lookup takes the place of the has, which becomes a test of its result
+            if (op == NIROp::DictGet) {
+                if (NIRInstruction* contains = find(reads, NIROp::DictContains, collection, argument)) {
+                    NIRInstruction* lookup = insertBefore(contains, NIROp::DictLookup, instruction->type, contains->operands);
+                    answerWith(contains, lookup);
+                    function.replaceAllUses(instruction, lookup);
+                    std::erase_if(reads, [&](const Read& read) { return read.value == contains; });
+                    reads.push_back(Read{NIROp::DictGet, collection, argument, lookup});
+                    changed = true;
+                    continue;
+                }
+            }
+            // get, then has: the has asks the get's result
+            if (op == NIROp::DictContains) {
+                if (NIRInstruction* lookup = find(reads, NIROp::DictGet, collection, argument)) {
+                    answerWith(instruction, lookup);
+                    changed = true;
+                    continue;
+                }
+            }
+            reads.push_back(Read{op, collection, argument, instruction});
+        }
+        known[block] = std::move(reads);
+    }
+
+    if (changed) function.removeDead();
+    return changed;
+}
@@ -0,0 +1,110 @@
+#include "Passes.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+
+struct Facts {
+    const DominatorTree& dominators;
+    std::unordered_map<const NIRInstruction*, std::vector<const NIRInstruction*>> checks; // value -> NullChecks and Unwraps of it
+    std::unordered_map<const NIRInstruction*, std::vector<const NIRBlock*>> branches; // value -> blocks only reached when it isn't null
+
+    // Whether `value` can't be null where `at` is
+    bool nonNull(const NIRInstruction* value, const NIRInstruction* at) const {
+        std::unordered_set<const NIRInstruction*> visiting;
+        return nonNull(value, at, visiting);
+    }
+
+    bool nonNull(const NIRInstruction* value, const NIRInstruction* at, std::unordered_set<const NIRInstruction*>& visiting) const {
+        if (value->op == NIROp::Wrap) return true;
+        if (value->op == NIROp::Phi && !value->operands.empty()) {
+            // a loop phi that only merges itself with wrapped values
+            if (!visiting.insert(value).second) return true;
+            bool merged = std::all_of(value->operands.begin(), value->operands.end(), [&](const NIRInstruction* operand) { return nonNull(operand, value, visiting); });
+            visiting.erase(value);
+            if (merged) return true;
+        }
+
+        if (auto it = checks.find(value); it != checks.end()) {
+            for (const NIRInstruction* check : it->second) {
+                if (check == at) continue;
+                if (check->block != at->block ? dominators.dominates(check->block, at->block) : comesBefore(check, at)) return true;
+            }
+        }
+        if (auto it = branches.find(value); it != branches.end())
+            for (const NIRBlock* block : it->second)
+                if (dominators.dominates(block, at->block)) return true;
+        return false;
+    }
+
+    static bool comesBefore(const NIRInstruction* a, const NIRInstruction* b) {
+        for (const auto& instruction : a->block->instructions) {
+            if (instruction.get() == a) return true;
+            if (instruction.get() == b) return false;
+        }
+        return false;
+    }
+};
+
+// Value `condition` tests for null, and whether it's true when the value is null
+const NIRInstruction* testedValue(const NIRInstruction* condition, bool& trueWhenNull) {
+    trueWhenNull = true;
+    while (condition->op == NIROp::Not) {
+        condition = condition->operands[0];
+        trueWhenNull = !trueWhenNull;
+    }
+    return condition->op == NIROp::IsNull ? condition->operands[0] : nullptr;
+}
+
+}
+
+bool NullCheckElimination::run(NIRFunction& function) {
+    function.computePredecessors();
+    DominatorTree dominators(function);
+    Facts facts{dominators};
+
+    for (auto& block : function.blocks) {
+        for (auto& instruction : block->instructions) {
+            if (instruction->op == NIROp::NullCheck || instruction->op == NIROp::Unwrap) facts.checks[instruction->operands[0]].push_back(instruction.get());
+
+            // the side of the branch a value isn't null on, if nothing else leads there
+            if (instruction->op != NIROp::Branch) continue;
+            bool trueWhenNull;
+            const NIRInstruction* value = testedValue(instruction->operands[0], trueWhenNull);
+            NIRBlock* side = instruction->targets[trueWhenNull ? 1 : 0];
+            if (value && side->predecessors.size() == 1 && instruction->targets[0] != instruction->targets[1]) facts.branches[value].push_back(side);
+        }
+    }
+
+    bool changed = false;
+    for (NIRBlock* block : dominators.order()) {
+        for (auto& instruction : block->instructions) {
+            NIRInstruction* value = instruction->operands.empty() ? nullptr : instruction->operands[0];
+            switch (instruction->op) {
+                case NIROp::NullCheck:
+                case NIROp::Unwrap:
+                    // unwrapping what was just wrapped gives the value back
+                    if (value->op == NIROp::Wrap) {
+                        function.replaceAllUses(instruction.get(), value->operands[0]);
+                        instruction->op = NIROp::Unwrap; // can't fail anymore, left for dead-code elimination
+                        changed = true;
+                    } else if (instruction->op == NIROp::NullCheck && facts.nonNull(value, instruction.get())) {
+                        instruction->op = NIROp::Unwrap;
+                        changed = true;
+                    }
+                    break;
+                case NIROp::IsNull:
+                    if (value->op == NIROp::Null || facts.nonNull(value, instruction.get())) {
+                        instruction->text = value->op == NIROp::Null ? "true" : "false";
+                        instruction->op = NIROp::Constant;
+                        instruction->operands.clear();
+                        changed = true;
+                    }
+                    break;
+                default: break;
+            }
+        }
+    }
+    return changed;
+}
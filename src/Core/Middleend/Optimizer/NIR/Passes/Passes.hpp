@@ -0,0 +1,50 @@
+#pragma once
+#include "Core/Middleend/Optimizer/NIR/PassManager.hpp"
+
+/* Null-check elimination: a NullCheck of a value that can't be null at that point becomes an Unwrap, an IsNull of one
+ * becomes `false`. A value is known not to be null if it was just wrapped, if a check of it dominates the point, or if
+ * the point is only reached through the "not null" side of a branch on IsNull.
+ */
+struct NullCheckElimination : NIRPass {
+    const char* name() const override { return "null-check-elimination"; }
+    bool run(NIRFunction& function) override;
+};
+
+/* ARC lowering: retains and releases for counted objects, by the rules in ARC.hpp. Only run in ARC memory mode.
+ * It's the plain form, a root is held from where the function gets it to its last use and every use that keeps it
+ * retains it once more, ARC pairing takes out what's redundant.
+ */
+struct ARCLowering : NIRPass {
+    const char* name() const override { return "arc-lowering"; }
+    bool run(NIRFunction& function) override;
+};
+
+/* ARC pairing takes out counting that can't matter:
+ * - borrowed roots something else holds while they live don't get a reference of their own: parameters, whose caller
+ *   holds them through the call, and elements of a collection only this function sees that isn't changed any more
+ *   (a `for` over a local array counts nothing per element)
+ * - a retain for a use that keeps the object, followed by the release after its last use, is a move
+ * - a retain and a release of the same object cancel out when nothing in between can drop a reference to it (calls,
+ *   other releases, stores, suspension points)
+ * - retains and releases of null
+ * What's left of objects that never leave the function is marked non-atomic.
+ */
+struct ARCPairing : NIRPass {
+    const char* name() const override { return "arc-pairing"; }
+    bool run(NIRFunction& function) override;
+};
+
+/* Collection fusion: `d.has(k)` followed by `d.get(k)` is one hash lookup, DictLookup, with the `has` answered by
+ * whether it found anything. Reads of a collection repeated with nothing in between that could change it (writes to
+ * it, calls, suspension points) reuse the first read.
+ */
+struct CollectionFusion : NIRPass {
+    const char* name() const override { return "collection-fusion"; }
+    bool run(NIRFunction& function) override;
+};
+
+// Values nobody uses and blocks nothing jumps to, what the passes before it leave behind
+struct DeadCodeElimination : NIRPass {
+    const char* name() const override { return "dead-code-elimination"; }
+    bool run(NIRFunction& function) override { return function.removeDead() > 0; }
+};
@@ -42,6 +42,7 @@ std::string readFile(const std::string& filePath) {
 std::string formatStrVec(const std::string& fmt, const std::vector<std::string>& collectedArgs) {
     std::string out;
     size_t argCount = 0;
+    bool usedPositional = false;
     for (size_t i = 0; i < fmt.size(); i++) {
         char c = fmt[i];
         if (c == '{') {
@@ -76,6 +77,7 @@ std::string formatStrVec(const std::string& fmt, const std::vector<std::string>&
                         throw std::runtime_error("[HelperFunctions/formatStr] Positional argument out of range");
 
                     out += collectedArgs[index];
+                    usedPositional = true;
                     i = j;
                 }
                 else {
@@ -90,6 +92,7 @@ std::string formatStrVec(const std::string& fmt, const std::vector<std::string>&
         }
         else out += c;
     }
-    if (argCount < collectedArgs.size()) throw std::runtime_error("[HelperFunctions/formatStr] Too many format arguments");
+    // positional placeholders can pick any subset of arguments, only a partially used sequence is a mistake
+    if (!usedPositional && argCount > 0 && argCount < collectedArgs.size()) throw std::runtime_error("[HelperFunctions/formatStr] Too many format arguments");
     return out;
 }
\ No newline at end of file
@@ -23,6 +23,20 @@ std::filesystem::path findProjectFile(const std::filesystem::path& folder) {
     return {};
 }
 
+// --project, the first positional argument or the current folder. A folder is searched for a project file.
+std::filesystem::path resolveProjectFile(const CLIArgs& args, const std::string& command) {
+    std::filesystem::path input = args.options.count("project") ? std::filesystem::path(args.options.at("project"))
+        : !args.positional.empty() ? std::filesystem::path(args.positional[0]) : std::filesystem::current_path();
+
+    std::filesystem::path projectFilePath;
+    if (std::filesystem::exists(input))
+        projectFilePath = std::filesystem::is_directory(input) ? findProjectFile(input) : input;
+
+    if (projectFilePath.empty())
+        std::println("{}[Neoluma/{}] Project file was not found!{}", Color::TextHex("#ff5050"), command, Color::Reset);
+    return projectFilePath;
+}
+
 int main(int argc, char** argv) {
     #ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
@@ -44,33 +58,20 @@ int main(int argc, char** argv) {
         else createProject();
 
     } else if (args.command == "build") {
-        // build
-    } else if (args.command == "run") {
-        // run
-    } else if (args.command == "check") {
-        std::filesystem::path projectFilePath;
+        std::filesystem::path projectFilePath = resolveProjectFile(args, "Build");
+        if (projectFilePath.empty()) return 2;
 
-        if (args.options.count("project")) {
-            std::filesystem::path input = args.options.at("project");
-
-            if (std::filesystem::exists(input)) {
-                if (std::filesystem::is_directory(input)) projectFilePath = findProjectFile(input);
-                else projectFilePath = input;
-            }
-        }
-        else if (args.positional.size() > 0) {
-            std::println("Test");
-        }
-        else {
-            projectFilePath = findProjectFile(std::filesystem::current_path());
+        if (build(projectFilePath.string(), args.options.count("lto") ? args.options.at("lto") : "").empty()) return 1;
+    } else if (args.command == "run") {
+        std::filesystem::path projectFilePath = resolveProjectFile(args, "Run");
+        if (projectFilePath.empty()) return 2;
 
-            if (projectFilePath.empty()) {
-                std::println("{}[Neoluma/Check] Project file was not found!{}", Color::TextHex("#ff5050"), Color::Reset);
-                return 2;
-            }
-        }
+        return run(projectFilePath.string());
+    } else if (args.command == "check") {
+        std::filesystem::path projectFilePath = resolveProjectFile(args, "Check");
+        if (projectFilePath.empty()) return 2;
 
-        check(projectFilePath.string(), args.options.count("json"));
+        check(projectFilePath.string(), args.options.count("json"), args.options.count("watch"));
     } else if (args.command == "version") std::println("{}Neoluma Alpha Release v0.1{}", Color::TextHex("#ff28e6"), Color::Reset);
     else printHelp();
 
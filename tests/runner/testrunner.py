@@ -1,188 +1,167 @@
+import argparse
 import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+from pathlib import Path
 
-exePath = ".build/.runtime/Debug/bin/neoluma.exe"
-casesRoot = "../cases"
-
-
-# """param(
-#     [string]$ExePath = ".build/.runtime/Debug/bin/neoluma.exe",
-#     [string]$CasesRoot = "tests/cases",
-#     [string[]]$Suites = @("parser", "semantic", "orchestrator")
-# )
-#
-# $ErrorActionPreference = "Stop"
-# $PSNativeCommandUseErrorActionPreference = $false
-#
-# function Strip-Ansi {
-#     param([string]$Text)
-#     return [regex]::Replace($Text, "\x1B\[[0-9;?]*[ -/]*[@-~]", "")
-# }
-#
-# function Get-ActualStage {
-#     param(
-#         [string]$Suite,
-#         [string]$ErrorCode
-#     )
-#
-#     if ($Suite -eq "orchestrator") {
-#         return "orchestrator"
-#     }
-#
-#     if ($ErrorCode -like "NSyE*") { return "parser" }
-#     if ($ErrorCode -like "NPrE*") { return "orchestrator" }
-#     if ($ErrorCode -like "NAnE*") { return "semantic" }
-#     return ""
-# }
-#
-# function New-ProjectFile {
-#     param([string]$ProjectPath)
-#
-#     @'
-# [project]
-# name = "NeolumaFrontendTest"
-# version = "1.0"
-# authors = ["User"]
-# license = "custom"
-# output = "exe"
-# sourceFolder = "src/"
-# buildFolder = ".build/"
-# '@ | Set-Content -LiteralPath $ProjectPath
-# }
-#
-# function Invoke-Case {
-#     param(
-#         [string]$Suite,
-#         [string]$Kind,
-#         [string]$CasePath
-#     )
-#
-#     $expectPath = Join-Path $CasePath "expect.json"
-#     $expect = Get-Content -LiteralPath $expectPath -Raw | ConvertFrom-Json
-#
-#     $tmpRoot = Join-Path "tests/.tmp" ("{0}-{1}-{2}" -f $Suite, $Kind, [IO.Path]::GetFileName($CasePath))
-#     if (Test-Path $tmpRoot) {
-#         Remove-Item -LiteralPath $tmpRoot -Recurse -Force
-#     }
-#
-#     $srcRoot = Join-Path $tmpRoot "src"
-#     New-Item -ItemType Directory -Path $srcRoot -Force | Out-Null
-#
-#     Get-ChildItem -LiteralPath $CasePath -Recurse -File | Where-Object { $_.Name -ne "expect.json" } | ForEach-Object {
-#         $relative = $_.FullName.Substring($CasePath.Length).TrimStart('\', '/')
-#         $dest = Join-Path $srcRoot $relative
-#         $destDir = Split-Path -Parent $dest
-#         if ($destDir) {
-#             New-Item -ItemType Directory -Path $destDir -Force | Out-Null
-#         }
-#         Copy-Item -LiteralPath $_.FullName -Destination $dest -Force
-#     }
-#
-#     $projectPath = Join-Path $tmpRoot "case.nlp"
-#     New-ProjectFile -ProjectPath $projectPath
-#
-#     $command = ('"{0}" check --project "{1}" --json 2>&1' -f $ExePath, $projectPath)
-#     $rawOutput = & cmd /c $command | Out-String
-#     $output = Strip-Ansi $rawOutput
-#     $jsonStart = $output.IndexOf('{')
-#     $jsonEnd = $output.LastIndexOf('}')
-#     if ($jsonStart -lt 0 -or $jsonEnd -lt $jsonStart) {
-#         throw "No JSON payload found in output for case '$CasePath'. Raw output:`n$output"
-#     }
-#     $jsonText = $output.Substring($jsonStart, $jsonEnd - $jsonStart + 1)
-#     $resultJson = $jsonText | ConvertFrom-Json
-#     $status = $resultJson.status
-#
-#     $errorCode = ""
-#     $actualStage = ""
-#     $line = $null
-#     $column = $null
-#     $messageKey = ""
-#
-#     if ($resultJson.errors.Count -gt 0) {
-#         $firstError = $resultJson.errors[0]
-#         $errorCode = $firstError.error_code
-#         $actualStage = if ($firstError.stage) { $firstError.stage } else { Get-ActualStage -Suite $Suite -ErrorCode $errorCode }
-#         if ($null -ne $firstError.line) { $line = [int]$firstError.line }
-#         if ($null -ne $firstError.column) { $column = [int]$firstError.column }
-#         $messageKey = $firstError.message_key
-#         $output = $firstError.message
-#     } else {
-#         $output = ""
-#     }
-#
-#     $failures = @()
-#     if ($expect.status -ne $status) {
-#         $failures += "status expected '$($expect.status)' got '$status'"
-#     }
-#
-#     if ($expect.stage -and $expect.stage -ne $actualStage) {
-#         $failures += "stage expected '$($expect.stage)' got '$actualStage'"
-#     }
-#
-#     if ($expect.error_code -and $expect.error_code -ne $errorCode) {
-#         $failures += "error_code expected '$($expect.error_code)' got '$errorCode'"
-#     }
-#
-#     if ($null -ne $expect.line -and $expect.line -ne $line) {
-#         $failures += "line expected '$($expect.line)' got '$line'"
-#     }
-#
-#     if ($null -ne $expect.column -and $expect.column -ne $column) {
-#         $failures += "column expected '$($expect.column)' got '$column'"
-#     }
-#
-#     if ($expect.message_key -and $expect.message_key -ne $messageKey) {
-#         $failures += "message_key expected '$($expect.message_key)' got '$messageKey'"
-#     }
-#
-#     if ($expect.message_contains -and -not $output.Contains($expect.message_contains)) {
-#         $failures += "message missing '$($expect.message_contains)'"
-#     }
-#
-#     [pscustomobject]@{
-#         Suite = $Suite
-#         Kind = $Kind
-#         Case = [IO.Path]::GetFileName($CasePath)
-#         Passed = ($failures.Count -eq 0)
-#         Failures = $failures
-#         Output = $output.Trim()
-#     }
-# }
-#
-# if (-not (Test-Path -LiteralPath $ExePath)) {
-#     throw "Executable not found: $ExePath"
-# }
-#
-# New-Item -ItemType Directory -Path "tests/.tmp" -Force | Out-Null
-#
-# $results = @()
-# foreach ($suite in $Suites) {
-#     foreach ($kind in @("valid", "invalid")) {
-#         $root = Join-Path $CasesRoot "$suite/$kind"
-#         if (-not (Test-Path -LiteralPath $root)) { continue }
-#
-#         Get-ChildItem -LiteralPath $root -Directory | Sort-Object Name | ForEach-Object {
-#             $results += Invoke-Case -Suite $suite -Kind $kind -CasePath $_.FullName
-#         }
-#     }
-# }
-#
-# $failed = $results | Where-Object { -not $_.Passed }
-# foreach ($result in $results) {
-#     if ($result.Passed) {
-#         Write-Host "[PASS] $($result.Suite)/$($result.Kind)/$($result.Case)"
-#     } else {
-#         Write-Host "[FAIL] $($result.Suite)/$($result.Kind)/$($result.Case)"
-#         foreach ($failure in $result.Failures) {
-#             Write-Host "  - $failure"
-#         }
-#     }
-# }
-#
-# Write-Host ""
-# Write-Host ("Passed {0}/{1} cases." -f ($results.Count - $failed.Count), $results.Count)
-#
-# if ($failed.Count -gt 0) {
-#     exit 1
-# }
-"""
\ No newline at end of file
+exePath = ".build/.runtime/Debug/bin/neoluma" + (".exe" if os.name == "nt" else "")
+casesRoot = "tests/cases"
+tmpRoot = "tests/.tmp"
+suites = ["parser", "semantic", "orchestrator", "run"]
+runTimeout = 60 # seconds a program of the `run` suite may take
+
+# files of a case that aren't sources
+expectFile = "expect.json"
+settingsFile = "settings.toml" # appended to the project file, e.g. `[compiler]` with `memory = "rusty"`
+
+projectFile = """[project]
+name = "NeolumaFrontendTest"
+version = "1.0"
+authors = ["User"]
+license = "custom"
+output = "exe"
+sourceFolder = "src/"
+buildFolder = ".build/"
+"""
+
+
+def stripAnsi(text):
+    return re.sub(r"\x1B\[[0-9;?]*[ -/]*[@-~]", "", text)
+
+
+def actualStage(suite, errorCode):
+    if suite == "orchestrator": return "orchestrator"
+    if errorCode.startswith("NSyE"): return "parser"
+    if errorCode.startswith("NPrE"): return "orchestrator"
+    if errorCode.startswith("NAnE"): return "semantic"
+    return ""
+
+
+def createProject(casePath, projectRoot):
+    if projectRoot.exists(): shutil.rmtree(projectRoot)
+    srcRoot = projectRoot / "src"
+    srcRoot.mkdir(parents=True)
+
+    for file in casePath.rglob("*"):
+        if not file.is_file() or file.name in (expectFile, settingsFile): continue
+        dest = srcRoot / file.relative_to(casePath)
+        dest.parent.mkdir(parents=True, exist_ok=True)
+        shutil.copyfile(file, dest)
+
+    project = projectFile
+    settings = casePath / settingsFile
+    if settings.exists(): project += "\n" + settings.read_text(encoding="utf-8")
+    projectPath = projectRoot / "case.nlp"
+    projectPath.write_text(project, encoding="utf-8")
+    return projectPath
+
+
+def runCase(exe, suite, kind, casePath):
+    expect = json.loads((casePath / expectFile).read_text(encoding="utf-8"))
+    projectPath = createProject(casePath, Path(tmpRoot) / f"{suite}-{kind}-{casePath.name}")
+    if suite == "run": return runProgram(exe, expect, projectPath)
+
+    # `checks` > 1 checks the same project again, so std comes from the symbol indexes the first check wrote
+    for _ in range(expect.get("checks", 1)):
+        process = subprocess.run([exe, "check", "--project", str(projectPath), "--json"], capture_output=True, text=True, encoding="utf-8", errors="replace")
+    output = stripAnsi(process.stdout + process.stderr)
+    jsonStart = output.find("{")
+    jsonEnd = output.rfind("}")
+    if jsonStart < 0 or jsonEnd < jsonStart:
+        return [f"no JSON payload in the output:\n{output}"], output
+
+    result = json.loads(output[jsonStart:jsonEnd + 1])
+    status = result.get("status")
+    errorCode, stage, line, column, messageKey, message = "", "", None, None, "", ""
+    if result.get("errors"):
+        first = result["errors"][0]
+        errorCode = first.get("error_code", "")
+        stage = first.get("stage") or actualStage(suite, errorCode)
+        line, column = first.get("line"), first.get("column")
+        messageKey = first.get("message_key", "")
+        message = first.get("message", "")
+
+    failures = []
+    if expect.get("status") != status: failures.append(f"status expected '{expect.get('status')}' got '{status}'")
+    if expect.get("stage") and expect["stage"] != stage: failures.append(f"stage expected '{expect['stage']}' got '{stage}'")
+    if expect.get("error_code") and expect["error_code"] != errorCode: failures.append(f"error_code expected '{expect['error_code']}' got '{errorCode}'")
+    if expect.get("line") is not None and expect["line"] != line: failures.append(f"line expected '{expect['line']}' got '{line}'")
+    if expect.get("column") is not None and expect["column"] != column: failures.append(f"column expected '{expect['column']}' got '{column}'")
+    if expect.get("message_key") and expect["message_key"] != messageKey: failures.append(f"message_key expected '{expect['message_key']}' got '{messageKey}'")
+    if expect.get("message_contains") and expect["message_contains"] not in message: failures.append(f"message missing '{expect['message_contains']}'")
+    return failures, message
+
+
+# `run` cases are built and run: the build has to succeed, then how the program exits and what it prints are compared.
+# With `"command": "run"` the program is run by `neoluma run` instead, through the Interpreter and the JIT. With
+# `"command": "build"` it's only built, and `status` and `stderr_contains` are of the build.
+def runProgram(exe, expect, projectPath):
+    if expect.get("command") == "build":
+        process = subprocess.run([exe, "build", "--project", str(projectPath)], capture_output=True, text=True, encoding="utf-8", errors="replace")
+        output = stripAnsi(process.stdout + process.stderr)
+        failures = []
+        status = "ok" if process.returncode == 0 else "error"
+        if expect.get("status") != status: failures.append(f"status expected '{expect.get('status')}' got '{status}'")
+        if expect.get("stderr_contains") and expect["stderr_contains"] not in output: failures.append(f"build output missing '{expect['stderr_contains']}'")
+        return failures, output
+    if expect.get("command") == "run":
+        command = [exe, "run", "--project", str(projectPath.resolve())]
+    else:
+        process = subprocess.run([exe, "build", "--project", str(projectPath)], capture_output=True, text=True, encoding="utf-8", errors="replace")
+        output = stripAnsi(process.stdout + process.stderr)
+        if process.returncode != 0: return [f"build failed:\n{output}"], output
+        command = [str(projectPath.parent.resolve() / ".build" / ("NeolumaFrontendTest" + (".exe" if os.name == "nt" else "")))]
+
+    try:
+        process = subprocess.run(command, cwd=projectPath.parent, capture_output=True, text=True, encoding="utf-8", errors="replace", timeout=runTimeout)
+    except subprocess.TimeoutExpired:
+        return [f"didn't finish in {runTimeout} seconds"], ""
+    stdout = process.stdout.replace("\r\n", "\n")
+    if expect.get("command") == "run": stdout = stdout.split("\n\n", 1)[-1] # what the program prints follows the banner of `run`
+    exitCode = 128 - process.returncode if process.returncode < 0 else process.returncode # killed by a signal, as a shell reports it
+    status = "ok" if exitCode == 0 else "error"
+
+    failures = []
+    if expect.get("status") != status: failures.append(f"status expected '{expect.get('status')}' got '{status}'")
+    if expect.get("exit_code") is not None and expect["exit_code"] != exitCode: failures.append(f"exit_code expected '{expect['exit_code']}' got '{exitCode}'")
+    if expect.get("stdout") is not None and expect["stdout"] != stdout: failures.append(f"stdout expected:\n{expect['stdout']}got:\n{stdout}")
+    if expect.get("stderr_contains") and expect["stderr_contains"] not in process.stderr: failures.append(f"stderr missing '{expect['stderr_contains']}'")
+    return failures, stdout
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Runs the regression suite against a built neoluma executable")
+    parser.add_argument("--exe", default=exePath)
+    parser.add_argument("--cases", default=casesRoot)
+    parser.add_argument("--suites", nargs="+", default=suites)
+    args = parser.parse_args()
+
+    if not Path(args.exe).exists(): sys.exit(f"Executable not found: {args.exe}")
+    exe = str(Path(args.exe).resolve())
+    Path(tmpRoot).mkdir(parents=True, exist_ok=True)
+
+    passed = total = 0
+    for suite in args.suites:
+        for kind in ("valid", "invalid"):
+            root = Path(args.cases) / suite / kind
+            if not root.is_dir(): continue
+            for casePath in sorted(path for path in root.iterdir() if path.is_dir()):
+                failures, _ = runCase(exe, suite, kind, casePath)
+                total += 1
+                if not failures:
+                    passed += 1
+                    print(f"[PASS] {suite}/{kind}/{casePath.name}")
+                    continue
+                print(f"[FAIL] {suite}/{kind}/{casePath.name}")
+                for failure in failures: print(f"  - {failure}")
+
+    print()
+    print(f"Passed {passed}/{total} cases.")
+    sys.exit(0 if passed == total else 1)
+
+
+if __name__ == "__main__":
+    main()